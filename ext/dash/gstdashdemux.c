@@ -378,6 +378,9 @@ static gboolean gst_dash_demux_process_manifest (GstAdaptiveDemux * ademux,
 static gboolean gst_dash_demux_seek (GstAdaptiveDemux * demux, GstEvent * seek);
 static GstFlowReturn
 gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream);
+static gboolean gst_dash_demux_stream_peek_fragment (GstAdaptiveDemuxStream *
+    stream, guint offset, gchar ** uri, gint64 * range_start,
+    gint64 * range_end);
 static GstFlowReturn gst_dash_demux_stream_seek (GstAdaptiveDemuxStream *
     stream, gboolean forward, GstSeekFlags flags, GstClockTime ts,
     GstClockTime * final_ts);
@@ -640,6 +643,8 @@ gst_dash_demux_class_init (GstDashDemuxClass * klass)
       gst_dash_demux_stream_select_bitrate;
   gstadaptivedemux_class->stream_update_fragment_info =
       gst_dash_demux_stream_update_fragment_info;
+  gstadaptivedemux_class->stream_peek_fragment =
+      gst_dash_demux_stream_peek_fragment;
   gstadaptivedemux_class->stream_free = gst_dash_demux_stream_free;
   gstadaptivedemux_class->get_live_seek_range =
       gst_dash_demux_get_live_seek_range;
@@ -1380,6 +1385,58 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
   return GST_FLOW_EOS;
 }
 
+static gboolean
+gst_dash_demux_stream_peek_fragment (GstAdaptiveDemuxStream * stream,
+    guint offset, gchar ** uri, gint64 * range_start, gint64 * range_end)
+{
+  GstDashDemuxStream *dashstream = (GstDashDemuxStream *) stream;
+  GstDashDemux *dashdemux = GST_DASH_DEMUX_CAST (stream->demux);
+  GstActiveStream *active_stream = dashstream->active_stream;
+  GstMediaFragmentInfo fragment;
+  gint segment_index;
+  guint segment_repeat_index;
+  gboolean ret = TRUE;
+  guint i;
+
+  /* In trick modes and with subsegments, what comes next depends on the
+   * data of the current fragment */
+  if (stream->demux->segment.rate != 1.0
+      || GST_ADAPTIVE_DEMUX_IN_TRICKMODE_KEY_UNITS (dashdemux)
+      || gst_mpd_client_has_isoff_ondemand_profile (dashdemux->client))
+    return FALSE;
+
+  segment_index = active_stream->segment_index;
+  segment_repeat_index = active_stream->segment_repeat_index;
+
+  for (i = 0; i < offset && ret; i++) {
+    ret = gst_mpd_client_advance_segment (dashdemux->client, active_stream,
+        TRUE) == GST_FLOW_OK;
+  }
+
+  /* Not available on the server yet */
+  if (ret && gst_mpd_client_is_live (dashdemux->client)
+      && gst_dash_demux_stream_get_fragment_waiting_time (stream) > 0)
+    ret = FALSE;
+
+  if (ret) {
+    ret = gst_mpd_client_get_next_fragment (dashdemux->client,
+        dashstream->index, &fragment);
+  }
+
+  active_stream->segment_index = segment_index;
+  active_stream->segment_repeat_index = segment_repeat_index;
+
+  if (!ret)
+    return FALSE;
+
+  *uri = fragment.uri;
+  *range_start = MAX (fragment.range_start, dashstream->sidx_base_offset);
+  *range_end = fragment.range_end;
+  g_free (fragment.index_uri);
+
+  return TRUE;
+}
+
 static gint
 gst_dash_demux_index_entry_search (GstSidxBoxEntry * entry, GstClockTime * ts,
     gpointer user_data)
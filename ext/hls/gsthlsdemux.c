@@ -109,6 +109,8 @@ static GstFlowReturn gst_hls_demux_advance_fragment (GstAdaptiveDemuxStream *
     stream);
 static GstFlowReturn gst_hls_demux_update_fragment_info (GstAdaptiveDemuxStream
     * stream);
+static gboolean gst_hls_demux_stream_get_preload_hint (GstAdaptiveDemuxStream *
+    stream, gchar ** uri, gint64 * range_start, gint64 * range_end);
 static gboolean gst_hls_demux_select_bitrate (GstAdaptiveDemuxStream * stream,
     guint64 bitrate);
 static void gst_hls_demux_reset (GstAdaptiveDemux * demux);
@@ -178,6 +180,8 @@ gst_hls_demux_class_init (GstHLSDemuxClass * klass)
   adaptivedemux_class->stream_advance_fragment = gst_hls_demux_advance_fragment;
   adaptivedemux_class->stream_update_fragment_info =
       gst_hls_demux_update_fragment_info;
+  adaptivedemux_class->stream_get_preload_hint =
+      gst_hls_demux_stream_get_preload_hint;
   adaptivedemux_class->stream_select_bitrate = gst_hls_demux_select_bitrate;
   adaptivedemux_class->stream_free = gst_hls_demux_stream_free;
 
@@ -425,8 +429,23 @@ gst_hls_demux_stream_seek (GstAdaptiveDemuxStream * stream, gboolean forward,
   snap_after = ! !(flags & GST_SEEK_FLAG_SNAP_AFTER);
 
   GST_M3U8_CLIENT_LOCK (hlsdemux->client);
+  walk = hls_stream->playlist->files;
+
+  /* The files ending before ts can't be the target, unless snapping to the
+   * one before it when seeking backwards */
+  if ((snap_nearest || forward || !snap_after) && ts > current_pos) {
+    GstClockTime file_start;
+    GList *l = gst_m3u8_find_file_at_position (hls_stream->playlist,
+        ts - current_pos, &file_start);
+
+    if (l) {
+      walk = l;
+      current_pos += file_start;
+    }
+  }
+
   /* FIXME: Here we need proper discont handling */
-  for (walk = hls_stream->playlist->files; walk; walk = walk->next) {
+  for (; walk; walk = walk->next) {
     file = walk->data;
 
     current_sequence = file->sequence;
@@ -458,6 +477,7 @@ gst_hls_demux_stream_seek (GstAdaptiveDemuxStream * stream, gboolean forward,
       (guint) current_sequence);
   hls_stream->reset_pts = TRUE;
   hls_stream->playlist->sequence = current_sequence;
+  hls_stream->playlist->part = -1;
   hls_stream->playlist->current_file = walk;
   hls_stream->playlist->sequence_position = current_pos;
   GST_M3U8_CLIENT_UNLOCK (hlsdemux->client);
@@ -481,7 +501,12 @@ static GstFlowReturn
 gst_hls_demux_update_manifest (GstAdaptiveDemux * demux)
 {
   GstHLSDemux *hlsdemux = GST_HLS_DEMUX_CAST (demux);
-  if (!gst_hls_demux_update_playlist (hlsdemux, TRUE, NULL))
+  gboolean ret;
+
+  hlsdemux->blocking_reload = TRUE;
+  ret = gst_hls_demux_update_playlist (hlsdemux, TRUE, NULL);
+  hlsdemux->blocking_reload = FALSE;
+  if (!ret)
     return GST_FLOW_ERROR;
 
   return GST_FLOW_OK;
@@ -717,6 +742,7 @@ gst_hls_demux_set_current_variant (GstHLSDemux * hlsdemux,
     variant->m3u8->sequence_position =
         hlsdemux->current_variant->m3u8->sequence_position;
     variant->m3u8->sequence = hlsdemux->current_variant->m3u8->sequence;
+    variant->m3u8->part = hlsdemux->current_variant->m3u8->part;
 
     GST_DEBUG_OBJECT (hlsdemux,
         "Switching Variant. Copying over sequence %" G_GINT64_FORMAT
@@ -738,6 +764,7 @@ gst_hls_demux_set_current_variant (GstHLSDemux * hlsdemux,
           GST_LOG_OBJECT (hlsdemux, "new_media '%s' '%s'", new_media->name,
               new_media->uri);
           new_media->playlist->sequence = old_media->playlist->sequence;
+          new_media->playlist->part = old_media->playlist->part;
           new_media->playlist->sequence_position =
               old_media->playlist->sequence_position;
         } else {
@@ -1303,6 +1330,35 @@ gst_hls_demux_update_fragment_info (GstAdaptiveDemuxStream * stream)
   return GST_FLOW_OK;
 }
 
+/* The part announced by EXT-X-PRELOAD-HINT is downloaded as soon as the
+ * stream starts downloading the one before, instead of once the current one
+ * is done and the playlist lists it */
+static gboolean
+gst_hls_demux_stream_get_preload_hint (GstAdaptiveDemuxStream * stream,
+    gchar ** uri, gint64 * range_start, gint64 * range_end)
+{
+  GstHLSDemuxStream *hls_stream = GST_HLS_DEMUX_STREAM_CAST (stream);
+  GstM3U8MediaFile *hint;
+
+  if (hls_stream->playlist == NULL)
+    return FALSE;
+
+  hint = gst_m3u8_get_preload_hint (hls_stream->playlist);
+  if (hint == NULL)
+    return FALSE;
+
+  /* Same as the fragment info of the part once it is listed */
+  *uri = g_strdup (hint->uri);
+  *range_start = hint->offset;
+  if (hint->size != -1)
+    *range_end = hint->offset + hint->size - 1;
+  else
+    *range_end = -1;
+  gst_m3u8_media_file_unref (hint);
+
+  return TRUE;
+}
+
 static gboolean
 gst_hls_demux_select_bitrate (GstAdaptiveDemuxStream * stream, guint64 bitrate)
 {
@@ -1451,6 +1507,7 @@ gst_hls_demux_update_variant_playlist (GstHLSDemux * hlsdemux, gchar * data,
       /* FIXME: Deal with losing position due to missing an update */
       variant->m3u8->sequence_position = old->m3u8->sequence_position;
       variant->m3u8->sequence = old->m3u8->sequence;
+      variant->m3u8->part = old->m3u8->part;
     }
   }
 
@@ -1554,23 +1611,64 @@ gst_hls_demux_update_playlist (GstHLSDemux * demux, gboolean update,
   GstBuffer *buf;
   gchar *playlist;
   gboolean main_checked = FALSE;
-  const gchar *main_uri;
+  gchar *main_uri;
   GstM3U8 *m3u8;
   gchar *uri;
+  gchar *blocking_uri = NULL;
   gint i;
 
 retry:
   uri = gst_m3u8_get_uri (demux->current_variant->m3u8);
-  main_uri = gst_adaptive_demux_get_manifest_ref_uri (adaptive_demux);
-  download =
-      gst_uri_downloader_fetch_uri (adaptive_demux->downloader, uri, main_uri,
-      TRUE, TRUE, TRUE, err);
+  /* The manifest lock is released during blocking reloads, and the manifest
+   * URI can change meanwhile */
+  main_uri = g_strdup (gst_adaptive_demux_get_manifest_ref_uri
+      (adaptive_demux));
+  if (update && demux->blocking_reload) {
+    /* Only once, variant switches while the lock is released don't block */
+    demux->blocking_reload = FALSE;
+    blocking_uri =
+        gst_m3u8_get_blocking_reload_uri (demux->current_variant->m3u8);
+  }
+
+  if (blocking_uri) {
+    GstHLSVariantStream *variant =
+        gst_hls_variant_stream_ref (demux->current_variant);
+
+    /* The server holds the request until the next part is available, so
+     * don't keep the manifest lock meanwhile */
+    GST_LOG_OBJECT (demux, "Blocking playlist reload %s", blocking_uri);
+    download =
+        gst_adaptive_demux_fetch_uri_blocking (adaptive_demux, blocking_uri,
+        main_uri, err);
+
+    if (variant != demux->current_variant) {
+      GST_DEBUG_OBJECT (demux, "Variant changed during blocking reload");
+      gst_hls_variant_stream_unref (variant);
+      if (download)
+        g_object_unref (download);
+      g_clear_error (err);
+      g_free (blocking_uri);
+      g_free (uri);
+      g_free (main_uri);
+      return TRUE;
+    }
+    gst_hls_variant_stream_unref (variant);
+  } else {
+    download =
+        gst_uri_downloader_fetch_uri (adaptive_demux->downloader, uri,
+        main_uri, TRUE, TRUE, TRUE, err);
+  }
+
   if (download == NULL) {
     gchar *base_uri;
 
+    g_free (blocking_uri);
+    blocking_uri = NULL;
+
     if (!update || main_checked || demux->master->is_simple
         || !gst_adaptive_demux_is_running (GST_ADAPTIVE_DEMUX_CAST (demux))) {
       g_free (uri);
+      g_free (main_uri);
       return FALSE;
     }
     g_clear_error (err);
@@ -1580,6 +1678,7 @@ retry:
     download =
         gst_uri_downloader_fetch_uri (adaptive_demux->downloader,
         main_uri, NULL, TRUE, TRUE, TRUE, err);
+    g_free (main_uri);
     if (download == NULL) {
       g_free (uri);
       return FALSE;
@@ -1622,11 +1721,15 @@ retry:
     goto retry;
   }
   g_free (uri);
+  g_free (main_uri);
 
   m3u8 = demux->current_variant->m3u8;
 
-  /* Set the base URI of the playlist to the redirect target if any */
-  if (download->redirect_permanent && download->redirect_uri) {
+  /* Set the base URI of the playlist to the redirect target if any. The
+   * blocking reload query must not end up in the playlist URI. */
+  if (blocking_uri) {
+    /* keep the current URI */
+  } else if (download->redirect_permanent && download->redirect_uri) {
     gst_m3u8_set_uri (m3u8, download->redirect_uri, NULL,
         demux->current_variant->name);
   } else {
@@ -1643,6 +1746,7 @@ retry:
     GST_WARNING_OBJECT (demux, "Couldn't validate playlist encoding");
     g_set_error (err, GST_STREAM_ERROR, GST_STREAM_ERROR_WRONG_TYPE,
         "Couldn't validate playlist encoding");
+    g_free (blocking_uri);
     return FALSE;
   }
 
@@ -1650,9 +1754,22 @@ retry:
     GST_WARNING_OBJECT (demux, "Couldn't update playlist");
     g_set_error (err, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
         "Couldn't update playlist");
+    g_free (blocking_uri);
     return FALSE;
   }
 
+  /* If the server answered with a newer playlist, the next blocking
+   * request can go out right away */
+  if (blocking_uri) {
+    gchar *next_uri = gst_m3u8_get_blocking_reload_uri (m3u8);
+
+    demux->reload_advanced = g_strcmp0 (next_uri, blocking_uri) != 0;
+    g_free (next_uri);
+    g_free (blocking_uri);
+  } else {
+    demux->reload_advanced = FALSE;
+  }
+
   for (i = 0; i < GST_HLS_N_MEDIA_TYPES; ++i) {
     GList *mlist = demux->current_variant->media[i];
 
@@ -1678,7 +1795,7 @@ retry:
 
   /* If it's a live source, do not let the sequence number go beyond
    * three fragments before the end of the list */
-  if (update == FALSE && gst_m3u8_is_live (m3u8)) {
+  if (update == FALSE && gst_m3u8_is_live (m3u8) && m3u8->part < 0) {
     gint64 last_sequence, first_sequence;
 
     GST_M3U8_CLIENT_LOCK (demux->client);
@@ -1726,20 +1843,18 @@ retry:
     GST_LOG_OBJECT (demux, "Looking for sequence position %"
         GST_TIME_FORMAT " in updated playlist", GST_TIME_ARGS (target_pos));
 
-    current_pos = 0;
-    for (walk = m3u8->files; walk; walk = walk->next) {
-      GstM3U8MediaFile *file = walk->data;
+    walk = gst_m3u8_find_file_at_position (m3u8, target_pos, &current_pos);
+    if (walk) {
+      sequence = GST_M3U8_MEDIA_FILE (walk->data)->sequence;
+    } else if (m3u8->files) {
+      /* End of playlist */
+      GList *last = g_array_index (m3u8->file_index, GstM3U8FileIndexEntry,
+          m3u8->file_index->len - 1).link;
 
-      sequence = file->sequence;
-      if (current_pos <= target_pos
-          && target_pos < current_pos + file->duration) {
-        break;
-      }
-      current_pos += file->duration;
+      sequence = GST_M3U8_MEDIA_FILE (last->data)->sequence + 1;
+    } else {
+      sequence = 1;
     }
-    /* End of playlist */
-    if (!walk)
-      sequence++;
     m3u8->sequence = sequence;
     m3u8->sequence_position = current_pos;
     GST_M3U8_CLIENT_UNLOCK (demux->client);
@@ -2048,8 +2163,19 @@ gst_hls_demux_get_manifest_update_interval (GstAdaptiveDemux * demux)
   GstClockTime target_duration;
 
   if (hlsdemux->current_variant) {
-    target_duration =
-        gst_m3u8_get_target_duration (hlsdemux->current_variant->m3u8);
+    GstM3U8 *m3u8 = hlsdemux->current_variant->m3u8;
+    GstClockTime part_target = gst_m3u8_get_part_target (m3u8);
+
+    /* Low-Latency playlists are reloaded once per part, right away if the
+     * server holds the request until it has something new */
+    if (GST_CLOCK_TIME_IS_VALID (part_target) && gst_m3u8_is_live (m3u8)) {
+      if (hlsdemux->reload_advanced && m3u8->can_block_reload)
+        return 0;
+      return gst_util_uint64_scale (part_target / 2, G_USEC_PER_SEC,
+          GST_SECOND);
+    }
+
+    target_duration = gst_m3u8_get_target_duration (m3u8);
   } else {
     target_duration = 5 * GST_SECOND;
   }
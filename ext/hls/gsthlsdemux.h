@@ -150,6 +150,12 @@ struct _GstHLSDemux
   GstHLSVariantStream  *previous_variant;
 
   gboolean streams_aware;
+
+  /* Blocking playlist reloads are only done from the manifest update loop */
+  gboolean blocking_reload;
+  /* TRUE if the last blocking playlist reload got a newer playlist, so the
+   * next one can be sent right away */
+  gboolean reload_advanced;
 };
 
 struct _GstHLSDemuxClass
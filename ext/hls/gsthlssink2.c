@@ -34,6 +34,16 @@
  * Just point an external webserver to the directory with the playlist and
  * fragment files.
  *
+ * If #GstHlsSink2:part-duration is set, Low-Latency HLS partial segments are
+ * announced in the playlist as byte ranges of the fragment being written,
+ * together with a preload hint for the next part. Blocking playlist reloads
+ * are only advertised if #GstHlsSink2:can-block-reload is set, as they need
+ * support from the server. The #GstHlsSink2::new-part signal
+ * provides the data of each part as soon as it is complete, so that an
+ * in-process server can serve parts from memory, for example together with
+ * memory streams returned from the #GstHlsSink2::get-playlist-stream and
+ * #GstHlsSink2::get-fragment-stream signals.
+ *
  * ## Example launch line
  * |[
  * gst-launch-1.0 videotestsrc is-live=true ! x264enc ! h264parse ! hlssink2 max-files=5
@@ -62,8 +72,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_hls_sink2_debug);
 #define DEFAULT_TARGET_DURATION 15
 #define DEFAULT_PLAYLIST_LENGTH 5
 #define DEFAULT_SEND_KEYFRAME_REQUESTS TRUE
+#define DEFAULT_PART_DURATION 0
+#define DEFAULT_CAN_BLOCK_RELOAD FALSE
 
 #define GST_M3U8_PLAYLIST_VERSION 3
+/* Byte ranges of partial segments need version 4, use what players
+ * supporting Low-Latency HLS are tested with */
+#define GST_M3U8_PLAYLIST_LL_VERSION 6
 
 enum
 {
@@ -75,6 +90,8 @@ enum
   PROP_TARGET_DURATION,
   PROP_PLAYLIST_LENGTH,
   PROP_SEND_KEYFRAME_REQUESTS,
+  PROP_PART_DURATION,
+  PROP_CAN_BLOCK_RELOAD,
 };
 
 enum
@@ -82,6 +99,7 @@ enum
   SIGNAL_GET_PLAYLIST_STREAM,
   SIGNAL_GET_FRAGMENT_STREAM,
   SIGNAL_DELETE_FRAGMENT,
+  SIGNAL_NEW_PART,
   SIGNAL_LAST
 };
 
@@ -110,6 +128,7 @@ static void gst_hls_sink2_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * spec);
 static void gst_hls_sink2_handle_message (GstBin * bin, GstMessage * message);
 static void gst_hls_sink2_reset (GstHlsSink2 * sink);
+static void gst_hls_sink2_write_playlist (GstHlsSink2 * sink);
 static GstStateChangeReturn
 gst_hls_sink2_change_state (GstElement * element, GstStateChange trans);
 static GstPad *gst_hls_sink2_request_new_pad (GstElement * element,
@@ -135,6 +154,8 @@ gst_hls_sink2_finalize (GObject * object)
   g_free (sink->current_location);
   if (sink->playlist)
     gst_m3u8_playlist_free (sink->playlist);
+  gst_buffer_replace (&sink->part_data, NULL);
+  g_mutex_clear (&sink->lock);
 
   g_queue_foreach (&sink->old_locations, (GFunc) g_free, NULL);
   g_queue_clear (&sink->old_locations);
@@ -257,6 +278,36 @@ gst_hls_sink2_class_init (GstHlsSink2Class * klass)
           DEFAULT_SEND_KEYFRAME_REQUESTS,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstHlsSink2:part-duration:
+   *
+   * Target duration of Low-Latency HLS partial segments in milliseconds.
+   * A part is cut at the first muxed packet of a new frame after that
+   * duration, so it can end in the middle of a GOP.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_PART_DURATION,
+      g_param_spec_uint ("part-duration", "Part duration",
+          "Target duration in milliseconds of Low-Latency HLS partial "
+          "segments (0 - disabled)", 0, G_MAXUINT, DEFAULT_PART_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstHlsSink2:can-block-reload:
+   *
+   * Advertise blocking playlist reloads with `_HLS_msn` and `_HLS_part`
+   * in the playlist of partial segments. hlssink2 only writes files, so
+   * only set this if the server serving them handles these requests.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_CAN_BLOCK_RELOAD,
+      g_param_spec_boolean ("can-block-reload", "Can block reload",
+          "Advertise that the server supports blocking playlist reloads",
+          DEFAULT_CAN_BLOCK_RELOAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstHlsSink2::get-playlist-stream:
    * @sink: the #GstHlsSink2
@@ -302,6 +353,25 @@ gst_hls_sink2_class_init (GstHlsSink2Class * klass)
       g_signal_new ("delete-fragment", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_STRING);
 
+  /**
+   * GstHlsSink2::new-part:
+   * @sink: the #GstHlsSink2
+   * @location: playlist URI of the fragment the part belongs to
+   * @sequence: media sequence number of the fragment
+   * @part: index of the part in the fragment
+   * @offset: byte offset of the part in the fragment
+   * @data: the part data
+   *
+   * Emitted when a partial segment is complete, before the playlist
+   * announcing it is written.
+   *
+   * Since: 1.20
+   */
+  signals[SIGNAL_NEW_PART] =
+      g_signal_new ("new-part", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 5, G_TYPE_STRING,
+      G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT64, GST_TYPE_BUFFER);
+
   klass->get_playlist_stream = gst_hls_sink2_get_playlist_stream;
   klass->get_fragment_stream = gst_hls_sink2_get_fragment_stream;
 }
@@ -313,19 +383,23 @@ on_format_location (GstElement * splitmuxsink, guint fragment_id,
   GOutputStream *stream = NULL;
   gchar *location;
 
+  g_mutex_lock (&sink->lock);
+  sink->fragment_id = fragment_id;
+  g_mutex_unlock (&sink->lock);
+
   location = g_strdup_printf (sink->location, fragment_id);
   g_signal_emit (sink, signals[SIGNAL_GET_FRAGMENT_STREAM], 0, location,
       &stream);
 
-  if (!stream) {
+  if (!stream)
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE,
         (("Got no output stream for fragment '%s'."), location), (NULL));
-    g_free (sink->current_location);
-    sink->current_location = NULL;
-  } else {
-    g_free (sink->current_location);
-    sink->current_location = g_steal_pointer (&location);
-  }
+
+  /* The fragment probe reads the location from the streaming thread */
+  g_mutex_lock (&sink->lock);
+  g_free (sink->current_location);
+  sink->current_location = stream ? g_steal_pointer (&location) : NULL;
+  g_mutex_unlock (&sink->lock);
   g_object_set (sink->giostreamsink, "stream", stream, NULL);
 
   if (stream)
@@ -336,10 +410,129 @@ on_format_location (GstElement * splitmuxsink, guint fragment_id,
   return NULL;
 }
 
+static gchar *
+gst_hls_sink2_get_entry_location (GstHlsSink2 * sink, const gchar * location)
+{
+  gchar *name, *entry_location;
+
+  name = g_path_get_basename (location);
+  if (sink->playlist_root == NULL)
+    return name;
+
+  entry_location = g_build_filename (sink->playlist_root, name, NULL);
+  g_free (name);
+
+  return entry_location;
+}
+
+/* Adds the current part to the playlist, must be called with the lock
+ * held */
+static void
+gst_hls_sink2_finish_part (GstHlsSink2 * sink, GstClockTime duration)
+{
+  gchar *entry_location;
+
+  if (sink->part_size == 0 || !sink->current_location)
+    return;
+
+  entry_location = gst_hls_sink2_get_entry_location (sink,
+      sink->current_location);
+
+  GST_LOG_OBJECT (sink, "part %u of fragment %u: %" G_GUINT64_FORMAT
+      " bytes, %" GST_TIME_FORMAT, sink->part_index, sink->index,
+      sink->part_size, GST_TIME_ARGS (duration));
+
+  if (sink->part_data) {
+    g_signal_emit (sink, signals[SIGNAL_NEW_PART], 0, entry_location,
+        sink->index, sink->part_index, sink->part_offset, sink->part_data);
+    gst_buffer_replace (&sink->part_data, NULL);
+  }
+
+  gst_m3u8_playlist_add_part (sink->playlist, entry_location, duration,
+      sink->part_offset, sink->part_size, sink->part_independent);
+
+  sink->part_offset += sink->part_size;
+  sink->part_size = 0;
+  sink->part_index++;
+  sink->parts_duration += duration;
+
+  gst_m3u8_playlist_set_preload_hint (sink->playlist, entry_location,
+      sink->part_offset);
+  g_free (entry_location);
+}
+
+/* Returns %TRUE if a part was finished */
+static gboolean
+gst_hls_sink2_handle_fragment_buffer (GstHlsSink2 * sink, GstBuffer * buffer)
+{
+  GstClockTime ts = GST_BUFFER_DTS_OR_PTS (buffer);
+  gboolean finished = FALSE;
+
+  /* Only cut before the first packet of a new frame */
+  if (GST_CLOCK_TIME_IS_VALID (ts)) {
+    if (!GST_CLOCK_TIME_IS_VALID (sink->part_start)) {
+      sink->part_start = ts;
+    } else if (sink->part_size > 0 && ts > sink->part_last_ts &&
+        ts - sink->part_start >= sink->part_duration * GST_MSECOND) {
+      gst_hls_sink2_finish_part (sink, ts - sink->part_start);
+      sink->part_start = ts;
+      finished = TRUE;
+    }
+    sink->part_last_ts = ts;
+  }
+
+  if (sink->part_size == 0) {
+    /* The muxer pushes unaligned packets one per buffer, and only flags the
+     * first packet written for a keyframe as non-delta */
+    sink->part_independent =
+        !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    if (g_signal_has_handler_pending (sink, signals[SIGNAL_NEW_PART], 0,
+            FALSE))
+      sink->part_data = gst_buffer_new ();
+  }
+
+  sink->part_size += gst_buffer_get_size (buffer);
+  if (sink->part_data)
+    sink->part_data = gst_buffer_append (sink->part_data,
+        gst_buffer_ref (buffer));
+
+  return finished;
+}
+
+static GstPadProbeReturn
+gst_hls_sink2_fragment_probe (GstPad * pad, GstPadProbeInfo * info,
+    GstHlsSink2 * sink)
+{
+  gboolean finished = FALSE;
+
+  if (sink->part_duration == 0)
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&sink->lock);
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    finished = gst_hls_sink2_handle_fragment_buffer (sink,
+        GST_PAD_PROBE_INFO_BUFFER (info));
+  } else {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint i, len = gst_buffer_list_length (list);
+
+    for (i = 0; i < len; i++)
+      finished |= gst_hls_sink2_handle_fragment_buffer (sink,
+          gst_buffer_list_get (list, i));
+  }
+
+  if (finished)
+    gst_hls_sink2_write_playlist (sink);
+  g_mutex_unlock (&sink->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
 static void
 gst_hls_sink2_init (GstHlsSink2 * sink)
 {
   GstElement *mux;
+  GstPad *pad;
 
   sink->location = g_strdup (DEFAULT_LOCATION);
   sink->playlist_location = g_strdup (DEFAULT_PLAYLIST_LOCATION);
@@ -348,13 +541,22 @@ gst_hls_sink2_init (GstHlsSink2 * sink)
   sink->max_files = DEFAULT_MAX_FILES;
   sink->target_duration = DEFAULT_TARGET_DURATION;
   sink->send_keyframe_requests = DEFAULT_SEND_KEYFRAME_REQUESTS;
+  sink->part_duration = DEFAULT_PART_DURATION;
+  sink->can_block_reload = DEFAULT_CAN_BLOCK_RELOAD;
   g_queue_init (&sink->old_locations);
+  g_mutex_init (&sink->lock);
 
   sink->splitmuxsink = gst_element_factory_make ("splitmuxsink", NULL);
   gst_bin_add (GST_BIN (sink), sink->splitmuxsink);
 
   sink->giostreamsink = gst_element_factory_make ("giostreamsink", NULL);
 
+  pad = gst_element_get_static_pad (sink->giostreamsink, "sink");
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      (GstPadProbeCallback) gst_hls_sink2_fragment_probe, sink, NULL);
+  gst_object_unref (pad);
+
   mux = gst_element_factory_make ("mpegtsmux", NULL);
   g_object_set (sink->splitmuxsink, "location", NULL, "max-size-time",
       ((GstClockTime) sink->target_duration * GST_SECOND),
@@ -369,20 +571,46 @@ gst_hls_sink2_init (GstHlsSink2 * sink)
   gst_hls_sink2_reset (sink);
 }
 
+static void
+gst_hls_sink2_reset_part (GstHlsSink2 * sink)
+{
+  sink->part_index = 0;
+  sink->part_offset = 0;
+  sink->part_size = 0;
+  sink->part_start = GST_CLOCK_TIME_NONE;
+  sink->part_last_ts = GST_CLOCK_TIME_NONE;
+  sink->parts_duration = 0;
+  gst_buffer_replace (&sink->part_data, NULL);
+}
+
+/* Must be called with the lock held */
+static void
+gst_hls_sink2_update_playlist_parts (GstHlsSink2 * sink)
+{
+  sink->playlist->version = sink->part_duration > 0 ?
+      GST_M3U8_PLAYLIST_LL_VERSION : GST_M3U8_PLAYLIST_VERSION;
+  sink->playlist->part_target = sink->part_duration * GST_MSECOND;
+  sink->playlist->can_block_reload = sink->can_block_reload;
+}
+
 static void
 gst_hls_sink2_reset (GstHlsSink2 * sink)
 {
+  g_mutex_lock (&sink->lock);
   sink->index = 0;
 
   if (sink->playlist)
     gst_m3u8_playlist_free (sink->playlist);
   sink->playlist =
       gst_m3u8_playlist_new (GST_M3U8_PLAYLIST_VERSION, sink->playlist_length);
+  gst_hls_sink2_update_playlist_parts (sink);
+  gst_hls_sink2_reset_part (sink);
 
   g_queue_foreach (&sink->old_locations, (GFunc) g_free, NULL);
   g_queue_clear (&sink->old_locations);
 
   sink->state = GST_M3U8_PLAYLIST_RENDER_INIT;
+  g_mutex_unlock (&sink->lock);
 }
 
 static void
@@ -431,36 +659,52 @@ gst_hls_sink2_handle_message (GstBin * bin, GstMessage * message)
           gst_structure_get_clock_time (s, "running-time",
               &sink->current_running_time_start);
         } else if (gst_structure_has_name (s, "splitmuxsink-fragment-closed")) {
-          GstClockTime running_time;
-          gchar *entry_location;
+          GstClockTime running_time, duration;
+          gchar *entry_location, *location;
 
+          g_mutex_lock (&sink->lock);
           if (!sink->current_location) {
+            g_mutex_unlock (&sink->lock);
             GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, ((NULL)),
                 ("Fragment closed without knowing its location"));
             break;
           }
 
           gst_structure_get_clock_time (s, "running-time", &running_time);
+          duration = running_time - sink->current_running_time_start;
 
           GST_INFO_OBJECT (sink, "COUNT %d", sink->index);
-          if (sink->playlist_root == NULL) {
-            entry_location = g_path_get_basename (sink->current_location);
-          } else {
-            gchar *name = g_path_get_basename (sink->current_location);
-            entry_location = g_build_filename (sink->playlist_root, name, NULL);
-            g_free (name);
+          entry_location = gst_hls_sink2_get_entry_location (sink,
+              sink->current_location);
+
+          if (sink->part_duration > 0) {
+            gchar *next_location, *next_entry_location;
+
+            /* The last part gets what's left of the fragment duration */
+            gst_hls_sink2_finish_part (sink,
+                MAX (duration, sink->parts_duration) - sink->parts_duration);
+            gst_hls_sink2_reset_part (sink);
+
+            next_location = g_strdup_printf (sink->location,
+                sink->fragment_id + 1);
+            next_entry_location = gst_hls_sink2_get_entry_location (sink,
+                next_location);
+            gst_m3u8_playlist_set_preload_hint (sink->playlist,
+                next_entry_location, 0);
+            g_free (next_entry_location);
+            g_free (next_location);
           }
 
           gst_m3u8_playlist_add_entry (sink->playlist, entry_location,
-              NULL, running_time - sink->current_running_time_start,
-              sink->index++, FALSE);
+              NULL, duration, sink->index++, FALSE);
           g_free (entry_location);
 
           gst_hls_sink2_write_playlist (sink);
           sink->state |= GST_M3U8_PLAYLIST_RENDER_STARTED;
+          location = g_steal_pointer (&sink->current_location);
+          g_mutex_unlock (&sink->lock);
 
-          g_queue_push_tail (&sink->old_locations,
-              g_strdup (sink->current_location));
+          g_queue_push_tail (&sink->old_locations, location);
 
           if (sink->max_files > 0) {
             while (g_queue_get_length (&sink->old_locations) > sink->max_files) {
@@ -487,17 +731,16 @@ gst_hls_sink2_handle_message (GstBin * bin, GstMessage * message)
               g_free (old_location);
             }
           }
-
-          g_free (sink->current_location);
-          sink->current_location = NULL;
         }
       }
       break;
     }
     case GST_MESSAGE_EOS:{
+      g_mutex_lock (&sink->lock);
       sink->playlist->end_list = TRUE;
       gst_hls_sink2_write_playlist (sink);
       sink->state |= GST_M3U8_PLAYLIST_RENDER_ENDED;
+      g_mutex_unlock (&sink->lock);
       break;
     }
     default:
@@ -591,11 +834,13 @@ gst_hls_sink2_change_state (GstElement * element, GstStateChange trans)
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       /* drain playlist with #EXT-X-ENDLIST */
+      g_mutex_lock (&sink->lock);
       if (sink->playlist && (sink->state & GST_M3U8_PLAYLIST_RENDER_STARTED) &&
           !(sink->state & GST_M3U8_PLAYLIST_RENDER_ENDED)) {
         sink->playlist->end_list = TRUE;
         gst_hls_sink2_write_playlist (sink);
       }
+      g_mutex_unlock (&sink->lock);
       /* fall-through */
     case GST_STATE_CHANGE_READY_TO_NULL:
       gst_hls_sink2_reset (sink);
@@ -640,7 +885,9 @@ gst_hls_sink2_set_property (GObject * object, guint prop_id,
       break;
     case PROP_PLAYLIST_LENGTH:
       sink->playlist_length = g_value_get_uint (value);
+      g_mutex_lock (&sink->lock);
       sink->playlist->window_size = sink->playlist_length;
+      g_mutex_unlock (&sink->lock);
       break;
     case PROP_SEND_KEYFRAME_REQUESTS:
       sink->send_keyframe_requests = g_value_get_boolean (value);
@@ -649,6 +896,18 @@ gst_hls_sink2_set_property (GObject * object, guint prop_id,
             sink->send_keyframe_requests, NULL);
       }
       break;
+    case PROP_PART_DURATION:
+      g_mutex_lock (&sink->lock);
+      sink->part_duration = g_value_get_uint (value);
+      gst_hls_sink2_update_playlist_parts (sink);
+      g_mutex_unlock (&sink->lock);
+      break;
+    case PROP_CAN_BLOCK_RELOAD:
+      g_mutex_lock (&sink->lock);
+      sink->can_block_reload = g_value_get_boolean (value);
+      gst_hls_sink2_update_playlist_parts (sink);
+      g_mutex_unlock (&sink->lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -683,6 +942,12 @@ gst_hls_sink2_get_property (GObject * object, guint prop_id,
     case PROP_SEND_KEYFRAME_REQUESTS:
       g_value_set_boolean (value, sink->send_keyframe_requests);
       break;
+    case PROP_PART_DURATION:
+      g_value_set_uint (value, sink->part_duration);
+      break;
+    case PROP_CAN_BLOCK_RELOAD:
+      g_value_set_boolean (value, sink->can_block_reload);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -50,14 +50,30 @@ struct _GstHlsSink2
   gint max_files;
   gint target_duration;
   gboolean send_keyframe_requests;
+  guint part_duration;
+  gboolean can_block_reload;
+
+  /* protects the playlist and the part state */
+  GMutex lock;
 
   GstM3U8Playlist *playlist;
   guint index;
 
-  gchar *current_location;
+  guint fragment_id;
+  gchar *current_location;      /* protected by the lock */
   GstClockTime current_running_time_start;
   GQueue old_locations;
   GstM3U8PlaylistRenderState state;
+
+  /* part of the current fragment being written */
+  guint part_index;
+  guint64 part_offset;
+  guint64 part_size;
+  GstClockTime part_start;
+  GstClockTime part_last_ts;
+  GstClockTime parts_duration;
+  gboolean part_independent;
+  GstBuffer *part_data;
 };
 
 struct _GstHlsSink2Class
@@ -32,7 +32,11 @@ enum
   GST_M3U8_PLAYLIST_TYPE_VOD,
 };
 
+/* Number of segments at the end of the playlist that keep their parts */
+#define GST_M3U8_PLAYLIST_PART_SEGMENTS 3
+
 typedef struct _GstM3U8Entry GstM3U8Entry;
+typedef struct _GstM3U8Part GstM3U8Part;
 
 struct _GstM3U8Entry
 {
@@ -40,8 +44,25 @@ struct _GstM3U8Entry
   gchar *title;
   gchar *url;
   gboolean discontinuous;
+  GQueue parts;
+};
+
+struct _GstM3U8Part
+{
+  gfloat duration;
+  gchar *url;
+  guint64 offset;
+  guint64 size;                 /* 0 if the part is the whole url */
+  gboolean independent;
 };
 
+static void
+gst_m3u8_part_free (GstM3U8Part * part)
+{
+  g_free (part->url);
+  g_free (part);
+}
+
 static GstM3U8Entry *
 gst_m3u8_entry_new (const gchar * url, const gchar * title,
     gfloat duration, gboolean discontinuous)
@@ -63,6 +84,8 @@ gst_m3u8_entry_free (GstM3U8Entry * entry)
 {
   g_return_if_fail (entry != NULL);
 
+  g_queue_foreach (&entry->parts, (GFunc) gst_m3u8_part_free, NULL);
+  g_queue_clear (&entry->parts);
   g_free (entry->url);
   g_free (entry->title);
   g_free (entry);
@@ -79,6 +102,7 @@ gst_m3u8_playlist_new (guint version, guint window_size)
   playlist->type = GST_M3U8_PLAYLIST_TYPE_EVENT;
   playlist->end_list = FALSE;
   playlist->entries = g_queue_new ();
+  playlist->parts = g_queue_new ();
 
   return playlist;
 }
@@ -90,6 +114,9 @@ gst_m3u8_playlist_free (GstM3U8Playlist * playlist)
 
   g_queue_foreach (playlist->entries, (GFunc) gst_m3u8_entry_free, NULL);
   g_queue_free (playlist->entries);
+  g_queue_foreach (playlist->parts, (GFunc) gst_m3u8_part_free, NULL);
+  g_queue_free (playlist->parts);
+  g_free (playlist->preload_hint_url);
   g_free (playlist);
 }
 
@@ -119,12 +146,73 @@ gst_m3u8_playlist_add_entry (GstM3U8Playlist * playlist,
     }
   }
 
+  /* The parts added since the previous entry make up this one */
+  entry->parts = *playlist->parts;
+  g_queue_init (playlist->parts);
+
   playlist->sequence_number = index + 1;
   g_queue_push_tail (playlist->entries, entry);
 
   return TRUE;
 }
 
+gboolean
+gst_m3u8_playlist_add_part (GstM3U8Playlist * playlist, const gchar * url,
+    gfloat duration, guint64 offset, guint64 size, gboolean independent)
+{
+  GstM3U8Part *part;
+
+  g_return_val_if_fail (playlist != NULL, FALSE);
+  g_return_val_if_fail (url != NULL, FALSE);
+
+  if (playlist->type == GST_M3U8_PLAYLIST_TYPE_VOD)
+    return FALSE;
+
+  part = g_new0 (GstM3U8Part, 1);
+  part->url = g_strdup (url);
+  part->duration = duration;
+  part->offset = offset;
+  part->size = size;
+  part->independent = independent;
+  g_queue_push_tail (playlist->parts, part);
+
+  return TRUE;
+}
+
+void
+gst_m3u8_playlist_set_preload_hint (GstM3U8Playlist * playlist,
+    const gchar * url, guint64 offset)
+{
+  g_return_if_fail (playlist != NULL);
+
+  g_free (playlist->preload_hint_url);
+  playlist->preload_hint_url = g_strdup (url);
+  playlist->preload_hint_offset = offset;
+}
+
+static void
+gst_m3u8_playlist_render_parts (GString * playlist_str, GQueue * parts)
+{
+  GList *l;
+
+  for (l = parts->head; l != NULL; l = l->next) {
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+    GstM3U8Part *part = l->data;
+
+    g_string_append_printf (playlist_str,
+        "#EXT-X-PART:DURATION=%s,URI=\"%s\"",
+        g_ascii_formatd (buf, sizeof (buf), "%.5f",
+            part->duration / GST_SECOND), part->url);
+    if (part->size > 0)
+      g_string_append_printf (playlist_str,
+          ",BYTERANGE=\"%" G_GUINT64_FORMAT "@%" G_GUINT64_FORMAT "\"",
+          part->size, part->offset);
+    if (part->independent)
+      g_string_append (playlist_str, ",INDEPENDENT=YES");
+    g_string_append (playlist_str, "\n");
+  }
+}
+
 static guint
 gst_m3u8_playlist_target_duration (GstM3U8Playlist * playlist)
 {
@@ -146,6 +234,7 @@ gst_m3u8_playlist_render (GstM3U8Playlist * playlist)
 {
   GString *playlist_str;
   GList *l;
+  guint i;
 
   g_return_val_if_fail (playlist != NULL, NULL);
 
@@ -159,16 +248,35 @@ gst_m3u8_playlist_render (GstM3U8Playlist * playlist)
 
   g_string_append_printf (playlist_str, "#EXT-X-TARGETDURATION:%u\n",
       gst_m3u8_playlist_target_duration (playlist));
+
+  if (playlist->part_target > 0) {
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    /* Players stay at least 3 part durations behind the live edge */
+    g_string_append_printf (playlist_str,
+        "#EXT-X-SERVER-CONTROL:%sPART-HOLD-BACK=%s\n",
+        playlist->can_block_reload ? "CAN-BLOCK-RELOAD=YES," : "",
+        g_ascii_formatd (buf, sizeof (buf), "%.5f",
+            3 * playlist->part_target / GST_SECOND));
+    g_string_append_printf (playlist_str, "#EXT-X-PART-INF:PART-TARGET=%s\n",
+        g_ascii_formatd (buf, sizeof (buf), "%.5f",
+            playlist->part_target / GST_SECOND));
+  }
   g_string_append (playlist_str, "\n");
 
   /* Entries */
-  for (l = playlist->entries->head; l != NULL; l = l->next) {
+  i = 0;
+  for (l = playlist->entries->head; l != NULL; l = l->next, i++) {
     gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
     GstM3U8Entry *entry = l->data;
 
     if (entry->discontinuous)
       g_string_append (playlist_str, "#EXT-X-DISCONTINUITY\n");
 
+    if (playlist->part_target > 0 && i + GST_M3U8_PLAYLIST_PART_SEGMENTS >=
+        playlist->entries->length)
+      gst_m3u8_playlist_render_parts (playlist_str, &entry->parts);
+
     if (playlist->version < 3) {
       g_string_append_printf (playlist_str, "#EXTINF:%d,%s\n",
           (gint) ((entry->duration + 500 * GST_MSECOND) / GST_SECOND),
@@ -182,6 +290,21 @@ gst_m3u8_playlist_render (GstM3U8Playlist * playlist)
     g_string_append_printf (playlist_str, "%s\n", entry->url);
   }
 
+  if (playlist->part_target > 0 && !playlist->end_list) {
+    gst_m3u8_playlist_render_parts (playlist_str, playlist->parts);
+
+    if (playlist->preload_hint_url) {
+      g_string_append_printf (playlist_str,
+          "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"",
+          playlist->preload_hint_url);
+      if (playlist->preload_hint_offset > 0)
+        g_string_append_printf (playlist_str,
+            ",BYTERANGE-START=%" G_GUINT64_FORMAT,
+            playlist->preload_hint_offset);
+      g_string_append (playlist_str, "\n");
+    }
+  }
+
   if (playlist->end_list)
     g_string_append (playlist_str, "#EXT-X-ENDLIST");
 
@@ -36,8 +36,16 @@ struct _GstM3U8Playlist
   gboolean end_list;
   guint sequence_number;
 
+  /* Low-Latency HLS, partial segments are only rendered if part_target
+   * is non-zero. Durations are in nanoseconds like entry durations */
+  gfloat part_target;
+  gboolean can_block_reload;
+  gchar *preload_hint_url;
+  guint64 preload_hint_offset;
+
   /*< Private >*/
   GQueue *entries;
+  GQueue *parts;                /* parts of the segment being written */
 };
 
 typedef enum
@@ -60,6 +68,17 @@ gboolean          gst_m3u8_playlist_add_entry (GstM3U8Playlist * playlist,
                                                guint             index,
                                                gboolean          discontinuous);
 
+gboolean          gst_m3u8_playlist_add_part (GstM3U8Playlist * playlist,
+                                              const gchar     * url,
+                                              gfloat            duration,
+                                              guint64           offset,
+                                              guint64           size,
+                                              gboolean          independent);
+
+void              gst_m3u8_playlist_set_preload_hint (GstM3U8Playlist * playlist,
+                                                      const gchar     * url,
+                                                      guint64           offset);
+
 gchar *           gst_m3u8_playlist_render (GstM3U8Playlist * playlist);
 
 G_END_DECLS
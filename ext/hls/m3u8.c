@@ -46,9 +46,12 @@ gst_m3u8_new (void)
   m3u8->current_file = NULL;
   m3u8->current_file_duration = GST_CLOCK_TIME_NONE;
   m3u8->sequence = -1;
+  m3u8->part = -1;
   m3u8->sequence_position = 0;
   m3u8->highest_sequence_number = -1;
   m3u8->duration = GST_CLOCK_TIME_NONE;
+  m3u8->part_hold_back = GST_CLOCK_TIME_NONE;
+  m3u8->part_target = GST_CLOCK_TIME_NONE;
 
   g_mutex_init (&m3u8->lock);
   m3u8->ref_count = 1;
@@ -107,8 +110,16 @@ gst_m3u8_unref (GstM3U8 * self)
 
     g_list_foreach (self->files, (GFunc) gst_m3u8_media_file_unref, NULL);
     g_list_free (self->files);
+    if (self->file_index)
+      g_array_free (self->file_index, TRUE);
+
+    if (self->partial_file)
+      gst_m3u8_media_file_unref (self->partial_file);
+    if (self->preload_hint)
+      gst_m3u8_media_file_unref (self->preload_hint);
 
     g_free (self->last_data);
+    g_free (self->files_base_uri);
     g_mutex_clear (&self->lock);
     g_free (self);
   }
@@ -147,6 +158,8 @@ gst_m3u8_media_file_unref (GstM3U8MediaFile * self)
   if (g_atomic_int_dec_and_test (&self->ref_count)) {
     if (self->init_file)
       gst_m3u8_init_file_unref (self->init_file);
+    if (self->parts)
+      g_ptr_array_unref (self->parts);
     g_free (self->title);
     g_free (self->uri);
     g_free (self->key);
@@ -330,6 +343,82 @@ parse_attributes (gchar ** ptr, gchar ** a, gchar ** v)
   return TRUE;
 }
 
+/* Parses the attributes of EXT-X-PART and EXT-X-PRELOAD-HINT. @prev is the
+ * part before in the same segment, if any. Returns NULL for hints that are
+ * not about a part */
+static GstM3U8MediaFile *
+gst_m3u8_parse_part (GstM3U8 * self, gchar * desc, GstM3U8MediaFile * prev)
+{
+  GstM3U8MediaFile *part;
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  gboolean independent = FALSE, open_ended = FALSE;
+  gint64 size = -1, offset = -1;
+  gchar *a, *v, *uri = NULL;
+  gdouble fval;
+
+  while (desc != NULL && parse_attributes (&desc, &a, &v)) {
+    if (strcmp (a, "URI") == 0) {
+      g_free (uri);
+      uri = uri_join (self->base_uri ? self->base_uri : self->uri, v);
+    } else if (strcmp (a, "TYPE") == 0) {
+      if (strcmp (v, "PART") != 0) {
+        GST_LOG ("Ignoring preload hint of type %s", v);
+        g_free (uri);
+        return NULL;
+      }
+    } else if (strcmp (a, "DURATION") == 0) {
+      if (double_from_string (v, NULL, &fval))
+        duration = fval * (gdouble) GST_SECOND;
+    } else if (strcmp (a, "INDEPENDENT") == 0) {
+      independent = g_ascii_strcasecmp (v, "YES") == 0;
+    } else if (strcmp (a, "BYTERANGE") == 0) {
+      if (!int64_from_string (v, &v, &size)) {
+        size = -1;
+      } else if (*v == '@' && !int64_from_string (v + 1, &v, &offset)) {
+        size = offset = -1;
+      }
+    } else if (strcmp (a, "BYTERANGE-START") == 0) {
+      if (int64_from_string (v, NULL, &offset))
+        open_ended = size == -1;
+      else
+        offset = -1;
+    } else if (strcmp (a, "BYTERANGE-LENGTH") == 0) {
+      if (int64_from_string (v, NULL, &size))
+        open_ended = FALSE;
+      else
+        size = -1;
+    }
+  }
+
+  if (uri == NULL) {
+    GST_WARNING ("Part without URI");
+    return NULL;
+  }
+
+  /* Such a hint only completes with its segment, it can't be fetched ahead
+   * as a part */
+  if (open_ended) {
+    GST_LOG ("Ignoring open ended preload hint for %s", uri);
+    g_free (uri);
+    return NULL;
+  }
+
+  /* A byte range without offset continues the previous part */
+  if (offset == -1) {
+    if (size != -1 && prev && prev->size != -1 && g_str_equal (prev->uri, uri))
+      offset = prev->offset + prev->size;
+    else
+      offset = 0;
+  }
+
+  part = gst_m3u8_media_file_new (uri, NULL, duration, 0);
+  part->offset = offset;
+  part->size = size;
+  part->independent = independent;
+
+  return part;
+}
+
 static gint
 gst_hls_variant_stream_compare_by_bitrate (gconstpointer a, gconstpointer b)
 {
@@ -342,6 +431,189 @@ gst_hls_variant_stream_compare_by_bitrate (gconstpointer a, gconstpointer b)
   return vs_a->bandwidth - vs_b->bandwidth;
 }
 
+/* Returns the position of the first file with a sequence number not lower
+ * than @sequence in @index, or the number of files if there is none */
+static guint
+m3u8_file_index_lower_bound (GArray * index, gint64 sequence)
+{
+  guint lo = 0, hi = index ? index->len : 0;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+    GstM3U8FileIndexEntry *entry =
+        &g_array_index (index, GstM3U8FileIndexEntry, mid);
+
+    if (GST_M3U8_MEDIA_FILE (entry->link->data)->sequence < sequence)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* Returns the link of the file with @sequence in @index, or NULL */
+static GList *
+m3u8_file_index_lookup (GArray * index, gint64 sequence)
+{
+  guint i = m3u8_file_index_lower_bound (index, sequence);
+  GList *link;
+
+  if (i == (index ? index->len : 0))
+    return NULL;
+
+  link = g_array_index (index, GstM3U8FileIndexEntry, i).link;
+  if (GST_M3U8_MEDIA_FILE (link->data)->sequence != sequence)
+    return NULL;
+
+  return link;
+}
+
+/* Fills in the links and start times of the index entries that were added
+ * while parsing, one per file.
+ * call with M3U8_LOCK held */
+static void
+m3u8_build_file_index (GstM3U8 * self)
+{
+  GstClockTime start = 0;
+  GList *l;
+  guint i = 0;
+
+  for (l = self->files; l; l = l->next, i++) {
+    GstM3U8FileIndexEntry *entry =
+        &g_array_index (self->file_index, GstM3U8FileIndexEntry, i);
+
+    entry->link = l;
+    entry->start = start;
+
+    start += GST_M3U8_MEDIA_FILE (l->data)->duration;
+  }
+}
+
+/* Adds an index entry for the file just added, whose URI line spans @line to
+ * @line_end in last_data */
+static GstM3U8FileIndexEntry *
+m3u8_add_file_index_entry (GstM3U8 * self, gsize line, gsize line_end,
+    gboolean have_iv)
+{
+  GstM3U8FileIndexEntry entry = { NULL, 0, line, line_end, have_iv };
+
+  g_array_append_val (self->file_index, entry);
+
+  return &g_array_index (self->file_index, GstM3U8FileIndexEntry,
+      self->file_index->len - 1);
+}
+
+/* Returns the file of the previous playlist update with @sequence if it has
+ * the same URI. The URI line @text, which spans @line to @line_end in
+ * last_data, is only resolved again if it or the base URI changed. If the
+ * file isn't known, the resolved URI is returned in @uri. The file then only
+ * needs the attributes set by the tags before it, which are cleared here. */
+static GstM3U8MediaFile *
+m3u8_take_previous_file (GstM3U8 * self, GArray * previous_index,
+    const gchar * previous_data, gint64 sequence, const gchar * text,
+    gsize line, gsize line_end, gboolean same_base, gchar ** uri)
+{
+  GstM3U8FileIndexEntry *entry = NULL;
+  GstM3U8MediaFile *file;
+  guint i;
+
+  *uri = NULL;
+
+  i = m3u8_file_index_lower_bound (previous_index, sequence);
+  if (previous_index && i < previous_index->len) {
+    entry = &g_array_index (previous_index, GstM3U8FileIndexEntry, i);
+    if (GST_M3U8_MEDIA_FILE (entry->link->data)->sequence != sequence)
+      entry = NULL;
+  }
+
+  if (entry == NULL || !same_base || entry->line_end - entry->line !=
+      line_end - line || memcmp (previous_data + entry->line,
+          self->last_data + line, line_end - line) != 0) {
+    *uri = uri_join (self->base_uri ? self->base_uri : self->uri, text);
+    if (entry == NULL || *uri == NULL)
+      return NULL;
+
+    if (strcmp (GST_M3U8_MEDIA_FILE (entry->link->data)->uri, *uri) != 0)
+      return NULL;
+
+    g_free (*uri);
+    *uri = NULL;
+  }
+
+  file = entry->link->data;
+
+  g_free (file->title);
+  file->title = NULL;
+  g_free (file->key);
+  file->key = NULL;
+  memset (file->iv, 0, sizeof (file->iv));
+  if (file->init_file) {
+    gst_m3u8_init_file_unref (file->init_file);
+    file->init_file = NULL;
+  }
+  if (file->parts) {
+    g_ptr_array_unref (file->parts);
+    file->parts = NULL;
+  }
+
+  return gst_m3u8_media_file_ref (file);
+}
+
+/* Compares the playlist text after the URI line of the known file with
+ * @sequence with the text of the previous update, from @line_end of
+ * last_data on. If the text is the same up to the URI line of the last known
+ * file, the files in between are added as they are without parsing their
+ * lines again. Returns the index entry of the last file added, or NULL. */
+static GstM3U8FileIndexEntry *
+m3u8_take_unchanged_files (GstM3U8 * self, GArray * previous_index,
+    const gchar * previous_data, gint64 sequence, gsize line_end)
+{
+  GstM3U8FileIndexEntry *first, *last, *entry = NULL;
+  gsize len;
+  guint i;
+
+  i = m3u8_file_index_lower_bound (previous_index, sequence);
+  if (previous_index == NULL || i + 1 >= previous_index->len)
+    return NULL;
+
+  first = &g_array_index (previous_index, GstM3U8FileIndexEntry, i);
+  last = &g_array_index (previous_index, GstM3U8FileIndexEntry,
+      previous_index->len - 1);
+  if (GST_M3U8_MEDIA_FILE (first->link->data)->sequence != sequence)
+    return NULL;
+
+  /* The previous text has no NUL in there, so this also stops at the end of
+   * the new one */
+  len = last->line_end - first->line_end;
+  if (strncmp (previous_data + first->line_end, self->last_data + line_end,
+          len) != 0)
+    return NULL;
+  if (self->last_data[line_end + len] != '\n'
+      && self->last_data[line_end + len] != '\0')
+    return NULL;
+
+  GST_LOG ("Keeping %u unchanged files after sequence %" G_GINT64_FORMAT,
+      previous_index->len - i - 1, sequence);
+
+  for (i++; i < previous_index->len; i++) {
+    GstM3U8FileIndexEntry *previous =
+        &g_array_index (previous_index, GstM3U8FileIndexEntry, i);
+    GstM3U8MediaFile *file = previous->link->data;
+
+    /* The tags of these files aren't parsed again */
+    if (file->discont)
+      self->discont_sequence++;
+
+    self->files = g_list_prepend (self->files, gst_m3u8_media_file_ref (file));
+    entry = m3u8_add_file_index_entry (self,
+        previous->line - first->line_end + line_end,
+        previous->line_end - first->line_end + line_end, previous->have_iv);
+  }
+
+  return entry;
+}
+
 /* If we have MEDIA-SEQUENCE, ensure that it's consistent. If it is not,
  * the client SHOULD halt playback (6.3.4), which is what we do then. */
 static gboolean
@@ -357,31 +629,22 @@ check_media_seqnums (GstM3U8 * self, GList * previous_files)
     return TRUE;
   }
 
-  /* Find first case of higher/equal sequence number in new playlist.
-   * From there on we can linearly step ahead */
+  /* Find first case of higher/equal sequence number in new playlist than
+   * the first one of the old playlist. From there on we can linearly step
+   * ahead */
+  m = previous_files;
+  f2 = m->data;
   for (l = self->files; l; l = l->next) {
-    gboolean match = FALSE;
-
     f1 = l->data;
-    for (m = previous_files; m; m = m->next) {
-      f2 = m->data;
 
-      if (f1->sequence >= f2->sequence) {
-        match = TRUE;
-        break;
-      }
-    }
-    if (match)
+    if (f1->sequence >= f2->sequence)
       break;
   }
 
-  /* We must have seen at least one entry on each list */
-  g_assert (f1 != NULL);
-  g_assert (f2 != NULL);
-
   if (!l) {
     /* No match, no sequence in the new playlist was higher than
      * any in the old. This is bad! */
+    f2 = g_list_last (previous_files)->data;
     GST_ERROR ("Media sequence doesn't continue: last new %" G_GINT64_FORMAT
         " < last old %" G_GINT64_FORMAT, f1->sequence, f2->sequence);
     return FALSE;
@@ -391,7 +654,8 @@ check_media_seqnums (GstM3U8 * self, GList * previous_files)
     f1 = l->data;
     f2 = m->data;
 
-    if (f1->sequence == f2->sequence && !g_str_equal (f1->uri, f2->uri)) {
+    if (f1->sequence == f2->sequence && f1 != f2
+        && !g_str_equal (f1->uri, f2->uri)) {
       /* Same sequence, different URI. This is bad! */
       GST_ERROR ("Media URIs inconsistent (sequence %" G_GINT64_FORMAT
           "): had '%s', got '%s'", f1->sequence, f2->uri, f1->uri);
@@ -418,35 +682,32 @@ check_media_seqnums (GstM3U8 * self, GList * previous_files)
 static void
 generate_media_seqnums (GstM3U8 * self, GList * previous_files)
 {
-  GList *l, *m;
+  GList *l, *m = NULL;
   GstM3U8MediaFile *f1 = NULL, *f2 = NULL;
+  GHashTable *previous_uris;
   gint64 mediasequence;
 
   g_return_if_fail (previous_files);
 
+  /* The first occurrence of each URI in the old playlist */
+  previous_uris = g_hash_table_new (g_str_hash, g_str_equal);
+  for (m = g_list_last (previous_files); m; m = m->prev)
+    g_hash_table_insert (previous_uris, GST_M3U8_MEDIA_FILE (m->data)->uri, m);
+
   /* Find first case of same URI in new playlist.
    * From there on we can linearly step ahead */
   for (l = self->files; l; l = l->next) {
-    gboolean match = FALSE;
-
     f1 = l->data;
-    for (m = previous_files; m; m = m->next) {
-      f2 = m->data;
-
-      if (g_str_equal (f1->uri, f2->uri)) {
-        match = TRUE;
-        break;
-      }
-    }
-
-    if (match)
+    m = g_hash_table_lookup (previous_uris, f1->uri);
+    if (m)
       break;
   }
+  g_hash_table_unref (previous_uris);
 
   if (l) {
     /* Match, check that all following ones are matching too and continue
      * sequence numbers from there on */
-
+    f2 = m->data;
     mediasequence = f2->sequence;
 
     for (; l && m; l = l->next, m = m->next) {
@@ -462,8 +723,9 @@ generate_media_seqnums (GstM3U8 * self, GList * previous_files)
       }
     }
   } else {
-    /* No match, this means f2 is the last item in the previous playlist
-     * and we have to start our new playlist at that sequence */
+    /* No match, this means the new playlist starts after the last item of
+     * the previous playlist */
+    f2 = g_list_last (previous_files)->data;
     mediasequence = f2->sequence + 1;
     l = self->files;
   }
@@ -476,6 +738,87 @@ generate_media_seqnums (GstM3U8 * self, GList * previous_files)
   }
 }
 
+/* Returns the complete or partial segment with @sequence, not reffed.
+ * call with M3U8_LOCK held */
+static GstM3U8MediaFile *
+m3u8_find_segment (GstM3U8 * m3u8, gint64 sequence)
+{
+  GList *l;
+
+  if (m3u8->partial_file && m3u8->partial_file->sequence == sequence)
+    return m3u8->partial_file;
+
+  l = m3u8_file_index_lookup (m3u8->file_index, sequence);
+
+  return l ? l->data : NULL;
+}
+
+/* Selects the independent part closest to PART-HOLD-BACK from the end of
+ * the playlist. Returns FALSE if the playlist lists no parts.
+ * call with M3U8_LOCK held */
+static gboolean
+m3u8_select_live_start_part (GstM3U8 * m3u8)
+{
+  GstM3U8MediaFile *segment, *start = NULL;
+  GstClockTime hold_back, distance = 0, start_distance = 0, end;
+  GList *l = NULL;
+  gint i, start_part = -1;
+
+  if (!GST_CLOCK_TIME_IS_VALID (m3u8->part_target))
+    return FALSE;
+
+  hold_back = m3u8->part_hold_back;
+  if (!GST_CLOCK_TIME_IS_VALID (hold_back))
+    hold_back = 3 * m3u8->part_target;
+
+  if (m3u8->file_index && m3u8->file_index->len > 0)
+    l = g_array_index (m3u8->file_index, GstM3U8FileIndexEntry,
+        m3u8->file_index->len - 1).link;
+
+  end = m3u8->last_file_end;
+  if (m3u8->partial_file) {
+    segment = m3u8->partial_file;
+    end += segment->duration;
+  } else {
+    segment = l ? l->data : NULL;
+    l = l ? l->prev : NULL;
+  }
+
+  while (segment && segment->parts) {
+    for (i = segment->parts->len - 1; i >= 0; i--) {
+      GstM3U8MediaFile *part = g_ptr_array_index (segment->parts, i);
+
+      distance += part->duration;
+      if (!part->independent)
+        continue;
+
+      start = segment;
+      start_part = i;
+      start_distance = distance;
+      if (distance >= hold_back)
+        goto done;
+    }
+
+    segment = l ? l->data : NULL;
+    l = l ? l->prev : NULL;
+  }
+
+  if (start == NULL)
+    return FALSE;
+
+done:
+  m3u8->current_file = NULL;
+  m3u8->sequence = start->sequence;
+  m3u8->part = start_part;
+  m3u8->sequence_position = end > start_distance ? end - start_distance : 0;
+
+  GST_DEBUG ("first sequence: %u part %d, %" GST_TIME_FORMAT
+      " from the live edge", (guint) m3u8->sequence, m3u8->part,
+      GST_TIME_ARGS (start_distance));
+
+  return TRUE;
+}
+
 /*
  * @data: a m3u8 playlist text data, taking ownership
  */
@@ -494,6 +837,12 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
   GList *previous_files = NULL;
   gboolean have_mediasequence = FALSE;
   GstM3U8InitFile *last_init_file = NULL;
+  GPtrArray *parts = NULL;
+  GArray *previous_index = NULL;
+  gchar *previous_data;
+  const gchar *base_uri;
+  gboolean same_base, take_unchanged = TRUE;
+  gchar *text;
 
   g_return_val_if_fail (self != NULL, FALSE);
   g_return_val_if_fail (data != NULL, FALSE);
@@ -504,6 +853,8 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
   if (self->last_data && g_str_equal (self->last_data, data)) {
     GST_DEBUG ("Playlist is the same as previous one");
     g_free (data);
+    /* as if it was parsed again */
+    self->current_file = NULL;
     GST_M3U8_UNLOCK (self);
     return TRUE;
   }
@@ -523,18 +874,40 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
 
   GST_TRACE ("data:\n%s", data);
 
-  g_free (self->last_data);
+  /* The parser below modifies the text, keep the original to detect
+   * unchanged playlists and files on the next update */
+  previous_data = self->last_data;
   self->last_data = data;
+  data = text = g_strdup (data);
+
+  base_uri = self->base_uri ? self->base_uri : self->uri;
+  same_base = g_strcmp0 (self->files_base_uri, base_uri) == 0;
 
   self->current_file = NULL;
   previous_files = self->files;
   self->files = NULL;
+  previous_index = self->file_index;
+  self->file_index = g_array_new (FALSE, FALSE,
+      sizeof (GstM3U8FileIndexEntry));
+
   self->duration = GST_CLOCK_TIME_NONE;
   mediasequence = 0;
 
   /* By default, allow caching */
   self->allowcache = TRUE;
 
+  self->can_block_reload = FALSE;
+  self->part_hold_back = GST_CLOCK_TIME_NONE;
+  self->part_target = GST_CLOCK_TIME_NONE;
+  if (self->partial_file) {
+    gst_m3u8_media_file_unref (self->partial_file);
+    self->partial_file = NULL;
+  }
+  if (self->preload_hint) {
+    gst_m3u8_media_file_unref (self->preload_hint);
+    self->preload_hint = NULL;
+  }
+
   duration = 0;
   title = NULL;
   data += 7;
@@ -550,16 +923,35 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
       *r = '\0';
 
     if (data[0] != '#' && data[0] != '\0') {
+      GstM3U8MediaFile *file = NULL;
+      GstM3U8FileIndexEntry *entry;
+      gsize line = data - text, line_end;
+      gboolean known = FALSE;
+
       if (duration <= 0) {
         GST_LOG ("%s: got line without EXTINF, dropping", data);
         goto next_line;
       }
 
-      data = uri_join (self->base_uri ? self->base_uri : self->uri, data);
-      if (data != NULL) {
-        GstM3U8MediaFile *file;
-        file = gst_m3u8_media_file_new (data, title, duration, mediasequence++);
+      line_end = end ? end - text : line + strlen (self->last_data + line);
+      if (previous_index && have_mediasequence) {
+        file = m3u8_take_previous_file (self, previous_index, previous_data,
+            mediasequence, data, line, line_end, same_base, &data);
+        known = file != NULL;
+      } else {
+        data = uri_join (base_uri, data);
+      }
+
+      if (file) {
+        file->title = title;
+        file->duration = duration;
+        mediasequence++;
+      } else if (data != NULL) {
+        file = gst_m3u8_media_file_new (data, title, duration,
+            mediasequence++);
+      }
 
+      if (file != NULL) {
         /* set encryption params */
         file->key = current_key ? g_strdup (current_key) : NULL;
         if (file->key) {
@@ -594,11 +986,44 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
         if (last_init_file)
           file->init_file = gst_m3u8_init_file_ref (last_init_file);
 
+        if (parts) {
+          GST_M3U8_MEDIA_FILE (g_ptr_array_index (parts, 0))->discont =
+              discontinuity;
+          file->parts = parts;
+          parts = NULL;
+        }
+
         duration = 0;
         title = NULL;
         discontinuity = FALSE;
         size = offset = -1;
         self->files = g_list_prepend (self->files, file);
+        m3u8_add_file_index_entry (self, line, line_end, have_iv);
+
+        /* Usually the rest of the known files follows as it was */
+        if (known && take_unchanged && same_base) {
+          take_unchanged = FALSE;
+          entry = m3u8_take_unchanged_files (self, previous_index,
+              previous_data, file->sequence, line_end);
+          if (entry) {
+            file = self->files->data;
+            mediasequence = file->sequence + 1;
+
+            /* Continue with the state after the last one */
+            g_free (current_key);
+            current_key = g_strdup (file->key);
+            have_iv = entry->have_iv;
+            if (have_iv)
+              memcpy (iv, file->iv, sizeof (iv));
+            if (last_init_file)
+              gst_m3u8_init_file_unref (last_init_file);
+            last_init_file = file->init_file ?
+                gst_m3u8_init_file_ref (file->init_file) : NULL;
+
+            end = self->last_data[entry->line_end] ? text + entry->line_end :
+                NULL;
+          }
+        }
       }
 
     } else if (g_str_has_prefix (data, "#EXTINF:")) {
@@ -751,6 +1176,59 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
 
           last_init_file = init_file;
         }
+      } else if (g_str_has_prefix (data_ext_x, "SERVER-CONTROL:")) {
+        gchar *v, *a;
+        gdouble fval;
+
+        data = data + 22;
+        while (data != NULL && parse_attributes (&data, &a, &v)) {
+          if (strcmp (a, "CAN-BLOCK-RELOAD") == 0) {
+            self->can_block_reload = g_ascii_strcasecmp (v, "YES") == 0;
+          } else if (strcmp (a, "PART-HOLD-BACK") == 0) {
+            if (double_from_string (v, NULL, &fval))
+              self->part_hold_back = fval * (gdouble) GST_SECOND;
+          }
+        }
+      } else if (g_str_has_prefix (data_ext_x, "PART-INF:")) {
+        gchar *v, *a;
+        gdouble fval;
+
+        data = data + 16;
+        while (data != NULL && parse_attributes (&data, &a, &v)) {
+          if (strcmp (a, "PART-TARGET") == 0
+              && double_from_string (v, NULL, &fval))
+            self->part_target = fval * (gdouble) GST_SECOND;
+        }
+      } else if (g_str_has_prefix (data_ext_x, "PART:")) {
+        GstM3U8MediaFile *part;
+
+        /* Parts can't be decrypted on their own, the IV of a part is the
+         * last block of the one before */
+        if (current_key) {
+          GST_LOG ("Ignoring part of encrypted segment");
+          goto next_line;
+        }
+
+        part = gst_m3u8_parse_part (self, data + 12,
+            parts ? g_ptr_array_index (parts, parts->len - 1) : NULL);
+        if (part == NULL)
+          goto next_line;
+        if (!GST_CLOCK_TIME_IS_VALID (part->duration)) {
+          GST_WARNING ("Part without duration");
+          gst_m3u8_media_file_unref (part);
+          goto next_line;
+        }
+
+        if (last_init_file)
+          part->init_file = gst_m3u8_init_file_ref (last_init_file);
+        if (parts == NULL)
+          parts = g_ptr_array_new_with_free_func ((GDestroyNotify)
+              gst_m3u8_media_file_unref);
+        g_ptr_array_add (parts, part);
+      } else if (g_str_has_prefix (data_ext_x, "PRELOAD-HINT:")) {
+        if (self->preload_hint)
+          gst_m3u8_media_file_unref (self->preload_hint);
+        self->preload_hint = gst_m3u8_parse_part (self, data + 20, NULL);
       } else {
         GST_LOG ("Ignored line: %s", data);
       }
@@ -766,12 +1244,35 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
 
   g_free (current_key);
   current_key = NULL;
+  g_free (text);
+  g_free (previous_data);
+  g_free (self->files_base_uri);
+  self->files_base_uri = g_strdup (base_uri);
 
   self->files = g_list_reverse (self->files);
+  m3u8_build_file_index (self);
+
+  /* Parts of the segment that is still being produced */
+  if (parts) {
+    GstClockTime partial_duration = 0;
+    guint i;
+
+    for (i = 0; i < parts->len; i++)
+      partial_duration += GST_M3U8_MEDIA_FILE (parts->pdata[i])->duration;
+
+    self->partial_file =
+        gst_m3u8_media_file_new (NULL, NULL, partial_duration, mediasequence);
+    GST_M3U8_MEDIA_FILE (parts->pdata[0])->discont = discontinuity;
+    self->partial_file->parts = parts;
+    parts = NULL;
+  }
 
   if (last_init_file)
     gst_m3u8_init_file_unref (last_init_file);
 
+  if (previous_index)
+    g_array_free (previous_index, TRUE);
+
   if (previous_files) {
     gboolean consistent = TRUE;
 
@@ -819,6 +1320,14 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
         mediasequence = file->sequence;
       }
 
+      if (file->parts) {
+        guint i;
+
+        for (i = 0; i < file->parts->len; i++)
+          GST_M3U8_MEDIA_FILE (file->parts->pdata[i])->sequence =
+              file->sequence;
+      }
+
       duration += file->duration;
       if (file->sequence > self->highest_sequence_number) {
         if (self->highest_sequence_number >= 0) {
@@ -835,6 +1344,14 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
         self->highest_sequence_number = file->sequence;
       }
     }
+    if (self->partial_file) {
+      guint i;
+
+      self->partial_file->sequence = mediasequence + 1;
+      for (i = 0; i < self->partial_file->parts->len; i++)
+        GST_M3U8_MEDIA_FILE (self->partial_file->parts->pdata[i])->sequence =
+            self->partial_file->sequence;
+    }
     if (GST_M3U8_IS_LIVE (self)) {
       self->first_file_start = self->last_file_end - duration;
       GST_DEBUG ("Live playlist range %" GST_TIME_FORMAT " -> %"
@@ -844,8 +1361,9 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
     self->duration = duration;
   }
 
-  /* first-time setup */
-  if (self->files && self->sequence == -1) {
+  /* first-time setup, Low-Latency live playlists start on a part */
+  if (self->files && self->sequence == -1
+      && !(GST_M3U8_IS_LIVE (self) && m3u8_select_live_start_part (self))) {
     GList *file;
 
     if (GST_M3U8_IS_LIVE (self)) {
@@ -889,32 +1407,76 @@ gst_m3u8_update (GstM3U8 * self, gchar * data)
 static GList *
 m3u8_find_next_fragment (GstM3U8 * m3u8, gboolean forward)
 {
-  GstM3U8MediaFile *file;
-  GList *l = m3u8->files;
+  GArray *index = m3u8->file_index;
+  guint i;
+
+  if (index == NULL)
+    return NULL;
 
   if (forward) {
-    while (l) {
-      file = l->data;
+    i = m3u8_file_index_lower_bound (index, m3u8->sequence);
+    if (i == index->len)
+      return NULL;
+  } else {
+    i = m3u8_file_index_lower_bound (index, m3u8->sequence + 1);
+    if (i == 0)
+      return NULL;
+    i--;
+  }
+
+  return g_array_index (index, GstM3U8FileIndexEntry, i).link;
+}
+
+/* Returns the part to play next, not reffed, or NULL if it is not
+ * published yet.
+ * call with M3U8_LOCK held */
+static GstM3U8MediaFile *
+m3u8_get_next_part (GstM3U8 * m3u8, gboolean * discont)
+{
+  GstM3U8MediaFile *segment;
+
+  *discont = FALSE;
+
+  while (TRUE) {
+    segment = m3u8_find_segment (m3u8, m3u8->sequence);
 
-      if (file->sequence >= m3u8->sequence)
-        break;
+    if (segment == NULL) {
+      GstM3U8MediaFile *first = m3u8->files ? m3u8->files->data : NULL;
 
-      l = l->next;
+      if (first == NULL || m3u8->sequence >= first->sequence
+          || !m3u8_select_live_start_part (m3u8))
+        return NULL;
+
+      GST_WARNING ("Fell behind the live playlist, resyncing");
+      *discont = TRUE;
+      continue;
     }
-  } else {
-    l = g_list_last (l);
 
-    while (l) {
-      file = l->data;
+    if (segment->parts && (guint) m3u8->part < segment->parts->len) {
+      GstM3U8MediaFile *part = g_ptr_array_index (segment->parts, m3u8->part);
 
-      if (file->sequence <= m3u8->sequence)
-        break;
+      *discont |= part->discont;
+      return part;
+    }
 
-      l = l->prev;
+    /* Parts are only listed for the last few segments, play the whole
+     * segment if it was not started yet */
+    if (segment->parts == NULL && m3u8->part == 0) {
+      *discont |= segment->discont;
+      return segment;
     }
-  }
 
-  return l;
+    /* The next part of the segment in progress is not published yet */
+    if (segment == m3u8->partial_file)
+      return NULL;
+
+    /* Skip the rest of the segment if its parts are gone already */
+    if (segment->parts == NULL)
+      *discont = TRUE;
+
+    m3u8->sequence++;
+    m3u8->part = 0;
+  }
 }
 
 GstM3U8MediaFile *
@@ -932,6 +1494,30 @@ gst_m3u8_get_next_fragment (GstM3U8 * m3u8, gboolean forward,
   if (m3u8->sequence < 0)       /* can't happen really */
     goto out;
 
+  /* Parts are only played forward */
+  if (m3u8->part >= 0 && !forward)
+    m3u8->part = -1;
+
+  if (m3u8->part >= 0) {
+    gboolean part_discont;
+
+    file = m3u8_get_next_part (m3u8, &part_discont);
+    if (file == NULL)
+      goto out;
+
+    file = gst_m3u8_media_file_ref (file);
+    GST_DEBUG ("Got part %d of sequence %u", m3u8->part,
+        (guint) m3u8->sequence);
+
+    if (sequence_position)
+      *sequence_position = m3u8->sequence_position;
+    if (discont)
+      *discont = part_discont;
+
+    m3u8->current_file_duration = file->duration;
+    goto out;
+  }
+
   if (m3u8->current_file == NULL)
     m3u8->current_file = m3u8_find_next_fragment (m3u8, forward);
 
@@ -971,6 +1557,23 @@ gst_m3u8_has_next_fragment (GstM3U8 * m3u8, gboolean forward)
   GST_DEBUG ("Checking next fragment %" G_GINT64_FORMAT,
       m3u8->sequence + (forward ? 1 : -1));
 
+  if (m3u8->part >= 0 && forward) {
+    GstM3U8MediaFile *segment = m3u8_find_segment (m3u8, m3u8->sequence);
+
+    if (segment == NULL)
+      have_next = FALSE;
+    else if (segment->parts && (guint) m3u8->part + 1 < segment->parts->len)
+      have_next = TRUE;
+    else if (segment == m3u8->partial_file)
+      have_next = FALSE;
+    else
+      have_next = m3u8_find_segment (m3u8, m3u8->sequence + 1) != NULL;
+
+    GST_M3U8_UNLOCK (m3u8);
+
+    return have_next;
+  }
+
   if (m3u8->current_file) {
     cur = m3u8->current_file;
   } else {
@@ -990,7 +1593,6 @@ m3u8_alternate_advance (GstM3U8 * m3u8, gboolean forward)
 {
   gint targetnum = m3u8->sequence;
   GList *tmp;
-  GstM3U8MediaFile *mf;
 
   /* figure out the target seqnum */
   if (forward)
@@ -998,11 +1600,7 @@ m3u8_alternate_advance (GstM3U8 * m3u8, gboolean forward)
   else
     targetnum -= 1;
 
-  for (tmp = m3u8->files; tmp; tmp = tmp->next) {
-    mf = (GstM3U8MediaFile *) tmp->data;
-    if (mf->sequence == targetnum)
-      break;
-  }
+  tmp = m3u8_file_index_lookup (m3u8->file_index, targetnum);
   if (tmp == NULL) {
     GST_WARNING ("Can't find next fragment");
     return;
@@ -1035,28 +1633,44 @@ gst_m3u8_advance_fragment (GstM3U8 * m3u8, gboolean forward)
     GST_DEBUG ("Sequence position now %" GST_TIME_FORMAT,
         GST_TIME_ARGS (m3u8->sequence_position));
   }
-  if (!m3u8->current_file) {
-    GList *l;
 
-    GST_DEBUG ("Looking for fragment %" G_GINT64_FORMAT, m3u8->sequence);
-    for (l = m3u8->files; l != NULL; l = l->next) {
-      if (GST_M3U8_MEDIA_FILE (l->data)->sequence == m3u8->sequence) {
-        m3u8->current_file = l;
-        break;
-      }
+  if (m3u8->part >= 0 && !forward)
+    m3u8->part = -1;
+
+  if (m3u8->part >= 0) {
+    GstM3U8MediaFile *segment = m3u8_find_segment (m3u8, m3u8->sequence);
+
+    /* More parts can still be added to the segment in progress */
+    if (segment != NULL && segment != m3u8->partial_file &&
+        (segment->parts == NULL
+            || (guint) m3u8->part + 1 >= segment->parts->len)) {
+      m3u8->sequence++;
+      m3u8->part = 0;
+    } else {
+      m3u8->part++;
     }
+    GST_DEBUG ("Advanced to sequence %u part %d", (guint) m3u8->sequence,
+        m3u8->part);
+    goto out;
+  }
+
+  if (!m3u8->current_file) {
+    GST_DEBUG ("Looking for fragment %" G_GINT64_FORMAT, m3u8->sequence);
+    m3u8->current_file =
+        m3u8_file_index_lookup (m3u8->file_index, m3u8->sequence);
     if (m3u8->current_file == NULL) {
       GST_DEBUG
           ("Could not find current fragment, trying next fragment directly");
       m3u8_alternate_advance (m3u8, forward);
 
       /* Resync sequence number if the above has failed for live streams */
-      if (m3u8->current_file == NULL && GST_M3U8_IS_LIVE (m3u8)) {
+      if (m3u8->current_file == NULL && GST_M3U8_IS_LIVE (m3u8)
+          && m3u8->file_index && m3u8->file_index->len > 0) {
         /* for live streams, start GST_M3U8_LIVE_MIN_FRAGMENT_DISTANCE from
            the end of the playlist. See section 6.3.3 of HLS draft */
-        gint pos =
-            g_list_length (m3u8->files) - GST_M3U8_LIVE_MIN_FRAGMENT_DISTANCE;
-        m3u8->current_file = g_list_nth (m3u8->files, pos >= 0 ? pos : 0);
+        gint pos = m3u8->file_index->len - GST_M3U8_LIVE_MIN_FRAGMENT_DISTANCE;
+        m3u8->current_file = g_array_index (m3u8->file_index,
+            GstM3U8FileIndexEntry, pos >= 0 ? pos : 0).link;
         m3u8->current_file_duration =
             GST_M3U8_MEDIA_FILE (m3u8->current_file->data)->duration;
 
@@ -1224,8 +1838,7 @@ gboolean
 gst_m3u8_get_seek_range (GstM3U8 * m3u8, gint64 * start, gint64 * stop)
 {
   GstClockTime duration = 0;
-  GList *walk;
-  GstM3U8MediaFile *file;
+  GstM3U8FileIndexEntry *last;
   guint count;
   guint min_distance = 0;
 
@@ -1233,7 +1846,7 @@ gst_m3u8_get_seek_range (GstM3U8 * m3u8, gint64 * start, gint64 * stop)
 
   GST_M3U8_LOCK (m3u8);
 
-  if (m3u8->files == NULL)
+  if (m3u8->files == NULL || m3u8->file_index == NULL)
     goto out;
 
   if (GST_M3U8_IS_LIVE (m3u8)) {
@@ -1242,12 +1855,18 @@ gst_m3u8_get_seek_range (GstM3U8 * m3u8, gint64 * start, gint64 * stop)
        playlist - see 6.3.3. "Playing the Playlist file" of the HLS draft */
     min_distance = GST_M3U8_LIVE_MIN_FRAGMENT_DISTANCE;
   }
-  count = g_list_length (m3u8->files);
+  count = m3u8->file_index->len;
 
-  for (walk = m3u8->files; walk && count > min_distance; walk = walk->next) {
-    file = walk->data;
-    --count;
-    duration += file->duration;
+  /* Up to the start of the file min_distance from the end */
+  if (count > min_distance) {
+    if (min_distance > 0) {
+      duration = g_array_index (m3u8->file_index, GstM3U8FileIndexEntry,
+          count - min_distance).start;
+    } else {
+      last = &g_array_index (m3u8->file_index, GstM3U8FileIndexEntry,
+          count - 1);
+      duration = last->start + GST_M3U8_MEDIA_FILE (last->link->data)->duration;
+    }
   }
 
   if (duration <= 0)
@@ -1262,6 +1881,132 @@ out:
   return (duration > 0);
 }
 
+/* Returns the link of the file that plays at @position, counted from the
+ * start of the first file of the playlist, or NULL if that is after the
+ * last file. @file_start is set to where that file (or the end of the
+ * playlist) starts. */
+GList *
+gst_m3u8_find_file_at_position (GstM3U8 * m3u8, GstClockTime position,
+    GstClockTime * file_start)
+{
+  GstM3U8FileIndexEntry *entry;
+  GstClockTime end;
+  GList *link = NULL;
+  guint lo = 0, hi;
+
+  g_return_val_if_fail (m3u8 != NULL, NULL);
+
+  GST_M3U8_LOCK (m3u8);
+
+  if (m3u8->file_index == NULL || m3u8->file_index->len == 0) {
+    if (file_start)
+      *file_start = 0;
+    goto out;
+  }
+
+  /* Last file starting at or before position */
+  hi = m3u8->file_index->len;
+  while (hi - lo > 1) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (g_array_index (m3u8->file_index, GstM3U8FileIndexEntry,
+            mid).start <= position)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  entry = &g_array_index (m3u8->file_index, GstM3U8FileIndexEntry, lo);
+  end = entry->start + GST_M3U8_MEDIA_FILE (entry->link->data)->duration;
+  if (position < end) {
+    link = entry->link;
+    if (file_start)
+      *file_start = entry->start;
+  } else if (file_start) {
+    *file_start = end;
+  }
+
+out:
+  GST_M3U8_UNLOCK (m3u8);
+
+  return link;
+}
+
+GstClockTime
+gst_m3u8_get_part_target (GstM3U8 * m3u8)
+{
+  GstClockTime part_target;
+
+  g_return_val_if_fail (m3u8 != NULL, GST_CLOCK_TIME_NONE);
+
+  GST_M3U8_LOCK (m3u8);
+  part_target = m3u8->part_target;
+  GST_M3U8_UNLOCK (m3u8);
+
+  return part_target;
+}
+
+/* Returns the URI asking the server to hold the playlist back until it
+ * lists the part (or segment) after the last one it has now, or NULL if
+ * the server can't block playlist reloads */
+gchar *
+gst_m3u8_get_blocking_reload_uri (GstM3U8 * m3u8)
+{
+  gchar *uri = NULL;
+  gchar sep;
+  gint64 msn;
+  gint part = -1;
+
+  g_return_val_if_fail (m3u8 != NULL, NULL);
+
+  GST_M3U8_LOCK (m3u8);
+
+  if (!m3u8->can_block_reload || !GST_M3U8_IS_LIVE (m3u8)
+      || m3u8->files == NULL || m3u8->uri == NULL)
+    goto out;
+
+  if (m3u8->partial_file) {
+    msn = m3u8->partial_file->sequence;
+    part = m3u8->partial_file->parts->len;
+  } else {
+    GList *last = g_array_index (m3u8->file_index, GstM3U8FileIndexEntry,
+        m3u8->file_index->len - 1).link;
+
+    msn = GST_M3U8_MEDIA_FILE (last->data)->sequence + 1;
+    if (GST_CLOCK_TIME_IS_VALID (m3u8->part_target))
+      part = 0;
+  }
+
+  sep = strchr (m3u8->uri, '?') ? '&' : '?';
+  if (part >= 0) {
+    uri = g_strdup_printf ("%s%c_HLS_msn=%" G_GINT64_FORMAT "&_HLS_part=%d",
+        m3u8->uri, sep, msn, part);
+  } else {
+    uri = g_strdup_printf ("%s%c_HLS_msn=%" G_GINT64_FORMAT, m3u8->uri, sep,
+        msn);
+  }
+
+out:
+  GST_M3U8_UNLOCK (m3u8);
+
+  return uri;
+}
+
+GstM3U8MediaFile *
+gst_m3u8_get_preload_hint (GstM3U8 * m3u8)
+{
+  GstM3U8MediaFile *hint = NULL;
+
+  g_return_val_if_fail (m3u8 != NULL, NULL);
+
+  GST_M3U8_LOCK (m3u8);
+  if (m3u8->preload_hint && GST_M3U8_IS_LIVE (m3u8))
+    hint = gst_m3u8_media_file_ref (m3u8->preload_hint);
+  GST_M3U8_UNLOCK (m3u8);
+
+  return hint;
+}
+
 GstHLSMedia *
 gst_hls_media_ref (GstHLSMedia * media)
 {
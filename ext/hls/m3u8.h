@@ -65,11 +65,21 @@ struct _GstM3U8
   gboolean allowcache;          /* last EXT-X-ALLOWCACHE */
 
   GList *files;
+  GArray *file_index;           /* GstM3U8FileIndexEntry, one per files entry */
+
+  /* Low-Latency HLS */
+  gboolean can_block_reload;    /* EXT-X-SERVER-CONTROL CAN-BLOCK-RELOAD */
+  GstClockTime part_hold_back;  /* EXT-X-SERVER-CONTROL PART-HOLD-BACK */
+  GstClockTime part_target;     /* EXT-X-PART-INF PART-TARGET */
+  GstM3U8MediaFile *partial_file; /* parts of the segment after the last one */
+  GstM3U8MediaFile *preload_hint; /* EXT-X-PRELOAD-HINT of TYPE=PART */
 
   /* state */
   GList *current_file;
   GstClockTime current_file_duration; /* Duration of current fragment */
   gint64 sequence;                    /* the next sequence for this client */
+  gint part;                          /* the next part of that sequence, -1 if
+                                       * whole segments are played */
   GstClockTime sequence_position;     /* position of this sequence */
   gint64 highest_sequence_number;     /* largest seen sequence number */
   GstClockTime first_file_start;      /* timecode of the start of the first fragment in the current media playlist */
@@ -79,11 +89,24 @@ struct _GstM3U8
 
   /*< private > */
   gchar *last_data;
+  gchar *files_base_uri;        /* base the URIs of files were resolved with */
   GMutex lock;
 
   gint ref_count;               /* ATOMIC */
 };
 
+/* Indexed access to the files of a playlist, in sequence order */
+typedef struct
+{
+  GList *link;
+  GstClockTime start;           /* offset from the start of the first file */
+
+  /*< private > */
+  gsize line;                   /* offset of the URI line in last_data */
+  gsize line_end;               /* offset of the end of that line */
+  gboolean have_iv;             /* an EXT-X-KEY IV applied to the file */
+} GstM3U8FileIndexEntry;
+
 GstM3U8 *          gst_m3u8_ref   (GstM3U8 * m3u8);
 
 void               gst_m3u8_unref (GstM3U8 * m3u8);
@@ -101,6 +124,8 @@ struct _GstM3U8MediaFile
   gint64 offset, size;
   gint ref_count;               /* ATOMIC */
   GstM3U8InitFile *init_file;   /* Media Initialization (hold ref) */
+  GPtrArray *parts;             /* EXT-X-PART entries, GstM3U8MediaFile */
+  gboolean independent;         /* part starts with an independent frame */
 };
 
 struct _GstM3U8InitFile
@@ -147,6 +172,16 @@ gboolean           gst_m3u8_get_seek_range       (GstM3U8 * m3u8,
                                                   gint64  * start,
                                                   gint64  * stop);
 
+GList *            gst_m3u8_find_file_at_position (GstM3U8      * m3u8,
+                                                   GstClockTime   position,
+                                                   GstClockTime * file_start);
+
+GstClockTime       gst_m3u8_get_part_target      (GstM3U8 * m3u8);
+
+gchar *            gst_m3u8_get_blocking_reload_uri (GstM3U8 * m3u8);
+
+GstM3U8MediaFile * gst_m3u8_get_preload_hint     (GstM3U8 * m3u8);
+
 typedef enum
 {
   GST_HLS_MEDIA_TYPE_INVALID = -1,
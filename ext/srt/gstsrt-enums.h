@@ -62,6 +62,23 @@ typedef enum
   GST_SRT_KEY_LENGTH_32 = 32,
 } GstSRTKeyLength;
 
+/**
+ * GstSRTQueueOverflow:
+ * @GST_SRT_QUEUE_OVERFLOW_DROP_CALLER: disconnect the caller
+ * @GST_SRT_QUEUE_OVERFLOW_SKIP_OLDEST: skip the oldest queued buffers
+ * @GST_SRT_QUEUE_OVERFLOW_SKIP_NEWEST: skip the incoming buffer
+ *
+ * What to do when a caller's send queue is full
+ *
+ * Since: 1.20
+ */
+typedef enum
+{
+  GST_SRT_QUEUE_OVERFLOW_DROP_CALLER,
+  GST_SRT_QUEUE_OVERFLOW_SKIP_OLDEST,
+  GST_SRT_QUEUE_OVERFLOW_SKIP_NEWEST,
+} GstSRTQueueOverflow;
+
 G_END_DECLS
 
 #endif // __GST_SRT_ENUM_H__
@@ -71,15 +71,35 @@ enum
   PROP_WAIT_FOR_CONNECTION,
   PROP_STREAMID,
   PROP_AUTHENTICATION,
+  PROP_SEND_QUEUE_SIZE,
+  PROP_SEND_QUEUE_OVERFLOW,
   PROP_LAST
 };
 
+G_STATIC_ASSERT (PROP_LAST <= GST_SRT_OBJECT_PROP_LAST);
+
+/* How long the sender thread waits for writable sockets before
+ * rechecking its state */
+#define SENDER_POLL_TIMEOUT_MS 100
+#define SENDER_MAX_EVENTS 64
+
 typedef struct
 {
   SRTSOCKET sock;
   gint poll_id;
   GSocketAddress *sockaddr;
   gboolean sent_headers;
+
+  /* Listener sink only: buffers waiting to be sent to this caller. The
+   * buffers are shared between all callers. */
+  GQueue queue;
+  GstBuffer *head;              /* buffer being sent */
+  GstMapInfo head_map;
+  gsize head_offset;
+  gsize queued_bytes;
+  gboolean pending;             /* registered for SRT_EPOLL_OUT */
+  gint payload_size;
+  guint64 buffers_skipped;
 } SRTCaller;
 
 static GstStructure *gst_srt_object_accumulate_stats (GstSRTObject * srtobject,
@@ -92,6 +112,8 @@ srt_caller_new (void)
   caller->sock = SRT_INVALID_SOCK;
   caller->poll_id = SRT_ERROR;
   caller->sent_headers = FALSE;
+  caller->payload_size = GST_SRT_DEFAULT_MSG_SIZE;
+  g_queue_init (&caller->queue);
 
   return caller;
 }
@@ -99,10 +121,19 @@ srt_caller_new (void)
 static void
 srt_caller_free (SRTCaller * caller)
 {
+  GstBuffer *buffer;
+
   g_return_if_fail (caller != NULL);
 
   g_clear_object (&caller->sockaddr);
 
+  if (caller->head) {
+    gst_buffer_unmap (caller->head, &caller->head_map);
+    gst_buffer_unref (caller->head);
+  }
+  while ((buffer = g_queue_pop_head (&caller->queue)))
+    gst_buffer_unref (buffer);
+
   if (caller->sock != SRT_INVALID_SOCK) {
     srt_close (caller->sock);
   }
@@ -130,6 +161,23 @@ srt_caller_signal_removed (SRTCaller * caller, GstSRTObject * srtobject)
       caller->sockaddr);
 }
 
+/* called with sock_lock */
+static void
+gst_srt_object_remove_caller (GstSRTObject * srtobject, SRTCaller * caller)
+{
+  srtobject->callers = g_list_remove (srtobject->callers, caller);
+  g_hash_table_remove (srtobject->callers_by_sock,
+      GINT_TO_POINTER (caller->sock));
+
+  if (caller->pending)
+    srtobject->pending_callers--;
+  if (srtobject->sender_poll_id != SRT_ERROR)
+    srt_epoll_remove_usock (srtobject->sender_poll_id, caller->sock);
+
+  srt_caller_signal_removed (caller, srtobject);
+  srt_caller_free (caller);
+}
+
 struct srt_constant_params
 {
   const gchar *name;
@@ -361,13 +409,19 @@ gst_srt_object_new (GstElement * element)
   srtobject->element = element;
   srtobject->parameters = gst_structure_new_empty ("application/x-srt-params");
   srtobject->sock = SRT_INVALID_SOCK;
+  srtobject->read_sock = SRT_INVALID_SOCK;
   srtobject->poll_id = srt_epoll_create ();
   srtobject->listener_sock = SRT_INVALID_SOCK;
   srtobject->listener_poll_id = SRT_ERROR;
   srtobject->sent_headers = FALSE;
   srtobject->wait_for_connection = GST_SRT_DEFAULT_WAIT_FOR_CONNECTION;
+  srtobject->callers_by_sock = g_hash_table_new (NULL, NULL);
+  srtobject->sender_poll_id = SRT_ERROR;
+  srtobject->send_queue_size = GST_SRT_DEFAULT_SEND_QUEUE_SIZE;
+  srtobject->send_queue_overflow = GST_SRT_DEFAULT_SEND_QUEUE_OVERFLOW;
 
   g_cond_init (&srtobject->sock_cond);
+  g_cond_init (&srtobject->sender_cond);
   return srtobject;
 }
 
@@ -382,6 +436,8 @@ gst_srt_object_destroy (GstSRTObject * srtobject)
   }
 
   g_cond_clear (&srtobject->sock_cond);
+  g_cond_clear (&srtobject->sender_cond);
+  g_hash_table_unref (srtobject->callers_by_sock);
 
   GST_DEBUG_OBJECT (srtobject->element, "Destroying srtobject");
   gst_structure_free (srtobject->parameters);
@@ -437,6 +493,12 @@ gst_srt_object_set_property_helper (GstSRTObject * srtobject,
     case PROP_AUTHENTICATION:
       srtobject->authentication = g_value_get_boolean (value);
       break;
+    case PROP_SEND_QUEUE_SIZE:
+      srtobject->send_queue_size = g_value_get_uint (value);
+      break;
+    case PROP_SEND_QUEUE_OVERFLOW:
+      srtobject->send_queue_overflow = g_value_get_enum (value);
+      break;
     default:
       goto err;
   }
@@ -544,6 +606,16 @@ gst_srt_object_get_property_helper (GstSRTObject * srtobject,
     case PROP_AUTHENTICATION:
       g_value_set_boolean (value, srtobject->authentication);
       break;
+    case PROP_SEND_QUEUE_SIZE:
+      GST_OBJECT_LOCK (srtobject->element);
+      g_value_set_uint (value, srtobject->send_queue_size);
+      GST_OBJECT_UNLOCK (srtobject->element);
+      break;
+    case PROP_SEND_QUEUE_OVERFLOW:
+      GST_OBJECT_LOCK (srtobject->element);
+      g_value_set_enum (value, srtobject->send_queue_overflow);
+      GST_OBJECT_UNLOCK (srtobject->element);
+      break;
     default:
       return FALSE;
   }
@@ -704,6 +776,36 @@ gst_srt_object_install_properties_helper (GObjectClass * gobject_class)
           "Authentication",
           "Authenticate a connection",
           FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstSRTSink:send-queue-size:
+   *
+   * In listener mode, the amount of data that can wait to be sent to a
+   * caller before #GstSRTSink:send-queue-overflow applies. Queued buffers
+   * are shared between callers, so this bounds the memory used for the
+   * slowest one.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_SEND_QUEUE_SIZE,
+      g_param_spec_uint ("send-queue-size", "Send queue size",
+          "Maximum bytes queued per caller in listener mode (0 = unlimited)",
+          0, G_MAXUINT, GST_SRT_DEFAULT_SEND_QUEUE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstSRTSink:send-queue-overflow:
+   *
+   * What to do when a caller doesn't keep up and its send queue is full.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_SEND_QUEUE_OVERFLOW,
+      g_param_spec_enum ("send-queue-overflow", "Send queue overflow",
+          "Policy applied when a caller's send queue is full",
+          GST_TYPE_SRT_QUEUE_OVERFLOW, GST_SRT_DEFAULT_SEND_QUEUE_OVERFLOW,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  gst_type_mark_as_plugin_api (GST_TYPE_SRT_QUEUE_OVERFLOW, 0);
 }
 
 static void
@@ -908,6 +1010,178 @@ gst_srt_object_set_uri (GstSRTObject * srtobject, const gchar * uri,
   return TRUE;
 }
 
+/* called with sock_lock */
+static void
+srt_caller_set_pending (GstSRTObject * srtobject, SRTCaller * caller,
+    gboolean pending)
+{
+  gint flag = SRT_EPOLL_ERR;
+
+  if (caller->pending == pending)
+    return;
+
+  if (pending)
+    flag |= SRT_EPOLL_OUT;
+
+  if (srt_epoll_update_usock (srtobject->sender_poll_id, caller->sock, &flag)) {
+    GST_WARNING_OBJECT (srtobject->element, "%s", srt_getlasterror_str ());
+  }
+
+  caller->pending = pending;
+  if (pending) {
+    srtobject->pending_callers++;
+    g_cond_signal (&srtobject->sender_cond);
+  } else {
+    srtobject->pending_callers--;
+  }
+}
+
+/* called with sock_lock. Returns FALSE if the caller has to be dropped */
+static gboolean
+srt_caller_queue_buffer (GstSRTObject * srtobject, SRTCaller * caller,
+    GstBuffer * buffer, gsize max_bytes, GstSRTQueueOverflow overflow)
+{
+  gsize size = gst_buffer_get_size (buffer);
+
+  if (max_bytes && caller->queued_bytes + size > max_bytes) {
+    switch (overflow) {
+      case GST_SRT_QUEUE_OVERFLOW_DROP_CALLER:
+        GST_WARNING_OBJECT (srtobject->element,
+            "Send queue of caller %d is full (%" G_GSIZE_FORMAT " bytes)",
+            caller->sock, caller->queued_bytes);
+        return FALSE;
+      case GST_SRT_QUEUE_OVERFLOW_SKIP_NEWEST:
+        caller->buffers_skipped++;
+        return TRUE;
+      case GST_SRT_QUEUE_OVERFLOW_SKIP_OLDEST:
+        /* The buffer being sent is never cut short */
+        while (caller->queued_bytes + size > max_bytes &&
+            !g_queue_is_empty (&caller->queue)) {
+          GstBuffer *old = g_queue_pop_head (&caller->queue);
+
+          caller->queued_bytes -= gst_buffer_get_size (old);
+          caller->buffers_skipped++;
+          gst_buffer_unref (old);
+        }
+        break;
+    }
+    GST_LOG_OBJECT (srtobject->element, "Caller %d skipped %" G_GUINT64_FORMAT
+        " buffers so far", caller->sock, caller->buffers_skipped);
+  }
+
+  g_queue_push_tail (&caller->queue, gst_buffer_ref (buffer));
+  caller->queued_bytes += size;
+  srt_caller_set_pending (srtobject, caller, TRUE);
+
+  return TRUE;
+}
+
+/* called with sock_lock. Sends whatever the socket accepts without
+ * blocking. Returns FALSE if the caller has to be dropped */
+static gboolean
+srt_caller_send_queued (GstSRTObject * srtobject, SRTCaller * caller)
+{
+  for (;;) {
+    if (caller->head == NULL) {
+      caller->head = g_queue_pop_head (&caller->queue);
+      if (caller->head == NULL)
+        break;
+
+      if (!gst_buffer_map (caller->head, &caller->head_map, GST_MAP_READ)) {
+        GST_ELEMENT_ERROR (srtobject->element, RESOURCE, READ,
+            ("Could not map the input stream"), (NULL));
+        caller->queued_bytes -= gst_buffer_get_size (caller->head);
+        gst_buffer_unref (caller->head);
+        caller->head = NULL;
+        continue;
+      }
+      caller->head_offset = 0;
+    }
+
+    while (caller->head_offset < caller->head_map.size) {
+      gint rest = MIN (caller->head_map.size - caller->head_offset,
+          caller->payload_size);
+      gint sent;
+
+      sent = srt_sendmsg2 (caller->sock,
+          (char *) (caller->head_map.data + caller->head_offset), rest, 0);
+      if (sent < 0) {
+        if (srt_getlasterror (NULL) == SRT_EASYNCSND)
+          return TRUE;
+
+        GST_WARNING_OBJECT (srtobject->element, "Dropping caller %d: %s",
+            caller->sock, srt_getlasterror_str ());
+        return FALSE;
+      }
+      caller->head_offset += sent;
+      caller->queued_bytes -= sent;
+    }
+
+    gst_buffer_unmap (caller->head, &caller->head_map);
+    gst_buffer_unref (caller->head);
+    caller->head = NULL;
+  }
+
+  srt_caller_set_pending (srtobject, caller, FALSE);
+
+  return TRUE;
+}
+
+static gpointer
+sender_thread_func (gpointer data)
+{
+  GstSRTObject *srtobject = data;
+  SRTSOCKET rsocks[SENDER_MAX_EVENTS];
+  SRTSOCKET wsocks[SENDER_MAX_EVENTS];
+
+  g_mutex_lock (&srtobject->sock_lock);
+
+  for (;;) {
+    gint rsocklen = SENDER_MAX_EVENTS;
+    gint wsocklen = SENDER_MAX_EVENTS;
+    gint i;
+
+    while (!srtobject->sender_stop && srtobject->pending_callers == 0)
+      g_cond_wait (&srtobject->sender_cond, &srtobject->sock_lock);
+
+    if (srtobject->sender_stop)
+      break;
+
+    g_mutex_unlock (&srtobject->sock_lock);
+
+    if (srt_epoll_wait (srtobject->sender_poll_id, rsocks, &rsocklen, wsocks,
+            &wsocklen, SENDER_POLL_TIMEOUT_MS, NULL, 0, NULL, 0) < 0) {
+      rsocklen = wsocklen = 0;
+    }
+
+    g_mutex_lock (&srtobject->sock_lock);
+
+    /* Only errors are reported as readable */
+    for (i = 0; i < rsocklen; i++) {
+      SRTCaller *caller = g_hash_table_lookup (srtobject->callers_by_sock,
+          GINT_TO_POINTER (rsocks[i]));
+
+      if (caller && srt_getsockstate (caller->sock) > SRTS_CONNECTED) {
+        GST_WARNING_OBJECT (srtobject->element, "Caller %d went away",
+            caller->sock);
+        gst_srt_object_remove_caller (srtobject, caller);
+      }
+    }
+
+    for (i = 0; i < wsocklen; i++) {
+      SRTCaller *caller = g_hash_table_lookup (srtobject->callers_by_sock,
+          GINT_TO_POINTER (wsocks[i]));
+
+      if (caller && !srt_caller_send_queued (srtobject, caller))
+        gst_srt_object_remove_caller (srtobject, caller);
+    }
+  }
+
+  g_mutex_unlock (&srtobject->sock_lock);
+
+  return NULL;
+}
+
 static gpointer
 thread_func (gpointer data)
 {
@@ -956,21 +1230,31 @@ thread_func (gpointer data)
     if (caller_sock != SRT_INVALID_SOCK) {
       SRTCaller *caller;
       gint flag = SRT_EPOLL_ERR;
+      gint poll_id;
 
       caller = srt_caller_new ();
       caller->sockaddr =
           g_socket_address_new_from_native (&caller_sa.sa, caller_sa_len);
-      caller->poll_id = srt_epoll_create ();
       caller->sock = caller_sock;
 
       if (gst_uri_handler_get_uri_type (GST_URI_HANDLER
               (srtobject->element)) == GST_URI_SRC) {
+        caller->poll_id = srt_epoll_create ();
+        poll_id = caller->poll_id;
         flag |= SRT_EPOLL_IN;
       } else {
-        flag |= SRT_EPOLL_OUT;
+        gint optlen = sizeof (caller->payload_size);
+
+        /* Only watched for writability once something is queued */
+        poll_id = srtobject->sender_poll_id;
+        if (srt_getsockflag (caller_sock, SRTO_PAYLOADSIZE,
+                &caller->payload_size, &optlen)) {
+          GST_WARNING_OBJECT (srtobject->element, "%s",
+              srt_getlasterror_str ());
+        }
       }
 
-      if (srt_epoll_add_usock (caller->poll_id, caller_sock, &flag)) {
+      if (srt_epoll_add_usock (poll_id, caller_sock, &flag)) {
 
         GST_ELEMENT_ERROR (srtobject->element, RESOURCE, SETTINGS,
             ("%s", srt_getlasterror_str ()), (NULL));
@@ -986,6 +1270,8 @@ thread_func (gpointer data)
 
       g_mutex_lock (&srtobject->sock_lock);
       srtobject->callers = g_list_append (srtobject->callers, caller);
+      g_hash_table_insert (srtobject->callers_by_sock,
+          GINT_TO_POINTER (caller->sock), caller);
       g_cond_signal (&srtobject->sock_cond);
       g_mutex_unlock (&srtobject->sock_lock);
 
@@ -1140,6 +1426,18 @@ gst_srt_object_wait_connect (GstSRTObject * srtobject,
     goto failed;
   }
 
+  if (gst_uri_handler_get_uri_type (GST_URI_HANDLER (srtobject->element)) ==
+      GST_URI_SINK) {
+    srtobject->sender_poll_id = srt_epoll_create ();
+    srtobject->sender_stop = FALSE;
+    srtobject->sender_thread = g_thread_try_new ("GstSRTObjectSender",
+        sender_thread_func, srtobject, error);
+    if (srtobject->sender_thread == NULL) {
+      GST_ERROR_OBJECT (srtobject->element, "Failed to start sender thread");
+      goto failed;
+    }
+  }
+
   srtobject->thread =
       g_thread_try_new ("GstSRTObjectListener", thread_func, srtobject, error);
   if (srtobject->thread == NULL) {
@@ -1159,6 +1457,21 @@ failed:
     srt_close (sock);
   }
 
+  if (srtobject->sender_thread) {
+    GThread *thread = g_steal_pointer (&srtobject->sender_thread);
+
+    g_mutex_lock (&srtobject->sock_lock);
+    srtobject->sender_stop = TRUE;
+    g_cond_signal (&srtobject->sender_cond);
+    g_mutex_unlock (&srtobject->sock_lock);
+    g_thread_join (thread);
+  }
+
+  if (srtobject->sender_poll_id != SRT_ERROR) {
+    srt_epoll_release (srtobject->sender_poll_id);
+    srtobject->sender_poll_id = SRT_ERROR;
+  }
+
   g_clear_object (&bind_addr);
 
   srtobject->listener_poll_id = SRT_ERROR;
@@ -1413,6 +1726,8 @@ gst_srt_object_close (GstSRTObject * srtobject)
     srtobject->sock = SRT_INVALID_SOCK;
   }
 
+  srtobject->read_sock = SRT_INVALID_SOCK;
+
   if (srtobject->listener_poll_id != SRT_ERROR) {
     if (srtobject->listener_sock != SRT_INVALID_SOCK) {
       srt_epoll_remove_usock (srtobject->listener_poll_id,
@@ -1429,6 +1744,15 @@ gst_srt_object_close (GstSRTObject * srtobject)
     g_mutex_lock (&srtobject->sock_lock);
   }
 
+  if (srtobject->sender_thread) {
+    GThread *thread = g_steal_pointer (&srtobject->sender_thread);
+    srtobject->sender_stop = TRUE;
+    g_cond_signal (&srtobject->sender_cond);
+    g_mutex_unlock (&srtobject->sock_lock);
+    g_thread_join (thread);
+    g_mutex_lock (&srtobject->sock_lock);
+  }
+
   if (srtobject->listener_sock != SRT_INVALID_SOCK) {
     GST_DEBUG_OBJECT (srtobject->element, "Closing SRT listener socket (0x%x)",
         srtobject->listener_sock);
@@ -1439,9 +1763,16 @@ gst_srt_object_close (GstSRTObject * srtobject)
 
   if (srtobject->callers) {
     GList *callers = g_steal_pointer (&srtobject->callers);
+    g_hash_table_remove_all (srtobject->callers_by_sock);
     g_list_foreach (callers, (GFunc) srt_caller_signal_removed, srtobject);
     g_list_free_full (callers, (GDestroyNotify) srt_caller_free);
   }
+  srtobject->pending_callers = 0;
+
+  if (srtobject->sender_poll_id != SRT_ERROR) {
+    srt_epoll_release (srtobject->sender_poll_id);
+    srtobject->sender_poll_id = SRT_ERROR;
+  }
 
   g_mutex_unlock (&srtobject->sock_lock);
 
@@ -1584,12 +1915,43 @@ gst_srt_object_read (GstSRTObject * srtobject,
         return -1;
       }
     }
+
+    srtobject->read_sock = rsock;
     break;
   }
 
   return len;
 }
 
+/* Receives one more message from the socket the previous
+ * gst_srt_object_read() returned data from, without waiting. Returns 0
+ * if nothing is ready; errors are left for the next blocking read to
+ * report. */
+gssize
+gst_srt_object_read_ready (GstSRTObject * srtobject,
+    guint8 * data, gsize size, SRT_MSGCTRL * mctrl)
+{
+  gssize len;
+
+  if (srtobject->read_sock == SRT_INVALID_SOCK)
+    return 0;
+
+  srt_msgctrl_init (mctrl);
+  len = srt_recvmsg2 (srtobject->read_sock, (char *) (data), size, mctrl);
+
+  if (len == SRT_ERROR) {
+    gint srt_errno = srt_getlasterror (NULL);
+
+    if (srt_errno != SRT_EASYNCRCV) {
+      GST_DEBUG_OBJECT (srtobject->element,
+          "Stopped draining SRT socket: %s", srt_getlasterror_str ());
+    }
+    return 0;
+  }
+
+  return len;
+}
+
 void
 gst_srt_object_wakeup (GstSRTObject * srtobject, GCancellable * cancellable)
 {
@@ -1665,21 +2027,25 @@ gst_srt_object_send_headers (GstSRTObject * srtobject, SRTSOCKET sock,
   return TRUE;
 }
 
+/* Only queues the buffer on each caller, the sender thread does the actual
+ * sending so that a slow caller doesn't hold back the others */
 static gssize
 gst_srt_object_write_to_callers (GstSRTObject * srtobject,
     GstBufferList * headers,
-    const GstMapInfo * mapinfo, GCancellable * cancellable, GError ** error)
+    GstBuffer * buffer, GCancellable * cancellable, GError ** error)
 {
   GList *callers;
+  gsize max_bytes;
+  GstSRTQueueOverflow overflow;
+
+  GST_OBJECT_LOCK (srtobject->element);
+  max_bytes = srtobject->send_queue_size;
+  overflow = srtobject->send_queue_overflow;
+  GST_OBJECT_UNLOCK (srtobject->element);
 
   g_mutex_lock (&srtobject->sock_lock);
   callers = srtobject->callers;
   while (callers != NULL) {
-    gssize len = 0;
-    const guint8 *msg = mapinfo->data;
-    gint sent;
-    gint payload_size, optlen = sizeof (payload_size);
-
     SRTCaller *caller = callers->data;
     callers = callers->next;
 
@@ -1688,40 +2054,24 @@ gst_srt_object_write_to_callers (GstSRTObject * srtobject,
     }
 
     if (!caller->sent_headers) {
-      if (!gst_srt_object_send_headers (srtobject, caller->sock, -1,
-              -1, headers, cancellable)) {
-        goto err;
+      guint i, n = headers ? gst_buffer_list_length (headers) : 0;
+
+      GST_DEBUG_OBJECT (srtobject->element, "Queuing %u stream headers", n);
+      for (i = 0; i < n; i++) {
+        srt_caller_queue_buffer (srtobject, caller,
+            gst_buffer_list_get (headers, i), 0, overflow);
       }
       caller->sent_headers = TRUE;
     }
 
-    if (srt_getsockflag (caller->sock, SRTO_PAYLOADSIZE, &payload_size,
-            &optlen)) {
-      GST_WARNING_OBJECT (srtobject->element, "%s", srt_getlasterror_str ());
-      goto err;
+    if (!srt_caller_queue_buffer (srtobject, caller, buffer, max_bytes,
+            overflow)) {
+      gst_srt_object_remove_caller (srtobject, caller);
     }
-
-    while (len < mapinfo->size) {
-      gint rest = MIN (mapinfo->size - len, payload_size);
-      sent = srt_sendmsg2 (caller->sock, (char *) (msg + len), rest, 0);
-      if (sent < 0) {
-        GST_WARNING_OBJECT (srtobject->element, "Dropping caller %d: %s",
-            caller->sock, srt_getlasterror_str ());
-        goto err;
-      }
-      len += sent;
-    }
-
-    continue;
-
-  err:
-    srtobject->callers = g_list_remove (srtobject->callers, caller);
-    srt_caller_signal_removed (caller, srtobject);
-    srt_caller_free (caller);
   }
 
   g_mutex_unlock (&srtobject->sock_lock);
-  return mapinfo->size;
+  return gst_buffer_get_size (buffer);
 
 cancelled:
   g_mutex_unlock (&srtobject->sock_lock);
@@ -1820,7 +2170,7 @@ gst_srt_object_write_one (GstSRTObject * srtobject,
 gssize
 gst_srt_object_write (GstSRTObject * srtobject,
     GstBufferList * headers,
-    const GstMapInfo * mapinfo, GCancellable * cancellable, GError ** error)
+    GstBuffer * buffer, GCancellable * cancellable, GError ** error)
 {
   gssize len = 0;
   GstSRTConnectionMode connection_mode = GST_SRT_CONNECTION_MODE_NONE;
@@ -1842,12 +2192,22 @@ gst_srt_object_write (GstSRTObject * srtobject,
         return -1;
     }
     len =
-        gst_srt_object_write_to_callers (srtobject, headers, mapinfo,
+        gst_srt_object_write_to_callers (srtobject, headers, buffer,
         cancellable, error);
   } else {
+    GstMapInfo mapinfo;
+
+    if (!gst_buffer_map (buffer, &mapinfo, GST_MAP_READ)) {
+      g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+          "Could not map the input stream");
+      return -1;
+    }
+
     len =
-        gst_srt_object_write_one (srtobject, headers, mapinfo, cancellable,
+        gst_srt_object_write_one (srtobject, headers, &mapinfo, cancellable,
         error);
+
+    gst_buffer_unmap (buffer, &mapinfo);
   }
 
   return len;
@@ -1949,6 +2309,12 @@ gst_srt_object_get_stats (GstSRTObject * srtobject)
       gst_structure_set (tmp, "caller-address", G_TYPE_SOCKET_ADDRESS,
           caller->sockaddr, NULL);
 
+      if (is_sender) {
+        gst_structure_set (tmp,
+            "send-queue-bytes", G_TYPE_UINT64, (guint64) caller->queued_bytes,
+            "buffers-skipped", G_TYPE_UINT64, caller->buffers_skipped, NULL);
+      }
+
       g_value_array_append (callers_stats, NULL);
       v = g_value_array_get_nth (callers_stats, callers_stats->n_values - 1);
       g_value_init (v, GST_TYPE_STRUCTURE);
@@ -42,6 +42,12 @@ G_BEGIN_DECLS
 #define GST_SRT_DEFAULT_LATENCY 125
 #define GST_SRT_DEFAULT_MSG_SIZE 1316
 #define GST_SRT_DEFAULT_WAIT_FOR_CONNECTION (TRUE)
+#define GST_SRT_DEFAULT_SEND_QUEUE_SIZE (4 * 1024 * 1024)
+#define GST_SRT_DEFAULT_SEND_QUEUE_OVERFLOW GST_SRT_QUEUE_OVERFLOW_SKIP_OLDEST
+
+/* Properties installed by gst_srt_object_install_properties_helper() use
+ * ids below this value, elements number their own ones from here */
+#define GST_SRT_OBJECT_PROP_LAST 64
 
 typedef struct _GstSRTObject GstSRTObject;
 
@@ -56,6 +62,9 @@ struct _GstSRTObject
   gint                          poll_id;
   gboolean                      sent_headers;
 
+  /* Socket the last message was read from, for draining */
+  SRTSOCKET                     read_sock;
+
   GTask                        *listener_task;
   SRTSOCKET                     listener_sock;
   gint                          listener_poll_id;
@@ -67,6 +76,18 @@ struct _GstSRTObject
   GCond                         sock_cond;
 
   GList                        *callers;
+  GHashTable                   *callers_by_sock;
+
+  /* Listener sink: thread writing the callers' send queues.
+   * Also protected by sock_lock */
+  GThread                      *sender_thread;
+  gint                          sender_poll_id;
+  GCond                         sender_cond;
+  gboolean                      sender_stop;
+  guint                         pending_callers;
+
+  gsize                         send_queue_size;
+  GstSRTQueueOverflow           send_queue_overflow;
 
   gboolean                     wait_for_connection;
 
@@ -103,9 +124,13 @@ gssize          gst_srt_object_read     (GstSRTObject * srtobject,
                                          GError **err,
 					 SRT_MSGCTRL *mctrl);
 
+gssize          gst_srt_object_read_ready (GstSRTObject * srtobject,
+                                           guint8 *data, gsize size,
+                                           SRT_MSGCTRL *mctrl);
+
 gssize          gst_srt_object_write    (GstSRTObject * srtobject,
                                          GstBufferList * headers,
-                                         const GstMapInfo * mapinfo,
+                                         GstBuffer * buffer,
                                          GCancellable *cancellable,
                                          GError **err);
 
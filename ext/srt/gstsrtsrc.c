@@ -39,6 +39,11 @@
  * gst-launch-1.0 -v srtclientsrc uri="srt://192.168.1.10:7001?mode=rendez-vous" ! fakesink
  * ]| This pipeline shows how to connect SRT server by setting #GstSRTSrc:uri property and using the rendez-vous mode.
  *
+ * |[
+ * gst-launch-1.0 -v srtsrc uri="srt://127.0.0.1:7001" max-batch-messages=64 ! tsparse ! fakesink
+ * ]| This pipeline pushes all messages that are ready after each wakeup as
+ * a single buffer list.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -67,6 +72,18 @@ enum
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
+#define DEFAULT_MAX_BATCH_MESSAGES 1
+#define MAX_BATCH_MESSAGES_MAX 1024
+
+enum
+{
+  PROP_MAX_BATCH_MESSAGES = GST_SRT_OBJECT_PROP_LAST,
+};
+
+/* Caps of the GstReferenceTimestampMeta carrying the sender's SRT source
+ * time in batched mode */
+static GstCaps *srctime_caps;
+
 static void gst_srt_src_uri_handler_init (gpointer g_iface,
     gpointer iface_data);
 static gchar *gst_srt_src_uri_get_uri (GstURIHandler * handler);
@@ -127,6 +144,19 @@ gst_srt_src_start (GstBaseSrc * bsrc)
   /* Reset expected pktseq */
   self->next_pktseq = 0;
 
+  GST_OBJECT_LOCK (self);
+  if (ret && self->max_batch_messages > 1) {
+    GstStructure *config;
+
+    self->pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (self->pool);
+    gst_buffer_pool_config_set_params (config, NULL,
+        gst_base_src_get_blocksize (bsrc), 0, 0);
+    gst_buffer_pool_set_config (self->pool, config);
+    gst_buffer_pool_set_active (self->pool, TRUE);
+  }
+  GST_OBJECT_UNLOCK (self);
+
   return ret;
 }
 
@@ -137,9 +167,66 @@ gst_srt_src_stop (GstBaseSrc * bsrc)
 
   gst_srt_object_close (self->srtobject);
 
+  if (self->pool) {
+    gst_buffer_pool_set_active (self->pool, FALSE);
+    gst_clear_object (&self->pool);
+  }
+
   return TRUE;
 }
 
+static int64_t
+gst_srt_src_get_srt_time (void)
+{
+#if SRT_VERSION_VALUE >= 0x10402
+  /* Use SRT clock value if available (SRT > 1.4.2) */
+  return srt_time_now ();
+#else
+  /* Else use the unix epoch monotonic clock */
+  return g_get_real_time ();
+#endif
+}
+
+/* Flags discontinuities and timestamps @outbuf from the running time
+ * at which the message was received, minus its transmission delay */
+static void
+gst_srt_src_process_message (GstSRTSrc * self, GstBuffer * outbuf,
+    const SRT_MSGCTRL * mctrl, GstClockTime capture_time, int64_t srt_time)
+{
+  GstClockTimeDiff delay;
+
+  /* Detect discontinuities */
+  if (mctrl->pktseq != self->next_pktseq) {
+    GST_WARNING_OBJECT (self, "discont detected %d (expected: %d)",
+        mctrl->pktseq, self->next_pktseq);
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+  }
+  /* pktseq is a 31bit field */
+  self->next_pktseq = (mctrl->pktseq + 1) % G_MAXINT32;
+
+  /* 0 means we do not have a srctime */
+  if (mctrl->srctime != 0)
+    delay = (srt_time - mctrl->srctime) * GST_USECOND;
+  else
+    delay = 0;
+
+  GST_LOG_OBJECT (self, "delay: %" GST_STIME_FORMAT, GST_STIME_ARGS (delay));
+
+  if (delay < 0) {
+    GST_WARNING_OBJECT (self,
+        "Calculated SRT delay %" GST_STIME_FORMAT " is negative, clamping to 0",
+        GST_STIME_ARGS (delay));
+    delay = 0;
+  }
+
+  /* Adjust by the delay */
+  if (capture_time > delay)
+    capture_time -= delay;
+  else
+    capture_time = 0;
+  GST_BUFFER_TIMESTAMP (outbuf) = capture_time;
+}
+
 static GstFlowReturn
 gst_srt_src_fill (GstPushSrc * src, GstBuffer * outbuf)
 {
@@ -151,7 +238,6 @@ gst_srt_src_fill (GstPushSrc * src, GstBuffer * outbuf)
   GstClock *clock;
   GstClockTime base_time;
   GstClockTime capture_time;
-  GstClockTimeDiff delay;
   int64_t srt_time;
   SRT_MSGCTRL mctrl;
 
@@ -180,13 +266,7 @@ gst_srt_src_fill (GstPushSrc * src, GstBuffer * outbuf)
 
   /* Capture clock values ASAP */
   capture_time = gst_clock_get_time (clock);
-#if SRT_VERSION_VALUE >= 0x10402
-  /* Use SRT clock value if available (SRT > 1.4.2) */
-  srt_time = srt_time_now ();
-#else
-  /* Else use the unix epoch monotonic clock */
-  srt_time = g_get_real_time ();
-#endif
+  srt_time = gst_srt_src_get_srt_time ();
   gst_object_unref (clock);
 
   gst_buffer_unmap (outbuf, &info);
@@ -210,41 +290,13 @@ gst_srt_src_fill (GstPushSrc * src, GstBuffer * outbuf)
     goto out;
   }
 
-  /* Detect discontinuities */
-  if (mctrl.pktseq != self->next_pktseq) {
-    GST_WARNING_OBJECT (src, "discont detected %d (expected: %d)",
-        mctrl.pktseq, self->next_pktseq);
-    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
-  }
-  /* pktseq is a 31bit field */
-  self->next_pktseq = (mctrl.pktseq + 1) % G_MAXINT32;
-
-  /* 0 means we do not have a srctime */
-  if (mctrl.srctime != 0)
-    delay = (srt_time - mctrl.srctime) * GST_USECOND;
-  else
-    delay = 0;
-
-  GST_LOG_OBJECT (src, "delay: %" GST_STIME_FORMAT, GST_STIME_ARGS (delay));
-
-  if (delay < 0) {
-    GST_WARNING_OBJECT (src,
-        "Calculated SRT delay %" GST_STIME_FORMAT " is negative, clamping to 0",
-        GST_STIME_ARGS (delay));
-    delay = 0;
-  }
-
-  /* Subtract the base_time (since the pipeline started) ... */
+  /* Subtract the base_time (since the pipeline started) */
   if (capture_time > base_time)
     capture_time -= base_time;
   else
     capture_time = 0;
-  /* And adjust by the delay */
-  if (capture_time > delay)
-    capture_time -= delay;
-  else
-    capture_time = 0;
-  GST_BUFFER_TIMESTAMP (outbuf) = capture_time;
+
+  gst_srt_src_process_message (self, outbuf, &mctrl, capture_time, srt_time);
 
   gst_buffer_resize (outbuf, 0, recv_len);
 
@@ -261,11 +313,167 @@ out:
   return ret;
 }
 
+/* Reads one message into a buffer from the pool. With @drain only takes
+ * messages that are already received, otherwise waits for one. Returns
+ * the message length, 0 on EOS (or nothing to drain) and -1 on error. */
+static gssize
+gst_srt_src_read_message (GstSRTSrc * self, gboolean drain,
+    GstBuffer ** outbuf, SRT_MSGCTRL * mctrl, GError ** err)
+{
+  GstBuffer *buffer = NULL;
+  GstMapInfo info;
+  gssize recv_len;
+
+  if (gst_buffer_pool_acquire_buffer (self->pool, &buffer,
+          NULL) != GST_FLOW_OK) {
+    g_set_error (err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+        "Could not acquire a buffer from the pool");
+    return -1;
+  }
+
+  if (!gst_buffer_map (buffer, &info, GST_MAP_WRITE)) {
+    g_set_error (err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+        "Could not map the buffer for writing");
+    gst_buffer_unref (buffer);
+    return -1;
+  }
+
+  if (drain)
+    recv_len = gst_srt_object_read_ready (self->srtobject, info.data,
+        info.size, mctrl);
+  else
+    recv_len = gst_srt_object_read (self->srtobject, info.data, info.size,
+        self->cancellable, err, mctrl);
+
+  gst_buffer_unmap (buffer, &info);
+
+  if (recv_len <= 0) {
+    gst_buffer_unref (buffer);
+    return recv_len;
+  }
+
+  gst_buffer_resize (buffer, 0, recv_len);
+
+  /* Keep the sender's time around, the timestamp has the delay applied */
+  if (mctrl->srctime != 0)
+    gst_buffer_add_reference_timestamp_meta (buffer, srctime_caps,
+        mctrl->srctime * GST_USECOND, GST_CLOCK_TIME_NONE);
+
+  *outbuf = buffer;
+
+  return recv_len;
+}
+
+/* Waits for a message, then drains all the others that are ready into
+ * a single buffer list */
+static GstFlowReturn
+gst_srt_src_create_batch (GstSRTSrc * self, guint max_messages,
+    GstBuffer ** outbuf)
+{
+  GstBufferList *list = NULL;
+  GstBuffer *buffer = NULL;
+  GError *err = NULL;
+  gssize recv_len;
+  GstClock *clock;
+  GstClockTime base_time;
+  GstClockTime capture_time;
+  int64_t srt_time;
+  SRT_MSGCTRL mctrl;
+  guint i;
+
+  if (g_cancellable_is_cancelled (self->cancellable))
+    return GST_FLOW_FLUSHING;
+
+  clock = gst_element_get_clock (GST_ELEMENT (self));
+  if (!clock) {
+    GST_DEBUG_OBJECT (self, "Clock missing, flushing");
+    return GST_FLOW_FLUSHING;
+  }
+
+  base_time = gst_element_get_base_time (GST_ELEMENT (self));
+
+  recv_len = gst_srt_src_read_message (self, FALSE, &buffer, &mctrl, &err);
+
+  /* Capture clock values ASAP */
+  capture_time = gst_clock_get_time (clock);
+  srt_time = gst_srt_src_get_srt_time ();
+  gst_object_unref (clock);
+
+  if (g_cancellable_is_cancelled (self->cancellable)) {
+    gst_clear_buffer (&buffer);
+    g_clear_error (&err);
+    return GST_FLOW_FLUSHING;
+  }
+
+  if (recv_len < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL), ("%s", err->message));
+    g_clear_error (&err);
+    return GST_FLOW_ERROR;
+  } else if (recv_len == 0) {
+    return GST_FLOW_EOS;
+  }
+
+  if (capture_time > base_time)
+    capture_time -= base_time;
+  else
+    capture_time = 0;
+
+  gst_srt_src_process_message (self, buffer, &mctrl, capture_time, srt_time);
+
+  /* Messages drained here were all waiting when we woke up, so they share
+   * the capture time and only differ by their SRT delay */
+  for (i = 1; i < max_messages; i++) {
+    GstBuffer *next = NULL;
+
+    if (gst_srt_src_read_message (self, TRUE, &next, &mctrl, NULL) <= 0)
+      break;
+
+    gst_srt_src_process_message (self, next, &mctrl, capture_time, srt_time);
+
+    if (!list) {
+      list = gst_buffer_list_new_sized (max_messages);
+      gst_buffer_list_add (list, g_steal_pointer (&buffer));
+    }
+    gst_buffer_list_add (list, next);
+  }
+
+  if (list) {
+    GST_LOG_OBJECT (self, "pushing %u messages as a list",
+        gst_buffer_list_length (list));
+    gst_base_src_submit_buffer_list (GST_BASE_SRC (self), list);
+    *outbuf = NULL;
+  } else {
+    *outbuf = buffer;
+  }
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_srt_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
+    GstBuffer ** outbuf)
+{
+  GstSRTSrc *self = GST_SRT_SRC (bsrc);
+  guint max_messages;
+
+  GST_OBJECT_LOCK (self);
+  max_messages = self->max_batch_messages;
+  GST_OBJECT_UNLOCK (self);
+
+  /* A buffer provided by the caller can only take one message */
+  if (max_messages <= 1 || !self->pool || *outbuf)
+    return GST_BASE_SRC_CLASS (parent_class)->create (bsrc, offset, size,
+        outbuf);
+
+  return gst_srt_src_create_batch (self, max_messages, outbuf);
+}
+
 static void
 gst_srt_src_init (GstSRTSrc * self)
 {
   self->srtobject = gst_srt_object_new (GST_ELEMENT (self));
   self->cancellable = g_cancellable_new ();
+  self->max_batch_messages = DEFAULT_MAX_BATCH_MESSAGES;
 
   gst_base_src_set_format (GST_BASE_SRC (self), GST_FORMAT_TIME);
   gst_base_src_set_live (GST_BASE_SRC (self), TRUE);
@@ -313,8 +521,12 @@ gst_srt_src_set_property (GObject * object,
 {
   GstSRTSrc *self = GST_SRT_SRC (object);
 
-  if (!gst_srt_object_set_property_helper (self->srtobject, prop_id, value,
-          pspec)) {
+  if (prop_id == PROP_MAX_BATCH_MESSAGES) {
+    GST_OBJECT_LOCK (self);
+    self->max_batch_messages = g_value_get_uint (value);
+    GST_OBJECT_UNLOCK (self);
+  } else if (!gst_srt_object_set_property_helper (self->srtobject, prop_id,
+          value, pspec)) {
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
 }
@@ -325,8 +537,12 @@ gst_srt_src_get_property (GObject * object,
 {
   GstSRTSrc *self = GST_SRT_SRC (object);
 
-  if (!gst_srt_object_get_property_helper (self->srtobject, prop_id, value,
-          pspec)) {
+  if (prop_id == PROP_MAX_BATCH_MESSAGES) {
+    GST_OBJECT_LOCK (self);
+    g_value_set_uint (value, self->max_batch_messages);
+    GST_OBJECT_UNLOCK (self);
+  } else if (!gst_srt_object_get_property_helper (self->srtobject, prop_id,
+          value, pspec)) {
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
 }
@@ -426,6 +642,28 @@ gst_srt_src_class_init (GstSRTSrcClass * klass)
 
   gst_srt_object_install_properties_helper (gobject_class);
 
+  /**
+   * GstSRTSrc:max-batch-messages:
+   *
+   * Maximum number of messages pushed downstream at once. When larger
+   * than 1, all the messages that are ready after a wakeup are read into
+   * pooled buffers and pushed as a single buffer list, each carrying the
+   * sender's SRT source time as a #GstReferenceTimestampMeta with
+   * `timestamp/x-srt-srctime` caps.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_MESSAGES,
+      g_param_spec_uint ("max-batch-messages", "Maximum batch messages",
+          "Maximum number of received messages pushed as one buffer list "
+          "(1 = push each message on its own)", 1, MAX_BATCH_MESSAGES_MAX,
+          DEFAULT_MAX_BATCH_MESSAGES,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
+
+  srctime_caps = gst_caps_new_empty_simple ("timestamp/x-srt-srctime");
+  GST_MINI_OBJECT_FLAG_SET (srctime_caps, GST_MINI_OBJECT_FLAG_MAY_BE_LEAKED);
+
   gst_element_class_add_static_pad_template (gstelement_class, &src_template);
   gst_element_class_set_metadata (gstelement_class,
       "SRT source", "Source/Network",
@@ -437,6 +675,7 @@ gst_srt_src_class_init (GstSRTSrcClass * klass)
   gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_srt_src_unlock);
   gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_srt_src_unlock_stop);
   gstbasesrc_class->query = GST_DEBUG_FUNCPTR (gst_srt_src_query);
+  gstbasesrc_class->create = GST_DEBUG_FUNCPTR (gst_srt_src_create);
 
   gstpushsrc_class->fill = GST_DEBUG_FUNCPTR (gst_srt_src_fill);
 }
@@ -51,6 +51,10 @@ struct _GstSRTSrc {
   GCancellable *cancellable;
 
   guint32       next_pktseq;
+
+  /* Batched receive, see #GstSRTSrc:max-batch-messages */
+  guint         max_batch_messages;
+  GstBufferPool *pool;
 };
 
 struct _GstSRTSrcClass {
@@ -119,6 +119,8 @@ that the demux object and its streams are not changed by anybody else.
 #endif
 
 #include "gstadaptivedemux.h"
+#include "gstadaptivedemuxabr.h"
+#include "gstadaptivedemuxprefetch.h"
 #include "gst/gst-i18n-plugin.h"
 #include <gst/base/gstadapter.h>
 
@@ -129,8 +131,11 @@ GST_DEBUG_CATEGORY (adaptivedemux_debug);
 #define DEFAULT_FAILED_COUNT 3
 #define DEFAULT_CONNECTION_SPEED 0
 #define DEFAULT_BITRATE_LIMIT 0.8f
+#define DEFAULT_ABR_ALGORITHM GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE
+#define DEFAULT_PREFETCH_DEPTH 0
+#define DEFAULT_PREFETCH_CACHE_SIZE (32 * 1024 * 1024)
 #define SRC_QUEUE_MAX_BYTES 20 * 1024 * 1024    /* For safety. Large enough to hold a segment. */
-#define NUM_LOOKBACK_FRAGMENTS 3
+#define NUM_LOOKBACK_FRAGMENTS 3        /* size of the deprecated fragment_bitrates */
 
 #define GST_MANIFEST_GET_LOCK(d) (&(GST_ADAPTIVE_DEMUX_CAST(d)->priv->manifest_lock))
 #define GST_MANIFEST_LOCK(d) G_STMT_START { \
@@ -157,6 +162,9 @@ enum
   PROP_0,
   PROP_CONNECTION_SPEED,
   PROP_BITRATE_LIMIT,
+  PROP_ABR_ALGORITHM,
+  PROP_PREFETCH_DEPTH,
+  PROP_PREFETCH_CACHE_SIZE,
   PROP_LAST
 };
 
@@ -207,6 +215,18 @@ struct _GstAdaptiveDemuxPrivate
   GMutex segment_lock;
 
   GstClockTime qos_earliest_time;
+
+  /* protected by manifest_lock, which set_property() takes. Streams switch
+   * to a new algorithm when they next compute their bitrate. */
+  GstAdaptiveDemuxAbrAlgorithm abr_algorithm;
+
+  /* fragments downloaded ahead of the streams */
+  GstAdaptiveDemuxPrefetch *prefetch;   /* MT safe */
+  guint prefetch_depth;         /* protected by manifest_lock */
+
+  /* for requests the server holds back, which are done without the
+   * manifest_lock and mustn't hold up the other manifest downloads */
+  GstUriDownloader *blocking_downloader;
 };
 
 typedef struct _GstAdaptiveDemuxTimer
@@ -339,6 +359,30 @@ gst_adaptive_demux_get_type (void)
   return type;
 }
 
+GType
+gst_adaptive_demux_abr_algorithm_get_type (void)
+{
+  static gsize type = 0;
+  static const GEnumValue values[] = {
+    {GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE,
+        "Average download rate of the last fragments", "moving-average"},
+    {GST_ADAPTIVE_DEMUX_ABR_THROUGHPUT,
+        "Throughput averaged over the downloaded chunks", "throughput"},
+    {GST_ADAPTIVE_DEMUX_ABR_BUFFER, "Based on the buffer level", "buffer"},
+    {GST_ADAPTIVE_DEMUX_ABR_HYBRID,
+        "Throughput based when the buffer is low, buffer based otherwise",
+        "hybrid"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        g_enum_register_static ("GstAdaptiveDemuxAbrAlgorithm", values);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
 static inline GstAdaptiveDemuxPrivate *
 gst_adaptive_demux_get_instance_private (GstAdaptiveDemux * self)
 {
@@ -363,6 +407,18 @@ gst_adaptive_demux_set_property (GObject * object, guint prop_id,
     case PROP_BITRATE_LIMIT:
       demux->bitrate_limit = g_value_get_float (value);
       break;
+    case PROP_ABR_ALGORITHM:
+      demux->priv->abr_algorithm = g_value_get_enum (value);
+      GST_DEBUG_OBJECT (demux, "ABR algorithm set to %d",
+          demux->priv->abr_algorithm);
+      break;
+    case PROP_PREFETCH_DEPTH:
+      demux->priv->prefetch_depth = g_value_get_uint (value);
+      break;
+    case PROP_PREFETCH_CACHE_SIZE:
+      gst_adaptive_demux_prefetch_set_max_size (demux->priv->prefetch,
+          g_value_get_uint64 (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -387,6 +443,16 @@ gst_adaptive_demux_get_property (GObject * object, guint prop_id,
     case PROP_BITRATE_LIMIT:
       g_value_set_float (value, demux->bitrate_limit);
       break;
+    case PROP_ABR_ALGORITHM:
+      g_value_set_enum (value, demux->priv->abr_algorithm);
+      break;
+    case PROP_PREFETCH_DEPTH:
+      g_value_set_uint (value, demux->priv->prefetch_depth);
+      break;
+    case PROP_PREFETCH_CACHE_SIZE:
+      g_value_set_uint64 (value,
+          gst_adaptive_demux_prefetch_get_max_size (demux->priv->prefetch));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -432,6 +498,51 @@ gst_adaptive_demux_class_init (GstAdaptiveDemuxClass * klass)
           0, 1, DEFAULT_BITRATE_LIMIT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstAdaptiveDemux:abr-algorithm:
+   *
+   * How the bandwidth is estimated when choosing the bitrate of the next
+   * fragment. Changes apply from the next fragment on.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_ABR_ALGORITHM,
+      g_param_spec_enum ("abr-algorithm", "ABR algorithm",
+          "Algorithm used to choose the bitrate of the next fragment",
+          GST_TYPE_ADAPTIVE_DEMUX_ABR_ALGORITHM, DEFAULT_ABR_ALGORITHM,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAdaptiveDemux:prefetch-depth:
+   *
+   * How many fragments following the current one each stream downloads
+   * ahead of time, so that the round trip of each request doesn't delay
+   * the next one. The subclass has to implement stream_peek_fragment.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_PREFETCH_DEPTH,
+      g_param_spec_uint ("prefetch-depth", "Prefetch depth",
+          "Number of fragments each stream downloads ahead (0 = disabled)",
+          0, 16, DEFAULT_PREFETCH_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAdaptiveDemux:prefetch-cache-size:
+   *
+   * Memory all streams together may use for fragments downloaded ahead of
+   * time. Fragments that don't fit are downloaded when they are needed.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_PREFETCH_CACHE_SIZE,
+      g_param_spec_uint64 ("prefetch-cache-size", "Prefetch cache size",
+          "Maximum bytes of prefetched fragments kept in memory", 0,
+          G_MAXUINT64, DEFAULT_PREFETCH_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_type_mark_as_plugin_api (GST_TYPE_ADAPTIVE_DEMUX_ABR_ALGORITHM, 0);
+
   gstelement_class->change_state = gst_adaptive_demux_change_state;
 
   gstbin_class->handle_message = gst_adaptive_demux_handle_message;
@@ -458,6 +569,11 @@ gst_adaptive_demux_init (GstAdaptiveDemux * demux,
   demux->priv->input_adapter = gst_adapter_new ();
   demux->downloader = gst_uri_downloader_new ();
   gst_uri_downloader_set_parent (demux->downloader, GST_ELEMENT_CAST (demux));
+  demux->priv->blocking_downloader = gst_uri_downloader_new ();
+  gst_uri_downloader_set_parent (demux->priv->blocking_downloader,
+      GST_ELEMENT_CAST (demux));
+  demux->priv->prefetch =
+      gst_adaptive_demux_prefetch_new (GST_ELEMENT_CAST (demux));
   demux->stream_struct_size = sizeof (GstAdaptiveDemuxStream);
   demux->priv->segment_seqnum = gst_util_seqnum_next ();
   demux->have_group_id = FALSE;
@@ -522,6 +638,10 @@ gst_adaptive_demux_init (GstAdaptiveDemux * demux,
   /* Properties */
   demux->bitrate_limit = DEFAULT_BITRATE_LIMIT;
   demux->connection_speed = DEFAULT_CONNECTION_SPEED;
+  demux->priv->abr_algorithm = DEFAULT_ABR_ALGORITHM;
+  demux->priv->prefetch_depth = DEFAULT_PREFETCH_DEPTH;
+  gst_adaptive_demux_prefetch_set_max_size (demux->priv->prefetch,
+      DEFAULT_PREFETCH_CACHE_SIZE);
 
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 }
@@ -536,6 +656,8 @@ gst_adaptive_demux_finalize (GObject * object)
 
   g_object_unref (priv->input_adapter);
   g_object_unref (demux->downloader);
+  g_object_unref (priv->blocking_downloader);
+  gst_adaptive_demux_prefetch_free (priv->prefetch);
 
   g_mutex_clear (&priv->updates_timed_lock);
   g_cond_clear (&priv->updates_timed_cond);
@@ -569,6 +691,7 @@ gst_adaptive_demux_change_state (GstElement * element,
       if (g_atomic_int_compare_and_exchange (&demux->running, TRUE, FALSE))
         GST_DEBUG_OBJECT (demux, "demuxer has stopped running");
       gst_uri_downloader_cancel (demux->downloader);
+      gst_uri_downloader_cancel (demux->priv->blocking_downloader);
 
       GST_API_LOCK (demux);
       GST_MANIFEST_LOCK (demux);
@@ -583,6 +706,7 @@ gst_adaptive_demux_change_state (GstElement * element,
       /* Clear "cancelled" flag in uridownloader since subclass might want to
        * use uridownloader to fetch another manifest */
       gst_uri_downloader_reset (demux->downloader);
+      gst_uri_downloader_reset (demux->priv->blocking_downloader);
       if (g_atomic_int_get (&demux->priv->have_manifest))
         gst_adaptive_demux_start_manifest_update_task (demux);
       GST_MANIFEST_UNLOCK (demux);
@@ -1323,6 +1447,7 @@ gst_adaptive_demux_stream_new (GstAdaptiveDemux * demux, GstPad * pad)
   stream->demux = demux;
   stream->fragment_bitrates =
       g_malloc0 (sizeof (guint64) * NUM_LOOKBACK_FRAGMENTS);
+  stream->abr = gst_adaptive_demux_abr_new (demux->priv->abr_algorithm);
   gst_pad_set_element_private (pad, stream);
   stream->qos_earliest_time = GST_CLOCK_TIME_NONE;
 
@@ -1375,6 +1500,8 @@ gst_adaptive_demux_stream_free (GstAdaptiveDemuxStream * stream)
   if (klass->stream_free)
     klass->stream_free (stream);
 
+  gst_adaptive_demux_prefetch_cancel (demux->priv->prefetch, stream);
+
   g_clear_error (&stream->last_error);
   if (stream->download_task) {
     if (GST_TASK_STATE (stream->download_task) != GST_TASK_STOPPED) {
@@ -1439,6 +1566,7 @@ gst_adaptive_demux_stream_free (GstAdaptiveDemuxStream * stream)
   g_cond_clear (&stream->fragment_download_cond);
   g_mutex_clear (&stream->fragment_download_lock);
   g_free (stream->fragment_bitrates);
+  gst_adaptive_demux_abr_free (stream->abr);
 
   if (stream->pad) {
     gst_object_unref (stream->pad);
@@ -2088,6 +2216,7 @@ static void
 gst_adaptive_demux_stop_manifest_update_task (GstAdaptiveDemux * demux)
 {
   gst_uri_downloader_cancel (demux->downloader);
+  gst_uri_downloader_cancel (demux->priv->blocking_downloader);
 
   gst_task_stop (demux->priv->updates_task);
 
@@ -2106,6 +2235,7 @@ gst_adaptive_demux_start_manifest_update_task (GstAdaptiveDemux * demux)
 
   if (gst_adaptive_demux_is_live (demux)) {
     gst_uri_downloader_reset (demux->downloader);
+    gst_uri_downloader_reset (demux->priv->blocking_downloader);
     g_mutex_lock (&demux->priv->updates_timed_lock);
     demux->priv->stop_updates_task = FALSE;
     g_mutex_unlock (&demux->priv->updates_timed_lock);
@@ -2145,6 +2275,9 @@ gst_adaptive_demux_stop_tasks (GstAdaptiveDemux * demux, gboolean stop_updates)
       gst_task_stop (stream->download_task);
       g_cond_signal (&stream->fragment_download_cond);
       g_mutex_unlock (&stream->fragment_download_lock);
+
+      /* also wakes up the task if it waits for a prefetch */
+      gst_adaptive_demux_prefetch_cancel (demux->priv->prefetch, stream);
     }
     list_to_process = demux->prepared_streams;
   }
@@ -2254,22 +2387,27 @@ gst_adaptive_demux_stream_queue_event (GstAdaptiveDemuxStream * stream,
   stream->pending_events = g_list_append (stream->pending_events, event);
 }
 
-/* must be called with manifest_lock taken */
-static guint64
-_update_average_bitrate (GstAdaptiveDemux * demux,
-    GstAdaptiveDemuxStream * stream, guint64 new_bitrate)
+/* Playback time of the data that was downloaded but not played yet.
+ * must be called with manifest_lock taken */
+static GstClockTime
+gst_adaptive_demux_stream_get_buffer_level (GstAdaptiveDemux * demux,
+    GstAdaptiveDemuxStream * stream)
 {
-  gint index = stream->moving_index % NUM_LOOKBACK_FRAGMENTS;
+  GstClockTime now, position;
 
-  stream->moving_bitrate -= stream->fragment_bitrates[index];
-  stream->fragment_bitrates[index] = new_bitrate;
-  stream->moving_bitrate += new_bitrate;
+  now = gst_element_get_current_running_time (GST_ELEMENT_CAST (demux));
+  if (!GST_CLOCK_TIME_IS_VALID (now))
+    return GST_CLOCK_TIME_NONE;
 
-  stream->moving_index += 1;
+  GST_ADAPTIVE_DEMUX_SEGMENT_LOCK (demux);
+  position = gst_segment_to_running_time (&stream->segment, GST_FORMAT_TIME,
+      stream->segment.position);
+  GST_ADAPTIVE_DEMUX_SEGMENT_UNLOCK (demux);
+
+  if (!GST_CLOCK_TIME_IS_VALID (position))
+    return GST_CLOCK_TIME_NONE;
 
-  if (stream->moving_index > NUM_LOOKBACK_FRAGMENTS)
-    return stream->moving_bitrate / NUM_LOOKBACK_FRAGMENTS;
-  return stream->moving_bitrate / stream->moving_index;
+  return position > now ? position - now : 0;
 }
 
 /* must be called with manifest_lock taken */
@@ -2277,8 +2415,7 @@ static guint64
 gst_adaptive_demux_stream_update_current_bitrate (GstAdaptiveDemux * demux,
     GstAdaptiveDemuxStream * stream)
 {
-  guint64 average_bitrate;
-  guint64 fragment_bitrate;
+  GstAdaptiveDemuxAbrInput input;
 
   if (demux->connection_speed) {
     GST_LOG_OBJECT (demux, "Connection-speed is set to %u kbps, using it",
@@ -2287,22 +2424,27 @@ gst_adaptive_demux_stream_update_current_bitrate (GstAdaptiveDemux * demux,
     return demux->connection_speed;
   }
 
-  fragment_bitrate = stream->last_bitrate;
-  GST_DEBUG_OBJECT (demux, "Download bitrate is : %" G_GUINT64_FORMAT " bps",
-      fragment_bitrate);
-
-  average_bitrate = _update_average_bitrate (demux, stream, fragment_bitrate);
+  input.fragment_bitrate = stream->last_bitrate;
+  input.fragment_duration = stream->fragment.duration;
+  input.buffer_level = gst_adaptive_demux_stream_get_buffer_level (demux,
+      stream);
+  input.bitrate_limit = demux->bitrate_limit;
 
   GST_INFO_OBJECT (GST_ADAPTIVE_DEMUX_STREAM_PAD (stream),
-      "last fragment bitrate was %" G_GUINT64_FORMAT, fragment_bitrate);
-  GST_INFO_OBJECT (GST_ADAPTIVE_DEMUX_STREAM_PAD (stream),
-      "Last %u fragments average bitrate is %" G_GUINT64_FORMAT,
-      NUM_LOOKBACK_FRAGMENTS, average_bitrate);
+      "last fragment bitrate was %" G_GUINT64_FORMAT ", buffer level %"
+      GST_TIME_FORMAT, input.fragment_bitrate,
+      GST_TIME_ARGS (input.buffer_level));
 
-  /* Conservative approach, make sure we don't upgrade too fast */
-  stream->current_download_rate = MIN (average_bitrate, fragment_bitrate);
+  g_mutex_lock (&stream->fragment_download_lock);
+  if (gst_adaptive_demux_abr_get_algorithm (stream->abr) !=
+      demux->priv->abr_algorithm) {
+    gst_adaptive_demux_abr_free (stream->abr);
+    stream->abr = gst_adaptive_demux_abr_new (demux->priv->abr_algorithm);
+  }
+  stream->current_download_rate =
+      gst_adaptive_demux_abr_get_bitrate (stream->abr, &input);
+  g_mutex_unlock (&stream->fragment_download_lock);
 
-  stream->current_download_rate *= demux->bitrate_limit;
   GST_DEBUG_OBJECT (demux, "Bitrate after bitrate limit (%0.2f): %"
       G_GUINT64_FORMAT, demux->bitrate_limit, stream->current_download_rate);
 
@@ -2578,31 +2720,16 @@ gst_adaptive_demux_requires_periodical_playlist_update_default (GstAdaptiveDemux
   return TRUE;
 }
 
+/* must be called with manifest_lock taken.
+ * Can temporarily release manifest_lock
+ */
 static GstFlowReturn
-_src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+gst_adaptive_demux_stream_chain_buffer (GstAdaptiveDemux * demux,
+    GstAdaptiveDemuxStream * stream, GstBuffer * buffer)
 {
-  GstAdaptiveDemuxStream *stream;
-  GstAdaptiveDemux *demux;
-  GstAdaptiveDemuxClass *klass;
+  GstAdaptiveDemuxClass *klass = GST_ADAPTIVE_DEMUX_GET_CLASS (demux);
   GstFlowReturn ret = GST_FLOW_OK;
 
-  demux = GST_ADAPTIVE_DEMUX_CAST (parent);
-  stream = gst_pad_get_element_private (pad);
-  klass = GST_ADAPTIVE_DEMUX_GET_CLASS (demux);
-
-  GST_MANIFEST_LOCK (demux);
-
-  /* do not make any changes if the stream is cancelled */
-  g_mutex_lock (&stream->fragment_download_lock);
-  if (G_UNLIKELY (stream->cancelled)) {
-    g_mutex_unlock (&stream->fragment_download_lock);
-    gst_buffer_unref (buffer);
-    ret = stream->last_ret = GST_FLOW_FLUSHING;
-    GST_MANIFEST_UNLOCK (demux);
-    return ret;
-  }
-  g_mutex_unlock (&stream->fragment_download_lock);
-
   /* starting_fragment is set to TRUE at the beginning of
    * _stream_download_fragment()
    * /!\ If there is a header/index being downloaded, then this will
@@ -2695,7 +2822,6 @@ _src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     g_mutex_lock (&stream->fragment_download_lock);
     if (G_UNLIKELY (stream->cancelled)) {
       g_mutex_unlock (&stream->fragment_download_lock);
-      GST_MANIFEST_UNLOCK (demux);
       return ret;
     }
     g_mutex_unlock (&stream->fragment_download_lock);
@@ -2735,6 +2861,34 @@ _src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
 error:
 
+  return ret;
+}
+
+static GstFlowReturn
+_src_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstAdaptiveDemuxStream *stream;
+  GstAdaptiveDemux *demux;
+  GstFlowReturn ret;
+
+  demux = GST_ADAPTIVE_DEMUX_CAST (parent);
+  stream = gst_pad_get_element_private (pad);
+
+  GST_MANIFEST_LOCK (demux);
+
+  /* do not make any changes if the stream is cancelled */
+  g_mutex_lock (&stream->fragment_download_lock);
+  if (G_UNLIKELY (stream->cancelled)) {
+    g_mutex_unlock (&stream->fragment_download_lock);
+    gst_buffer_unref (buffer);
+    ret = stream->last_ret = GST_FLOW_FLUSHING;
+    GST_MANIFEST_UNLOCK (demux);
+    return ret;
+  }
+  g_mutex_unlock (&stream->fragment_download_lock);
+
+  ret = gst_adaptive_demux_stream_chain_buffer (demux, stream, buffer);
+
   GST_MANIFEST_UNLOCK (demux);
 
   return ret;
@@ -2854,14 +3008,25 @@ _uri_handler_probe (GstPad * pad, GstPadProbeInfo * info,
 
   if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
     GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+    GstClockTime now = gst_adaptive_demux_get_monotonic_time (stream->demux);
+    GstClockTime chunk_time;
+
     if (stream->fragment_bytes_downloaded == 0) {
-      stream->last_latency =
-          gst_adaptive_demux_get_monotonic_time (stream->demux) -
-          (stream->download_start_time * GST_USECOND);
+      stream->last_latency = now - (stream->download_start_time * GST_USECOND);
       GST_DEBUG_OBJECT (pad,
           "FIRST BYTE since download_start %" GST_TIME_FORMAT,
           GST_TIME_ARGS (stream->last_latency));
+      chunk_time = stream->last_latency;
+    } else {
+      chunk_time = now - stream->last_chunk_time;
     }
+    stream->last_chunk_time = now;
+
+    g_mutex_lock (&stream->fragment_download_lock);
+    gst_adaptive_demux_abr_add_chunk (stream->abr, gst_buffer_get_size (buf),
+        chunk_time);
+    g_mutex_unlock (&stream->fragment_download_lock);
+
     stream->fragment_bytes_downloaded += gst_buffer_get_size (buf);
     GST_LOG_OBJECT (pad,
         "Received buffer, size %" G_GSIZE_FORMAT " total %" G_GUINT64_FORMAT,
@@ -3344,6 +3509,135 @@ gst_adaptive_demux_stream_download_uri (GstAdaptiveDemux * demux,
   return ret;
 }
 
+/* Feeds fragment data the subclass got by other means as if it had been
+ * downloaded. It is not accounted for in the download bitrate.
+ * must be called with manifest_lock taken.
+ * Can temporarily release manifest_lock
+ */
+static GstFlowReturn
+gst_adaptive_demux_stream_push_prefetched (GstAdaptiveDemux * demux,
+    GstAdaptiveDemuxStream * stream, GstBuffer * buffer)
+{
+  GstFlowReturn ret;
+
+  GST_DEBUG_OBJECT (stream->pad, "Using %" G_GSIZE_FORMAT
+      " prefetched bytes for %s", gst_buffer_get_size (buffer),
+      stream->fragment.uri);
+
+  stream->downloading_first_buffer = FALSE;
+  stream->fragment_bytes_downloaded = gst_buffer_get_size (buffer);
+
+  ret = gst_adaptive_demux_stream_chain_buffer (demux, stream, buffer);
+  if (ret == GST_FLOW_OK)
+    gst_adaptive_demux_eos_handling (stream);
+
+  return stream->last_ret;
+}
+
+/* Requests the fragments following the current one, so that they download
+ * while the current one does, and the one the server announced after them.
+ * must be called with manifest_lock taken */
+static void
+gst_adaptive_demux_stream_prefetch_next (GstAdaptiveDemux * demux,
+    GstAdaptiveDemuxStream * stream)
+{
+  GstAdaptiveDemuxClass *klass = GST_ADAPTIVE_DEMUX_GET_CLASS (demux);
+  gchar *uri = NULL;
+  gint64 range_start = 0, range_end = -1;
+  guint64 expected_size;
+  gboolean requested = TRUE;
+  guint i;
+
+  for (i = 1; klass->stream_peek_fragment && i <= demux->priv->prefetch_depth;
+      i++) {
+    if (!klass->stream_peek_fragment (stream, i, &uri, &range_start,
+            &range_end))
+      break;
+
+    /* Without a range, expect it to be as large as the previous one */
+    if (range_end != -1)
+      expected_size = range_end - range_start + 1;
+    else
+      expected_size = stream->fragment_bytes_downloaded;
+
+    requested = gst_adaptive_demux_prefetch_request (demux->priv->prefetch,
+        stream, uri, NULL, range_start, range_end, expected_size);
+    g_free (uri);
+    uri = NULL;
+
+    if (!requested)
+      return;
+  }
+
+  if (!klass->stream_get_preload_hint
+      || !klass->stream_get_preload_hint (stream, &uri, &range_start,
+          &range_end))
+    return;
+
+  if (range_end != -1)
+    expected_size = range_end - range_start + 1;
+  else
+    expected_size = stream->fragment_bytes_downloaded;
+
+  gst_adaptive_demux_prefetch_request (demux->priv->prefetch, stream, uri,
+      NULL, range_start, range_end, expected_size);
+  g_free (uri);
+}
+
+/* Requests the next fragments and returns the current one if it was
+ * prefetched, waiting for it to finish downloading if needed. The download
+ * is accounted for in the download bitrate.
+ * must be called with manifest_lock taken.
+ * Can temporarily release manifest_lock
+ */
+static GstBuffer *
+gst_adaptive_demux_stream_take_prefetched (GstAdaptiveDemux * demux,
+    GstAdaptiveDemuxStream * stream)
+{
+  GstClockTime download_time = 0;
+  GstBuffer *buffer;
+  gboolean prefetched;
+  gsize size;
+
+  prefetched = gst_adaptive_demux_prefetch_retain (demux->priv->prefetch,
+      stream, stream->fragment.uri, stream->fragment.range_start,
+      stream->fragment.range_end);
+
+  /* before waiting, so that the next ones download meanwhile */
+  gst_adaptive_demux_stream_prefetch_next (demux, stream);
+
+  if (!prefetched)
+    return NULL;
+
+  GST_MANIFEST_UNLOCK (demux);
+  buffer = gst_adaptive_demux_prefetch_take (demux->priv->prefetch, stream,
+      stream->fragment.uri, stream->fragment.range_start,
+      stream->fragment.range_end, &download_time);
+  GST_MANIFEST_LOCK (demux);
+
+  if (buffer == NULL)
+    return NULL;
+
+  size = gst_buffer_get_size (buffer);
+
+  g_mutex_lock (&stream->fragment_download_lock);
+  if (G_UNLIKELY (stream->cancelled)) {
+    g_mutex_unlock (&stream->fragment_download_lock);
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+  gst_adaptive_demux_abr_add_chunk (stream->abr, size, download_time);
+  g_mutex_unlock (&stream->fragment_download_lock);
+
+  if (download_time > 0) {
+    stream->last_download_time = download_time;
+    stream->last_bitrate =
+        gst_util_uint64_scale (size, 8 * GST_SECOND, download_time);
+  }
+
+  return buffer;
+}
+
 /* must be called with manifest_lock taken.
  * Can temporarily release manifest_lock
  */
@@ -3432,6 +3726,20 @@ again:
   stream->last_ret = GST_FLOW_OK;
   http_status = 200;
 
+  /* We might have downloaded it ahead of time */
+  if ((demux->priv->prefetch_depth > 0 && klass->stream_peek_fragment)
+      || klass->stream_get_preload_hint) {
+    GstBuffer *buffer =
+        gst_adaptive_demux_stream_take_prefetched (demux, stream);
+
+    if (buffer) {
+      ret = gst_adaptive_demux_stream_push_prefetched (demux, stream, buffer);
+      GST_DEBUG_OBJECT (stream->pad, "Prefetched fragment result: %s",
+          gst_flow_get_name (ret));
+      goto beach;
+    }
+  }
+
   /* Download the actual fragment, either in fragments or in one go */
   if (klass->need_another_chunk && klass->need_another_chunk (stream)
       && stream->fragment.chunk_size != 0) {
@@ -4181,6 +4489,9 @@ gst_adaptive_demux_stream_seek (GstAdaptiveDemux * demux,
 {
   GstAdaptiveDemuxClass *klass = GST_ADAPTIVE_DEMUX_GET_CLASS (demux);
 
+  /* What was downloaded ahead of the old position isn't needed anymore */
+  gst_adaptive_demux_prefetch_cancel (demux->priv->prefetch, stream);
+
   if (klass->stream_seek)
     return klass->stream_seek (stream, forward, flags, ts, final_ts);
   return GST_FLOW_ERROR;
@@ -4682,3 +4993,39 @@ gst_adaptive_demux_get_qos_earliest_time (GstAdaptiveDemux * demux)
 
   return earliest;
 }
+
+/**
+ * gst_adaptive_demux_fetch_uri_blocking:
+ * @demux: #GstAdaptiveDemux
+ * @uri: the URI to fetch
+ * @referer: (nullable): the referer of the request
+ * @err: return location for a #GError
+ *
+ * Fetches @uri with a downloader of its own, releasing the manifest lock
+ * while the request is pending. Meant for requests the server holds back on
+ * purpose, like blocking playlist reloads, so that fragment downloads and
+ * other manifest downloads are not stalled meanwhile. The request is
+ * cancelled when the manifest updates are stopped.
+ *
+ * Must be called with the manifest lock taken, the caller has to check its
+ * state is still valid afterwards.
+ *
+ * Returns: (transfer full) (nullable): the downloaded #GstFragment
+ *
+ * Since: 1.20
+ */
+GstFragment *
+gst_adaptive_demux_fetch_uri_blocking (GstAdaptiveDemux * demux,
+    const gchar * uri, const gchar * referer, GError ** err)
+{
+  GstFragment *download;
+
+  g_return_val_if_fail (GST_IS_ADAPTIVE_DEMUX (demux), NULL);
+
+  GST_MANIFEST_UNLOCK (demux);
+  download = gst_uri_downloader_fetch_uri (demux->priv->blocking_downloader,
+      uri, referer, TRUE, TRUE, TRUE, err);
+  GST_MANIFEST_LOCK (demux);
+
+  return download;
+}
@@ -92,6 +92,36 @@ typedef struct _GstAdaptiveDemuxStream GstAdaptiveDemuxStream;
 typedef struct _GstAdaptiveDemux GstAdaptiveDemux;
 typedef struct _GstAdaptiveDemuxClass GstAdaptiveDemuxClass;
 typedef struct _GstAdaptiveDemuxPrivate GstAdaptiveDemuxPrivate;
+typedef struct _GstAdaptiveDemuxAbr GstAdaptiveDemuxAbr;
+
+/**
+ * GstAdaptiveDemuxAbrAlgorithm:
+ * @GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE: minimum of the download rate of the
+ *   last fragment and of the average of the last 3 fragments
+ * @GST_ADAPTIVE_DEMUX_ABR_THROUGHPUT: throughput averaged over the downloaded
+ *   chunks with a short and a long memory, the lower of both is used
+ * @GST_ADAPTIVE_DEMUX_ABR_BUFFER: share of the long term throughput that
+ *   grows with the amount of data buffered downstream
+ * @GST_ADAPTIVE_DEMUX_ABR_HYBRID: throughput based while the buffer is low,
+ *   buffer based once it is full enough
+ *
+ * How the bitrate used to choose the next fragment is estimated.
+ *
+ * Since: 1.20
+ */
+typedef enum
+{
+  GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE,
+  GST_ADAPTIVE_DEMUX_ABR_THROUGHPUT,
+  GST_ADAPTIVE_DEMUX_ABR_BUFFER,
+  GST_ADAPTIVE_DEMUX_ABR_HYBRID,
+} GstAdaptiveDemuxAbrAlgorithm;
+
+#define GST_TYPE_ADAPTIVE_DEMUX_ABR_ALGORITHM \
+  (gst_adaptive_demux_abr_algorithm_get_type())
+
+GST_ADAPTIVE_DEMUX_API
+GType gst_adaptive_demux_abr_algorithm_get_type (void);
 
 struct _GstAdaptiveDemuxStreamFragment
 {
@@ -179,7 +209,8 @@ struct _GstAdaptiveDemuxStream
   GstClockTime last_latency;
   GstClockTime last_download_time;
 
-  /* Average for the last fragments */
+  /* Average for the last fragments.
+   * Deprecated: not updated anymore, the bitrate is estimated by @abr */
   guint64 moving_bitrate;
   guint moving_index;
   guint64 *fragment_bitrates;
@@ -195,6 +226,13 @@ struct _GstAdaptiveDemuxStream
   gboolean eos;
 
   gboolean do_block; /* TRUE if stream should block on preroll */
+
+  /* arrival time of the last buffer of the current fragment (pre-queue2) */
+  GstClockTime last_chunk_time;
+
+  /* Bandwidth estimation, fed with every downloaded buffer (pre-queue2),
+   * protected by fragment_download_lock */
+  GstAdaptiveDemuxAbr *abr;
 };
 
 /**
@@ -482,6 +520,46 @@ struct _GstAdaptiveDemuxClass
    * Return: %TRUE if the playlist needs to be refreshed periodically by the demuxer.
    */
   gboolean (*requires_periodical_playlist_update) (GstAdaptiveDemux * demux);
+
+  /**
+   * stream_get_preload_hint:
+   * @stream: #GstAdaptiveDemuxStream
+   * @uri: (out) (transfer full): the uri of the announced fragment
+   * @range_start: (out): the first byte of the fragment
+   * @range_end: (out): the last byte of the fragment, or -1
+   *
+   * Looks up the fragment the server announced will come after the ones
+   * listed in the manifest. It is downloaded ahead of time, whatever
+   * #GstAdaptiveDemux:prefetch-depth is, so that it is requested as soon as
+   * the server knows about it.
+   *
+   * Returns: %FALSE if no fragment was announced
+   *
+   * Since: 1.20
+   */
+  gboolean (*stream_get_preload_hint) (GstAdaptiveDemuxStream * stream,
+                                       gchar ** uri, gint64 * range_start,
+                                       gint64 * range_end);
+
+  /**
+   * stream_peek_fragment:
+   * @stream: #GstAdaptiveDemuxStream
+   * @offset: how many fragments after the current one, starting at 1
+   * @uri: (out) (transfer full): the uri of that fragment
+   * @range_start: (out): the first byte of the fragment
+   * @range_end: (out): the last byte of the fragment, or -1
+   *
+   * Looks up a fragment that comes after the current one at the current
+   * bitrate, without advancing. Used to download fragments ahead of time
+   * when #GstAdaptiveDemux:prefetch-depth is set.
+   *
+   * Returns: %FALSE if the fragment isn't known or can't be downloaded yet
+   *
+   * Since: 1.20
+   */
+  gboolean (*stream_peek_fragment) (GstAdaptiveDemuxStream * stream,
+                                    guint offset, gchar ** uri,
+                                    gint64 * range_start, gint64 * range_end);
 };
 
 GST_ADAPTIVE_DEMUX_API
@@ -535,6 +613,10 @@ gboolean gst_adaptive_demux_is_running (GstAdaptiveDemux * demux);
 GST_ADAPTIVE_DEMUX_API
 GstClockTime gst_adaptive_demux_get_qos_earliest_time (GstAdaptiveDemux *demux);
 
+GST_ADAPTIVE_DEMUX_API
+GstFragment * gst_adaptive_demux_fetch_uri_blocking (GstAdaptiveDemux * demux,
+    const gchar * uri, const gchar * referer, GError ** err);
+
 G_END_DECLS
 
 #endif
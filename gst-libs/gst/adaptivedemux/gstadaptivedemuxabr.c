@@ -0,0 +1,414 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Bandwidth estimation and bitrate selection for adaptivedemux.
+ *
+ * moving-average: the historical behaviour, the minimum of the download
+ *   rate of the last fragment and the average of the last 3 fragments.
+ *
+ * throughput: two exponentially weighted moving averages of the per-chunk
+ *   download rate, weighted by the time each chunk took, with a short and a
+ *   long half-life. The lower of both is used, so that drops are followed
+ *   quickly and increases only once they lasted. Weighting by time makes
+ *   bursts of data that arrive back to back count for as long as they took,
+ *   instead of as one sample each.
+ *
+ * buffer: the buffer level is mapped linearly onto a share of the long-term
+ *   throughput, from nothing when only the reservoir is left up to above
+ *   the throughput once the cushion is full, similar to BBA/BOLA. The
+ *   throughput only scales the result because subclasses don't expose their
+ *   variants to the base class, they pick the highest one below a bitrate.
+ *
+ * hybrid: the throughput rule, lowered when downloading the next fragment
+ *   at that rate would drain the buffer into the reservoir, or the buffer
+ *   rule when the buffer is full enough to ride out a throughput dip.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "gstadaptivedemuxabr.h"
+
+GST_DEBUG_CATEGORY_EXTERN (adaptivedemux_debug);
+#define GST_CAT_DEFAULT adaptivedemux_debug
+
+#define NUM_LOOKBACK_FRAGMENTS 3
+
+/* Half-lives of the throughput averages, in seconds */
+#define ABR_FAST_HALF_LIFE 2.0
+#define ABR_SLOW_HALF_LIFE 5.0
+/* Chunks are merged until they carry at least this much data, so that tiny
+ * reads don't produce meaningless rates */
+#define ABR_MIN_SAMPLE_BYTES (16 * 1024)
+/* The averages are only trusted after this much data */
+#define ABR_MIN_TOTAL_BYTES (128 * 1024)
+
+/* Buffer levels, in fragment durations, below which the buffer rule asks for
+ * the lowest bitrate and above which it asks for the highest */
+#define ABR_BUFFER_RESERVOIR 1
+#define ABR_BUFFER_CUSHION 4
+/* Highest bitrate the buffer rule asks for, relative to the throughput */
+#define ABR_BUFFER_MAX_FACTOR 1.25
+
+/* A bitrate lower than the previous one is only returned once it dropped
+ * below this share of it, unless the buffer runs low, so that small
+ * variations don't switch variants back and forth */
+#define ABR_HOLD_FACTOR 0.8
+
+typedef struct
+{
+  GstAdaptiveDemuxAbr parent;
+
+  guint64 fragment_bitrates[NUM_LOOKBACK_FRAGMENTS];
+  guint64 moving_bitrate;
+  guint moving_index;
+} GstAdaptiveDemuxAbrMovingAverage;
+
+typedef struct
+{
+  gdouble alpha;
+  gdouble estimate;
+  gdouble total_weight;
+} GstAdaptiveDemuxAbrEwma;
+
+typedef struct
+{
+  GstAdaptiveDemuxAbr parent;
+
+  GstAdaptiveDemuxAbrEwma fast;
+  GstAdaptiveDemuxAbrEwma slow;
+
+  guint64 pending_bytes;
+  GstClockTime pending_time;
+  guint64 total_bytes;
+
+  guint64 last_bitrate;
+} GstAdaptiveDemuxAbrThroughput;
+
+static void
+ewma_init (GstAdaptiveDemuxAbrEwma * ewma, gdouble half_life)
+{
+  ewma->alpha = exp (log (0.5) / half_life);
+  ewma->estimate = 0;
+  ewma->total_weight = 0;
+}
+
+static void
+ewma_sample (GstAdaptiveDemuxAbrEwma * ewma, gdouble weight, gdouble value)
+{
+  gdouble adj_alpha = pow (ewma->alpha, weight);
+
+  ewma->estimate = value * (1 - adj_alpha) + adj_alpha * ewma->estimate;
+  ewma->total_weight += weight;
+}
+
+static gdouble
+ewma_get_estimate (GstAdaptiveDemuxAbrEwma * ewma)
+{
+  /* The average starts at 0, correct for the weight it still has */
+  gdouble zero_factor = 1 - pow (ewma->alpha, ewma->total_weight);
+
+  if (zero_factor <= 0)
+    return 0;
+
+  return ewma->estimate / zero_factor;
+}
+
+static void
+moving_average_reset (GstAdaptiveDemuxAbr * abr)
+{
+  GstAdaptiveDemuxAbrMovingAverage *self =
+      (GstAdaptiveDemuxAbrMovingAverage *) abr;
+
+  memset (self->fragment_bitrates, 0, sizeof (self->fragment_bitrates));
+  self->moving_bitrate = 0;
+  self->moving_index = 0;
+}
+
+static void
+moving_average_add_chunk (GstAdaptiveDemuxAbr * abr, guint64 bytes,
+    GstClockTime duration)
+{
+  /* works on whole fragments only */
+}
+
+static guint64
+moving_average_get_bitrate (GstAdaptiveDemuxAbr * abr,
+    const GstAdaptiveDemuxAbrInput * input)
+{
+  GstAdaptiveDemuxAbrMovingAverage *self =
+      (GstAdaptiveDemuxAbrMovingAverage *) abr;
+  gint index = self->moving_index % NUM_LOOKBACK_FRAGMENTS;
+  guint64 average_bitrate;
+
+  self->moving_bitrate -= self->fragment_bitrates[index];
+  self->fragment_bitrates[index] = input->fragment_bitrate;
+  self->moving_bitrate += input->fragment_bitrate;
+  self->moving_index += 1;
+
+  if (self->moving_index > NUM_LOOKBACK_FRAGMENTS)
+    average_bitrate = self->moving_bitrate / NUM_LOOKBACK_FRAGMENTS;
+  else
+    average_bitrate = self->moving_bitrate / self->moving_index;
+
+  GST_LOG ("Last %u fragments average bitrate is %" G_GUINT64_FORMAT,
+      NUM_LOOKBACK_FRAGMENTS, average_bitrate);
+
+  /* Conservative approach, make sure we don't upgrade too fast */
+  return MIN (average_bitrate, input->fragment_bitrate) * input->bitrate_limit;
+}
+
+static void
+throughput_reset (GstAdaptiveDemuxAbr * abr)
+{
+  GstAdaptiveDemuxAbrThroughput *self = (GstAdaptiveDemuxAbrThroughput *) abr;
+
+  ewma_init (&self->fast, ABR_FAST_HALF_LIFE);
+  ewma_init (&self->slow, ABR_SLOW_HALF_LIFE);
+  self->pending_bytes = 0;
+  self->pending_time = 0;
+  self->total_bytes = 0;
+  self->last_bitrate = 0;
+}
+
+static void
+throughput_add_chunk (GstAdaptiveDemuxAbr * abr, guint64 bytes,
+    GstClockTime duration)
+{
+  GstAdaptiveDemuxAbrThroughput *self = (GstAdaptiveDemuxAbrThroughput *) abr;
+  gdouble seconds, bitrate;
+
+  self->pending_bytes += bytes;
+  self->pending_time += duration;
+
+  if (self->pending_bytes < ABR_MIN_SAMPLE_BYTES || self->pending_time == 0)
+    return;
+
+  seconds = (gdouble) self->pending_time / GST_SECOND;
+  bitrate = self->pending_bytes * 8 / seconds;
+
+  ewma_sample (&self->fast, seconds, bitrate);
+  ewma_sample (&self->slow, seconds, bitrate);
+  self->total_bytes += self->pending_bytes;
+
+  self->pending_bytes = 0;
+  self->pending_time = 0;
+}
+
+/* Estimated bandwidth, before applying the bitrate limit */
+static guint64
+throughput_get_estimate (GstAdaptiveDemuxAbrThroughput * self,
+    const GstAdaptiveDemuxAbrInput * input, gboolean long_term)
+{
+  gdouble fast, slow;
+
+  if (self->total_bytes < ABR_MIN_TOTAL_BYTES)
+    return input->fragment_bitrate;
+
+  fast = ewma_get_estimate (&self->fast);
+  slow = ewma_get_estimate (&self->slow);
+
+  GST_LOG ("Throughput estimates: fast %.0f slow %.0f", fast, slow);
+
+  if (long_term)
+    return slow;
+
+  return MIN (fast, slow);
+}
+
+static guint64
+throughput_rule (GstAdaptiveDemuxAbrThroughput * self,
+    const GstAdaptiveDemuxAbrInput * input)
+{
+  return throughput_get_estimate (self, input, FALSE) * input->bitrate_limit;
+}
+
+static gboolean
+buffer_level_is_valid (const GstAdaptiveDemuxAbrInput * input)
+{
+  return GST_CLOCK_TIME_IS_VALID (input->buffer_level) &&
+      GST_CLOCK_TIME_IS_VALID (input->fragment_duration) &&
+      input->fragment_duration > 0;
+}
+
+static guint64
+hold_bitrate (GstAdaptiveDemuxAbrThroughput * self,
+    const GstAdaptiveDemuxAbrInput * input, guint64 bitrate)
+{
+  if (bitrate < self->last_bitrate &&
+      bitrate >= self->last_bitrate * ABR_HOLD_FACTOR &&
+      (!buffer_level_is_valid (input) ||
+          input->buffer_level >
+          (ABR_BUFFER_RESERVOIR + 1) * input->fragment_duration)) {
+    GST_LOG ("Holding bitrate %" G_GUINT64_FORMAT " instead of %"
+        G_GUINT64_FORMAT, self->last_bitrate, bitrate);
+    return self->last_bitrate;
+  }
+
+  self->last_bitrate = bitrate;
+  return bitrate;
+}
+
+static guint64
+buffer_rule (GstAdaptiveDemuxAbrThroughput * self,
+    const GstAdaptiveDemuxAbrInput * input)
+{
+  gdouble level, factor;
+
+  level = (gdouble) input->buffer_level / input->fragment_duration;
+  factor = ABR_BUFFER_MAX_FACTOR * (level - ABR_BUFFER_RESERVOIR) /
+      ABR_BUFFER_CUSHION;
+  factor = CLAMP (factor, 0, ABR_BUFFER_MAX_FACTOR);
+
+  GST_LOG ("Buffer level %.2f fragments, factor %.2f", level, factor);
+
+  return throughput_get_estimate (self, input, TRUE) * factor *
+      input->bitrate_limit;
+}
+
+static guint64
+throughput_get_bitrate (GstAdaptiveDemuxAbr * abr,
+    const GstAdaptiveDemuxAbrInput * input)
+{
+  GstAdaptiveDemuxAbrThroughput *self = (GstAdaptiveDemuxAbrThroughput *) abr;
+
+  return hold_bitrate (self, input, throughput_rule (self, input));
+}
+
+static guint64
+buffer_get_bitrate (GstAdaptiveDemuxAbr * abr,
+    const GstAdaptiveDemuxAbrInput * input)
+{
+  GstAdaptiveDemuxAbrThroughput *self = (GstAdaptiveDemuxAbrThroughput *) abr;
+
+  if (!buffer_level_is_valid (input))
+    return throughput_get_bitrate (abr, input);
+
+  return hold_bitrate (self, input, buffer_rule (self, input));
+}
+
+static guint64
+hybrid_get_bitrate (GstAdaptiveDemuxAbr * abr,
+    const GstAdaptiveDemuxAbrInput * input)
+{
+  GstAdaptiveDemuxAbrThroughput *self = (GstAdaptiveDemuxAbrThroughput *) abr;
+  guint64 throughput_bitrate, buffer_bitrate;
+  gdouble level, factor;
+
+  if (!buffer_level_is_valid (input))
+    return throughput_get_bitrate (abr, input);
+
+  throughput_bitrate = throughput_rule (self, input);
+
+  /* Downloading a fragment at the throughput rule bitrate takes about as long
+   * as the fragment lasts, at a higher bitrate the buffer drains. Stay above
+   * the reservoir once the next fragment is in. */
+  level = (gdouble) input->buffer_level / input->fragment_duration;
+  factor = CLAMP (level - ABR_BUFFER_RESERVOIR + 1, 0, 1);
+  throughput_bitrate *= factor;
+
+  buffer_bitrate = buffer_rule (self, input);
+
+  GST_LOG ("Throughput rule %" G_GUINT64_FORMAT ", buffer rule %"
+      G_GUINT64_FORMAT, throughput_bitrate, buffer_bitrate);
+
+  return hold_bitrate (self, input, MAX (throughput_bitrate, buffer_bitrate));
+}
+
+static const GstAdaptiveDemuxAbrFuncs abr_algorithms[] = {
+  {GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE, "moving-average",
+        sizeof (GstAdaptiveDemuxAbrMovingAverage),
+        moving_average_reset, moving_average_add_chunk,
+      moving_average_get_bitrate},
+  {GST_ADAPTIVE_DEMUX_ABR_THROUGHPUT, "throughput",
+        sizeof (GstAdaptiveDemuxAbrThroughput),
+        throughput_reset, throughput_add_chunk,
+      throughput_get_bitrate},
+  {GST_ADAPTIVE_DEMUX_ABR_BUFFER, "buffer",
+        sizeof (GstAdaptiveDemuxAbrThroughput),
+        throughput_reset, throughput_add_chunk,
+      buffer_get_bitrate},
+  {GST_ADAPTIVE_DEMUX_ABR_HYBRID, "hybrid",
+        sizeof (GstAdaptiveDemuxAbrThroughput),
+        throughput_reset, throughput_add_chunk,
+      hybrid_get_bitrate},
+};
+
+GstAdaptiveDemuxAbr *
+gst_adaptive_demux_abr_new (GstAdaptiveDemuxAbrAlgorithm algorithm)
+{
+  const GstAdaptiveDemuxAbrFuncs *funcs = NULL;
+  GstAdaptiveDemuxAbr *abr;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (abr_algorithms); i++) {
+    if (abr_algorithms[i].algorithm == algorithm) {
+      funcs = &abr_algorithms[i];
+      break;
+    }
+  }
+  g_return_val_if_fail (funcs != NULL, NULL);
+
+  abr = g_malloc0 (funcs->size);
+  abr->funcs = funcs;
+  funcs->reset (abr);
+
+  GST_DEBUG ("Created %s ABR", funcs->name);
+
+  return abr;
+}
+
+void
+gst_adaptive_demux_abr_free (GstAdaptiveDemuxAbr * abr)
+{
+  g_free (abr);
+}
+
+void
+gst_adaptive_demux_abr_reset (GstAdaptiveDemuxAbr * abr)
+{
+  abr->funcs->reset (abr);
+}
+
+GstAdaptiveDemuxAbrAlgorithm
+gst_adaptive_demux_abr_get_algorithm (GstAdaptiveDemuxAbr * abr)
+{
+  return abr->funcs->algorithm;
+}
+
+/* Called for every chunk of data received, with the time since the previous
+ * chunk or since the request for the first one */
+void
+gst_adaptive_demux_abr_add_chunk (GstAdaptiveDemuxAbr * abr, guint64 bytes,
+    GstClockTime duration)
+{
+  abr->funcs->add_chunk (abr, bytes, duration);
+}
+
+/* Called once per fragment, returns the bitrate to choose the next fragment
+ * with */
+guint64
+gst_adaptive_demux_abr_get_bitrate (GstAdaptiveDemuxAbr * abr,
+    const GstAdaptiveDemuxAbrInput * input)
+{
+  return abr->funcs->get_bitrate (abr, input);
+}
@@ -0,0 +1,89 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_ADAPTIVE_DEMUX_ABR_H__
+#define __GST_ADAPTIVE_DEMUX_ABR_H__
+
+#include <gst/gst.h>
+#include "gstadaptivedemux.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstAdaptiveDemuxAbrFuncs GstAdaptiveDemuxAbrFuncs;
+typedef struct _GstAdaptiveDemuxAbrInput GstAdaptiveDemuxAbrInput;
+
+/* What is known about a stream when choosing the bitrate of its next
+ * fragment */
+struct _GstAdaptiveDemuxAbrInput
+{
+  /* download rate of the last fragment, from request to EOS */
+  guint64 fragment_bitrate;
+  /* duration of the last fragment, or GST_CLOCK_TIME_NONE */
+  GstClockTime fragment_duration;
+  /* data queued downstream and not played yet, or GST_CLOCK_TIME_NONE */
+  GstClockTime buffer_level;
+  /* share of the estimated bandwidth that may be used */
+  gfloat bitrate_limit;
+};
+
+/* An ABR algorithm. Downloaded chunks are fed as they arrive from the
+ * network, and once per fragment the algorithm is asked for the bitrate
+ * subclasses choose the next variant with. */
+struct _GstAdaptiveDemuxAbrFuncs
+{
+  GstAdaptiveDemuxAbrAlgorithm algorithm;
+  const gchar *name;
+  gsize size;
+
+  void (*reset) (GstAdaptiveDemuxAbr * abr);
+  void (*add_chunk) (GstAdaptiveDemuxAbr * abr, guint64 bytes,
+      GstClockTime duration);
+  guint64 (*get_bitrate) (GstAdaptiveDemuxAbr * abr,
+      const GstAdaptiveDemuxAbrInput * input);
+};
+
+struct _GstAdaptiveDemuxAbr
+{
+  const GstAdaptiveDemuxAbrFuncs *funcs;
+};
+
+G_GNUC_INTERNAL
+GstAdaptiveDemuxAbr *gst_adaptive_demux_abr_new (GstAdaptiveDemuxAbrAlgorithm
+    algorithm);
+
+G_GNUC_INTERNAL
+void gst_adaptive_demux_abr_free (GstAdaptiveDemuxAbr * abr);
+
+G_GNUC_INTERNAL
+void gst_adaptive_demux_abr_reset (GstAdaptiveDemuxAbr * abr);
+
+G_GNUC_INTERNAL
+GstAdaptiveDemuxAbrAlgorithm
+gst_adaptive_demux_abr_get_algorithm (GstAdaptiveDemuxAbr * abr);
+
+G_GNUC_INTERNAL
+void gst_adaptive_demux_abr_add_chunk (GstAdaptiveDemuxAbr * abr,
+    guint64 bytes, GstClockTime duration);
+
+G_GNUC_INTERNAL
+guint64 gst_adaptive_demux_abr_get_bitrate (GstAdaptiveDemuxAbr * abr,
+    const GstAdaptiveDemuxAbrInput * input);
+
+G_END_DECLS
+
+#endif /* __GST_ADAPTIVE_DEMUX_ABR_H__ */
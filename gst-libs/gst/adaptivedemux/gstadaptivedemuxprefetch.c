@@ -0,0 +1,427 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Fragment prefetching for adaptivedemux.
+ *
+ * Streams request the fragments that follow the one they are downloading,
+ * each request is run by a worker thread with a downloader taken from a pool
+ * shared by all streams. Downloaders are returned to the pool after each
+ * request and keep their source element, so HTTP connections stay alive
+ * from one fragment to the next. The source elements also get the parent's
+ * contexts, which lets souphttpsrc share one session, and its connections,
+ * with the other streams and the manifest downloader.
+ *
+ * Finished downloads are kept until the stream takes them. The bytes of all
+ * entries, finished or not, are accounted against a budget shared by all
+ * streams: requests are refused once the expected size doesn't fit anymore,
+ * and downloads that turn out too large are dropped, the stream then
+ * downloads those fragments itself.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/uridownloader/gsturidownloader.h>
+
+#include "gstadaptivedemuxprefetch.h"
+
+GST_DEBUG_CATEGORY_EXTERN (adaptivedemux_debug);
+#define GST_CAT_DEFAULT adaptivedemux_debug
+
+typedef enum
+{
+  PREFETCH_STATE_QUEUED,
+  PREFETCH_STATE_DOWNLOADING,
+  PREFETCH_STATE_DONE,
+  PREFETCH_STATE_FAILED
+} GstAdaptiveDemuxPrefetchState;
+
+typedef struct
+{
+  gint ref_count;
+
+  gpointer owner;
+  gchar *uri;
+  gchar *referer;
+  gint64 range_start;
+  gint64 range_end;
+
+  GstAdaptiveDemuxPrefetchState state;
+  gboolean cancelled;
+  GstUriDownloader *downloader;
+
+  GstBuffer *buffer;
+  GstClockTime download_time;
+  /* bytes accounted against the budget */
+  guint64 size;
+} GstAdaptiveDemuxPrefetchEntry;
+
+struct _GstAdaptiveDemuxPrefetch
+{
+  GstElement *parent;
+
+  GMutex lock;
+  GCond cond;
+
+  GThreadPool *pool;
+  /* downloaders not in use */
+  GQueue downloaders;
+  /* entries not taken yet, in request order */
+  GQueue entries;
+
+  guint64 size;
+  guint64 max_size;
+};
+
+/* must be called with the prefetch lock taken */
+static void
+prefetch_entry_unref (GstAdaptiveDemuxPrefetch * prefetch,
+    GstAdaptiveDemuxPrefetchEntry * entry)
+{
+  if (--entry->ref_count > 0)
+    return;
+
+  prefetch->size -= entry->size;
+  if (entry->buffer)
+    gst_buffer_unref (entry->buffer);
+  g_free (entry->uri);
+  g_free (entry->referer);
+  g_free (entry);
+}
+
+/* must be called with the prefetch lock taken */
+static GstAdaptiveDemuxPrefetchEntry *
+prefetch_find_entry (GstAdaptiveDemuxPrefetch * prefetch, gpointer owner,
+    const gchar * uri, gint64 range_start, gint64 range_end)
+{
+  GList *iter;
+
+  for (iter = prefetch->entries.head; iter; iter = iter->next) {
+    GstAdaptiveDemuxPrefetchEntry *entry = iter->data;
+
+    if (entry->owner == owner && entry->range_start == range_start
+        && entry->range_end == range_end && g_str_equal (entry->uri, uri))
+      return entry;
+  }
+
+  return NULL;
+}
+
+/* Cancels and forgets the entries of @owner, or of everyone if %NULL, up to
+ * @until or all of them if %NULL.
+ * must be called with the prefetch lock taken */
+static void
+prefetch_drop_entries (GstAdaptiveDemuxPrefetch * prefetch, gpointer owner,
+    GstAdaptiveDemuxPrefetchEntry * until)
+{
+  GList *iter, *next;
+
+  for (iter = prefetch->entries.head; iter; iter = next) {
+    GstAdaptiveDemuxPrefetchEntry *entry = iter->data;
+
+    next = iter->next;
+    if (entry == until)
+      break;
+    if (owner && entry->owner != owner)
+      continue;
+
+    GST_DEBUG_OBJECT (prefetch->parent, "Dropping prefetch of %s %"
+        G_GINT64_FORMAT "-%" G_GINT64_FORMAT, entry->uri, entry->range_start,
+        entry->range_end);
+
+    entry->cancelled = TRUE;
+    if (entry->downloader)
+      gst_uri_downloader_cancel (entry->downloader);
+
+    g_queue_delete_link (&prefetch->entries, iter);
+    prefetch_entry_unref (prefetch, entry);
+  }
+
+  g_cond_broadcast (&prefetch->cond);
+}
+
+static void
+prefetch_download (GstAdaptiveDemuxPrefetchEntry * entry,
+    GstAdaptiveDemuxPrefetch * prefetch)
+{
+  GstUriDownloader *downloader;
+  GstFragment *download = NULL;
+  GstBuffer *buffer = NULL;
+  GstClockTime download_time = 0;
+  gboolean cancelled;
+
+  g_mutex_lock (&prefetch->lock);
+  if (entry->cancelled) {
+    prefetch_entry_unref (prefetch, entry);
+    g_mutex_unlock (&prefetch->lock);
+    return;
+  }
+  downloader = g_queue_pop_head (&prefetch->downloaders);
+  g_mutex_unlock (&prefetch->lock);
+
+  if (downloader == NULL) {
+    downloader = gst_uri_downloader_new ();
+    gst_uri_downloader_set_parent (downloader, prefetch->parent);
+  }
+
+  /* The entry might have been cancelled before it had a downloader to
+   * cancel */
+  g_mutex_lock (&prefetch->lock);
+  entry->downloader = downloader;
+  entry->state = PREFETCH_STATE_DOWNLOADING;
+  cancelled = entry->cancelled;
+  g_mutex_unlock (&prefetch->lock);
+
+  if (!cancelled) {
+    GError *err = NULL;
+    gint64 start = g_get_monotonic_time ();
+
+    GST_DEBUG_OBJECT (prefetch->parent, "Prefetching %s %" G_GINT64_FORMAT
+        "-%" G_GINT64_FORMAT, entry->uri, entry->range_start,
+        entry->range_end);
+
+    download = gst_uri_downloader_fetch_uri_with_range (downloader,
+        entry->uri, entry->referer, FALSE, FALSE, TRUE, entry->range_start,
+        entry->range_end, &err);
+    download_time = (g_get_monotonic_time () - start) * GST_USECOND;
+
+    if (download) {
+      buffer = gst_fragment_get_buffer (download);
+      g_object_unref (download);
+    } else {
+      GST_DEBUG_OBJECT (prefetch->parent, "Prefetching %s failed: %s",
+          entry->uri, err ? err->message : "unknown error");
+      g_clear_error (&err);
+    }
+  }
+
+  g_mutex_lock (&prefetch->lock);
+  entry->downloader = NULL;
+  /* A cancel might have come in after the download was done */
+  gst_uri_downloader_reset (downloader);
+  g_queue_push_head (&prefetch->downloaders, downloader);
+
+  /* Account for the actual size instead of the expected one */
+  prefetch->size -= entry->size;
+  entry->size = 0;
+
+  if (buffer && !entry->cancelled) {
+    gsize size = gst_buffer_get_size (buffer);
+
+    if (prefetch->size + size <= prefetch->max_size) {
+      entry->buffer = buffer;
+      entry->download_time = download_time;
+      entry->size = size;
+      prefetch->size += size;
+      buffer = NULL;
+    } else {
+      GST_DEBUG_OBJECT (prefetch->parent, "Prefetched %" G_GSIZE_FORMAT
+          " bytes of %s don't fit in the cache, %" G_GUINT64_FORMAT " of %"
+          G_GUINT64_FORMAT " bytes used", size, entry->uri, prefetch->size,
+          prefetch->max_size);
+    }
+  }
+
+  entry->state = entry->buffer ? PREFETCH_STATE_DONE : PREFETCH_STATE_FAILED;
+  g_cond_broadcast (&prefetch->cond);
+  prefetch_entry_unref (prefetch, entry);
+  g_mutex_unlock (&prefetch->lock);
+
+  if (buffer)
+    gst_buffer_unref (buffer);
+}
+
+GstAdaptiveDemuxPrefetch *
+gst_adaptive_demux_prefetch_new (GstElement * parent)
+{
+  GstAdaptiveDemuxPrefetch *prefetch = g_new0 (GstAdaptiveDemuxPrefetch, 1);
+
+  prefetch->parent = parent;
+  g_mutex_init (&prefetch->lock);
+  g_cond_init (&prefetch->cond);
+  g_queue_init (&prefetch->downloaders);
+  g_queue_init (&prefetch->entries);
+  prefetch->pool = g_thread_pool_new ((GFunc) prefetch_download, prefetch,
+      -1, FALSE, NULL);
+
+  return prefetch;
+}
+
+void
+gst_adaptive_demux_prefetch_free (GstAdaptiveDemuxPrefetch * prefetch)
+{
+  g_mutex_lock (&prefetch->lock);
+  prefetch_drop_entries (prefetch, NULL, NULL);
+  g_mutex_unlock (&prefetch->lock);
+
+  /* wait for the running downloads to be cancelled */
+  g_thread_pool_free (prefetch->pool, FALSE, TRUE);
+
+  g_queue_foreach (&prefetch->downloaders, (GFunc) gst_object_unref, NULL);
+  g_queue_clear (&prefetch->downloaders);
+  g_mutex_clear (&prefetch->lock);
+  g_cond_clear (&prefetch->cond);
+  g_free (prefetch);
+}
+
+/* Bytes all prefetched data may use */
+void
+gst_adaptive_demux_prefetch_set_max_size (GstAdaptiveDemuxPrefetch * prefetch,
+    guint64 max_size)
+{
+  g_mutex_lock (&prefetch->lock);
+  prefetch->max_size = max_size;
+  g_mutex_unlock (&prefetch->lock);
+}
+
+guint64
+gst_adaptive_demux_prefetch_get_max_size (GstAdaptiveDemuxPrefetch * prefetch)
+{
+  guint64 max_size;
+
+  g_mutex_lock (&prefetch->lock);
+  max_size = prefetch->max_size;
+  g_mutex_unlock (&prefetch->lock);
+
+  return max_size;
+}
+
+/* Starts downloading a fragment for @owner, unless it was already requested.
+ * @expected_size is reserved from the budget until the download is done,
+ * returns %FALSE if it doesn't fit. */
+gboolean
+gst_adaptive_demux_prefetch_request (GstAdaptiveDemuxPrefetch * prefetch,
+    gpointer owner, const gchar * uri, const gchar * referer,
+    gint64 range_start, gint64 range_end, guint64 expected_size)
+{
+  GstAdaptiveDemuxPrefetchEntry *entry;
+
+  g_return_val_if_fail (uri != NULL, FALSE);
+
+  g_mutex_lock (&prefetch->lock);
+  if (prefetch_find_entry (prefetch, owner, uri, range_start, range_end)) {
+    g_mutex_unlock (&prefetch->lock);
+    return TRUE;
+  }
+
+  if (prefetch->size + expected_size > prefetch->max_size) {
+    GST_LOG_OBJECT (prefetch->parent, "Not prefetching %s, %" G_GUINT64_FORMAT
+        " of %" G_GUINT64_FORMAT " bytes used", uri, prefetch->size,
+        prefetch->max_size);
+    g_mutex_unlock (&prefetch->lock);
+    return FALSE;
+  }
+
+  entry = g_new0 (GstAdaptiveDemuxPrefetchEntry, 1);
+  /* one for the list, one for the download */
+  entry->ref_count = 2;
+  entry->owner = owner;
+  entry->uri = g_strdup (uri);
+  entry->referer = g_strdup (referer);
+  entry->range_start = range_start;
+  entry->range_end = range_end;
+  entry->state = PREFETCH_STATE_QUEUED;
+  entry->size = expected_size;
+  prefetch->size += expected_size;
+  g_queue_push_tail (&prefetch->entries, entry);
+  g_mutex_unlock (&prefetch->lock);
+
+  g_thread_pool_push (prefetch->pool, entry, NULL);
+
+  return TRUE;
+}
+
+/* Drops the fragments @owner requested before this one, or all of them if
+ * it didn't request this one: the stream moved on to other fragments,
+ * because of a bitrate switch for example. Returns whether this one was
+ * requested. */
+gboolean
+gst_adaptive_demux_prefetch_retain (GstAdaptiveDemuxPrefetch * prefetch,
+    gpointer owner, const gchar * uri, gint64 range_start, gint64 range_end)
+{
+  GstAdaptiveDemuxPrefetchEntry *entry;
+
+  g_return_val_if_fail (uri != NULL, FALSE);
+
+  g_mutex_lock (&prefetch->lock);
+  entry = prefetch_find_entry (prefetch, owner, uri, range_start, range_end);
+  prefetch_drop_entries (prefetch, owner, entry);
+  g_mutex_unlock (&prefetch->lock);
+
+  return entry != NULL;
+}
+
+/* Returns the data of a fragment requested by @owner, waiting for the
+ * download to finish if needed, or %NULL if it wasn't requested, failed or
+ * was cancelled. */
+GstBuffer *
+gst_adaptive_demux_prefetch_take (GstAdaptiveDemuxPrefetch * prefetch,
+    gpointer owner, const gchar * uri, gint64 range_start, gint64 range_end,
+    GstClockTime * download_time)
+{
+  GstAdaptiveDemuxPrefetchEntry *entry;
+  GstBuffer *buffer = NULL;
+
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  g_mutex_lock (&prefetch->lock);
+  entry = prefetch_find_entry (prefetch, owner, uri, range_start, range_end);
+  if (entry == NULL) {
+    g_mutex_unlock (&prefetch->lock);
+    return NULL;
+  }
+
+  entry->ref_count++;
+  while (!entry->cancelled && entry->state != PREFETCH_STATE_DONE
+      && entry->state != PREFETCH_STATE_FAILED) {
+    GST_LOG_OBJECT (prefetch->parent, "Waiting for the prefetch of %s",
+        entry->uri);
+    g_cond_wait (&prefetch->cond, &prefetch->lock);
+  }
+
+  if (!entry->cancelled) {
+    if (entry->buffer) {
+      buffer = entry->buffer;
+      entry->buffer = NULL;
+      prefetch->size -= entry->size;
+      entry->size = 0;
+      if (download_time)
+        *download_time = entry->download_time;
+    }
+
+    g_queue_remove (&prefetch->entries, entry);
+    prefetch_entry_unref (prefetch, entry);
+  }
+  prefetch_entry_unref (prefetch, entry);
+  g_mutex_unlock (&prefetch->lock);
+
+  return buffer;
+}
+
+/* Cancels the downloads of @owner, or of everyone if %NULL, and drops what
+ * was prefetched for it. Wakes up anyone waiting in
+ * gst_adaptive_demux_prefetch_take() for these. */
+void
+gst_adaptive_demux_prefetch_cancel (GstAdaptiveDemuxPrefetch * prefetch,
+    gpointer owner)
+{
+  g_mutex_lock (&prefetch->lock);
+  prefetch_drop_entries (prefetch, owner, NULL);
+  g_mutex_unlock (&prefetch->lock);
+}
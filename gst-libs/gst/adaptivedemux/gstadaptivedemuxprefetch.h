@@ -0,0 +1,68 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_ADAPTIVE_DEMUX_PREFETCH_H__
+#define __GST_ADAPTIVE_DEMUX_PREFETCH_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Downloads fragments ahead of the streams that will need them and keeps
+ * the data until they do. The downloaders are shared by all streams and
+ * reused, so that their connections are kept alive between requests. All
+ * functions are thread safe. */
+typedef struct _GstAdaptiveDemuxPrefetch GstAdaptiveDemuxPrefetch;
+
+G_GNUC_INTERNAL
+GstAdaptiveDemuxPrefetch *gst_adaptive_demux_prefetch_new (GstElement *
+    parent);
+
+G_GNUC_INTERNAL
+void gst_adaptive_demux_prefetch_free (GstAdaptiveDemuxPrefetch * prefetch);
+
+G_GNUC_INTERNAL
+void gst_adaptive_demux_prefetch_set_max_size (GstAdaptiveDemuxPrefetch *
+    prefetch, guint64 max_size);
+
+G_GNUC_INTERNAL
+guint64 gst_adaptive_demux_prefetch_get_max_size (GstAdaptiveDemuxPrefetch *
+    prefetch);
+
+G_GNUC_INTERNAL
+gboolean gst_adaptive_demux_prefetch_request (GstAdaptiveDemuxPrefetch *
+    prefetch, gpointer owner, const gchar * uri, const gchar * referer,
+    gint64 range_start, gint64 range_end, guint64 expected_size);
+
+G_GNUC_INTERNAL
+gboolean gst_adaptive_demux_prefetch_retain (GstAdaptiveDemuxPrefetch *
+    prefetch, gpointer owner, const gchar * uri, gint64 range_start,
+    gint64 range_end);
+
+G_GNUC_INTERNAL
+GstBuffer *gst_adaptive_demux_prefetch_take (GstAdaptiveDemuxPrefetch *
+    prefetch, gpointer owner, const gchar * uri, gint64 range_start,
+    gint64 range_end, GstClockTime * download_time);
+
+G_GNUC_INTERNAL
+void gst_adaptive_demux_prefetch_cancel (GstAdaptiveDemuxPrefetch * prefetch,
+    gpointer owner);
+
+G_END_DECLS
+
+#endif /* __GST_ADAPTIVE_DEMUX_PREFETCH_H__ */
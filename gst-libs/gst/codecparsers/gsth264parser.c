@@ -3267,84 +3267,37 @@ gst_h264_create_sei_memory_avc (guint8 nal_length_size, GArray * messages)
   return gst_h264_create_sei_memory_internal (nal_length_size, TRUE, messages);
 }
 
+static gboolean
+gst_h264_nal_header_is_slice (const guint8 * header)
+{
+  guint8 type = header[0] & 0x1f;
+
+  return (type >= GST_H264_NAL_SLICE && type <= GST_H264_NAL_SLICE_IDR)
+      || (type >= GST_H264_NAL_SLICE_AUX && type <= GST_H264_NAL_SLICE_DEPTH);
+}
+
 static GstBuffer *
 gst_h264_parser_insert_sei_internal (GstH264NalParser * nalparser,
     guint8 nal_prefix_size, gboolean packetized, GstBuffer * au,
     GstMemory * sei)
 {
-  GstH264NalUnit nalu;
-  GstMapInfo info;
-  GstH264ParserResult pres;
-  guint offset = 0;
-  GstBuffer *new_buffer = NULL;
+  guint8 header;
+  gssize offset;
 
-  if (!gst_buffer_map (au, &info, GST_MAP_READ)) {
-    GST_ERROR ("Cannot map au buffer");
+  /* Find the offset of the first slice. The AU isn't mapped, the SEI memory
+   * is spliced in between its memories so that nothing but the SEI, which
+   * is already escaped, is written. */
+  offset = nal_find_first_slice (au, nal_prefix_size, packetized, 1,
+      gst_h264_nal_header_is_slice, &header);
+  if (offset < 0) {
+    GST_DEBUG ("Failed to find a nal unit");
     return NULL;
   }
 
-  /* Find the offset of the first slice */
-  do {
-    if (packetized) {
-      pres = gst_h264_parser_identify_nalu_avc (nalparser,
-          info.data, offset, info.size, nal_prefix_size, &nalu);
-    } else {
-      pres = gst_h264_parser_identify_nalu (nalparser,
-          info.data, offset, info.size, &nalu);
-    }
-
-    if (pres != GST_H264_PARSER_OK && pres != GST_H264_PARSER_NO_NAL_END) {
-      GST_DEBUG ("Failed to identify nal unit, ret: %d", pres);
-      gst_buffer_unmap (au, &info);
-
-      return NULL;
-    }
-
-    if ((nalu.type >= GST_H264_NAL_SLICE && nalu.type <= GST_H264_NAL_SLICE_IDR)
-        || (nalu.type >= GST_H264_NAL_SLICE_AUX
-            && nalu.type <= GST_H264_NAL_SLICE_DEPTH)) {
-      GST_DEBUG ("Found slice nal type %d at offset %d",
-          nalu.type, nalu.sc_offset);
-      break;
-    }
-
-    offset = nalu.offset + nalu.size;
-  } while (pres == GST_H264_PARSER_OK);
-  gst_buffer_unmap (au, &info);
-
-  /* found the best position now, create new buffer */
-  new_buffer = gst_buffer_new ();
-
-  /* copy all metadata */
-  if (!gst_buffer_copy_into (new_buffer, au, GST_BUFFER_COPY_METADATA, 0, -1)) {
-    GST_ERROR ("Failed to copy metadata into new buffer");
-    gst_clear_buffer (&new_buffer);
-    goto out;
-  }
-
-  /* copy non-slice nal */
-  if (nalu.sc_offset > 0) {
-    if (!gst_buffer_copy_into (new_buffer, au,
-            GST_BUFFER_COPY_MEMORY, 0, nalu.sc_offset)) {
-      GST_ERROR ("Failed to copy buffer");
-      gst_clear_buffer (&new_buffer);
-      goto out;
-    }
-  }
-
-  /* insert sei */
-  gst_buffer_append_memory (new_buffer, gst_memory_ref (sei));
-
-  /* copy the rest */
-  if (!gst_buffer_copy_into (new_buffer, au,
-          GST_BUFFER_COPY_MEMORY, nalu.sc_offset, -1)) {
-    GST_ERROR ("Failed to copy buffer");
-    gst_clear_buffer (&new_buffer);
-    goto out;
-  }
+  GST_DEBUG ("Found nal type %d at offset %" G_GSSIZE_FORMAT, header & 0x1f,
+      offset);
 
-out:
-  return new_buffer;
+  return nal_insert_memory (au, offset, sei);
 }
 
 /**
@@ -3354,6 +3307,7 @@ out:
  * @sei: (transfer none): a #GstMemory containing a SEI nal
  *
  * Copy @au into new #GstBuffer and insert @sei into the #GstBuffer.
+ * The memories of @au are shared with the new #GstBuffer, not copied.
  * The validation for completeness of @au and @sei is caller's responsibility.
  * Both @au and @sei must be byte-stream formatted
  *
@@ -3383,6 +3337,7 @@ gst_h264_parser_insert_sei (GstH264NalParser * nalparser, GstBuffer * au,
  * @sei: (transfer none): a #GstMemory containing a SEI nal
  *
  * Copy @au into new #GstBuffer and insert @sei into the #GstBuffer.
+ * The memories of @au are shared with the new #GstBuffer, not copied.
  * The validation for completeness of @au and @sei is caller's responsibility.
  * Nal prefix type of both @au and @sei must be packetized, and
  * also the size of nal length field must be identical to @nal_length_size
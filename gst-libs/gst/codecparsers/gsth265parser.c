@@ -4110,19 +4110,29 @@ gst_h265_create_sei_memory_hevc (guint8 layer_id, guint8 temporal_id_plus1,
       nal_length_size, TRUE, messages);
 }
 
+static gboolean
+gst_h265_nal_header_is_slice (const guint8 * header)
+{
+  guint8 type = (header[0] >> 1) & 0x3f;
+
+  return type <= GST_H265_NAL_SLICE_RASL_R
+      || (type >= GST_H265_NAL_SLICE_BLA_W_LP
+      && type <= GST_H265_NAL_SLICE_CRA_NUT);
+}
+
 static GstBuffer *
 gst_h265_parser_insert_sei_internal (GstH265Parser * parser,
     guint8 nal_prefix_size, gboolean packetized, GstBuffer * au,
     GstMemory * sei)
 {
-  GstH265NalUnit nalu;
   GstH265NalUnit sei_nalu;
-  GstMapInfo info;
   GstMapInfo sei_info;
   GstH265ParserResult pres;
-  guint offset = 0;
-  GstBuffer *new_buffer = NULL;
-  GstMemory *new_mem = NULL;
+  GstBuffer *new_buffer;
+  GstMemory *new_mem;
+  guint8 header[2];
+  guint8 layer_id, temporal_id_plus1;
+  gssize offset;
 
   /* all SEI payload types supported by us need to have the identical
    * temporal id to that of slice. Parse SEI first and we will
@@ -4145,65 +4155,27 @@ gst_h265_parser_insert_sei_internal (GstH265Parser * parser,
     return NULL;
   }
 
-  if (!gst_buffer_map (au, &info, GST_MAP_READ)) {
-    GST_ERROR ("Cannot map au buffer");
+  /* Find the offset of the first slice. The AU isn't mapped, the SEI memory
+   * is spliced in between its memories so that nothing but the SEI, which
+   * is already escaped, is written. */
+  offset = nal_find_first_slice (au, nal_prefix_size, packetized, 2,
+      gst_h265_nal_header_is_slice, header);
+  if (offset < 0) {
+    GST_DEBUG ("Failed to find a nal unit");
     return NULL;
   }
 
-  /* Find the offset of the first slice */
-  do {
-    if (packetized) {
-      pres = gst_h265_parser_identify_nalu_hevc (parser,
-          info.data, offset, info.size, nal_prefix_size, &nalu);
-    } else {
-      pres = gst_h265_parser_identify_nalu (parser,
-          info.data, offset, info.size, &nalu);
-    }
-
-    if (pres != GST_H265_PARSER_OK && pres != GST_H265_PARSER_NO_NAL_END) {
-      GST_DEBUG ("Failed to identify nal unit, ret: %d", pres);
-      gst_buffer_unmap (au, &info);
+  GST_DEBUG ("Found nal type %d at offset %" G_GSSIZE_FORMAT,
+      (header[0] >> 1) & 0x3f, offset);
 
-      return NULL;
-    }
-
-    if (nalu.type <= GST_H265_NAL_SLICE_RASL_R
-        || (nalu.type >= GST_H265_NAL_SLICE_BLA_W_LP
-            && nalu.type <= GST_H265_NAL_SLICE_CRA_NUT)) {
-      GST_DEBUG ("Found slice nal type %d at offset %d", nalu.type,
-          nalu.sc_offset);
-      break;
-    }
-
-    offset = nalu.offset + nalu.size;
-  } while (pres == GST_H265_PARSER_OK);
-  gst_buffer_unmap (au, &info);
-
-  /* found the best position now, create new buffer */
-  new_buffer = gst_buffer_new ();
-
-  /* copy all metadata */
-  if (!gst_buffer_copy_into (new_buffer, au, GST_BUFFER_COPY_METADATA, 0, -1)) {
-    GST_ERROR ("Failed to copy metadata into new buffer");
-    gst_clear_buffer (&new_buffer);
-    goto out;
-  }
-
-  /* copy non-slice nal */
-  if (nalu.sc_offset > 0) {
-    if (!gst_buffer_copy_into (new_buffer, au,
-            GST_BUFFER_COPY_MEMORY, 0, nalu.sc_offset)) {
-      GST_ERROR ("Failed to copy buffer");
-      gst_clear_buffer (&new_buffer);
-      goto out;
-    }
-  }
+  layer_id = ((header[0] & 0x01) << 5) | (header[1] >> 3);
+  temporal_id_plus1 = header[1] & 0x07;
 
   /* check whether we need to update temporal id and layer id.
    * If it's not matched to slice nalu, update it.
    */
-  if (sei_nalu.layer_id != nalu.layer_id || sei_nalu.temporal_id_plus1 !=
-      nalu.temporal_id_plus1) {
+  if (sei_nalu.layer_id != layer_id
+      || sei_nalu.temporal_id_plus1 != temporal_id_plus1) {
     guint16 nalu_header;
     guint16 layer_id_temporal_id = 0;
     new_mem = gst_memory_copy (sei, 0, -1);
@@ -4211,8 +4183,7 @@ gst_h265_parser_insert_sei_internal (GstH265Parser * parser,
     if (!gst_memory_map (new_mem, &sei_info, GST_MAP_READWRITE)) {
       GST_ERROR ("Failed to map new sei memory");
       gst_memory_unref (new_mem);
-      gst_clear_buffer (&new_buffer);
-      goto out;
+      return NULL;
     }
 
     nalu_header = GST_READ_UINT16_BE (sei_info.data + sei_nalu.offset);
@@ -4223,8 +4194,8 @@ gst_h265_parser_insert_sei_internal (GstH265Parser * parser,
      * bits 1 ~ 6: nalu type */
     nalu_header &= 0xfe00;
 
-    layer_id_temporal_id = ((nalu.layer_id << 3) & 0x1f8);
-    layer_id_temporal_id |= (nalu.temporal_id_plus1 & 0x7);
+    layer_id_temporal_id = ((layer_id << 3) & 0x1f8);
+    layer_id_temporal_id |= (temporal_id_plus1 & 0x7);
 
     nalu_header |= layer_id_temporal_id;
     GST_WRITE_UINT16_BE (sei_info.data + sei_nalu.offset, nalu_header);
@@ -4234,17 +4205,9 @@ gst_h265_parser_insert_sei_internal (GstH265Parser * parser,
   }
 
   /* insert sei */
-  gst_buffer_append_memory (new_buffer, new_mem);
-
-  /* copy the rest */
-  if (!gst_buffer_copy_into (new_buffer, au,
-          GST_BUFFER_COPY_MEMORY, nalu.sc_offset, -1)) {
-    GST_ERROR ("Failed to copy buffer");
-    gst_clear_buffer (&new_buffer);
-    goto out;
-  }
+  new_buffer = nal_insert_memory (au, offset, new_mem);
+  gst_memory_unref (new_mem);
 
-out:
   return new_buffer;
 }
 
@@ -4255,6 +4218,7 @@ out:
  * @sei: (transfer none): a #GstMemory containing a SEI nal
  *
  * Copy @au into new #GstBuffer and insert @sei into the #GstBuffer.
+ * The memories of @au are shared with the new #GstBuffer, not copied.
  * The validation for completeness of @au and @sei is caller's responsibility.
  * Both @au and @sei must be byte-stream formatted
  *
@@ -4284,6 +4248,7 @@ gst_h265_parser_insert_sei (GstH265Parser * parser, GstBuffer * au,
  * @sei: (transfer none): a #GstMemory containing a SEI nal
  *
  * Copy @au into new #GstBuffer and insert @sei into the #GstBuffer.
+ * The memories of @au are shared with the new #GstBuffer, not copied.
  * The validation for completeness of @au and @sei is caller's responsibility.
  * Nal prefix type of both @au and @sei must be packetized, and
  * also the size of nal length field must be identical to @nal_length_size
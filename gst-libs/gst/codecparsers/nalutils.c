@@ -74,20 +74,71 @@ nal_reader_init (NalReader * nr, const guint8 * data, guint size)
   nr->byte = 0;
   nr->bits_in_cache = 0;
   /* fill with something other than 0 to detect emulation prevention bytes */
-  nr->first_byte = 0xff;
   nr->epb_cache = 0xff;
-  nr->cache = 0xff;
+  nr->cache = 0;
+}
+
+/* Non-zero if any byte of x is zero. Can flag bytes in front of a zero byte
+ * that aren't zero, but never misses one */
+#define HAS_ZERO_BYTE(x) \
+    (((x) - G_GUINT64_CONSTANT (0x0101010101010101)) & ~(x) & \
+    G_GUINT64_CONSTANT (0x8080808080808080))
+
+/* The cache is filled up to this many bits, so that shifting it never
+ * overflows */
+#define MAX_BITS_IN_CACHE 56
+
+/* Loads the bytes in front of the next possible emulation prevention byte
+ * from a 64 bits word, at most as many as fit in the cache. Emulation
+ * prevention bytes are always 0x03, so bytes that aren't can be taken
+ * without looking at what came before them. */
+static inline void
+nal_reader_refill_fast (NalReader * nr)
+{
+  guint64 word, epb;
+  guint n_bytes, max_bytes;
+
+  if (nr->byte + 8 > nr->size)
+    return;
+
+  word = GST_READ_UINT64_BE (nr->data + nr->byte);
+  epb = HAS_ZERO_BYTE (word ^ G_GUINT64_CONSTANT (0x0303030303030303));
+
+  max_bytes = (MAX_BITS_IN_CACHE - nr->bits_in_cache) / 8;
+  for (n_bytes = 0; n_bytes < max_bytes; n_bytes++) {
+    if (epb & (G_GUINT64_CONSTANT (0x80) << (56 - 8 * n_bytes)))
+      break;
+  }
+  if (n_bytes == 0)
+    return;
+
+  word >>= 64 - 8 * n_bytes;
+  nr->cache = (nr->cache << (8 * n_bytes)) | word;
+  if (n_bytes >= 4)
+    nr->epb_cache = (guint32) word;
+  else
+    nr->epb_cache = (nr->epb_cache << (8 * n_bytes)) | (guint32) word;
+  nr->byte += n_bytes;
+  nr->bits_in_cache += 8 * n_bytes;
 }
 
 gboolean
 nal_reader_read (NalReader * nr, guint nbits)
 {
+  g_assert (nbits <= 32);
+
   if (G_UNLIKELY (nr->byte * 8 + (nbits - nr->bits_in_cache) > nr->size * 8)) {
     GST_DEBUG ("Can not read %u bits, bits in cache %u, Byte * 8 %u, size in "
         "bits %u", nbits, nr->bits_in_cache, nr->byte * 8, nr->size * 8);
     return FALSE;
   }
 
+  if (nr->bits_in_cache >= nbits)
+    return TRUE;
+
+  nal_reader_refill_fast (nr);
+
+  /* byte by byte up to and over emulation prevention bytes, or at the end */
   while (nr->bits_in_cache < nbits) {
     guint8 byte;
 
@@ -103,8 +154,7 @@ nal_reader_read (NalReader * nr, guint nbits)
       nr->n_epb++;
       goto next_byte;
     }
-    nr->cache = (nr->cache << 8) | nr->first_byte;
-    nr->first_byte = byte;
+    nr->cache = (nr->cache << 8) | byte;
     nr->bits_in_cache += 8;
   }
 
@@ -118,6 +168,14 @@ nal_reader_skip (NalReader * nr, guint nbits)
 {
   g_assert (nbits <= 8 * sizeof (nr->cache));
 
+  /* only up to 32 bits are read into the cache at once */
+  while (nbits > 32) {
+    if (G_UNLIKELY (!nal_reader_read (nr, 32)))
+      return FALSE;
+    nr->bits_in_cache -= 32;
+    nbits -= 32;
+  }
+
   if (G_UNLIKELY (!nal_reader_read (nr, nbits)))
     return FALSE;
 
@@ -173,9 +231,7 @@ nal_reader_get_bits_uint##bits (NalReader *nr, guint##bits *val, guint nbits) \
   \
   /* bring the required bits down and truncate */ \
   shift = nr->bits_in_cache - nbits; \
-  *val = nr->first_byte >> shift; \
-  \
-  *val |= nr->cache << (8 - shift); \
+  *val = nr->cache >> shift; \
   /* mask out required bits */ \
   if (nbits < bits) \
     *val &= ((guint##bits)1 << nbits) - 1; \
@@ -189,6 +245,28 @@ NAL_READER_READ_BITS (8);
 NAL_READER_READ_BITS (16);
 NAL_READER_READ_BITS (32);
 
+/* The cache only takes 32 bits at once, so wider values are read in two
+ * halves like nal_reader_skip() does */
+gboolean
+nal_reader_get_bits_uint64 (NalReader * nr, guint64 * val, guint nbits)
+{
+  guint32 high = 0, low;
+
+  g_assert (nbits <= 64);
+
+  if (nbits > 32) {
+    if (!nal_reader_get_bits_uint32 (nr, &high, nbits - 32))
+      return FALSE;
+    nbits = 32;
+  }
+  if (!nal_reader_get_bits_uint32 (nr, &low, nbits))
+    return FALSE;
+
+  *val = ((guint64) high << 32) | low;
+
+  return TRUE;
+}
+
 #define NAL_READER_PEEK_BITS(bits) \
 gboolean \
 nal_reader_peek_bits_uint##bits (const NalReader *nr, guint##bits *val, guint nbits) \
@@ -247,7 +325,8 @@ nal_reader_get_se (NalReader * nr, gint32 * val)
 gboolean
 nal_reader_is_byte_aligned (NalReader * nr)
 {
-  if (nr->bits_in_cache != 0)
+  /* the cache only ever holds whole bytes of the data */
+  if (nr->bits_in_cache % 8 != 0)
     return FALSE;
   return TRUE;
 }
@@ -298,12 +377,167 @@ nal_reader_has_more_data (NalReader * nr)
 gint
 scan_for_start_codes (const guint8 * data, guint size)
 {
-  GstByteReader br;
-  gst_byte_reader_init (&br, data, size);
+  const guint8 *p, *end;
 
   /* NALU not empty, so we can at least expect 1 (even 2) bytes following sc */
-  return gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
-      0, size);
+  if (size < 4)
+    return -1;
+
+  /* Look for the 0x01 of the start codes with memchr(), which the C library
+   * vectorizes, and check the two bytes in front of each one */
+  p = data + 2;
+  end = data + size - 1;
+  while (p < end) {
+    p = memchr (p, 0x01, end - p);
+    if (p == NULL)
+      break;
+    if (p[-1] == 0x00 && p[-2] == 0x00)
+      return p - 2 - data;
+    /* the next start code starts after this 0x01 */
+    p += 3;
+  }
+
+  return -1;
+}
+
+/* Finds the first slice of @au without mapping it as a whole, which would
+ * merge all of its memories into a copy of the access unit. Only the NAL
+ * units in front of the slice are looked at, one memory at a time, and the
+ * length prefixes are followed in packetized streams. The @header_size bytes
+ * following the start code or length prefix are given to @is_slice and are
+ * returned in @header.
+ *
+ * Returns the offset of the start code or length prefix of the slice. When
+ * there is none, the offset of the last NAL unit like the parsers did before,
+ * or -1 when there is no NAL unit at all. */
+gssize
+nal_find_first_slice (GstBuffer * au, guint nal_prefix_size,
+    gboolean packetized, guint header_size, NalIsSliceFunc is_slice,
+    guint8 * header)
+{
+  gssize last_offset = -1;
+  /* number of header bytes read after the start code, -1 outside of one */
+  gint header_pos = -1;
+  guint n_mem, zeros = 0, i;
+  gsize base = 0;
+
+  g_return_val_if_fail (header_size > 0 && header_size <= 2, -1);
+
+  if (packetized) {
+    gsize size = gst_buffer_get_size (au);
+    gsize offset = 0;
+
+    while (offset + nal_prefix_size + header_size <= size) {
+      guint8 prefix[6];
+      guint32 nal_size = 0;
+
+      gst_buffer_extract (au, offset, prefix, nal_prefix_size + header_size);
+      for (i = 0; i < nal_prefix_size; i++)
+        nal_size = (nal_size << 8) | prefix[i];
+      memcpy (header, prefix + nal_prefix_size, header_size);
+
+      if (is_slice (header))
+        return offset;
+      last_offset = offset;
+      offset += nal_prefix_size + nal_size;
+    }
+
+    return last_offset;
+  }
+
+  n_mem = gst_buffer_n_memory (au);
+  for (i = 0; i < n_mem; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (au, i);
+    GstMapInfo map;
+    gsize pos = 0;
+
+    if (!gst_memory_map (mem, &map, GST_MAP_READ)) {
+      GST_ERROR ("Cannot map au memory");
+      return -1;
+    }
+
+    /* the start codes and headers can span several memories */
+    while (pos < map.size) {
+      guint8 byte;
+
+      if (header_pos >= 0) {
+        header[header_pos++] = map.data[pos++];
+        if ((guint) header_pos < header_size)
+          continue;
+
+        if (is_slice (header)) {
+          gst_memory_unmap (mem, &map);
+          return last_offset;
+        }
+        header_pos = -1;
+        continue;
+      }
+
+      if (zeros == 0) {
+        const guint8 *zero = memchr (map.data + pos, 0x00, map.size - pos);
+
+        if (zero == NULL)
+          break;
+        pos = zero - map.data;
+      }
+
+      byte = map.data[pos++];
+      if (byte == 0x00) {
+        zeros++;
+      } else {
+        if (byte == 0x01 && zeros >= 2) {
+          /* includes the leading zero of 4 bytes start codes */
+          last_offset = base + pos - 1 - MIN (zeros, 3);
+          header_pos = 0;
+        }
+        zeros = 0;
+      }
+    }
+
+    base += map.size;
+    gst_memory_unmap (mem, &map);
+  }
+
+  return last_offset;
+}
+
+/* Returns a new buffer with the metadata and memories of @au, and @mem
+ * inserted at @offset. The memories are shared, only the one @offset falls
+ * in is split. */
+GstBuffer *
+nal_insert_memory (GstBuffer * au, gsize offset, GstMemory * mem)
+{
+  GstBuffer *new_buffer = gst_buffer_new ();
+
+  /* copy all metadata */
+  if (!gst_buffer_copy_into (new_buffer, au, GST_BUFFER_COPY_METADATA, 0, -1)) {
+    GST_ERROR ("Failed to copy metadata into new buffer");
+    goto error;
+  }
+
+  /* share the NAL units in front */
+  if (offset > 0) {
+    if (!gst_buffer_copy_into (new_buffer, au,
+            GST_BUFFER_COPY_MEMORY, 0, offset)) {
+      GST_ERROR ("Failed to copy buffer");
+      goto error;
+    }
+  }
+
+  gst_buffer_append_memory (new_buffer, gst_memory_ref (mem));
+
+  /* and the rest */
+  if (!gst_buffer_copy_into (new_buffer, au,
+          GST_BUFFER_COPY_MEMORY, offset, -1)) {
+    GST_ERROR ("Failed to copy buffer");
+    goto error;
+  }
+
+  return new_buffer;
+
+error:
+  gst_buffer_unref (new_buffer);
+  return NULL;
 }
 
 void
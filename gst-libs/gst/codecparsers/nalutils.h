@@ -50,9 +50,8 @@ typedef struct
   guint n_epb;                  /* Number of emulation prevention bytes */
   guint byte;                   /* Byte position */
   guint bits_in_cache;          /* bitpos in the cache of next bit */
-  guint8 first_byte;
   guint32 epb_cache;            /* cache 3 bytes to check emulation prevention bytes */
-  guint64 cache;                /* cached bytes */
+  guint64 cache;                /* cached bits */
 } NalReader;
 
 typedef struct
@@ -97,6 +96,7 @@ gboolean nal_reader_get_bits_uint##bits (NalReader *nr, guint##bits *val, guint
 NAL_READER_READ_BITS_H (8);
 NAL_READER_READ_BITS_H (16);
 NAL_READER_READ_BITS_H (32);
+NAL_READER_READ_BITS_H (64);
 
 #define NAL_READER_PEEK_BITS_H(bits) \
 G_GNUC_INTERNAL \
@@ -153,7 +153,7 @@ gboolean nal_reader_get_se (NalReader * nr, gint32 * val);
 
 #define READ_UINT64(nr, val, nbits) { \
   if (!nal_reader_get_bits_uint64 (nr, &val, nbits)) { \
-    GST_WARNING ("failed to read uint32 for '" G_STRINGIFY (val) "', nbits: %d", nbits); \
+    GST_WARNING ("failed to read uint64 for '" G_STRINGIFY (val) "', nbits: %d", nbits); \
     goto error; \
   } \
 }
@@ -196,6 +196,16 @@ gboolean nal_reader_get_se (NalReader * nr, gint32 * val);
 G_GNUC_INTERNAL
 gint scan_for_start_codes (const guint8 * data, guint size);
 
+typedef gboolean (*NalIsSliceFunc) (const guint8 * header);
+
+G_GNUC_INTERNAL
+gssize nal_find_first_slice (GstBuffer * au, guint nal_prefix_size,
+    gboolean packetized, guint header_size, NalIsSliceFunc is_slice,
+    guint8 * header);
+
+G_GNUC_INTERNAL
+GstBuffer * nal_insert_memory (GstBuffer * au, gsize offset, GstMemory * mem);
+
 G_GNUC_INTERNAL
 void nal_writer_init (NalWriter * nw, guint nal_prefix_size, gboolean packetized);
 
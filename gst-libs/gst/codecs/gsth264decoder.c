@@ -78,6 +78,46 @@ typedef enum
   GST_H264_DECODER_ALIGN_AU
 } GstH264DecoderAlign;
 
+/* In pipelined mode, a frame whose slice headers were parsed by the
+ * streaming thread, waiting for the submission thread */
+typedef struct
+{
+  /* Holds ref */
+  GstVideoCodecFrame *frame;
+  GstBuffer *buffer;
+  /* the slices point to the mapped data */
+  GstMapInfo map;
+  /* GstH264Slice, not decoded yet */
+  GArray *slices;
+  gboolean decode_ret;
+} GstH264DecoderParsedFrame;
+
+/* In pipelined mode, what the submission thread can only do with the stream
+ * lock, in order */
+typedef enum
+{
+  /* output the picture */
+  GST_H264_DECODER_TASK_OUTPUT,
+  /* output all the pictures delayed in the output queue */
+  GST_H264_DECODER_TASK_DRAIN,
+  /* discard them */
+  GST_H264_DECODER_TASK_CLEAR,
+  /* release the frame, its picture isn't output */
+  GST_H264_DECODER_TASK_RELEASE,
+  /* drop the frame */
+  GST_H264_DECODER_TASK_DROP,
+  /* drop the frame, which failed to decode */
+  GST_H264_DECODER_TASK_ERROR
+} GstH264DecoderTaskType;
+
+typedef struct
+{
+  GstH264DecoderTaskType type;
+  /* Holds ref, for GST_H264_DECODER_TASK_OUTPUT */
+  GstH264Picture *picture;
+  guint32 system_frame_number;
+} GstH264DecoderTask;
+
 struct _GstH264DecoderPrivate
 {
   gint width, height;
@@ -148,6 +188,25 @@ struct _GstH264DecoderPrivate
 
   /* For delayed output */
   GstQueueArray *output_queue;
+
+  /* Pipelined mode, see gst_h264_decoder_set_pipeline_depth() */
+  guint pipeline_depth;
+  GThread *pipeline_thread;
+  /* The frame being parsed by the streaming thread */
+  GstH264DecoderParsedFrame *parsed_frame;
+
+  /* protected by pipeline_lock */
+  GMutex pipeline_lock;
+  GCond pipeline_cond;
+  /* GstH264DecoderParsedFrame waiting for the submission thread */
+  GstQueueArray *pipeline_queue;
+  gboolean pipeline_busy;
+  gboolean pipeline_discard;
+  gboolean pipeline_stop;
+  /* GstH264DecoderTask waiting for the streaming thread */
+  GstQueueArray *pipeline_tasks;
+  /* first flow error of the tasks, not yet returned upstream */
+  GstFlowReturn pipeline_ret;
 };
 
 typedef struct
@@ -182,6 +241,11 @@ static GstFlowReturn gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
 static gboolean gst_h264_decoder_process_sps (GstH264Decoder * self,
     GstH264SPS * sps);
 static gboolean gst_h264_decoder_decode_slice (GstH264Decoder * self);
+static gboolean gst_h264_decoder_process_slice (GstH264Decoder * self);
+static gboolean gst_h264_decoder_parse_sps (GstH264Decoder * self,
+    GstH264NalUnit * nalu);
+static gboolean gst_h264_decoder_parse_pps (GstH264Decoder * self,
+    GstH264NalUnit * nalu);
 static gboolean gst_h264_decoder_decode_nal (GstH264Decoder * self,
     GstH264NalUnit * nalu);
 static gboolean gst_h264_decoder_fill_picture_from_slice (GstH264Decoder * self,
@@ -203,10 +267,24 @@ gst_h264_decoder_sliding_window_picture_marking (GstH264Decoder * self,
     GstH264Picture * picture);
 static void gst_h264_decoder_do_output_picture (GstH264Decoder * self,
     GstH264Picture * picture);
+static void gst_h264_decoder_queue_output_picture (GstH264Decoder * self,
+    GstH264Picture * picture);
+static void gst_h264_decoder_drain_output_queue (GstH264Decoder * self,
+    guint num);
 static GstH264Picture *gst_h264_decoder_new_field_picture (GstH264Decoder *
     self, GstH264Picture * picture);
 static void
 gst_h264_decoder_clear_output_frame (GstH264DecoderOutputFrame * output_frame);
+static void gst_h264_decoder_clear_task (GstH264DecoderTask * task);
+static void gst_h264_decoder_pipeline_push_task (GstH264Decoder * self,
+    GstH264DecoderTaskType type, GstH264Picture * picture,
+    guint32 system_frame_number);
+static void gst_h264_decoder_pipeline_wait (GstH264Decoder * self,
+    gboolean idle);
+static GstFlowReturn gst_h264_decoder_pipeline_handle_frame (GstH264Decoder *
+    self, GstVideoCodecFrame * frame);
+static gboolean gst_h264_decoder_pipeline_parse_nal (GstH264Decoder * self,
+    GstH264NalUnit * nalu);
 
 static void
 gst_h264_decoder_class_init (GstH264DecoderClass * klass)
@@ -274,6 +352,14 @@ gst_h264_decoder_init (GstH264Decoder * self)
       gst_queue_array_new_for_struct (sizeof (GstH264DecoderOutputFrame), 1);
   gst_queue_array_set_clear_func (priv->output_queue,
       (GDestroyNotify) gst_h264_decoder_clear_output_frame);
+
+  g_mutex_init (&priv->pipeline_lock);
+  g_cond_init (&priv->pipeline_cond);
+  priv->pipeline_queue = gst_queue_array_new (4);
+  priv->pipeline_tasks =
+      gst_queue_array_new_for_struct (sizeof (GstH264DecoderTask), 4);
+  gst_queue_array_set_clear_func (priv->pipeline_tasks,
+      (GDestroyNotify) gst_h264_decoder_clear_task);
 }
 
 static void
@@ -291,6 +377,10 @@ gst_h264_decoder_finalize (GObject * object)
   g_array_unref (priv->ref_pic_list0);
   g_array_unref (priv->ref_pic_list1);
   gst_queue_array_free (priv->output_queue);
+  gst_queue_array_free (priv->pipeline_queue);
+  gst_queue_array_free (priv->pipeline_tasks);
+  g_mutex_clear (&priv->pipeline_lock);
+  g_cond_clear (&priv->pipeline_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -310,6 +400,326 @@ gst_h264_decoder_reset (GstH264Decoder * self)
   priv->nal_length_size = 4;
 }
 
+static void
+gst_h264_decoder_parsed_frame_free (GstH264DecoderParsedFrame * pf)
+{
+  if (pf->buffer) {
+    gst_buffer_unmap (pf->buffer, &pf->map);
+    gst_buffer_unref (pf->buffer);
+  }
+
+  g_array_unref (pf->slices);
+  gst_video_codec_frame_unref (pf->frame);
+  g_free (pf);
+}
+
+/* Decodes the slices parsed so far, on the submission thread, or on the
+ * streaming thread while the submission thread is idle */
+static gboolean
+gst_h264_decoder_decode_parsed_slices (GstH264Decoder * self,
+    GstH264DecoderParsedFrame * pf)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  guint i;
+
+  priv->current_frame = pf->frame;
+
+  for (i = 0; i < pf->slices->len && pf->decode_ret; i++) {
+    priv->current_slice = g_array_index (pf->slices, GstH264Slice, i);
+    pf->decode_ret = gst_h264_decoder_process_slice (self);
+  }
+
+  g_array_set_size (pf->slices, 0);
+
+  return pf->decode_ret;
+}
+
+static void
+gst_h264_decoder_decode_parsed_frame (GstH264Decoder * self,
+    GstH264DecoderParsedFrame * pf)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  if (!gst_h264_decoder_decode_parsed_slices (self, pf)) {
+    gst_h264_decoder_pipeline_push_task (self, GST_H264_DECODER_TASK_ERROR,
+        NULL, pf->frame->system_frame_number);
+    gst_h264_picture_clear (&priv->current_picture);
+  } else {
+    gst_h264_decoder_finish_current_picture (self);
+  }
+
+  priv->current_frame = NULL;
+}
+
+static gboolean
+gst_h264_decoder_is_submission_thread (GstH264Decoder * self)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  return priv->pipeline_thread && g_thread_self () == priv->pipeline_thread;
+}
+
+static void
+gst_h264_decoder_clear_task (GstH264DecoderTask * task)
+{
+  gst_h264_picture_clear (&task->picture);
+}
+
+/* Called on the submission thread, takes ownership of @picture */
+static void
+gst_h264_decoder_pipeline_push_task (GstH264Decoder * self,
+    GstH264DecoderTaskType type, GstH264Picture * picture,
+    guint32 system_frame_number)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  GstH264DecoderTask task;
+
+  task.type = type;
+  task.picture = picture;
+  task.system_frame_number = system_frame_number;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  gst_queue_array_push_tail_struct (priv->pipeline_tasks, &task);
+  g_cond_broadcast (&priv->pipeline_cond);
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
+/* Releases the frame of a picture that won't be output */
+static void
+gst_h264_decoder_release_frame (GstH264Decoder * self,
+    guint32 system_frame_number)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstVideoCodecFrame *frame;
+
+  if (gst_h264_decoder_is_submission_thread (self)) {
+    gst_h264_decoder_pipeline_push_task (self, GST_H264_DECODER_TASK_RELEASE,
+        NULL, system_frame_number);
+    return;
+  }
+
+  frame = gst_video_decoder_get_frame (decoder, system_frame_number);
+  if (frame)
+    gst_video_decoder_release_frame (decoder, frame);
+}
+
+static void
+gst_h264_decoder_drop_frame (GstH264Decoder * self,
+    guint32 system_frame_number)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstVideoCodecFrame *frame;
+
+  if (gst_h264_decoder_is_submission_thread (self)) {
+    gst_h264_decoder_pipeline_push_task (self, GST_H264_DECODER_TASK_DROP,
+        NULL, system_frame_number);
+    return;
+  }
+
+  frame = gst_video_decoder_get_frame (decoder, system_frame_number);
+  if (frame)
+    gst_video_decoder_drop_frame (decoder, frame);
+}
+
+static GstFlowReturn
+gst_h264_decoder_run_task (GstH264Decoder * self, GstH264DecoderTask * task)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  priv->last_ret = GST_FLOW_OK;
+
+  switch (task->type) {
+    case GST_H264_DECODER_TASK_OUTPUT:
+      gst_h264_decoder_queue_output_picture (self, task->picture);
+      break;
+    case GST_H264_DECODER_TASK_DRAIN:
+      gst_h264_decoder_drain_output_queue (self, 0);
+      break;
+    case GST_H264_DECODER_TASK_CLEAR:
+      gst_queue_array_clear (priv->output_queue);
+      break;
+    case GST_H264_DECODER_TASK_RELEASE:
+      gst_h264_decoder_release_frame (self, task->system_frame_number);
+      break;
+    case GST_H264_DECODER_TASK_DROP:
+      gst_h264_decoder_drop_frame (self, task->system_frame_number);
+      break;
+    case GST_H264_DECODER_TASK_ERROR:
+      GST_VIDEO_DECODER_ERROR (self, 1, STREAM, DECODE,
+          ("Failed to decode data"), (NULL), priv->last_ret);
+      gst_h264_decoder_drop_frame (self, task->system_frame_number);
+      break;
+  }
+
+  return priv->last_ret;
+}
+
+/* Runs the tasks the submission thread left. Called with the stream lock and
+ * pipeline_lock, which is released meanwhile */
+static void
+gst_h264_decoder_pipeline_run_tasks (GstH264Decoder * self)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  while (!gst_queue_array_is_empty (priv->pipeline_tasks)) {
+    GstH264DecoderTask task = *(GstH264DecoderTask *)
+        gst_queue_array_pop_head_struct (priv->pipeline_tasks);
+    GstFlowReturn ret;
+
+    /* the base class discards the frames when flushing */
+    if (priv->pipeline_discard) {
+      gst_h264_decoder_clear_task (&task);
+      continue;
+    }
+
+    g_mutex_unlock (&priv->pipeline_lock);
+    ret = gst_h264_decoder_run_task (self, &task);
+    g_mutex_lock (&priv->pipeline_lock);
+
+    if (priv->pipeline_ret == GST_FLOW_OK)
+      priv->pipeline_ret = ret;
+  }
+}
+
+/* Keeps the first flow error until it can be returned upstream */
+static void
+gst_h264_decoder_pipeline_update_ret (GstH264Decoder * self)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  if (priv->pipeline_ret == GST_FLOW_OK)
+    priv->pipeline_ret = priv->last_ret;
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
+static GstFlowReturn
+gst_h264_decoder_pipeline_take_ret (GstH264Decoder * self)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  ret = priv->pipeline_ret;
+  priv->pipeline_ret = GST_FLOW_OK;
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  return ret;
+}
+
+/* Runs the tasks from the submission thread if the streaming thread doesn't
+ * hold the stream lock, typically while waiting for the next input in a
+ * live pipeline, so that decoded pictures don't wait for it to be output.
+ * Otherwise the streaming thread holds it and runs them itself */
+static void
+gst_h264_decoder_pipeline_try_run_tasks (GstH264Decoder * self)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstH264DecoderPrivate *priv = self->priv;
+
+  if (!g_rec_mutex_trylock (&decoder->stream_lock))
+    return;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  gst_h264_decoder_pipeline_run_tasks (self);
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+}
+
+static gpointer
+gst_h264_decoder_pipeline_thread (GstH264Decoder * self)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  while (TRUE) {
+    GstH264DecoderParsedFrame *pf;
+    gboolean discard;
+
+    while (!priv->pipeline_stop &&
+        gst_queue_array_is_empty (priv->pipeline_queue))
+      g_cond_wait (&priv->pipeline_cond, &priv->pipeline_lock);
+
+    if (priv->pipeline_stop)
+      break;
+
+    pf = gst_queue_array_pop_head (priv->pipeline_queue);
+    discard = priv->pipeline_discard;
+    priv->pipeline_busy = TRUE;
+    g_cond_broadcast (&priv->pipeline_cond);
+    g_mutex_unlock (&priv->pipeline_lock);
+
+    if (!discard)
+      gst_h264_decoder_decode_parsed_frame (self, pf);
+    gst_h264_decoder_parsed_frame_free (pf);
+
+    gst_h264_decoder_pipeline_try_run_tasks (self);
+
+    g_mutex_lock (&priv->pipeline_lock);
+    priv->pipeline_busy = FALSE;
+    g_cond_broadcast (&priv->pipeline_cond);
+  }
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  return NULL;
+}
+
+static gboolean
+gst_h264_decoder_pipeline_is_ready (GstH264Decoder * self, gboolean idle)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  guint len = gst_queue_array_get_length (priv->pipeline_queue);
+
+  if (idle)
+    return len == 0 && !priv->pipeline_busy;
+
+  return len < priv->pipeline_depth;
+}
+
+/* Waits until the submission thread has room for another frame, or until
+ * it decoded all of them if @idle is %TRUE, running the tasks it leaves
+ * meanwhile. Called with the stream lock, which the tasks need: the
+ * submission thread only ever tries to take it, as the base class can hold
+ * it more than once here */
+static void
+gst_h264_decoder_pipeline_wait (GstH264Decoder * self, gboolean idle)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  if (!priv->pipeline_thread)
+    return;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  while (TRUE) {
+    gst_h264_decoder_pipeline_run_tasks (self);
+    if (gst_h264_decoder_pipeline_is_ready (self, idle))
+      break;
+    g_cond_wait (&priv->pipeline_cond, &priv->pipeline_lock);
+  }
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
+static void
+gst_h264_decoder_pipeline_flush (GstH264Decoder * self)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
+  if (!priv->pipeline_thread)
+    return;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  priv->pipeline_discard = TRUE;
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  gst_h264_decoder_pipeline_wait (self, TRUE);
+
+  g_mutex_lock (&priv->pipeline_lock);
+  priv->pipeline_discard = FALSE;
+  priv->pipeline_ret = GST_FLOW_OK;
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
 static gboolean
 gst_h264_decoder_start (GstVideoDecoder * decoder)
 {
@@ -321,6 +731,15 @@ gst_h264_decoder_start (GstVideoDecoder * decoder)
   priv->parser = gst_h264_nal_parser_new ();
   priv->dpb = gst_h264_dpb_new ();
 
+  if (priv->pipeline_depth > 0) {
+    GST_DEBUG_OBJECT (self, "Pipelined mode, depth %u", priv->pipeline_depth);
+
+    priv->pipeline_stop = FALSE;
+    priv->pipeline_ret = GST_FLOW_OK;
+    priv->pipeline_thread = g_thread_new ("h264dec-submit",
+        (GThreadFunc) gst_h264_decoder_pipeline_thread, self);
+  }
+
   return TRUE;
 }
 
@@ -328,6 +747,23 @@ static gboolean
 gst_h264_decoder_stop (GstVideoDecoder * decoder)
 {
   GstH264Decoder *self = GST_H264_DECODER (decoder);
+  GstH264DecoderPrivate *priv = self->priv;
+
+  if (priv->pipeline_thread) {
+    g_mutex_lock (&priv->pipeline_lock);
+    priv->pipeline_stop = TRUE;
+    g_cond_broadcast (&priv->pipeline_cond);
+    g_mutex_unlock (&priv->pipeline_lock);
+
+    g_thread_join (priv->pipeline_thread);
+    priv->pipeline_thread = NULL;
+
+    while (!gst_queue_array_is_empty (priv->pipeline_queue)) {
+      gst_h264_decoder_parsed_frame_free (gst_queue_array_pop_head
+          (priv->pipeline_queue));
+    }
+    gst_queue_array_clear (priv->pipeline_tasks);
+  }
 
   gst_h264_decoder_reset (self);
 
@@ -352,7 +788,6 @@ gst_h264_decoder_clear_output_frame (GstH264DecoderOutputFrame * output_frame)
 static void
 gst_h264_decoder_clear_dpb (GstH264Decoder * self, gboolean flush)
 {
-  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
   GstH264DecoderPrivate *priv = self->priv;
   GstH264Picture *picture;
 
@@ -360,16 +795,17 @@ gst_h264_decoder_clear_dpb (GstH264Decoder * self, gboolean flush)
    * GstVideoCodecFrame. Release frames manually */
   if (!flush) {
     while ((picture = gst_h264_dpb_bump (priv->dpb, TRUE)) != NULL) {
-      GstVideoCodecFrame *frame = gst_video_decoder_get_frame (decoder,
-          picture->system_frame_number);
-
-      if (frame)
-        gst_video_decoder_release_frame (decoder, frame);
+      gst_h264_decoder_release_frame (self, picture->system_frame_number);
       gst_h264_picture_unref (picture);
     }
   }
 
-  gst_queue_array_clear (priv->output_queue);
+  if (gst_h264_decoder_is_submission_thread (self)) {
+    gst_h264_decoder_pipeline_push_task (self, GST_H264_DECODER_TASK_CLEAR,
+        NULL, 0);
+  } else {
+    gst_queue_array_clear (priv->output_queue);
+  }
   gst_h264_decoder_clear_ref_pic_lists (self);
   gst_h264_dpb_clear (priv->dpb);
   priv->last_output_poc = 0;
@@ -380,6 +816,7 @@ gst_h264_decoder_flush (GstVideoDecoder * decoder)
 {
   GstH264Decoder *self = GST_H264_DECODER (decoder);
 
+  gst_h264_decoder_pipeline_flush (self);
   gst_h264_decoder_clear_dpb (self, TRUE);
 
   return TRUE;
@@ -391,6 +828,8 @@ gst_h264_decoder_drain (GstVideoDecoder * decoder)
   GstH264Decoder *self = GST_H264_DECODER (decoder);
   GstH264DecoderPrivate *priv = self->priv;
 
+  gst_h264_decoder_pipeline_wait (self, TRUE);
+
   priv->last_ret = GST_FLOW_OK;
   /* dpb will be cleared by this method */
   gst_h264_decoder_drain_internal (self);
@@ -401,44 +840,43 @@ gst_h264_decoder_drain (GstVideoDecoder * decoder)
 static GstFlowReturn
 gst_h264_decoder_finish (GstVideoDecoder * decoder)
 {
-  return gst_h264_decoder_drain (decoder);
+  GstH264Decoder *self = GST_H264_DECODER (decoder);
+  GstFlowReturn ret;
+
+  ret = gst_h264_decoder_drain (decoder);
+
+  if (self->priv->pipeline_thread) {
+    GstFlowReturn pipeline_ret = gst_h264_decoder_pipeline_take_ret (self);
+
+    if (pipeline_ret != GST_FLOW_OK)
+      ret = pipeline_ret;
+  }
+
+  return ret;
 }
 
-static GstFlowReturn
-gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
-    GstVideoCodecFrame * frame)
+static gboolean
+gst_h264_decoder_decode_nals (GstH264Decoder * self, const GstMapInfo * map)
 {
-  GstH264Decoder *self = GST_H264_DECODER (decoder);
   GstH264DecoderPrivate *priv = self->priv;
-  GstBuffer *in_buf = frame->input_buffer;
   GstH264NalUnit nalu;
   GstH264ParserResult pres;
-  GstMapInfo map;
   gboolean decode_ret = TRUE;
 
-  GST_LOG_OBJECT (self,
-      "handle frame, PTS: %" GST_TIME_FORMAT ", DTS: %"
-      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_PTS (in_buf)),
-      GST_TIME_ARGS (GST_BUFFER_DTS (in_buf)));
-
-  priv->current_frame = frame;
-  priv->last_ret = GST_FLOW_OK;
-
-  gst_buffer_map (in_buf, &map, GST_MAP_READ);
   if (priv->in_format == GST_H264_DECODER_FORMAT_AVC) {
     pres = gst_h264_parser_identify_nalu_avc (priv->parser,
-        map.data, 0, map.size, priv->nal_length_size, &nalu);
+        map->data, 0, map->size, priv->nal_length_size, &nalu);
 
     while (pres == GST_H264_PARSER_OK && decode_ret) {
       decode_ret = gst_h264_decoder_decode_nal (self, &nalu);
 
       pres = gst_h264_parser_identify_nalu_avc (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, priv->nal_length_size,
-          &nalu);
+          map->data, nalu.offset + nalu.size, map->size,
+          priv->nal_length_size, &nalu);
     }
   } else {
     pres = gst_h264_parser_identify_nalu (priv->parser,
-        map.data, 0, map.size, &nalu);
+        map->data, 0, map->size, &nalu);
 
     if (pres == GST_H264_PARSER_NO_NAL_END)
       pres = GST_H264_PARSER_OK;
@@ -447,13 +885,39 @@ gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
       decode_ret = gst_h264_decoder_decode_nal (self, &nalu);
 
       pres = gst_h264_parser_identify_nalu (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, &nalu);
+          map->data, nalu.offset + nalu.size, map->size, &nalu);
 
       if (pres == GST_H264_PARSER_NO_NAL_END)
         pres = GST_H264_PARSER_OK;
     }
   }
 
+  return decode_ret;
+}
+
+static GstFlowReturn
+gst_h264_decoder_handle_frame (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame)
+{
+  GstH264Decoder *self = GST_H264_DECODER (decoder);
+  GstH264DecoderPrivate *priv = self->priv;
+  GstBuffer *in_buf = frame->input_buffer;
+  GstMapInfo map;
+  gboolean decode_ret;
+
+  GST_LOG_OBJECT (self,
+      "handle frame, PTS: %" GST_TIME_FORMAT ", DTS: %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_PTS (in_buf)),
+      GST_TIME_ARGS (GST_BUFFER_DTS (in_buf)));
+
+  if (priv->pipeline_thread)
+    return gst_h264_decoder_pipeline_handle_frame (self, frame);
+
+  priv->current_frame = frame;
+  priv->last_ret = GST_FLOW_OK;
+
+  gst_buffer_map (in_buf, &map, GST_MAP_READ);
+  decode_ret = gst_h264_decoder_decode_nals (self, &map);
   gst_buffer_unmap (in_buf, &map);
 
   if (!decode_ret) {
@@ -635,38 +1099,9 @@ gst_h264_decoder_update_pic_nums (GstH264Decoder * self,
     GstH264Picture * current_picture, gint frame_num)
 {
   GstH264DecoderPrivate *priv = self->priv;
-  GArray *dpb = gst_h264_dpb_get_pictures_all (priv->dpb);
-  gint i;
-
-  for (i = 0; i < dpb->len; i++) {
-    GstH264Picture *picture = g_array_index (dpb, GstH264Picture *, i);
-
-    if (!GST_H264_PICTURE_IS_REF (picture))
-      continue;
-
-    if (GST_H264_PICTURE_IS_LONG_TERM_REF (picture)) {
-      if (GST_H264_PICTURE_IS_FRAME (current_picture))
-        picture->long_term_pic_num = picture->long_term_frame_idx;
-      else if (current_picture->field == picture->field)
-        picture->long_term_pic_num = 2 * picture->long_term_frame_idx + 1;
-      else
-        picture->long_term_pic_num = 2 * picture->long_term_frame_idx;
-    } else {
-      if (picture->frame_num > frame_num)
-        picture->frame_num_wrap = picture->frame_num - priv->max_frame_num;
-      else
-        picture->frame_num_wrap = picture->frame_num;
-
-      if (GST_H264_PICTURE_IS_FRAME (current_picture))
-        picture->pic_num = picture->frame_num_wrap;
-      else if (picture->field == current_picture->field)
-        picture->pic_num = 2 * picture->frame_num_wrap + 1;
-      else
-        picture->pic_num = 2 * picture->frame_num_wrap;
-    }
-  }
 
-  g_array_unref (dpb);
+  gst_h264_dpb_update_pic_nums (priv->dpb, current_picture, frame_num,
+      priv->max_frame_num);
 }
 
 static GstH264Picture *
@@ -998,6 +1433,15 @@ gst_h264_decoder_parse_slice (GstH264Decoder * self, GstH264NalUnit * nalu)
 
   priv->current_slice.nalu = *nalu;
 
+  return gst_h264_decoder_process_slice (self);
+}
+
+/* Decodes priv->current_slice, once parsed */
+static gboolean
+gst_h264_decoder_process_slice (GstH264Decoder * self)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+
   if (!gst_h264_decoder_preprocess_slice (self, &priv->current_slice))
     return FALSE;
 
@@ -1083,6 +1527,9 @@ gst_h264_decoder_decode_nal (GstH264Decoder * self, GstH264NalUnit * nalu)
   GST_LOG_OBJECT (self, "Parsed nal type: %d, offset %d, size %d",
       nalu->type, nalu->offset, nalu->size);
 
+  if (self->priv->parsed_frame)
+    return gst_h264_decoder_pipeline_parse_nal (self, nalu);
+
   switch (nalu->type) {
     case GST_H264_NAL_SPS:
       ret = gst_h264_decoder_parse_sps (self, nalu);
@@ -1105,6 +1552,138 @@ gst_h264_decoder_decode_nal (GstH264Decoder * self, GstH264NalUnit * nalu)
   return ret;
 }
 
+/* Whether @nalu is a SPS or PPS identical to the one already stored with the
+ * same id, as most streams repeat them before every IDR */
+static gboolean
+gst_h264_decoder_is_repeated_parameter_set (GstH264Decoder * self,
+    GstH264NalUnit * nalu)
+{
+  GstH264NalParser *parser = self->priv->parser;
+  gboolean ret = FALSE;
+
+  if (nalu->type == GST_H264_NAL_SPS) {
+    GstH264SPS sps;
+
+    if (gst_h264_parse_sps (nalu, &sps) != GST_H264_PARSER_OK)
+      return FALSE;
+
+    if (parser->sps[sps.id].valid &&
+        memcmp (&parser->sps[sps.id], &sps, sizeof (sps)) == 0) {
+      parser->last_sps = &parser->sps[sps.id];
+      ret = TRUE;
+    }
+
+    gst_h264_sps_clear (&sps);
+  } else {
+    GstH264PPS pps;
+
+    if (gst_h264_parse_pps (parser, nalu, &pps) != GST_H264_PARSER_OK)
+      return FALSE;
+
+    if (parser->pps[pps.id].valid &&
+        memcmp (&parser->pps[pps.id], &pps, sizeof (pps)) == 0) {
+      parser->last_pps = &parser->pps[pps.id];
+      ret = TRUE;
+    }
+
+    gst_h264_pps_clear (&pps);
+  }
+
+  return ret;
+}
+
+/* Called on the streaming thread in pipelined mode. Slices are only parsed,
+ * the submission thread decodes them. New parameter sets change the state
+ * it uses, so they wait for it to be done with the previous frames */
+static gboolean
+gst_h264_decoder_pipeline_parse_nal (GstH264Decoder * self,
+    GstH264NalUnit * nalu)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  GstH264DecoderParsedFrame *pf = priv->parsed_frame;
+  GstH264ParserResult pres;
+  GstH264Slice *slice;
+
+  switch (nalu->type) {
+    case GST_H264_NAL_SPS:
+    case GST_H264_NAL_PPS:
+      if (gst_h264_decoder_is_repeated_parameter_set (self, nalu)) {
+        GST_LOG_OBJECT (self, "Skipping repeated parameter set");
+        break;
+      }
+
+      gst_h264_decoder_pipeline_wait (self, TRUE);
+
+      /* The slices parsed before it come first */
+      priv->last_ret = GST_FLOW_OK;
+      if (gst_h264_decoder_decode_parsed_slices (self, pf)) {
+        if (nalu->type == GST_H264_NAL_SPS)
+          pf->decode_ret = gst_h264_decoder_parse_sps (self, nalu);
+        else
+          pf->decode_ret = gst_h264_decoder_parse_pps (self, nalu);
+      }
+      gst_h264_decoder_pipeline_update_ret (self);
+      break;
+    case GST_H264_NAL_SLICE:
+    case GST_H264_NAL_SLICE_DPA:
+    case GST_H264_NAL_SLICE_DPB:
+    case GST_H264_NAL_SLICE_DPC:
+    case GST_H264_NAL_SLICE_IDR:
+    case GST_H264_NAL_SLICE_EXT:
+      g_array_set_size (pf->slices, pf->slices->len + 1);
+      slice = &g_array_index (pf->slices, GstH264Slice, pf->slices->len - 1);
+
+      pres = gst_h264_parser_parse_slice_hdr (priv->parser, nalu,
+          &slice->header, TRUE, TRUE);
+      if (pres != GST_H264_PARSER_OK) {
+        GST_ERROR_OBJECT (self, "Failed to parse slice header, ret %d", pres);
+        g_array_set_size (pf->slices, pf->slices->len - 1);
+        pf->decode_ret = FALSE;
+        break;
+      }
+
+      slice->nalu = *nalu;
+      break;
+    default:
+      break;
+  }
+
+  return pf->decode_ret;
+}
+
+static GstFlowReturn
+gst_h264_decoder_pipeline_handle_frame (GstH264Decoder * self,
+    GstVideoCodecFrame * frame)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  GstH264DecoderParsedFrame *pf;
+
+  pf = g_new0 (GstH264DecoderParsedFrame, 1);
+  pf->frame = frame;
+  pf->slices = g_array_new (FALSE, TRUE, sizeof (GstH264Slice));
+  pf->decode_ret = TRUE;
+
+  if (gst_buffer_map (frame->input_buffer, &pf->map, GST_MAP_READ)) {
+    pf->buffer = gst_buffer_ref (frame->input_buffer);
+
+    priv->parsed_frame = pf;
+    gst_h264_decoder_decode_nals (self, &pf->map);
+    priv->parsed_frame = NULL;
+  } else {
+    GST_ERROR_OBJECT (self, "Failed to map input buffer");
+    pf->decode_ret = FALSE;
+  }
+
+  gst_h264_decoder_pipeline_wait (self, FALSE);
+
+  g_mutex_lock (&priv->pipeline_lock);
+  gst_queue_array_push_tail (priv->pipeline_queue, pf);
+  g_cond_broadcast (&priv->pipeline_cond);
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  return gst_h264_decoder_pipeline_take_ret (self);
+}
+
 static void
 gst_h264_decoder_format_from_caps (GstH264Decoder * self, GstCaps * caps,
     GstH264DecoderFormat * format, GstH264DecoderAlign * align)
@@ -1156,6 +1735,9 @@ gst_h264_decoder_set_format (GstVideoDecoder * decoder,
 
   GST_DEBUG_OBJECT (decoder, "Set format");
 
+  /* The submission thread might still use the state updated from here */
+  gst_h264_decoder_pipeline_wait (self, TRUE);
+
   if (self->input_state)
     gst_video_codec_state_unref (self->input_state);
 
@@ -1541,8 +2123,6 @@ gst_h264_decoder_do_output_picture (GstH264Decoder * self,
     GstH264Picture * picture)
 {
   GstH264DecoderPrivate *priv = self->priv;
-  GstVideoCodecFrame *frame = NULL;
-  GstH264DecoderOutputFrame output_frame;
 
   GST_LOG_OBJECT (self, "Outputting picture %p (frame_num %d, poc %d)",
       picture, picture->frame_num, picture->pic_order_cnt);
@@ -1555,6 +2135,23 @@ gst_h264_decoder_do_output_picture (GstH264Decoder * self,
 
   priv->last_output_poc = picture->pic_order_cnt;
 
+  if (gst_h264_decoder_is_submission_thread (self)) {
+    gst_h264_decoder_pipeline_push_task (self, GST_H264_DECODER_TASK_OUTPUT,
+        picture, 0);
+    return;
+  }
+
+  gst_h264_decoder_queue_output_picture (self, picture);
+}
+
+static void
+gst_h264_decoder_queue_output_picture (GstH264Decoder * self,
+    GstH264Picture * picture)
+{
+  GstH264DecoderPrivate *priv = self->priv;
+  GstVideoCodecFrame *frame = NULL;
+  GstH264DecoderOutputFrame output_frame;
+
   frame = gst_video_decoder_get_frame (GST_VIDEO_DECODER (self),
       picture->system_frame_number);
 
@@ -1598,8 +2195,8 @@ gst_h264_decoder_finish_current_picture (GstH264Decoder * self)
       priv->current_picture->nonexisting = TRUE;
 
       /* this fake nonexisting picture will not trigger ouput_picture() */
-      gst_video_decoder_drop_frame (GST_VIDEO_DECODER (self),
-          gst_video_codec_frame_ref (priv->current_frame));
+      gst_h264_decoder_drop_frame (self,
+          priv->current_frame->system_frame_number);
     }
   }
 
@@ -1640,7 +2237,12 @@ gst_h264_decoder_drain_internal (GstH264Decoder * self)
     gst_h264_decoder_do_output_picture (self, picture);
   }
 
-  gst_h264_decoder_drain_output_queue (self, 0);
+  if (gst_h264_decoder_is_submission_thread (self)) {
+    gst_h264_decoder_pipeline_push_task (self, GST_H264_DECODER_TASK_DRAIN,
+        NULL, 0);
+  } else {
+    gst_h264_decoder_drain_output_queue (self, 0);
+  }
 
   gst_h264_dpb_clear (priv->dpb);
   priv->last_output_poc = 0;
@@ -1802,7 +2404,6 @@ static gboolean
 gst_h264_decoder_finish_picture (GstH264Decoder * self,
     GstH264Picture * picture)
 {
-  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
   GstH264DecoderPrivate *priv = self->priv;
 
   /* Finish processing the picture.
@@ -1831,10 +2432,7 @@ gst_h264_decoder_finish_picture (GstH264Decoder * self,
   if (picture->second_field && picture->other_field &&
       picture->system_frame_number !=
       picture->other_field->system_frame_number) {
-    GstVideoCodecFrame *frame = gst_video_decoder_get_frame (decoder,
-        picture->system_frame_number);
-
-    gst_video_decoder_release_frame (decoder, frame);
+    gst_h264_decoder_release_frame (self, picture->system_frame_number);
   }
 
   /* Split frame into top/bottom field pictures for reference picture marking
@@ -2033,13 +2631,14 @@ gst_h264_decoder_set_latency (GstH264Decoder * self, const GstH264SPS * sps,
   if (num_reorder_frames > max_dpb_size)
     num_reorder_frames = priv->is_live ? 0 : 1;
 
-  /* Consider output delay wanted by subclass */
-  num_reorder_frames += priv->preferred_output_delay;
+  /* Consider output delay wanted by subclass, and the frames parsed ahead
+   * in pipelined mode */
+  num_reorder_frames += priv->preferred_output_delay + priv->pipeline_depth;
 
   min = gst_util_uint64_scale_int (num_reorder_frames * GST_SECOND, fps_d,
       fps_n);
-  max = gst_util_uint64_scale_int ((max_dpb_size + priv->preferred_output_delay)
-      * GST_SECOND, fps_d, fps_n);
+  max = gst_util_uint64_scale_int ((max_dpb_size + priv->preferred_output_delay
+          + priv->pipeline_depth) * GST_SECOND, fps_d, fps_n);
 
   GST_LOG_OBJECT (self,
       "latency min %" G_GUINT64_FORMAT " max %" G_GUINT64_FORMAT, min, max);
@@ -2948,6 +3547,43 @@ gst_h264_decoder_set_process_ref_pic_lists (GstH264Decoder * decoder,
   decoder->priv->process_ref_pic_lists = process;
 }
 
+/**
+ * gst_h264_decoder_set_pipeline_depth:
+ * @decoder: a #GstH264Decoder
+ * @depth: the number of frames parsed ahead of the submission, or 0
+ *
+ * Called to en/disable pipelined mode. In pipelined mode, the streaming
+ * thread only parses up to @depth frames ahead, while another thread manages
+ * the DPB and calls #GstH264DecoderClass.new_picture,
+ * #GstH264DecoderClass.new_field_picture, #GstH264DecoderClass.start_picture,
+ * #GstH264DecoderClass.decode_slice and #GstH264DecoderClass.end_picture, so
+ * that parsing a frame overlaps with the submission of the previous ones.
+ * #GstH264DecoderClass.new_sequence is still called from the streaming
+ * thread, once all previous frames were submitted.
+ * #GstH264DecoderClass.output_picture is called with the stream lock held,
+ * from either thread.
+ *
+ * The methods called from the submission thread, such as
+ * #GstH264DecoderClass.new_picture and #GstH264DecoderClass.decode_slice,
+ * must not take the stream lock, which
+ * gst_video_decoder_allocate_output_frame() does for example. The streaming
+ * thread holds it while waiting for the submission thread, so the pipeline
+ * would deadlock.
+ *
+ * Up to @depth more frames are held back before being output, which is
+ * added to the reported latency.
+ *
+ * This must be called before the decoder is started, from the instance
+ * init function for example.
+ *
+ * Since: 1.20
+ */
+void
+gst_h264_decoder_set_pipeline_depth (GstH264Decoder * decoder, guint depth)
+{
+  decoder->priv->pipeline_depth = depth;
+}
+
 /**
  * gst_h264_decoder_get_picture:
  * @decoder: a #GstH264Decoder
@@ -23,6 +23,7 @@
 
 #include "gsth264picture.h"
 #include <stdlib.h>
+#include <string.h>
 
 GST_DEBUG_CATEGORY_EXTERN (gst_h264_decoder_debug);
 #define GST_CAT_DEFAULT gst_h264_decoder_debug
@@ -103,6 +104,13 @@ gst_h264_picture_get_user_data (GstH264Picture * picture)
   return picture->user_data;
 }
 
+/* Number of hash buckets of the pic_num and long_term_pic_num indices. Picture
+ * numbers of the pictures in a DPB are mostly consecutive, so with a power of
+ * two larger than the number of pictures there are hardly any collisions */
+#define GST_H264_DPB_INDEX_SIZE 64
+#define GST_H264_DPB_INDEX_BUCKET(num) \
+    (((guint) (num)) & (GST_H264_DPB_INDEX_SIZE - 1))
+
 struct _GstH264Dpb
 {
   GArray *pic_list;
@@ -111,6 +119,16 @@ struct _GstH264Dpb
   gint32 last_output_poc;
 
   gboolean interlaced;
+
+  /* Chained hash tables of the pictures in pic_list, keyed by pic_num and
+   * long_term_pic_num. The heads and next links are indices in pic_list, -1
+   * terminated. Rebuilt on the first lookup after pic_list or picture numbers
+   * changed */
+  gboolean index_valid;
+  gint pic_num_head[GST_H264_DPB_INDEX_SIZE];
+  gint long_term_pic_num_head[GST_H264_DPB_INDEX_SIZE];
+  GArray *pic_num_next;
+  GArray *long_term_pic_num_next;
 };
 
 static void
@@ -118,6 +136,39 @@ gst_h264_dpb_init (GstH264Dpb * dpb)
 {
   dpb->num_output_needed = 0;
   dpb->last_output_poc = G_MININT32;
+  dpb->index_valid = FALSE;
+}
+
+static void
+gst_h264_dpb_build_index (GstH264Dpb * dpb)
+{
+  guint i;
+
+  memset (dpb->pic_num_head, 0xff, sizeof (dpb->pic_num_head));
+  memset (dpb->long_term_pic_num_head, 0xff,
+      sizeof (dpb->long_term_pic_num_head));
+  g_array_set_size (dpb->pic_num_next, dpb->pic_list->len);
+  g_array_set_size (dpb->long_term_pic_num_next, dpb->pic_list->len);
+
+  /* Inserted from the back so that every chain is in pic_list order, and a
+   * lookup returns the same picture as walking pic_list would */
+  for (i = dpb->pic_list->len; i > 0; i--) {
+    GstH264Picture *picture =
+        g_array_index (dpb->pic_list, GstH264Picture *, i - 1);
+    guint bucket;
+
+    bucket = GST_H264_DPB_INDEX_BUCKET (picture->pic_num);
+    g_array_index (dpb->pic_num_next, gint, i - 1) =
+        dpb->pic_num_head[bucket];
+    dpb->pic_num_head[bucket] = i - 1;
+
+    bucket = GST_H264_DPB_INDEX_BUCKET (picture->long_term_pic_num);
+    g_array_index (dpb->long_term_pic_num_next, gint, i - 1) =
+        dpb->long_term_pic_num_head[bucket];
+    dpb->long_term_pic_num_head[bucket] = i - 1;
+  }
+
+  dpb->index_valid = TRUE;
 }
 
 /**
@@ -141,6 +192,13 @@ gst_h264_dpb_new (void)
   g_array_set_clear_func (dpb->pic_list,
       (GDestroyNotify) gst_h264_picture_clear);
 
+  dpb->pic_num_next =
+      g_array_sized_new (FALSE, FALSE, sizeof (gint),
+      2 * GST_H264_DPB_MAX_SIZE + 1);
+  dpb->long_term_pic_num_next =
+      g_array_sized_new (FALSE, FALSE, sizeof (gint),
+      2 * GST_H264_DPB_MAX_SIZE + 1);
+
   return dpb;
 }
 
@@ -221,6 +279,8 @@ gst_h264_dpb_free (GstH264Dpb * dpb)
 
   gst_h264_dpb_clear (dpb);
   g_array_unref (dpb->pic_list);
+  g_array_unref (dpb->pic_num_next);
+  g_array_unref (dpb->long_term_pic_num_next);
   g_free (dpb);
 }
 
@@ -277,6 +337,7 @@ gst_h264_dpb_add (GstH264Dpb * dpb, GstH264Picture * picture)
   }
 
   g_array_append_val (dpb->pic_list, picture);
+  dpb->index_valid = FALSE;
 }
 
 /**
@@ -303,6 +364,7 @@ gst_h264_dpb_delete_unused (GstH264Dpb * dpb)
           ("remove picture %p (frame num: %d, poc: %d, field: %d) from dpb",
           picture, picture->frame_num, picture->pic_order_cnt, picture->field);
       g_array_remove_index (dpb->pic_list, i);
+      dpb->index_valid = FALSE;
       i--;
     }
   }
@@ -365,7 +427,10 @@ gst_h264_dpb_mark_all_non_ref (GstH264Dpb * dpb)
  * @dpb: a #GstH264Dpb
  * @pic_num: a picture number
  *
- * Find a short term reference picture which has matching picture number
+ * Find a short term reference picture which has matching picture number.
+ *
+ * The lookup uses an index of the picture numbers set by
+ * gst_h264_dpb_update_pic_nums().
  *
  * Returns: (nullable) (transfer none): a #GstH264Picture
  */
@@ -376,7 +441,11 @@ gst_h264_dpb_get_short_ref_by_pic_num (GstH264Dpb * dpb, gint pic_num)
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
+  if (!dpb->index_valid)
+    gst_h264_dpb_build_index (dpb);
+
+  for (i = dpb->pic_num_head[GST_H264_DPB_INDEX_BUCKET (pic_num)]; i >= 0;
+      i = g_array_index (dpb->pic_num_next, gint, i)) {
     GstH264Picture *picture =
         g_array_index (dpb->pic_list, GstH264Picture *, i);
 
@@ -397,6 +466,9 @@ gst_h264_dpb_get_short_ref_by_pic_num (GstH264Dpb * dpb, gint pic_num)
  *
  * Find a long term reference picture which has matching long term picture number
  *
+ * The lookup uses an index of the long term picture numbers set by
+ * gst_h264_dpb_update_pic_nums().
+ *
  * Returns: (nullable) (transfer none): a #GstH264Picture
  *
  * Since: 1.20
@@ -409,7 +481,12 @@ gst_h264_dpb_get_long_ref_by_long_term_pic_num (GstH264Dpb * dpb,
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
+  if (!dpb->index_valid)
+    gst_h264_dpb_build_index (dpb);
+
+  for (i = dpb->long_term_pic_num_head[GST_H264_DPB_INDEX_BUCKET
+          (long_term_pic_num)]; i >= 0;
+      i = g_array_index (dpb->long_term_pic_num_next, gint, i)) {
     GstH264Picture *picture =
         g_array_index (dpb->pic_list, GstH264Picture *, i);
 
@@ -775,8 +852,10 @@ gst_h264_dpb_bump (GstH264Dpb * dpb, gboolean drain)
 
   /* NOTE: don't use g_array_remove_index_fast here since the last picture
    * need to be referenced for bumping decision */
-  if (!GST_H264_PICTURE_IS_REF (picture) || drain)
+  if (!GST_H264_PICTURE_IS_REF (picture) || drain) {
     g_array_remove_index (dpb->pic_list, index);
+    dpb->index_valid = FALSE;
+  }
 
   other_picture = picture->other_field;
   if (other_picture) {
@@ -797,6 +876,7 @@ gst_h264_dpb_bump (GstH264Dpb * dpb, gboolean drain)
 
         if (tmp == other_picture) {
           g_array_remove_index (dpb->pic_list, i);
+          dpb->index_valid = FALSE;
           break;
         }
       }
@@ -1029,6 +1109,62 @@ gst_h264_dpb_perform_memory_management_control_operation (GstH264Dpb * dpb,
   return TRUE;
 }
 
+/**
+ * gst_h264_dpb_update_pic_nums:
+ * @dpb: a #GstH264Dpb
+ * @current_picture: the #GstH264Picture being decoded
+ * @frame_num: the frame_num of @current_picture
+ * @max_frame_num: MaxFrameNum of the active SPS
+ *
+ * Derive FrameNumWrap, PicNum and LongTermPicNum of all reference pictures
+ * in @dpb as defined in "8.2.4.1 Decoding process for picture numbers".
+ * This must be used instead of setting the picture numbers of stored pictures
+ * directly, for gst_h264_dpb_get_short_ref_by_pic_num() and
+ * gst_h264_dpb_get_long_ref_by_long_term_pic_num() to find them.
+ *
+ * Since: 1.20
+ */
+void
+gst_h264_dpb_update_pic_nums (GstH264Dpb * dpb,
+    GstH264Picture * current_picture, gint frame_num, gint max_frame_num)
+{
+  gint i;
+
+  g_return_if_fail (dpb != NULL);
+  g_return_if_fail (current_picture != NULL);
+
+  for (i = 0; i < dpb->pic_list->len; i++) {
+    GstH264Picture *picture =
+        g_array_index (dpb->pic_list, GstH264Picture *, i);
+
+    if (!GST_H264_PICTURE_IS_REF (picture))
+      continue;
+
+    if (GST_H264_PICTURE_IS_LONG_TERM_REF (picture)) {
+      if (GST_H264_PICTURE_IS_FRAME (current_picture))
+        picture->long_term_pic_num = picture->long_term_frame_idx;
+      else if (current_picture->field == picture->field)
+        picture->long_term_pic_num = 2 * picture->long_term_frame_idx + 1;
+      else
+        picture->long_term_pic_num = 2 * picture->long_term_frame_idx;
+    } else {
+      if (picture->frame_num > frame_num)
+        picture->frame_num_wrap = picture->frame_num - max_frame_num;
+      else
+        picture->frame_num_wrap = picture->frame_num;
+
+      if (GST_H264_PICTURE_IS_FRAME (current_picture))
+        picture->pic_num = picture->frame_num_wrap;
+      else if (picture->field == current_picture->field)
+        picture->pic_num = 2 * picture->frame_num_wrap + 1;
+      else
+        picture->pic_num = 2 * picture->frame_num_wrap;
+    }
+  }
+
+  dpb->index_valid = FALSE;
+}
+
 /**
  * gst_h264_picture_set_reference:
  * @picture: a #GstH264Picture
@@ -292,6 +292,12 @@ gboolean         gst_h264_dpb_perform_memory_management_control_operation (GstH2
                                                                            GstH264RefPicMarking *ref_pic_marking,
                                                                            GstH264Picture * picture);
 
+GST_CODECS_API
+void  gst_h264_dpb_update_pic_nums (GstH264Dpb * dpb,
+                                    GstH264Picture * current_picture,
+                                    gint frame_num,
+                                    gint max_frame_num);
+
 /* Internal methods */
 void  gst_h264_picture_set_reference (GstH264Picture * picture,
                                       GstH264PictureReference reference,
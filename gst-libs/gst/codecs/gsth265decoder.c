@@ -30,6 +30,7 @@
 #include <config.h>
 #endif
 
+#include <gst/base/base.h>
 #include "gsth265decoder.h"
 
 GST_DEBUG_CATEGORY (gst_h265_decoder_debug);
@@ -50,6 +51,53 @@ typedef enum
   GST_H265_DECODER_ALIGN_AU
 } GstH265DecoderAlign;
 
+/* In pipelined mode, a NAL unit parsed by the streaming thread */
+typedef struct
+{
+  /* Only the nalu is set for other units than slices */
+  GstH265Slice slice;
+
+  /* picture timing SEI */
+  GstH265SEIPicStructType pic_struct;
+  guint8 source_scan_type;
+  guint8 duplicate_flag;
+} GstH265DecoderParsedUnit;
+
+/* In pipelined mode, a frame parsed by the streaming thread, waiting for the
+ * submission thread */
+typedef struct
+{
+  /* Holds ref */
+  GstVideoCodecFrame *frame;
+  GstBuffer *buffer;
+  /* the units point to the mapped data */
+  GstMapInfo map;
+  /* GstH265DecoderParsedUnit, not decoded yet */
+  GArray *units;
+  gboolean started;
+  gboolean decode_ret;
+} GstH265DecoderParsedFrame;
+
+/* In pipelined mode, what the submission thread can only do with the stream
+ * lock, in order */
+typedef enum
+{
+  /* output the picture */
+  GST_H265_DECODER_TASK_OUTPUT,
+  /* release the frame, its picture isn't output */
+  GST_H265_DECODER_TASK_RELEASE,
+  /* drop the frame, which failed to decode */
+  GST_H265_DECODER_TASK_ERROR
+} GstH265DecoderTaskType;
+
+typedef struct
+{
+  GstH265DecoderTaskType type;
+  /* Holds ref, for GST_H265_DECODER_TASK_OUTPUT */
+  GstH265Picture *picture;
+  guint32 system_frame_number;
+} GstH265DecoderTask;
+
 struct _GstH265DecoderPrivate
 {
   gint width, height;
@@ -118,6 +166,25 @@ struct _GstH265DecoderPrivate
   GArray *ref_pic_list_tmp;
   GArray *ref_pic_list0;
   GArray *ref_pic_list1;
+
+  /* Pipelined mode, see gst_h265_decoder_set_pipeline_depth() */
+  guint pipeline_depth;
+  GThread *pipeline_thread;
+  /* The frame being parsed by the streaming thread */
+  GstH265DecoderParsedFrame *parsed_frame;
+
+  /* protected by pipeline_lock */
+  GMutex pipeline_lock;
+  GCond pipeline_cond;
+  /* GstH265DecoderParsedFrame waiting for the submission thread */
+  GstQueueArray *pipeline_queue;
+  gboolean pipeline_busy;
+  gboolean pipeline_discard;
+  gboolean pipeline_stop;
+  /* GstH265DecoderTask waiting for the streaming thread */
+  GstQueueArray *pipeline_tasks;
+  /* first flow error of the tasks, not yet returned upstream */
+  GstFlowReturn pipeline_ret;
 };
 
 #define parent_class gst_h265_decoder_parent_class
@@ -144,6 +211,20 @@ static void gst_h265_decoder_clear_ref_pic_sets (GstH265Decoder * self);
 static void gst_h265_decoder_clear_dpb (GstH265Decoder * self, gboolean flush);
 static gboolean gst_h265_decoder_drain_internal (GstH265Decoder * self);
 static gboolean gst_h265_decoder_start_current_picture (GstH265Decoder * self);
+static void gst_h265_decoder_reset_frame_state (GstH265Decoder * self);
+static gboolean gst_h265_decoder_process_slice (GstH265Decoder * self,
+    GstClockTime pts);
+static void gst_h265_decoder_output_frame (GstH265Decoder * self,
+    GstH265Picture * picture);
+static void gst_h265_decoder_clear_task (GstH265DecoderTask * task);
+static void gst_h265_decoder_pipeline_wait (GstH265Decoder * self,
+    gboolean idle);
+static GstFlowReturn gst_h265_decoder_pipeline_handle_frame (GstH265Decoder *
+    self, GstVideoCodecFrame * frame);
+static gboolean gst_h265_decoder_pipeline_parse_nal (GstH265Decoder * self,
+    GstH265NalUnit * nalu);
+static gboolean gst_h265_decoder_decode_nals (GstH265Decoder * self,
+    const GstMapInfo * map, GstClockTime pts);
 
 static void
 gst_h265_decoder_class_init (GstH265DecoderClass * klass)
@@ -178,6 +259,14 @@ gst_h265_decoder_init (GstH265Decoder * self)
       sizeof (GstH265Picture *), 32);
   priv->ref_pic_list1 = g_array_sized_new (FALSE, TRUE,
       sizeof (GstH265Picture *), 32);
+
+  g_mutex_init (&priv->pipeline_lock);
+  g_cond_init (&priv->pipeline_cond);
+  priv->pipeline_queue = gst_queue_array_new (4);
+  priv->pipeline_tasks =
+      gst_queue_array_new_for_struct (sizeof (GstH265DecoderTask), 4);
+  gst_queue_array_set_clear_func (priv->pipeline_tasks,
+      (GDestroyNotify) gst_h265_decoder_clear_task);
 }
 
 static void
@@ -189,10 +278,338 @@ gst_h265_decoder_finalize (GObject * object)
   g_array_unref (priv->ref_pic_list_tmp);
   g_array_unref (priv->ref_pic_list0);
   g_array_unref (priv->ref_pic_list1);
+  gst_queue_array_free (priv->pipeline_queue);
+  gst_queue_array_free (priv->pipeline_tasks);
+  g_mutex_clear (&priv->pipeline_lock);
+  g_cond_clear (&priv->pipeline_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_h265_decoder_parsed_frame_free (GstH265DecoderParsedFrame * pf)
+{
+  if (pf->buffer) {
+    gst_buffer_unmap (pf->buffer, &pf->map);
+    gst_buffer_unref (pf->buffer);
+  }
+
+  g_array_unref (pf->units);
+  gst_video_codec_frame_unref (pf->frame);
+  g_free (pf);
+}
+
+/* Decodes the units parsed so far, on the submission thread, or on the
+ * streaming thread while the submission thread is idle */
+static gboolean
+gst_h265_decoder_decode_parsed_units (GstH265Decoder * self,
+    GstH265DecoderParsedFrame * pf)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstClockTime pts = GST_BUFFER_PTS (pf->frame->input_buffer);
+  guint i;
+
+  if (!pf->started) {
+    gst_h265_decoder_reset_frame_state (self);
+    pf->started = TRUE;
+  }
+
+  priv->current_frame = pf->frame;
+
+  for (i = 0; i < pf->units->len && pf->decode_ret; i++) {
+    GstH265DecoderParsedUnit *unit =
+        &g_array_index (pf->units, GstH265DecoderParsedUnit, i);
+
+    switch (unit->slice.nalu.type) {
+      case GST_H265_NAL_PREFIX_SEI:
+      case GST_H265_NAL_SUFFIX_SEI:
+        priv->cur_pic_struct = unit->pic_struct;
+        priv->cur_source_scan_type = unit->source_scan_type;
+        priv->cur_duplicate_flag = unit->duplicate_flag;
+        break;
+      case GST_H265_NAL_EOB:
+        priv->new_bitstream = TRUE;
+        break;
+      case GST_H265_NAL_EOS:
+        priv->prev_nal_is_eos = TRUE;
+        break;
+      default:
+        priv->current_slice = unit->slice;
+        pf->decode_ret = gst_h265_decoder_process_slice (self, pts);
+        priv->new_bitstream = FALSE;
+        priv->prev_nal_is_eos = FALSE;
+        break;
+    }
+  }
+
+  g_array_set_size (pf->units, 0);
+
+  return pf->decode_ret;
+}
+
+static gboolean
+gst_h265_decoder_is_submission_thread (GstH265Decoder * self)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  return priv->pipeline_thread && g_thread_self () == priv->pipeline_thread;
+}
+
+static void
+gst_h265_decoder_clear_task (GstH265DecoderTask * task)
+{
+  gst_h265_picture_clear (&task->picture);
+}
+
+/* Called on the submission thread, takes ownership of @picture */
+static void
+gst_h265_decoder_pipeline_push_task (GstH265Decoder * self,
+    GstH265DecoderTaskType type, GstH265Picture * picture,
+    guint32 system_frame_number)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstH265DecoderTask task;
+
+  task.type = type;
+  task.picture = picture;
+  task.system_frame_number = system_frame_number;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  gst_queue_array_push_tail_struct (priv->pipeline_tasks, &task);
+  g_cond_broadcast (&priv->pipeline_cond);
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
+/* Releases the frame of a picture that won't be output */
+static void
+gst_h265_decoder_release_frame (GstH265Decoder * self,
+    guint32 system_frame_number)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstVideoCodecFrame *frame;
+
+  if (gst_h265_decoder_is_submission_thread (self)) {
+    gst_h265_decoder_pipeline_push_task (self, GST_H265_DECODER_TASK_RELEASE,
+        NULL, system_frame_number);
+    return;
+  }
+
+  frame = gst_video_decoder_get_frame (decoder, system_frame_number);
+  if (frame)
+    gst_video_decoder_release_frame (decoder, frame);
+}
+
+static GstFlowReturn
+gst_h265_decoder_run_task (GstH265Decoder * self, GstH265DecoderTask * task)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstH265DecoderPrivate *priv = self->priv;
+  GstVideoCodecFrame *frame;
+
+  priv->last_ret = GST_FLOW_OK;
+
+  switch (task->type) {
+    case GST_H265_DECODER_TASK_OUTPUT:
+      gst_h265_decoder_output_frame (self, task->picture);
+      break;
+    case GST_H265_DECODER_TASK_RELEASE:
+      gst_h265_decoder_release_frame (self, task->system_frame_number);
+      break;
+    case GST_H265_DECODER_TASK_ERROR:
+      GST_VIDEO_DECODER_ERROR (self, 1, STREAM, DECODE,
+          ("Failed to decode data"), (NULL), priv->last_ret);
+      frame = gst_video_decoder_get_frame (decoder, task->system_frame_number);
+      if (frame)
+        gst_video_decoder_drop_frame (decoder, frame);
+      break;
+  }
+
+  return priv->last_ret;
+}
+
+/* Runs the tasks the submission thread left. Called with the stream lock and
+ * pipeline_lock, which is released meanwhile */
+static void
+gst_h265_decoder_pipeline_run_tasks (GstH265Decoder * self)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  while (!gst_queue_array_is_empty (priv->pipeline_tasks)) {
+    GstH265DecoderTask task = *(GstH265DecoderTask *)
+        gst_queue_array_pop_head_struct (priv->pipeline_tasks);
+    GstFlowReturn ret;
+
+    /* the base class discards the frames when flushing */
+    if (priv->pipeline_discard) {
+      gst_h265_decoder_clear_task (&task);
+      continue;
+    }
+
+    g_mutex_unlock (&priv->pipeline_lock);
+    ret = gst_h265_decoder_run_task (self, &task);
+    g_mutex_lock (&priv->pipeline_lock);
+
+    if (priv->pipeline_ret == GST_FLOW_OK)
+      priv->pipeline_ret = ret;
+  }
+}
+
+static void
+gst_h265_decoder_decode_parsed_frame (GstH265Decoder * self,
+    GstH265DecoderParsedFrame * pf)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  if (!gst_h265_decoder_decode_parsed_units (self, pf)) {
+    gst_h265_decoder_pipeline_push_task (self, GST_H265_DECODER_TASK_ERROR,
+        NULL, pf->frame->system_frame_number);
+    gst_h265_picture_clear (&priv->current_picture);
+  } else {
+    gst_h265_decoder_finish_current_picture (self);
+  }
+
+  priv->current_frame = NULL;
+}
+
+/* Keeps the first flow error until it can be returned upstream */
+static void
+gst_h265_decoder_pipeline_update_ret (GstH265Decoder * self)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  if (priv->pipeline_ret == GST_FLOW_OK)
+    priv->pipeline_ret = priv->last_ret;
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
+static GstFlowReturn
+gst_h265_decoder_pipeline_take_ret (GstH265Decoder * self)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  ret = priv->pipeline_ret;
+  priv->pipeline_ret = GST_FLOW_OK;
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  return ret;
+}
+
+/* Runs the tasks from the submission thread if the streaming thread doesn't
+ * hold the stream lock, typically while waiting for the next input in a
+ * live pipeline, so that decoded pictures don't wait for it to be output.
+ * Otherwise the streaming thread holds it and runs them itself */
+static void
+gst_h265_decoder_pipeline_try_run_tasks (GstH265Decoder * self)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstH265DecoderPrivate *priv = self->priv;
+
+  if (!g_rec_mutex_trylock (&decoder->stream_lock))
+    return;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  gst_h265_decoder_pipeline_run_tasks (self);
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+}
+
+static gpointer
+gst_h265_decoder_pipeline_thread (GstH265Decoder * self)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  while (TRUE) {
+    GstH265DecoderParsedFrame *pf;
+    gboolean discard;
+
+    while (!priv->pipeline_stop &&
+        gst_queue_array_is_empty (priv->pipeline_queue))
+      g_cond_wait (&priv->pipeline_cond, &priv->pipeline_lock);
+
+    if (priv->pipeline_stop)
+      break;
+
+    pf = gst_queue_array_pop_head (priv->pipeline_queue);
+    discard = priv->pipeline_discard;
+    priv->pipeline_busy = TRUE;
+    g_cond_broadcast (&priv->pipeline_cond);
+    g_mutex_unlock (&priv->pipeline_lock);
+
+    if (!discard)
+      gst_h265_decoder_decode_parsed_frame (self, pf);
+    gst_h265_decoder_parsed_frame_free (pf);
+
+    gst_h265_decoder_pipeline_try_run_tasks (self);
+
+    g_mutex_lock (&priv->pipeline_lock);
+    priv->pipeline_busy = FALSE;
+    g_cond_broadcast (&priv->pipeline_cond);
+  }
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  return NULL;
+}
+
+static gboolean
+gst_h265_decoder_pipeline_is_ready (GstH265Decoder * self, gboolean idle)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  guint len = gst_queue_array_get_length (priv->pipeline_queue);
+
+  if (idle)
+    return len == 0 && !priv->pipeline_busy;
+
+  return len < priv->pipeline_depth;
+}
+
+/* Waits until the submission thread has room for another frame, or until
+ * it decoded all of them if @idle is %TRUE, running the tasks it leaves
+ * meanwhile. Called with the stream lock, which the tasks need: the
+ * submission thread only ever tries to take it, as the base class can hold
+ * it more than once here */
+static void
+gst_h265_decoder_pipeline_wait (GstH265Decoder * self, gboolean idle)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  if (!priv->pipeline_thread)
+    return;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  while (TRUE) {
+    gst_h265_decoder_pipeline_run_tasks (self);
+    if (gst_h265_decoder_pipeline_is_ready (self, idle))
+      break;
+    g_cond_wait (&priv->pipeline_cond, &priv->pipeline_lock);
+  }
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
+static void
+gst_h265_decoder_pipeline_flush (GstH265Decoder * self)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
+  if (!priv->pipeline_thread)
+    return;
+
+  g_mutex_lock (&priv->pipeline_lock);
+  priv->pipeline_discard = TRUE;
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  gst_h265_decoder_pipeline_wait (self, TRUE);
+
+  g_mutex_lock (&priv->pipeline_lock);
+  priv->pipeline_discard = FALSE;
+  priv->pipeline_ret = GST_FLOW_OK;
+  g_mutex_unlock (&priv->pipeline_lock);
+}
+
 static gboolean
 gst_h265_decoder_start (GstVideoDecoder * decoder)
 {
@@ -204,6 +621,15 @@ gst_h265_decoder_start (GstVideoDecoder * decoder)
   priv->new_bitstream = TRUE;
   priv->prev_nal_is_eos = FALSE;
 
+  if (priv->pipeline_depth > 0) {
+    GST_DEBUG_OBJECT (self, "Pipelined mode, depth %u", priv->pipeline_depth);
+
+    priv->pipeline_stop = FALSE;
+    priv->pipeline_ret = GST_FLOW_OK;
+    priv->pipeline_thread = g_thread_new ("h265dec-submit",
+        (GThreadFunc) gst_h265_decoder_pipeline_thread, self);
+  }
+
   return TRUE;
 }
 
@@ -213,6 +639,22 @@ gst_h265_decoder_stop (GstVideoDecoder * decoder)
   GstH265Decoder *self = GST_H265_DECODER (decoder);
   GstH265DecoderPrivate *priv = self->priv;
 
+  if (priv->pipeline_thread) {
+    g_mutex_lock (&priv->pipeline_lock);
+    priv->pipeline_stop = TRUE;
+    g_cond_broadcast (&priv->pipeline_cond);
+    g_mutex_unlock (&priv->pipeline_lock);
+
+    g_thread_join (priv->pipeline_thread);
+    priv->pipeline_thread = NULL;
+
+    while (!gst_queue_array_is_empty (priv->pipeline_queue)) {
+      gst_h265_decoder_parsed_frame_free (gst_queue_array_pop_head
+          (priv->pipeline_queue));
+    }
+    gst_queue_array_clear (priv->pipeline_tasks);
+  }
+
   if (self->input_state) {
     gst_video_codec_state_unref (self->input_state);
     self->input_state = NULL;
@@ -254,6 +696,43 @@ gst_h265_decoder_parse_vps (GstH265Decoder * self, GstH265NalUnit * nalu)
   return ret;
 }
 
+/* In pipelined mode, up to pipeline_depth decoded frames can wait for the
+ * next one before being output */
+static void
+gst_h265_decoder_set_pipeline_latency (GstH265Decoder * self)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstCaps *caps;
+  GstClockTime latency;
+  GstStructure *structure;
+  gint fps_d = 1, fps_n = 0;
+
+  caps = gst_pad_get_current_caps (GST_VIDEO_DECODER_SRC_PAD (self));
+  if (caps) {
+    structure = gst_caps_get_structure (caps, 0);
+    if (gst_structure_get_fraction (structure, "framerate", &fps_n, &fps_d)
+        && fps_n == 0) {
+      /* variable framerate: see if we have a max-framerate */
+      gst_structure_get_fraction (structure, "max-framerate", &fps_n, &fps_d);
+    }
+    gst_caps_unref (caps);
+  }
+
+  /* if no fps or variable, then 25/1 */
+  if (fps_n == 0) {
+    fps_n = 25;
+    fps_d = 1;
+  }
+
+  latency = gst_util_uint64_scale_int (priv->pipeline_depth * GST_SECOND,
+      fps_d, fps_n);
+
+  GST_LOG_OBJECT (self, "pipeline latency %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (latency));
+
+  gst_video_decoder_set_latency (GST_VIDEO_DECODER (self), latency, latency);
+}
+
 static gboolean
 gst_h265_decoder_process_sps (GstH265Decoder * self, GstH265SPS * sps)
 {
@@ -318,6 +797,9 @@ gst_h265_decoder_process_sps (GstH265Decoder * self, GstH265SPS * sps)
     priv->interlaced_source_flag = interlaced_source_flag;
 
     gst_h265_dpb_set_max_num_pics (priv->dpb, max_dpb_size);
+
+    if (priv->pipeline_depth > 0)
+      gst_h265_decoder_set_pipeline_latency (self);
   }
 
   if (sps->max_latency_increase_plus1[sps->max_sub_layers_minus1]) {
@@ -377,12 +859,17 @@ gst_h265_decoder_parse_pps (GstH265Decoder * self, GstH265NalUnit * nalu)
   return TRUE;
 }
 
+/* Returns %TRUE if @nalu holds a picture timing SEI, and fills @pic_struct,
+ * @source_scan_type and @duplicate_flag with its values */
 static gboolean
-gst_h265_decoder_parse_sei (GstH265Decoder * self, GstH265NalUnit * nalu)
+gst_h265_decoder_parse_sei (GstH265Decoder * self, GstH265NalUnit * nalu,
+    GstH265SEIPicStructType * pic_struct, guint8 * source_scan_type,
+    guint8 * duplicate_flag)
 {
   GstH265DecoderPrivate *priv = self->priv;
   GstH265ParserResult pres;
   GArray *messages;
+  gboolean ret = FALSE;
   guint i;
 
   pres = gst_h265_parser_parse_sei (priv->parser, nalu, &messages);
@@ -391,7 +878,7 @@ gst_h265_decoder_parse_sei (GstH265Decoder * self, GstH265NalUnit * nalu)
 
     /* XXX: Ignore error from SEI parsing, it might be malformed bitstream,
      * or our fault. But shouldn't be critical  */
-    return TRUE;
+    return FALSE;
   }
 
   for (i = 0; i < messages->len; i++) {
@@ -399,14 +886,15 @@ gst_h265_decoder_parse_sei (GstH265Decoder * self, GstH265NalUnit * nalu)
 
     switch (sei->payloadType) {
       case GST_H265_SEI_PIC_TIMING:
-        priv->cur_pic_struct = sei->payload.pic_timing.pic_struct;
-        priv->cur_source_scan_type = sei->payload.pic_timing.source_scan_type;
-        priv->cur_duplicate_flag = sei->payload.pic_timing.duplicate_flag;
+        *pic_struct = sei->payload.pic_timing.pic_struct;
+        *source_scan_type = sei->payload.pic_timing.source_scan_type;
+        *duplicate_flag = sei->payload.pic_timing.duplicate_flag;
+        ret = TRUE;
 
         GST_TRACE_OBJECT (self,
             "Picture Timing SEI, pic_struct: %d, source_scan_type: %d, "
-            "duplicate_flag: %d", priv->cur_pic_struct,
-            priv->cur_source_scan_type, priv->cur_duplicate_flag);
+            "duplicate_flag: %d", *pic_struct, *source_scan_type,
+            *duplicate_flag);
         break;
       default:
         break;
@@ -416,7 +904,7 @@ gst_h265_decoder_parse_sei (GstH265Decoder * self, GstH265NalUnit * nalu)
   g_array_free (messages, TRUE);
   GST_LOG_OBJECT (self, "SEI parsed");
 
-  return TRUE;
+  return ret;
 }
 
 static void
@@ -610,6 +1098,15 @@ gst_h265_decoder_parse_slice (GstH265Decoder * self, GstH265NalUnit * nalu,
 
   priv->current_slice.nalu = *nalu;
 
+  return gst_h265_decoder_process_slice (self, pts);
+}
+
+/* Decodes priv->current_slice, once parsed */
+static gboolean
+gst_h265_decoder_process_slice (GstH265Decoder * self, GstClockTime pts)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+
   if (priv->current_slice.header.dependent_slice_segment_flag) {
     GstH265SliceHdr *slice_hdr = &priv->current_slice.header;
     GstH265SliceHdr *indep_slice_hdr = &priv->prev_independent_slice.header;
@@ -674,6 +1171,9 @@ gst_h265_decoder_decode_nal (GstH265Decoder * self, GstH265NalUnit * nalu,
   GST_LOG_OBJECT (self, "Parsed nal type: %d, offset %d, size %d",
       nalu->type, nalu->offset, nalu->size);
 
+  if (priv->parsed_frame)
+    return gst_h265_decoder_pipeline_parse_nal (self, nalu);
+
   switch (nalu->type) {
     case GST_H265_NAL_VPS:
       ret = gst_h265_decoder_parse_vps (self, nalu);
@@ -686,7 +1186,8 @@ gst_h265_decoder_decode_nal (GstH265Decoder * self, GstH265NalUnit * nalu,
       break;
     case GST_H265_NAL_PREFIX_SEI:
     case GST_H265_NAL_SUFFIX_SEI:
-      ret = gst_h265_decoder_parse_sei (self, nalu);
+      gst_h265_decoder_parse_sei (self, nalu, &priv->cur_pic_struct,
+          &priv->cur_source_scan_type, &priv->cur_duplicate_flag);
       break;
     case GST_H265_NAL_SLICE_TRAIL_N:
     case GST_H265_NAL_SLICE_TRAIL_R:
@@ -721,6 +1222,166 @@ gst_h265_decoder_decode_nal (GstH265Decoder * self, GstH265NalUnit * nalu,
   return ret;
 }
 
+/* Whether @nalu is a VPS, SPS or PPS identical to the one already stored
+ * with the same id, as most streams repeat them before every IRAP */
+static gboolean
+gst_h265_decoder_is_repeated_parameter_set (GstH265Decoder * self,
+    GstH265NalUnit * nalu)
+{
+  GstH265Parser *parser = self->priv->parser;
+
+  if (nalu->type == GST_H265_NAL_VPS) {
+    GstH265VPS vps;
+
+    if (gst_h265_parse_vps (nalu, &vps) != GST_H265_PARSER_OK)
+      return FALSE;
+
+    if (!parser->vps[vps.id].valid ||
+        memcmp (&parser->vps[vps.id], &vps, sizeof (vps)) != 0)
+      return FALSE;
+
+    parser->last_vps = &parser->vps[vps.id];
+  } else if (nalu->type == GST_H265_NAL_SPS) {
+    GstH265SPS sps;
+
+    if (gst_h265_parse_sps (parser, nalu, &sps, TRUE) != GST_H265_PARSER_OK)
+      return FALSE;
+
+    if (!parser->sps[sps.id].valid ||
+        memcmp (&parser->sps[sps.id], &sps, sizeof (sps)) != 0)
+      return FALSE;
+
+    parser->last_sps = &parser->sps[sps.id];
+  } else {
+    GstH265PPS pps;
+
+    if (gst_h265_parse_pps (parser, nalu, &pps) != GST_H265_PARSER_OK)
+      return FALSE;
+
+    if (!parser->pps[pps.id].valid ||
+        memcmp (&parser->pps[pps.id], &pps, sizeof (pps)) != 0)
+      return FALSE;
+
+    parser->last_pps = &parser->pps[pps.id];
+  }
+
+  return TRUE;
+}
+
+/* Called on the streaming thread in pipelined mode. Slices are only parsed,
+ * the submission thread decodes them. New parameter sets change the state
+ * it uses, so they wait for it to be done with the previous frames */
+static gboolean
+gst_h265_decoder_pipeline_parse_nal (GstH265Decoder * self,
+    GstH265NalUnit * nalu)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstH265DecoderParsedFrame *pf = priv->parsed_frame;
+  GstH265DecoderParsedUnit unit = { 0, };
+  GstH265ParserResult pres;
+
+  unit.slice.nalu = *nalu;
+
+  switch (nalu->type) {
+    case GST_H265_NAL_VPS:
+    case GST_H265_NAL_SPS:
+    case GST_H265_NAL_PPS:
+      if (gst_h265_decoder_is_repeated_parameter_set (self, nalu)) {
+        GST_LOG_OBJECT (self, "Skipping repeated parameter set");
+        break;
+      }
+
+      gst_h265_decoder_pipeline_wait (self, TRUE);
+
+      /* The units parsed before it come first */
+      priv->last_ret = GST_FLOW_OK;
+      if (gst_h265_decoder_decode_parsed_units (self, pf)) {
+        if (nalu->type == GST_H265_NAL_VPS)
+          pf->decode_ret = gst_h265_decoder_parse_vps (self, nalu);
+        else if (nalu->type == GST_H265_NAL_SPS)
+          pf->decode_ret = gst_h265_decoder_parse_sps (self, nalu);
+        else
+          pf->decode_ret = gst_h265_decoder_parse_pps (self, nalu);
+      }
+      gst_h265_decoder_pipeline_update_ret (self);
+      break;
+    case GST_H265_NAL_PREFIX_SEI:
+    case GST_H265_NAL_SUFFIX_SEI:
+      if (gst_h265_decoder_parse_sei (self, nalu, &unit.pic_struct,
+              &unit.source_scan_type, &unit.duplicate_flag))
+        g_array_append_val (pf->units, unit);
+      break;
+    case GST_H265_NAL_SLICE_TRAIL_N:
+    case GST_H265_NAL_SLICE_TRAIL_R:
+    case GST_H265_NAL_SLICE_TSA_N:
+    case GST_H265_NAL_SLICE_TSA_R:
+    case GST_H265_NAL_SLICE_STSA_N:
+    case GST_H265_NAL_SLICE_STSA_R:
+    case GST_H265_NAL_SLICE_RADL_N:
+    case GST_H265_NAL_SLICE_RADL_R:
+    case GST_H265_NAL_SLICE_RASL_N:
+    case GST_H265_NAL_SLICE_RASL_R:
+    case GST_H265_NAL_SLICE_BLA_W_LP:
+    case GST_H265_NAL_SLICE_BLA_W_RADL:
+    case GST_H265_NAL_SLICE_BLA_N_LP:
+    case GST_H265_NAL_SLICE_IDR_W_RADL:
+    case GST_H265_NAL_SLICE_IDR_N_LP:
+    case GST_H265_NAL_SLICE_CRA_NUT:
+      pres = gst_h265_parser_parse_slice_hdr (priv->parser, nalu,
+          &unit.slice.header);
+      if (pres != GST_H265_PARSER_OK) {
+        GST_ERROR_OBJECT (self, "Failed to parse slice header, ret %d", pres);
+        pf->decode_ret = FALSE;
+        break;
+      }
+
+      g_array_append_val (pf->units, unit);
+      break;
+    case GST_H265_NAL_EOB:
+    case GST_H265_NAL_EOS:
+      g_array_append_val (pf->units, unit);
+      break;
+    default:
+      break;
+  }
+
+  return pf->decode_ret;
+}
+
+static GstFlowReturn
+gst_h265_decoder_pipeline_handle_frame (GstH265Decoder * self,
+    GstVideoCodecFrame * frame)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstH265DecoderParsedFrame *pf;
+
+  pf = g_new0 (GstH265DecoderParsedFrame, 1);
+  pf->frame = frame;
+  pf->units = g_array_new (FALSE, FALSE, sizeof (GstH265DecoderParsedUnit));
+  pf->decode_ret = TRUE;
+
+  if (gst_buffer_map (frame->input_buffer, &pf->map, GST_MAP_READ)) {
+    pf->buffer = gst_buffer_ref (frame->input_buffer);
+
+    priv->parsed_frame = pf;
+    gst_h265_decoder_decode_nals (self, &pf->map,
+        GST_BUFFER_PTS (frame->input_buffer));
+    priv->parsed_frame = NULL;
+  } else {
+    GST_ERROR_OBJECT (self, "Failed to map input buffer");
+    pf->decode_ret = FALSE;
+  }
+
+  gst_h265_decoder_pipeline_wait (self, FALSE);
+
+  g_mutex_lock (&priv->pipeline_lock);
+  gst_queue_array_push_tail (priv->pipeline_queue, pf);
+  g_cond_broadcast (&priv->pipeline_cond);
+  g_mutex_unlock (&priv->pipeline_lock);
+
+  return gst_h265_decoder_pipeline_take_ret (self);
+}
+
 static void
 gst_h265_decoder_format_from_caps (GstH265Decoder * self, GstCaps * caps,
     GstH265DecoderFormat * format, GstH265DecoderAlign * align)
@@ -848,6 +1509,9 @@ gst_h265_decoder_set_format (GstVideoDecoder * decoder,
 
   GST_DEBUG_OBJECT (decoder, "Set format");
 
+  /* The submission thread might still use the state updated from here */
+  gst_h265_decoder_pipeline_wait (self, TRUE);
+
   if (self->input_state)
     gst_video_codec_state_unref (self->input_state);
 
@@ -929,6 +1593,7 @@ gst_h265_decoder_flush (GstVideoDecoder * decoder)
 {
   GstH265Decoder *self = GST_H265_DECODER (decoder);
 
+  gst_h265_decoder_pipeline_flush (self);
   gst_h265_decoder_clear_dpb (self, TRUE);
 
   return TRUE;
@@ -940,6 +1605,8 @@ gst_h265_decoder_drain (GstVideoDecoder * decoder)
   GstH265Decoder *self = GST_H265_DECODER (decoder);
   GstH265DecoderPrivate *priv = self->priv;
 
+  gst_h265_decoder_pipeline_wait (self, TRUE);
+
   priv->last_ret = GST_FLOW_OK;
   /* dpb will be cleared by this method */
   gst_h265_decoder_drain_internal (self);
@@ -950,7 +1617,19 @@ gst_h265_decoder_drain (GstVideoDecoder * decoder)
 static GstFlowReturn
 gst_h265_decoder_finish (GstVideoDecoder * decoder)
 {
-  return gst_h265_decoder_drain (decoder);
+  GstH265Decoder *self = GST_H265_DECODER (decoder);
+  GstFlowReturn ret;
+
+  ret = gst_h265_decoder_drain (decoder);
+
+  if (self->priv->pipeline_thread) {
+    GstFlowReturn pipeline_ret = gst_h265_decoder_pipeline_take_ret (self);
+
+    if (pipeline_ret != GST_FLOW_OK)
+      ret = pipeline_ret;
+  }
+
+  return ret;
 }
 
 static gboolean
@@ -1422,8 +2101,6 @@ gst_h265_decoder_do_output_picture (GstH265Decoder * self,
     GstH265Picture * picture)
 {
   GstH265DecoderPrivate *priv = self->priv;
-  GstH265DecoderClass *klass;
-  GstVideoCodecFrame *frame = NULL;
 
   GST_LOG_OBJECT (self, "Output picture %p (poc %d)", picture,
       picture->pic_order_cnt);
@@ -1436,6 +2113,22 @@ gst_h265_decoder_do_output_picture (GstH265Decoder * self,
 
   priv->last_output_poc = picture->pic_order_cnt;
 
+  if (gst_h265_decoder_is_submission_thread (self)) {
+    gst_h265_decoder_pipeline_push_task (self, GST_H265_DECODER_TASK_OUTPUT,
+        picture, 0);
+    return;
+  }
+
+  gst_h265_decoder_output_frame (self, picture);
+}
+
+static void
+gst_h265_decoder_output_frame (GstH265Decoder * self, GstH265Picture * picture)
+{
+  GstH265DecoderPrivate *priv = self->priv;
+  GstH265DecoderClass *klass;
+  GstVideoCodecFrame *frame = NULL;
+
   frame = gst_video_decoder_get_frame (GST_VIDEO_DECODER (self),
       picture->system_frame_number);
 
@@ -1458,7 +2151,6 @@ gst_h265_decoder_do_output_picture (GstH265Decoder * self,
 static void
 gst_h265_decoder_clear_dpb (GstH265Decoder * self, gboolean flush)
 {
-  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
   GstH265DecoderPrivate *priv = self->priv;
   GstH265Picture *picture;
 
@@ -1466,11 +2158,7 @@ gst_h265_decoder_clear_dpb (GstH265Decoder * self, gboolean flush)
    * GstVideoCodecFrame. Release frames manually */
   if (!flush) {
     while ((picture = gst_h265_dpb_bump (priv->dpb, TRUE)) != NULL) {
-      GstVideoCodecFrame *frame = gst_video_decoder_get_frame (decoder,
-          picture->system_frame_number);
-
-      if (frame)
-        gst_video_decoder_release_frame (decoder, frame);
+      gst_h265_decoder_release_frame (self, picture->system_frame_number);
       gst_h265_picture_unref (picture);
     }
   }
@@ -1597,7 +2285,6 @@ static gboolean
 gst_h265_decoder_finish_picture (GstH265Decoder * self,
     GstH265Picture * picture)
 {
-  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
   GstH265DecoderPrivate *priv = self->priv;
   const GstH265SPS *sps = priv->active_sps;
 
@@ -1608,12 +2295,8 @@ gst_h265_decoder_finish_picture (GstH265Decoder * self,
   gst_h265_dpb_delete_unused (priv->dpb);
 
   /* This picture is decode only, drop corresponding frame */
-  if (!picture->output_flag) {
-    GstVideoCodecFrame *frame = gst_video_decoder_get_frame (decoder,
-        picture->system_frame_number);
-
-    gst_video_decoder_release_frame (decoder, frame);
-  }
+  if (!picture->output_flag)
+    gst_h265_decoder_release_frame (self, picture->system_frame_number);
 
   /* gst_h265_dpb_add() will take care of pic_latency_cnt increment and
    * reference picture marking for this picture */
@@ -1677,66 +2360,79 @@ gst_h265_decoder_reset_frame_state (GstH265Decoder * self)
   priv->cur_duplicate_flag = 0;
 }
 
-static GstFlowReturn
-gst_h265_decoder_handle_frame (GstVideoDecoder * decoder,
-    GstVideoCodecFrame * frame)
+static gboolean
+gst_h265_decoder_decode_nals (GstH265Decoder * self, const GstMapInfo * map,
+    GstClockTime pts)
 {
-  GstH265Decoder *self = GST_H265_DECODER (decoder);
   GstH265DecoderPrivate *priv = self->priv;
-  GstBuffer *in_buf = frame->input_buffer;
   GstH265NalUnit nalu;
   GstH265ParserResult pres;
-  GstMapInfo map;
   gboolean decode_ret = TRUE;
 
-  GST_LOG_OBJECT (self,
-      "handle frame, PTS: %" GST_TIME_FORMAT ", DTS: %"
-      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_PTS (in_buf)),
-      GST_TIME_ARGS (GST_BUFFER_DTS (in_buf)));
-
-  priv->current_frame = frame;
-  priv->last_ret = GST_FLOW_OK;
-
-  gst_h265_decoder_reset_frame_state (self);
-
-  if (!gst_buffer_map (in_buf, &map, GST_MAP_READ)) {
-    GST_ELEMENT_ERROR (self, RESOURCE, READ,
-        ("Failed to map memory for reading"), (NULL));
-    return GST_FLOW_ERROR;
-  }
-
   if (priv->in_format == GST_H265_DECODER_FORMAT_HVC1 ||
       priv->in_format == GST_H265_DECODER_FORMAT_HEV1) {
     pres = gst_h265_parser_identify_nalu_hevc (priv->parser,
-        map.data, 0, map.size, priv->nal_length_size, &nalu);
+        map->data, 0, map->size, priv->nal_length_size, &nalu);
 
     while (pres == GST_H265_PARSER_OK && decode_ret) {
-      decode_ret = gst_h265_decoder_decode_nal (self,
-          &nalu, GST_BUFFER_PTS (in_buf));
+      decode_ret = gst_h265_decoder_decode_nal (self, &nalu, pts);
 
       pres = gst_h265_parser_identify_nalu_hevc (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, priv->nal_length_size,
-          &nalu);
+          map->data, nalu.offset + nalu.size, map->size,
+          priv->nal_length_size, &nalu);
     }
   } else {
     pres = gst_h265_parser_identify_nalu (priv->parser,
-        map.data, 0, map.size, &nalu);
+        map->data, 0, map->size, &nalu);
 
     if (pres == GST_H265_PARSER_NO_NAL_END)
       pres = GST_H265_PARSER_OK;
 
     while (pres == GST_H265_PARSER_OK && decode_ret) {
-      decode_ret = gst_h265_decoder_decode_nal (self,
-          &nalu, GST_BUFFER_PTS (in_buf));
+      decode_ret = gst_h265_decoder_decode_nal (self, &nalu, pts);
 
       pres = gst_h265_parser_identify_nalu (priv->parser,
-          map.data, nalu.offset + nalu.size, map.size, &nalu);
+          map->data, nalu.offset + nalu.size, map->size, &nalu);
 
       if (pres == GST_H265_PARSER_NO_NAL_END)
         pres = GST_H265_PARSER_OK;
     }
   }
 
+  return decode_ret;
+}
+
+static GstFlowReturn
+gst_h265_decoder_handle_frame (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame)
+{
+  GstH265Decoder *self = GST_H265_DECODER (decoder);
+  GstH265DecoderPrivate *priv = self->priv;
+  GstBuffer *in_buf = frame->input_buffer;
+  GstMapInfo map;
+  gboolean decode_ret;
+
+  GST_LOG_OBJECT (self,
+      "handle frame, PTS: %" GST_TIME_FORMAT ", DTS: %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_PTS (in_buf)),
+      GST_TIME_ARGS (GST_BUFFER_DTS (in_buf)));
+
+  if (priv->pipeline_thread)
+    return gst_h265_decoder_pipeline_handle_frame (self, frame);
+
+  priv->current_frame = frame;
+  priv->last_ret = GST_FLOW_OK;
+
+  gst_h265_decoder_reset_frame_state (self);
+
+  if (!gst_buffer_map (in_buf, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ,
+        ("Failed to map memory for reading"), (NULL));
+    return GST_FLOW_ERROR;
+  }
+
+  decode_ret = gst_h265_decoder_decode_nals (self, &map,
+      GST_BUFFER_PTS (in_buf));
   gst_buffer_unmap (in_buf, &map);
   priv->current_frame = NULL;
 
@@ -1772,6 +2468,42 @@ gst_h265_decoder_set_process_ref_pic_lists (GstH265Decoder * decoder,
   decoder->priv->process_ref_pic_lists = process;
 }
 
+/**
+ * gst_h265_decoder_set_pipeline_depth:
+ * @decoder: a #GstH265Decoder
+ * @depth: the number of frames parsed ahead of the submission, or 0
+ *
+ * Called to en/disable pipelined mode. In pipelined mode, the streaming
+ * thread only parses up to @depth frames ahead, while another thread manages
+ * the DPB and calls #GstH265DecoderClass.new_picture,
+ * #GstH265DecoderClass.start_picture, #GstH265DecoderClass.decode_slice and
+ * #GstH265DecoderClass.end_picture, so that parsing a frame overlaps with
+ * the submission of the previous ones. #GstH265DecoderClass.new_sequence is
+ * still called from the streaming thread, once all previous frames were
+ * submitted. #GstH265DecoderClass.output_picture is called with the stream
+ * lock held, from either thread.
+ *
+ * The methods called from the submission thread, such as
+ * #GstH265DecoderClass.new_picture and #GstH265DecoderClass.decode_slice,
+ * must not take the stream lock, which
+ * gst_video_decoder_allocate_output_frame() does for example. The streaming
+ * thread holds it while waiting for the submission thread, so the pipeline
+ * would deadlock.
+ *
+ * Up to @depth more frames are held back before being output, which is
+ * reported as latency.
+ *
+ * This must be called before the decoder is started, from the instance
+ * init function for example.
+ *
+ * Since: 1.20
+ */
+void
+gst_h265_decoder_set_pipeline_depth (GstH265Decoder * decoder, guint depth)
+{
+  decoder->priv->pipeline_depth = depth;
+}
+
 /**
  * gst_h265_decoder_get_picture:
  * @decoder: a #GstH265Decoder
@@ -143,6 +143,10 @@ GST_CODECS_API
 void gst_h265_decoder_set_process_ref_pic_lists (GstH265Decoder * decoder,
                                                  gboolean process);
 
+GST_CODECS_API
+void gst_h265_decoder_set_pipeline_depth (GstH265Decoder * decoder,
+                                          guint depth);
+
 GST_CODECS_API
 GstH265Picture * gst_h265_decoder_get_picture   (GstH265Decoder * decoder,
                                                  guint32 system_frame_number);
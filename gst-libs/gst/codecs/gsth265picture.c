@@ -22,6 +22,7 @@
 #endif
 
 #include "gsth265picture.h"
+#include <string.h>
 
 GST_DEBUG_CATEGORY_EXTERN (gst_h265_decoder_debug);
 #define GST_CAT_DEFAULT gst_h265_decoder_debug
@@ -105,13 +106,60 @@ gst_h265_picture_get_user_data (GstH265Picture * picture)
   return picture->user_data;
 }
 
+/* Number of hash buckets of the POC indices. Picture order counts of the
+ * pictures in a DPB are close to each other, so with a power of two larger
+ * than the number of pictures there are few collisions */
+#define GST_H265_DPB_INDEX_SIZE 64
+#define GST_H265_DPB_INDEX_BUCKET(poc) \
+    (((guint) (poc)) & (GST_H265_DPB_INDEX_SIZE - 1))
+
 struct _GstH265Dpb
 {
   GArray *pic_list;
   gint max_num_pics;
   gint num_output_needed;
+
+  /* Chained hash tables of the pictures in pic_list, keyed by pic_order_cnt
+   * and pic_order_cnt_lsb, which don't change once a picture is stored. The
+   * heads and next links are indices in pic_list, -1 terminated. Rebuilt on
+   * the first lookup after pic_list changed */
+  gboolean index_valid;
+  gint poc_head[GST_H265_DPB_INDEX_SIZE];
+  gint poc_lsb_head[GST_H265_DPB_INDEX_SIZE];
+  GArray *poc_next;
+  GArray *poc_lsb_next;
 };
 
+static void
+gst_h265_dpb_build_index (GstH265Dpb * dpb)
+{
+  guint i;
+
+  memset (dpb->poc_head, 0xff, sizeof (dpb->poc_head));
+  memset (dpb->poc_lsb_head, 0xff, sizeof (dpb->poc_lsb_head));
+  g_array_set_size (dpb->poc_next, dpb->pic_list->len);
+  g_array_set_size (dpb->poc_lsb_next, dpb->pic_list->len);
+
+  /* Inserted from the back so that every chain is in pic_list order, and a
+   * lookup returns the same picture as walking pic_list would */
+  for (i = dpb->pic_list->len; i > 0; i--) {
+    GstH265Picture *picture =
+        g_array_index (dpb->pic_list, GstH265Picture *, i - 1);
+    guint bucket;
+
+    bucket = GST_H265_DPB_INDEX_BUCKET (picture->pic_order_cnt);
+    g_array_index (dpb->poc_next, gint, i - 1) = dpb->poc_head[bucket];
+    dpb->poc_head[bucket] = i - 1;
+
+    bucket = GST_H265_DPB_INDEX_BUCKET (picture->pic_order_cnt_lsb);
+    g_array_index (dpb->poc_lsb_next, gint, i - 1) =
+        dpb->poc_lsb_head[bucket];
+    dpb->poc_lsb_head[bucket] = i - 1;
+  }
+
+  dpb->index_valid = TRUE;
+}
+
 /**
  * gst_h265_dpb_new: (skip)
  *
@@ -132,6 +180,11 @@ gst_h265_dpb_new (void)
   g_array_set_clear_func (dpb->pic_list,
       (GDestroyNotify) gst_h265_picture_clear);
 
+  dpb->poc_next = g_array_sized_new (FALSE, FALSE, sizeof (gint),
+      GST_H265_DPB_MAX_SIZE + 1);
+  dpb->poc_lsb_next = g_array_sized_new (FALSE, FALSE, sizeof (gint),
+      GST_H265_DPB_MAX_SIZE + 1);
+
   return dpb;
 }
 
@@ -177,6 +230,8 @@ gst_h265_dpb_free (GstH265Dpb * dpb)
 
   gst_h265_dpb_clear (dpb);
   g_array_unref (dpb->pic_list);
+  g_array_unref (dpb->poc_next);
+  g_array_unref (dpb->poc_lsb_next);
   g_free (dpb);
 }
 
@@ -193,6 +248,7 @@ gst_h265_dpb_clear (GstH265Dpb * dpb)
 
   g_array_set_size (dpb->pic_list, 0);
   dpb->num_output_needed = 0;
+  dpb->index_valid = FALSE;
 }
 
 /**
@@ -231,6 +287,7 @@ gst_h265_dpb_add (GstH265Dpb * dpb, GstH265Picture * picture)
   picture->long_term = FALSE;
 
   g_array_append_val (dpb->pic_list, picture);
+  dpb->index_valid = FALSE;
 }
 
 /**
@@ -254,6 +311,7 @@ gst_h265_dpb_delete_unused (GstH265Dpb * dpb)
       GST_TRACE ("remove picture %p (poc %d) from dpb",
           picture, picture->pic_order_cnt);
       g_array_remove_index (dpb->pic_list, i);
+      dpb->index_valid = FALSE;
       i--;
     }
   }
@@ -321,7 +379,11 @@ gst_h265_dpb_get_ref_by_poc (GstH265Dpb * dpb, gint poc)
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
+  if (!dpb->index_valid)
+    gst_h265_dpb_build_index (dpb);
+
+  for (i = dpb->poc_head[GST_H265_DPB_INDEX_BUCKET (poc)]; i >= 0;
+      i = g_array_index (dpb->poc_next, gint, i)) {
     GstH265Picture *picture =
         g_array_index (dpb->pic_list, GstH265Picture *, i);
 
@@ -350,7 +412,11 @@ gst_h265_dpb_get_ref_by_poc_lsb (GstH265Dpb * dpb, gint poc_lsb)
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
+  if (!dpb->index_valid)
+    gst_h265_dpb_build_index (dpb);
+
+  for (i = dpb->poc_lsb_head[GST_H265_DPB_INDEX_BUCKET (poc_lsb)]; i >= 0;
+      i = g_array_index (dpb->poc_lsb_next, gint, i)) {
     GstH265Picture *picture =
         g_array_index (dpb->pic_list, GstH265Picture *, i);
 
@@ -379,7 +445,11 @@ gst_h265_dpb_get_short_ref_by_poc (GstH265Dpb * dpb, gint poc)
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
+  if (!dpb->index_valid)
+    gst_h265_dpb_build_index (dpb);
+
+  for (i = dpb->poc_head[GST_H265_DPB_INDEX_BUCKET (poc)]; i >= 0;
+      i = g_array_index (dpb->poc_next, gint, i)) {
     GstH265Picture *picture =
         g_array_index (dpb->pic_list, GstH265Picture *, i);
 
@@ -408,7 +478,11 @@ gst_h265_dpb_get_long_ref_by_poc (GstH265Dpb * dpb, gint poc)
 
   g_return_val_if_fail (dpb != NULL, NULL);
 
-  for (i = 0; i < dpb->pic_list->len; i++) {
+  if (!dpb->index_valid)
+    gst_h265_dpb_build_index (dpb);
+
+  for (i = dpb->poc_head[GST_H265_DPB_INDEX_BUCKET (poc)]; i >= 0;
+      i = g_array_index (dpb->poc_next, gint, i)) {
     GstH265Picture *picture =
         g_array_index (dpb->pic_list, GstH265Picture *, i);
 
@@ -621,8 +695,10 @@ gst_h265_dpb_bump (GstH265Dpb * dpb, gboolean drain)
   dpb->num_output_needed--;
   g_assert (dpb->num_output_needed >= 0);
 
-  if (!picture->ref || drain)
+  if (!picture->ref || drain) {
     g_array_remove_index_fast (dpb->pic_list, index);
+    dpb->index_valid = FALSE;
+  }
 
   return picture;
 }
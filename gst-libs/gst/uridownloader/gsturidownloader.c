@@ -306,6 +306,21 @@ gst_uri_downloader_bus_handler (GstBus * bus,
     }
     if (parent)
       gst_object_unref (parent);
+  } else if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_HAVE_CONTEXT) {
+    GstElement *parent = g_weak_ref_get (&downloader->priv->parent);
+
+    /* give the context to the parent, so that it is shared with its other
+     * elements and downloaders, e.g. the HTTP session of souphttpsrc and
+     * with it the connections that are kept alive */
+    if (parent) {
+      GstContext *context;
+
+      gst_message_parse_have_context (message, &context);
+      gst_element_set_context (parent, context);
+      gst_element_post_message (parent,
+          gst_message_new_have_context (GST_OBJECT_CAST (parent), context));
+      gst_object_unref (parent);
+    }
   }
 
   gst_message_unref (message);
@@ -40,6 +40,8 @@ plugin_init (GstPlugin * plugin)
   ret |= GST_ELEMENT_REGISTER (fakeaudiosink, plugin);
   ret |= GST_ELEMENT_REGISTER (fakevideosink, plugin);
   ret |= GST_ELEMENT_REGISTER (fpsdisplaysink, plugin);
+  ret |= GST_ELEMENT_REGISTER (nullh264dec, plugin);
+  ret |= GST_ELEMENT_REGISTER (nullh265dec, plugin);
   ret |= GST_ELEMENT_REGISTER (testsrcbin, plugin);
   ret |= GST_ELEMENT_REGISTER (videocodectestsink, plugin);
   ret |= GST_ELEMENT_REGISTER (watchdog, plugin);
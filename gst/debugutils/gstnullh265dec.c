@@ -0,0 +1,307 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gstdebugutilsbadelements.h"
+#include "gstnullh265dec.h"
+
+/**
+ * SECTION:element-nullh265dec
+ * @title: nullh265dec
+ *
+ * A H.265 decoder based on #GstH265Decoder which does not decode anything.
+ * It outputs one uninitialized NV12 frame per picture, in presentation
+ * order, and can wait for a while for each picture to simulate a hardware
+ * decoder. This element is meant to test and to benchmark #GstH265Decoder.
+ *
+ * ## Example launch line
+ * |[
+ * gst-launch-1.0 filesrc location=in.h265 ! h265parse ! nullh265dec pipeline-depth=2 submit-delay=2000 ! fakesink
+ * ]|
+ *
+ * Since: 1.20
+ */
+
+GST_DEBUG_CATEGORY_STATIC (gst_null_h265_dec_debug);
+#define GST_CAT_DEFAULT gst_null_h265_dec_debug
+
+#define DEFAULT_PIPELINE_DEPTH 0
+#define DEFAULT_SUBMIT_DELAY 0
+
+enum
+{
+  PROP_0,
+  PROP_PIPELINE_DEPTH,
+  PROP_SUBMIT_DELAY,
+};
+
+struct _GstNullH265Dec
+{
+  GstH265Decoder parent;
+
+  /* protected by the stream lock */
+  gint width, height;
+
+  /* copied from the properties on start */
+  gulong submit_delay;
+
+  /* protected by the object lock */
+  guint pipeline_depth;
+  guint submit_delay_prop;
+};
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-h265, "
+        "stream-format = (string) { hvc1, hev1, byte-stream }, "
+        "alignment = (string) au"));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("NV12")));
+
+#define gst_null_h265_dec_parent_class parent_class
+G_DEFINE_TYPE (GstNullH265Dec, gst_null_h265_dec, GST_TYPE_H265_DECODER);
+GST_ELEMENT_REGISTER_DEFINE (nullh265dec, "nullh265dec", GST_RANK_NONE,
+    gst_null_h265_dec_get_type ());
+
+static void
+gst_null_h265_dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstNullH265Dec *self = GST_NULL_H265_DEC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (prop_id) {
+    case PROP_PIPELINE_DEPTH:
+      self->pipeline_depth = g_value_get_uint (value);
+      break;
+    case PROP_SUBMIT_DELAY:
+      self->submit_delay_prop = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+gst_null_h265_dec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstNullH265Dec *self = GST_NULL_H265_DEC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (prop_id) {
+    case PROP_PIPELINE_DEPTH:
+      g_value_set_uint (value, self->pipeline_depth);
+      break;
+    case PROP_SUBMIT_DELAY:
+      g_value_set_uint (value, self->submit_delay_prop);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean
+gst_null_h265_dec_start (GstVideoDecoder * decoder)
+{
+  GstNullH265Dec *self = GST_NULL_H265_DEC (decoder);
+
+  GST_OBJECT_LOCK (self);
+  gst_h265_decoder_set_pipeline_depth (GST_H265_DECODER (self),
+      self->pipeline_depth);
+  self->submit_delay = self->submit_delay_prop;
+  GST_OBJECT_UNLOCK (self);
+
+  self->width = self->height = 0;
+
+  return GST_VIDEO_DECODER_CLASS (parent_class)->start (decoder);
+}
+
+static gboolean
+gst_null_h265_dec_new_sequence (GstH265Decoder * decoder,
+    const GstH265SPS * sps, gint max_dpb_size)
+{
+  GstNullH265Dec *self = GST_NULL_H265_DEC (decoder);
+  GstVideoDecoder *vdec = GST_VIDEO_DECODER (decoder);
+  GstVideoCodecState *state;
+  gint width, height;
+
+  if (sps->conformance_window_flag) {
+    width = sps->crop_rect_width;
+    height = sps->crop_rect_height;
+  } else {
+    width = sps->width;
+    height = sps->height;
+  }
+
+  if (width == self->width && height == self->height)
+    return TRUE;
+
+  GST_INFO_OBJECT (self, "Resolution changed to %dx%d", width, height);
+
+  self->width = width;
+  self->height = height;
+
+  state = gst_video_decoder_set_output_state (vdec, GST_VIDEO_FORMAT_NV12,
+      width, height, decoder->input_state);
+  gst_video_codec_state_unref (state);
+
+  if (!gst_video_decoder_negotiate (vdec)) {
+    GST_ERROR_OBJECT (self, "Failed to negotiate with downstream");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_null_h265_dec_start_picture (GstH265Decoder * decoder,
+    GstH265Picture * picture, GstH265Slice * slice, GstH265Dpb * dpb)
+{
+  return TRUE;
+}
+
+static gboolean
+gst_null_h265_dec_decode_slice (GstH265Decoder * decoder,
+    GstH265Picture * picture, GstH265Slice * slice, GArray * ref_pic_list0,
+    GArray * ref_pic_list1)
+{
+  return TRUE;
+}
+
+static gboolean
+gst_null_h265_dec_end_picture (GstH265Decoder * decoder,
+    GstH265Picture * picture)
+{
+  GstNullH265Dec *self = GST_NULL_H265_DEC (decoder);
+
+  /* Where a hardware decoder would wait for the picture to be decoded */
+  if (self->submit_delay > 0)
+    g_usleep (self->submit_delay);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_null_h265_dec_output_picture (GstH265Decoder * decoder,
+    GstVideoCodecFrame * frame, GstH265Picture * picture)
+{
+  GstVideoDecoder *vdec = GST_VIDEO_DECODER (decoder);
+  GstFlowReturn ret;
+
+  GST_LOG_OBJECT (decoder, "Output picture %u, POC %d",
+      picture->system_frame_number, picture->pic_order_cnt);
+
+  gst_h265_picture_unref (picture);
+
+  ret = gst_video_decoder_allocate_output_frame (vdec, frame);
+  if (ret != GST_FLOW_OK) {
+    gst_video_decoder_drop_frame (vdec, frame);
+    return ret;
+  }
+
+  return gst_video_decoder_finish_frame (vdec, frame);
+}
+
+static void
+gst_null_h265_dec_class_init (GstNullH265DecClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstVideoDecoderClass *decoder_class = GST_VIDEO_DECODER_CLASS (klass);
+  GstH265DecoderClass *h265decoder_class = GST_H265_DECODER_CLASS (klass);
+
+  gobject_class->set_property = gst_null_h265_dec_set_property;
+  gobject_class->get_property = gst_null_h265_dec_get_property;
+
+  decoder_class->start = GST_DEBUG_FUNCPTR (gst_null_h265_dec_start);
+
+  h265decoder_class->new_sequence =
+      GST_DEBUG_FUNCPTR (gst_null_h265_dec_new_sequence);
+  h265decoder_class->start_picture =
+      GST_DEBUG_FUNCPTR (gst_null_h265_dec_start_picture);
+  h265decoder_class->decode_slice =
+      GST_DEBUG_FUNCPTR (gst_null_h265_dec_decode_slice);
+  h265decoder_class->end_picture =
+      GST_DEBUG_FUNCPTR (gst_null_h265_dec_end_picture);
+  h265decoder_class->output_picture =
+      GST_DEBUG_FUNCPTR (gst_null_h265_dec_output_picture);
+
+  gst_element_class_add_static_pad_template (element_class, &sink_template);
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+
+  /**
+   * GstNullH265Dec:pipeline-depth:
+   *
+   * See gst_h265_decoder_set_pipeline_depth(), applied on start.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_PIPELINE_DEPTH,
+      g_param_spec_uint ("pipeline-depth", "Pipeline Depth",
+          "Number of frames parsed ahead of the submission "
+          "(0 = parse and submit from the streaming thread)", 0, 16,
+          DEFAULT_PIPELINE_DEPTH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstNullH265Dec:submit-delay:
+   *
+   * Time spent by each picture in #GstH265DecoderClass.end_picture, as a
+   * hardware decoder would.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_SUBMIT_DELAY,
+      g_param_spec_uint ("submit-delay", "Submit Delay",
+          "Time to wait for each picture to be decoded, in microseconds",
+          0, G_USEC_PER_SEC, DEFAULT_SUBMIT_DELAY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_set_static_metadata (element_class,
+      "Null H.265 Decoder", "Codec/Decoder/Video",
+      "Runs the H.265 decoding process without decoding anything",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  GST_DEBUG_CATEGORY_INIT (gst_null_h265_dec_debug, "nullh265dec", 0,
+      "Null H.265 Decoder");
+}
+
+static void
+gst_null_h265_dec_init (GstNullH265Dec * self)
+{
+  self->pipeline_depth = DEFAULT_PIPELINE_DEPTH;
+  self->submit_delay_prop = DEFAULT_SUBMIT_DELAY;
+}
@@ -110,12 +110,78 @@ GST_STATIC_PAD_TEMPLATE ("src",
 enum
 {
   PROP_0,
-  PROP_SIGMA
+  PROP_SIGMA,
+  PROP_MODE,
+  PROP_N_THREADS
 };
 
+/* Fixed point precision of the kernel coefficients and of the horizontally
+ * blurred intermediate values */
+#define KERNEL_SHIFT 14
+#define TEMP_SHIFT 5
+#define ROUND_SHIFT(v, s) (((v) + (1 << ((s) - 1))) >> (s))
+
+/* The exact blur works on tiles of this many pixels and rows, so that the
+ * horizontally blurred rows of a tile stay in the cache for the vertical
+ * pass */
+#define TILE_WIDTH 256
+#define TILE_HEIGHT 64
+
+#define BOX_PASSES 3
+
+struct _GstGaussianBlurScratch
+{
+  gint16 *temp;
+  gint32 *acc;
+  gint32 *weights;
+  guint8 *rows[2];
+};
+
+typedef void (*GstGaussianBlurBandFunc) (GstGaussianBlur * gb,
+    GstGaussianBlurBand * band);
+
+struct _GstGaussianBlurBand
+{
+  GstGaussianBlurBandFunc func;
+  const guint8 *src;
+  gint src_stride;
+  guint8 *dest;
+  gint dest_stride;
+  gint radius;
+
+  gint y0, y1;
+  GstGaussianBlurScratch *scratch;
+};
+
+#define GST_TYPE_GAUSSIANBLUR_MODE (gst_gaussianblur_mode_get_type ())
+static GType
+gst_gaussianblur_mode_get_type (void)
+{
+  static GType mode_type = 0;
+
+  if (g_once_init_enter (&mode_type)) {
+    GType type;
+    static const GEnumValue modes[] = {
+      {GST_GAUSSIANBLUR_MODE_EXACT, "Convolve with the gaussian kernel",
+          "exact"},
+      {GST_GAUSSIANBLUR_MODE_BOX,
+          "Approximate with a cascade of box blurs (blurring only)", "box"},
+      {0, NULL, NULL},
+    };
+
+    type = g_enum_register_static ("GstGaussianBlurMode", modes);
+    g_once_init_leave (&mode_type, type);
+  }
+
+  return mode_type;
+}
+
 static gboolean make_gaussian_kernel (GstGaussianBlur * gb, float sigma);
-static void gaussian_smooth (GstGaussianBlur * gb, guint8 * image,
-    guint8 * out_image);
+static void gaussian_smooth (GstGaussianBlur * gb, GstVideoFrame * in_frame,
+    GstVideoFrame * out_frame, guint n_bands);
+static void box_smooth (GstGaussianBlur * gb, GstVideoFrame * in_frame,
+    GstVideoFrame * out_frame, guint n_bands);
+static void free_scratch (GstGaussianBlur * gb);
 
 #define gst_gaussianblur_parent_class parent_class
 G_DEFINE_TYPE (GstGaussianBlur, gst_gaussianblur, GST_TYPE_VIDEO_FILTER);
@@ -124,6 +190,8 @@ GST_ELEMENT_REGISTER_DEFINE_WITH_CODE (gaussianblur, "gaussianblur",
     GST_DEBUG_CATEGORY_INIT (gst_gauss_blur_debug, "gaussianblur", 0,
         "Gaussian Blur video effect"));
 #define DEFAULT_SIGMA 1.2
+#define DEFAULT_MODE GST_GAUSSIANBLUR_MODE_EXACT
+#define DEFAULT_N_THREADS 1
 
 /* Initialize the gaussianblur's class. */
 static void
@@ -154,9 +222,38 @@ gst_gaussianblur_class_init (GstGaussianBlurClass * klass)
           -20.0, 20.0, DEFAULT_SIGMA,
           G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstGaussianBlur:mode:
+   *
+   * How to blur. The box blur cascade is much cheaper for large sigmas, but
+   * can't sharpen: negative sigmas always use the exact kernel.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "Mode", "How to blur",
+          GST_TYPE_GAUSSIANBLUR_MODE, DEFAULT_MODE,
+          G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstGaussianBlur:n-threads:
+   *
+   * Number of threads the frames are split into row bands for, 0 uses one
+   * per processor.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Threads",
+          "Maximum number of threads to use (0 = number of processors)",
+          0, G_MAXINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   vfilter_class->transform_frame =
       GST_DEBUG_FUNCPTR (gst_gaussianblur_transform_frame);
   vfilter_class->set_info = GST_DEBUG_FUNCPTR (gst_gaussianblur_set_info);
+
+  gst_type_mark_as_plugin_api (GST_TYPE_GAUSSIANBLUR_MODE, 0);
 }
 
 static gboolean
@@ -164,15 +261,17 @@ gst_gaussianblur_set_info (GstVideoFilter * filter, GstCaps * incaps,
     GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
 {
   GstGaussianBlur *gb = GST_GAUSSIANBLUR (filter);
-  guint32 n_elems;
 
   gb->width = GST_VIDEO_INFO_WIDTH (in_info);
   gb->height = GST_VIDEO_INFO_HEIGHT (in_info);
 
   /* get stride */
   gb->stride = GST_VIDEO_INFO_COMP_STRIDE (in_info, 0);
-  n_elems = gb->stride * gb->height;
-  gb->tempim = g_malloc (sizeof (gfloat) * n_elems);
+
+  /* the scratch buffers depend on the width */
+  free_scratch (gb);
+  g_free (gb->boxim);
+  gb->boxim = NULL;
 
   return TRUE;
 }
@@ -182,6 +281,10 @@ gst_gaussianblur_init (GstGaussianBlur * gb)
 {
   gb->sigma = (gfloat) DEFAULT_SIGMA;
   gb->cur_sigma = -1.0;
+  gb->mode = DEFAULT_MODE;
+  gb->n_threads = DEFAULT_N_THREADS;
+  g_mutex_init (&gb->band_lock);
+  g_cond_init (&gb->band_cond);
 }
 
 static void
@@ -189,16 +292,23 @@ gst_gaussianblur_finalize (GObject * object)
 {
   GstGaussianBlur *gb = GST_GAUSSIANBLUR (object);
 
-  g_free (gb->tempim);
-  gb->tempim = NULL;
-
-  g_free (gb->smoothedim);
-  gb->smoothedim = NULL;
+  if (gb->pool)
+    g_thread_pool_free (gb->pool, FALSE, TRUE);
+  free_scratch (gb);
+  g_free (gb->boxim);
+  gb->boxim = NULL;
 
   g_free (gb->kernel);
   gb->kernel = NULL;
   g_free (gb->kernel_sum);
   gb->kernel_sum = NULL;
+  g_free (gb->kernel_fixed);
+  gb->kernel_fixed = NULL;
+  g_free (gb->box_recip);
+  gb->box_recip = NULL;
+
+  g_mutex_clear (&gb->band_lock);
+  g_cond_clear (&gb->band_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -211,7 +321,8 @@ gst_gaussianblur_transform_frame (GstVideoFilter * vfilter,
   GstClockTime timestamp;
   gint64 stream_time;
   gfloat sigma;
-  guint8 *src, *dest;
+  GstGaussianBlurMode mode;
+  guint n_bands;
 
   /* GstController: update the properties */
   timestamp = GST_BUFFER_TIMESTAMP (in_frame->buffer);
@@ -227,6 +338,8 @@ gst_gaussianblur_transform_frame (GstVideoFilter * vfilter,
 
   GST_OBJECT_LOCK (filter);
   sigma = filter->sigma;
+  mode = filter->mode;
+  n_bands = filter->n_threads ? filter->n_threads : g_get_num_processors ();
   GST_OBJECT_UNLOCK (filter);
 
   if (filter->cur_sigma != sigma) {
@@ -234,6 +347,12 @@ gst_gaussianblur_transform_frame (GstVideoFilter * vfilter,
     filter->kernel = NULL;
     g_free (filter->kernel_sum);
     filter->kernel_sum = NULL;
+    g_free (filter->kernel_fixed);
+    filter->kernel_fixed = NULL;
+    g_free (filter->box_recip);
+    filter->box_recip = NULL;
+    /* the scratch buffers depend on the kernel size */
+    free_scratch (filter);
     filter->cur_sigma = sigma;
   }
   if (filter->kernel == NULL &&
@@ -243,118 +362,447 @@ gst_gaussianblur_transform_frame (GstVideoFilter * vfilter,
     return GST_FLOW_ERROR;
   }
 
+  if (filter->cur_sigma == 0.0) {
+    gst_video_frame_copy (out_frame, in_frame);
+    return GST_FLOW_OK;
+  }
+
   /*
    * Perform gaussian smoothing on the image using the input standard
    * deviation.
    */
-  src = GST_VIDEO_FRAME_COMP_DATA (in_frame, 0);
-  dest = GST_VIDEO_FRAME_COMP_DATA (out_frame, 0);
-  gst_video_frame_copy (out_frame, in_frame);
-  if (filter->sigma != 0.0)
-    gaussian_smooth (filter, src, dest);
+  n_bands = MIN (n_bands, filter->height);
+  if (mode == GST_GAUSSIANBLUR_MODE_BOX && filter->cur_sigma > 0.0)
+    box_smooth (filter, in_frame, out_frame, n_bands);
+  else
+    gaussian_smooth (filter, in_frame, out_frame, n_bands);
 
   return GST_FLOW_OK;
 }
 
 static void
-blur_row_x (GstGaussianBlur * gb, guint8 * in_row, gfloat * out_row)
+free_scratch (GstGaussianBlur * gb)
 {
-  int c, cc, center;
-  float dot[4], sum;
-  int k, kmin, kmax;
-
-  center = gb->windowsize / 2;
-
-  for (c = 0; c < gb->width; c++) {
-    /* Calculate min */
-    cc = center - c;
-    kmin = MAX (0, cc);
-    cc = kmin - cc;
-    /* Calc max */
-    kmax = MIN (gb->windowsize, gb->width - cc);
-    cc *= 4;
-
-    dot[0] = dot[1] = dot[2] = dot[3] = 0.0;
-    /* Calculate sum for range */
-    sum = gb->kernel_sum[kmax - 1];
-    sum -= kmin ? gb->kernel_sum[kmin - 1] : 0.0;
+  guint i;
+
+  for (i = 0; i < gb->n_scratch; i++) {
+    g_free (gb->scratch[i].temp);
+    g_free (gb->scratch[i].acc);
+    g_free (gb->scratch[i].weights);
+    g_free (gb->scratch[i].rows[0]);
+    g_free (gb->scratch[i].rows[1]);
+  }
+  g_free (gb->scratch);
+  gb->scratch = NULL;
+  g_free (gb->bands);
+  gb->bands = NULL;
+  gb->n_scratch = 0;
+}
+
+/* Makes sure there are scratch buffers for n_bands bands, for the current
+ * width and kernel */
+static void
+ensure_scratch (GstGaussianBlur * gb, guint n_bands)
+{
+  guint i;
 
+  if (gb->n_scratch >= n_bands)
+    return;
+
+  gb->scratch = g_renew (GstGaussianBlurScratch, gb->scratch, n_bands);
+  gb->bands = g_renew (GstGaussianBlurBand, gb->bands, n_bands);
+
+  for (i = gb->n_scratch; i < n_bands; i++) {
+    GstGaussianBlurScratch *scratch = &gb->scratch[i];
+
+    scratch->temp = g_new (gint16,
+        (TILE_HEIGHT + gb->windowsize - 1) * TILE_WIDTH * 4);
+    scratch->acc = g_new (gint32, MAX (gb->width, TILE_WIDTH) * 4);
+    scratch->weights = g_new (gint32, gb->windowsize);
+    scratch->rows[0] = g_new (guint8, gb->width * 4);
+    scratch->rows[1] = g_new (guint8, gb->width * 4);
+  }
+  gb->n_scratch = n_bands;
+}
+
+static void
+band_func (gpointer data, gpointer user_data)
+{
+  GstGaussianBlur *gb = user_data;
+  GstGaussianBlurBand *band = data;
+
+  band->func (gb, band);
+
+  g_mutex_lock (&gb->band_lock);
+  if (--gb->bands_pending == 0)
+    g_cond_signal (&gb->band_cond);
+  g_mutex_unlock (&gb->band_lock);
+}
+
+/* Calls func for n_bands row bands of the frame, all but the first one in
+ * the thread pool, and waits for them to finish */
+static void
+run_bands (GstGaussianBlur * gb, guint n_bands, GstGaussianBlurBandFunc func,
+    const guint8 * src, gint src_stride, guint8 * dest, gint dest_stride,
+    gint radius)
+{
+  guint i;
+
+  ensure_scratch (gb, n_bands);
+
+  for (i = 0; i < n_bands; i++) {
+    GstGaussianBlurBand *band = &gb->bands[i];
+
+    band->func = func;
+    band->src = src;
+    band->src_stride = src_stride;
+    band->dest = dest;
+    band->dest_stride = dest_stride;
+    band->radius = radius;
+    band->y0 = (gint) ((guint64) gb->height * i / n_bands);
+    band->y1 = (gint) ((guint64) gb->height * (i + 1) / n_bands);
+    band->scratch = &gb->scratch[i];
+  }
+
+  if (n_bands > 1) {
+    if (gb->pool == NULL) {
+      gb->pool = g_thread_pool_new (band_func, gb, n_bands - 1, FALSE, NULL);
+    } else if (g_thread_pool_get_max_threads (gb->pool) != n_bands - 1) {
+      g_thread_pool_set_max_threads (gb->pool, n_bands - 1, NULL);
+    }
+
+    g_mutex_lock (&gb->band_lock);
+    gb->bands_pending = n_bands - 1;
+    g_mutex_unlock (&gb->band_lock);
+
+    for (i = 1; i < n_bands; i++)
+      g_thread_pool_push (gb->pool, &gb->bands[i], NULL);
+  }
+
+  func (gb, &gb->bands[0]);
+
+  if (n_bands > 1) {
+    g_mutex_lock (&gb->band_lock);
+    while (gb->bands_pending > 0)
+      g_cond_wait (&gb->band_cond, &gb->band_lock);
+    g_mutex_unlock (&gb->band_lock);
+  }
+}
+
+/* Fixed point coefficients for the taps kmin to kmax - 1 of the kernel,
+ * renormalized to that part of it like at the edges of the image */
+static const gint32 *
+make_fixed_weights (GstGaussianBlur * gb, gint kmin, gint kmax,
+    gint32 * weights)
+{
+  float sum;
+  gint k, total = 0, max_k = kmin;
+
+  if (kmin == 0 && kmax == gb->windowsize)
+    return gb->kernel_fixed;
+
+  sum = gb->kernel_sum[kmax - 1];
+  sum -= kmin ? gb->kernel_sum[kmin - 1] : 0.0;
+
+  for (k = kmin; k < kmax; k++) {
+    weights[k] = (gint32) lrintf (gb->kernel[k] / sum * (1 << KERNEL_SHIFT));
+    total += weights[k];
+    if (fabsf (gb->kernel[k]) > fabsf (gb->kernel[max_k]))
+      max_k = k;
+  }
+  /* make them add up to exactly one */
+  weights[max_k] += (1 << KERNEL_SHIFT) - total;
+
+  return weights;
+}
+
+/* Horizontal blur of a pixel for which the kernel doesn't fit in the row */
+static void
+blur_pixel_x (GstGaussianBlur * gb, gint32 * weights, const guint8 * in_row,
+    gint16 * out, gint x)
+{
+  const gint center = gb->windowsize / 2;
+  gint kmin = MAX (0, center - x);
+  gint kmax = MIN (gb->windowsize, gb->width + center - x);
+  const guint8 *in = in_row + (x - center + kmin) * 4;
+  const gint32 *coeffs;
+  gint32 dot[4] = { 0, 0, 0, 0 };
+  gint k, c;
+
+  coeffs = make_fixed_weights (gb, kmin, kmax, weights);
+  for (k = kmin; k < kmax; k++, in += 4)
+    for (c = 0; c < 4; c++)
+      dot[c] += in[c] * coeffs[k];
+
+  for (c = 0; c < 4; c++)
+    out[c] = ROUND_SHIFT (dot[c], KERNEL_SHIFT - TEMP_SHIFT);
+}
+
+/* Horizontal blur of the pixels x0 to x1 - 1 of a row. Where the whole
+ * kernel fits in the row, each tap is applied to the whole span at once,
+ * which the compiler can vectorize. */
+static void
+blur_row_x (GstGaussianBlur * gb, GstGaussianBlurScratch * scratch,
+    const guint8 * in_row, gint16 * out_row, gint x0, gint x1)
+{
+  const gint center = gb->windowsize / 2;
+  gint32 *acc = scratch->acc;
+  gint ix0, ix1, x, k, i, n;
+
+  ix0 = CLAMP (center, x0, x1);
+  ix1 = CLAMP (gb->width - center, ix0, x1);
+
+  for (x = x0; x < ix0; x++)
+    blur_pixel_x (gb, scratch->weights, in_row, out_row + (x - x0) * 4, x);
+
+  n = (ix1 - ix0) * 4;
+  if (n > 0) {
+    const guint8 *in = in_row + (ix0 - center) * 4;
+    gint16 *out = out_row + (ix0 - x0) * 4;
+
+    memset (acc, 0, n * sizeof (gint32));
+    for (k = 0; k < gb->windowsize; k++, in += 4) {
+      const gint32 coeff = gb->kernel_fixed[k];
+
+      for (i = 0; i < n; i++)
+        acc[i] += in[i] * coeff;
+    }
+    for (i = 0; i < n; i++)
+      out[i] = ROUND_SHIFT (acc[i], KERNEL_SHIFT - TEMP_SHIFT);
+  }
+
+  for (x = ix1; x < x1; x++)
+    blur_pixel_x (gb, scratch->weights, in_row, out_row + (x - x0) * 4, x);
+}
+
+/* Blurs the pixels x0 to x1 - 1 of the rows y0 to y1 - 1. All the input rows
+ * the tile needs are blurred horizontally into the scratch buffer first. */
+static void
+blur_tile (GstGaussianBlur * gb, GstGaussianBlurBand * band, gint x0, gint x1,
+    gint y0, gint y1)
+{
+  GstGaussianBlurScratch *scratch = band->scratch;
+  const gint center = gb->windowsize / 2;
+  const gint ty0 = MAX (0, y0 - center);
+  const gint ty1 = MIN (gb->height, y1 + center);
+  const gint n = (x1 - x0) * 4;
+  gint32 *acc = scratch->acc;
+  gint y, k, i;
+
+  for (y = ty0; y < ty1; y++)
+    blur_row_x (gb, scratch, band->src + y * band->src_stride,
+        scratch->temp + (y - ty0) * TILE_WIDTH * 4, x0, x1);
+
+  for (y = y0; y < y1; y++) {
+    gint kmin = MAX (0, center - y);
+    gint kmax = MIN (gb->windowsize, gb->height + center - y);
+    const gint32 *coeffs;
+    guint8 *out = band->dest + y * band->dest_stride + x0 * 4;
+
+    coeffs = make_fixed_weights (gb, kmin, kmax, scratch->weights);
+
+    memset (acc, 0, n * sizeof (gint32));
     for (k = kmin; k < kmax; k++) {
-      float coeff = gb->kernel[k];
-      dot[0] += (float) in_row[cc++] * coeff;
-      dot[1] += (float) in_row[cc++] * coeff;
-      dot[2] += (float) in_row[cc++] * coeff;
-      dot[3] += (float) in_row[cc++] * coeff;
+      const gint16 *tmp =
+          scratch->temp + (y - center + k - ty0) * TILE_WIDTH * 4;
+      const gint32 coeff = coeffs[k];
+
+      for (i = 0; i < n; i++)
+        acc[i] += tmp[i] * coeff;
+    }
+    for (i = 0; i < n; i++) {
+      gint32 v = ROUND_SHIFT (acc[i], KERNEL_SHIFT + TEMP_SHIFT);
+
+      out[i] = CLAMP (v, 0, 255);
     }
+  }
+}
 
-    out_row[c * 4] = dot[0] / sum;
-    out_row[c * 4 + 1] = dot[1] / sum;
-    out_row[c * 4 + 2] = dot[2] / sum;
-    out_row[c * 4 + 3] = dot[3] / sum;
+static void
+gaussian_smooth_band (GstGaussianBlur * gb, GstGaussianBlurBand * band)
+{
+  gint x, y;
+
+  for (y = band->y0; y < band->y1; y += TILE_HEIGHT) {
+    for (x = 0; x < gb->width; x += TILE_WIDTH) {
+      blur_tile (gb, band, x, MIN (x + TILE_WIDTH, gb->width), y,
+          MIN (y + TILE_HEIGHT, band->y1));
+    }
   }
 }
 
 static void
-gaussian_smooth (GstGaussianBlur * gb, guint8 * image, guint8 * out_image)
+gaussian_smooth (GstGaussianBlur * gb, GstVideoFrame * in_frame,
+    GstVideoFrame * out_frame, guint n_bands)
 {
-  int r, c, rr, center;
-  float dot[4], sum;
-  int k, kmin, kmax;
-  guint8 *in_row = image;
-  float *tmp_out_row = gb->tempim;
-  float *tmp_in_pos;
-  gint y_avail = 0;
-  guint8 *out_row;
-
-  /* Apply the gaussian kernel */
-  center = gb->windowsize / 2;
-
-  /* Blur in the y - direction. */
-  for (r = 0; r < gb->height; r++) {
-    /* Calculate input row range */
-    rr = center - r;
-    kmin = MAX (0, rr);
-    rr = kmin - rr;
-    /* Calc max */
-    kmax = MIN (gb->windowsize, gb->height - rr);
-
-    /* Precalculate sum for range */
-    sum = gb->kernel_sum[kmax - 1];
-    sum -= kmin ? gb->kernel_sum[kmin - 1] : 0.0;
-
-    /* Blur more input rows (x direction blur) */
-    while (y_avail <= (r + center) && y_avail < gb->height) {
-      blur_row_x (gb, in_row, tmp_out_row);
-      in_row += gb->stride;
-      tmp_out_row += gb->stride;
-      y_avail++;
+  run_bands (gb, n_bands, gaussian_smooth_band,
+      GST_VIDEO_FRAME_COMP_DATA (in_frame, 0),
+      GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0),
+      GST_VIDEO_FRAME_COMP_DATA (out_frame, 0),
+      GST_VIDEO_FRAME_COMP_STRIDE (out_frame, 0), 0);
+}
+
+/*
+ * Box blur cascade: BOX_PASSES box blurs in each direction approximate a
+ * gaussian blur, with a cost that doesn't depend on sigma. The box sizes
+ * are the ones giving the closest variance, like in "Fast Almost-Gaussian
+ * Filtering" by Kovesi. Like the kernel, the boxes are renormalized to the
+ * part inside the image at the edges.
+ */
+static void
+make_box_kernel (GstGaussianBlur * gb, float sigma)
+{
+  gdouble var = 12.0 * sigma * sigma;
+  gint wl, wu, m, i, max_radius;
+
+  wl = (gint) floor (sqrt (var / BOX_PASSES + 1.0));
+  if (wl % 2 == 0)
+    wl--;
+  wu = wl + 2;
+  m = (gint) floor ((var - BOX_PASSES * wl * wl - 4 * BOX_PASSES * wl -
+          3 * BOX_PASSES) / (-4.0 * wl - 4.0) + 0.5);
+
+  for (i = 0; i < BOX_PASSES; i++)
+    gb->box_radii[i] = ((i < m ? wl : wu) - 1) / 2;
+  max_radius = MAX (gb->box_radii[0], gb->box_radii[BOX_PASSES - 1]);
+
+  /* the sums are at most 255 * count, so rounding down the reciprocals
+   * keeps the results within 255 */
+  gb->box_recip = g_new (guint32, 2 * max_radius + 2);
+  gb->box_recip[0] = 0;
+  for (i = 1; i < 2 * max_radius + 2; i++)
+    gb->box_recip[i] = 65536 / i;
+
+  GST_DEBUG_OBJECT (gb, "box radii for sigma %f: %d %d %d", sigma,
+      gb->box_radii[0], gb->box_radii[1], gb->box_radii[2]);
+}
+
+static void
+box_blur_row (GstGaussianBlur * gb, const guint8 * in, guint8 * out,
+    gint radius)
+{
+  const guint32 *recip = gb->box_recip;
+  guint32 sum[4] = { 0, 0, 0, 0 };
+  gint x, c, count;
+
+  count = MIN (radius, gb->width - 1) + 1;
+  for (x = 0; x < count; x++)
+    for (c = 0; c < 4; c++)
+      sum[c] += in[x * 4 + c];
+
+  for (x = 0; x < gb->width; x++) {
+    for (c = 0; c < 4; c++)
+      out[x * 4 + c] = (sum[c] * recip[count] + 32768) >> 16;
+
+    if (x + radius + 1 < gb->width) {
+      for (c = 0; c < 4; c++)
+        sum[c] += in[(x + radius + 1) * 4 + c];
+      count++;
     }
+    if (x - radius >= 0) {
+      for (c = 0; c < 4; c++)
+        sum[c] -= in[(x - radius) * 4 + c];
+      count--;
+    }
+  }
+}
 
-    tmp_in_pos = gb->tempim + (rr * gb->stride);
-    out_row = out_image + r * gb->stride;
+/* Horizontal passes, one row at a time */
+static void
+box_blur_x_band (GstGaussianBlur * gb, GstGaussianBlurBand * band)
+{
+  GstGaussianBlurScratch *scratch = band->scratch;
+  gint y, i;
 
-    for (c = 0; c < gb->width; c++) {
-      float *tmp = tmp_in_pos;
+  for (y = band->y0; y < band->y1; y++) {
+    const guint8 *in = band->src + y * band->src_stride;
 
-      dot[0] = dot[1] = dot[2] = dot[3] = 0.0;
-      for (k = kmin; k < kmax; k++, tmp += gb->stride) {
-        float kern = gb->kernel[k];
-        dot[0] += tmp[0] * kern;
-        dot[1] += tmp[1] * kern;
-        dot[2] += tmp[2] * kern;
-        dot[3] += tmp[3] * kern;
-      }
+    for (i = 0; i < BOX_PASSES; i++) {
+      guint8 *out = i == BOX_PASSES - 1 ?
+          band->dest + y * band->dest_stride : scratch->rows[i % 2];
 
-      *out_row++ = (guint8) CLAMP ((dot[0] / sum + 0.5), 0, 255);
-      *out_row++ = (guint8) CLAMP ((dot[1] / sum + 0.5), 0, 255);
-      *out_row++ = (guint8) CLAMP ((dot[2] / sum + 0.5), 0, 255);
-      *out_row++ = (guint8) CLAMP ((dot[3] / sum + 0.5), 0, 255);
+      box_blur_row (gb, in, out, gb->box_radii[i]);
+      in = out;
+    }
+  }
+}
 
-      tmp_in_pos += 4;
+/* One vertical pass. The sums of the columns are kept for the whole row and
+ * slid down, so the frame is only ever accessed row by row. */
+static void
+box_blur_y_band (GstGaussianBlur * gb, GstGaussianBlurBand * band)
+{
+  const guint32 *recip = gb->box_recip;
+  const gint radius = band->radius;
+  const gint n = gb->width * 4;
+  guint32 *sum = (guint32 *) band->scratch->acc;
+  const guint8 *in;
+  gint y, i, lo, hi, count;
+
+  lo = MAX (0, band->y0 - radius);
+  hi = MIN (gb->height - 1, band->y0 + radius);
+  count = hi - lo + 1;
+
+  memset (sum, 0, n * sizeof (guint32));
+  for (y = lo; y <= hi; y++) {
+    in = band->src + y * band->src_stride;
+    for (i = 0; i < n; i++)
+      sum[i] += in[i];
+  }
+
+  for (y = band->y0; y < band->y1; y++) {
+    guint8 *out = band->dest + y * band->dest_stride;
+    const guint32 r = recip[count];
+
+    for (i = 0; i < n; i++)
+      out[i] = (sum[i] * r + 32768) >> 16;
+
+    if (y + radius + 1 < gb->height) {
+      in = band->src + (y + radius + 1) * band->src_stride;
+      for (i = 0; i < n; i++)
+        sum[i] += in[i];
+      count++;
+    }
+    if (y - radius >= 0) {
+      in = band->src + (y - radius) * band->src_stride;
+      for (i = 0; i < n; i++)
+        sum[i] -= in[i];
+      count--;
     }
   }
 }
 
+static void
+box_smooth (GstGaussianBlur * gb, GstVideoFrame * in_frame,
+    GstVideoFrame * out_frame, guint n_bands)
+{
+  guint8 *src = GST_VIDEO_FRAME_COMP_DATA (in_frame, 0);
+  guint8 *dest = GST_VIDEO_FRAME_COMP_DATA (out_frame, 0);
+  gint src_stride = GST_VIDEO_FRAME_COMP_STRIDE (in_frame, 0);
+  gint dest_stride = GST_VIDEO_FRAME_COMP_STRIDE (out_frame, 0);
+  gint tmp_stride = gb->width * 4;
+  gint i;
+
+  if (gb->box_recip == NULL)
+    make_box_kernel (gb, gb->cur_sigma);
+  if (gb->boxim == NULL)
+    gb->boxim = g_new (guint8, tmp_stride * gb->height);
+
+  /* every vertical pass needs the whole output of the previous one, so they
+   * go back and forth between the output frame and the temporary frame,
+   * ending in the output frame */
+  run_bands (gb, n_bands, box_blur_x_band, src, src_stride, gb->boxim,
+      tmp_stride, 0);
+  for (i = 0; i < BOX_PASSES; i++) {
+    if (i % 2 == 0)
+      run_bands (gb, n_bands, box_blur_y_band, gb->boxim, tmp_stride, dest,
+          dest_stride, gb->box_radii[i]);
+    else
+      run_bands (gb, n_bands, box_blur_y_band, dest, dest_stride, gb->boxim,
+          tmp_stride, gb->box_radii[i]);
+  }
+}
+
 /*
  * Create a one dimensional gaussian kernel.
  */
@@ -363,6 +811,7 @@ make_gaussian_kernel (GstGaussianBlur * gb, float sigma)
 {
   int i, center, left, right;
   float sum, sum2;
+  gint32 fixed_sum;
   const float fe = -0.5 / (sigma * sigma);
   const float dx = 1.0 / (sigma * sqrt (2 * G_PI));
 
@@ -374,9 +823,12 @@ make_gaussian_kernel (GstGaussianBlur * gb, float sigma)
   if (gb->kernel == NULL || gb->kernel_sum == NULL)
     return FALSE;
 
+  gb->kernel_fixed = g_new (gint32, gb->windowsize);
+
   if (gb->windowsize == 1) {
     gb->kernel[0] = 1.0;
     gb->kernel_sum[0] = 1.0;
+    gb->kernel_fixed[0] = 1 << KERNEL_SHIFT;
     return TRUE;
   }
 
@@ -406,6 +858,14 @@ make_gaussian_kernel (GstGaussianBlur * gb, float sigma)
     gb->kernel_sum[i] = sum2;
   }
 
+  fixed_sum = 0;
+  for (i = 0; i < gb->windowsize; i++) {
+    gb->kernel_fixed[i] = (gint32) lrintf (gb->kernel[i] * (1 << KERNEL_SHIFT));
+    fixed_sum += gb->kernel_fixed[i];
+  }
+  /* make it add up to exactly one */
+  gb->kernel_fixed[center] += (1 << KERNEL_SHIFT) - fixed_sum;
+
 #if 0
   g_print ("Sigma %f: ", sigma);
   for (i = 0; i < gb->windowsize; i++)
@@ -432,6 +892,16 @@ gst_gaussianblur_set_property (GObject * object,
       gb->sigma = g_value_get_double (value);
       GST_OBJECT_UNLOCK (object);
       break;
+    case PROP_MODE:
+      GST_OBJECT_LOCK (object);
+      gb->mode = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (object);
+      break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (object);
+      gb->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (object);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -449,6 +919,16 @@ gst_gaussianblur_get_property (GObject * object,
       g_value_set_double (value, gb->sigma);
       GST_OBJECT_UNLOCK (gb);
       break;
+    case PROP_MODE:
+      GST_OBJECT_LOCK (gb);
+      g_value_set_enum (value, gb->mode);
+      GST_OBJECT_UNLOCK (gb);
+      break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (gb);
+      g_value_set_uint (value, gb->n_threads);
+      GST_OBJECT_UNLOCK (gb);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
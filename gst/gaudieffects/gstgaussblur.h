@@ -61,6 +61,15 @@ G_BEGIN_DECLS
 typedef struct _GstGaussianBlur GstGaussianBlur;
 typedef struct _GstGaussianBlurClass GstGaussianBlurClass;
 
+typedef enum
+{
+  GST_GAUSSIANBLUR_MODE_EXACT,
+  GST_GAUSSIANBLUR_MODE_BOX
+} GstGaussianBlurMode;
+
+typedef struct _GstGaussianBlurScratch GstGaussianBlurScratch;
+typedef struct _GstGaussianBlurBand GstGaussianBlurBand;
+
 struct _GstGaussianBlur
 {
   GstVideoFilter videofilter;
@@ -71,8 +80,26 @@ struct _GstGaussianBlur
 
   float *kernel;
   float *kernel_sum;
-  float *tempim;
-  gint16 *smoothedim;
+  /* kernel in fixed point */
+  gint32 *kernel_fixed;
+
+  /* box blur cascade radii and reciprocals of the window sizes */
+  gint box_radii[3];
+  guint32 *box_recip;
+  guint8 *boxim;
+
+  GstGaussianBlurMode mode;
+  guint n_threads;
+
+  /* per band scratch buffers */
+  GstGaussianBlurScratch *scratch;
+  guint n_scratch;
+
+  GstGaussianBlurBand *bands;
+  GThreadPool *pool;
+  GMutex band_lock;
+  GCond band_cond;
+  gint bands_pending;
 };
 
 struct _GstGaussianBlurClass
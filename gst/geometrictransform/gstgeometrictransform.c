@@ -24,6 +24,7 @@
 #include "gstgeometrictransform.h"
 #include "geometricmath.h"
 #include <string.h>
+#include <math.h>
 
 GST_DEBUG_CATEGORY_STATIC (geometric_transform_debug);
 #define GST_CAT_DEFAULT geometric_transform_debug
@@ -49,7 +50,8 @@ static GstVideoFilterClass *parent_class = NULL;
 enum
 {
   PROP_0,
-  PROP_OFF_EDGE_PIXELS
+  PROP_OFF_EDGE_PIXELS,
+  PROP_N_THREADS
 };
 
 #define GST_GT_OFF_EDGES_PIXELS_METHOD_TYPE ( \
@@ -75,6 +77,65 @@ gst_geometric_transform_off_edges_pixels_method_get_type (void)
 }
 
 #define DEFAULT_OFF_EDGE_PIXELS GST_GT_OFF_EDGES_PIXELS_IGNORE
+#define DEFAULT_N_THREADS 1
+
+/* map entry of pixels that have no input pixel */
+#define MAP_INVALID G_MININT32
+
+/* the integer part of the map entries is a signed 16 bit value */
+#define MAX_SIZE G_MAXINT16
+
+typedef struct
+{
+  const guint8 *in_data;
+  guint8 *out_data;
+  gint y_start;
+  gint y_end;
+} GstGeometricTransformBand;
+
+/* Applies the off edge pixels method to an input coordinate and converts it
+ * to 16.16 fixed point, in the [0, size) range. Returns MAP_INVALID if there
+ * is no input pixel for it. */
+static inline gint32
+gst_geometric_transform_to_fixed (gdouble in, gint size, gint off_edge_pixels)
+{
+  gint32 fixed;
+
+  if (!isfinite (in))
+    return MAP_INVALID;
+
+  switch (off_edge_pixels) {
+    case GST_GT_OFF_EDGES_PIXELS_CLAMP:
+      in = CLAMP (in, 0, size - 1);
+      break;
+
+    case GST_GT_OFF_EDGES_PIXELS_WRAP:
+      in = gst_gm_mod_float (in, size);
+      if (in < 0)
+        in += size;
+      if (in >= size)
+        in -= size;
+      break;
+
+    default:
+      /* truncating to the pixel it falls in must give a valid one */
+      if (in <= -1.0 || in >= size)
+        return MAP_INVALID;
+      in = MAX (in, 0);
+      break;
+  }
+
+  fixed = MIN ((gint32) (in * 65536.0), (size << 16) - 1);
+
+  /* Maps computed with trigonometry, like rotations by right angles, land a
+   * rounding error away from pixels. Those just below a pixel take the one
+   * they truncate to, as with the nearest pixel mapping, instead of getting
+   * 255/256 of the next one */
+  if ((fixed & 0xffff) == 0xffff)
+    fixed &= ~0xffff;
+
+  return fixed;
+}
 
 /* must be called with the object lock */
 static gboolean
@@ -84,23 +145,18 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
   gdouble in_x, in_y;
   gboolean ret = TRUE;
   GstGeometricTransformClass *klass;
-  gdouble *ptr;
-
-  GST_INFO_OBJECT (gt, "Generating new transform map");
+  gint32 *ptr;
 
-  /* cleanup old map */
-  g_free (gt->map);
-  gt->map = NULL;
+  GST_LOG_OBJECT (gt, "Generating new transform map");
 
   klass = GST_GEOMETRIC_TRANSFORM_GET_CLASS (gt);
 
   /* subclass must have defined the map_func */
   g_return_val_if_fail (klass->map_func, FALSE);
 
-  /*
-   * (x,y) pairs of the inverse mapping
-   */
-  gt->map = g_malloc0 (sizeof (gdouble) * gt->width * gt->height * 2);
+  /* the size only changes in set_info, which frees the map */
+  if (gt->map == NULL)
+    gt->map = g_new (gint32, (gsize) gt->width * gt->height * 2);
   ptr = gt->map;
 
   for (y = 0; y < gt->height; y++) {
@@ -111,8 +167,12 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
         goto end;
       }
 
-      ptr[0] = in_x;
-      ptr[1] = in_y;
+      ptr[0] = gst_geometric_transform_to_fixed (in_x, gt->width,
+          gt->off_edge_pixels);
+      ptr[1] = gst_geometric_transform_to_fixed (in_y, gt->height,
+          gt->off_edge_pixels);
+      if (ptr[0] == MAP_INVALID || ptr[1] == MAP_INVALID)
+        ptr[0] = ptr[1] = MAP_INVALID;
       ptr += 2;
     }
   }
@@ -143,15 +203,34 @@ gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
   old_width = gt->width;
   old_height = gt->height;
 
+  if (in_info->width > MAX_SIZE || in_info->height > MAX_SIZE) {
+    GST_ERROR_OBJECT (gt, "Unsupported size %dx%d", in_info->width,
+        in_info->height);
+    return FALSE;
+  }
+
   gt->width = in_info->width;
   gt->height = in_info->height;
+  gt->format = GST_VIDEO_INFO_FORMAT (in_info);
   gt->row_stride = in_info->stride[0];
   gt->pixel_stride = GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0);
 
+  if (gt->format == GST_VIDEO_FORMAT_AYUV) {
+    /* in AYUV black is not just all zeros:
+     * 0x10 is black for Y,
+     * 0x80 is black for Cr and Cb */
+    GST_WRITE_UINT32_BE (gt->black, 0xff108080);
+  } else {
+    memset (gt->black, 0, sizeof (gt->black));
+  }
+
   /* regenerate the map */
   GST_OBJECT_LOCK (gt);
   if (gt->map == NULL || old_width == 0 || old_height == 0
       || gt->width != old_width || gt->height != old_height) {
+    g_free (gt->map);
+    gt->map = NULL;
+    gt->needs_remap = TRUE;
     if (klass->prepare_func)
       if (!klass->prepare_func (gt)) {
         GST_OBJECT_UNLOCK (gt);
@@ -164,46 +243,203 @@ gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
   return ret;
 }
 
+/* Bilinear sampling of formats with 8 bit components, pstride is a constant
+ * in each caller so that the loop over the components gets unrolled or
+ * vectorized by the compiler. The fractional parts of the map are reduced to
+ * 8 bits, which keeps all the intermediate values in 32 bits. */
+static inline void
+gst_geometric_transform_sample_rows_8 (GstGeometricTransform * gt,
+    const guint8 * in_data, guint8 * out_data, gint y_start, gint y_end,
+    const gint pstride)
+{
+  const gint32 *map = gt->map + (gsize) y_start * gt->width * 2;
+  const gint last_x = gt->width - 1;
+  const gint last_y = gt->height - 1;
+  const gboolean wrap = gt->off_edge_pixels == GST_GT_OFF_EDGES_PIXELS_WRAP;
+  const gint edge_x = wrap ? 0 : last_x;
+  const gint edge_y = wrap ? 0 : last_y;
+  const gint rstride = gt->row_stride;
+  gint x, y, c;
+
+  for (y = y_start; y < y_end; y++) {
+    guint8 *out = out_data + (gsize) y * rstride;
+
+    for (x = 0; x < gt->width; x++, map += 2, out += pstride) {
+      const guint8 *p00, *p01, *p10, *p11;
+      gint x0, y0, x1, y1;
+      guint wx, wy;
+
+      if (G_UNLIKELY (map[0] == MAP_INVALID)) {
+        memcpy (out, gt->black, pstride);
+        continue;
+      }
+
+      x0 = map[0] >> 16;
+      y0 = map[1] >> 16;
+      wx = (map[0] >> 8) & 0xff;
+      wy = (map[1] >> 8) & 0xff;
+      x1 = x0 < last_x ? x0 + 1 : edge_x;
+      y1 = y0 < last_y ? y0 + 1 : edge_y;
+
+      p00 = in_data + y0 * rstride + x0 * pstride;
+      p01 = in_data + y0 * rstride + x1 * pstride;
+      p10 = in_data + y1 * rstride + x0 * pstride;
+      p11 = in_data + y1 * rstride + x1 * pstride;
+
+      for (c = 0; c < pstride; c++) {
+        guint top = p00[c] * (256 - wx) + p01[c] * wx;
+        guint bottom = p10[c] * (256 - wx) + p11[c] * wx;
+
+        out[c] = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+      }
+    }
+  }
+}
+
+/* Same for GRAY16, the intermediate values still fit in 32 bits */
 static void
-gst_geometric_transform_do_map (GstGeometricTransform * gt, guint8 * in_data,
-    guint8 * out_data, gint x, gint y, gdouble in_x, gdouble in_y)
+gst_geometric_transform_sample_rows_16 (GstGeometricTransform * gt,
+    const guint8 * in_data, guint8 * out_data, gint y_start, gint y_end,
+    gboolean big_endian)
 {
-  gint in_offset;
-  gint out_offset;
+  const gint32 *map = gt->map + (gsize) y_start * gt->width * 2;
+  const gint last_x = gt->width - 1;
+  const gint last_y = gt->height - 1;
+  const gboolean wrap = gt->off_edge_pixels == GST_GT_OFF_EDGES_PIXELS_WRAP;
+  const gint edge_x = wrap ? 0 : last_x;
+  const gint edge_y = wrap ? 0 : last_y;
+  const gint rstride = gt->row_stride;
+  gint x, y;
 
-  out_offset = y * gt->row_stride + x * gt->pixel_stride;
+#define READ_PIXEL(p) (big_endian ? GST_READ_UINT16_BE (p) : \
+    GST_READ_UINT16_LE (p))
 
-  /* operate on out of edge pixels */
-  switch (gt->off_edge_pixels) {
-    case GST_GT_OFF_EDGES_PIXELS_CLAMP:
-      in_x = CLAMP (in_x, 0, gt->width - 1);
-      in_y = CLAMP (in_y, 0, gt->height - 1);
-      break;
+  for (y = y_start; y < y_end; y++) {
+    guint8 *out = out_data + (gsize) y * rstride;
 
-    case GST_GT_OFF_EDGES_PIXELS_WRAP:
-      in_x = gst_gm_mod_float (in_x, gt->width);
-      in_y = gst_gm_mod_float (in_y, gt->height);
-      if (in_x < 0)
-        in_x += gt->width;
-      if (in_y < 0)
-        in_y += gt->height;
-      break;
+    for (x = 0; x < gt->width; x++, map += 2, out += 2) {
+      gint x0, y0, x1, y1;
+      guint32 wx, wy, top, bottom, val;
+
+      if (G_UNLIKELY (map[0] == MAP_INVALID)) {
+        memcpy (out, gt->black, 2);
+        continue;
+      }
+
+      x0 = map[0] >> 16;
+      y0 = map[1] >> 16;
+      wx = (map[0] >> 8) & 0xff;
+      wy = (map[1] >> 8) & 0xff;
+      x1 = x0 < last_x ? x0 + 1 : edge_x;
+      y1 = y0 < last_y ? y0 + 1 : edge_y;
+
+      top = READ_PIXEL (in_data + y0 * rstride + x0 * 2) * (256 - wx) +
+          READ_PIXEL (in_data + y0 * rstride + x1 * 2) * wx;
+      bottom = READ_PIXEL (in_data + y1 * rstride + x0 * 2) * (256 - wx) +
+          READ_PIXEL (in_data + y1 * rstride + x1 * 2) * wx;
+      val = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+
+      if (big_endian)
+        GST_WRITE_UINT16_BE (out, val);
+      else
+        GST_WRITE_UINT16_LE (out, val);
+    }
+  }
+
+#undef READ_PIXEL
+}
 
+static void
+gst_geometric_transform_sample_rows (GstGeometricTransform * gt,
+    const guint8 * in_data, guint8 * out_data, gint y_start, gint y_end)
+{
+  switch (gt->pixel_stride) {
+    case 1:
+      gst_geometric_transform_sample_rows_8 (gt, in_data, out_data, y_start,
+          y_end, 1);
+      break;
+    case 2:
+      gst_geometric_transform_sample_rows_16 (gt, in_data, out_data, y_start,
+          y_end, gt->format == GST_VIDEO_FORMAT_GRAY16_BE);
+      break;
+    case 3:
+      gst_geometric_transform_sample_rows_8 (gt, in_data, out_data, y_start,
+          y_end, 3);
+      break;
+    case 4:
+      gst_geometric_transform_sample_rows_8 (gt, in_data, out_data, y_start,
+          y_end, 4);
+      break;
     default:
+      g_assert_not_reached ();
       break;
   }
+}
 
-  {
-    gint trunc_x = (gint) in_x;
-    gint trunc_y = (gint) in_y;
-    /* only set the values if the values are valid */
-    if (trunc_x >= 0 && trunc_x < gt->width && trunc_y >= 0 &&
-        trunc_y < gt->height) {
-      in_offset = trunc_y * gt->row_stride + trunc_x * gt->pixel_stride;
+static void
+gst_geometric_transform_band_func (gpointer data, gpointer user_data)
+{
+  GstGeometricTransform *gt = user_data;
+  GstGeometricTransformBand *band = data;
 
-      memcpy (out_data + out_offset, in_data + in_offset, gt->pixel_stride);
-    }
+  gst_geometric_transform_sample_rows (gt, band->in_data, band->out_data,
+      band->y_start, band->y_end);
+
+  g_mutex_lock (&gt->band_lock);
+  if (--gt->bands_pending == 0)
+    g_cond_signal (&gt->band_cond);
+  g_mutex_unlock (&gt->band_lock);
+}
+
+/* Splits the frame in row bands and samples all but the first one in the
+ * thread pool. Must be called with the object lock */
+static void
+gst_geometric_transform_do_map (GstGeometricTransform * gt,
+    const guint8 * in_data, guint8 * out_data)
+{
+  GstGeometricTransformBand *bands;
+  guint n_bands, i;
+
+  n_bands = gt->n_threads ? gt->n_threads : g_get_num_processors ();
+  n_bands = MIN (n_bands, gt->height);
+
+  if (n_bands <= 1) {
+    gst_geometric_transform_sample_rows (gt, in_data, out_data, 0,
+        gt->height);
+    return;
+  }
+
+  if (gt->pool == NULL) {
+    gt->pool = g_thread_pool_new (gst_geometric_transform_band_func, gt,
+        n_bands - 1, FALSE, NULL);
+  } else if (g_thread_pool_get_max_threads (gt->pool) != n_bands - 1) {
+    g_thread_pool_set_max_threads (gt->pool, n_bands - 1, NULL);
   }
+
+  bands = g_new (GstGeometricTransformBand, n_bands);
+  for (i = 0; i < n_bands; i++) {
+    bands[i].in_data = in_data;
+    bands[i].out_data = out_data;
+    bands[i].y_start = (gint) ((guint64) gt->height * i / n_bands);
+    bands[i].y_end = (gint) ((guint64) gt->height * (i + 1) / n_bands);
+  }
+
+  g_mutex_lock (&gt->band_lock);
+  gt->bands_pending = n_bands - 1;
+  g_mutex_unlock (&gt->band_lock);
+
+  for (i = 1; i < n_bands; i++)
+    g_thread_pool_push (gt->pool, &bands[i], NULL);
+
+  gst_geometric_transform_sample_rows (gt, in_data, out_data,
+      bands[0].y_start, bands[0].y_end);
+
+  g_mutex_lock (&gt->band_lock);
+  while (gt->bands_pending > 0)
+    g_cond_wait (&gt->band_cond, &gt->band_lock);
+  g_mutex_unlock (&gt->band_lock);
+
+  g_free (bands);
 }
 
 static void
@@ -229,64 +465,29 @@ gst_geometric_transform_transform_frame (GstVideoFilter * vfilter,
 {
   GstGeometricTransform *gt;
   GstGeometricTransformClass *klass;
-  gint x, y, i;
   GstFlowReturn ret = GST_FLOW_OK;
-  gdouble *ptr;
-  guint8 *in_data;
-  guint8 *out_data;
 
   gt = GST_GEOMETRIC_TRANSFORM_CAST (vfilter);
   klass = GST_GEOMETRIC_TRANSFORM_GET_CLASS (gt);
 
-  in_data = GST_VIDEO_FRAME_PLANE_DATA (in_frame, 0);
-  out_data = GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0);
-
-  if (GST_VIDEO_FRAME_FORMAT (out_frame) == GST_VIDEO_FORMAT_AYUV) {
-    /* in AYUV black is not just all zeros:
-     * 0x10 is black for Y,
-     * 0x80 is black for Cr and Cb */
-    for (i = 0; i < out_frame->map[0].size; i += 4)
-      GST_WRITE_UINT32_BE (out_data + i, 0xff108080);
-  } else {
-    memset (out_data, 0, out_frame->map[0].size);
-  }
-
   GST_OBJECT_LOCK (gt);
-  if (gt->precalc_map) {
-    if (gt->needs_remap) {
-      if (klass->prepare_func)
-        if (!klass->prepare_func (gt)) {
-          ret = FALSE;
-          goto end;
-        }
-      gst_geometric_transform_generate_map (gt);
-    }
-    g_return_val_if_fail (gt->map, GST_FLOW_ERROR);
-    ptr = gt->map;
-    for (y = 0; y < gt->height; y++) {
-      for (x = 0; x < gt->width; x++) {
-        /* do the mapping */
-        gst_geometric_transform_do_map (gt, in_data, out_data, x, y, ptr[0],
-            ptr[1]);
-        ptr += 2;
-      }
-    }
-  } else {
-    for (y = 0; y < gt->height; y++) {
-      for (x = 0; x < gt->width; x++) {
-        gdouble in_x, in_y;
-
-        if (klass->map_func (gt, x, y, &in_x, &in_y)) {
-          gst_geometric_transform_do_map (gt, in_data, out_data, x, y, in_x,
-              in_y);
-        } else {
-          GST_WARNING_OBJECT (gt, "Failed to do mapping for %d %d", x, y);
-          ret = GST_FLOW_ERROR;
-          goto end;
-        }
+  /* without a precalculated map, the mapping changes with every frame */
+  if (gt->needs_remap || !gt->precalc_map) {
+    if (gt->needs_remap && klass->prepare_func)
+      if (!klass->prepare_func (gt)) {
+        ret = GST_FLOW_ERROR;
+        goto end;
       }
+    if (!gst_geometric_transform_generate_map (gt)) {
+      ret = GST_FLOW_ERROR;
+      goto end;
     }
   }
+
+  /* every output pixel is written, off edge ones with black */
+  gst_geometric_transform_do_map (gt, GST_VIDEO_FRAME_PLANE_DATA (in_frame, 0),
+      GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0));
+
 end:
   GST_OBJECT_UNLOCK (gt);
   return ret;
@@ -304,6 +505,13 @@ gst_geometric_transform_set_property (GObject * object, guint prop_id,
     case PROP_OFF_EDGE_PIXELS:
       GST_OBJECT_LOCK (gt);
       gt->off_edge_pixels = g_value_get_enum (value);
+      /* the map has the method applied */
+      gst_geometric_transform_set_need_remap (gt);
+      GST_OBJECT_UNLOCK (gt);
+      break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (gt);
+      gt->n_threads = g_value_get_uint (value);
       GST_OBJECT_UNLOCK (gt);
       break;
     default:
@@ -324,12 +532,30 @@ gst_geometric_transform_get_property (GObject * object, guint prop_id,
     case PROP_OFF_EDGE_PIXELS:
       g_value_set_enum (value, gt->off_edge_pixels);
       break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (gt);
+      g_value_set_uint (value, gt->n_threads);
+      GST_OBJECT_UNLOCK (gt);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static void
+gst_geometric_transform_finalize (GObject * object)
+{
+  GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (object);
+
+  if (gt->pool)
+    g_thread_pool_free (gt->pool, FALSE, TRUE);
+  g_free (gt->map);
+  g_mutex_clear (&gt->band_lock);
+  g_cond_clear (&gt->band_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
 
 static gboolean
 gst_geometric_transform_stop (GstBaseTransform * trans)
@@ -373,6 +599,7 @@ gst_geometric_transform_class_init (gpointer klass, gpointer class_data)
 
   obj_class->set_property = gst_geometric_transform_set_property;
   obj_class->get_property = gst_geometric_transform_get_property;
+  obj_class->finalize = gst_geometric_transform_finalize;
 
   trans_class->stop = GST_DEBUG_FUNCPTR (gst_geometric_transform_stop);
   trans_class->before_transform =
@@ -389,6 +616,20 @@ gst_geometric_transform_class_init (gpointer klass, gpointer class_data)
           GST_GT_OFF_EDGES_PIXELS_METHOD_TYPE, DEFAULT_OFF_EDGE_PIXELS,
           GST_PARAM_CONTROLLABLE | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstGeometricTransform:n-threads:
+   *
+   * Number of threads the frames are split into row bands for, 0 uses one
+   * per processor.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (obj_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Threads",
+          "Maximum number of threads to use (0 = number of processors)",
+          0, G_MAXINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_type_mark_as_plugin_api (GST_GT_OFF_EDGES_PIXELS_METHOD_TYPE, 0);
   gst_type_mark_as_plugin_api (GST_TYPE_GEOMETRIC_TRANSFORM, 0);
 }
@@ -399,6 +640,9 @@ gst_geometric_transform_init (GTypeInstance * instance, gpointer g_class)
   GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (instance);
 
   gt->off_edge_pixels = DEFAULT_OFF_EDGE_PIXELS;
+  gt->n_threads = DEFAULT_N_THREADS;
+  g_mutex_init (&gt->band_lock);
+  g_cond_init (&gt->band_cond);
   gt->precalc_map = TRUE;
   gt->needs_remap = TRUE;
 }
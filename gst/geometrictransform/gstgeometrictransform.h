@@ -99,8 +99,20 @@ struct _GstGeometricTransform {
 
   /* properties */
   gint off_edge_pixels;
+  guint n_threads;
 
-  gdouble *map;
+  /* (x,y) pairs of the inverse mapping in 16.16 fixed point, with the off
+   * edge pixels method already applied */
+  gint32 *map;
+
+  /* what to put in pixels that map outside of the input */
+  guint8 black[4];
+
+  /* row bands are sampled in these threads */
+  GThreadPool *pool;
+  GMutex band_lock;
+  GCond band_cond;
+  gint bands_pending;
 };
 
 struct _GstGeometricTransformClass {
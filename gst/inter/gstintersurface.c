@@ -25,23 +25,24 @@
 
 #include "gstintersurface.h"
 
-static GList *list;
+/* name -> GstInterSurface, protected by mutex */
+static GHashTable *surfaces;
 static GMutex mutex;
 
 GstInterSurface *
 gst_inter_surface_get (const char *name)
 {
-  GList *g;
   GstInterSurface *surface;
 
   g_mutex_lock (&mutex);
-  for (g = list; g; g = g_list_next (g)) {
-    surface = g->data;
-    if (strcmp (name, surface->name) == 0) {
-      surface->ref_count++;
-      g_mutex_unlock (&mutex);
-      return surface;
-    }
+  if (!surfaces)
+    surfaces = g_hash_table_new (g_str_hash, g_str_equal);
+
+  surface = g_hash_table_lookup (surfaces, name);
+  if (surface) {
+    surface->ref_count++;
+    g_mutex_unlock (&mutex);
+    return surface;
   }
 
   surface = g_malloc0 (sizeof (GstInterSurface));
@@ -53,7 +54,14 @@ gst_inter_surface_get (const char *name)
   surface->audio_latency_time = DEFAULT_AUDIO_LATENCY_TIME;
   surface->audio_period_time = DEFAULT_AUDIO_PERIOD_TIME;
 
-  list = g_list_append (list, surface);
+  g_mutex_init (&surface->video_writer_lock);
+  g_cond_init (&surface->video_cond);
+  surface->video_ring_size = DEFAULT_VIDEO_RING_SIZE;
+  surface->video_first_seq = 1;
+  surface->video_retired = g_array_new (FALSE, FALSE,
+      sizeof (GstInterVideoSlot));
+
+  g_hash_table_insert (surfaces, surface->name, surface);
   g_mutex_unlock (&mutex);
 
   return surface;
@@ -64,21 +72,23 @@ gst_inter_surface_unref (GstInterSurface * surface)
 {
   /* Mutex needed here, otherwise refcount might become 0
    * and someone else requests the same surface again before
-   * we remove it from the list */
+   * we remove it from the table */
   g_mutex_lock (&mutex);
   if ((--surface->ref_count) == 0) {
-    GList *g;
+    guint i;
 
-    for (g = list; g; g = g_list_next (g)) {
-      GstInterSurface *tmp = g->data;
-      if (strcmp (tmp->name, surface->name) == 0) {
-        list = g_list_delete_link (list, g);
-        break;
-      }
-    }
+    g_hash_table_remove (surfaces, surface->name);
+
+    for (i = 0; i < G_N_ELEMENTS (surface->video_slots); i++)
+      gst_buffer_replace (&surface->video_slots[i].buffer, NULL);
+    for (i = 0; i < surface->video_retired->len; i++)
+      gst_buffer_unref (g_array_index (surface->video_retired,
+              GstInterVideoSlot, i).buffer);
+    g_array_free (surface->video_retired, TRUE);
+    g_cond_clear (&surface->video_cond);
+    g_mutex_clear (&surface->video_writer_lock);
 
     g_mutex_clear (&surface->mutex);
-    gst_buffer_replace (&surface->video_buffer, NULL);
     gst_buffer_replace (&surface->sub_buffer, NULL);
     gst_object_unref (surface->audio_adapter);
     g_free (surface->name);
@@ -86,3 +96,330 @@ gst_inter_surface_unref (GstInterSurface * surface)
   }
   g_mutex_unlock (&mutex);
 }
+
+static void
+gst_inter_surface_video_wake (GstInterSurface * surface)
+{
+  g_mutex_lock (&surface->mutex);
+  g_cond_broadcast (&surface->video_cond);
+  g_mutex_unlock (&surface->mutex);
+}
+
+/* Unrefs the retired buffers that no reader is referencing anymore */
+static void
+gst_inter_surface_video_sweep (GstInterSurface * surface)
+{
+  gpointer hazards[GST_INTER_SURFACE_MAX_READERS];
+  guint i, j;
+
+  for (i = 0; i < GST_INTER_SURFACE_MAX_READERS; i++)
+    hazards[i] = g_atomic_pointer_get (&surface->video_readers[i].hazard);
+
+  for (i = 0; i < surface->video_retired->len;) {
+    GstInterVideoSlot *retired =
+        &g_array_index (surface->video_retired, GstInterVideoSlot, i);
+
+    for (j = 0; j < GST_INTER_SURFACE_MAX_READERS; j++) {
+      if (hazards[j] == retired->buffer)
+        break;
+    }
+
+    if (j < GST_INTER_SURFACE_MAX_READERS) {
+      i++;
+    } else {
+      gst_buffer_unref (retired->buffer);
+      g_array_remove_index_fast (surface->video_retired, i);
+    }
+  }
+}
+
+/* Empties @slot, the buffer it held is kept around until no reader
+ * references it anymore */
+static void
+gst_inter_surface_video_retire (GstInterSurface * surface,
+    GstInterVideoSlot * slot, GstBuffer * replacement, guint seq)
+{
+  GstInterVideoSlot retired;
+
+  retired.seq = g_atomic_int_get (&slot->seq);
+  retired.buffer = g_atomic_pointer_get (&slot->buffer);
+
+  /* Invalidate the slot first, readers check the sequence number again
+   * after publishing the buffer as their hazard */
+  g_atomic_int_set (&slot->seq, 0);
+  g_atomic_pointer_set (&slot->buffer, replacement);
+  if (replacement)
+    g_atomic_int_set (&slot->seq, seq);
+
+  if (retired.buffer)
+    g_array_append_val (surface->video_retired, retired);
+}
+
+/* Whether a reader with the block policy didn't read frame @seq yet. Racy
+ * without the mutex, but then readers can only get unblocked */
+static gboolean
+gst_inter_surface_video_is_blocked (GstInterSurface * surface, guint seq)
+{
+  guint i;
+
+  for (i = 0; i < GST_INTER_SURFACE_MAX_READERS; i++) {
+    GstInterVideoReader *reader = &surface->video_readers[i];
+
+    if (reader->active && !reader->flushing &&
+        reader->policy == GST_INTER_VIDEO_POLICY_BLOCK &&
+        (gint) (g_atomic_int_get (&reader->read_seq) - seq) <= 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/**
+ * gst_inter_surface_video_reset:
+ * @ring_size: new number of frames kept, or 0 to keep the current one
+ *
+ * Drops all published frames, readers start over with the next frame.
+ * Only to be called by the sink.
+ */
+void
+gst_inter_surface_video_reset (GstInterSurface * surface, guint ring_size)
+{
+  guint i;
+
+  g_mutex_lock (&surface->video_writer_lock);
+  g_atomic_int_set (&surface->video_first_seq,
+      g_atomic_int_get (&surface->video_write_seq) + 1);
+
+  for (i = 0; i < G_N_ELEMENTS (surface->video_slots); i++)
+    gst_inter_surface_video_retire (surface, &surface->video_slots[i], NULL,
+        0);
+  gst_inter_surface_video_sweep (surface);
+
+  if (ring_size > 0)
+    g_atomic_int_set (&surface->video_ring_size,
+        CLAMP (ring_size, 1, GST_INTER_VIDEO_RING_MAX_SIZE));
+  g_mutex_unlock (&surface->video_writer_lock);
+
+  gst_inter_surface_video_wake (surface);
+}
+
+/**
+ * gst_inter_surface_video_publish:
+ *
+ * Adds @buffer to the ring, replacing the oldest frame. Waits for readers
+ * with the block policy that didn't read the oldest frame yet.
+ *
+ * Returns: %FALSE if interrupted by gst_inter_surface_video_set_writer_flushing()
+ */
+gboolean
+gst_inter_surface_video_publish (GstInterSurface * surface, GstBuffer * buffer)
+{
+  GstInterVideoSlot *slot;
+  guint seq, size, old_seq;
+
+  g_mutex_lock (&surface->video_writer_lock);
+  seq = g_atomic_int_get (&surface->video_write_seq) + 1;
+  size = g_atomic_int_get (&surface->video_ring_size);
+  slot = &surface->video_slots[seq % size];
+  old_seq = g_atomic_int_get (&slot->seq);
+
+  if (old_seq != 0 && gst_inter_surface_video_is_blocked (surface, old_seq)) {
+    gboolean flushing;
+
+    g_mutex_lock (&surface->mutex);
+    g_atomic_int_set (&surface->video_writer_waiting, 1);
+    while (!surface->video_writer_flushing &&
+        gst_inter_surface_video_is_blocked (surface, old_seq))
+      g_cond_wait (&surface->video_cond, &surface->mutex);
+    g_atomic_int_set (&surface->video_writer_waiting, 0);
+    flushing = surface->video_writer_flushing;
+    g_mutex_unlock (&surface->mutex);
+
+    if (flushing) {
+      g_mutex_unlock (&surface->video_writer_lock);
+      return FALSE;
+    }
+  }
+
+  gst_inter_surface_video_retire (surface, slot, gst_buffer_ref (buffer), seq);
+  g_atomic_int_set (&surface->video_write_seq, seq);
+  gst_inter_surface_video_sweep (surface);
+  g_mutex_unlock (&surface->video_writer_lock);
+
+  if (g_atomic_int_get (&surface->video_readers_waiting) > 0)
+    gst_inter_surface_video_wake (surface);
+
+  return TRUE;
+}
+
+void
+gst_inter_surface_video_set_writer_flushing (GstInterSurface * surface,
+    gboolean flushing)
+{
+  g_mutex_lock (&surface->mutex);
+  surface->video_writer_flushing = flushing;
+  g_cond_broadcast (&surface->video_cond);
+  g_mutex_unlock (&surface->mutex);
+}
+
+/**
+ * gst_inter_surface_video_add_reader:
+ *
+ * Returns: the reader id, or -1 if there are too many readers
+ */
+gint
+gst_inter_surface_video_add_reader (GstInterSurface * surface,
+    GstInterVideoPolicy policy)
+{
+  gint i;
+
+  g_mutex_lock (&surface->mutex);
+  for (i = 0; i < GST_INTER_SURFACE_MAX_READERS; i++) {
+    GstInterVideoReader *reader = &surface->video_readers[i];
+
+    if (reader->active)
+      continue;
+
+    reader->active = TRUE;
+    reader->policy = policy;
+    reader->flushing = FALSE;
+    reader->first_seq = g_atomic_int_get (&surface->video_first_seq);
+    g_atomic_pointer_set (&reader->hazard, NULL);
+    g_atomic_int_set (&reader->read_seq,
+        g_atomic_int_get (&surface->video_write_seq));
+    break;
+  }
+  g_mutex_unlock (&surface->mutex);
+
+  return i < GST_INTER_SURFACE_MAX_READERS ? i : -1;
+}
+
+void
+gst_inter_surface_video_remove_reader (GstInterSurface * surface, gint reader)
+{
+  g_mutex_lock (&surface->mutex);
+  surface->video_readers[reader].active = FALSE;
+  g_cond_broadcast (&surface->video_cond);
+  g_mutex_unlock (&surface->mutex);
+}
+
+void
+gst_inter_surface_video_set_reader_flushing (GstInterSurface * surface,
+    gint reader, gboolean flushing)
+{
+  g_mutex_lock (&surface->mutex);
+  surface->video_readers[reader].flushing = flushing;
+  g_cond_broadcast (&surface->video_cond);
+  g_mutex_unlock (&surface->mutex);
+}
+
+/* Returns a reference to frame @seq, or %NULL if it's not in the ring */
+static GstBuffer *
+gst_inter_surface_video_ref_frame (GstInterSurface * surface,
+    GstInterVideoReader * reader, guint seq, guint size)
+{
+  GstInterVideoSlot *slot = &surface->video_slots[seq % size];
+  GstBuffer *buffer;
+
+  for (;;) {
+    buffer = g_atomic_pointer_get (&slot->buffer);
+    if (buffer == NULL)
+      break;
+
+    /* The sink doesn't unref the buffers that are set as hazard. It could
+     * have retired and swept this one before it saw the hazard, so only use
+     * it if the slot still holds it afterwards */
+    g_atomic_pointer_set (&reader->hazard, buffer);
+    if (g_atomic_pointer_get (&slot->buffer) == buffer)
+      break;
+  }
+
+  /* The slot is invalidated before it gets another buffer, so the buffer is
+   * the one of frame @seq if the slot still has its sequence number */
+  if (buffer && g_atomic_int_get (&slot->seq) == seq)
+    gst_buffer_ref (buffer);
+  else
+    buffer = NULL;
+  g_atomic_pointer_set (&reader->hazard, NULL);
+
+  return buffer;
+}
+
+/**
+ * gst_inter_surface_video_read:
+ * @end_time: monotonic time until which readers with the block policy
+ *     wait for a frame, or -1 to wait forever
+ * @buffer: (out): the next frame for the reader, or %NULL if there is none
+ * @reset: (out): set to %TRUE if the sink restarted or changed format
+ *
+ * Returns: %GST_FLOW_FLUSHING if interrupted by
+ *     gst_inter_surface_video_set_reader_flushing(), %GST_FLOW_OK otherwise
+ */
+GstFlowReturn
+gst_inter_surface_video_read (GstInterSurface * surface, gint id,
+    gint64 end_time, GstBuffer ** buffer, gboolean * reset)
+{
+  GstInterVideoReader *reader = &surface->video_readers[id];
+  gboolean timeout = FALSE;
+
+  *buffer = NULL;
+  *reset = FALSE;
+
+  for (;;) {
+    guint first_seq, write_seq, read_seq, size;
+    gboolean flushing;
+
+    first_seq = g_atomic_int_get (&surface->video_first_seq);
+    write_seq = g_atomic_int_get (&surface->video_write_seq);
+    size = g_atomic_int_get (&surface->video_ring_size);
+    read_seq = g_atomic_int_get (&reader->read_seq);
+
+    if (reader->first_seq != first_seq) {
+      reader->first_seq = first_seq;
+      *reset = TRUE;
+    }
+    if ((gint) (read_seq - first_seq) < 0)
+      read_seq = first_seq;
+
+    if ((gint) (write_seq - read_seq) >= 0) {
+      if (reader->policy == GST_INTER_VIDEO_POLICY_REPEAT)
+        read_seq = write_seq;
+      else if (write_seq - read_seq >= size)
+        read_seq = write_seq - size + 1;        /* overwritten, drop */
+
+      *buffer = gst_inter_surface_video_ref_frame (surface, reader, read_seq,
+          size);
+      if (*buffer == NULL)
+        continue;
+
+      g_atomic_int_set (&reader->read_seq, read_seq + 1);
+      if (reader->policy == GST_INTER_VIDEO_POLICY_BLOCK &&
+          g_atomic_int_get (&surface->video_writer_waiting))
+        gst_inter_surface_video_wake (surface);
+
+      return GST_FLOW_OK;
+    }
+
+    g_atomic_int_set (&reader->read_seq, read_seq);
+    if (reader->policy != GST_INTER_VIDEO_POLICY_BLOCK || timeout)
+      return GST_FLOW_OK;
+
+    g_mutex_lock (&surface->mutex);
+    g_atomic_int_inc (&surface->video_readers_waiting);
+    while (!reader->flushing && !timeout &&
+        g_atomic_int_get (&surface->video_write_seq) == write_seq &&
+        g_atomic_int_get (&surface->video_first_seq) == first_seq) {
+      if (end_time == -1)
+        g_cond_wait (&surface->video_cond, &surface->mutex);
+      else
+        timeout = !g_cond_wait_until (&surface->video_cond, &surface->mutex,
+            end_time);
+    }
+    g_atomic_int_add (&surface->video_readers_waiting, -1);
+    flushing = reader->flushing;
+    g_mutex_unlock (&surface->mutex);
+
+    if (flushing)
+      return GST_FLOW_FLUSHING;
+  }
+}
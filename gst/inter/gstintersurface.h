@@ -28,6 +28,34 @@ G_BEGIN_DECLS
 
 typedef struct _GstInterSurface GstInterSurface;
 
+#define GST_INTER_SURFACE_MAX_READERS 32
+#define GST_INTER_VIDEO_RING_MAX_SIZE 64
+#define DEFAULT_VIDEO_RING_SIZE 4
+
+typedef enum
+{
+  GST_INTER_VIDEO_POLICY_REPEAT,
+  GST_INTER_VIDEO_POLICY_DROP,
+  GST_INTER_VIDEO_POLICY_BLOCK
+} GstInterVideoPolicy;
+
+typedef struct
+{
+  guint seq;                    /* atomic, 0 if the slot is empty */
+  GstBuffer *buffer;            /* atomic */
+} GstInterVideoSlot;
+
+typedef struct
+{
+  gboolean active;
+  GstInterVideoPolicy policy;
+  gboolean flushing;
+
+  gpointer hazard;              /* atomic, buffer being referenced */
+  guint read_seq;               /* atomic, next frame to read */
+  guint first_seq;              /* stream the reader is in */
+} GstInterVideoReader;
+
 struct _GstInterSurface
 {
   GMutex mutex;
@@ -37,7 +65,23 @@ struct _GstInterSurface
 
   /* video */
   GstVideoInfo video_info;
-  int video_buffer_count;
+
+  /* Frames published by the intervideosink. Publishing doesn't take
+   * @mutex, readers publish the buffer they reference as their hazard
+   * and the sink only unrefs buffers that no reader is referencing. @mutex
+   * and @video_cond are only used to wait for frames or free slots,
+   * @video_writer_lock serializes sinks sharing the channel. */
+  GstInterVideoSlot video_slots[GST_INTER_VIDEO_RING_MAX_SIZE];
+  guint video_ring_size;        /* atomic */
+  guint video_write_seq;        /* atomic, last published frame */
+  guint video_first_seq;        /* atomic, first frame of the stream */
+  GMutex video_writer_lock;
+  GArray *video_retired;        /* GstInterVideoSlot, writer lock */
+  gboolean video_writer_flushing;
+  gint video_writer_waiting;
+  gint video_readers_waiting;
+  GCond video_cond;
+  GstInterVideoReader video_readers[GST_INTER_SURFACE_MAX_READERS];
 
   /* audio */
   GstAudioInfo audio_info;
@@ -45,7 +89,6 @@ struct _GstInterSurface
   guint64 audio_latency_time;
   guint64 audio_period_time;
 
-  GstBuffer *video_buffer;
   GstBuffer *sub_buffer;
   GstAdapter *audio_adapter;
 };
@@ -58,6 +101,16 @@ struct _GstInterSurface
 GstInterSurface * gst_inter_surface_get (const char *name);
 void gst_inter_surface_unref (GstInterSurface *surface);
 
+void gst_inter_surface_video_reset (GstInterSurface *surface, guint ring_size);
+gboolean gst_inter_surface_video_publish (GstInterSurface *surface, GstBuffer *buffer);
+void gst_inter_surface_video_set_writer_flushing (GstInterSurface *surface, gboolean flushing);
+
+gint gst_inter_surface_video_add_reader (GstInterSurface *surface, GstInterVideoPolicy policy);
+void gst_inter_surface_video_remove_reader (GstInterSurface *surface, gint reader);
+void gst_inter_surface_video_set_reader_flushing (GstInterSurface *surface, gint reader, gboolean flushing);
+GstFlowReturn gst_inter_surface_video_read (GstInterSurface *surface, gint reader,
+    gint64 end_time, GstBuffer **buffer, gboolean *reset);
+
 
 G_END_DECLS
 
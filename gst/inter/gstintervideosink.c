@@ -58,6 +58,8 @@ static void gst_inter_video_sink_get_times (GstBaseSink * sink,
     GstBuffer * buffer, GstClockTime * start, GstClockTime * end);
 static gboolean gst_inter_video_sink_start (GstBaseSink * sink);
 static gboolean gst_inter_video_sink_stop (GstBaseSink * sink);
+static gboolean gst_inter_video_sink_unlock (GstBaseSink * sink);
+static gboolean gst_inter_video_sink_unlock_stop (GstBaseSink * sink);
 static gboolean gst_inter_video_sink_set_caps (GstBaseSink * sink,
     GstCaps * caps);
 static GstFlowReturn gst_inter_video_sink_show_frame (GstVideoSink * sink,
@@ -66,10 +68,12 @@ static GstFlowReturn gst_inter_video_sink_show_frame (GstVideoSink * sink,
 enum
 {
   PROP_0,
-  PROP_CHANNEL
+  PROP_CHANNEL,
+  PROP_RING_SIZE
 };
 
 #define DEFAULT_CHANNEL ("default")
+#define DEFAULT_RING_SIZE DEFAULT_VIDEO_RING_SIZE
 
 /* pad templates */
 static GstStaticPadTemplate gst_inter_video_sink_sink_template =
@@ -112,6 +116,9 @@ gst_inter_video_sink_class_init (GstInterVideoSinkClass * klass)
       GST_DEBUG_FUNCPTR (gst_inter_video_sink_get_times);
   base_sink_class->start = GST_DEBUG_FUNCPTR (gst_inter_video_sink_start);
   base_sink_class->stop = GST_DEBUG_FUNCPTR (gst_inter_video_sink_stop);
+  base_sink_class->unlock = GST_DEBUG_FUNCPTR (gst_inter_video_sink_unlock);
+  base_sink_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_inter_video_sink_unlock_stop);
   base_sink_class->set_caps = GST_DEBUG_FUNCPTR (gst_inter_video_sink_set_caps);
   video_sink_class->show_frame =
       GST_DEBUG_FUNCPTR (gst_inter_video_sink_show_frame);
@@ -120,12 +127,28 @@ gst_inter_video_sink_class_init (GstInterVideoSinkClass * klass)
       g_param_spec_string ("channel", "Channel",
           "Channel name to match inter src and sink elements",
           DEFAULT_CHANNEL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstInterVideoSink:ring-size:
+   *
+   * Number of frames kept for intervideosrc elements that don't only
+   * want the latest one, see #GstInterVideoSrc:policy. Applied when the
+   * sink starts.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_RING_SIZE,
+      g_param_spec_uint ("ring-size", "Ring size",
+          "Number of frames kept for the readers",
+          1, GST_INTER_VIDEO_RING_MAX_SIZE, DEFAULT_RING_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 gst_inter_video_sink_init (GstInterVideoSink * intervideosink)
 {
   intervideosink->channel = g_strdup (DEFAULT_CHANNEL);
+  intervideosink->ring_size = DEFAULT_RING_SIZE;
 }
 
 void
@@ -139,6 +162,9 @@ gst_inter_video_sink_set_property (GObject * object, guint property_id,
       g_free (intervideosink->channel);
       intervideosink->channel = g_value_dup_string (value);
       break;
+    case PROP_RING_SIZE:
+      intervideosink->ring_size = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -155,6 +181,9 @@ gst_inter_video_sink_get_property (GObject * object, guint property_id,
     case PROP_CHANNEL:
       g_value_set_string (value, intervideosink->channel);
       break;
+    case PROP_RING_SIZE:
+      g_value_set_uint (value, intervideosink->ring_size);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -202,6 +231,8 @@ gst_inter_video_sink_start (GstBaseSink * sink)
   g_mutex_lock (&intervideosink->surface->mutex);
   memset (&intervideosink->surface->video_info, 0, sizeof (GstVideoInfo));
   g_mutex_unlock (&intervideosink->surface->mutex);
+  gst_inter_surface_video_reset (intervideosink->surface,
+      intervideosink->ring_size);
 
   return TRUE;
 }
@@ -211,11 +242,8 @@ gst_inter_video_sink_stop (GstBaseSink * sink)
 {
   GstInterVideoSink *intervideosink = GST_INTER_VIDEO_SINK (sink);
 
+  gst_inter_surface_video_reset (intervideosink->surface, 0);
   g_mutex_lock (&intervideosink->surface->mutex);
-  if (intervideosink->surface->video_buffer) {
-    gst_buffer_unref (intervideosink->surface->video_buffer);
-  }
-  intervideosink->surface->video_buffer = NULL;
   memset (&intervideosink->surface->video_info, 0, sizeof (GstVideoInfo));
   g_mutex_unlock (&intervideosink->surface->mutex);
 
@@ -225,11 +253,32 @@ gst_inter_video_sink_stop (GstBaseSink * sink)
   return TRUE;
 }
 
+static gboolean
+gst_inter_video_sink_unlock (GstBaseSink * sink)
+{
+  GstInterVideoSink *intervideosink = GST_INTER_VIDEO_SINK (sink);
+
+  gst_inter_surface_video_set_writer_flushing (intervideosink->surface, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+gst_inter_video_sink_unlock_stop (GstBaseSink * sink)
+{
+  GstInterVideoSink *intervideosink = GST_INTER_VIDEO_SINK (sink);
+
+  gst_inter_surface_video_set_writer_flushing (intervideosink->surface, FALSE);
+
+  return TRUE;
+}
+
 static gboolean
 gst_inter_video_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
 {
   GstInterVideoSink *intervideosink = GST_INTER_VIDEO_SINK (sink);
   GstVideoInfo info;
+  gboolean changed;
 
   if (!gst_video_info_from_caps (&info, caps)) {
     GST_ERROR_OBJECT (sink, "Failed to parse caps %" GST_PTR_FORMAT, caps);
@@ -237,10 +286,16 @@ gst_inter_video_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
   }
 
   g_mutex_lock (&intervideosink->surface->mutex);
+  changed = intervideosink->surface->video_info.finfo &&
+      !gst_video_info_is_equal (&intervideosink->surface->video_info, &info);
   intervideosink->surface->video_info = info;
   intervideosink->info = info;
   g_mutex_unlock (&intervideosink->surface->mutex);
 
+  /* Readers shouldn't get frames in the old format after renegotiating */
+  if (changed)
+    gst_inter_surface_video_reset (intervideosink->surface, 0);
+
   return TRUE;
 }
 
@@ -252,13 +307,8 @@ gst_inter_video_sink_show_frame (GstVideoSink * sink, GstBuffer * buffer)
   GST_DEBUG_OBJECT (intervideosink, "render ts %" GST_TIME_FORMAT,
       GST_TIME_ARGS (GST_BUFFER_PTS (buffer)));
 
-  g_mutex_lock (&intervideosink->surface->mutex);
-  if (intervideosink->surface->video_buffer) {
-    gst_buffer_unref (intervideosink->surface->video_buffer);
-  }
-  intervideosink->surface->video_buffer = gst_buffer_ref (buffer);
-  intervideosink->surface->video_buffer_count = 0;
-  g_mutex_unlock (&intervideosink->surface->mutex);
+  if (!gst_inter_surface_video_publish (intervideosink->surface, buffer))
+    return GST_FLOW_FLUSHING;
 
   return GST_FLOW_OK;
 }
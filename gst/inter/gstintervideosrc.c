@@ -32,6 +32,12 @@
  * The intersubsrc element cannot be used effectively with gst-launch-1.0,
  * as it requires a second pipeline in the application to send subtitles.
  *
+ * Any number of intervideosrc elements can read from the same channel,
+ * each following its own #GstInterVideoSrc:policy. By default the latest
+ * frame is output and repeated until a new one arrives. The other policies
+ * output all frames in order from the ring kept by the intervideosink,
+ * see #GstInterVideoSink:ring-size.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -60,6 +66,8 @@ static gboolean gst_inter_video_src_set_caps (GstBaseSrc * src, GstCaps * caps);
 static GstCaps *gst_inter_video_src_fixate (GstBaseSrc * src, GstCaps * caps);
 static gboolean gst_inter_video_src_start (GstBaseSrc * src);
 static gboolean gst_inter_video_src_stop (GstBaseSrc * src);
+static gboolean gst_inter_video_src_unlock (GstBaseSrc * src);
+static gboolean gst_inter_video_src_unlock_stop (GstBaseSrc * src);
 static void
 gst_inter_video_src_get_times (GstBaseSrc * src, GstBuffer * buffer,
     GstClockTime * start, GstClockTime * end);
@@ -71,11 +79,36 @@ enum
 {
   PROP_0,
   PROP_CHANNEL,
-  PROP_TIMEOUT
+  PROP_TIMEOUT,
+  PROP_POLICY
 };
 
 #define DEFAULT_CHANNEL ("default")
 #define DEFAULT_TIMEOUT (GST_SECOND)
+#define DEFAULT_POLICY GST_INTER_VIDEO_POLICY_REPEAT
+
+#define GST_TYPE_INTER_VIDEO_POLICY (gst_inter_video_policy_get_type ())
+static GType
+gst_inter_video_policy_get_type (void)
+{
+  static GType policy_type = 0;
+  static const GEnumValue policies[] = {
+    {GST_INTER_VIDEO_POLICY_REPEAT,
+        "Output the latest frame, repeat it until a new one arrives", "repeat"},
+    {GST_INTER_VIDEO_POLICY_DROP,
+          "Output frames in order, drop the ones overwritten before being read",
+        "drop"},
+    {GST_INTER_VIDEO_POLICY_BLOCK,
+          "Output all frames in order, make the sink wait for this reader",
+        "block"},
+    {0, NULL, NULL},
+  };
+
+  if (!policy_type) {
+    policy_type = g_enum_register_static ("GstInterVideoPolicy", policies);
+  }
+  return policy_type;
+}
 
 /* pad templates */
 static GstStaticPadTemplate gst_inter_video_src_src_template =
@@ -119,6 +152,9 @@ gst_inter_video_src_class_init (GstInterVideoSrcClass * klass)
   base_src_class->fixate = GST_DEBUG_FUNCPTR (gst_inter_video_src_fixate);
   base_src_class->start = GST_DEBUG_FUNCPTR (gst_inter_video_src_start);
   base_src_class->stop = GST_DEBUG_FUNCPTR (gst_inter_video_src_stop);
+  base_src_class->unlock = GST_DEBUG_FUNCPTR (gst_inter_video_src_unlock);
+  base_src_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_inter_video_src_unlock_stop);
   base_src_class->get_times = GST_DEBUG_FUNCPTR (gst_inter_video_src_get_times);
   base_src_class->create = GST_DEBUG_FUNCPTR (gst_inter_video_src_create);
 
@@ -132,6 +168,23 @@ gst_inter_video_src_class_init (GstInterVideoSrcClass * klass)
           "Timeout after which to start outputting black frames",
           0, G_MAXUINT64, DEFAULT_TIMEOUT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstInterVideoSrc:policy:
+   *
+   * How frames are read from the channel. With the block policy, the
+   * element waits up to #GstInterVideoSrc:timeout for the next frame
+   * before outputting black frames, forever if it is %GST_CLOCK_TIME_NONE.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_POLICY,
+      g_param_spec_enum ("policy", "Policy",
+          "How frames are read from the channel",
+          GST_TYPE_INTER_VIDEO_POLICY, DEFAULT_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_type_mark_as_plugin_api (GST_TYPE_INTER_VIDEO_POLICY, 0);
 }
 
 static void
@@ -142,6 +195,7 @@ gst_inter_video_src_init (GstInterVideoSrc * intervideosrc)
 
   intervideosrc->channel = g_strdup (DEFAULT_CHANNEL);
   intervideosrc->timeout = DEFAULT_TIMEOUT;
+  intervideosrc->policy = DEFAULT_POLICY;
 }
 
 void
@@ -158,6 +212,9 @@ gst_inter_video_src_set_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       intervideosrc->timeout = g_value_get_uint64 (value);
       break;
+    case PROP_POLICY:
+      intervideosrc->policy = g_value_get_enum (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -177,6 +234,9 @@ gst_inter_video_src_get_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       g_value_set_uint64 (value, intervideosrc->timeout);
       break;
+    case PROP_POLICY:
+      g_value_set_enum (value, intervideosrc->policy);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -276,8 +336,20 @@ gst_inter_video_src_start (GstBaseSrc * src)
   GST_DEBUG_OBJECT (intervideosrc, "start");
 
   intervideosrc->surface = gst_inter_surface_get (intervideosrc->channel);
+  intervideosrc->reader =
+      gst_inter_surface_video_add_reader (intervideosrc->surface,
+      intervideosrc->policy);
+  if (intervideosrc->reader < 0) {
+    GST_ELEMENT_ERROR (intervideosrc, RESOURCE, BUSY, (NULL),
+        ("Too many readers on channel %s", intervideosrc->channel));
+    gst_inter_surface_unref (intervideosrc->surface);
+    intervideosrc->surface = NULL;
+    return FALSE;
+  }
+
   intervideosrc->timestamp_offset = 0;
   intervideosrc->n_frames = 0;
+  intervideosrc->video_buffer_count = 0;
 
   return TRUE;
 }
@@ -289,9 +361,34 @@ gst_inter_video_src_stop (GstBaseSrc * src)
 
   GST_DEBUG_OBJECT (intervideosrc, "stop");
 
+  gst_inter_surface_video_remove_reader (intervideosrc->surface,
+      intervideosrc->reader);
   gst_inter_surface_unref (intervideosrc->surface);
   intervideosrc->surface = NULL;
   gst_buffer_replace (&intervideosrc->black_frame, NULL);
+  gst_buffer_replace (&intervideosrc->video_buffer, NULL);
+
+  return TRUE;
+}
+
+static gboolean
+gst_inter_video_src_unlock (GstBaseSrc * src)
+{
+  GstInterVideoSrc *intervideosrc = GST_INTER_VIDEO_SRC (src);
+
+  gst_inter_surface_video_set_reader_flushing (intervideosrc->surface,
+      intervideosrc->reader, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+gst_inter_video_src_unlock_stop (GstBaseSrc * src)
+{
+  GstInterVideoSrc *intervideosrc = GST_INTER_VIDEO_SRC (src);
+
+  gst_inter_surface_video_set_reader_flushing (intervideosrc->surface,
+      intervideosrc->reader, FALSE);
 
   return TRUE;
 }
@@ -328,8 +425,11 @@ gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
   GstInterVideoSrc *intervideosrc = GST_INTER_VIDEO_SRC (src);
   GstCaps *caps;
   GstBuffer *buffer;
+  GstFlowReturn flow;
   guint64 frames;
+  gint64 end_time = -1;
   gboolean is_gap = FALSE;
+  gboolean reset;
 
   GST_DEBUG_OBJECT (intervideosrc, "create");
 
@@ -340,6 +440,28 @@ gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
       GST_VIDEO_INFO_FPS_N (&intervideosrc->info),
       GST_VIDEO_INFO_FPS_D (&intervideosrc->info) * GST_SECOND);
 
+  if (GST_CLOCK_TIME_IS_VALID (intervideosrc->timeout))
+    end_time = g_get_monotonic_time () +
+        intervideosrc->timeout / GST_USECOND;
+
+  flow = gst_inter_surface_video_read (intervideosrc->surface,
+      intervideosrc->reader, end_time, &buffer, &reset);
+  if (flow != GST_FLOW_OK)
+    return flow;
+
+  if (reset)
+    gst_buffer_replace (&intervideosrc->video_buffer, NULL);
+
+  if (buffer) {
+    gst_buffer_replace (&intervideosrc->video_buffer, buffer);
+    gst_buffer_unref (buffer);
+    buffer = NULL;
+    intervideosrc->video_buffer_count = 0;
+  } else if (intervideosrc->policy == GST_INTER_VIDEO_POLICY_BLOCK) {
+    /* Waited for the whole timeout already */
+    gst_buffer_replace (&intervideosrc->video_buffer, NULL);
+  }
+
   g_mutex_lock (&intervideosrc->surface->mutex);
   if (intervideosrc->surface->video_info.finfo) {
     GstVideoInfo tmp_info = intervideosrc->surface->video_info;
@@ -362,25 +484,24 @@ gst_inter_video_src_create (GstBaseSrc * src, guint64 offset, guint size,
     }
   }
 
-  if (intervideosrc->surface->video_buffer) {
+  g_mutex_unlock (&intervideosrc->surface->mutex);
+
+  if (intervideosrc->video_buffer) {
     /* We have a buffer to push */
-    buffer = gst_buffer_ref (intervideosrc->surface->video_buffer);
+    buffer = gst_buffer_ref (intervideosrc->video_buffer);
 
     /* Can only be true if timeout > 0 */
-    if (intervideosrc->surface->video_buffer_count == frames) {
-      gst_buffer_unref (intervideosrc->surface->video_buffer);
-      intervideosrc->surface->video_buffer = NULL;
-    }
+    if (intervideosrc->video_buffer_count == frames)
+      gst_buffer_replace (&intervideosrc->video_buffer, NULL);
   }
 
-  if (intervideosrc->surface->video_buffer_count != 0 &&
-      intervideosrc->surface->video_buffer_count != (frames + 1)) {
+  if (intervideosrc->video_buffer_count != 0 &&
+      intervideosrc->video_buffer_count != (frames + 1)) {
     /* This is a repeat of the stored buffer or of a black frame */
     is_gap = TRUE;
   }
 
-  intervideosrc->surface->video_buffer_count++;
-  g_mutex_unlock (&intervideosrc->surface->mutex);
+  intervideosrc->video_buffer_count++;
 
   if (caps) {
     gboolean ret;
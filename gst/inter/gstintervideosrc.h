@@ -43,6 +43,12 @@ struct _GstInterVideoSrc
 
   char *channel;
   guint64 timeout;
+  GstInterVideoPolicy policy;
+
+  /* ring reader id, last frame read and how often it was output */
+  gint reader;
+  GstBuffer *video_buffer;
+  guint64 video_buffer_count;
 
   GstVideoInfo info;
   GstBuffer *black_frame;
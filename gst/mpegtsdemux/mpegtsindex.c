@@ -0,0 +1,262 @@
+/*
+ * mpegtsindex.c : Keyframe index for MPEG-TS seeking
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "mpegtsindex.h"
+
+GST_DEBUG_CATEGORY_STATIC (mpegts_index_debug);
+#define GST_CAT_DEFAULT mpegts_index_debug
+
+/* First line of the sidecar files */
+#define INDEX_FILE_HEADER "MPEGTSINDEX 1"
+
+typedef struct
+{
+  GstClockTime ts;
+  guint64 offset;
+  /* All data up to the next entry was scanned */
+  gboolean complete;
+} MpegTSIndexEntry;
+
+#define INDEX_ENTRY(index, i) \
+  (&g_array_index ((index)->entries, MpegTSIndexEntry, (i)))
+
+void
+mpegts_index_init (MpegTSIndex * index)
+{
+  index->entries = g_array_new (FALSE, FALSE, sizeof (MpegTSIndexEntry));
+  index->last_added = -1;
+  index->dirty = FALSE;
+}
+
+void
+mpegts_index_clear (MpegTSIndex * index)
+{
+  if (index->entries)
+    g_array_set_size (index->entries, 0);
+  index->last_added = -1;
+  index->dirty = FALSE;
+}
+
+/* Returns the position of the first entry with a timestamp above @ts */
+static guint
+mpegts_index_find (MpegTSIndex * index, GstClockTime ts)
+{
+  guint lo = 0, hi = index->entries->len;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (INDEX_ENTRY (index, mid)->ts <= ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+void
+mpegts_index_add (MpegTSIndex * index, GstClockTime ts, guint64 offset)
+{
+  guint pos, len = index->entries->len;
+  gint idx;
+
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (ts));
+
+  pos = mpegts_index_find (index, ts);
+
+  if (pos > 0 && INDEX_ENTRY (index, pos - 1)->ts == ts) {
+    idx = pos - 1;
+  } else {
+    MpegTSIndexEntry entry = { ts, offset, FALSE };
+
+    /* Timestamps and offsets must grow together, anything else means the
+     * timeline doesn't match the one the index was built with */
+    if ((pos > 0 && INDEX_ENTRY (index, pos - 1)->offset >= offset) ||
+        (pos < len && INDEX_ENTRY (index, pos)->offset <= offset)) {
+      GST_DEBUG ("Ignoring out of order keyframe %" GST_TIME_FORMAT
+          " at offset %" G_GUINT64_FORMAT, GST_TIME_ARGS (ts), offset);
+      index->last_added = -1;
+      return;
+    }
+
+    g_array_insert_val (index->entries, pos, entry);
+    if (index->last_added >= (gint) pos)
+      index->last_added++;
+    index->dirty = TRUE;
+    idx = pos;
+
+    GST_LOG ("Added keyframe %" GST_TIME_FORMAT " at offset %"
+        G_GUINT64_FORMAT " (%u entries)", GST_TIME_ARGS (ts), offset,
+        index->entries->len);
+  }
+
+  /* We went from the previous keyframe to this one without a jump, so no
+   * keyframe can be missing in between */
+  if (index->last_added >= 0 && index->last_added == idx - 1) {
+    MpegTSIndexEntry *prev = INDEX_ENTRY (index, idx - 1);
+
+    if (!prev->complete) {
+      prev->complete = TRUE;
+      index->dirty = TRUE;
+    }
+  }
+
+  index->last_added = idx;
+}
+
+void
+mpegts_index_discont (MpegTSIndex * index)
+{
+  index->last_added = -1;
+}
+
+/**
+ * mpegts_index_lookup:
+ * @index: a #MpegTSIndex
+ * @ts: target timestamp
+ * @entry_ts: (out): timestamp of the keyframe
+ * @offset: (out): offset of the keyframe
+ *
+ * Looks for the last keyframe at or before @ts. Only succeeds if the
+ * index is known to be complete around @ts.
+ *
+ * Returns: %TRUE if a keyframe was found.
+ */
+gboolean
+mpegts_index_lookup (MpegTSIndex * index, GstClockTime ts,
+    GstClockTime * entry_ts, guint64 * offset)
+{
+  MpegTSIndexEntry *entry;
+  guint pos;
+
+  pos = mpegts_index_find (index, ts);
+  if (pos == 0)
+    return FALSE;
+
+  entry = INDEX_ENTRY (index, pos - 1);
+  if (!entry->complete)
+    return FALSE;
+
+  *entry_ts = entry->ts;
+  *offset = entry->offset;
+
+  return TRUE;
+}
+
+gboolean
+mpegts_index_load (MpegTSIndex * index, const gchar * filename,
+    GError ** error)
+{
+  gchar *contents;
+  gchar **lines;
+  guint i;
+  gboolean ret = FALSE;
+
+  if (!g_file_get_contents (filename, &contents, NULL, error))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  if (lines[0] == NULL || strcmp (lines[0], INDEX_FILE_HEADER) != 0) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+        "%s is not a keyframe index", filename);
+    goto done;
+  }
+
+  mpegts_index_clear (index);
+
+  for (i = 1; lines[i]; i++) {
+    MpegTSIndexEntry entry;
+    gchar *end;
+
+    if (lines[i][0] == '\0')
+      continue;
+
+    entry.ts = g_ascii_strtoull (lines[i], &end, 10);
+    entry.offset = g_ascii_strtoull (end, &end, 10);
+    entry.complete = g_ascii_strtoull (end, &end, 10) != 0;
+
+    if (*end != '\0' || !GST_CLOCK_TIME_IS_VALID (entry.ts) ||
+        (index->entries->len > 0 &&
+            (INDEX_ENTRY (index, index->entries->len - 1)->ts >= entry.ts ||
+                INDEX_ENTRY (index,
+                    index->entries->len - 1)->offset >= entry.offset))) {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+          "Invalid entry on line %u of %s", i + 1, filename);
+      mpegts_index_clear (index);
+      goto done;
+    }
+
+    g_array_append_val (index->entries, entry);
+  }
+
+  /* The last entry has nothing after it to be complete with */
+  if (index->entries->len > 0)
+    INDEX_ENTRY (index, index->entries->len - 1)->complete = FALSE;
+
+  GST_DEBUG ("Loaded %u entries from %s", index->entries->len, filename);
+  ret = TRUE;
+
+done:
+  g_strfreev (lines);
+  return ret;
+}
+
+gboolean
+mpegts_index_save (MpegTSIndex * index, const gchar * filename,
+    GError ** error)
+{
+  GString *str;
+  guint i;
+  gboolean ret;
+
+  str = g_string_sized_new (32 + index->entries->len * 32);
+  g_string_append (str, INDEX_FILE_HEADER "\n");
+
+  for (i = 0; i < index->entries->len; i++) {
+    MpegTSIndexEntry *entry = INDEX_ENTRY (index, i);
+
+    g_string_append_printf (str, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+        " %d\n", entry->ts, entry->offset, entry->complete ? 1 : 0);
+  }
+
+  ret = g_file_set_contents (filename, str->str, str->len, error);
+  if (ret) {
+    GST_DEBUG ("Saved %u entries to %s", index->entries->len, filename);
+    index->dirty = FALSE;
+  }
+
+  g_string_free (str, TRUE);
+  return ret;
+}
+
+void
+init_mpegts_index (void)
+{
+  GST_DEBUG_CATEGORY_INIT (mpegts_index_debug, "tsdemux-index", 0,
+      "MPEG-TS keyframe index");
+}
@@ -0,0 +1,67 @@
+/*
+ * mpegtsindex.h : Keyframe index for MPEG-TS seeking
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __MPEGTS_INDEX_H__
+#define __MPEGTS_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _MpegTSIndex MpegTSIndex;
+
+/*
+ * MpegTSIndex:
+ *
+ * Sorted list of (timestamp, byte offset) pairs, one per keyframe seen
+ * at the start of a PES. Timestamps are in the demuxer output timeline,
+ * offsets point at the TS packet carrying the PES header.
+ *
+ * An entry is only trusted for lookups if all the data up to the next
+ * entry was scanned, so that it is known to be the closest keyframe and
+ * not one left over from before a seek.
+ */
+struct _MpegTSIndex
+{
+  GArray *entries;              /* MpegTSIndexEntry */
+
+  /* Position of the last added entry, -1 after a discontinuity */
+  gint last_added;
+
+  /* TRUE if entries were added since the last load/save */
+  gboolean dirty;
+};
+
+void init_mpegts_index (void);
+
+void mpegts_index_init (MpegTSIndex * index);
+void mpegts_index_clear (MpegTSIndex * index);
+
+void mpegts_index_add (MpegTSIndex * index, GstClockTime ts, guint64 offset);
+void mpegts_index_discont (MpegTSIndex * index);
+gboolean mpegts_index_lookup (MpegTSIndex * index, GstClockTime ts,
+    GstClockTime * entry_ts, guint64 * offset);
+
+gboolean mpegts_index_load (MpegTSIndex * index, const gchar * filename,
+    GError ** error);
+gboolean mpegts_index_save (MpegTSIndex * index, const gchar * filename,
+    GError ** error);
+
+G_END_DECLS
+#endif /* __MPEGTS_INDEX_H__ */
@@ -49,6 +49,7 @@ G_DEFINE_TYPE_EXTENDED (MpegTSPacketizer2, mpegts_packetizer, G_TYPE_OBJECT, 0,
 #define PACKETIZER_GROUP_UNLOCK(p) g_mutex_unlock(&((p)->group_lock))
 
 static void mpegts_packetizer_dispose (GObject * object);
+static void mpegts_packetizer_unmap (MpegTSPacketizer2 * packetizer);
 static void mpegts_packetizer_finalize (GObject * object);
 static GstClockTime calculate_skew (MpegTSPacketizer2 * packetizer,
     MpegTSPCR * pcr, guint64 pcrtime, GstClockTime time);
@@ -260,6 +261,7 @@ mpegts_packetizer_init (MpegTSPacketizer2 * packetizer)
   packetizer->map_data = NULL;
   packetizer->map_size = 0;
   packetizer->map_offset = 0;
+  packetizer->map_buffer = NULL;
   packetizer->need_sync = FALSE;
 
   memset (packetizer->pcrtablelut, 0xff, 0x2000);
@@ -291,6 +293,7 @@ mpegts_packetizer_dispose (GObject * object)
       g_free (packetizer->streams);
     }
 
+    mpegts_packetizer_unmap (packetizer);
     gst_adapter_clear (packetizer->adapter);
     g_object_unref (packetizer->adapter);
     g_mutex_clear (&packetizer->group_lock);
@@ -584,13 +587,11 @@ mpegts_packetizer_clear (MpegTSPacketizer2 * packetizer)
     memset (packetizer->streams, 0, 8192 * sizeof (MpegTSPacketizerStream *));
   }
 
+  mpegts_packetizer_unmap (packetizer);
   gst_adapter_clear (packetizer->adapter);
   packetizer->offset = 0;
   packetizer->empty = TRUE;
   packetizer->need_sync = FALSE;
-  packetizer->map_data = NULL;
-  packetizer->map_size = 0;
-  packetizer->map_offset = 0;
   packetizer->last_in_time = GST_CLOCK_TIME_NONE;
   packetizer->last_pts = GST_CLOCK_TIME_NONE;
   packetizer->last_dts = GST_CLOCK_TIME_NONE;
@@ -625,14 +626,12 @@ mpegts_packetizer_flush (MpegTSPacketizer2 * packetizer, gboolean hard)
       }
     }
   }
+  mpegts_packetizer_unmap (packetizer);
   gst_adapter_clear (packetizer->adapter);
 
   packetizer->offset = 0;
   packetizer->empty = TRUE;
   packetizer->need_sync = FALSE;
-  packetizer->map_data = NULL;
-  packetizer->map_size = 0;
-  packetizer->map_offset = 0;
   packetizer->last_in_time = GST_CLOCK_TIME_NONE;
   packetizer->last_pts = GST_CLOCK_TIME_NONE;
   packetizer->last_dts = GST_CLOCK_TIME_NONE;
@@ -702,11 +701,12 @@ mpegts_packetizer_push (MpegTSPacketizer2 * packetizer, GstBuffer * buffer)
 }
 
 static void
-mpegts_packetizer_flush_bytes (MpegTSPacketizer2 * packetizer, gsize size)
+mpegts_packetizer_unmap (MpegTSPacketizer2 * packetizer)
 {
-  if (size > 0) {
-    GST_LOG ("flushing %" G_GSIZE_FORMAT " bytes from adapter", size);
-    gst_adapter_flush (packetizer->adapter, size);
+  if (packetizer->map_buffer) {
+    gst_buffer_unmap (packetizer->map_buffer, &packetizer->map_info);
+    gst_buffer_unref (packetizer->map_buffer);
+    packetizer->map_buffer = NULL;
   }
 
   packetizer->map_data = NULL;
@@ -714,6 +714,23 @@ mpegts_packetizer_flush_bytes (MpegTSPacketizer2 * packetizer, gsize size)
   packetizer->map_offset = 0;
 }
 
+static void
+mpegts_packetizer_flush_bytes (MpegTSPacketizer2 * packetizer, gsize size)
+{
+  mpegts_packetizer_unmap (packetizer);
+
+  if (size > 0) {
+    GST_LOG ("flushing %" G_GSIZE_FORMAT " bytes from adapter", size);
+    gst_adapter_flush (packetizer->adapter, size);
+  }
+}
+
+/* Makes at least @size bytes available at map_data + map_offset.
+ *
+ * This never merges the buffers queued in the adapter. The mapping covers
+ * the remainder of the first input buffer, so the packets handed out point
+ * straight into the upstream memory. Only when the requested range straddles
+ * two input buffers are @size bytes copied into the bounce slot. */
 static gboolean
 mpegts_packetizer_map (MpegTSPacketizer2 * packetizer, gsize size)
 {
@@ -728,24 +745,128 @@ mpegts_packetizer_map (MpegTSPacketizer2 * packetizer, gsize size)
   if (available < size)
     return FALSE;
 
-  packetizer->map_data =
-      (guint8 *) gst_adapter_map (packetizer->adapter, available);
-  if (!packetizer->map_data)
-    return FALSE;
+  available = gst_adapter_available_fast (packetizer->adapter);
+  if (available >= size) {
+    packetizer->map_buffer =
+        gst_adapter_get_buffer_fast (packetizer->adapter, available);
+    if (!packetizer->map_buffer)
+      return FALSE;
 
-  packetizer->map_size = available;
-  packetizer->map_offset = 0;
+    if (!gst_buffer_map (packetizer->map_buffer, &packetizer->map_info,
+            GST_MAP_READ)) {
+      gst_buffer_unref (packetizer->map_buffer);
+      packetizer->map_buffer = NULL;
+      return FALSE;
+    }
+
+    packetizer->map_data = packetizer->map_info.data;
+    packetizer->map_size = packetizer->map_info.size;
+
+    GST_LOG ("mapped %" G_GSIZE_FORMAT " bytes from adapter", available);
+  } else {
+    g_assert (size <= sizeof (packetizer->bounce));
 
-  GST_LOG ("mapped %" G_GSIZE_FORMAT " bytes from adapter", available);
+    gst_adapter_copy (packetizer->adapter, packetizer->bounce, 0, size);
+    packetizer->map_data = packetizer->bounce;
+    packetizer->map_size = size;
+
+    GST_LOG ("copied %" G_GSIZE_FORMAT " straddling bytes from adapter", size);
+  }
+
+  packetizer->map_offset = 0;
 
   return TRUE;
 }
 
+#define SYNC_BYTE_PATTERN G_GUINT64_CONSTANT (0x4747474747474747)
+#define LOW_7_BITS G_GUINT64_CONSTANT (0x7f7f7f7f7f7f7f7f)
+
+/* Returns a word with the high bit set in every byte of the 8 bytes at @data
+ * that is a sync byte, and all other bits cleared. Unlike the classic
+ * "has zero byte" trick this has no false positives, so the masks of several
+ * strides can be and'ed together */
+static inline guint64
+sync_byte_mask (const guint8 * data)
+{
+  guint64 v = GST_READ_UINT64_LE (data) ^ SYNC_BYTE_PATTERN;
+
+  return ~(((v & LOW_7_BITS) + LOW_7_BITS) | v | LOW_7_BITS);
+}
+
+/* Looks for the first offset in @data (starting from *@offset) holding
+ * @nb_sync sync bytes spaced by one of the @psizes packet sizes.
+ *
+ * 16 candidate offsets are tested per iteration against all packet sizes at
+ * once, 8 per 64-bit word. Only once a word contains a match is the exact
+ * offset (and packet size, in @psizes order of preference) picked byte-wise.
+ *
+ * Returns TRUE if found, with *@offset and *@packet_size set. Otherwise
+ * *@offset is set to the first offset that couldn't be checked for lack
+ * of data */
+static gboolean
+mpegts_packetizer_scan_sync (const guint8 * data, gsize size,
+    const guint * psizes, guint n_psizes, guint nb_sync, gsize * offset,
+    guint * packet_size)
+{
+  gsize i = *offset, limit, span;
+  guint j, k, max_size = 0;
+
+  for (j = 0; j < n_psizes; j++)
+    max_size = MAX (max_size, psizes[j]);
+
+  span = (nb_sync - 1) * max_size;
+  limit = size > span ? size - span : 0;
+
+  for (; i + 16 <= limit; i += 16) {
+    guint64 first0, first1, hits = 0;
+
+    first0 = sync_byte_mask (data + i);
+    first1 = sync_byte_mask (data + i + 8);
+    if (G_LIKELY ((first0 | first1) == 0))
+      continue;
+
+    for (j = 0; j < n_psizes && !hits; j++) {
+      guint64 m0 = first0, m1 = first1;
+
+      for (k = 1; k < nb_sync && (m0 | m1); k++) {
+        m0 &= sync_byte_mask (data + i + k * psizes[j]);
+        m1 &= sync_byte_mask (data + i + k * psizes[j] + 8);
+      }
+      hits = m0 | m1;
+    }
+
+    if (hits)
+      break;
+  }
+
+  for (; i < limit; i++) {
+    if (data[i] != PACKET_SYNC_BYTE)
+      continue;
+
+    for (j = 0; j < n_psizes; j++) {
+      for (k = 1; k < nb_sync; k++) {
+        if (data[i + k * psizes[j]] != PACKET_SYNC_BYTE)
+          break;
+      }
+      if (k == nb_sync) {
+        *offset = i;
+        *packet_size = psizes[j];
+        return TRUE;
+      }
+    }
+  }
+
+  *offset = MAX (i, *offset);
+
+  return FALSE;
+}
+
 static gboolean
 mpegts_try_discover_packet_size (MpegTSPacketizer2 * packetizer)
 {
   guint8 *data;
-  gsize size, i, j;
+  gsize size, i;
+  guint packet_size;
 
   static const guint psizes[] = {
     MPEGTS_NORMAL_PACKETSIZE,
@@ -754,40 +875,30 @@ mpegts_try_discover_packet_size (MpegTSPacketizer2 * packetizer)
     MPEGTS_ATSC_PACKETSIZE
   };
 
-  if (!mpegts_packetizer_map (packetizer, 4 * MPEGTS_MAX_PACKETSIZE))
-    return FALSE;
-
-  size = packetizer->map_size - packetizer->map_offset;
-  data = packetizer->map_data + packetizer->map_offset;
-
-  for (i = 0; i + 3 * MPEGTS_MAX_PACKETSIZE < size; i++) {
-    /* find a sync byte */
-    if (data[i] != PACKET_SYNC_BYTE)
-      continue;
+  /* The mapping only covers one input buffer at a time, keep scanning until
+   * we run out of data */
+  while (mpegts_packetizer_map (packetizer, 4 * MPEGTS_MAX_PACKETSIZE)) {
+    size = packetizer->map_size - packetizer->map_offset;
+    data = packetizer->map_data + packetizer->map_offset;
+    i = 0;
 
     /* check for 4 consecutive sync bytes with each possible packet size */
-    for (j = 0; j < G_N_ELEMENTS (psizes); j++) {
-      guint packet_size = psizes[j];
-
-      if (data[i + packet_size] == PACKET_SYNC_BYTE &&
-          data[i + 2 * packet_size] == PACKET_SYNC_BYTE &&
-          data[i + 3 * packet_size] == PACKET_SYNC_BYTE) {
-        packetizer->packet_size = packet_size;
-        goto out;
-      }
+    if (mpegts_packetizer_scan_sync (data, size, psizes,
+            G_N_ELEMENTS (psizes), 4, &i, &packet_size)) {
+      packetizer->packet_size = packet_size;
+      packetizer->map_offset += i;
+      goto out;
     }
-  }
-
-out:
-  packetizer->map_offset += i;
 
-  if (packetizer->packet_size == 0) {
     GST_DEBUG ("Could not determine packet size in %" G_GSIZE_FORMAT
         " bytes buffer, flush %" G_GSIZE_FORMAT " bytes", size, i);
+    packetizer->map_offset += i;
     mpegts_packetizer_flush_bytes (packetizer, packetizer->map_offset);
-    return FALSE;
   }
 
+  return FALSE;
+
+out:
   GST_INFO ("have packetsize detected: %u bytes", packetizer->packet_size);
 
   if (packetizer->packet_size == MPEGTS_M2TS_PACKETSIZE &&
@@ -800,39 +911,33 @@ out:
 static gboolean
 mpegts_packetizer_sync (MpegTSPacketizer2 * packetizer)
 {
-  gboolean found = FALSE;
   guint8 *data;
-  guint packet_size;
+  guint packet_size, found_size;
   gsize size, sync_offset, i;
 
   packet_size = packetizer->packet_size;
 
-  if (!mpegts_packetizer_map (packetizer, 3 * packet_size))
-    return FALSE;
-
-  size = packetizer->map_size - packetizer->map_offset;
-  data = packetizer->map_data + packetizer->map_offset;
-
   if (packet_size == MPEGTS_M2TS_PACKETSIZE)
     sync_offset = 4;
   else
     sync_offset = 0;
 
-  for (i = sync_offset; i + 2 * packet_size < size; i++) {
-    if (data[i] == PACKET_SYNC_BYTE &&
-        data[i + packet_size] == PACKET_SYNC_BYTE &&
-        data[i + 2 * packet_size] == PACKET_SYNC_BYTE) {
-      found = TRUE;
-      break;
-    }
-  }
+  while (mpegts_packetizer_map (packetizer, 3 * packet_size)) {
+    size = packetizer->map_size - packetizer->map_offset;
+    data = packetizer->map_data + packetizer->map_offset;
+    i = sync_offset;
 
-  packetizer->map_offset += i - sync_offset;
+    if (mpegts_packetizer_scan_sync (data, size, &packet_size, 1, 3, &i,
+            &found_size)) {
+      packetizer->map_offset += i - sync_offset;
+      return TRUE;
+    }
 
-  if (!found)
+    packetizer->map_offset += i - sync_offset;
     mpegts_packetizer_flush_bytes (packetizer, packetizer->map_offset);
+  }
 
-  return found;
+  return FALSE;
 }
 
 MpegTSPacketizerPacketReturn
@@ -905,7 +1010,7 @@ void
 mpegts_packetizer_clear_packet (MpegTSPacketizer2 * packetizer,
     MpegTSPacketizerPacket * packet)
 {
-  guint8 packet_size = packetizer->packet_size;
+  guint packet_size = packetizer->packet_size;
 
   if (packetizer->map_data) {
     packetizer->map_offset += packet_size;
@@ -924,6 +1029,31 @@ mpegts_packetizer_has_packets (MpegTSPacketizer2 * packetizer)
   return gst_adapter_available (packetizer->adapter) >= packetizer->packet_size;
 }
 
+/* Returns a buffer holding the 188 bytes of @packet. If the packet lies in
+ * the upstream memory (i.e. it didn't straddle two input buffers), the
+ * returned buffer shares that memory instead of copying it. */
+GstBuffer *
+mpegts_packetizer_get_packet_buffer (MpegTSPacketizer2 * packetizer,
+    MpegTSPacketizerPacket * packet)
+{
+  gsize size = packet->data_end - packet->data_start;
+  GstBuffer *buf;
+
+  if (packetizer->map_buffer && packet->data_start >= packetizer->map_data &&
+      packet->data_end <= packetizer->map_data + packetizer->map_size) {
+    buf = gst_buffer_copy_region (packetizer->map_buffer,
+        GST_BUFFER_COPY_MEMORY, packet->data_start - packetizer->map_data,
+        size);
+    if (buf)
+      return buf;
+  }
+
+  buf = gst_buffer_new_and_alloc (size);
+  gst_buffer_fill (buf, 0, packet->data_start, size);
+
+  return buf;
+}
+
 /*
  * Ideally it should just return a section if:
  * * The section is complete
@@ -263,10 +263,16 @@ struct _MpegTSPacketizer2 {
   /* offset/bitrate calculator */
   gboolean       calculate_offset;
 
-  /* Shortcuts for adapter usage */
+  /* Shortcuts for adapter usage.
+   * map_data either points into the memory of the first buffer queued in the
+   * adapter (map_buffer is then set and mapped with map_info), or into
+   * the bounce slot for the (rare) packets straddling two input buffers */
   guint8 *map_data;
   gsize map_offset;
   gsize map_size;
+  GstBuffer *map_buffer;
+  GstMapInfo map_info;
+  guint8 bounce[4 * MPEGTS_MAX_PACKETSIZE];
   gboolean need_sync;
 
   /* Reference offset */
@@ -352,6 +358,8 @@ G_GNUC_INTERNAL MpegTSPacketizerPacketReturn
 mpegts_packetizer_process_next_packet(MpegTSPacketizer2 * packetizer);
 G_GNUC_INTERNAL void mpegts_packetizer_clear_packet (MpegTSPacketizer2 *packetizer,
 				     MpegTSPacketizerPacket *packet);
+G_GNUC_INTERNAL GstBuffer *mpegts_packetizer_get_packet_buffer (MpegTSPacketizer2 *packetizer,
+				     MpegTSPacketizerPacket *packet);
 G_GNUC_INTERNAL void mpegts_packetizer_remove_stream(MpegTSPacketizer2 *packetizer,
   gint16 pid);
 
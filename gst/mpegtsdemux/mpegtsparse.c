@@ -607,16 +607,6 @@ mpegts_parse_request_new_pad (GstElement * element, GstPadTemplate * template,
   return pad;
 }
 
-static GstBuffer *
-mpegts_packet_to_buffer (MpegTSPacketizerPacket * packet)
-{
-  GstBuffer *buf =
-      gst_buffer_new_and_alloc (packet->data_end - packet->data_start);
-  gst_buffer_fill (buf, 0, packet->data_start,
-      packet->data_end - packet->data_start);
-  return buf;
-}
-
 static void
 mpegts_parse_release_pad (GstElement * element, GstPad * pad)
 {
@@ -807,7 +797,7 @@ mpegts_parse_push (MpegTSBase * base, MpegTSPacketizerPacket * packet,
   }
   GST_OBJECT_UNLOCK (parse);
 
-  buf = mpegts_packet_to_buffer (packet);
+  buf = mpegts_packetizer_get_packet_buffer (base->packetizer, packet);
   if (parse->split_on_rai
       && !(packet->afc_flags & MPEGTS_AFC_RANDOM_ACCESS_FLAG)) {
     gst_buffer_set_flags (buf, GST_BUFFER_FLAG_DELTA_UNIT);
@@ -47,6 +47,7 @@
 #include "mpegtspacketizer.h"
 #include "pesparse.h"
 #include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
 #include <gst/codecparsers/gstmpegvideoparser.h>
 #include <gst/video/video-color.h>
 
@@ -74,6 +75,19 @@
 
 /* latency in msecs */
 #define DEFAULT_LATENCY (700)
+#define DEFAULT_LATENCY_MODE GST_TS_DEMUX_LATENCY_MODE_NORMAL
+#define DEFAULT_LOW_LATENCY_THRESHOLD 0
+
+/* Extra margin added on top of the measured latency, to absorb jitter
+ * before the next measurement catches up */
+#define LOW_LATENCY_MARGIN (10 * GST_MSECOND)
+
+/* Minimum span of data held back while waiting for the first PCR in low
+ * latency mode, before timestamps are derived from the PTS/DTS alone */
+#define LOW_LATENCY_PCR_WAIT (100 * GST_MSECOND)
+
+/* PTS/DTS are 33 bit values */
+#define PTS_DTS_MASK G_GUINT64_CONSTANT (0x1ffffffff)
 
 /* Limit PES packet collection to a maximum of 32MB
  * which is more than large enough to support an H264 frame at
@@ -217,10 +231,20 @@ struct _TSDemuxStream
   guint8 target_pes_substream;
   gboolean needs_keyframe;
 
+  /* TRUE once part of the current PES was pushed early (low latency mode),
+   * the remaining data then goes out without timestamps */
+  gboolean continuation;
+
   GstClockTime seeked_pts, seeked_dts;
 
   GstTsDemuxKeyFrameScanFunction scan_function;
   TSDemuxH264ParsingInfos h264infos;
+  /* Only used to find keyframes for the index */
+  GstH265Parser *h265parser;
+  /* Offset and timestamp of the PES being collected, if it is to be checked
+   * for the index once complete (-1 otherwise) */
+  guint64 index_offset;
+  GstClockTime index_ts;
   TSDemuxJP2KParsingInfos jp2kInfos;
   TSDemuxADTSParsingInfos atdsInfos;
 };
@@ -297,6 +321,9 @@ enum
   PROP_PROGRAM_NUMBER,
   PROP_EMIT_STATS,
   PROP_LATENCY,
+  PROP_LATENCY_MODE,
+  PROP_LOW_LATENCY_THRESHOLD,
+  PROP_INDEX_LOCATION,
   /* FILL ME */
 };
 
@@ -359,10 +386,30 @@ G_DEFINE_TYPE_WITH_CODE (GstTSDemux, gst_ts_demux, GST_TYPE_MPEGTS_BASE,
 #define _do_element_init \
   GST_DEBUG_CATEGORY_INIT (ts_demux_debug, "tsdemux", 0, \
       "MPEG transport stream demuxer");\
-  init_pes_parser ();
+  init_pes_parser (); \
+  init_mpegts_index ();
 GST_ELEMENT_REGISTER_DEFINE_WITH_CODE (tsdemux, "tsdemux",
     GST_RANK_PRIMARY, GST_TYPE_TS_DEMUX, _do_element_init);
 
+GType
+gst_ts_demux_latency_mode_get_type (void)
+{
+  static GType latency_mode_type = 0;
+  static const GEnumValue latency_modes[] = {
+    {GST_TS_DEMUX_LATENCY_MODE_NORMAL, "Report the configured latency",
+        "normal"},
+    {GST_TS_DEMUX_LATENCY_MODE_LOW,
+        "Report the measured latency and push data early", "low"},
+    {0, NULL, NULL}
+  };
+
+  if (!latency_mode_type) {
+    latency_mode_type =
+        g_enum_register_static ("GstTSDemuxLatencyMode", latency_modes);
+  }
+  return latency_mode_type;
+}
+
 static void
 gst_ts_demux_dispose (GObject * object)
 {
@@ -370,6 +417,13 @@ gst_ts_demux_dispose (GObject * object)
 
   gst_flow_combiner_free (demux->flowcombiner);
 
+  if (demux->index.entries) {
+    g_array_free (demux->index.entries, TRUE);
+    demux->index.entries = NULL;
+  }
+  g_free (demux->index_location);
+  demux->index_location = NULL;
+
   GST_CALL_PARENT (G_OBJECT_CLASS, dispose, (object));
 }
 
@@ -401,6 +455,50 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
           G_MAXINT, DEFAULT_LATENCY,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstTSDemux:latency-mode:
+   *
+   * In low latency mode the latency reported upstream is the delay actually
+   * measured between input and output, instead of #GstTSDemux:latency.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_LATENCY_MODE,
+      g_param_spec_enum ("latency-mode", "Latency mode",
+          "How latency is reported and PES data scheduled",
+          GST_TYPE_TS_DEMUX_LATENCY_MODE, DEFAULT_LATENCY_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTSDemux:low-latency-threshold:
+   *
+   * In low latency mode, push PES payload downstream as soon as this many
+   * bytes were collected, without waiting for the PES to complete.
+   * Only applies to streams that don't need whole access units.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_LOW_LATENCY_THRESHOLD,
+      g_param_spec_uint ("low-latency-threshold", "Low latency threshold",
+          "Push partial PES data once this many bytes are queued in low "
+          "latency mode (0 = wait for the complete PES)", 0, MAX_PES_PAYLOAD,
+          DEFAULT_LOW_LATENCY_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTSDemux:index-location:
+   *
+   * File in which the keyframe index is kept between runs. It is read
+   * the first time the index is needed and written back when stopping.
+   * It must only be shared between runs on the same recording.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index location",
+          "Sidecar file to load and save the keyframe index (NULL = none)",
+          NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   element_class = GST_ELEMENT_CLASS (klass);
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&video_template));
@@ -418,6 +516,8 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
       "Zaheer Abbas Merali <zaheerabbas at merali dot org>\n"
       "Edward Hervey <edward.hervey@collabora.co.uk>");
 
+  gst_type_mark_as_plugin_api (GST_TYPE_TS_DEMUX_LATENCY_MODE, 0);
+
   ts_class = GST_MPEGTS_BASE_CLASS (klass);
   ts_class->reset = GST_DEBUG_FUNCPTR (gst_ts_demux_reset);
   ts_class->push = GST_DEBUG_FUNCPTR (gst_ts_demux_push);
@@ -434,6 +534,52 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
   ts_class->drain = GST_DEBUG_FUNCPTR (gst_ts_demux_drain);
 }
 
+static void
+gst_ts_demux_load_index (GstTSDemux * demux)
+{
+  GError *err = NULL;
+  gchar *location;
+
+  if (demux->index_loaded)
+    return;
+  demux->index_loaded = TRUE;
+
+  GST_OBJECT_LOCK (demux);
+  location = g_strdup (demux->index_location);
+  GST_OBJECT_UNLOCK (demux);
+
+  if (location == NULL)
+    return;
+
+  if (!mpegts_index_load (&demux->index, location, &err)) {
+    /* A missing file just means there is no index yet */
+    if (!g_error_matches (err, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      GST_WARNING_OBJECT (demux, "Couldn't load index: %s", err->message);
+    g_clear_error (&err);
+  }
+  g_free (location);
+}
+
+static void
+gst_ts_demux_save_index (GstTSDemux * demux)
+{
+  GError *err = NULL;
+  gchar *location;
+
+  if (!demux->index.dirty)
+    return;
+
+  GST_OBJECT_LOCK (demux);
+  location = g_strdup (demux->index_location);
+  GST_OBJECT_UNLOCK (demux);
+
+  if (location && !mpegts_index_save (&demux->index, location, &err)) {
+    GST_WARNING_OBJECT (demux, "Couldn't save index: %s", err->message);
+    g_clear_error (&err);
+  }
+  g_free (location);
+}
+
 static void
 gst_ts_demux_reset (MpegTSBase * base)
 {
@@ -460,6 +606,19 @@ gst_ts_demux_reset (MpegTSBase * base)
 
   demux->last_seek_offset = -1;
   demux->program_generation = 0;
+
+  gst_ts_demux_save_index (demux);
+  mpegts_index_clear (&demux->index);
+  demux->index_loaded = FALSE;
+  demux->index_pid = -1;
+
+  demux->fallback_base = -1;
+  demux->fallback_base_time = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (demux);
+  demux->measured_latency = 0;
+  demux->reported_latency = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (demux);
 }
 
 static void
@@ -476,6 +635,9 @@ gst_ts_demux_init (GstTSDemux * demux)
   demux->requested_program_number = -1;
   demux->program_number = -1;
   demux->latency = DEFAULT_LATENCY;
+  demux->latency_mode = DEFAULT_LATENCY_MODE;
+  demux->low_latency_threshold = DEFAULT_LOW_LATENCY_THRESHOLD;
+  mpegts_index_init (&demux->index);
   gst_ts_demux_reset (base);
 }
 
@@ -498,6 +660,23 @@ gst_ts_demux_set_property (GObject * object, guint prop_id,
     case PROP_LATENCY:
       demux->latency = g_value_get_int (value);
       break;
+    case PROP_LATENCY_MODE:
+      GST_OBJECT_LOCK (demux);
+      demux->latency_mode = g_value_get_enum (value);
+      demux->reported_latency = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (demux);
+      gst_element_post_message (GST_ELEMENT_CAST (demux),
+          gst_message_new_latency (GST_OBJECT_CAST (demux)));
+      break;
+    case PROP_LOW_LATENCY_THRESHOLD:
+      demux->low_latency_threshold = g_value_get_uint (value);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (demux);
+      g_free (demux->index_location);
+      demux->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -519,6 +698,17 @@ gst_ts_demux_get_property (GObject * object, guint prop_id,
     case PROP_LATENCY:
       g_value_set_int (value, demux->latency);
       break;
+    case PROP_LATENCY_MODE:
+      g_value_set_enum (value, demux->latency_mode);
+      break;
+    case PROP_LOW_LATENCY_THRESHOLD:
+      g_value_set_uint (value, demux->low_latency_threshold);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_string (value, demux->index_location);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -584,23 +774,35 @@ gst_ts_demux_srcpad_query (GstPad * pad, GstObject * parent, GstQuery * query)
       res = gst_pad_peer_query (base->sinkpad, query);
       if (res) {
         GstClockTime min_lat, max_lat;
+        GstClockTime latency;
         gboolean live;
-        gint latency;
-
-        /* According to H.222.0
-           Annex D.0.3 (System Time Clock recovery in the decoder)
-           and D.0.2 (Audio and video presentation synchronization)
-
-           We can end up with an interval of up to 700ms between valid
-           PTS/DTS. We therefore allow a latency of 700ms for that.
-         */
-        latency = demux->latency;
-        if (latency < 0)
-          latency = 700;
+
+        GST_OBJECT_LOCK (demux);
+        if (demux->latency_mode == GST_TS_DEMUX_LATENCY_MODE_LOW) {
+          /* Report what we actually hold data for, measured on output */
+          latency = demux->measured_latency + LOW_LATENCY_MARGIN;
+          demux->reported_latency = latency;
+        } else {
+          /* According to H.222.0
+             Annex D.0.3 (System Time Clock recovery in the decoder)
+             and D.0.2 (Audio and video presentation synchronization)
+
+             We can end up with an interval of up to 700ms between valid
+             PTS/DTS. We therefore allow a latency of 700ms for that.
+           */
+          if (demux->latency < 0)
+            latency = DEFAULT_LATENCY * GST_MSECOND;
+          else
+            latency = demux->latency * GST_MSECOND;
+        }
+        GST_OBJECT_UNLOCK (demux);
+
+        GST_DEBUG_OBJECT (demux, "Reporting latency of %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (latency));
         gst_query_parse_latency (query, &live, &min_lat, &max_lat);
-        min_lat += latency * GST_MSECOND;
+        min_lat += latency;
         if (GST_CLOCK_TIME_IS_VALID (max_lat))
-          max_lat += latency * GST_MSECOND;
+          max_lat += latency;
         gst_query_set_latency (query, live, min_lat, max_lat);
       }
       break;
@@ -669,6 +871,41 @@ clear_simple_buffer (SimpleBuffer * sbuf)
   sbuf->data = NULL;
 }
 
+static GstH264NalParser *
+tsdemux_h264_parsing_info_get_parser (TSDemuxH264ParsingInfos * h264infos)
+{
+  if (G_UNLIKELY (h264infos->parser == NULL)) {
+    h264infos->parser = gst_h264_nal_parser_new ();
+    h264infos->sps = gst_byte_writer_new ();
+    h264infos->pps = gst_byte_writer_new ();
+    h264infos->sei = gst_byte_writer_new ();
+  }
+
+  return h264infos->parser;
+}
+
+/* Whether the slice starts a picture that can be decoded on its own, as
+ * h264parse considers it. The type of non-IDR slices is only known once
+ * their PPS was parsed */
+static gboolean
+h264_slice_is_keyframe (GstH264NalParser * parser, GstH264NalUnit * unit)
+{
+  GstH264SliceHdr slice;
+
+  /* means first_mb_in_slice == 0 */
+  if (unit->size < 2 || !(unit->data[unit->offset + 1] & 0x80))
+    return FALSE;
+
+  if (unit->type == GST_H264_NAL_SLICE_IDR)
+    return TRUE;
+
+  if (gst_h264_parser_parse_slice_hdr (parser, unit, &slice, FALSE,
+          FALSE) != GST_H264_PARSER_OK)
+    return FALSE;
+
+  return GST_H264_IS_I_SLICE (&slice) || GST_H264_IS_SI_SLICE (&slice);
+}
+
 static gboolean
 scan_keyframe_h264 (TSDemuxStream * stream, const guint8 * data,
     const gsize data_size, const gsize max_frame_offset)
@@ -678,14 +915,7 @@ scan_keyframe_h264 (TSDemuxStream * stream, const guint8 * data,
   GstH264ParserResult res = GST_H264_PARSER_OK;
   TSDemuxH264ParsingInfos *h264infos = &stream->h264infos;
 
-  GstH264NalParser *parser = h264infos->parser;
-
-  if (G_UNLIKELY (parser == NULL)) {
-    parser = h264infos->parser = gst_h264_nal_parser_new ();
-    h264infos->sps = gst_byte_writer_new ();
-    h264infos->pps = gst_byte_writer_new ();
-    h264infos->sei = gst_byte_writer_new ();
-  }
+  GstH264NalParser *parser = tsdemux_h264_parsing_info_get_parser (h264infos);
 
   while (res == GST_H264_PARSER_OK) {
     res =
@@ -745,22 +975,14 @@ scan_keyframe_h264 (TSDemuxStream * stream, const guint8 * data,
       case GST_H264_NAL_SLICE_DPC:
       case GST_H264_NAL_SLICE_IDR:
       {
-        GstH264SliceHdr slice;
-
         if (h264infos->framedata.size)
           break;
 
-        res = gst_h264_parser_parse_slice_hdr (parser, &unit, &slice,
-            FALSE, FALSE);
-
-        if (GST_H264_IS_I_SLICE (&slice) || GST_H264_IS_SI_SLICE (&slice)) {
-          if (*(unit.data + unit.offset + 1) & 0x80) {
-            /* means first_mb_in_slice == 0 */
-            /* real frame data */
-            GST_DEBUG_OBJECT (stream->pad, "Found keyframe at: %u",
-                unit.sc_offset);
-            frame_unit = unit;
-          }
+        if (h264_slice_is_keyframe (parser, &unit)) {
+          /* real frame data */
+          GST_DEBUG_OBJECT (stream->pad, "Found keyframe at: %u",
+              unit.sc_offset);
+          frame_unit = unit;
         }
 
         break;
@@ -911,17 +1133,29 @@ gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
   /* If the position actually changed, update == TRUE */
   if (update) {
     GstClockTime target = seeksegment.start;
-    if (target >= SEEK_TIMESTAMP_OFFSET)
-      target -= SEEK_TIMESTAMP_OFFSET;
-    else
-      target = 0;
+    GstClockTime keyframe_ts;
 
-    start_offset =
-        mpegts_packetizer_ts_to_offset (base->packetizer, target,
-        demux->program->pcr_pid);
-    if (G_UNLIKELY (start_offset == -1)) {
-      GST_WARNING ("Couldn't convert start position to an offset");
-      goto done;
+    gst_ts_demux_load_index (demux);
+    mpegts_index_discont (&demux->index);
+
+    if (mpegts_index_lookup (&demux->index, target, &keyframe_ts,
+            &start_offset)) {
+      GST_DEBUG_OBJECT (demux, "Using indexed keyframe %" GST_TIME_FORMAT
+          " at offset %" G_GUINT64_FORMAT, GST_TIME_ARGS (keyframe_ts),
+          start_offset);
+    } else {
+      if (target >= SEEK_TIMESTAMP_OFFSET)
+        target -= SEEK_TIMESTAMP_OFFSET;
+      else
+        target = 0;
+
+      start_offset =
+          mpegts_packetizer_ts_to_offset (base->packetizer, target,
+          demux->program->pcr_pid);
+      if (G_UNLIKELY (start_offset == -1)) {
+        GST_WARNING ("Couldn't convert start position to an offset");
+        goto done;
+      }
     }
 
     base->seek_offset = start_offset;
@@ -1903,6 +2137,8 @@ gst_ts_demux_stream_added (MpegTSBase * base, MpegTSBaseStream * bstream,
     stream->raw_pts = -1;
     stream->raw_dts = -1;
     stream->pending_ts = TRUE;
+    stream->continuation = FALSE;
+    stream->index_offset = -1;
     stream->nb_out_buffers = 0;
     stream->gap_ref_buffers = 0;
     stream->gap_ref_pts = GST_CLOCK_TIME_NONE;
@@ -1924,6 +2160,7 @@ tsdemux_h264_parsing_info_clear (TSDemuxH264ParsingInfos * h264infos)
     gst_byte_writer_free (h264infos->sps);
     gst_byte_writer_free (h264infos->pps);
     gst_byte_writer_free (h264infos->sei);
+    h264infos->parser = NULL;
   }
 }
 
@@ -1964,6 +2201,10 @@ gst_ts_demux_stream_removed (MpegTSBase * base, MpegTSBaseStream * bstream)
   }
 
   tsdemux_h264_parsing_info_clear (&stream->h264infos);
+  if (stream->h265parser) {
+    gst_h265_parser_free (stream->h265parser);
+    stream->h265parser = NULL;
+  }
 }
 
 static void
@@ -2001,6 +2242,8 @@ gst_ts_demux_stream_flush (TSDemuxStream * stream, GstTSDemux * tsdemux,
   stream->raw_pts = -1;
   stream->raw_dts = -1;
   stream->pending_ts = TRUE;
+  stream->continuation = FALSE;
+  stream->index_offset = -1;
   stream->nb_out_buffers = 0;
   stream->gap_ref_buffers = 0;
   stream->gap_ref_pts = GST_CLOCK_TIME_NONE;
@@ -2183,6 +2426,27 @@ gst_ts_demux_program_stopped (MpegTSBase * base, MpegTSBaseProgram * program)
   }
 }
 
+/* Converts a raw PTS/DTS to running time, through the PCR unless the low
+ * latency mode had to give up waiting for one */
+static GstClockTime
+gst_ts_demux_raw_to_ts (GstTSDemux * demux, guint64 raw)
+{
+  guint64 diff;
+
+  if (G_LIKELY (demux->fallback_base == -1))
+    return mpegts_packetizer_pts_to_ts (MPEG_TS_BASE_PACKETIZER (demux),
+        MPEGTIME_TO_GSTTIME (raw), demux->program->pcr_pid);
+
+  /* PTS/DTS are 33 bits and wrap around */
+  diff = (raw - demux->fallback_base) & PTS_DTS_MASK;
+  if (diff < (PTS_DTS_MASK >> 1))
+    return demux->fallback_base_time + MPEGTIME_TO_GSTTIME (diff);
+
+  diff = MPEGTIME_TO_GSTTIME ((demux->fallback_base - raw) & PTS_DTS_MASK);
+  if (diff > demux->fallback_base_time)
+    return GST_CLOCK_TIME_NONE;
+  return demux->fallback_base_time - diff;
+}
 
 static inline void
 gst_ts_demux_record_pts (GstTSDemux * demux, TSDemuxStream * stream,
@@ -2200,9 +2464,7 @@ gst_ts_demux_record_pts (GstTSDemux * demux, TSDemuxStream * stream,
       G_GUINT64_FORMAT, bs->pid, pts, offset);
 
   /* Compute PTS in GstClockTime */
-  stream->pts =
-      mpegts_packetizer_pts_to_ts (MPEG_TS_BASE_PACKETIZER (demux),
-      MPEGTIME_TO_GSTTIME (pts), demux->program->pcr_pid);
+  stream->pts = gst_ts_demux_raw_to_ts (demux, pts);
 
   GST_LOG ("pid 0x%04x Stored PTS %" G_GUINT64_FORMAT, bs->pid, stream->pts);
 
@@ -2234,9 +2496,7 @@ gst_ts_demux_record_dts (GstTSDemux * demux, TSDemuxStream * stream,
       G_GUINT64_FORMAT, bs->pid, dts, offset);
 
   /* Compute DTS in GstClockTime */
-  stream->dts =
-      mpegts_packetizer_pts_to_ts (MPEG_TS_BASE_PACKETIZER (demux),
-      MPEGTIME_TO_GSTTIME (dts), demux->program->pcr_pid);
+  stream->dts = gst_ts_demux_raw_to_ts (demux, dts);
 
   GST_LOG ("pid 0x%04x Stored DTS %" G_GUINT64_FORMAT, bs->pid, stream->dts);
 
@@ -2252,11 +2512,73 @@ gst_ts_demux_record_dts (GstTSDemux * demux, TSDemuxStream * stream,
   }
 }
 
+/* In low latency mode, data doesn't wait for the first PCR much longer than
+ * the latency we report. Returns GST_CLOCK_TIME_NONE to wait for as long as
+ * it takes */
+static GstClockTime
+gst_ts_demux_get_pending_threshold (GstTSDemux * demux)
+{
+  GstClockTime threshold = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (demux);
+  if (demux->latency_mode == GST_TS_DEMUX_LATENCY_MODE_LOW)
+    threshold = MAX (demux->measured_latency + LOW_LATENCY_MARGIN,
+        LOW_LATENCY_PCR_WAIT);
+  GST_OBJECT_UNLOCK (demux);
+
+  return threshold;
+}
+
+/* Picks the earliest pending PTS/DTS as base to compute timestamps without
+ * a PCR. It maps to the time it arrived at if the input is timestamped,
+ * assuming the data since then came in at its own pace */
+static void
+gst_ts_demux_set_fallback_base (GstTSDemux * demux)
+{
+  MpegTSPacketizer2 *packetizer = MPEG_TS_BASE_PACKETIZER (demux);
+  guint64 firstval = -1, lastval = -1;
+  GstClockTime span;
+  GList *tmp;
+
+  for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
+    TSDemuxStream *tmpstream = (TSDemuxStream *) tmp->data;
+    PendingBuffer *pend;
+    guint64 val;
+
+    if (tmpstream->pending) {
+      pend = tmpstream->pending->data;
+      val = pend->dts != -1 ? pend->dts : pend->pts;
+      if (val != -1 && (firstval == -1 || val < firstval))
+        firstval = val;
+    }
+    val = tmpstream->raw_dts != -1 ? tmpstream->raw_dts : tmpstream->raw_pts;
+    if (val != -1 && (lastval == -1 || val > lastval))
+      lastval = val;
+  }
+
+  if (firstval == -1)
+    firstval = lastval;
+  span = lastval > firstval ? MPEGTIME_TO_GSTTIME (lastval - firstval) : 0;
+
+  demux->fallback_base = firstval;
+  if (GST_CLOCK_TIME_IS_VALID (packetizer->last_in_time)
+      && packetizer->last_in_time > span)
+    demux->fallback_base_time = packetizer->last_in_time - span;
+  else
+    demux->fallback_base_time = 0;
+
+  GST_DEBUG_OBJECT (demux, "No PCR in time, raw PTS/DTS %" G_GUINT64_FORMAT
+      " is now %" GST_TIME_FORMAT, demux->fallback_base,
+      GST_TIME_ARGS (demux->fallback_base_time));
+}
+
 /* This is called when we haven't got a valid initial PTS/DTS on all streams */
 static gboolean
 check_pending_buffers (GstTSDemux * demux)
 {
   gboolean have_observation = FALSE;
+  gboolean exceeded_threshold = FALSE;
+  GstClockTime threshold = gst_ts_demux_get_pending_threshold (demux);
   /* The biggest offset */
   guint64 offset = 0;
   GList *tmp;
@@ -2282,13 +2604,34 @@ check_pending_buffers (GstTSDemux * demux)
         have_observation = TRUE;
         break;
       }
+      /* 1.2 in low latency mode, check if the pending data exceeds what we
+       * may hold back */
+      if (GST_CLOCK_TIME_IS_VALID (threshold) && tmpstream->pending
+          && (tmpstream->raw_dts != -1 || tmpstream->raw_pts != -1)) {
+        PendingBuffer *pend = tmpstream->pending->data;
+        guint64 lastval, firstval;
+
+        lastval = tmpstream->raw_dts != -1 ?
+            tmpstream->raw_dts : tmpstream->raw_pts;
+        firstval = pend->dts != -1 ? pend->dts : pend->pts;
+        if (firstval != -1 && lastval > firstval &&
+            MPEGTIME_TO_GSTTIME (lastval - firstval) > threshold)
+          exceeded_threshold = TRUE;
+      }
     }
   }
 
   /* 2. If we don't have a valid value yet, break out */
-  if (have_observation == FALSE)
+  if (have_observation == FALSE && exceeded_threshold == FALSE)
     return FALSE;
 
+  /* 2.1 Without any PCR, timestamps are relative to the first PTS/DTS. There
+   * is no PCR offset to compute then */
+  if (have_observation == FALSE) {
+    gst_ts_demux_set_fallback_base (demux);
+    goto recalculate;
+  }
+
   /* 3. Go over all streams that have current/pending data */
   for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
     TSDemuxStream *tmpstream = (TSDemuxStream *) tmp->data;
@@ -2339,6 +2682,7 @@ check_pending_buffers (GstTSDemux * demux)
   mpegts_packetizer_set_current_pcr_offset (MPEG_TS_BASE_PACKETIZER (demux),
       offset, demux->program->pcr_pid);
 
+recalculate:
   /* 4. Go over all streams */
   for (tmp = demux->program->stream_list; tmp; tmp = tmp->next) {
     TSDemuxStream *stream = (TSDemuxStream *) tmp->data;
@@ -2353,12 +2697,10 @@ check_pending_buffers (GstTSDemux * demux)
         PendingBuffer *pend = (PendingBuffer *) tmp2->data;
         if (pend->pts != -1)
           GST_BUFFER_PTS (pend->buffer) =
-              mpegts_packetizer_pts_to_ts (MPEG_TS_BASE_PACKETIZER (demux),
-              MPEGTIME_TO_GSTTIME (pend->pts), demux->program->pcr_pid);
+              gst_ts_demux_raw_to_ts (demux, pend->pts);
         if (pend->dts != -1)
           GST_BUFFER_DTS (pend->buffer) =
-              mpegts_packetizer_pts_to_ts (MPEG_TS_BASE_PACKETIZER (demux),
-              MPEGTIME_TO_GSTTIME (pend->dts), demux->program->pcr_pid);
+              gst_ts_demux_raw_to_ts (demux, pend->dts);
         /* 4.2.2 Set first_pts to TS of lowest PTS (for segment) */
         if (stream->first_pts == GST_CLOCK_TIME_NONE) {
           if (GST_BUFFER_PTS (pend->buffer) != GST_CLOCK_TIME_NONE)
@@ -2371,16 +2713,12 @@ check_pending_buffers (GstTSDemux * demux)
     /* Recalculate PTS/DTS (in running time) for current data */
     if (stream->state != PENDING_PACKET_EMPTY) {
       if (stream->raw_pts != -1) {
-        stream->pts =
-            mpegts_packetizer_pts_to_ts (MPEG_TS_BASE_PACKETIZER (demux),
-            MPEGTIME_TO_GSTTIME (stream->raw_pts), demux->program->pcr_pid);
+        stream->pts = gst_ts_demux_raw_to_ts (demux, stream->raw_pts);
         if (stream->first_pts == GST_CLOCK_TIME_NONE)
           stream->first_pts = stream->pts;
       }
       if (stream->raw_dts != -1) {
-        stream->dts =
-            mpegts_packetizer_pts_to_ts (MPEG_TS_BASE_PACKETIZER (demux),
-            MPEGTIME_TO_GSTTIME (stream->raw_dts), demux->program->pcr_pid);
+        stream->dts = gst_ts_demux_raw_to_ts (demux, stream->raw_dts);
         if (stream->first_pts == GST_CLOCK_TIME_NONE)
           stream->first_pts = stream->dts;
       }
@@ -2390,6 +2728,208 @@ check_pending_buffers (GstTSDemux * demux)
   return TRUE;
 }
 
+typedef enum
+{
+  PES_KEYFRAME_NO,
+  PES_KEYFRAME_YES,
+  /* The data ended before the first picture */
+  PES_KEYFRAME_UNKNOWN
+} PESKeyframeResult;
+
+static PESKeyframeResult
+gst_ts_demux_h264_pes_is_keyframe (TSDemuxStream * stream, const guint8 * data,
+    gsize size)
+{
+  GstH264NalParser *parser =
+      tsdemux_h264_parsing_info_get_parser (&stream->h264infos);
+  GstH264ParserResult res;
+  GstH264NalUnit unit;
+  guint offset = 0;
+
+  do {
+    res = gst_h264_parser_identify_nalu (parser, data, offset, size, &unit);
+    if (res != GST_H264_PARSER_OK && res != GST_H264_PARSER_NO_NAL_END)
+      return PES_KEYFRAME_UNKNOWN;
+
+    switch (unit.type) {
+      case GST_H264_NAL_SPS:
+      case GST_H264_NAL_PPS:
+        gst_h264_parser_parse_nal (parser, &unit);
+        break;
+      case GST_H264_NAL_SLICE:
+      case GST_H264_NAL_SLICE_IDR:
+        return h264_slice_is_keyframe (parser, &unit) ?
+            PES_KEYFRAME_YES : PES_KEYFRAME_NO;
+      case GST_H264_NAL_SLICE_DPA:
+      case GST_H264_NAL_SLICE_DPB:
+      case GST_H264_NAL_SLICE_DPC:
+        return PES_KEYFRAME_NO;
+      default:
+        break;
+    }
+
+    offset = unit.offset + unit.size;
+  } while (res == GST_H264_PARSER_OK);
+
+  return PES_KEYFRAME_UNKNOWN;
+}
+
+static PESKeyframeResult
+gst_ts_demux_h265_pes_is_keyframe (TSDemuxStream * stream, const guint8 * data,
+    gsize size)
+{
+  GstH265ParserResult res;
+  GstH265NalUnit unit;
+  guint offset = 0;
+
+  if (G_UNLIKELY (stream->h265parser == NULL))
+    stream->h265parser = gst_h265_parser_new ();
+
+  do {
+    res = gst_h265_parser_identify_nalu (stream->h265parser, data, offset,
+        size, &unit);
+    if (res != GST_H265_PARSER_OK && res != GST_H265_PARSER_NO_NAL_END)
+      return PES_KEYFRAME_UNKNOWN;
+
+    /* The first VCL unit tells */
+    if (unit.type < GST_H265_NAL_VPS)
+      return GST_H265_IS_NAL_TYPE_IRAP (unit.type) ?
+          PES_KEYFRAME_YES : PES_KEYFRAME_NO;
+
+    offset = unit.offset + unit.size;
+  } while (res == GST_H265_PARSER_OK);
+
+  return PES_KEYFRAME_UNKNOWN;
+}
+
+static PESKeyframeResult
+gst_ts_demux_mpeg_video_pes_is_keyframe (const guint8 * data, gsize size)
+{
+  GstMpegVideoPacket packet;
+  guint offset = 0;
+
+  while (gst_mpeg_video_parse (&packet, data, size, offset)) {
+    GstMpegVideoPictureHdr hdr;
+
+    if (packet.size < 0)
+      packet.size = size - packet.offset;
+
+    switch (packet.type) {
+      case GST_MPEG_VIDEO_PACKET_SEQUENCE:
+      case GST_MPEG_VIDEO_PACKET_GOP:
+        return PES_KEYFRAME_YES;
+      case GST_MPEG_VIDEO_PACKET_PICTURE:
+        if (!gst_mpeg_video_packet_parse_picture_header (&packet, &hdr))
+          return PES_KEYFRAME_UNKNOWN;
+        return hdr.pic_type == GST_MPEG_VIDEO_PICTURE_TYPE_I ?
+            PES_KEYFRAME_YES : PES_KEYFRAME_NO;
+      default:
+        if (GST_MPEG_VIDEO_PACKET_IS_SLICE (packet.type))
+          return PES_KEYFRAME_NO;
+        break;
+    }
+
+    offset = packet.offset + packet.size;
+  }
+
+  return PES_KEYFRAME_UNKNOWN;
+}
+
+/* Whether keyframes of the stream can be found for the index */
+static gboolean
+gst_ts_demux_stream_is_indexable (TSDemuxStream * stream)
+{
+  MpegTSBaseStream *bs = (MpegTSBaseStream *) stream;
+
+  switch (bs->stream_type) {
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_H264:
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_HEVC:
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG1:
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG2:
+    case ST_PS_VIDEO_MPEG2_DCII:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/* Sniffs a PES payload for the start of a picture that can be decoded on
+ * its own */
+static PESKeyframeResult
+gst_ts_demux_pes_is_keyframe (TSDemuxStream * stream, const guint8 * data,
+    gsize size)
+{
+  MpegTSBaseStream *bs = (MpegTSBaseStream *) stream;
+
+  switch (bs->stream_type) {
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_H264:
+      return gst_ts_demux_h264_pes_is_keyframe (stream, data, size);
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_HEVC:
+      return gst_ts_demux_h265_pes_is_keyframe (stream, data, size);
+    default:
+      return gst_ts_demux_mpeg_video_pes_is_keyframe (data, size);
+  }
+}
+
+/* Remembers where the PES starts, so that it can be indexed once its
+ * payload was collected. Only one video stream is indexed, the first one
+ * on which a keyframe is seen */
+static void
+gst_ts_demux_index_pes_start (GstTSDemux * demux, TSDemuxStream * stream,
+    guint64 bufferoffset)
+{
+  MpegTSBaseStream *bs = (MpegTSBaseStream *) stream;
+  GstClockTime ts;
+
+  stream->index_offset = -1;
+
+  if (demux->index_pid != -1 && demux->index_pid != bs->pid)
+    return;
+
+  if (!gst_ts_demux_stream_is_indexable (stream))
+    return;
+
+  ts = GST_CLOCK_TIME_IS_VALID (stream->pts) ? stream->pts : stream->dts;
+  if (stream->pending_ts || !GST_CLOCK_TIME_IS_VALID (ts)) {
+    /* A keyframe could go unnoticed */
+    mpegts_index_discont (&demux->index);
+    return;
+  }
+
+  stream->index_offset = bufferoffset;
+  stream->index_ts = ts;
+}
+
+/* Records the PES if it starts with a keyframe. The previous keyframe is
+ * only known to be the last one before it if this could be told for every
+ * PES in between */
+static void
+gst_ts_demux_index_pes (GstTSDemux * demux, TSDemuxStream * stream)
+{
+  MpegTSBaseStream *bs = (MpegTSBaseStream *) stream;
+
+  if (stream->index_offset == -1)
+    return;
+
+  switch (gst_ts_demux_pes_is_keyframe (stream, stream->data,
+          stream->current_size)) {
+    case PES_KEYFRAME_YES:
+      gst_ts_demux_load_index (demux);
+      demux->index_pid = bs->pid;
+      mpegts_index_add (&demux->index, stream->index_ts, stream->index_offset);
+      break;
+    case PES_KEYFRAME_UNKNOWN:
+      GST_DEBUG_OBJECT (stream->pad, "Couldn't tell if PES at offset %"
+          G_GUINT64_FORMAT " is a keyframe", stream->index_offset);
+      mpegts_index_discont (&demux->index);
+      break;
+    default:
+      break;
+  }
+
+  stream->index_offset = -1;
+}
+
 static void
 gst_ts_demux_parse_pes_header (GstTSDemux * demux, TSDemuxStream * stream,
     guint8 * data, guint32 length, guint64 bufferoffset)
@@ -2448,6 +2988,8 @@ gst_ts_demux_parse_pes_header (GstTSDemux * demux, TSDemuxStream * stream,
   data += header.header_size;
   length -= header.header_size;
 
+  gst_ts_demux_index_pes_start (demux, stream, bufferoffset);
+
   /* Create the output buffer */
   if (stream->expected_size)
     stream->allocated_size = MAX (stream->expected_size, length);
@@ -3050,6 +3592,59 @@ out:
 }
 
 
+/* The latency we introduce is how far behind the latest input the buffers
+ * we push are. Keep the maximum and ask for a new latency configuration
+ * whenever it exceeds what was last reported. */
+static void
+gst_ts_demux_update_measured_latency (GstTSDemux * demux, GstClockTime ts)
+{
+  MpegTSPacketizer2 *packetizer = MPEG_TS_BASE_PACKETIZER (demux);
+  GstClockTime in_time = packetizer->last_in_time;
+  gboolean post = FALSE;
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts) || !GST_CLOCK_TIME_IS_VALID (in_time)
+      || in_time <= ts)
+    return;
+
+  GST_OBJECT_LOCK (demux);
+  if (in_time - ts > demux->measured_latency) {
+    demux->measured_latency = in_time - ts;
+    GST_DEBUG_OBJECT (demux, "Measured latency now %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (demux->measured_latency));
+    post = demux->latency_mode == GST_TS_DEMUX_LATENCY_MODE_LOW &&
+        GST_CLOCK_TIME_IS_VALID (demux->reported_latency) &&
+        demux->measured_latency > demux->reported_latency;
+    if (post)
+      demux->reported_latency = GST_CLOCK_TIME_NONE;
+  }
+  GST_OBJECT_UNLOCK (demux);
+
+  if (post)
+    gst_element_post_message (GST_ELEMENT_CAST (demux),
+        gst_message_new_latency (GST_OBJECT_CAST (demux)));
+}
+
+/* Whether the stream can be output in chunks that don't contain a whole
+ * PES, which is not the case for the formats we parse ourselves */
+static gboolean
+gst_ts_demux_stream_can_split (TSDemuxStream * stream)
+{
+  MpegTSBaseStream *bs = (MpegTSBaseStream *) stream;
+
+  if (stream->needs_keyframe || stream->pending_ts || stream->sparse)
+    return FALSE;
+
+  switch (bs->stream_type) {
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_JP2K:
+    case GST_MPEGTS_STREAM_TYPE_AUDIO_AAC_ADTS:
+      return FALSE;
+    case GST_MPEGTS_STREAM_TYPE_PRIVATE_PES_PACKETS:
+      return bs->registration_id != DRF_ID_OPUS;
+    default:
+      return TRUE;
+  }
+}
+
 static GstFlowReturn
 gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream,
     MpegTSBaseProgram * target_program)
@@ -3086,6 +3681,10 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream,
     goto beach;
   }
 
+  /* Before the data is handed out. A PES split in low latency mode is only
+   * sniffed in its first part */
+  gst_ts_demux_index_pes (demux, stream);
+
   if (stream->needs_keyframe) {
     MpegTSBase *base = (MpegTSBase *) demux;
 
@@ -3255,11 +3854,17 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream,
   if (buffer_list)
     buffer = gst_buffer_list_get (buffer_list, 0);
 
-  if (GST_CLOCK_TIME_IS_VALID (stream->pts))
-    GST_BUFFER_PTS (buffer) = GST_BUFFER_DTS (buffer) = stream->pts;
-  /* DTS = PTS by default, we override it if there's a real DTS */
-  if (GST_CLOCK_TIME_IS_VALID (stream->dts))
-    GST_BUFFER_DTS (buffer) = stream->dts;
+  /* The rest of a PES that was partially pushed already doesn't start
+   * an access unit, don't repeat the timestamps on it */
+  if (!stream->continuation) {
+    if (GST_CLOCK_TIME_IS_VALID (stream->pts))
+      GST_BUFFER_PTS (buffer) = GST_BUFFER_DTS (buffer) = stream->pts;
+    /* DTS = PTS by default, we override it if there's a real DTS */
+    if (GST_CLOCK_TIME_IS_VALID (stream->dts))
+      GST_BUFFER_DTS (buffer) = stream->dts;
+
+    gst_ts_demux_update_measured_latency (demux, GST_BUFFER_DTS (buffer));
+  }
 
   if (stream->discont)
     GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
@@ -3351,6 +3956,7 @@ gst_ts_demux_handle_packet (GstTSDemux * demux, TSDemuxStream * stream,
       FLAGS_HAS_PAYLOAD (packet->scram_afc_cc)) {
     /* Flush previous data */
     res = gst_ts_demux_push_pending_data (demux, stream, NULL);
+    stream->continuation = FALSE;
     if (res != GST_FLOW_REWINDING) {
       /* Tell the data collecting to expect this header. We don't do this when
        * rewinding since the states will have been resetted accordingly */
@@ -3369,6 +3975,14 @@ gst_ts_demux_handle_packet (GstTSDemux * demux, TSDemuxStream * stream,
         || (stream->current_size >= MAX_PES_PAYLOAD)) {
       GST_LOG ("pushing packet of size %u", stream->current_size);
       res = gst_ts_demux_push_pending_data (demux, stream, NULL);
+    } else if (demux->latency_mode == GST_TS_DEMUX_LATENCY_MODE_LOW
+        && demux->low_latency_threshold
+        && stream->current_size >= demux->low_latency_threshold
+        && stream->state == PENDING_PACKET_BUFFER
+        && gst_ts_demux_stream_can_split (stream)) {
+      GST_LOG ("pushing %u bytes of incomplete PES", stream->current_size);
+      res = gst_ts_demux_push_pending_data (demux, stream, NULL);
+      stream->continuation = TRUE;
     }
   }
 
@@ -3387,6 +4001,7 @@ gst_ts_demux_flush (MpegTSBase * base, gboolean hard)
   GstTSDemux *demux = GST_TS_DEMUX_CAST (base);
 
   gst_ts_demux_flush_streams (demux, hard);
+  mpegts_index_discont (&demux->index);
 
   if (demux->segment_event) {
     gst_event_unref (demux->segment_event);
@@ -32,6 +32,7 @@
 #include <gst/base/gstflowcombiner.h>
 #include "mpegtsbase.h"
 #include "mpegtspacketizer.h"
+#include "mpegtsindex.h"
 
 /* color specifications for JPEG 2000 stream over MPEG TS */
 typedef enum
@@ -61,9 +62,25 @@ G_BEGIN_DECLS
 #define GST_TS_DEMUX_GET_CLASS(obj) \
   (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_TS_DEMUX, GstTSDemuxClass))
 #define GST_TS_DEMUX_CAST(obj) ((GstTSDemux*) obj)
+#define GST_TYPE_TS_DEMUX_LATENCY_MODE \
+  (gst_ts_demux_latency_mode_get_type())
 typedef struct _GstTSDemux GstTSDemux;
 typedef struct _GstTSDemuxClass GstTSDemuxClass;
 
+/**
+ * GstTSDemuxLatencyMode:
+ * @GST_TS_DEMUX_LATENCY_MODE_NORMAL: report the fixed #GstTSDemux:latency
+ * @GST_TS_DEMUX_LATENCY_MODE_LOW: report the measured latency and output
+ *   PES data as early as possible
+ *
+ * Since: 1.20
+ */
+typedef enum
+{
+  GST_TS_DEMUX_LATENCY_MODE_NORMAL,
+  GST_TS_DEMUX_LATENCY_MODE_LOW
+} GstTSDemuxLatencyMode;
+
 struct _GstTSDemux
 {
   MpegTSBase parent;
@@ -77,6 +94,14 @@ struct _GstTSDemux
   guint program_number;
   gboolean emit_statistics;
   gint latency; /* latency in ms */
+  GstTSDemuxLatencyMode latency_mode;
+  guint low_latency_threshold; /* bytes, 0 to disable */
+
+  /* Highest observed delay between the last input timestamp and the
+   * timestamp of the buffer being pushed, and the value last reported
+   * in a latency query */
+  GstClockTime measured_latency;
+  GstClockTime reported_latency;
 
   /*< private >*/
   gint program_generation; /* Incremented each time we switch program 0..15 */
@@ -101,6 +126,19 @@ struct _GstTSDemux
 
   /* Used when seeking for a keyframe to go backward in the stream */
   guint64 last_seek_offset;
+
+  /* In low latency mode, when no PCR showed up in time, PTS/DTS are
+   * converted relative to this raw value (-1 if unused), which maps to
+   * fallback_base_time */
+  guint64 fallback_base;
+  GstClockTime fallback_base_time;
+
+  /* Keyframe index built while playing, optionally kept in a sidecar file
+   * (index_location, protected by the OBJECT_LOCK) */
+  gchar *index_location;
+  MpegTSIndex index;
+  gboolean index_loaded;
+  gint index_pid; /* PID of the video stream being indexed, -1 if none yet */
 };
 
 struct _GstTSDemuxClass
@@ -109,6 +147,7 @@ struct _GstTSDemuxClass
 };
 
 G_GNUC_INTERNAL GType gst_ts_demux_get_type (void);
+G_GNUC_INTERNAL GType gst_ts_demux_latency_mode_get_type (void);
 GST_ELEMENT_REGISTER_DECLARE (tsdemux);
 
 G_END_DECLS
@@ -309,6 +309,90 @@ steal_si_section (GstMpegtsSectionType * type, TsMuxSection * section,
   return TRUE;
 }
 
+static void
+gst_base_ts_mux_release_pool (GstBufferPool ** pool)
+{
+  if (*pool) {
+    gst_buffer_pool_set_active (*pool, FALSE);
+    gst_object_unref (*pool);
+    *pool = NULL;
+  }
+}
+
+/* Acquires a buffer of @size bytes from @pool, (re)creating the pool if
+ * the size changed */
+static GstBuffer *
+gst_base_ts_mux_acquire_buffer (GstBaseTsMux * mux, GstBufferPool ** pool,
+    gsize * pool_size, gsize size)
+{
+  GstBuffer *buf = NULL;
+
+  if (*pool && *pool_size != size)
+    gst_base_ts_mux_release_pool (pool);
+
+  if (!*pool) {
+    GstStructure *config;
+
+    *pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (*pool);
+    gst_buffer_pool_config_set_params (config, NULL, size, 0, 0);
+    if (!gst_buffer_pool_set_config (*pool, config) ||
+        !gst_buffer_pool_set_active (*pool, TRUE)) {
+      GST_WARNING_OBJECT (mux, "Failed to set up pool of %" G_GSIZE_FORMAT
+          " bytes buffers", size);
+      gst_object_unref (*pool);
+      *pool = NULL;
+    }
+    *pool_size = size;
+  }
+
+  if (!*pool || gst_buffer_pool_acquire_buffer (*pool, &buf,
+          NULL) != GST_FLOW_OK)
+    buf = gst_buffer_new_allocate (NULL, size, NULL);
+
+  return buf;
+}
+
+/* Moves the slab being filled to the list pushed at the end of the
+ * aggregate cycle */
+static void
+gst_base_ts_mux_finish_out_buffer (GstBaseTsMux * mux)
+{
+  if (!mux->out_buffer)
+    return;
+
+  gst_buffer_unmap (mux->out_buffer, &mux->out_map);
+  gst_buffer_set_size (mux->out_buffer, mux->out_offset);
+
+  if (!mux->out_list)
+    mux->out_list = gst_buffer_list_new ();
+  gst_buffer_list_add (mux->out_list, mux->out_buffer);
+
+  mux->out_buffer = NULL;
+  mux->out_offset = 0;
+}
+
+static void
+gst_base_ts_mux_clear_output (GstBaseTsMux * mux)
+{
+  if (mux->out_buffer) {
+    gst_buffer_unmap (mux->out_buffer, &mux->out_map);
+    gst_buffer_unref (mux->out_buffer);
+    mux->out_buffer = NULL;
+  }
+  mux->out_offset = 0;
+
+  if (mux->out_list) {
+    gst_buffer_list_unref (mux->out_list);
+    mux->out_list = NULL;
+  }
+
+  mux->last_packet_pts = GST_CLOCK_TIME_NONE;
+
+  gst_base_ts_mux_release_pool (&mux->packet_pool);
+  gst_base_ts_mux_release_pool (&mux->out_pool);
+}
+
 static void
 gst_base_ts_mux_reset (GstBaseTsMux * mux, gboolean alloc)
 {
@@ -327,8 +411,7 @@ gst_base_ts_mux_reset (GstBaseTsMux * mux, gboolean alloc)
   mux->pending_key_unit_ts = GST_CLOCK_TIME_NONE;
   gst_event_replace (&mux->force_key_unit_event, NULL);
 
-  if (mux->out_adapter)
-    gst_adapter_clear (mux->out_adapter);
+  gst_base_ts_mux_clear_output (mux);
   mux->output_ts_offset = GST_CLOCK_TIME_NONE;
 
   if (mux->tsmux) {
@@ -348,7 +431,6 @@ gst_base_ts_mux_reset (GstBaseTsMux * mux, gboolean alloc)
     gst_buffer_unref (buf);
 
   gst_event_replace (&mux->force_key_unit_event, NULL);
-  gst_buffer_replace (&mux->out_buffer, NULL);
 
   GST_OBJECT_LOCK (mux);
 
@@ -914,77 +996,33 @@ new_packet_common_init (GstBaseTsMux * mux, GstBuffer * buf, guint8 * data,
   }
 }
 
+static gint
+gst_base_ts_mux_get_alignment (GstBaseTsMux * mux)
+{
+  if (mux->alignment < 0)
+    return mux->automatic_alignment;
+
+  return mux->alignment;
+}
+
 static GstFlowReturn
 gst_base_ts_mux_push_packets (GstBaseTsMux * mux, gboolean force)
 {
   GstBufferList *buffer_list;
-  gint align = mux->alignment;
-  gint av, packet_size;
-
-  packet_size = mux->packet_size;
-
-  if (align < 0)
-    align = mux->automatic_alignment;
-
-  av = gst_adapter_available (mux->out_adapter);
-  GST_LOG_OBJECT (mux, "align %d, av %d", align, av);
+  gint align;
 
-  if (av == 0)
-    return GST_FLOW_OK;
+  align = gst_base_ts_mux_get_alignment (mux);
 
-  /* no alignment, just push all available data */
-  if (align == 0) {
-    buffer_list = gst_adapter_take_buffer_list (mux->out_adapter, av);
-    return gst_aggregator_finish_buffer_list (GST_AGGREGATOR (mux),
-        buffer_list);
-  }
+  GST_LOG_OBJECT (mux, "align %d, pending %" G_GSIZE_FORMAT " bytes", align,
+      mux->out_offset);
 
-  align *= packet_size;
-
-  if (!force && align > av)
-    return GST_FLOW_OK;
+  /* pad the last aligned buffer with null packets */
+  if (mux->out_buffer && align > 0 && force) {
+    gsize packet_size = mux->packet_size;
+    guint8 *data = mux->out_map.data + mux->out_offset;
+    guint32 header = GST_READ_UINT32_BE (data - packet_size);
+    gint dummy = (mux->out_map.size - mux->out_offset) / packet_size;
 
-  buffer_list = gst_buffer_list_new_sized ((av / align) + 1);
-
-  GST_LOG_OBJECT (mux, "aligning to %d bytes", align);
-  while (align <= av) {
-    GstBuffer *buf;
-    GstClockTime pts;
-
-    pts = gst_adapter_prev_pts (mux->out_adapter, NULL);
-    buf = gst_adapter_take_buffer (mux->out_adapter, align);
-
-    GST_BUFFER_PTS (buf) = pts;
-
-    gst_buffer_list_add (buffer_list, buf);
-    av -= align;
-  }
-
-  if (av > 0 && force) {
-    GstBuffer *buf;
-    GstClockTime pts;
-    guint8 *data;
-    guint32 header;
-    gint dummy;
-    GstMapInfo map;
-
-    GST_LOG_OBJECT (mux, "handling %d leftover bytes", av);
-
-    pts = gst_adapter_prev_pts (mux->out_adapter, NULL);
-    buf = gst_buffer_new_and_alloc (align);
-
-    GST_BUFFER_PTS (buf) = pts;
-
-    gst_buffer_map (buf, &map, GST_MAP_READ);
-    data = map.data;
-
-    gst_adapter_copy (mux->out_adapter, data, 0, av);
-    gst_adapter_clear (mux->out_adapter);
-
-    data += av;
-    header = GST_READ_UINT32_BE (data - packet_size);
-
-    dummy = (map.size - av) / packet_size;
     GST_LOG_OBJECT (mux, "adding %d null packets", dummy);
 
     for (; dummy > 0; dummy--) {
@@ -1006,21 +1044,77 @@ gst_base_ts_mux_push_packets (GstBaseTsMux * mux, gboolean force)
       /* payload */
       memset (data + offset + 4, 0, GST_BASE_TS_MUX_NORMAL_PACKET_LENGTH - 4);
       data += packet_size;
+      mux->out_offset += packet_size;
     }
-
-    gst_buffer_unmap (buf, &map);
-    gst_buffer_list_add (buffer_list, buf);
   }
 
+  /* push the last slab when draining */
+  if (force)
+    gst_base_ts_mux_finish_out_buffer (mux);
+
+  if (!mux->out_list)
+    return GST_FLOW_OK;
+
+  buffer_list = mux->out_list;
+  mux->out_list = NULL;
+
   return gst_aggregator_finish_buffer_list (GST_AGGREGATOR (mux), buffer_list);
 }
 
+/* Without alignment, packets are queued as they are, so that each keeps its
+ * own timestamps and flags. Otherwise they are copied into a slab of
+ * alignment packets, which takes the timestamps and flags of its first
+ * packet */
 static GstFlowReturn
 gst_base_ts_mux_collect_packet (GstBaseTsMux * mux, GstBuffer * buf)
 {
-  GST_LOG_OBJECT (mux, "collecting packet size %" G_GSIZE_FORMAT,
-      gst_buffer_get_size (buf));
-  gst_adapter_push (mux->out_adapter, buf);
+  gsize size = gst_buffer_get_size (buf);
+  gint align = gst_base_ts_mux_get_alignment (mux);
+
+  GST_LOG_OBJECT (mux, "collecting packet size %" G_GSIZE_FORMAT, size);
+
+  if (GST_BUFFER_PTS_IS_VALID (buf))
+    mux->last_packet_pts = GST_BUFFER_PTS (buf);
+
+  if (align == 0) {
+    /* in case the alignment just changed */
+    gst_base_ts_mux_finish_out_buffer (mux);
+
+    if (!mux->out_list)
+      mux->out_list = gst_buffer_list_new ();
+    gst_buffer_list_add (mux->out_list, buf);
+
+    return GST_FLOW_OK;
+  }
+
+  if (mux->out_buffer && mux->out_offset + size > mux->out_map.size)
+    gst_base_ts_mux_finish_out_buffer (mux);
+
+  if (!mux->out_buffer) {
+    gsize slab_size = MAX (align * mux->packet_size, size);
+
+    mux->out_buffer = gst_base_ts_mux_acquire_buffer (mux, &mux->out_pool,
+        &mux->out_pool_size, slab_size);
+    if (!gst_buffer_map (mux->out_buffer, &mux->out_map, GST_MAP_WRITE)) {
+      gst_buffer_unref (mux->out_buffer);
+      mux->out_buffer = NULL;
+      gst_buffer_unref (buf);
+      return GST_FLOW_ERROR;
+    }
+    mux->out_offset = 0;
+
+    GST_BUFFER_PTS (mux->out_buffer) = mux->last_packet_pts;
+    GST_BUFFER_DTS (mux->out_buffer) = GST_BUFFER_DTS (buf);
+    GST_BUFFER_FLAG_SET (mux->out_buffer, GST_BUFFER_FLAGS (buf) &
+        (GST_BUFFER_FLAG_HEADER | GST_BUFFER_FLAG_DELTA_UNIT));
+  }
+
+  gst_buffer_extract (buf, 0, mux->out_map.data + mux->out_offset, size);
+  mux->out_offset += size;
+  gst_buffer_unref (buf);
+
+  if (mux->out_offset == mux->out_map.size)
+    gst_base_ts_mux_finish_out_buffer (mux);
 
   return GST_FLOW_OK;
 }
@@ -1848,10 +1942,6 @@ gst_base_ts_mux_dispose (GObject * object)
 
   gst_base_ts_mux_reset (mux, FALSE);
 
-  if (mux->out_adapter) {
-    g_object_unref (mux->out_adapter);
-    mux->out_adapter = NULL;
-  }
   if (mux->prog_map) {
     gst_structure_free (mux->prog_map);
     mux->prog_map = NULL;
@@ -1996,20 +2086,15 @@ static void
 gst_base_ts_mux_default_allocate_packet (GstBaseTsMux * mux,
     GstBuffer ** buffer)
 {
-  GstBuffer *buf;
-
-  buf = gst_buffer_new_and_alloc (mux->packet_size);
-
-  *buffer = buf;
+  *buffer = gst_base_ts_mux_acquire_buffer (mux, &mux->packet_pool,
+      &mux->packet_pool_size, mux->packet_size);
 }
 
 static gboolean
 gst_base_ts_mux_default_output_packet (GstBaseTsMux * mux, GstBuffer * buffer,
     gint64 new_pcr)
 {
-  gst_base_ts_mux_collect_packet (mux, buffer);
-
-  return TRUE;
+  return gst_base_ts_mux_collect_packet (mux, buffer) == GST_FLOW_OK;
 }
 
 /* Subclass API */
@@ -2131,7 +2216,7 @@ gst_base_ts_mux_class_init (GstBaseTsMuxClass * klass)
 static void
 gst_base_ts_mux_init (GstBaseTsMux * mux)
 {
-  mux->out_adapter = gst_adapter_new ();
+  mux->last_packet_pts = GST_CLOCK_TIME_NONE;
 
   /* properties */
   mux->pat_interval = TSMUX_DEFAULT_PAT_INTERVAL;
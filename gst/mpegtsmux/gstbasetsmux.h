@@ -194,9 +194,18 @@ struct GstBaseTsMux {
   gsize packet_size;
   gsize automatic_alignment;
 
-  /* output buffer aggregation */
-  GstAdapter *out_adapter;
+  /* output buffer aggregation: packets are written into pooled buffers,
+   * which are queued as they are, or packed into slabs of alignment packets,
+   * and pushed as one buffer list per aggregate cycle */
+  GstBufferPool *packet_pool;
+  gsize packet_pool_size;
+  GstBufferPool *out_pool;
+  gsize out_pool_size;
   GstBuffer *out_buffer;
+  GstMapInfo out_map;
+  gsize out_offset;
+  GstBufferList *out_list;
+  GstClockTime last_packet_pts;
   GstClockTimeDiff output_ts_offset;
 };
 
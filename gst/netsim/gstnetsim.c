@@ -53,6 +53,23 @@ distribution_get_type (void)
   return static_g_define_type_id;
 }
 
+static GType
+loss_model_get_type (void)
+{
+  static gsize static_g_define_type_id = 0;
+  if (g_once_init_enter (&static_g_define_type_id)) {
+    static const GEnumValue values[] = {
+      {LOSS_MODEL_BERNOULLI, "bernoulli", "bernoulli"},
+      {LOSS_MODEL_GILBERT_ELLIOTT, "gilbert-elliott", "gilbert-elliott"},
+      {0, NULL, NULL}
+    };
+    GType g_define_type_id =
+        g_enum_register_static ("GstNetSimLossModel", values);
+    g_once_init_leave (&static_g_define_type_id, g_define_type_id);
+  }
+  return static_g_define_type_id;
+}
+
 enum
 {
   PROP_0,
@@ -66,6 +83,13 @@ enum
   PROP_MAX_KBPS,
   PROP_MAX_BUCKET_SIZE,
   PROP_ALLOW_REORDERING,
+  PROP_LOSS_MODEL,
+  PROP_GE_GOOD_TO_BAD,
+  PROP_GE_BAD_TO_GOOD,
+  PROP_GE_GOOD_LOSS,
+  PROP_GE_BAD_LOSS,
+  PROP_TRACE_LOCATION,
+  PROP_SEED,
 };
 
 /* these numbers are nothing but wild guesses and don't reflect any reality */
@@ -79,6 +103,13 @@ enum
 #define DEFAULT_MAX_KBPS -1
 #define DEFAULT_MAX_BUCKET_SIZE -1
 #define DEFAULT_ALLOW_REORDERING TRUE
+#define DEFAULT_LOSS_MODEL LOSS_MODEL_BERNOULLI
+#define DEFAULT_GE_GOOD_TO_BAD 0.0
+#define DEFAULT_GE_BAD_TO_GOOD 1.0
+#define DEFAULT_GE_GOOD_LOSS 0.0
+#define DEFAULT_GE_BAD_LOSS 1.0
+#define DEFAULT_TRACE_LOCATION NULL
+#define DEFAULT_SEED 0
 
 static GstStaticPadTemplate gst_net_sim_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
@@ -96,57 +127,237 @@ G_DEFINE_TYPE (GstNetSim, gst_net_sim, GST_TYPE_ELEMENT);
 GST_ELEMENT_REGISTER_DEFINE (netsim, "netsim",
     GST_RANK_MARGINAL, GST_TYPE_NET_SIM);
 
-static gboolean
-gst_net_sim_source_dispatch (GSource * source,
-    GSourceFunc callback, gpointer user_data)
+/* One line of an impairment trace */
+typedef struct
+{
+  gint64 delay;                 /* microseconds */
+  gboolean lost;
+} TraceEntry;
+
+/* Parses a trace in CSV format, one "delay_ms,lost" line per packet. An
+ * empty or negative delay also marks the packet as lost, the lost column
+ * is optional. Blank lines, lines starting with '#' and a header line are
+ * skipped. */
+static GArray *
+gst_net_sim_load_trace (const gchar * location, GError ** error)
 {
-  callback (user_data);
-  return FALSE;
+  gchar *contents;
+  gchar **lines;
+  GArray *trace;
+  gboolean header_allowed = TRUE;
+  guint i;
+
+  if (!g_file_get_contents (location, &contents, NULL, error))
+    return NULL;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+  trace = g_array_new (FALSE, FALSE, sizeof (TraceEntry));
+
+  for (i = 0; lines[i] != NULL; i++) {
+    TraceEntry entry = { 0, FALSE };
+    gchar *line = g_strstrip (lines[i]);
+    gchar **fields;
+    gchar *field, *end;
+
+    if (line[0] == '\0' || line[0] == '#')
+      continue;
+
+    fields = g_strsplit (line, ",", 3);
+    field = g_strstrip (fields[0]);
+    if (field[0] == '\0') {
+      entry.lost = TRUE;
+    } else {
+      gdouble delay = g_ascii_strtod (field, &end);
+
+      if (*end != '\0') {
+        g_strfreev (fields);
+        if (header_allowed) {
+          header_allowed = FALSE;
+          continue;
+        }
+        goto parse_error;
+      }
+
+      if (delay < 0)
+        entry.lost = TRUE;
+      else
+        entry.delay = delay * 1000;
+    }
+
+    if (fields[1] != NULL) {
+      field = g_strstrip (fields[1]);
+      if (field[0] != '\0') {
+        gint64 lost = g_ascii_strtoll (field, &end, 10);
+
+        if (*end != '\0') {
+          g_strfreev (fields);
+          goto parse_error;
+        }
+        entry.lost |= (lost != 0);
+      }
+    }
+    g_strfreev (fields);
+
+    header_allowed = FALSE;
+    g_array_append_val (trace, entry);
+  }
+
+  if (trace->len == 0) {
+    g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+        "Trace \"%s\" contains no packets", location);
+    goto error;
+  }
+
+  g_strfreev (lines);
+  return trace;
+
+parse_error:
+  g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_READ,
+      "Invalid trace line %u: \"%s\"", i + 1, lines[i]);
+error:
+  g_strfreev (lines);
+  g_array_unref (trace);
+  return NULL;
 }
 
-GSourceFuncs gst_net_sim_source_funcs = {
-  NULL,                         /* prepare */
-  NULL,                         /* check */
-  gst_net_sim_source_dispatch,
-  NULL                          /* finalize */
-};
+/* A delayed packet. The delay queue is a binary min-heap on the ready time,
+ * the sequence number keeps packets with the same ready time in order. */
+typedef struct
+{
+  gint64 ready_time;
+  guint64 seqnum;
+  GstBuffer *buf;
+} DelayedPacket;
+
+static inline gboolean
+delayed_packet_before (const DelayedPacket * a, const DelayedPacket * b)
+{
+  if (a->ready_time != b->ready_time)
+    return a->ready_time < b->ready_time;
+  return a->seqnum < b->seqnum;
+}
 
 static void
-gst_net_sim_loop (GstNetSim * netsim)
+delay_queue_push (GArray * queue, const DelayedPacket * packet)
 {
-  GMainLoop *loop;
+  DelayedPacket *heap;
+  guint i;
 
-  GST_TRACE_OBJECT (netsim, "TASK: begin");
+  g_array_append_val (queue, *packet);
+  heap = (DelayedPacket *) queue->data;
 
-  g_mutex_lock (&netsim->loop_mutex);
-  loop = g_main_loop_ref (netsim->main_loop);
-  netsim->running = TRUE;
-  GST_TRACE_OBJECT (netsim, "TASK: signal start");
-  g_cond_signal (&netsim->start_cond);
-  g_mutex_unlock (&netsim->loop_mutex);
+  /* sift up, this stops right away when packets come in ready time order */
+  for (i = queue->len - 1; i > 0;) {
+    guint parent = (i - 1) / 2;
+    DelayedPacket tmp;
 
-  GST_TRACE_OBJECT (netsim, "TASK: run");
-  g_main_loop_run (loop);
-  g_main_loop_unref (loop);
+    if (!delayed_packet_before (&heap[i], &heap[parent]))
+      break;
 
-  g_mutex_lock (&netsim->loop_mutex);
-  GST_TRACE_OBJECT (netsim, "TASK: pause");
-  gst_pad_pause_task (netsim->srcpad);
-  netsim->running = FALSE;
-  GST_TRACE_OBJECT (netsim, "TASK: signal end");
-  g_cond_signal (&netsim->start_cond);
-  g_mutex_unlock (&netsim->loop_mutex);
-  GST_TRACE_OBJECT (netsim, "TASK: end");
+    tmp = heap[parent];
+    heap[parent] = heap[i];
+    heap[i] = tmp;
+    i = parent;
+  }
 }
 
-static gboolean
-_main_loop_quit_and_remove_source (gpointer user_data)
+static GstBuffer *
+delay_queue_pop (GArray * queue)
+{
+  DelayedPacket *heap = (DelayedPacket *) queue->data;
+  GstBuffer *buf = heap[0].buf;
+  guint len, i;
+
+  len = queue->len - 1;
+  heap[0] = heap[len];
+  g_array_set_size (queue, len);
+
+  /* sift down */
+  for (i = 0;;) {
+    guint left = 2 * i + 1;
+    guint smallest = i;
+    DelayedPacket tmp;
+
+    if (left < len && delayed_packet_before (&heap[left], &heap[smallest]))
+      smallest = left;
+    if (left + 1 < len &&
+        delayed_packet_before (&heap[left + 1], &heap[smallest]))
+      smallest = left + 1;
+    if (smallest == i)
+      break;
+
+    tmp = heap[smallest];
+    heap[smallest] = heap[i];
+    heap[i] = tmp;
+    i = smallest;
+  }
+
+  return buf;
+}
+
+static void
+delay_queue_clear (GArray * queue)
 {
-  GMainLoop *main_loop = user_data;
-  GST_DEBUG ("MAINLOOP: Quit %p", main_loop);
-  g_main_loop_quit (main_loop);
-  g_assert (!g_main_loop_is_running (main_loop));
-  return FALSE;                 /* Remove source */
+  guint i;
+
+  for (i = 0; i < queue->len; i++)
+    gst_buffer_unref (g_array_index (queue, DelayedPacket, i).buf);
+  g_array_set_size (queue, 0);
+}
+
+/* Single timer thread for all delayed packets: sleeps until the head of the
+ * delay queue is due, then pushes everything that is due in one go */
+static void
+gst_net_sim_loop (GstNetSim * netsim)
+{
+  GArray *queue = netsim->delay_queue;
+  gint64 now;
+  guint i;
+
+  g_mutex_lock (&netsim->loop_mutex);
+  while (netsim->running) {
+    gint64 ready_time;
+
+    if (queue->len == 0) {
+      g_cond_wait (&netsim->queue_cond, &netsim->loop_mutex);
+      continue;
+    }
+
+    ready_time = g_array_index (queue, DelayedPacket, 0).ready_time;
+    if (ready_time <= g_get_monotonic_time ())
+      break;
+
+    g_cond_wait_until (&netsim->queue_cond, &netsim->loop_mutex, ready_time);
+  }
+
+  if (!netsim->running) {
+    GST_TRACE_OBJECT (netsim, "TASK: pause");
+    gst_pad_pause_task (netsim->srcpad);
+    netsim->task_paused = TRUE;
+    g_cond_signal (&netsim->start_cond);
+    g_mutex_unlock (&netsim->loop_mutex);
+    return;
+  }
+
+  now = g_get_monotonic_time ();
+  while (queue->len > 0 &&
+      g_array_index (queue, DelayedPacket, 0).ready_time <= now)
+    g_ptr_array_add (netsim->due_buffers, delay_queue_pop (queue));
+  g_mutex_unlock (&netsim->loop_mutex);
+
+  GST_LOG_OBJECT (netsim, "Pushing %u delayed buffers",
+      netsim->due_buffers->len);
+  /* gst_pad_push() takes ownership of the buffers */
+  for (i = 0; i < netsim->due_buffers->len; i++) {
+    GstFlowReturn ret = gst_pad_push (netsim->srcpad,
+        g_ptr_array_index (netsim->due_buffers, i));
+
+    if (ret != GST_FLOW_OK)
+      GST_DEBUG_OBJECT (netsim, "Delayed push returned %s",
+          gst_flow_get_name (ret));
+  }
+  g_ptr_array_set_size (netsim->due_buffers, 0);
 }
 
 static gboolean
@@ -158,48 +369,29 @@ gst_net_sim_src_activatemode (GstPad * pad, GstObject * parent,
 
   g_mutex_lock (&netsim->loop_mutex);
   if (active) {
-    if (netsim->main_loop == NULL) {
-      GMainContext *main_context = g_main_context_new ();
-      netsim->main_loop = g_main_loop_new (main_context, FALSE);
-      g_main_context_unref (main_context);
-
+    if (!netsim->running) {
       GST_TRACE_OBJECT (netsim, "ACT: Starting task on srcpad");
+      netsim->running = TRUE;
+      netsim->task_paused = FALSE;
       result = gst_pad_start_task (netsim->srcpad,
           (GstTaskFunction) gst_net_sim_loop, netsim, NULL);
-
-      GST_TRACE_OBJECT (netsim, "ACT: Wait for task to start");
-      g_assert (!netsim->running);
-      while (!netsim->running)
-        g_cond_wait (&netsim->start_cond, &netsim->loop_mutex);
-      GST_TRACE_OBJECT (netsim, "ACT: Task on srcpad started");
+      netsim->running = result;
     }
   } else {
-    if (netsim->main_loop != NULL) {
-      GSource *source;
-      guint id;
-
-      /* Adds an Idle Source which quits the main loop from within.
-       * This removes the possibility for run/quit race conditions. */
-      GST_TRACE_OBJECT (netsim, "DEACT: Stopping main loop on deactivate");
-      source = g_idle_source_new ();
-      g_source_set_callback (source, _main_loop_quit_and_remove_source,
-          g_main_loop_ref (netsim->main_loop),
-          (GDestroyNotify) g_main_loop_unref);
-      id = g_source_attach (source,
-          g_main_loop_get_context (netsim->main_loop));
-      g_source_unref (source);
-      g_assert_cmpuint (id, >, 0);
-      g_main_loop_unref (netsim->main_loop);
-      netsim->main_loop = NULL;
-
-      GST_TRACE_OBJECT (netsim, "DEACT: Wait for mainloop and task to pause");
-      g_assert (netsim->running);
-      while (netsim->running)
+    if (netsim->running) {
+      /* Let the task pause itself before stopping it, so that its pause
+       * can't race with the stop */
+      GST_TRACE_OBJECT (netsim, "DEACT: Wait for task to pause");
+      netsim->running = FALSE;
+      g_cond_signal (&netsim->queue_cond);
+      while (!netsim->task_paused)
         g_cond_wait (&netsim->start_cond, &netsim->loop_mutex);
 
       GST_TRACE_OBJECT (netsim, "DEACT: Stopping task on srcpad");
       result = gst_pad_stop_task (netsim->srcpad);
-      GST_TRACE_OBJECT (netsim, "DEACT: Mainloop and GstTask stopped");
+      delay_queue_clear (netsim->delay_queue);
+      netsim->last_ready_time = 0;
+      GST_TRACE_OBJECT (netsim, "DEACT: GstTask stopped");
     }
   }
   g_mutex_unlock (&netsim->loop_mutex);
@@ -207,39 +399,6 @@ gst_net_sim_src_activatemode (GstPad * pad, GstObject * parent,
   return result;
 }
 
-typedef struct
-{
-  GstPad *pad;
-  GstBuffer *buf;
-} PushBufferCtx;
-
-static inline PushBufferCtx *
-push_buffer_ctx_new (GstPad * pad, GstBuffer * buf)
-{
-  PushBufferCtx *ctx = g_slice_new (PushBufferCtx);
-  ctx->pad = gst_object_ref (pad);
-  ctx->buf = gst_buffer_ref (buf);
-  return ctx;
-}
-
-static inline void
-push_buffer_ctx_free (PushBufferCtx * ctx)
-{
-  if (G_LIKELY (ctx != NULL)) {
-    gst_buffer_unref (ctx->buf);
-    gst_object_unref (ctx->pad);
-    g_slice_free (PushBufferCtx, ctx);
-  }
-}
-
-static gboolean
-push_buffer_ctx_push (PushBufferCtx * ctx)
-{
-  GST_DEBUG_OBJECT (ctx->pad, "Pushing buffer now");
-  gst_pad_push (ctx->pad, gst_buffer_ref (ctx->buf));
-  return FALSE;
-}
-
 static gint
 get_random_value_uniform (GRand * rand_seed, gint32 min_value, gint32 max_value)
 {
@@ -328,63 +487,126 @@ get_random_value_gamma (GRand * rand_seed, gint32 low, gint32 high,
   return round (x + low);
 }
 
+/* Returns the delay in microseconds, or -1 if the buffer isn't delayed */
+static gint64
+gst_net_sim_get_delay (GstNetSim * netsim)
+{
+  gint delay;
+
+  if (netsim->delay_probability <= 0 ||
+      g_rand_double (netsim->rand_seed) >= netsim->delay_probability)
+    return -1;
+
+  switch (netsim->delay_distribution) {
+    case DISTRIBUTION_UNIFORM:
+      delay = get_random_value_uniform (netsim->rand_seed, netsim->min_delay,
+          netsim->max_delay);
+      break;
+    case DISTRIBUTION_NORMAL:
+      delay = get_random_value_normal (netsim->rand_seed, netsim->min_delay,
+          netsim->max_delay, &netsim->delay_state);
+      break;
+    case DISTRIBUTION_GAMMA:
+      delay = get_random_value_gamma (netsim->rand_seed, netsim->min_delay,
+          netsim->max_delay, &netsim->delay_state);
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+
+  if (delay < 0)
+    delay = 0;
+
+  return (gint64) delay * 1000;
+}
+
 static GstFlowReturn
-gst_net_sim_delay_buffer (GstNetSim * netsim, GstBuffer * buf)
+gst_net_sim_delay_buffer (GstNetSim * netsim, GstBuffer * buf, gint64 delay)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
+  DelayedPacket packet;
+  gint64 now_time;
 
-  g_mutex_lock (&netsim->loop_mutex);
-  if (netsim->main_loop != NULL && netsim->delay_probability > 0 &&
-      g_rand_double (netsim->rand_seed) < netsim->delay_probability) {
-    gint delay;
-    PushBufferCtx *ctx;
-    GSource *source;
-    gint64 ready_time, now_time;
-
-    switch (netsim->delay_distribution) {
-      case DISTRIBUTION_UNIFORM:
-        delay = get_random_value_uniform (netsim->rand_seed, netsim->min_delay,
-            netsim->max_delay);
-        break;
-      case DISTRIBUTION_NORMAL:
-        delay = get_random_value_normal (netsim->rand_seed, netsim->min_delay,
-            netsim->max_delay, &netsim->delay_state);
-        break;
-      case DISTRIBUTION_GAMMA:
-        delay = get_random_value_gamma (netsim->rand_seed, netsim->min_delay,
-            netsim->max_delay, &netsim->delay_state);
-        break;
-      default:
-        g_assert_not_reached ();
-        break;
-    }
+  if (delay < 0)
+    return gst_pad_push (netsim->srcpad, gst_buffer_ref (buf));
 
-    if (delay < 0)
-      delay = 0;
+  g_mutex_lock (&netsim->loop_mutex);
+  if (!netsim->running) {
+    g_mutex_unlock (&netsim->loop_mutex);
+    return GST_FLOW_FLUSHING;
+  }
 
-    ctx = push_buffer_ctx_new (netsim->srcpad, buf);
+  now_time = g_get_monotonic_time ();
+  packet.ready_time = now_time + delay;
+  if (!netsim->allow_reordering && packet.ready_time < netsim->last_ready_time)
+    packet.ready_time = netsim->last_ready_time + 1;
+  packet.seqnum = netsim->queue_seqnum++;
+  packet.buf = gst_buffer_ref (buf);
+
+  netsim->last_ready_time = packet.ready_time;
+  GST_DEBUG_OBJECT (netsim, "Delaying packet by %" G_GINT64_FORMAT "ms",
+      (packet.ready_time - now_time) / 1000);
+
+  delay_queue_push (netsim->delay_queue, &packet);
+  /* only wake up the timer thread if it has to wait less now */
+  if (g_array_index (netsim->delay_queue, DelayedPacket, 0).seqnum ==
+      packet.seqnum)
+    g_cond_signal (&netsim->queue_cond);
+  g_mutex_unlock (&netsim->loop_mutex);
 
-    source = g_source_new (&gst_net_sim_source_funcs, sizeof (GSource));
-    now_time = g_get_monotonic_time ();
-    ready_time = now_time + delay * 1000;
-    if (!netsim->allow_reordering && ready_time < netsim->last_ready_time)
-      ready_time = netsim->last_ready_time + 1;
+  return GST_FLOW_OK;
+}
 
-    netsim->last_ready_time = ready_time;
-    GST_DEBUG_OBJECT (netsim, "Delaying packet by %" G_GINT64_FORMAT "ms",
-        (ready_time - now_time) / 1000);
+/* Gilbert-Elliott: a two state Markov chain, with its own loss probability
+ * in each state, to simulate bursty loss */
+static gboolean
+gst_net_sim_gilbert_elliott_drop (GstNetSim * netsim)
+{
+  gfloat loss;
 
-    g_source_set_ready_time (source, ready_time);
-    g_source_set_callback (source, (GSourceFunc) push_buffer_ctx_push,
-        ctx, (GDestroyNotify) push_buffer_ctx_free);
-    g_source_attach (source, g_main_loop_get_context (netsim->main_loop));
-    g_source_unref (source);
+  if (netsim->ge_bad_state) {
+    if (g_rand_double (netsim->rand_seed) < netsim->ge_bad_to_good)
+      netsim->ge_bad_state = FALSE;
   } else {
-    ret = gst_pad_push (netsim->srcpad, gst_buffer_ref (buf));
+    if (g_rand_double (netsim->rand_seed) < netsim->ge_good_to_bad)
+      netsim->ge_bad_state = TRUE;
   }
-  g_mutex_unlock (&netsim->loop_mutex);
 
-  return ret;
+  loss = netsim->ge_bad_state ? netsim->ge_bad_loss : netsim->ge_good_loss;
+
+  return loss > 0 && g_rand_double (netsim->rand_seed) < (gdouble) loss;
+}
+
+static gboolean
+gst_net_sim_drop_buffer (GstNetSim * netsim)
+{
+  switch (netsim->loss_model) {
+    case LOSS_MODEL_BERNOULLI:
+      return netsim->drop_probability > 0 &&
+          g_rand_double (netsim->rand_seed) <
+          (gdouble) netsim->drop_probability;
+    case LOSS_MODEL_GILBERT_ELLIOTT:
+      return gst_net_sim_gilbert_elliott_drop (netsim);
+    default:
+      g_assert_not_reached ();
+      return FALSE;
+  }
+}
+
+static const TraceEntry *
+gst_net_sim_next_trace_entry (GstNetSim * netsim)
+{
+  const TraceEntry *entry;
+
+  if (netsim->trace_pos == netsim->trace->len) {
+    GST_DEBUG_OBJECT (netsim, "End of trace, starting over");
+    netsim->trace_pos = 0;
+  }
+
+  entry = &g_array_index (netsim->trace, TraceEntry, netsim->trace_pos);
+  netsim->trace_pos++;
+
+  return entry;
 }
 
 static gint
@@ -475,6 +697,8 @@ gst_net_sim_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
   GstNetSim *netsim = GST_NET_SIM (parent);
   GstFlowReturn ret = GST_FLOW_OK;
+  gboolean drop;
+  gint64 delay = -1;
 
   if (!gst_net_sim_token_bucket (netsim, buf))
     goto done;
@@ -483,25 +707,93 @@ gst_net_sim_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
     netsim->drop_packets--;
     GST_DEBUG_OBJECT (netsim, "Dropping packet (%d left)",
         netsim->drop_packets);
-  } else if (netsim->drop_probability > 0
-      && g_rand_double (netsim->rand_seed) <
-      (gdouble) netsim->drop_probability) {
+    goto done;
+  }
+
+  if (netsim->trace) {
+    const TraceEntry *entry = gst_net_sim_next_trace_entry (netsim);
+
+    drop = entry->lost;
+    delay = entry->delay;
+  } else {
+    drop = gst_net_sim_drop_buffer (netsim);
+  }
+
+  if (drop) {
     GST_DEBUG_OBJECT (netsim, "Dropping packet");
-  } else if (netsim->duplicate_probability > 0 &&
+    goto done;
+  }
+
+  if (netsim->duplicate_probability > 0 &&
       g_rand_double (netsim->rand_seed) <
       (gdouble) netsim->duplicate_probability) {
     GST_DEBUG_OBJECT (netsim, "Duplicating packet");
-    gst_net_sim_delay_buffer (netsim, buf);
-    ret = gst_net_sim_delay_buffer (netsim, buf);
-  } else {
-    ret = gst_net_sim_delay_buffer (netsim, buf);
+    gst_net_sim_delay_buffer (netsim, buf,
+        netsim->trace ? delay : gst_net_sim_get_delay (netsim));
   }
 
+  ret = gst_net_sim_delay_buffer (netsim, buf,
+      netsim->trace ? delay : gst_net_sim_get_delay (netsim));
+
 done:
   gst_buffer_unref (buf);
   return ret;
 }
 
+static gboolean
+gst_net_sim_start (GstNetSim * netsim)
+{
+  if (netsim->trace_location != NULL) {
+    GError *err = NULL;
+
+    netsim->trace = gst_net_sim_load_trace (netsim->trace_location, &err);
+    if (netsim->trace == NULL) {
+      GST_ELEMENT_ERROR (netsim, RESOURCE, OPEN_READ,
+          ("Could not load trace \"%s\"", netsim->trace_location),
+          ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+    GST_INFO_OBJECT (netsim, "Replaying trace of %u packets",
+        netsim->trace->len);
+  }
+  netsim->trace_pos = 0;
+
+  if (netsim->seed != 0)
+    g_rand_set_seed (netsim->rand_seed, netsim->seed);
+  netsim->ge_bad_state = FALSE;
+
+  return TRUE;
+}
+
+static GstStateChangeReturn
+gst_net_sim_change_state (GstElement * element, GstStateChange transition)
+{
+  GstNetSim *netsim = GST_NET_SIM (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_net_sim_start (netsim))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_net_sim_parent_class)->change_state (element,
+      transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      g_clear_pointer (&netsim->trace, g_array_unref);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
 
 static void
 gst_net_sim_set_property (GObject * object,
@@ -542,6 +834,28 @@ gst_net_sim_set_property (GObject * object,
     case PROP_ALLOW_REORDERING:
       netsim->allow_reordering = g_value_get_boolean (value);
       break;
+    case PROP_LOSS_MODEL:
+      netsim->loss_model = g_value_get_enum (value);
+      break;
+    case PROP_GE_GOOD_TO_BAD:
+      netsim->ge_good_to_bad = g_value_get_float (value);
+      break;
+    case PROP_GE_BAD_TO_GOOD:
+      netsim->ge_bad_to_good = g_value_get_float (value);
+      break;
+    case PROP_GE_GOOD_LOSS:
+      netsim->ge_good_loss = g_value_get_float (value);
+      break;
+    case PROP_GE_BAD_LOSS:
+      netsim->ge_bad_loss = g_value_get_float (value);
+      break;
+    case PROP_TRACE_LOCATION:
+      g_free (netsim->trace_location);
+      netsim->trace_location = g_value_dup_string (value);
+      break;
+    case PROP_SEED:
+      netsim->seed = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -585,6 +899,27 @@ gst_net_sim_get_property (GObject * object,
     case PROP_ALLOW_REORDERING:
       g_value_set_boolean (value, netsim->allow_reordering);
       break;
+    case PROP_LOSS_MODEL:
+      g_value_set_enum (value, netsim->loss_model);
+      break;
+    case PROP_GE_GOOD_TO_BAD:
+      g_value_set_float (value, netsim->ge_good_to_bad);
+      break;
+    case PROP_GE_BAD_TO_GOOD:
+      g_value_set_float (value, netsim->ge_bad_to_good);
+      break;
+    case PROP_GE_GOOD_LOSS:
+      g_value_set_float (value, netsim->ge_good_loss);
+      break;
+    case PROP_GE_BAD_LOSS:
+      g_value_set_float (value, netsim->ge_bad_loss);
+      break;
+    case PROP_TRACE_LOCATION:
+      g_value_set_string (value, netsim->trace_location);
+      break;
+    case PROP_SEED:
+      g_value_set_uint (value, netsim->seed);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -605,8 +940,10 @@ gst_net_sim_init (GstNetSim * netsim)
 
   g_mutex_init (&netsim->loop_mutex);
   g_cond_init (&netsim->start_cond);
+  g_cond_init (&netsim->queue_cond);
+  netsim->delay_queue = g_array_new (FALSE, FALSE, sizeof (DelayedPacket));
+  netsim->due_buffers = g_ptr_array_new ();
   netsim->rand_seed = g_rand_new ();
-  netsim->main_loop = NULL;
   netsim->prev_time = GST_CLOCK_TIME_NONE;
 
   GST_OBJECT_FLAG_SET (netsim->sinkpad,
@@ -624,8 +961,12 @@ gst_net_sim_finalize (GObject * object)
   GstNetSim *netsim = GST_NET_SIM (object);
 
   g_rand_free (netsim->rand_seed);
+  g_array_unref (netsim->delay_queue);
+  g_ptr_array_unref (netsim->due_buffers);
+  g_free (netsim->trace_location);
   g_mutex_clear (&netsim->loop_mutex);
   g_cond_clear (&netsim->start_cond);
+  g_cond_clear (&netsim->queue_cond);
 
   G_OBJECT_CLASS (gst_net_sim_parent_class)->finalize (object);
 }
@@ -635,7 +976,7 @@ gst_net_sim_dispose (GObject * object)
 {
   GstNetSim *netsim = GST_NET_SIM (object);
 
-  g_assert (netsim->main_loop == NULL);
+  g_assert (!netsim->running);
 
   G_OBJECT_CLASS (gst_net_sim_parent_class)->dispose (object);
 }
@@ -662,6 +1003,9 @@ gst_net_sim_class_init (GstNetSimClass * klass)
   gobject_class->dispose = GST_DEBUG_FUNCPTR (gst_net_sim_dispose);
   gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_net_sim_finalize);
 
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_net_sim_change_state);
+
   gobject_class->set_property = gst_net_sim_set_property;
   gobject_class->get_property = gst_net_sim_get_property;
 
@@ -757,9 +1101,114 @@ gst_net_sim_class_init (GstNetSimClass * klass)
           DEFAULT_ALLOW_REORDERING,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstNetSim:loss-model:
+   *
+   * How packets are dropped. "bernoulli" drops each packet independently
+   * with "drop-probability", "gilbert-elliott" simulates bursty loss with
+   * the "ge-*" properties.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_LOSS_MODEL,
+      g_param_spec_enum ("loss-model", "Loss Model",
+          "How packets are dropped",
+          loss_model_get_type (), DEFAULT_LOSS_MODEL,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstNetSim:ge-good-to-bad:
+   *
+   * Gilbert-Elliott model: the probability to go from the good to the bad
+   * state for each packet.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_GE_GOOD_TO_BAD,
+      g_param_spec_float ("ge-good-to-bad", "Good to Bad Probability",
+          "Gilbert-Elliott probability to go from the good to the bad state",
+          0.0, 1.0, DEFAULT_GE_GOOD_TO_BAD,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstNetSim:ge-bad-to-good:
+   *
+   * Gilbert-Elliott model: the probability to go from the bad back to the
+   * good state for each packet. The mean burst length is the inverse of it.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_GE_BAD_TO_GOOD,
+      g_param_spec_float ("ge-bad-to-good", "Bad to Good Probability",
+          "Gilbert-Elliott probability to go from the bad to the good state",
+          0.0, 1.0, DEFAULT_GE_BAD_TO_GOOD,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstNetSim:ge-good-loss:
+   *
+   * Gilbert-Elliott model: the probability a packet is dropped in the good
+   * state.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_GE_GOOD_LOSS,
+      g_param_spec_float ("ge-good-loss", "Good State Loss",
+          "Gilbert-Elliott probability a buffer is dropped in the good state",
+          0.0, 1.0, DEFAULT_GE_GOOD_LOSS,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstNetSim:ge-bad-loss:
+   *
+   * Gilbert-Elliott model: the probability a packet is dropped in the bad
+   * state.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_GE_BAD_LOSS,
+      g_param_spec_float ("ge-bad-loss", "Bad State Loss",
+          "Gilbert-Elliott probability a buffer is dropped in the bad state",
+          0.0, 1.0, DEFAULT_GE_BAD_LOSS,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstNetSim:trace-location:
+   *
+   * A recorded trace to replay, in CSV format with one "delay_ms,lost" line
+   * per packet. An empty or negative delay also means the packet was lost.
+   * When set, the trace decides the delay and loss of every packet instead
+   * of the random delay and loss settings, and is started over once the
+   * end is reached.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_TRACE_LOCATION,
+      g_param_spec_string ("trace-location", "Trace Location",
+          "CSV file with the delay and loss of each packet to replay",
+          DEFAULT_TRACE_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstNetSim:seed:
+   *
+   * Seed for the random number generator, applied when going to PAUSED, so
+   * that runs can be reproduced.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_SEED,
+      g_param_spec_uint ("seed", "Seed",
+          "Random number generator seed (0 = random)",
+          0, G_MAXUINT, DEFAULT_SEED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   GST_DEBUG_CATEGORY_INIT (netsim_debug, "netsim", 0, "Network simulator");
 
   gst_type_mark_as_plugin_api (distribution_get_type (), 0);
+  gst_type_mark_as_plugin_api (loss_model_get_type (), 0);
 }
 
 static gboolean
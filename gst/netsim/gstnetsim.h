@@ -53,6 +53,12 @@ typedef enum
   DISTRIBUTION_GAMMA
 } GstNetSimDistribution;
 
+typedef enum
+{
+  LOSS_MODEL_BERNOULLI,
+  LOSS_MODEL_GILBERT_ELLIOTT
+} GstNetSimLossModel;
+
 typedef struct
 {
   gboolean generate;
@@ -69,13 +75,20 @@ struct _GstNetSim
 
   GMutex loop_mutex;
   GCond start_cond;
-  GMainLoop *main_loop;
+  GCond queue_cond;
   gboolean running;
+  gboolean task_paused;
+  GArray *delay_queue;
+  guint64 queue_seqnum;
+  GPtrArray *due_buffers;
   GRand *rand_seed;
   gsize bucket_size;
   GstClockTime prev_time;
   NormalDistributionState delay_state;
   gint64 last_ready_time;
+  gboolean ge_bad_state;
+  GArray *trace;
+  guint trace_pos;
 
   /* properties */
   gint min_delay;
@@ -88,6 +101,13 @@ struct _GstNetSim
   gint max_kbps;
   gint max_bucket_size;
   gboolean allow_reordering;
+  GstNetSimLossModel loss_model;
+  gfloat ge_good_to_bad;
+  gfloat ge_bad_to_good;
+  gfloat ge_good_loss;
+  gfloat ge_bad_loss;
+  gchar *trace_location;
+  guint seed;
 };
 
 struct _GstNetSimClass
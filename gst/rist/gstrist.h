@@ -77,10 +77,26 @@ typedef struct {
 GType gst_rist_rtp_deext_get_type (void);
 GST_ELEMENT_REGISTER_DECLARE (ristrtpdeext);
 
+#define GST_TYPE_RIST_DISPATCHER    (gst_rist_dispatcher_get_type())
+#define GST_RIST_DISPATCHER(obj)    (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_RIST_DISPATCHER,GstRistDispatcher))
+typedef struct _GstRistDispatcher GstRistDispatcher;
+typedef struct {
+  GstElementClass parent;
+} GstRistDispatcherClass;
+GType gst_rist_dispatcher_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (ristdispatcher);
+
 guint32 gst_rist_rtp_ext_seq (guint32 * extseqnum, guint16 seqnum);
 
 void gst_rist_rtx_send_set_extseqnum (GstRistRtxSend *self, guint32 ssrc,
     guint16 seqnum_ext);
 void gst_rist_rtx_send_clear_extseqnum (GstRistRtxSend *self, guint32 ssrc);
 
+/* Called with each retransmission packet before it is sent */
+typedef void (*GstRistRtxSendRtxFunc) (GstRistRtxSend *self, GstBuffer *rtx_buf,
+    gpointer user_data);
+void gst_rist_rtx_send_set_rtx_func (GstRistRtxSend *self,
+    GstRistRtxSendRtxFunc func, gpointer user_data);
+void gst_rist_rtx_send_push_rtx (GstRistRtxSend *self, GstBuffer *rtx_buf);
+
 #endif
@@ -0,0 +1,650 @@
+/* GStreamer RIST plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-ristdispatcher
+ * @title: ristdispatcher
+ *
+ * This element distributes RTP packets over multiple src pads, like
+ * roundrobin, but in proportion to a weight computed for each pad from
+ * link reports. It is used by ristsink for the "weighted" bonding method.
+ *
+ * Each report gives, for one src pad, the round trip time and the extended
+ * highest sequence number and cumulative number of lost packets from an
+ * RTCP report block of that link. As the dispatcher knows which sequence
+ * numbers it sent over each pad, this gives the actual loss of the link.
+ * A lossy link is past its available bitrate: that bitrate is estimated from
+ * the bytes it delivered since the previous report, and its share backs off
+ * to that bitrate relative to the incoming one. Clean links are probed with
+ * a growing share, the faster the shorter their round trip time. Every pad
+ * keeps a small share so that it keeps being measured.
+ *
+ * Packets that are not marked as delta units are duplicated over all the
+ * pads, once upstream has been seen marking delta units.
+ *
+ * Since: 1.20
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstrist.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_rist_dispatcher_debug);
+#define GST_CAT_DEFAULT gst_rist_dispatcher_debug
+
+/* Loss above which a link is considered saturated */
+#define LOSS_THRESHOLD 0.02
+/* Share added to a clean link on each report, scaled by its relative
+ * round trip time */
+#define PROBE_STEP 0.05
+/* Share of the packets every link gets, whatever its quality */
+#define MIN_SHARE 0.02
+/* Links that have not reported for that long are considered dead */
+#define LINK_TIMEOUT (5 * G_USEC_PER_SEC)
+
+#define DEFAULT_DUPLICATE_KEYFRAMES TRUE
+
+enum
+{
+  PROP_0,
+  PROP_DUPLICATE_KEYFRAMES,
+};
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_WEIGHT,
+  PROP_PAD_BITRATE,
+};
+
+enum
+{
+  SIGNAL_REPORT_LINK,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static GstStaticPadTemplate sink_templ = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GstStaticPadTemplate src_templ = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+/* All fields are protected by the object lock of the element */
+typedef struct
+{
+  GstPad parent;
+
+  /* Smooth weighted round robin state, weights sum up to 1 */
+  gdouble weight;
+  gdouble current;
+
+  /* Share the link should get according to the reports */
+  gdouble target;
+  gdouble loss;
+  GstClockTime rtt;
+  /* Estimated available bitrate in bits per second, 0 if unknown */
+  guint64 bitrate;
+
+  /* Bytes sent over this pad */
+  guint64 bytes_sent;
+
+  /* State at the last report */
+  gboolean have_report;
+  guint32 last_ext_seqnum;
+  gint32 last_lost;
+  gint64 last_report_time;
+  GstClockTime last_report_clock_time;
+  guint64 last_bytes_sent;
+  guint64 last_bytes_received;
+
+  /* One bit per RTP seqnum, set if the packet was sent on this pad */
+  guint32 sent[65536 / 32];
+} GstRistDispatcherPad;
+
+typedef GstPadClass GstRistDispatcherPadClass;
+
+static GType gst_rist_dispatcher_pad_get_type (void);
+G_DEFINE_TYPE (GstRistDispatcherPad, gst_rist_dispatcher_pad, GST_TYPE_PAD);
+
+struct _GstRistDispatcher
+{
+  GstElement parent;
+
+  gboolean duplicate_keyframes;
+  gboolean seen_delta_unit;
+
+  /* Bytes received on the sink pad, protected by the object lock */
+  guint64 bytes_received;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GstRistDispatcher, gst_rist_dispatcher,
+    GST_TYPE_ELEMENT, GST_DEBUG_CATEGORY_INIT (gst_rist_dispatcher_debug,
+        "ristdispatcher", 0, "RIST Weighted Dispatcher"));
+GST_ELEMENT_REGISTER_DEFINE (ristdispatcher, "ristdispatcher", GST_RANK_NONE,
+    GST_TYPE_RIST_DISPATCHER);
+
+static void
+gst_rist_dispatcher_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRistDispatcherPad *pad = (GstRistDispatcherPad *) object;
+  GstObject *parent = gst_object_get_parent (GST_OBJECT (pad));
+
+  if (parent)
+    GST_OBJECT_LOCK (parent);
+
+  switch (prop_id) {
+    case PROP_PAD_WEIGHT:
+      g_value_set_double (value, pad->weight);
+      break;
+    case PROP_PAD_BITRATE:
+      g_value_set_uint64 (value, pad->bitrate);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  if (parent) {
+    GST_OBJECT_UNLOCK (parent);
+    gst_object_unref (parent);
+  }
+}
+
+static void
+gst_rist_dispatcher_pad_init (GstRistDispatcherPad * pad)
+{
+  pad->weight = 1.0;
+  pad->target = 1.0;
+  pad->rtt = GST_CLOCK_TIME_NONE;
+  pad->last_report_clock_time = GST_CLOCK_TIME_NONE;
+}
+
+static void
+gst_rist_dispatcher_pad_class_init (GstRistDispatcherPadClass * klass)
+{
+  GObjectClass *object_class = (GObjectClass *) klass;
+
+  object_class->get_property = gst_rist_dispatcher_pad_get_property;
+
+  g_object_class_install_property (object_class, PROP_PAD_WEIGHT,
+      g_param_spec_double ("weight", "Weight",
+          "Share of the packets currently sent over this pad", 0.0, 1.0, 1.0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_PAD_BITRATE,
+      g_param_spec_uint64 ("bitrate", "Bitrate",
+          "Estimated available bitrate of the link in bits per second "
+          "(0 = unknown)", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+/* called with the object lock */
+static void
+gst_rist_dispatcher_mark_sent (GstRistDispatcher * disp,
+    GstRistDispatcherPad * target, guint16 seqnum, gsize size)
+{
+  guint32 bit = 1U << (seqnum & 31);
+  GList *l;
+
+  for (l = GST_ELEMENT (disp)->srcpads; l; l = l->next) {
+    GstRistDispatcherPad *pad = l->data;
+
+    if (target == NULL || pad == target) {
+      pad->sent[seqnum >> 5] |= bit;
+      pad->bytes_sent += size;
+    } else {
+      pad->sent[seqnum >> 5] &= ~bit;
+    }
+
+    /* Start the timeout when the pad gets its first packet */
+    if ((target == NULL || pad == target) && pad->last_report_time == 0)
+      pad->last_report_time = g_get_monotonic_time ();
+  }
+}
+
+static guint
+gst_rist_dispatcher_pad_count_sent (GstRistDispatcherPad * pad,
+    guint32 first, guint32 count)
+{
+  guint n = 0;
+  guint32 i;
+
+  for (i = 0; i < count; i++) {
+    guint16 seqnum = first + i;
+    n += (pad->sent[seqnum >> 5] >> (seqnum & 31)) & 1;
+  }
+
+  return n;
+}
+
+/* Smooth weighted round robin: each pad accumulates its weight, the one
+ * with the largest credit is picked and pays for the total.
+ * Called with the object lock */
+static GstRistDispatcherPad *
+gst_rist_dispatcher_select_pad (GstRistDispatcher * disp)
+{
+  GstRistDispatcherPad *best = NULL;
+  gdouble total = 0.0;
+  GList *l;
+
+  for (l = GST_ELEMENT (disp)->srcpads; l; l = l->next) {
+    GstRistDispatcherPad *pad = l->data;
+
+    pad->current += pad->weight;
+    total += pad->weight;
+    if (!best || pad->current > best->current)
+      best = pad;
+  }
+
+  if (best)
+    best->current -= total;
+
+  return best;
+}
+
+/* called with the object lock */
+static void
+gst_rist_dispatcher_update_weights (GstRistDispatcher * disp)
+{
+  gdouble total = 0.0, sum = 0.0;
+  GList *l;
+
+  for (l = GST_ELEMENT (disp)->srcpads; l; l = l->next) {
+    GstRistDispatcherPad *pad = l->data;
+
+    total += pad->target;
+  }
+
+  if (total <= 0.0)
+    total = 1.0;
+
+  /* Keep every link measured, then normalize */
+  for (l = GST_ELEMENT (disp)->srcpads; l; l = l->next) {
+    GstRistDispatcherPad *pad = l->data;
+
+    pad->target /= total;
+    pad->weight = MAX (pad->target, MIN_SHARE);
+    sum += pad->weight;
+  }
+
+  for (l = GST_ELEMENT (disp)->srcpads; l; l = l->next) {
+    GstRistDispatcherPad *pad = l->data;
+
+    pad->weight /= sum;
+    GST_LOG_OBJECT (pad, "weight %f (loss %f, rtt %" GST_TIME_FORMAT
+        ", bitrate %" G_GUINT64_FORMAT ")", pad->weight, pad->loss,
+        GST_TIME_ARGS (pad->rtt), pad->bitrate);
+  }
+}
+
+/* called with the object lock */
+static GstClockTime
+gst_rist_dispatcher_min_rtt (GstRistDispatcher * disp)
+{
+  GstClockTime min_rtt = GST_CLOCK_TIME_NONE;
+  GList *l;
+
+  for (l = GST_ELEMENT (disp)->srcpads; l; l = l->next) {
+    GstRistDispatcherPad *pad = l->data;
+
+    if (GST_CLOCK_TIME_IS_VALID (pad->rtt) && pad->rtt > 0)
+      min_rtt = MIN (min_rtt, pad->rtt);
+  }
+
+  return min_rtt;
+}
+
+/* Reports are timed with the clock of the pipeline when there is one, so
+ * that bitrates match the running time of the stream */
+static GstClockTime
+gst_rist_dispatcher_get_time (GstRistDispatcher * disp)
+{
+  GstClock *clock = gst_element_get_clock (GST_ELEMENT (disp));
+  GstClockTime now;
+
+  if (!clock)
+    return g_get_monotonic_time () * GST_USECOND;
+
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  return now;
+}
+
+/* called with the object lock */
+static void
+gst_rist_dispatcher_pad_update_bitrate (GstRistDispatcher * disp,
+    GstRistDispatcherPad * pad, GstClockTime now)
+{
+  GstClockTime elapsed;
+  guint64 delivered, received;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pad->last_report_clock_time)
+      || now <= pad->last_report_clock_time)
+    return;
+
+  elapsed = now - pad->last_report_clock_time;
+  delivered = (pad->bytes_sent - pad->last_bytes_sent) * (1.0 - pad->loss);
+  received = disp->bytes_received - pad->last_bytes_received;
+
+  /* What a clean link delivers is only a lower bound of what it could */
+  if (pad->loss > LOSS_THRESHOLD)
+    pad->bitrate = gst_util_uint64_scale (delivered * 8, GST_SECOND, elapsed);
+  else
+    pad->bitrate = MAX (pad->bitrate,
+        gst_util_uint64_scale (delivered * 8, GST_SECOND, elapsed));
+
+  /* Back off to the share of the incoming bitrate that got through */
+  if (pad->loss > LOSS_THRESHOLD && received > 0)
+    pad->target = (gdouble) delivered / received;
+}
+
+static void
+gst_rist_dispatcher_report_link (GstRistDispatcher * disp, GstPad * srcpad,
+    guint64 rtt, guint ext_seqnum, gint lost)
+{
+  GstRistDispatcherPad *pad = (GstRistDispatcherPad *) srcpad;
+  gint64 now = g_get_monotonic_time ();
+  GstClockTime clock_time = gst_rist_dispatcher_get_time (disp);
+  GList *l;
+
+  g_return_if_fail (GST_IS_PAD (srcpad));
+
+  GST_OBJECT_LOCK (disp);
+  if (GST_OBJECT_PARENT (srcpad) != GST_OBJECT (disp)
+      || GST_PAD_DIRECTION (srcpad) != GST_PAD_SRC) {
+    GST_OBJECT_UNLOCK (disp);
+    GST_WARNING_OBJECT (disp, "%" GST_PTR_FORMAT " is not one of our pads",
+        srcpad);
+    return;
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (rtt))
+    pad->rtt = rtt;
+
+  if (pad->have_report) {
+    guint32 expected = ext_seqnum - pad->last_ext_seqnum;
+    gint64 received = (gint64) expected - (lost - pad->last_lost);
+    guint sent = 0;
+
+    /* Ignore reordered reports and jumps we can't account for */
+    if (expected > 0 && expected < 32768)
+      sent = gst_rist_dispatcher_pad_count_sent (pad,
+          pad->last_ext_seqnum + 1, expected);
+
+    if (sent > 0) {
+      received = CLAMP (received, 0, sent);
+      pad->loss = 1.0 - (gdouble) received / sent;
+
+      if (pad->loss > LOSS_THRESHOLD) {
+        /* Back off to the share that got through, refined from the
+         * bytes that actually went over the link if possible */
+        pad->target = pad->weight * (1.0 - pad->loss);
+        gst_rist_dispatcher_pad_update_bitrate (disp, pad, clock_time);
+      } else {
+        GstClockTime min_rtt = gst_rist_dispatcher_min_rtt (disp);
+        gdouble step = PROBE_STEP;
+
+        if (GST_CLOCK_TIME_IS_VALID (min_rtt)
+            && GST_CLOCK_TIME_IS_VALID (pad->rtt) && pad->rtt > min_rtt)
+          step *= (gdouble) min_rtt / pad->rtt;
+
+        pad->target = pad->weight + step;
+        gst_rist_dispatcher_pad_update_bitrate (disp, pad, clock_time);
+      }
+    }
+  }
+
+  pad->have_report = TRUE;
+  pad->last_ext_seqnum = ext_seqnum;
+  pad->last_lost = lost;
+  pad->last_report_time = now;
+  pad->last_report_clock_time = clock_time;
+  pad->last_bytes_sent = pad->bytes_sent;
+  pad->last_bytes_received = disp->bytes_received;
+
+  /* Links that stopped reporting have most likely gone away */
+  for (l = GST_ELEMENT (disp)->srcpads; l; l = l->next) {
+    GstRistDispatcherPad *other = l->data;
+
+    if (other->last_report_time != 0
+        && now - other->last_report_time > LINK_TIMEOUT) {
+      other->target = 0.0;
+      other->loss = 1.0;
+    }
+  }
+
+  gst_rist_dispatcher_update_weights (disp);
+  GST_OBJECT_UNLOCK (disp);
+}
+
+static GstFlowReturn
+gst_rist_dispatcher_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstRistDispatcher *disp = GST_RIST_DISPATCHER (parent);
+  GstElement *elem = GST_ELEMENT (parent);
+  GstRistDispatcherPad *src_pad = NULL;
+  GList *src_pads = NULL, *l;
+  GstFlowReturn ret = GST_FLOW_NOT_LINKED;
+  gboolean have_seqnum;
+  guint8 seqnum[2];
+  gsize size;
+
+  have_seqnum = gst_buffer_extract (buffer, 2, seqnum, 2) == 2;
+  size = gst_buffer_get_size (buffer);
+
+  GST_OBJECT_LOCK (disp);
+  disp->bytes_received += size;
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    disp->seen_delta_unit = TRUE;
+  } else if (disp->duplicate_keyframes && disp->seen_delta_unit) {
+    src_pads = g_list_copy_deep (elem->srcpads, (GCopyFunc) gst_object_ref,
+        NULL);
+    if (have_seqnum)
+      gst_rist_dispatcher_mark_sent (disp, NULL, GST_READ_UINT16_BE (seqnum),
+          size);
+  }
+
+  if (!src_pads) {
+    src_pad = gst_rist_dispatcher_select_pad (disp);
+    if (src_pad) {
+      gst_object_ref (src_pad);
+      if (have_seqnum)
+        gst_rist_dispatcher_mark_sent (disp, src_pad,
+            GST_READ_UINT16_BE (seqnum), size);
+    }
+  }
+  GST_OBJECT_UNLOCK (disp);
+
+  if (src_pad) {
+    ret = gst_pad_push (GST_PAD (src_pad), buffer);
+    gst_object_unref (src_pad);
+    return ret;
+  }
+
+  if (!src_pads) {
+    /* no pad, that's fine */
+    gst_buffer_unref (buffer);
+    return GST_FLOW_OK;
+  }
+
+  GST_LOG_OBJECT (disp, "duplicating keyframe packet over %u pads",
+      g_list_length (src_pads));
+
+  /* Succeed as long as one of the links took it */
+  for (l = src_pads; l; l = l->next) {
+    GstFlowReturn pad_ret = gst_pad_push (l->data, gst_buffer_ref (buffer));
+
+    if (ret != GST_FLOW_OK)
+      ret = pad_ret;
+  }
+  g_list_free_full (src_pads, gst_object_unref);
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static GstPad *
+gst_rist_dispatcher_request_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
+{
+  GstRistDispatcher *disp = GST_RIST_DISPATCHER (element);
+  GstPad *pad;
+
+  pad = gst_element_get_static_pad (element, name);
+  if (pad) {
+    gst_object_unref (pad);
+    return NULL;
+  }
+
+  pad = g_object_new (gst_rist_dispatcher_pad_get_type (), "name", name,
+      "direction", templ->direction, "template", templ, NULL);
+  gst_element_add_pad (element, pad);
+
+  GST_OBJECT_LOCK (disp);
+  gst_rist_dispatcher_update_weights (disp);
+  GST_OBJECT_UNLOCK (disp);
+
+  return pad;
+}
+
+static void
+gst_rist_dispatcher_release_pad (GstElement * element, GstPad * pad)
+{
+  GstRistDispatcher *disp = GST_RIST_DISPATCHER (element);
+
+  gst_element_remove_pad (element, pad);
+
+  GST_OBJECT_LOCK (disp);
+  gst_rist_dispatcher_update_weights (disp);
+  GST_OBJECT_UNLOCK (disp);
+}
+
+static void
+gst_rist_dispatcher_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRistDispatcher *disp = GST_RIST_DISPATCHER (object);
+
+  switch (prop_id) {
+    case PROP_DUPLICATE_KEYFRAMES:
+      GST_OBJECT_LOCK (disp);
+      disp->duplicate_keyframes = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (disp);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_rist_dispatcher_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRistDispatcher *disp = GST_RIST_DISPATCHER (object);
+
+  switch (prop_id) {
+    case PROP_DUPLICATE_KEYFRAMES:
+      GST_OBJECT_LOCK (disp);
+      g_value_set_boolean (value, disp->duplicate_keyframes);
+      GST_OBJECT_UNLOCK (disp);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_rist_dispatcher_init (GstRistDispatcher * disp)
+{
+  GstPad *pad;
+
+  disp->duplicate_keyframes = DEFAULT_DUPLICATE_KEYFRAMES;
+
+  gst_element_create_all_pads (GST_ELEMENT (disp));
+  pad = GST_PAD (GST_ELEMENT (disp)->sinkpads->data);
+
+  GST_PAD_SET_PROXY_CAPS (pad);
+  GST_PAD_SET_PROXY_SCHEDULING (pad);
+  /* do not proxy allocation, it requires special handling like tee does */
+
+  gst_pad_set_chain_function (pad,
+      GST_DEBUG_FUNCPTR (gst_rist_dispatcher_chain));
+}
+
+static void
+gst_rist_dispatcher_class_init (GstRistDispatcherClass * klass)
+{
+  GObjectClass *object_class = (GObjectClass *) klass;
+  GstElementClass *element_class = (GstElementClass *) klass;
+
+  object_class->set_property = gst_rist_dispatcher_set_property;
+  object_class->get_property = gst_rist_dispatcher_get_property;
+
+  gst_element_class_set_metadata (element_class,
+      "RIST Weighted Dispatcher", "Filter/Network",
+      "Distributes RTP packets over links according to their quality",
+      "The GStreamer developers <gstreamer-devel@lists.freedesktop.org>");
+
+  gst_element_class_add_static_pad_template (element_class, &sink_templ);
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &src_templ, gst_rist_dispatcher_pad_get_type ());
+
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_rist_dispatcher_request_pad);
+  element_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_rist_dispatcher_release_pad);
+
+  g_object_class_install_property (object_class, PROP_DUPLICATE_KEYFRAMES,
+      g_param_spec_boolean ("duplicate-keyframes", "Duplicate Keyframes",
+          "Send packets that are not delta units over all the links",
+          DEFAULT_DUPLICATE_KEYFRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRistDispatcher::report-link:
+   * @dispatcher: the ristdispatcher
+   * @pad: the src pad of the link
+   * @round_trip_time: the round trip time of the link, or
+   *     %GST_CLOCK_TIME_NONE if unknown
+   * @ext_seqnum: the extended highest sequence number received on the link
+   * @lost: the cumulative number of packets lost on the link, as reported
+   *     by the receiver
+   *
+   * Updates the quality estimate of a link from an RTCP report block, and
+   * re-balances the traffic over all the links.
+   */
+  signals[SIGNAL_REPORT_LINK] =
+      g_signal_new_class_handler ("report-link", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_CALLBACK (gst_rist_dispatcher_report_link), NULL, NULL, NULL,
+      G_TYPE_NONE, 4, GST_TYPE_PAD, G_TYPE_UINT64, G_TYPE_UINT, G_TYPE_INT);
+
+  gst_type_mark_as_plugin_api (gst_rist_dispatcher_pad_get_type (), 0);
+}
@@ -35,6 +35,7 @@ plugin_init (GstPlugin * plugin)
   ret |= GST_ELEMENT_REGISTER (ristrtxsend, plugin);
   ret |= GST_ELEMENT_REGISTER (ristrtxreceive, plugin);
   ret |= GST_ELEMENT_REGISTER (roundrobin, plugin);
+  ret |= GST_ELEMENT_REGISTER (ristdispatcher, plugin);
   ret |= GST_ELEMENT_REGISTER (ristrtpext, plugin);
   ret |= GST_ELEMENT_REGISTER (ristrtpdeext, plugin);
 
@@ -92,6 +92,9 @@ struct _GstRistRtxSend
   /* statistics */
   guint num_rtx_requests;
   guint num_rtx_packets;
+
+  GstRistRtxSendRtxFunc rtx_func;
+  gpointer rtx_func_data;
 };
 
 static gboolean gst_rist_rtx_send_queue_check_full (GstDataQueue * queue,
@@ -394,6 +397,8 @@ gst_rist_rtx_send_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
         guint seqnum = 0;
         guint ssrc = 0;
         GstBuffer *rtx_buf = NULL;
+        GstRistRtxSendRtxFunc rtx_func;
+        gpointer rtx_func_data;
 
         /* retrieve seqnum of the packet that need to be retransmitted */
         if (!gst_structure_get_uint (s, "seqnum", &seqnum))
@@ -457,10 +462,15 @@ gst_rist_rtx_send_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
 #endif
           }
         }
+        rtx_func = rtx->rtx_func;
+        rtx_func_data = rtx->rtx_func_data;
         GST_OBJECT_UNLOCK (rtx);
 
-        if (rtx_buf)
+        if (rtx_buf) {
+          if (rtx_func)
+            rtx_func (rtx, rtx_buf, rtx_func_data);
           gst_rist_rtx_send_push_out (rtx, rtx_buf);
+        }
 
         gst_event_unref (event);
         return TRUE;
@@ -835,3 +845,21 @@ gst_rist_rtx_send_clear_extseqnum (GstRistRtxSend * rtx, guint32 ssrc)
     data->has_seqnum_ext = FALSE;
   GST_OBJECT_UNLOCK (rtx);
 }
+
+void
+gst_rist_rtx_send_set_rtx_func (GstRistRtxSend * rtx,
+    GstRistRtxSendRtxFunc func, gpointer user_data)
+{
+  GST_OBJECT_LOCK (rtx);
+  rtx->rtx_func = func;
+  rtx->rtx_func_data = user_data;
+  GST_OBJECT_UNLOCK (rtx);
+}
+
+/* Sends a retransmission packet produced by another instance, takes
+ * ownership of @rtx_buf */
+void
+gst_rist_rtx_send_push_rtx (GstRistRtxSend * rtx, GstBuffer * rtx_buf)
+{
+  gst_rist_rtx_send_push_out (rtx, rtx_buf);
+}
@@ -51,13 +51,18 @@
  * mapped to its own RTP session. RTX request are only replied to on the
  * link the NACK was received from.
  *
- * There are currently two bonding methods in place: "broadcast" and "round-robin".
- * In "broadcast" mode, all the packets are duplicated over all sessions.
- * While in "round-robin" mode, packets are evenly distributed over the links. One
- * can also implement its own dispatcher element and configure it using the
- * "dispatcher" property. As a reference, "broadcast" mode is implemented with
- * the "tee" element, while "round-robin" mode is implemented with the
- * "round-robin" element.
+ * There are currently three bonding methods in place: "broadcast", "round-robin"
+ * and "weighted". In "broadcast" mode, all the packets are duplicated over all
+ * sessions. While in "round-robin" mode, packets are evenly distributed over the
+ * links. In "weighted" mode, packets are distributed according to the round
+ * trip time and loss each link reports through RTCP, re-balanced on every
+ * report. Keyframe packets are duplicated over all the links, retransmission
+ * requests are served from whichever link has the packet, and retransmissions
+ * are also sent over the best other link. One can also implement its own
+ * dispatcher element and configure it using the "dispatcher" property. As a
+ * reference, "broadcast" mode is implemented with the "tee" element,
+ * "round-robin" mode with the "round-robin" element and "weighted" mode with
+ * the "ristdispatcher" element.
  *
  * ## Example gst-launch line for bonding
  * |[
@@ -108,6 +113,7 @@ typedef enum
 {
   GST_RIST_BONDING_METHOD_BROADCAST,
   GST_RIST_BONDING_METHOD_ROUND_ROBIN,
+  GST_RIST_BONDING_METHOD_WEIGHTED,
 } GstRistBondingMethod;
 
 static GstStaticPadTemplate sink_templ = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -127,6 +133,8 @@ typedef struct
   GstElement *rtx_send;
   GstElement *rtx_queue;
   guint32 rtcp_ssrc;
+  /* ristdispatcher pad of this link, in weighted mode */
+  GstPad *dispatcher_pad;
 } RistSenderBond;
 
 struct _GstRistSink
@@ -148,6 +156,9 @@ struct _GstRistSink
   gdouble max_rtcp_bandwidth;
   GstRistBondingMethod bonding_method;
 
+  /* TRUE if the dispatcher is a ristdispatcher we created */
+  gboolean weighted;
+
   /* Bonds */
   GPtrArray *bonds;
   /* this is needed as setting sibling properties will try to take the object
@@ -175,6 +186,8 @@ gst_rist_bonding_method_get_type (void)
         "GST_RIST_BONDING_METHOD_BROADCAST", "broadcast"},
     {GST_RIST_BONDING_METHOD_ROUND_ROBIN,
         "GST_RIST_BONDING_METHOD_ROUND_ROBIN", "round-robin"},
+    {GST_RIST_BONDING_METHOD_WEIGHTED,
+        "GST_RIST_BONDING_METHOD_WEIGHTED", "weighted"},
     {0, NULL, NULL}
   };
 
@@ -305,6 +318,63 @@ gst_rist_sink_request_aux_sender (GstRistSink * sink, guint session_id,
   return gst_object_ref (sink->rtxbin);
 }
 
+/* Current time in NTP short format (16.16), as used by LSR and DLSR */
+static guint32
+gst_rist_sink_ntp_short_now (void)
+{
+  guint64 now = g_get_real_time () +
+      G_GUINT64_CONSTANT (2208988800) * G_USEC_PER_SEC;
+
+  return (guint32) gst_util_uint64_scale (now, 65536, G_USEC_PER_SEC);
+}
+
+/* Feeds the report blocks about our stream to the weighted dispatcher */
+static void
+gst_rist_sink_report_link (GstRistSink * sink, GObject * session,
+    GstRTCPPacket * packet)
+{
+  guint session_id =
+      GPOINTER_TO_UINT (g_object_get_qdata (session, session_id_quark));
+  RistSenderBond *bond;
+  guint i, count;
+
+  if (session_id >= sink->bonds->len)
+    return;
+
+  bond = g_ptr_array_index (sink->bonds, session_id);
+  if (!bond->dispatcher_pad)
+    return;
+
+  count = gst_rtcp_packet_get_rb_count (packet);
+  for (i = 0; i < count; i++) {
+    guint32 ssrc, exthighestseq, jitter, lsr, dlsr;
+    guint8 fractionlost;
+    gint32 packetslost;
+    GstClockTime rtt = GST_CLOCK_TIME_NONE;
+
+    gst_rtcp_packet_get_rb (packet, i, &ssrc, &fractionlost, &packetslost,
+        &exthighestseq, &jitter, &lsr, &dlsr);
+
+    if (ssrc != sink->rtp_ssrc)
+      continue;
+
+    if (lsr != 0) {
+      guint32 rtt_ntp = gst_rist_sink_ntp_short_now () - lsr - dlsr;
+
+      /* Anything above 10s means the clocks are not comparable */
+      if (rtt_ntp < 10 * 65536)
+        rtt = gst_util_uint64_scale (rtt_ntp, GST_SECOND, 65536);
+    }
+
+    GST_LOG_OBJECT (sink, "session %u: rtt %" GST_TIME_FORMAT
+        ", highest seqnum %u, lost %d", session_id, GST_TIME_ARGS (rtt),
+        exthighestseq, packetslost);
+
+    g_signal_emit_by_name (sink->dispatcher, "report-link",
+        bond->dispatcher_pad, (guint64) rtt, exthighestseq, packetslost);
+  }
+}
+
 static void
 on_receiving_rtcp (GObject * session, GstBuffer * buffer, GstRistSink * sink)
 {
@@ -315,6 +385,12 @@ on_receiving_rtcp (GObject * session, GstBuffer * buffer, GstRistSink * sink)
     GstRTCPPacket packet;
 
     if (gst_rtcp_buffer_get_first_packet (&rtcp, &packet)) {
+      GstRTCPType type = gst_rtcp_packet_get_type (&packet);
+
+      if (sink->weighted && (type == GST_RTCP_TYPE_RR
+              || type == GST_RTCP_TYPE_SR))
+        gst_rist_sink_report_link (sink, session, &packet);
+
       /* Always skip the first one as it's never a FB or APP packet */
 
       while (gst_rtcp_packet_move_to_next (&packet)) {
@@ -443,7 +519,8 @@ gst_rist_sink_on_new_sender_ssrc (GstRistSink * sink, guint session_id,
   GObject *session = NULL;
   GObject *source = NULL;
 
-  if (session_id != 0)
+  /* In weighted mode, the reports and requests of every link matter */
+  if (session_id != 0 && !sink->weighted)
     return;
 
   g_signal_emit_by_name (rtpbin, "get-session", session_id, &gstsession);
@@ -708,6 +785,74 @@ dns_resolve_failed:
   return GST_STATE_CHANGE_FAILURE;
 }
 
+/* With weighted bonding, the requested packet may have been sent over any
+ * link, so let all of them look it up */
+static GstPadProbeReturn
+gst_rist_sink_forward_rtx_request (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GstRistSink *sink = user_data;
+  GstEvent *event = info->data;
+  const GstStructure *s;
+  gint i;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CUSTOM_UPSTREAM)
+    return GST_PAD_PROBE_OK;
+
+  s = gst_event_get_structure (event);
+  if (!gst_structure_has_name (s, "GstRTPRetransmissionRequest")
+      || gst_structure_has_field (s, "rist-forwarded"))
+    return GST_PAD_PROBE_OK;
+
+  for (i = 0; i < sink->bonds->len; i++) {
+    RistSenderBond *bond = g_ptr_array_index (sink->bonds, i);
+    GstStructure *fs;
+    GstPad *srcpad;
+
+    if (GST_OBJECT_PARENT (pad) == GST_OBJECT (bond->rtx_send))
+      continue;
+
+    fs = gst_structure_copy (s);
+    gst_structure_set (fs, "rist-forwarded", G_TYPE_BOOLEAN, TRUE, NULL);
+
+    srcpad = gst_element_get_static_pad (bond->rtx_send, "src");
+    gst_pad_send_event (srcpad,
+        gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM, fs));
+    gst_object_unref (srcpad);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Sends a copy of each retransmission over the best other link */
+static void
+gst_rist_sink_duplicate_rtx (GstRistRtxSend * rtx_send, GstBuffer * rtx_buf,
+    gpointer user_data)
+{
+  GstRistSink *sink = user_data;
+  RistSenderBond *best = NULL;
+  gdouble best_weight = -1.0;
+  gint i;
+
+  for (i = 0; i < sink->bonds->len; i++) {
+    RistSenderBond *bond = g_ptr_array_index (sink->bonds, i);
+    gdouble weight;
+
+    if (bond->rtx_send == GST_ELEMENT (rtx_send) || !bond->dispatcher_pad)
+      continue;
+
+    g_object_get (bond->dispatcher_pad, "weight", &weight, NULL);
+    if (weight > best_weight) {
+      best = bond;
+      best_weight = weight;
+    }
+  }
+
+  if (best)
+    gst_rist_rtx_send_push_rtx (GST_RIST_RTX_SEND (best->rtx_send),
+        gst_buffer_ref (rtx_buf));
+}
+
 static GstStateChangeReturn
 gst_rist_sink_start (GstRistSink * sink)
 {
@@ -730,6 +875,12 @@ gst_rist_sink_start (GstRistSink * sink)
             "rist_dispatcher");
         g_assert (sink->dispatcher);
         break;
+      case GST_RIST_BONDING_METHOD_WEIGHTED:
+        sink->dispatcher = gst_element_factory_make ("ristdispatcher",
+            "rist_dispatcher");
+        g_assert (sink->dispatcher);
+        sink->weighted = TRUE;
+        break;
     }
   }
 
@@ -763,6 +914,21 @@ gst_rist_sink_start (GstRistSink * sink)
     g_snprintf (name, 32, "src_%u", bond->session);
     pad = gst_element_request_pad_simple (sink->dispatcher, name);
     gst_element_link_pads (sink->dispatcher, name, bond->rtx_queue, "sink");
+
+    if (sink->weighted) {
+      GstPad *rtx_srcpad;
+
+      gst_object_replace ((GstObject **) & bond->dispatcher_pad,
+          GST_OBJECT (pad));
+
+      rtx_srcpad = gst_element_get_static_pad (bond->rtx_send, "src");
+      gst_pad_add_probe (rtx_srcpad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+          gst_rist_sink_forward_rtx_request, sink, NULL);
+      gst_object_unref (rtx_srcpad);
+
+      gst_rist_rtx_send_set_rtx_func (GST_RIST_RTX_SEND (bond->rtx_send),
+          gst_rist_sink_duplicate_rtx, sink);
+    }
     gst_object_unref (pad);
 
     if (!gst_rist_sink_setup_rtcp_socket (sink, bond))
@@ -1301,6 +1467,7 @@ gst_rist_sink_finalize (GObject * object)
     RistSenderBond *bond = g_ptr_array_index (sink->bonds, i);
     g_free (bond->address);
     g_free (bond->multicast_iface);
+    gst_clear_object (&bond->dispatcher_pad);
     g_slice_free (RistSenderBond, bond);
   }
   g_ptr_array_free (sink->bonds, TRUE);
@@ -0,0 +1,137 @@
+/* GStreamer
+ *
+ * gstipcpipelineallocator.c:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gstipcpipelineallocator.h"
+
+#ifdef G_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <glib/gstdio.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (gst_ipc_pipeline_allocator_debug);
+#define GST_CAT_DEFAULT gst_ipc_pipeline_allocator_debug
+
+#define _do_init \
+    GST_DEBUG_CATEGORY_INIT (gst_ipc_pipeline_allocator_debug, \
+        "ipcpipelineallocator", 0, "ipcpipeline memfd allocator");
+G_DEFINE_TYPE_WITH_CODE (GstIpcPipelineMemfdAllocator,
+    gst_ipc_pipeline_memfd_allocator, GST_TYPE_FD_ALLOCATOR, _do_init);
+
+static GstMemory *
+gst_ipc_pipeline_memfd_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+#ifdef G_OS_UNIX
+  GstMemory *mem;
+  gsize maxsize;
+  int fd;
+
+  /* honour the requested padding and alignment like the system allocator */
+  maxsize = size + params->prefix + params->padding + params->align;
+
+#ifdef HAVE_MEMFD_CREATE
+  fd = memfd_create ("gst-ipcpipeline", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd >= 0) {
+    fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK);
+  } else
+#endif
+  {
+    gchar *filename = g_build_filename (g_get_user_runtime_dir (),
+        "gst-ipcpipeline-XXXXXX", NULL);
+
+    fd = g_mkstemp (filename);
+    if (fd >= 0)
+      g_unlink (filename);
+    g_free (filename);
+
+    if (fd < 0) {
+      GST_ERROR_OBJECT (allocator, "Failed to create temporary file: %s",
+          g_strerror (errno));
+      return NULL;
+    }
+  }
+
+  if (ftruncate (fd, maxsize) < 0) {
+    GST_ERROR_OBJECT (allocator, "ftruncate failed: %s", g_strerror (errno));
+    close (fd);
+    return NULL;
+  }
+
+  /* the mapping is kept, so that recycled buffers don't mmap() again */
+  mem = gst_fd_allocator_alloc (allocator, fd, maxsize,
+      GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+  if (!mem) {
+    close (fd);
+    return NULL;
+  }
+
+  if (params->prefix || params->padding || params->align) {
+    gsize offset = params->prefix;
+
+    /* the mapping is page aligned, so aligning the offset is enough */
+    if (params->align)
+      offset = (offset + params->align) & ~params->align;
+    gst_memory_resize (mem, offset, size);
+  }
+
+  return mem;
+#else
+  return NULL;
+#endif
+}
+
+static void
+gst_ipc_pipeline_memfd_allocator_class_init (GstIpcPipelineMemfdAllocatorClass
+    * klass)
+{
+  GstAllocatorClass *alloc_class = (GstAllocatorClass *) klass;
+
+  alloc_class->alloc =
+      GST_DEBUG_FUNCPTR (gst_ipc_pipeline_memfd_allocator_alloc);
+}
+
+static void
+gst_ipc_pipeline_memfd_allocator_init (GstIpcPipelineMemfdAllocator * self)
+{
+  GstAllocator *alloc = GST_ALLOCATOR_CAST (self);
+
+  alloc->mem_type = "ipcpipeline-memfd";
+
+  GST_OBJECT_FLAG_UNSET (self, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
+GstAllocator *
+gst_ipc_pipeline_memfd_allocator_new (void)
+{
+  GstAllocator *alloc;
+
+  alloc = g_object_new (GST_TYPE_IPC_PIPELINE_MEMFD_ALLOCATOR, NULL);
+  gst_object_ref_sink (alloc);
+
+  return alloc;
+}
@@ -0,0 +1,55 @@
+/* GStreamer
+ *
+ * gstipcpipelineallocator.h:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_IPC_PIPELINE_ALLOCATOR_H__
+#define __GST_IPC_PIPELINE_ALLOCATOR_H__
+
+#include <gst/gst.h>
+#include <gst/allocators/allocators.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_IPC_PIPELINE_MEMFD_ALLOCATOR \
+  (gst_ipc_pipeline_memfd_allocator_get_type())
+#define GST_IPC_PIPELINE_MEMFD_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_IPC_PIPELINE_MEMFD_ALLOCATOR,GstIpcPipelineMemfdAllocator))
+
+typedef struct _GstIpcPipelineMemfdAllocator GstIpcPipelineMemfdAllocator;
+typedef struct _GstIpcPipelineMemfdAllocatorClass GstIpcPipelineMemfdAllocatorClass;
+
+/* Allocates memories backed by an anonymous file, which ipcpipelinesink can
+ * pass to ipcpipelinesrc by fd instead of copying their content */
+struct _GstIpcPipelineMemfdAllocator
+{
+  GstFdAllocator parent;
+};
+
+struct _GstIpcPipelineMemfdAllocatorClass
+{
+  GstFdAllocatorClass parent_class;
+};
+
+G_GNUC_INTERNAL GType gst_ipc_pipeline_memfd_allocator_get_type (void);
+
+G_GNUC_INTERNAL GstAllocator *gst_ipc_pipeline_memfd_allocator_new (void);
+
+G_END_DECLS
+
+#endif /* __GST_IPC_PIPELINE_ALLOCATOR_H__ */
@@ -35,8 +35,15 @@
 #include <string.h>
 #include <gst/base/gstbytewriter.h>
 #include <gst/gstprotection.h>
+#include <gst/allocators/allocators.h>
 #include "gstipcpipelinecomm.h"
 
+#ifdef G_OS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#endif
+
 GST_DEBUG_CATEGORY_STATIC (gst_ipc_pipeline_comm_debug);
 #define GST_CAT_DEFAULT gst_ipc_pipeline_comm_debug
 
@@ -192,6 +199,10 @@ gst_ipc_pipeline_comm_data_type_get_name (GstIpcPipelineCommDataType type)
       return "MESSAGE";
     case GST_IPC_PIPELINE_COMM_DATA_TYPE_GERROR_MESSAGE:
       return "GERROR_MESSAGE";
+    case GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_FDS:
+      return "BUFFER_FDS";
+    case GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_RELEASE:
+      return "BUFFER_RELEASE";
     default:
       return "UNKNOWN";
   }
@@ -299,6 +310,67 @@ write_failed:
   goto done;
 }
 
+/* Only called from the reader thread, see
+ * gst_ipc_pipeline_comm_write_pending_releases() */
+static void
+gst_ipc_pipeline_comm_write_release_to_fd (GstIpcPipelineComm * comm,
+    guint32 id)
+{
+  const unsigned char payload_type =
+      GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_RELEASE;
+  GstByteWriter bw;
+
+  g_mutex_lock (&comm->mutex);
+
+  if (comm->fdout < 0)
+    goto done;
+
+  GST_TRACE_OBJECT (comm->element, "Writing release for buffer %u", id);
+  gst_byte_writer_init (&bw);
+  if (!gst_byte_writer_put_uint8 (&bw, payload_type) ||
+      !gst_byte_writer_put_uint32_le (&bw, id) ||
+      !gst_byte_writer_put_uint32_le (&bw, 0) ||
+      !write_byte_writer_to_fd (comm, &bw)) {
+    /* the peer dropping its buffers on failure is harmless */
+    GST_WARNING_OBJECT (comm->element, "Failed to release buffer %u", id);
+  }
+  gst_byte_writer_reset (&bw);
+
+done:
+  g_mutex_unlock (&comm->mutex);
+}
+
+static gboolean
+fd_is_unix_socket (int fd)
+{
+#ifdef G_OS_UNIX
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof (addr);
+
+  if (fd < 0 || getsockname (fd, (struct sockaddr *) &addr, &len) < 0)
+    return FALSE;
+
+  return addr.ss_family == AF_UNIX;
+#else
+  return FALSE;
+#endif
+}
+
+/* Whether memories can be passed by fd to the peer, which needs fdout to
+ * be a unix socket. Must be called with the mutex held. */
+gboolean
+gst_ipc_pipeline_comm_can_pass_fds (GstIpcPipelineComm * comm)
+{
+  if (comm->checked_fdout != comm->fdout) {
+    comm->checked_fdout = comm->fdout;
+    comm->fdout_is_socket = fd_is_unix_socket (comm->fdout);
+    GST_DEBUG_OBJECT (comm->element, "fdout %d %s pass fds", comm->fdout,
+        comm->fdout_is_socket ? "can" : "cannot");
+  }
+
+  return comm->fdout_is_socket;
+}
+
 void
 gst_ipc_pipeline_comm_write_flow_ack_to_fd (GstIpcPipelineComm * comm,
     guint32 id, GstFlowReturn ret)
@@ -503,6 +575,226 @@ typedef struct
   guint64 flags;
 } CommBufferMetadata;
 
+static gboolean
+put_buffer_metas (GstByteWriter * bw, const MetaListRepresentation * repr)
+{
+  guint32 n;
+
+  if (!gst_byte_writer_put_uint32_le (bw, repr->n_meta))
+    return FALSE;
+  for (n = 0; n < repr->n_meta; ++n) {
+    const MetaBuildInfo *info = repr->info + n;
+    guint32 len;
+    const char *s;
+
+    if (!gst_byte_writer_put_uint32_le (bw, info->bytes))
+      return FALSE;
+
+    if (!gst_byte_writer_put_uint32_le (bw, info->flags))
+      return FALSE;
+
+    s = g_type_name (info->api);
+    len = strlen (s) + 1;
+    if (!gst_byte_writer_put_uint32_le (bw, len))
+      return FALSE;
+    if (!gst_byte_writer_put_data (bw, (const guint8 *) s, len))
+      return FALSE;
+
+    if (!gst_byte_writer_put_uint64_le (bw, info->size))
+      return FALSE;
+
+    s = info->str;
+    len = s ? (strlen (s) + 1) : 0;
+    if (!gst_byte_writer_put_uint32_le (bw, len))
+      return FALSE;
+    if (len)
+      if (!gst_byte_writer_put_data (bw, (const guint8 *) s, len))
+        return FALSE;
+  }
+
+  return TRUE;
+}
+
+typedef enum
+{
+  COMM_MEMORY_TYPE_DATA,
+  COMM_MEMORY_TYPE_FD,
+  COMM_MEMORY_TYPE_DMABUF,
+} CommMemoryType;
+
+/* Maximum number of fds sent along a single chunk, one per memory */
+#define MAX_FDS_PER_CHUNK 16
+
+static gboolean
+buffer_has_fd_memory (GstBuffer * buffer)
+{
+  guint i, n = gst_buffer_n_memory (buffer);
+
+  if (n > MAX_FDS_PER_CHUNK)
+    return FALSE;
+
+  for (i = 0; i < n; i++) {
+    if (gst_is_fd_memory (gst_buffer_peek_memory (buffer, i)))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+#ifdef G_OS_UNIX
+static gboolean
+write_to_fd_with_fds (GstIpcPipelineComm * comm, const guint8 * data,
+    gsize size, const gint * fds, guint n_fds)
+{
+  struct msghdr msg = { 0, };
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    struct cmsghdr hdr;
+    gchar buf[CMSG_SPACE (sizeof (gint) * MAX_FDS_PER_CHUNK)];
+  } control;
+  ssize_t written;
+
+  g_assert (n_fds > 0 && n_fds <= MAX_FDS_PER_CHUNK);
+
+  iov.iov_base = (void *) data;
+  iov.iov_len = size;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = CMSG_SPACE (sizeof (gint) * n_fds);
+  memset (control.buf, 0, sizeof (control.buf));
+
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (gint) * n_fds);
+  memcpy (CMSG_DATA (cmsg), fds, sizeof (gint) * n_fds);
+
+  GST_TRACE_OBJECT (comm->element, "Writing %u bytes and %u fds to fdout",
+      (unsigned) size, n_fds);
+  do {
+    written = sendmsg (comm->fdout, &msg, 0);
+  } while (written < 0 && (errno == EAGAIN || errno == EINTR));
+
+  if (written < 0) {
+    GST_ERROR_OBJECT (comm->element, "Failed to send fds: %s",
+        strerror (errno));
+    return FALSE;
+  }
+
+  /* the fds went along with the first bytes, the rest is plain data */
+  return write_to_fd_raw (comm, data + written, size - written);
+}
+#endif
+
+/* Writes a buffer as a BUFFER_FDS chunk: memories backed by a fd are passed
+ * over the socket instead of being copied. The buffer is kept alive until
+ * the peer releases it, so that pools upstream don't recycle memory that
+ * is still in use on the other side. */
+static gboolean
+write_buffer_fds (GstIpcPipelineComm * comm, GstBuffer * buffer,
+    const CommBufferMetadata * meta, const MetaListRepresentation * repr)
+{
+#ifdef G_OS_UNIX
+  const unsigned char payload_type = GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_FDS;
+  gint fds[MAX_FDS_PER_CHUNK];
+  guint n_fds = 0;
+  guint32 size;
+  guint8 *data;
+  guint i, n_mem;
+  GstByteWriter bw;
+  gboolean ret = FALSE;
+
+  n_mem = gst_buffer_n_memory (buffer);
+
+  size = sizeof (CommBufferMetadata) + sizeof (guint32) + repr->total_bytes;
+  for (i = 0; i < n_mem; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (buffer, i);
+
+    size += 1 + 3 * sizeof (guint64);
+    if (!gst_is_fd_memory (mem))
+      size += mem->size;
+  }
+
+  gst_byte_writer_init (&bw);
+  if (!gst_byte_writer_put_uint8 (&bw, payload_type))
+    goto done;
+  if (!gst_byte_writer_put_uint32_le (&bw, comm->send_id))
+    goto done;
+  if (!gst_byte_writer_put_uint32_le (&bw, size))
+    goto done;
+  if (!gst_byte_writer_put_data (&bw, (const guint8 *) meta, sizeof (*meta)))
+    goto done;
+  if (!gst_byte_writer_put_uint32_le (&bw, n_mem))
+    goto done;
+
+  for (i = 0; i < n_mem; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (buffer, i);
+    CommMemoryType type;
+
+    if (gst_is_dmabuf_memory (mem)) {
+      type = COMM_MEMORY_TYPE_DMABUF;
+      fds[n_fds++] = gst_dmabuf_memory_get_fd (mem);
+    } else if (gst_is_fd_memory (mem)) {
+      type = COMM_MEMORY_TYPE_FD;
+      fds[n_fds++] = gst_fd_memory_get_fd (mem);
+    } else {
+      type = COMM_MEMORY_TYPE_DATA;
+    }
+
+    if (!gst_byte_writer_put_uint8 (&bw, type))
+      goto done;
+    if (!gst_byte_writer_put_uint64_le (&bw, mem->offset))
+      goto done;
+    if (!gst_byte_writer_put_uint64_le (&bw, mem->size))
+      goto done;
+    if (!gst_byte_writer_put_uint64_le (&bw, mem->maxsize))
+      goto done;
+  }
+
+  size = gst_byte_writer_get_size (&bw);
+  data = gst_byte_writer_reset_and_get_data (&bw);
+  ret = write_to_fd_with_fds (comm, data, size, fds, n_fds);
+  g_free (data);
+  if (!ret)
+    goto done;
+
+  /* memories that could not be exported follow, in order */
+  for (i = 0; i < n_mem; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (buffer, i);
+    GstMapInfo map;
+
+    if (gst_is_fd_memory (mem))
+      continue;
+
+    if (!gst_memory_map (mem, &map, GST_MAP_READ)) {
+      GST_ERROR_OBJECT (comm->element, "Failed to map memory");
+      ret = FALSE;
+      goto done;
+    }
+    ret = write_to_fd_raw (comm, map.data, map.size);
+    gst_memory_unmap (mem, &map);
+    if (!ret)
+      goto done;
+  }
+
+  gst_byte_writer_init (&bw);
+  ret = put_buffer_metas (&bw, repr) && write_byte_writer_to_fd (comm, &bw);
+  if (ret)
+    g_hash_table_insert (comm->exported_buffers,
+        GUINT_TO_POINTER (comm->send_id), gst_buffer_ref (buffer));
+
+done:
+  gst_byte_writer_reset (&bw);
+  return ret;
+#else
+  g_assert_not_reached ();
+  return FALSE;
+#endif
+}
+
 GstFlowReturn
 gst_ipc_pipeline_comm_write_buffer_to_fd (GstIpcPipelineComm * comm,
     GstBuffer * buffer)
@@ -534,6 +826,13 @@ gst_ipc_pipeline_comm_write_buffer_to_fd (GstIpcPipelineComm * comm,
   /* work out meta size */
   gst_buffer_foreach_meta (buffer, build_meta, &repr);
 
+  if (buffer_has_fd_memory (buffer) &&
+      gst_ipc_pipeline_comm_can_pass_fds (comm)) {
+    if (!write_buffer_fds (comm, buffer, &meta, &repr))
+      goto write_failed;
+    goto sync;
+  }
+
   if (!gst_byte_writer_put_uint8 (&bw, payload_type))
     goto write_failed;
   if (!gst_byte_writer_put_uint32_le (&bw, comm->send_id))
@@ -560,41 +859,13 @@ gst_ipc_pipeline_comm_write_buffer_to_fd (GstIpcPipelineComm * comm,
 
   /* meta */
   gst_byte_writer_init (&bw);
-  if (!gst_byte_writer_put_uint32_le (&bw, repr.n_meta))
+  if (!put_buffer_metas (&bw, &repr))
     goto write_failed;
-  for (n = 0; n < repr.n_meta; ++n) {
-    const MetaBuildInfo *info = repr.info + n;
-    guint32 len;
-    const char *s;
-
-    if (!gst_byte_writer_put_uint32_le (&bw, info->bytes))
-      goto write_failed;
-
-    if (!gst_byte_writer_put_uint32_le (&bw, info->flags))
-      goto write_failed;
-
-    s = g_type_name (info->api);
-    len = strlen (s) + 1;
-    if (!gst_byte_writer_put_uint32_le (&bw, len))
-      goto write_failed;
-    if (!gst_byte_writer_put_data (&bw, (const guint8 *) s, len))
-      goto write_failed;
-
-    if (!gst_byte_writer_put_uint64_le (&bw, info->size))
-      goto write_failed;
-
-    s = info->str;
-    len = s ? (strlen (s) + 1) : 0;
-    if (!gst_byte_writer_put_uint32_le (&bw, len))
-      goto write_failed;
-    if (len)
-      if (!gst_byte_writer_put_data (&bw, (const guint8 *) s, len))
-        goto write_failed;
-  }
 
   if (!write_byte_writer_to_fd (comm, &bw))
     goto write_failed;
 
+sync:
   if (!gst_ipc_pipeline_comm_sync_fd (comm, comm->send_id, NULL, &ret32,
           ACK_TYPE_BLOCKING, COMM_REQUEST_TYPE_BUFFER))
     goto wait_failed;
@@ -627,55 +898,16 @@ map_failed:
   goto done;
 }
 
-static GstBuffer *
-gst_ipc_pipeline_comm_read_buffer (GstIpcPipelineComm * comm, guint32 size)
+static void
+read_buffer_metas (GstIpcPipelineComm * comm, GstBuffer * buffer,
+    const guint8 * payload)
 {
-  GstBuffer *buffer;
-  CommBufferMetadata meta;
   guint32 n_meta, n;
-  const guint8 *payload = NULL;
-  guint32 mapped_size, buffer_data_size;
-
-  /* this should not be called if we don't have enough yet */
-  g_return_val_if_fail (gst_adapter_available (comm->adapter) >= size, NULL);
-  g_return_val_if_fail (size >= sizeof (CommBufferMetadata), NULL);
-
-  mapped_size = sizeof (CommBufferMetadata) + sizeof (buffer_data_size);
-  payload = gst_adapter_map (comm->adapter, mapped_size);
-  if (!payload)
-    return NULL;
-  memcpy (&meta, payload, sizeof (CommBufferMetadata));
-  payload += sizeof (CommBufferMetadata);
-  memcpy (&buffer_data_size, payload, sizeof (buffer_data_size));
-  size -= mapped_size;
-  gst_adapter_unmap (comm->adapter);
-  gst_adapter_flush (comm->adapter, mapped_size);
-
-  if (buffer_data_size == 0) {
-    buffer = gst_buffer_new ();
-  } else {
-    buffer = gst_adapter_get_buffer (comm->adapter, buffer_data_size);
-    gst_adapter_flush (comm->adapter, buffer_data_size);
-  }
-  size -= buffer_data_size;
-
-  GST_BUFFER_PTS (buffer) = meta.pts;
-  GST_BUFFER_DTS (buffer) = meta.dts;
-  GST_BUFFER_DURATION (buffer) = meta.duration;
-  GST_BUFFER_OFFSET (buffer) = meta.offset;
-  GST_BUFFER_OFFSET_END (buffer) = meta.offset_end;
-  GST_BUFFER_FLAGS (buffer) = meta.flags;
 
   /* If you don't call that, the GType isn't yet known at the
      g_type_from_name below */
   gst_protection_meta_get_info ();
 
-  mapped_size = size;
-  payload = gst_adapter_map (comm->adapter, mapped_size);
-  if (!payload) {
-    gst_buffer_unref (buffer);
-    return NULL;
-  }
   memcpy (&n_meta, payload, sizeof (n_meta));
   payload += sizeof (n_meta);
 
@@ -720,13 +952,351 @@ gst_ipc_pipeline_comm_read_buffer (GstIpcPipelineComm * comm, guint32 size)
 #undef READ_FIELD
 
   }
+}
+
+static void
+set_buffer_metadata (GstBuffer * buffer, const CommBufferMetadata * meta)
+{
+  GST_BUFFER_PTS (buffer) = meta->pts;
+  GST_BUFFER_DTS (buffer) = meta->dts;
+  GST_BUFFER_DURATION (buffer) = meta->duration;
+  GST_BUFFER_OFFSET (buffer) = meta->offset;
+  GST_BUFFER_OFFSET_END (buffer) = meta->offset_end;
+  GST_BUFFER_FLAGS (buffer) = meta->flags;
+}
+
+static GstBuffer *
+gst_ipc_pipeline_comm_read_buffer (GstIpcPipelineComm * comm, guint32 size)
+{
+  GstBuffer *buffer;
+  CommBufferMetadata meta;
+  const guint8 *payload = NULL;
+  guint32 mapped_size, buffer_data_size;
+
+  /* this should not be called if we don't have enough yet */
+  g_return_val_if_fail (gst_adapter_available (comm->adapter) >= size, NULL);
+  g_return_val_if_fail (size >= sizeof (CommBufferMetadata), NULL);
 
+  mapped_size = sizeof (CommBufferMetadata) + sizeof (buffer_data_size);
+  payload = gst_adapter_map (comm->adapter, mapped_size);
+  if (!payload)
+    return NULL;
+  memcpy (&meta, payload, sizeof (CommBufferMetadata));
+  payload += sizeof (CommBufferMetadata);
+  memcpy (&buffer_data_size, payload, sizeof (buffer_data_size));
+  size -= mapped_size;
+  gst_adapter_unmap (comm->adapter);
+  gst_adapter_flush (comm->adapter, mapped_size);
+
+  if (buffer_data_size == 0) {
+    buffer = gst_buffer_new ();
+  } else {
+    buffer = gst_adapter_get_buffer (comm->adapter, buffer_data_size);
+    gst_adapter_flush (comm->adapter, buffer_data_size);
+  }
+  size -= buffer_data_size;
+
+  set_buffer_metadata (buffer, &meta);
+
+  mapped_size = size;
+  payload = gst_adapter_map (comm->adapter, mapped_size);
+  if (!payload) {
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+  read_buffer_metas (comm, buffer, payload);
   gst_adapter_unmap (comm->adapter);
   gst_adapter_flush (comm->adapter, mapped_size);
 
   return buffer;
 }
 
+/* Tracks the memories imported for one buffer, the peer is told it can
+ * reuse them once they are all freed */
+typedef struct
+{
+  GstElement *element;
+  GstIpcPipelineComm *comm;
+  guint32 id;
+  gint n_memories;
+} ImportedBuffer;
+
+/* Memories are freed from any thread, possibly one that holds the comm
+ * mutex or is waiting for the peer. The release is thus only queued here,
+ * and written by the reader thread which gets woken up for it */
+static void
+imported_memory_freed (gpointer user_data, GstMiniObject * obj)
+{
+  ImportedBuffer *imported = user_data;
+  GstIpcPipelineComm *comm = imported->comm;
+
+  if (!g_atomic_int_dec_and_test (&imported->n_memories))
+    return;
+
+  GST_TRACE_OBJECT (imported->element, "Queueing release of buffer %u",
+      imported->id);
+  gst_atomic_queue_push (comm->released_ids, GUINT_TO_POINTER (imported->id));
+  if (g_atomic_int_compare_and_exchange (&comm->releases_pending, 0, 1))
+    gst_poll_write_control (comm->poll);
+
+  gst_object_unref (imported->element);
+  g_free (imported);
+}
+
+static void
+gst_ipc_pipeline_comm_write_pending_releases (GstIpcPipelineComm * comm)
+{
+  if (!g_atomic_int_compare_and_exchange (&comm->releases_pending, 1, 0))
+    return;
+
+  gst_poll_read_control (comm->poll);
+  while (gst_atomic_queue_length (comm->released_ids) > 0) {
+    guint32 id = GPOINTER_TO_UINT (gst_atomic_queue_pop (comm->released_ids));
+
+    gst_ipc_pipeline_comm_write_release_to_fd (comm, id);
+  }
+}
+
+/* Maximum number of imported memories kept around for reuse */
+#define MAX_CACHED_MEMORIES 32
+
+typedef struct
+{
+  dev_t dev;
+  ino_t ino;
+  /* owns the fd, and keeps it mapped */
+  GstMemory *mem;
+} CachedMemory;
+
+static void
+cached_memory_free (CachedMemory * cached)
+{
+  gst_memory_unref (cached->mem);
+  g_free (cached);
+}
+
+static void
+clear_cached_memories (GstIpcPipelineComm * comm)
+{
+  g_queue_clear_full (&comm->cached_memories,
+      (GDestroyNotify) cached_memory_free);
+}
+
+/* Returns a memory of @size bytes at @offset in the memory backed by @fd,
+ * taking ownership of @fd. Upstream pools on the other side send the same
+ * few files over and over, so each one is only imported and mapped once:
+ * it is recognized by its inode and shared from the first import */
+static GstMemory *
+import_fd_memory (GstIpcPipelineComm * comm, gboolean dmabuf, gint fd,
+    gsize offset, gsize size, gsize maxsize)
+{
+  CachedMemory *cached;
+  GstMemory *mem;
+  struct stat st;
+  GList *l;
+
+  if (fstat (fd, &st) < 0) {
+    GST_WARNING_OBJECT (comm->element, "fstat failed: %s", g_strerror (errno));
+    memset (&st, 0, sizeof (st));
+  }
+
+  for (l = comm->cached_memories.head; l && st.st_ino; l = l->next) {
+    cached = l->data;
+
+    if (cached->dev == st.st_dev && cached->ino == st.st_ino
+        && cached->mem->maxsize == maxsize
+        && gst_is_dmabuf_memory (cached->mem) == dmabuf) {
+      GST_TRACE_OBJECT (comm->element, "Reusing imported memory %p",
+          cached->mem);
+      close (fd);
+      /* most recently used first */
+      g_queue_unlink (&comm->cached_memories, l);
+      g_queue_push_head_link (&comm->cached_memories, l);
+      return gst_memory_share (cached->mem, offset, size);
+    }
+  }
+
+  if (dmabuf) {
+    mem = gst_dmabuf_allocator_alloc_with_flags (comm->dmabuf_allocator, fd,
+        maxsize, GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+  } else {
+    mem = gst_fd_allocator_alloc (comm->fd_allocator, fd, maxsize,
+        GST_FD_MEMORY_FLAG_KEEP_MAPPED);
+  }
+  if (!mem) {
+    close (fd);
+    return NULL;
+  }
+
+  /* without an inode, it can't be found again */
+  if (st.st_ino == 0) {
+    gst_memory_resize (mem, offset, size);
+    return mem;
+  }
+
+  cached = g_new0 (CachedMemory, 1);
+  cached->dev = st.st_dev;
+  cached->ino = st.st_ino;
+  cached->mem = mem;
+  g_queue_push_head (&comm->cached_memories, cached);
+
+  if (comm->cached_memories.length > MAX_CACHED_MEMORIES)
+    cached_memory_free (g_queue_pop_tail (&comm->cached_memories));
+
+  return gst_memory_share (mem, offset, size);
+}
+
+typedef struct
+{
+  guint8 type;
+  guint64 offset;
+  guint64 size;
+  guint64 maxsize;
+} CommMemoryInfo;
+
+static void
+close_received_fds (GstIpcPipelineComm * comm)
+{
+  guint i;
+
+  for (i = 0; i < comm->received_fds->len; i++) {
+    gint fd = g_array_index (comm->received_fds, gint, i);
+    if (fd >= 0)
+      close (fd);
+  }
+  g_array_set_size (comm->received_fds, 0);
+}
+
+static GstBuffer *
+gst_ipc_pipeline_comm_read_buffer_fds (GstIpcPipelineComm * comm,
+    guint32 size, guint32 id)
+{
+  GstBuffer *buffer;
+  CommBufferMetadata meta;
+  CommMemoryInfo infos[MAX_FDS_PER_CHUNK];
+  ImportedBuffer *imported = NULL;
+  const guint8 *payload = NULL;
+  guint32 mapped_size, n_mem, i;
+  guint n_fds = 0, fd_index = 0;
+
+  /* this should not be called if we don't have enough yet */
+  g_return_val_if_fail (gst_adapter_available (comm->adapter) >= size, NULL);
+  g_return_val_if_fail (size >= sizeof (CommBufferMetadata) + 4, NULL);
+
+  mapped_size = sizeof (CommBufferMetadata) + sizeof (n_mem);
+  payload = gst_adapter_map (comm->adapter, mapped_size);
+  if (!payload)
+    goto failed;
+  memcpy (&meta, payload, sizeof (CommBufferMetadata));
+  payload += sizeof (CommBufferMetadata);
+  memcpy (&n_mem, payload, sizeof (n_mem));
+  gst_adapter_unmap (comm->adapter);
+  gst_adapter_flush (comm->adapter, mapped_size);
+  size -= mapped_size;
+
+  if (n_mem > MAX_FDS_PER_CHUNK || size < n_mem * (1 + 3 * sizeof (guint64))) {
+    GST_ERROR_OBJECT (comm->element, "Invalid number of memories: %u", n_mem);
+    goto failed;
+  }
+
+  mapped_size = n_mem * (1 + 3 * sizeof (guint64));
+  payload = gst_adapter_map (comm->adapter, mapped_size);
+  if (!payload)
+    goto failed;
+  for (i = 0; i < n_mem; i++) {
+    infos[i].type = *payload++;
+    memcpy (&infos[i].offset, payload, sizeof (guint64));
+    memcpy (&infos[i].size, payload + 8, sizeof (guint64));
+    memcpy (&infos[i].maxsize, payload + 16, sizeof (guint64));
+    payload += 3 * sizeof (guint64);
+    if (infos[i].type != COMM_MEMORY_TYPE_DATA)
+      n_fds++;
+  }
+  gst_adapter_unmap (comm->adapter);
+  gst_adapter_flush (comm->adapter, mapped_size);
+  size -= mapped_size;
+
+  if (n_fds > comm->received_fds->len) {
+    GST_ERROR_OBJECT (comm->element, "Expected %u fds, got %u", n_fds,
+        comm->received_fds->len);
+    goto failed;
+  }
+
+  buffer = gst_buffer_new ();
+  for (i = 0; i < n_mem; i++) {
+    GstMemory *mem;
+
+    if (infos[i].type == COMM_MEMORY_TYPE_DATA) {
+      GstBuffer *data;
+
+      if (size < infos[i].size)
+        goto invalid_size;
+      if (infos[i].size > 0) {
+        data = gst_adapter_take_buffer (comm->adapter, infos[i].size);
+        buffer = gst_buffer_append (buffer, data);
+        size -= infos[i].size;
+      }
+      continue;
+    }
+
+    if (infos[i].offset + infos[i].size > infos[i].maxsize)
+      goto invalid_size;
+
+    mem = import_fd_memory (comm,
+        infos[i].type == COMM_MEMORY_TYPE_DMABUF,
+        g_array_index (comm->received_fds, gint, fd_index), infos[i].offset,
+        infos[i].size, infos[i].maxsize);
+    /* the fd was taken over */
+    g_array_index (comm->received_fds, gint, fd_index) = -1;
+    fd_index++;
+
+    if (!mem) {
+      GST_ERROR_OBJECT (comm->element, "Failed to import memory");
+      goto error;
+    }
+
+    if (!imported) {
+      imported = g_new0 (ImportedBuffer, 1);
+      imported->element = gst_object_ref (comm->element);
+      imported->comm = comm;
+      imported->id = id;
+    }
+    g_atomic_int_inc (&imported->n_memories);
+    gst_mini_object_weak_ref (GST_MINI_OBJECT_CAST (mem),
+        imported_memory_freed, imported);
+    gst_buffer_append_memory (buffer, mem);
+  }
+
+  set_buffer_metadata (buffer, &meta);
+
+  mapped_size = size;
+  payload = gst_adapter_map (comm->adapter, mapped_size);
+  if (!payload)
+    goto error;
+  read_buffer_metas (comm, buffer, payload);
+  gst_adapter_unmap (comm->adapter);
+  gst_adapter_flush (comm->adapter, mapped_size);
+
+done:
+  /* drop the fds of this chunk, closing any we did not import */
+  for (i = 0; i < n_fds; i++) {
+    gint fd = g_array_index (comm->received_fds, gint, i);
+    if (fd >= 0)
+      close (fd);
+  }
+  g_array_remove_range (comm->received_fds, 0, n_fds);
+  return buffer;
+
+invalid_size:
+  GST_ERROR_OBJECT (comm->element, "Invalid memory size");
+error:
+  gst_buffer_unref (buffer);
+failed:
+  /* the fds can't be matched to the memories anymore, drop all of them */
+  close_received_fds (comm);
+  return NULL;
+}
+
 static gboolean
 gst_ipc_pipeline_comm_write_sink_message_event_to_fd (GstIpcPipelineComm * comm,
     GstEvent * event)
@@ -1614,6 +2184,14 @@ gst_ipc_pipeline_comm_init (GstIpcPipelineComm * comm, GstElement * element)
   comm->adapter = gst_adapter_new ();
   comm->poll = gst_poll_new (TRUE);
   gst_poll_fd_init (&comm->pollFDin);
+  comm->checked_fdout = -1;
+  comm->received_fds = g_array_new (FALSE, FALSE, sizeof (gint));
+  comm->exported_buffers = g_hash_table_new_full (g_direct_hash,
+      g_direct_equal, NULL, (GDestroyNotify) gst_buffer_unref);
+  comm->fd_allocator = gst_fd_allocator_new ();
+  comm->dmabuf_allocator = gst_dmabuf_allocator_new ();
+  comm->released_ids = gst_atomic_queue_new (16);
+  g_queue_init (&comm->cached_memories);
 }
 
 void
@@ -1622,6 +2200,13 @@ gst_ipc_pipeline_comm_clear (GstIpcPipelineComm * comm)
   g_hash_table_destroy (comm->waiting_ids);
   gst_object_unref (comm->adapter);
   gst_poll_free (comm->poll);
+  close_received_fds (comm);
+  g_array_unref (comm->received_fds);
+  g_hash_table_destroy (comm->exported_buffers);
+  clear_cached_memories (comm);
+  gst_object_unref (comm->fd_allocator);
+  gst_object_unref (comm->dmabuf_allocator);
+  gst_atomic_queue_unref (comm->released_ids);
   g_mutex_clear (&comm->mutex);
 }
 
@@ -1655,6 +2240,8 @@ gst_ipc_pipeline_comm_cancel (GstIpcPipelineComm * comm, gboolean cleanup)
   g_mutex_lock (&comm->mutex);
   g_hash_table_foreach (comm->waiting_ids, cancel_request_error, comm);
   if (cleanup) {
+    /* the peer is gone, nobody will release what it had */
+    g_hash_table_remove_all (comm->exported_buffers);
     g_hash_table_unref (comm->waiting_ids);
     comm->waiting_ids =
         g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
@@ -1706,6 +2293,55 @@ gst_ipc_pipeline_comm_reply_request (GstIpcPipelineComm * comm, guint32 id,
   return TRUE;
 }
 
+/* Reads from fdin, collecting the fds passed along on a unix socket */
+static ssize_t
+read_from_fd (GstIpcPipelineComm * comm, void *data, size_t size)
+{
+#ifdef G_OS_UNIX
+  if (comm->fdin_is_socket) {
+    struct msghdr msg = { 0, };
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union
+    {
+      struct cmsghdr hdr;
+      gchar buf[CMSG_SPACE (sizeof (gint) * MAX_FDS_PER_CHUNK)];
+    } control;
+    int flags = 0;
+    ssize_t sz;
+
+    iov.iov_base = data;
+    iov.iov_len = size;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof (control.buf);
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+    sz = recvmsg (comm->pollFDin.fd, &msg, flags);
+    if (sz <= 0)
+      return sz;
+
+    for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        guint n_fds = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (gint);
+
+        GST_TRACE_OBJECT (comm->element, "Received %u fds", n_fds);
+        g_array_append_vals (comm->received_fds, CMSG_DATA (cmsg), n_fds);
+      }
+    }
+    if (msg.msg_flags & MSG_CTRUNC)
+      GST_WARNING_OBJECT (comm->element, "Some passed fds were dropped");
+
+    return sz;
+  }
+#endif
+
+  return read (comm->pollFDin.fd, data, size);
+}
+
 static gint
 update_adapter (GstIpcPipelineComm * comm)
 {
@@ -1731,6 +2367,7 @@ again:
     if (comm->fdin != -1 && GST_OBJECT_PARENT (comm->element)) {
       GST_DEBUG_OBJECT (comm->element, "Start watching fd %d", comm->fdin);
       comm->pollFDin.fd = comm->fdin;
+      comm->fdin_is_socket = fd_is_unix_socket (comm->fdin);
       gst_poll_add_fd (comm->poll, &comm->pollFDin);
       gst_poll_fd_ctl_read (comm->poll, &comm->pollFDin, TRUE);
     }
@@ -1752,7 +2389,7 @@ again:
       mem = gst_allocator_alloc (NULL, comm->read_chunk_size, NULL);
 
     gst_memory_map (mem, &map, GST_MAP_WRITE);
-    sz = read (comm->pollFDin.fd, map.data, map.size);
+    sz = read_from_fd (comm, map.data, map.size);
     gst_memory_unmap (mem, &map);
 
     if (sz <= 0) {
@@ -1817,6 +2454,8 @@ read_many (GstIpcPipelineComm * comm)
           case GST_IPC_PIPELINE_COMM_DATA_TYPE_STATE_LOST:
           case GST_IPC_PIPELINE_COMM_DATA_TYPE_MESSAGE:
           case GST_IPC_PIPELINE_COMM_DATA_TYPE_GERROR_MESSAGE:
+          case GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_FDS:
+          case GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_RELEASE:
             GST_TRACE_OBJECT (comm->element, "switching to state %s",
                 gst_ipc_pipeline_comm_data_type_get_name (type));
             comm->state = type;
@@ -1853,6 +2492,25 @@ read_many (GstIpcPipelineComm * comm)
         comm->state = GST_IPC_PIPELINE_COMM_STATE_TYPE;
         break;
       }
+      case GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_RELEASE:
+      {
+        available = gst_adapter_available (comm->adapter);
+        if (available < comm->payload_length)
+          goto done;
+        gst_adapter_flush (comm->adapter, comm->payload_length);
+
+        GST_TRACE_OBJECT (comm->element, "Peer released buffer %u", comm->id);
+        g_mutex_lock (&comm->mutex);
+        if (!g_hash_table_remove (comm->exported_buffers,
+                GUINT_TO_POINTER (comm->id)))
+          GST_WARNING_OBJECT (comm->element, "Release of unknown buffer %u",
+              comm->id);
+        g_mutex_unlock (&comm->mutex);
+
+        GST_TRACE_OBJECT (comm->element, "switching to state TYPE");
+        comm->state = GST_IPC_PIPELINE_COMM_STATE_TYPE;
+        break;
+      }
       case GST_IPC_PIPELINE_COMM_DATA_TYPE_QUERY_RESULT:
       {
         GstQuery *query = NULL;
@@ -1881,6 +2539,7 @@ read_many (GstIpcPipelineComm * comm)
         break;
       }
       case GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER:
+      case GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_FDS:
       {
         GstBuffer *buf;
 
@@ -1888,7 +2547,11 @@ read_many (GstIpcPipelineComm * comm)
         if (available < comm->payload_length)
           goto done;
 
-        buf = gst_ipc_pipeline_comm_read_buffer (comm, comm->payload_length);
+        if (comm->state == GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_FDS)
+          buf = gst_ipc_pipeline_comm_read_buffer_fds (comm,
+              comm->payload_length, comm->id);
+        else
+          buf = gst_ipc_pipeline_comm_read_buffer (comm, comm->payload_length);
         if (!buf)
           goto buffer_failed;
 
@@ -2159,6 +2822,7 @@ reader_thread (gpointer data)
         running = FALSE;
         break;
       default:
+        gst_ipc_pipeline_comm_write_pending_releases (comm);
         read_many (comm);
         break;
     }
@@ -2203,6 +2867,8 @@ gst_ipc_pipeline_comm_stop_reader_thread (GstIpcPipelineComm * comm)
   gst_poll_set_flushing (comm->poll, TRUE);
   g_thread_join (comm->reader_thread);
   comm->reader_thread = NULL;
+  close_received_fds (comm);
+  clear_cached_memories (comm);
 }
 
 static gchar *
@@ -51,6 +51,8 @@ typedef enum {
   GST_IPC_PIPELINE_COMM_DATA_TYPE_STATE_LOST,
   GST_IPC_PIPELINE_COMM_DATA_TYPE_MESSAGE,
   GST_IPC_PIPELINE_COMM_DATA_TYPE_GERROR_MESSAGE,
+  GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_FDS,
+  GST_IPC_PIPELINE_COMM_DATA_TYPE_BUFFER_RELEASE,
 } GstIpcPipelineCommDataType;
 
 typedef struct
@@ -76,6 +78,20 @@ typedef struct
   guint read_chunk_size;
   GstClockTime ack_time;
 
+  /* fd passing, only possible over unix sockets */
+  int checked_fdout;
+  gboolean fdout_is_socket;
+  gboolean fdin_is_socket;
+  GArray *received_fds;
+  GHashTable *exported_buffers;
+  GstAllocator *fd_allocator;
+  GstAllocator *dmabuf_allocator;
+  /* ids of the imported buffers to release, written by the reader thread */
+  GstAtomicQueue *released_ids;
+  gint releases_pending;
+  /* imported memories kept for reuse, most recently used first */
+  GQueue cached_memories;
+
   void (*on_buffer) (guint32, GstBuffer *, gpointer);
   void (*on_event) (guint32, GstEvent *, gboolean, gpointer);
   void (*on_query) (guint32, GstQuery *, gboolean, gpointer);
@@ -92,6 +108,7 @@ void gst_ipc_pipeline_comm_init (GstIpcPipelineComm *comm, GstElement *e);
 void gst_ipc_pipeline_comm_clear (GstIpcPipelineComm *comm);
 void gst_ipc_pipeline_comm_cancel (GstIpcPipelineComm * comm,
     gboolean flushing);
+gboolean gst_ipc_pipeline_comm_can_pass_fds (GstIpcPipelineComm * comm);
 
 void gst_ipc_pipeline_comm_write_flow_ack_to_fd (GstIpcPipelineComm * comm,
     guint32 id, GstFlowReturn ret);
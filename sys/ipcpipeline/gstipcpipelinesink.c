@@ -66,7 +66,10 @@
  * GError are serialized differently).
  *
  * Buffers are transported by writing their content directly on the socket.
- * More efficient ways for memory sharing could be implemented in the future.
+ * When the fds are unix sockets, memories backed by a fd (memfd, shm or
+ * dmabuf) are passed by fd instead, and kept alive until the slave has
+ * released them. ipcpipelinesink proposes a memfd backed allocator upstream
+ * in that case, so that raw video frames are not copied at all.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -75,6 +78,7 @@
 
 #include "gstipcpipelineelements.h"
 #include "gstipcpipelinesink.h"
+#include "gstipcpipelineallocator.h"
 
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -217,6 +221,7 @@ gst_ipc_pipeline_sink_init (GstIpcPipelineSink * sink)
   sink->comm.fdin = -1;
   sink->comm.fdout = -1;
   sink->threads = g_thread_pool_new (pusher, sink, -1, FALSE, NULL);
+  sink->allocator = gst_ipc_pipeline_memfd_allocator_new ();
   gst_ipc_pipeline_sink_start_reader_thread (sink);
 
   pad_template =
@@ -252,6 +257,7 @@ gst_ipc_pipeline_sink_finalize (GObject * obj)
 
   gst_ipc_pipeline_comm_clear (&sink->comm);
   g_thread_pool_free (sink->threads, TRUE, TRUE);
+  gst_object_unref (sink->allocator);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -348,8 +354,22 @@ gst_ipc_pipeline_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
 
   switch (GST_QUERY_TYPE (query)) {
     case GST_QUERY_ALLOCATION:
-      GST_DEBUG_OBJECT (sink, "Rejecting ALLOCATION query");
-      return FALSE;
+    {
+      gboolean can_pass_fds;
+
+      g_mutex_lock (&sink->comm.mutex);
+      can_pass_fds = gst_ipc_pipeline_comm_can_pass_fds (&sink->comm);
+      g_mutex_unlock (&sink->comm.mutex);
+
+      if (!can_pass_fds) {
+        GST_DEBUG_OBJECT (sink, "Rejecting ALLOCATION query");
+        return FALSE;
+      }
+
+      GST_DEBUG_OBJECT (sink, "Proposing memfd allocator");
+      gst_query_add_allocation_param (query, sink->allocator, NULL);
+      return TRUE;
+    }
     case GST_QUERY_CAPS:
     {
       /* caps queries occur even while linking the pipeline.
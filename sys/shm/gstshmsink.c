@@ -58,7 +58,11 @@ enum
   PROP_PERMS,
   PROP_SHM_SIZE,
   PROP_WAIT_FOR_CONNECTION,
-  PROP_BUFFER_TIME
+  PROP_BUFFER_TIME,
+  PROP_RING_SIZE,
+  PROP_HIGH_WATER_MARK,
+  PROP_FRAGMENTATION,
+  PROP_RING_PUBLISHED
 };
 
 struct GstShmClient
@@ -69,6 +73,8 @@ struct GstShmClient
 
 #define DEFAULT_SIZE ( 64 * 1024 * 1024 )
 #define DEFAULT_WAIT_FOR_CONNECTION (TRUE)
+#define DEFAULT_RING_SIZE 0
+#define MAX_RING_SIZE 65536
 /* Default is user read/write, group read */
 #define DEFAULT_PERMS ( S_IRUSR | S_IWUSR | S_IRGRP )
 
@@ -357,6 +363,7 @@ gst_shm_sink_init (GstShmSink * self)
   self->unlock = FALSE;
   self->wait_for_connection = DEFAULT_WAIT_FOR_CONNECTION;
   self->perms = DEFAULT_PERMS;
+  self->ring_size = DEFAULT_RING_SIZE;
 
   gst_allocation_params_init (&self->params);
 }
@@ -419,6 +426,67 @@ gst_shm_sink_class_init (GstShmSinkClass * klass)
           -1, G_MAXINT64, -1,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstShmSink:ring-size:
+   *
+   * Number of slots of a ring in shared memory that buffers are published
+   * in, rounded up to a power of two. Clients then get and release buffers
+   * without any message on the control socket, but they must all be
+   * shmsrc 1.20 or newer. 0 sends every buffer over the control socket.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_RING_SIZE,
+      g_param_spec_uint ("ring-size",
+          "Size of the buffer ring",
+          "Number of slots of the buffer ring shared with the clients, "
+          "0 to send the buffers over the control socket. This may be "
+          "modified during the NULL->READY transition",
+          0, MAX_RING_SIZE, DEFAULT_RING_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstShmSink:high-water-mark:
+   *
+   * Largest number of bytes that were allocated at the same time in the
+   * current shared memory area.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_HIGH_WATER_MARK,
+      g_param_spec_uint64 ("high-water-mark",
+          "High water mark",
+          "Largest number of bytes allocated at once in the shared memory area",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstShmSink:fragmentation:
+   *
+   * Share of the free space of the shared memory area that is not in its
+   * largest free extent, from 0 (not fragmented) to 1.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_FRAGMENTATION,
+      g_param_spec_double ("fragmentation",
+          "Fragmentation",
+          "Share of the free space that is not in the largest free extent",
+          0.0, 1.0, 0.0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstShmSink:ring-published:
+   *
+   * Number of buffers that were published in the buffer ring, rather than
+   * sent over the control socket.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_RING_PUBLISHED,
+      g_param_spec_uint64 ("ring-published",
+          "Buffers published in the ring",
+          "Number of buffers that were published in the buffer ring",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   signals[SIGNAL_CLIENT_CONNECTED] = g_signal_new ("client-connected",
       GST_TYPE_SHM_SINK, G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
       G_TYPE_NONE, 1, G_TYPE_INT);
@@ -507,6 +575,11 @@ gst_shm_sink_set_property (GObject * object, guint prop_id,
       GST_OBJECT_UNLOCK (object);
       g_cond_broadcast (&self->cond);
       break;
+    case PROP_RING_SIZE:
+      GST_OBJECT_LOCK (object);
+      self->ring_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (object);
+      break;
     default:
       break;
   }
@@ -536,6 +609,21 @@ gst_shm_sink_get_property (GObject * object, guint prop_id,
     case PROP_BUFFER_TIME:
       g_value_set_int64 (value, self->buffer_time);
       break;
+    case PROP_RING_SIZE:
+      g_value_set_uint (value, self->ring_size);
+      break;
+    case PROP_HIGH_WATER_MARK:
+      g_value_set_uint64 (value,
+          self->pipe ? sp_writer_get_high_water_mark (self->pipe) : 0);
+      break;
+    case PROP_FRAGMENTATION:
+      g_value_set_double (value,
+          self->pipe ? sp_writer_get_fragmentation (self->pipe) : 0.0);
+      break;
+    case PROP_RING_PUBLISHED:
+      g_value_set_uint64 (value,
+          self->pipe ? sp_writer_ring_get_published (self->pipe) : 0);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -577,12 +665,25 @@ gst_shm_sink_start (GstBaseSink * bsink)
 
   GST_DEBUG ("Created socket at %s", self->socket_path);
 
+  if (self->ring_size > 0 &&
+      sp_writer_enable_ring (self->pipe, self->ring_size) < 0)
+    GST_ELEMENT_WARNING (self, RESOURCE, OPEN_READ_WRITE,
+        ("Could not create the buffer ring, buffers will be sent over the "
+            "control socket"), (NULL));
+
   self->poll = gst_poll_new (TRUE);
   gst_poll_fd_init (&self->serverpollfd);
   self->serverpollfd.fd = sp_get_fd (self->pipe);
   gst_poll_add_fd (self->poll, &self->serverpollfd);
   gst_poll_fd_ctl_read (self->poll, &self->serverpollfd, TRUE);
 
+  gst_poll_fd_init (&self->ringpollfd);
+  if (sp_writer_get_ring_fd (self->pipe) >= 0) {
+    self->ringpollfd.fd = sp_writer_get_ring_fd (self->pipe);
+    gst_poll_add_fd (self->poll, &self->ringpollfd);
+    gst_poll_fd_ctl_read (self->poll, &self->ringpollfd, TRUE);
+  }
+
   self->pollthread =
       g_thread_try_new ("gst-shmsink-poll-thread", pollthread_func, self, &err);
 
@@ -642,6 +743,37 @@ gst_shm_sink_stop (GstBaseSink * bsink)
   return TRUE;
 }
 
+static void
+free_buffer_locked (GstBuffer * buffer, void *data)
+{
+  GSList **list = data;
+
+  g_assert (buffer != NULL);
+
+  *list = g_slist_prepend (*list, buffer);
+}
+
+/* Waits for the poll thread to signal that something changed, after
+ * asking the ring clients to wake it up when they release a buffer. If
+ * they already did, the buffers are freed here, with the object lock
+ * released, instead of waiting. */
+static void
+gst_shm_sink_wait_locked (GstShmSink * self)
+{
+  GSList *list = NULL;
+
+  if (!sp_writer_ring_want_release (self->pipe)) {
+    g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+    return;
+  }
+
+  sp_writer_ring_reclaim (self->pipe,
+      (sp_buffer_free_callback) free_buffer_locked, (void **) &list);
+  GST_OBJECT_UNLOCK (self);
+  g_slist_free_full (list, (GDestroyNotify) gst_buffer_unref);
+  GST_OBJECT_LOCK (self);
+}
+
 static gboolean
 gst_shm_sink_can_render (GstShmSink * self, GstClockTime time)
 {
@@ -691,7 +823,7 @@ gst_shm_sink_render (GstBaseSink * bsink, GstBuffer * buf)
   }
 
   while (!gst_shm_sink_can_render (self, GST_BUFFER_TIMESTAMP (buf))) {
-    g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+    gst_shm_sink_wait_locked (self);
     if (self->unlock) {
       GST_OBJECT_UNLOCK (self);
       ret = gst_base_sink_wait_preroll (bsink);
@@ -730,7 +862,7 @@ gst_shm_sink_render (GstBaseSink * bsink, GstBuffer * buf)
     while ((memory =
             gst_shm_sink_allocator_alloc_locked (self->allocator,
                 gst_buffer_get_size (buf), &self->params)) == NULL) {
-      g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+      gst_shm_sink_wait_locked (self);
       if (self->unlock) {
         GST_OBJECT_UNLOCK (self);
         ret = gst_base_sink_wait_preroll (bsink);
@@ -780,6 +912,20 @@ gst_shm_sink_render (GstBaseSink * bsink, GstBuffer * buf)
     sendbuf = gst_buffer_ref (buf);
   }
 
+  while (!sp_writer_ring_can_publish (self->pipe)) {
+    gst_shm_sink_wait_locked (self);
+    if (self->unlock) {
+      GST_OBJECT_UNLOCK (self);
+      ret = gst_base_sink_wait_preroll (bsink);
+      if (ret == GST_FLOW_OK) {
+        GST_OBJECT_LOCK (self);
+      } else {
+        gst_buffer_unref (sendbuf);
+        return ret;
+      }
+    }
+  }
+
   if (!gst_buffer_map (sendbuf, &map, GST_MAP_READ)) {
     GST_ELEMENT_ERROR (self, STREAM, FAILED,
         (NULL), ("Failed to map data into send buffer"));
@@ -814,16 +960,6 @@ error:
   return GST_FLOW_ERROR;
 }
 
-static void
-free_buffer_locked (GstBuffer * buffer, void *data)
-{
-  GSList **list = data;
-
-  g_assert (buffer != NULL);
-
-  *list = g_slist_prepend (*list, buffer);
-}
-
 static gpointer
 pollthread_func (gpointer data)
 {
@@ -894,6 +1030,17 @@ pollthread_func (gpointer data)
       continue;
     }
 
+    if (self->ringpollfd.fd >= 0 &&
+        gst_poll_fd_can_read (self->poll, &self->ringpollfd)) {
+      GSList *list = NULL;
+
+      GST_OBJECT_LOCK (self);
+      sp_writer_ring_reclaim (self->pipe,
+          (sp_buffer_free_callback) free_buffer_locked, (void **) &list);
+      GST_OBJECT_UNLOCK (self);
+      g_slist_free_full (list, (GDestroyNotify) gst_buffer_unref);
+    }
+
   again:
     for (item = self->clients; item; item = item->next) {
       struct GstShmClient *gclient = item->data;
@@ -964,7 +1111,7 @@ gst_shm_sink_event (GstBaseSink * bsink, GstEvent * event)
       GST_OBJECT_LOCK (self);
       while (self->wait_for_connection && sp_writer_pending_writes (self->pipe)
           && !self->unlock)
-        g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+        gst_shm_sink_wait_locked (self);
       GST_OBJECT_UNLOCK (self);
       break;
     default:
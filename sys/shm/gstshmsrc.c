@@ -153,6 +153,7 @@ gst_shm_src_init (GstShmSrc * self)
 {
   self->poll = gst_poll_new (TRUE);
   gst_poll_fd_init (&self->pollfd);
+  gst_poll_fd_init (&self->ringpollfd);
 }
 
 static void
@@ -341,6 +342,20 @@ gst_shm_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
   GST_OBJECT_UNLOCK (self);
 
   do {
+    /* Buffers in the ring are only signalled if we said we would wait */
+    if (self->ringpollfd.fd >= 0) {
+      GST_OBJECT_LOCK (self);
+      rv = sp_client_ring_recv (pipe->pipe, &buf);
+      GST_OBJECT_UNLOCK (self);
+      if (rv < 0) {
+        GST_ELEMENT_ERROR (self, RESOURCE, READ, ("Failed to read from shmsrc"),
+            ("Error reading from the buffer ring: %d", rv));
+        goto error;
+      }
+      if (buf)
+        break;
+    }
+
     if (gst_poll_wait (self->poll, GST_CLOCK_TIME_NONE) < 0) {
       if (errno == EBUSY)
         goto flushing;
@@ -375,6 +390,13 @@ gst_shm_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
             ("Error reading control data: %d", rv));
         goto error;
       }
+
+      if (self->ringpollfd.fd < 0 && sp_client_get_ring_fd (pipe->pipe) >= 0) {
+        GST_DEBUG_OBJECT (self, "Getting buffers from the ring");
+        self->ringpollfd.fd = sp_client_get_ring_fd (pipe->pipe);
+        gst_poll_add_fd (self->poll, &self->ringpollfd);
+        gst_poll_fd_ctl_read (self->poll, &self->ringpollfd, TRUE);
+      }
     }
   } while (buf == NULL);
 
@@ -473,6 +495,10 @@ gst_shm_pipe_dec (GstShmPipe * pipe)
   gst_poll_remove_fd (pipe->src->poll, &pipe->src->pollfd);
   gst_poll_fd_init (&pipe->src->pollfd);
 
+  if (pipe->src->ringpollfd.fd >= 0)
+    gst_poll_remove_fd (pipe->src->poll, &pipe->src->ringpollfd);
+  gst_poll_fd_init (&pipe->src->ringpollfd);
+
   GST_OBJECT_UNLOCK (pipe->src);
 
   gst_object_unref (pipe->src);
@@ -52,6 +52,7 @@ struct _GstShmSrc
   GstShmPipe *pipe;
   GstPoll *poll;
   GstPollFD pollfd;
+  GstPollFD ringpollfd;
 
 
   GstFlowReturn flow_return;
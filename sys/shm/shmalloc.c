@@ -22,7 +22,6 @@
  * THE SOFTWARE.
  */
 
-
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -33,14 +32,41 @@
 #include <string.h>
 #include <assert.h>
 
+/* Granularity of the offset index */
+#define SHM_ALLOC_INDEX_SHIFT 12
+
+/* Allocations of the same size in a row before they get a slab */
+#define SHM_ALLOC_SLAB_THRESHOLD 3
+#define SHM_ALLOC_SLAB_SLOTS 16
+#define SHM_ALLOC_SLAB_ALIGN 64
+#define SHM_ALLOC_MAX_SLABS 4
+
+#define ROUND_UP(size, align) (((size) + (align) - 1) & ~((unsigned long) (align) - 1))
+
+typedef struct _ShmAllocSlab ShmAllocSlab;
+
 /* This is the allocated space to hold multiple blocks */
 struct _ShmAllocSpace
 {
   /* The total size of this space */
   size_t size;
 
-  /* chained list of the blocks contained in this space */
+  /* chained list of the blocks contained in this space, sorted by offset */
   ShmAllocBlock *blocks;
+
+  /* For each page of the space, the first block of the list that ends
+   * after the start of the page */
+  ShmAllocBlock **index;
+  unsigned long n_pages;
+
+  /* Slabs for the sizes that are allocated over and over */
+  ShmAllocSlab *slabs[SHM_ALLOC_MAX_SLABS];
+  unsigned long last_size;
+  unsigned int same_size_count;
+
+  /* Bytes handed out */
+  unsigned long used;
+  unsigned long high_water_mark;
 };
 
 /* A single block of data */
@@ -56,10 +82,30 @@ struct _ShmAllocBlock
   /* The size of the block */
   unsigned long size;
 
-  /* Pointer to the next block in the chain */
+  /* The slab this block is a slot of, those are not in the chain */
+  ShmAllocSlab *slab;
+  /* The slab that is carved out of this block */
+  ShmAllocSlab *carried_slab;
+
+  /* Pointers to the previous and next blocks in the chain */
+  ShmAllocBlock *prev;
   ShmAllocBlock *next;
 };
 
+/* Fixed size slots carved out of a single block, with a stack of the free
+ * ones */
+struct _ShmAllocSlab
+{
+  ShmAllocBlock *carrier;
+
+  unsigned long slot_size;
+  unsigned int n_slots;
+  ShmAllocBlock *slots;
+
+  unsigned int *free_slots;
+  unsigned int n_free;
+};
+
 
 ShmAllocSpace *
 shm_alloc_space_new (size_t size)
@@ -69,20 +115,49 @@ shm_alloc_space_new (size_t size)
   memset (self, 0, sizeof (ShmAllocSpace));
 
   self->size = size;
+  self->n_pages = ((size - 1) >> SHM_ALLOC_INDEX_SHIFT) + 1;
+  self->index = calloc (self->n_pages, sizeof (ShmAllocBlock *));
 
   return self;
 }
 
+static void shm_alloc_space_free_slab (ShmAllocSpace * self,
+    ShmAllocSlab * slab);
+
 void
 shm_alloc_space_free (ShmAllocSpace * self)
 {
-  assert (self && self->blocks == NULL);
+  int i;
+
+  assert (self);
+
+  for (i = 0; i < SHM_ALLOC_MAX_SLABS; i++) {
+    if (self->slabs[i])
+      shm_alloc_space_free_slab (self, self->slabs[i]);
+  }
+
+  assert (self->blocks == NULL);
+  free (self->index);
   spalloc_free (ShmAllocSpace, self);
 }
 
+/* Points the index entries of the pages starting in [start, end) to
+ * @block */
+static void
+shm_alloc_space_index_set (ShmAllocSpace * self, unsigned long start,
+    unsigned long end, ShmAllocBlock * block)
+{
+  unsigned long page = ROUND_UP (start, 1UL << SHM_ALLOC_INDEX_SHIFT) >>
+      SHM_ALLOC_INDEX_SHIFT;
+  unsigned long end_page = ROUND_UP (end, 1UL << SHM_ALLOC_INDEX_SHIFT) >>
+      SHM_ALLOC_INDEX_SHIFT;
 
-ShmAllocBlock *
-shm_alloc_space_alloc_block (ShmAllocSpace * self, unsigned long size)
+  for (; page < end_page && page < self->n_pages; page++)
+    self->index[page] = block;
+}
+
+static ShmAllocBlock *
+shm_alloc_space_alloc_from_list (ShmAllocSpace * self, unsigned long size)
 {
   ShmAllocBlock *block;
   ShmAllocBlock *item = NULL;
@@ -120,7 +195,178 @@ shm_alloc_space_alloc_block (ShmAllocSpace * self, unsigned long size)
   else
     self->blocks = block;
 
+  block->prev = prev_item;
   block->next = item;
+  if (item)
+    item->prev = block;
+
+  shm_alloc_space_index_set (self, prev_end_offset, block->offset + size,
+      block);
+
+  return block;
+}
+
+static void
+shm_alloc_space_free_to_list (ShmAllocSpace * self, ShmAllocBlock * block)
+{
+  unsigned long prev_end_offset = 0;
+
+  if (block->prev) {
+    prev_end_offset = block->prev->offset + block->prev->size;
+    block->prev->next = block->next;
+  } else {
+    self->blocks = block->next;
+  }
+
+  if (block->next)
+    block->next->prev = block->prev;
+
+  shm_alloc_space_index_set (self, prev_end_offset,
+      block->offset + block->size, block->next);
+
+  spalloc_free (ShmAllocBlock, block);
+}
+
+static ShmAllocSlab *
+shm_alloc_space_new_slab (ShmAllocSpace * self, unsigned long slot_size)
+{
+  ShmAllocSlab *slab;
+  ShmAllocBlock *carrier = NULL;
+  unsigned int n_slots;
+  unsigned int i;
+  int pos;
+
+  for (pos = 0; pos < SHM_ALLOC_MAX_SLABS; pos++) {
+    if (!self->slabs[pos])
+      break;
+  }
+
+  /* Make room by dropping an unused slab */
+  if (pos == SHM_ALLOC_MAX_SLABS) {
+    for (pos = 0; pos < SHM_ALLOC_MAX_SLABS; pos++) {
+      if (self->slabs[pos]->n_free == self->slabs[pos]->n_slots)
+        break;
+    }
+    if (pos == SHM_ALLOC_MAX_SLABS)
+      return NULL;
+    shm_alloc_space_free_slab (self, self->slabs[pos]);
+  }
+
+  /* Take as much as there is room for, a slab of 1 is pointless */
+  for (n_slots = SHM_ALLOC_SLAB_SLOTS; n_slots >= 2; n_slots /= 2) {
+    if (slot_size > self->size / n_slots)
+      continue;
+    carrier = shm_alloc_space_alloc_from_list (self, slot_size * n_slots);
+    if (carrier)
+      break;
+  }
+
+  if (!carrier)
+    return NULL;
+
+  slab = spalloc_new (ShmAllocSlab);
+  slab->carrier = carrier;
+  slab->slot_size = slot_size;
+  slab->n_slots = n_slots;
+  slab->slots = calloc (n_slots, sizeof (ShmAllocBlock));
+  slab->free_slots = malloc (n_slots * sizeof (unsigned int));
+  slab->n_free = n_slots;
+
+  for (i = 0; i < n_slots; i++) {
+    slab->slots[i].space = self;
+    slab->slots[i].offset = carrier->offset + i * slot_size;
+    slab->slots[i].slab = slab;
+    /* Hand out the first slots first */
+    slab->free_slots[i] = n_slots - 1 - i;
+  }
+
+  carrier->carried_slab = slab;
+  self->slabs[pos] = slab;
+
+  return slab;
+}
+
+static void
+shm_alloc_space_free_slab (ShmAllocSpace * self, ShmAllocSlab * slab)
+{
+  int i;
+
+  assert (slab->n_free == slab->n_slots);
+
+  for (i = 0; i < SHM_ALLOC_MAX_SLABS; i++) {
+    if (self->slabs[i] == slab)
+      self->slabs[i] = NULL;
+  }
+
+  shm_alloc_space_free_to_list (self, slab->carrier);
+  free (slab->slots);
+  free (slab->free_slots);
+  spalloc_free (ShmAllocSlab, slab);
+}
+
+/* Frees the slabs with nothing allocated from them, except @keep */
+static int
+shm_alloc_space_release_slabs (ShmAllocSpace * self, ShmAllocSlab * keep)
+{
+  int released = 0;
+  int i;
+
+  for (i = 0; i < SHM_ALLOC_MAX_SLABS; i++) {
+    ShmAllocSlab *slab = self->slabs[i];
+
+    if (slab && slab != keep && slab->n_free == slab->n_slots) {
+      shm_alloc_space_free_slab (self, slab);
+      released++;
+    }
+  }
+
+  return released;
+}
+
+ShmAllocBlock *
+shm_alloc_space_alloc_block (ShmAllocSpace * self, unsigned long size)
+{
+  ShmAllocBlock *block = NULL;
+  ShmAllocSlab *slab = NULL;
+  unsigned long slot_size = ROUND_UP (size, SHM_ALLOC_SLAB_ALIGN);
+  int i;
+
+  if (slot_size == self->last_size) {
+    self->same_size_count++;
+  } else {
+    self->last_size = slot_size;
+    self->same_size_count = 1;
+  }
+
+  if (size > 0) {
+    for (i = 0; i < SHM_ALLOC_MAX_SLABS; i++) {
+      if (self->slabs[i] && self->slabs[i]->slot_size == slot_size) {
+        slab = self->slabs[i];
+        break;
+      }
+    }
+
+    if (!slab && self->same_size_count >= SHM_ALLOC_SLAB_THRESHOLD)
+      slab = shm_alloc_space_new_slab (self, slot_size);
+  }
+
+  if (slab && slab->n_free > 0) {
+    block = &slab->slots[slab->free_slots[--slab->n_free]];
+    block->use_count = 1;
+    block->size = size;
+  } else {
+    block = shm_alloc_space_alloc_from_list (self, size);
+    /* Slabs for sizes that are no longer used might be in the way */
+    if (!block && shm_alloc_space_release_slabs (self, slab))
+      block = shm_alloc_space_alloc_from_list (self, size);
+  }
+
+  if (!block)
+    return NULL;
+
+  self->used += size;
+  if (self->used > self->high_water_mark)
+    self->high_water_mark = self->used;
 
   return block;
 }
@@ -134,35 +380,46 @@ shm_alloc_space_alloc_block_get_offset (ShmAllocBlock * block)
 static void
 shm_alloc_space_free_block (ShmAllocBlock * block)
 {
-  ShmAllocBlock *item = NULL;
-  ShmAllocBlock *prev_item = NULL;
   ShmAllocSpace *self = block->space;
+  ShmAllocSlab *slab = block->slab;
 
-  for (item = self->blocks; item; item = item->next) {
-    if (item == block) {
-      if (prev_item)
-        prev_item->next = item->next;
-      else
-        self->blocks = item->next;
-      break;
-    }
-    prev_item = item;
-  }
+  self->used -= block->size;
 
-  spalloc_free (ShmAllocBlock, block);
+  if (slab) {
+    block->use_count = 0;
+    slab->free_slots[slab->n_free++] = block - slab->slots;
+  } else {
+    shm_alloc_space_free_to_list (self, block);
+  }
 }
 
 ShmAllocBlock *
 shm_alloc_space_block_get (ShmAllocSpace * self, unsigned long offset)
 {
   ShmAllocBlock *block = NULL;
+  ShmAllocSlab *slab;
+
+  if (offset >= self->size)
+    return NULL;
+
+  /* At most the blocks that fit in one page are walked */
+  for (block = self->index[offset >> SHM_ALLOC_INDEX_SHIFT]; block;
+      block = block->next) {
+    if (block->offset + block->size > offset)
+      break;
+  }
 
-  for (block = self->blocks; block; block = block->next) {
-    if (block->offset <= offset && (block->offset + block->size) > offset)
-      return block;
+  if (!block || block->offset > offset)
+    return NULL;
+
+  slab = block->carried_slab;
+  if (slab) {
+    block = &slab->slots[(offset - block->offset) / slab->slot_size];
+    if (block->use_count <= 0 || block->offset + block->size <= offset)
+      return NULL;
   }
 
-  return NULL;
+  return block;
 }
 
 
@@ -180,3 +437,50 @@ shm_alloc_space_block_dec (ShmAllocBlock * block)
   if (block->use_count <= 0)
     shm_alloc_space_free_block (block);
 }
+
+unsigned long
+shm_alloc_space_get_high_water_mark (ShmAllocSpace * self)
+{
+  return self->high_water_mark;
+}
+
+/* Share of the free space that is outside of the largest free extent,
+ * the free slots of the slabs are extents of their own */
+double
+shm_alloc_space_get_fragmentation (ShmAllocSpace * self)
+{
+  ShmAllocBlock *item;
+  unsigned long prev_end_offset = 0;
+  unsigned long total_free = 0;
+  unsigned long largest_free = 0;
+  int i;
+
+  for (item = self->blocks;; item = item->next) {
+    unsigned long end = item ? item->offset : self->size;
+    unsigned long gap = end - prev_end_offset;
+
+    total_free += gap;
+    if (gap > largest_free)
+      largest_free = gap;
+
+    if (!item)
+      break;
+    prev_end_offset = item->offset + item->size;
+  }
+
+  for (i = 0; i < SHM_ALLOC_MAX_SLABS; i++) {
+    ShmAllocSlab *slab = self->slabs[i];
+
+    if (!slab || slab->n_free == 0)
+      continue;
+
+    total_free += slab->n_free * slab->slot_size;
+    if (slab->slot_size > largest_free)
+      largest_free = slab->slot_size;
+  }
+
+  if (total_free == 0)
+    return 0.0;
+
+  return 1.0 - (double) largest_free / total_free;
+}
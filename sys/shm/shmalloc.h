@@ -66,6 +66,9 @@ void shm_alloc_space_block_dec (ShmAllocBlock * block);
 ShmAllocBlock * shm_alloc_space_block_get (ShmAllocSpace * space,
     unsigned long offset);
 
+unsigned long shm_alloc_space_get_high_water_mark (ShmAllocSpace * self);
+double shm_alloc_space_get_fragmentation (ShmAllocSpace * self);
+
 
 #ifdef __cplusplus
 }
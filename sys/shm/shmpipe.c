@@ -49,6 +49,13 @@
 
 #include "shmalloc.h"
 
+/* The ring needs eventfd for the wakeups and the GCC atomic builtins to
+ * share the cursors */
+#if defined (HAVE_SYS_EVENTFD_H) && defined (__ATOMIC_SEQ_CST)
+#define SHM_PIPE_HAVE_RING 1
+#include <sys/eventfd.h>
+#endif
+
 /*
  * The protocol over the pipe is in packets
  *
@@ -59,6 +66,7 @@
  *
  * type 2: Close shm area:
  * No payload
+ * Only sent once no buffer can be sent from the area anymore
  *
  * type 3: shm buffer
  * offset
@@ -67,9 +75,27 @@
  * type 4: ack buffer
  * offset
  *
+ * type 5: new ring
+ * The area_id is the index of the consumer cursor of the client
+ * Ring area length
+ * Size of path (followed by path)
+ * Carries the eventfd used to wake up the client and the one used to wake
+ * up the server as SCM_RIGHTS
+ *
  * Type 4 goes from the client to the server
  * The rest are from the server to the client
- * The client should never write in the SHM
+ * The client should never write in the SHM, except for its cursor in the
+ * ring area
+ *
+ * If the server has a ring, it is offered to every client when it connects
+ * and buffers are then published in the ring instead of being sent as type
+ * 3 packets. The ring is a single producer, multiple consumer array of
+ * fixed size slots, one per buffer. Each client has its own read cursor in
+ * the ring area, the server reclaims the slots (and the buffers in them)
+ * once every client cursor went past them, so no ack is sent either. The
+ * eventfds are only written to when the other side announced that it is
+ * about to sleep. Slots only point to the current area, buffers from an
+ * area older than that are sent as type 3 packets to every client.
  */
 
 
@@ -80,9 +106,55 @@ enum
   COMMAND_NEW_SHM_AREA = 1,
   COMMAND_CLOSE_SHM_AREA = 2,
   COMMAND_NEW_BUFFER = 3,
-  COMMAND_ACK_BUFFER = 4
+  COMMAND_ACK_BUFFER = 4,
+  COMMAND_NEW_RING = 5
 };
 
+/* Everything that is written to by different sides lives in its own
+ * cache line */
+#define SHM_RING_CACHELINE 64
+#define SHM_RING_MAGIC 0x53485252       /* SHRR */
+#define SHM_RING_MAX_CONSUMERS 32
+#define SHM_RING_MAX_SLOTS 65536
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t n_slots;
+  uint32_t max_consumers;
+  /* Set by the server before it waits for slots to be released */
+  uint32_t writer_waiting;
+  char padding0[SHM_RING_CACHELINE - 4 * sizeof (uint32_t)];
+
+  /* Sequence number of the next slot the server will publish */
+  uint64_t write_seq;
+  char padding1[SHM_RING_CACHELINE - sizeof (uint64_t)];
+} ShmRingHeader;
+
+typedef struct
+{
+  /* Every slot before this one was released by the client */
+  uint64_t read_seq;
+  /* Set by the client before it waits on its eventfd */
+  uint32_t waiting;
+  char padding[SHM_RING_CACHELINE - sizeof (uint64_t) - sizeof (uint32_t)];
+} ShmRingConsumer;
+
+typedef struct
+{
+  uint64_t seq;
+  uint64_t offset;
+  uint64_t size;
+  int32_t area_id;
+  char padding[SHM_RING_CACHELINE - 3 * sizeof (uint64_t) - sizeof (int32_t)];
+} ShmRingSlot;
+
+/* The ring area is a header followed by the consumer cursors and the
+ * slots */
+#define SHM_RING_AREA_SIZE(n_slots) (sizeof (ShmRingHeader) + \
+    SHM_RING_MAX_CONSUMERS * sizeof (ShmRingConsumer) + \
+    (n_slots) * sizeof (ShmRingSlot))
+
 typedef struct _ShmArea ShmArea;
 
 struct _ShmArea
@@ -101,6 +173,11 @@ struct _ShmArea
 
   ShmAllocSpace *allocspace;
 
+  /* On a client with a ring, the area was closed by the server but ring
+   * slots published before ring_close_seq can still point into it */
+  int ring_closing;
+  uint64_t ring_close_seq;
+
   ShmArea *next;
 };
 
@@ -118,6 +195,9 @@ struct _ShmBuffer
 
   void *tag;
 
+  /* Also published in the ring, until all consumers went past it */
+  int in_ring;
+
   int num_clients;
   /* This must ALWAYS stay last in the struct */
   int clients[0];
@@ -141,12 +221,46 @@ struct _ShmPipe
   ShmClient *clients;
 
   mode_t perms;
+
+  /* Ring shared by the server and the clients, NULL if not used */
+  ShmArea *ring_area;
+  ShmRingHeader *ring;
+  ShmRingConsumer *ring_consumers;
+  ShmRingSlot *ring_slots;
+  uint64_t ring_mask;
+  /* eventfd written to by the clients when the server waits */
+  int ring_release_fd;
+
+  /* Server side: the buffer published in each slot, the next slot to
+   * publish and the oldest slot that wasn't reclaimed */
+  ShmBuffer **ring_buffers;
+  uint64_t ring_head;
+  uint64_t ring_tail;
+  uint32_t ring_used_consumers;
+  int ring_num_consumers;
+
+  /* Client side: our cursor, the eventfd we are woken up with, the next
+   * slot to read and the buffers handed out, which are released in order */
+  int ring_index;
+  int ring_fd;
+  uint64_t ring_next;
+  uint64_t ring_released;
+  char **ring_bufs;
+  unsigned char *ring_done;
 };
 
 struct _ShmClient
 {
   int fd;
 
+  /* Index of the ring cursor of this client, -1 if it gets every buffer
+   * over the socket */
+  int ring_index;
+  int ring_fd;
+
+  /* Current area when the client connected, it doesn't know older ones */
+  int first_area_id;
+
   ShmClient *next;
 };
 
@@ -182,11 +296,19 @@ struct CommandBuffer
   } payload;
 };
 
-static ShmArea *sp_open_shm (char *path, int id, mode_t perms, size_t size);
+static ShmArea *sp_open_shm (char *path, int id, mode_t perms, size_t size,
+    int ring);
 static void sp_close_shm (ShmArea * area);
 static int sp_shmbuf_dec (ShmPipe * self, ShmBuffer * buf,
     ShmBuffer * prev_buf, ShmClient * client, void **tag);
 static void sp_shm_area_dec (ShmPipe * self, ShmArea * area);
+static int send_command (int fd, struct CommandBuffer *cb,
+    unsigned short int type, int area_id);
+#ifdef SHM_PIPE_HAVE_RING
+static int sp_shmbuf_release_ring (ShmPipe * self, ShmBuffer * buf,
+    void **tag);
+#endif
+static void sp_ring_close (ShmPipe * self);
 
 
 
@@ -208,6 +330,9 @@ sp_writer_create (const char *path, size_t size, mode_t perms)
 
   self->main_socket = socket (PF_UNIX, SOCK_STREAM, 0);
   self->use_count = 1;
+  self->ring_release_fd = -1;
+  self->ring_index = -1;
+  self->ring_fd = -1;
 
   if (self->main_socket < 0)
     RETURN_ERROR ("Could not create socket (%d): %s\n", errno,
@@ -244,7 +369,7 @@ sp_writer_create (const char *path, size_t size, mode_t perms)
   if (listen (self->main_socket, LISTEN_BACKLOG) < 0)
     RETURN_ERROR ("listen() failed (%d): %s\n", errno, strerror (errno));
 
-  self->shm_area = sp_open_shm (NULL, ++self->next_area_id, perms, size);
+  self->shm_area = sp_open_shm (NULL, ++self->next_area_id, perms, size, 0);
 
   self->perms = perms;
 
@@ -266,12 +391,14 @@ sp_writer_create (const char *path, size_t size, mode_t perms)
 /* sp_open_shm:
  * @path: Path of the shm area for a reader,
  *  NULL if this is a writer (then it will allocate its own path)
+ * @ring: If this is the ring area, which the reader can write to and
+ *  which has no allocator
  *
  * Opens a ShmArea
  */
 
 static ShmArea *
-sp_open_shm (char *path, int id, mode_t perms, size_t size)
+sp_open_shm (char *path, int id, mode_t perms, size_t size, int ring)
 {
   ShmArea *area = spalloc_new (ShmArea);
   char tmppath[32];
@@ -290,7 +417,7 @@ sp_open_shm (char *path, int id, mode_t perms, size_t size)
 
 
   if (path)
-    flags = O_RDONLY;
+    flags = ring ? O_RDWR : O_RDONLY;
   else
 #ifdef HAVE_OSX
     flags = O_RDWR | O_CREAT | O_EXCL;
@@ -323,7 +450,7 @@ sp_open_shm (char *path, int id, mode_t perms, size_t size)
     prot = PROT_READ | PROT_WRITE;
   } else {
     area->shm_area_name = strdup (path);
-    prot = PROT_READ;
+    prot = ring ? PROT_READ | PROT_WRITE : PROT_READ;
   }
 
   area->shm_area_buf = mmap (NULL, size, prot, MAP_SHARED, area->shm_fd, 0);
@@ -333,7 +460,7 @@ sp_open_shm (char *path, int id, mode_t perms, size_t size)
 
   area->id = id;
 
-  if (!path)
+  if (!path && !ring)
     area->allocspace = shm_alloc_space_new (area->shm_area_len);
 
   return area;
@@ -379,6 +506,16 @@ sp_shm_area_dec (ShmPipe * self, ShmArea * area)
   if (area->use_count == 0) {
     ShmArea *item = NULL;
     ShmArea *prev_item = NULL;
+    ShmClient *client;
+
+    /* On the writer, the clients are only told that an area from before a
+     * resize is gone once no buffer can be sent from it anymore */
+    for (client = self->clients; client; client = client->next) {
+      struct CommandBuffer cb = { 0 };
+
+      if (area->id >= client->first_area_id)
+        send_command (client->fd, &cb, COMMAND_CLOSE_SHM_AREA, area->id);
+    }
 
     for (item = self->shm_area; item; item = item->next) {
       if (item == area) {
@@ -425,6 +562,8 @@ sp_dec (ShmPipe * self)
   while (self->shm_area)
     sp_shm_area_dec (self, self->shm_area);
 
+  sp_ring_close (self);
+
   spalloc_free (ShmPipe, self);
 }
 
@@ -465,6 +604,9 @@ sp_writer_setperms_shm (ShmPipe * self, mode_t perms)
   for (area = self->shm_area; area; area = area->next)
     ret |= fchmod (area->shm_fd, perms);
 
+  if (self->ring_area)
+    ret |= fchmod (self->ring_area->shm_fd, perms);
+
   ret |= chmod (self->socket_path, perms);
 
   return ret;
@@ -484,6 +626,380 @@ send_command (int fd, struct CommandBuffer *cb, unsigned short int type,
   return 1;
 }
 
+static void
+close_fds (int *fds, int n_fds)
+{
+  int i;
+
+  for (i = 0; i < n_fds; i++) {
+    if (fds[i] >= 0)
+      close (fds[i]);
+    fds[i] = -1;
+  }
+}
+
+static void
+sp_ring_close (ShmPipe * self)
+{
+  if (self->ring_area) {
+    self->ring_area->use_count--;
+    sp_close_shm (self->ring_area);
+    self->ring_area = NULL;
+    self->ring = NULL;
+    self->ring_consumers = NULL;
+    self->ring_slots = NULL;
+  }
+
+  free (self->ring_buffers);
+  self->ring_buffers = NULL;
+  free (self->ring_bufs);
+  self->ring_bufs = NULL;
+  free (self->ring_done);
+  self->ring_done = NULL;
+
+  close_fds (&self->ring_release_fd, 1);
+  close_fds (&self->ring_fd, 1);
+}
+
+#ifdef SHM_PIPE_HAVE_RING
+
+static void
+sp_ring_map (ShmPipe * self, ShmArea * area)
+{
+  self->ring_area = area;
+  self->ring = (ShmRingHeader *) area->shm_area_buf;
+  self->ring_consumers = (ShmRingConsumer *) (self->ring + 1);
+  self->ring_slots =
+      (ShmRingSlot *) (self->ring_consumers + SHM_RING_MAX_CONSUMERS);
+}
+
+static int
+send_command_with_fds (int fd, struct CommandBuffer *cb,
+    unsigned short int type, int area_id, int *fds, int n_fds)
+{
+  struct msghdr msg = { 0 };
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (2 * sizeof (int))];
+  } control;
+
+  assert (n_fds <= 2);
+
+  cb->type = type;
+  cb->area_id = area_id;
+
+  iov.iov_base = cb;
+  iov.iov_len = sizeof (struct CommandBuffer);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = CMSG_SPACE (n_fds * sizeof (int));
+
+  memset (&control, 0, sizeof (control));
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (n_fds * sizeof (int));
+  memcpy (CMSG_DATA (cmsg), fds, n_fds * sizeof (int));
+
+  if (sendmsg (fd, &msg, MSG_NOSIGNAL) != sizeof (struct CommandBuffer))
+    return 0;
+
+  return 1;
+}
+
+/* Same as recv_command(), and also receives up to @max_fds file
+ * descriptors, the missing ones are set to -1 */
+static int
+recv_command_with_fds (int fd, struct CommandBuffer *cb, int *fds,
+    int max_fds)
+{
+  struct msghdr msg = { 0 };
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (2 * sizeof (int))];
+  } control;
+  ssize_t retval;
+  int i;
+
+  for (i = 0; i < max_fds; i++)
+    fds[i] = -1;
+
+  iov.iov_base = cb;
+  iov.iov_len = sizeof (struct CommandBuffer);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  retval = recvmsg (fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+  if (retval < 0)
+    return 0;
+
+  for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+    int n_fds;
+
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+
+    n_fds = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+    for (i = 0; i < n_fds; i++) {
+      int received;
+
+      memcpy (&received, CMSG_DATA (cmsg) + i * sizeof (int), sizeof (int));
+      if (i < max_fds && fds[i] < 0)
+        fds[i] = received;
+      else
+        close (received);
+    }
+  }
+
+  return retval == sizeof (struct CommandBuffer);
+}
+
+/* Lowest cursor of all the ring clients, everything before it can be
+ * reclaimed */
+static uint64_t
+sp_writer_ring_min_read (ShmPipe * self)
+{
+  uint64_t min_read = self->ring_head;
+  ShmClient *client;
+
+  for (client = self->clients; client; client = client->next) {
+    uint64_t read_seq;
+
+    if (client->ring_index < 0)
+      continue;
+
+    read_seq = __atomic_load_n (&self->ring_consumers[client->ring_index]
+        .read_seq, __ATOMIC_SEQ_CST);
+    if (read_seq < min_read)
+      min_read = read_seq;
+  }
+
+  return min_read;
+}
+
+static void
+sp_writer_ring_publish (ShmPipe * self, ShmBuffer * sb)
+{
+  uint64_t idx = self->ring_head & self->ring_mask;
+  ShmRingSlot *slot = &self->ring_slots[idx];
+  ShmClient *client;
+
+  slot->seq = self->ring_head;
+  slot->offset = sb->offset;
+  slot->size = sb->size;
+  slot->area_id = sb->shm_area->id;
+  self->ring_buffers[idx] = sb;
+  sb->in_ring = 1;
+
+  self->ring_head++;
+  __atomic_store_n (&self->ring->write_seq, self->ring_head, __ATOMIC_SEQ_CST);
+
+  /* Only the clients that are about to sleep need a wakeup */
+  for (client = self->clients; client; client = client->next) {
+    if (client->ring_index >= 0 &&
+        __atomic_exchange_n (&self->ring_consumers[client->ring_index].waiting,
+            0, __ATOMIC_SEQ_CST))
+      eventfd_write (client->ring_fd, 1);
+  }
+}
+
+/* Gives the client a cursor in the ring, if there is none left it just
+ * gets its buffers over the socket */
+static int
+sp_writer_ring_add_client (ShmPipe * self, ShmClient * client)
+{
+  struct CommandBuffer cb = { 0 };
+  int pathlen = strlen (self->ring_area->shm_area_name) + 1;
+  ShmRingConsumer *consumer;
+  int fds[2];
+  int index;
+
+  for (index = 0; index < SHM_RING_MAX_CONSUMERS; index++) {
+    if (!(self->ring_used_consumers & (1U << index)))
+      break;
+  }
+  if (index == SHM_RING_MAX_CONSUMERS)
+    return 0;
+
+  client->ring_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (client->ring_fd < 0)
+    return 0;
+
+  /* The client starts with the next buffer */
+  consumer = &self->ring_consumers[index];
+  consumer->waiting = 0;
+  __atomic_store_n (&consumer->read_seq, self->ring_head, __ATOMIC_SEQ_CST);
+
+  cb.payload.new_shm_area.size = self->ring_area->shm_area_len;
+  cb.payload.new_shm_area.path_size = pathlen;
+  fds[0] = client->ring_fd;
+  fds[1] = self->ring_release_fd;
+  if (!send_command_with_fds (client->fd, &cb, COMMAND_NEW_RING, index, fds,
+          2)) {
+    fprintf (stderr, "Sending new ring failed: %s", strerror (errno));
+    goto error;
+  }
+
+  if (send (client->fd, self->ring_area->shm_area_name, pathlen,
+          MSG_NOSIGNAL) != pathlen) {
+    fprintf (stderr, "Sending new ring path failed: %s", strerror (errno));
+    goto error;
+  }
+
+  client->ring_index = index;
+  self->ring_used_consumers |= 1U << index;
+  self->ring_num_consumers++;
+
+  return 0;
+
+error:
+  close_fds (&client->ring_fd, 1);
+  return -1;
+}
+
+#endif /* SHM_PIPE_HAVE_RING */
+
+/* sp_writer_enable_ring:
+ * @n_slots: Number of slots, rounded up to a power of two
+ *
+ * Creates the ring which will be offered to the clients connecting from
+ * now on. Returns 0 on success and -1 if the ring is not supported or
+ * could not be created.
+ */
+
+int
+sp_writer_enable_ring (ShmPipe * self, unsigned int n_slots)
+{
+#ifdef SHM_PIPE_HAVE_RING
+  ShmArea *area;
+  unsigned int slots = 1;
+
+  if (self->ring_area || n_slots == 0 || n_slots > SHM_RING_MAX_SLOTS)
+    return -1;
+
+  while (slots < n_slots)
+    slots <<= 1;
+
+  self->ring_release_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (self->ring_release_fd < 0)
+    return -1;
+
+  /* ftruncate() leaves the area zeroed */
+  area = sp_open_shm (NULL, 0, self->perms, SHM_RING_AREA_SIZE (slots), 1);
+  if (!area) {
+    close_fds (&self->ring_release_fd, 1);
+    return -1;
+  }
+
+  sp_ring_map (self, area);
+  self->ring->magic = SHM_RING_MAGIC;
+  self->ring->n_slots = slots;
+  self->ring->max_consumers = SHM_RING_MAX_CONSUMERS;
+  self->ring_mask = slots - 1;
+  self->ring_buffers = calloc (slots, sizeof (ShmBuffer *));
+
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+int
+sp_writer_get_ring_fd (ShmPipe * self)
+{
+  return self->ring_release_fd;
+}
+
+/* Returns the number of buffers that were published in the ring */
+
+unsigned long long
+sp_writer_ring_get_published (ShmPipe * self)
+{
+  return self->ring_head;
+}
+
+/* Returns 0 if the ring is full and sp_writer_send_buf() would not be able
+ * to publish a buffer in it */
+
+int
+sp_writer_ring_can_publish (ShmPipe * self)
+{
+  if (!self->ring || self->ring_num_consumers == 0)
+    return 1;
+
+  return self->ring_head - self->ring_tail <= self->ring_mask;
+}
+
+/* Asks the clients to signal the fd from sp_writer_get_ring_fd() the next
+ * time they release a buffer. Returns 1 if some were released already,
+ * then sp_writer_ring_reclaim() should be called instead of waiting.
+ */
+
+int
+sp_writer_ring_want_release (ShmPipe * self)
+{
+#ifdef SHM_PIPE_HAVE_RING
+  if (!self->ring)
+    return 0;
+
+  __atomic_store_n (&self->ring->writer_waiting, 1, __ATOMIC_SEQ_CST);
+
+  return sp_writer_ring_min_read (self) > self->ring_tail;
+#else
+  return 0;
+#endif
+}
+
+/* Reclaims the slots that all the ring clients are done with, @callback
+ * is called with the tag of the buffers which are no longer used by
+ * anyone. Returns the number of slots reclaimed.
+ */
+
+int
+sp_writer_ring_reclaim (ShmPipe * self, sp_buffer_free_callback callback,
+    void *user_data)
+{
+#ifdef SHM_PIPE_HAVE_RING
+  uint64_t min_read;
+  eventfd_t value;
+  int reclaimed = 0;
+
+  if (!self->ring)
+    return 0;
+
+  /* Only clears the wakeup, the cursors say what was released */
+  eventfd_read (self->ring_release_fd, &value);
+
+  min_read = sp_writer_ring_min_read (self);
+
+  while (self->ring_tail < min_read) {
+    uint64_t idx = self->ring_tail & self->ring_mask;
+    ShmBuffer *sb = self->ring_buffers[idx];
+    void *tag = NULL;
+
+    self->ring_buffers[idx] = NULL;
+    self->ring_tail++;
+    reclaimed++;
+
+    if (sb && !sp_shmbuf_release_ring (self, sb, &tag) && callback)
+      callback (tag, user_data);
+  }
+
+  return reclaimed;
+#else
+  return 0;
+#endif
+}
+
 int
 sp_writer_resize (ShmPipe * self, size_t size)
 {
@@ -496,7 +1012,7 @@ sp_writer_resize (ShmPipe * self, size_t size)
   if (self->shm_area->shm_area_len == size)
     return 0;
 
-  newarea = sp_open_shm (NULL, ++self->next_area_id, self->perms, size);
+  newarea = sp_open_shm (NULL, ++self->next_area_id, self->perms, size, 0);
 
   if (!newarea)
     return -1;
@@ -510,10 +1026,6 @@ sp_writer_resize (ShmPipe * self, size_t size)
   for (client = self->clients; client; client = client->next) {
     struct CommandBuffer cb = { 0 };
 
-    if (!send_command (client->fd, &cb, COMMAND_CLOSE_SHM_AREA,
-            old_current->id))
-      continue;
-
     cb.payload.new_shm_area.size = newarea->shm_area_len;
     cb.payload.new_shm_area.path_size = pathlen;
     if (!send_command (client->fd, &cb, COMMAND_NEW_SHM_AREA, newarea->id))
@@ -583,6 +1095,7 @@ sp_writer_send_buf (ShmPipe * self, char *buf, size_t size, void *tag)
   ShmBuffer *sb;
   ShmClient *client = NULL;
   ShmAllocBlock *ablock = NULL;
+  int ring;
   int i = 0;
   int c = 0;
 
@@ -612,16 +1125,36 @@ sp_writer_send_buf (ShmPipe * self, char *buf, size_t size, void *tag)
   sb->ablock = ablock;
   sb->tag = tag;
 
+  /* Slots of the ring can only point to the current area: the ring clients
+   * stop resolving the areas from before a resize once the ring went past
+   * the resize. Buffers from such an area are sent over the socket to every
+   * client instead, like to the clients without a ring */
+  ring = self->ring_num_consumers > 0 && area == self->shm_area;
+
   for (client = self->clients; client; client = client->next) {
     struct CommandBuffer cb = { 0 };
+
+    if (ring && client->ring_index >= 0)
+      continue;
+
+    if (area->id < client->first_area_id)
+      continue;
+
     cb.payload.buffer.offset = offset;
     cb.payload.buffer.size = bsize;
-    if (!send_command (client->fd, &cb, COMMAND_NEW_BUFFER, self->shm_area->id))
+    if (!send_command (client->fd, &cb, COMMAND_NEW_BUFFER, area->id))
       continue;
     sb->clients[i++] = client->fd;
     c++;
   }
 
+#ifdef SHM_PIPE_HAVE_RING
+  if (ring && sp_writer_ring_can_publish (self)) {
+    sp_writer_ring_publish (self, sb);
+    c += self->ring_num_consumers;
+  }
+#endif
+
   if (c == 0) {
     spalloc_free1 (sizeof (ShmBuffer) + sizeof (int) * sb->num_clients, sb);
     return 0;
@@ -630,7 +1163,8 @@ sp_writer_send_buf (ShmPipe * self, char *buf, size_t size, void *tag)
   sp_shm_area_inc (area);
   shm_alloc_space_block_inc (ablock);
 
-  sb->use_count = c;
+  /* The ring holds a single reference for all its clients */
+  sb->use_count = i + sb->in_ring;
 
   sb->next = self->buffers;
   self->buffers = sb;
@@ -651,6 +1185,165 @@ recv_command (int fd, struct CommandBuffer *cb)
   }
 }
 
+#ifdef SHM_PIPE_HAVE_RING
+
+static long int
+sp_client_open_ring (ShmPipe * self, struct CommandBuffer *cb, int *fds)
+{
+  char *area_name;
+  ShmArea *area;
+  ShmRingHeader *ring;
+  uint32_t n_slots;
+  int retval;
+
+  if (self->ring_area || fds[0] < 0 || fds[1] < 0 || cb->area_id < 0 ||
+      cb->area_id >= SHM_RING_MAX_CONSUMERS ||
+      cb->payload.new_shm_area.path_size == 0 ||
+      cb->payload.new_shm_area.size < SHM_RING_AREA_SIZE (0))
+    goto error;
+
+  area_name = malloc (cb->payload.new_shm_area.path_size + 1);
+  retval = recv (self->main_socket, area_name,
+      cb->payload.new_shm_area.path_size, 0);
+  if (retval != cb->payload.new_shm_area.path_size) {
+    free (area_name);
+    close_fds (fds, 2);
+    return -3;
+  }
+  area_name[retval] = 0;
+
+  area = sp_open_shm (area_name, -1, 0, cb->payload.new_shm_area.size, 1);
+  free (area_name);
+  if (!area)
+    goto error;
+
+  ring = (ShmRingHeader *) area->shm_area_buf;
+  n_slots = ring->n_slots;
+  if (ring->magic != SHM_RING_MAGIC || n_slots == 0 ||
+      n_slots > SHM_RING_MAX_SLOTS || (n_slots & (n_slots - 1)) != 0 ||
+      SHM_RING_AREA_SIZE (n_slots) > area->shm_area_len) {
+    area->use_count--;
+    sp_close_shm (area);
+    goto error;
+  }
+
+  sp_ring_map (self, area);
+  self->ring_mask = n_slots - 1;
+  self->ring_index = cb->area_id;
+  self->ring_fd = fds[0];
+  self->ring_release_fd = fds[1];
+  self->ring_next = self->ring_released =
+      __atomic_load_n (&self->ring_consumers[self->ring_index].read_seq,
+      __ATOMIC_SEQ_CST);
+  self->ring_bufs = calloc (n_slots, sizeof (char *));
+  self->ring_done = calloc (n_slots, 1);
+
+  return 0;
+
+error:
+  close_fds (fds, 2);
+  return -4;
+}
+
+/* Drops the areas closed by the server once no slot can point to them */
+static void
+sp_client_ring_close_areas (ShmPipe * self)
+{
+  ShmArea *area, *next;
+
+  for (area = self->shm_area; area; area = next) {
+    next = area->next;
+    if (area->ring_closing && area->ring_close_seq <= self->ring_next) {
+      area->ring_closing = 0;
+      sp_shm_area_dec (self, area);
+    }
+  }
+}
+
+#endif /* SHM_PIPE_HAVE_RING */
+
+/* Returns the fd to poll for new buffers in the ring, or -1 if the server
+ * did not give us a ring. Once it has, sp_client_ring_recv() must be called
+ * whenever the fd is readable and before waiting on any fd. */
+
+int
+sp_client_get_ring_fd (ShmPipe * self)
+{
+  return self->ring_fd;
+}
+
+/* Gets the next buffer from the ring, with the same return values as
+ * sp_client_recv(). If there is none, *buf is set to NULL and the fd from
+ * sp_client_get_ring_fd() will be signalled once there is one. */
+
+long int
+sp_client_ring_recv (ShmPipe * self, char **buf)
+{
+#ifdef SHM_PIPE_HAVE_RING
+  ShmRingConsumer *consumer;
+  ShmRingSlot *slot;
+  ShmArea *area;
+  uint64_t write_seq;
+  uint64_t idx;
+  eventfd_t value;
+
+  *buf = NULL;
+
+  if (!self->ring)
+    return 0;
+
+  consumer = &self->ring_consumers[self->ring_index];
+
+  write_seq = __atomic_load_n (&self->ring->write_seq, __ATOMIC_ACQUIRE);
+  if (write_seq == self->ring_next) {
+    /* Ask for a wakeup, and check again so nothing published in between
+     * is missed */
+    eventfd_read (self->ring_fd, &value);
+    __atomic_store_n (&consumer->waiting, 1, __ATOMIC_SEQ_CST);
+    write_seq = __atomic_load_n (&self->ring->write_seq, __ATOMIC_SEQ_CST);
+    if (write_seq == self->ring_next)
+      return 0;
+    __atomic_store_n (&consumer->waiting, 0, __ATOMIC_RELAXED);
+  }
+
+  /* The server can't overwrite slots we didn't release */
+  if (write_seq - self->ring_released > self->ring_mask + 1)
+    return -30;
+
+  idx = self->ring_next & self->ring_mask;
+  slot = &self->ring_slots[idx];
+  if (slot->seq != self->ring_next)
+    return -31;
+
+  for (area = self->shm_area; area; area = area->next) {
+    if (area->id == slot->area_id)
+      break;
+  }
+
+  /* Published in an area we didn't get from the socket yet */
+  if (!area)
+    return 0;
+
+  if (slot->offset > area->shm_area_len ||
+      slot->size > area->shm_area_len - slot->offset)
+    return -32;
+
+  *buf = area->shm_area_buf + slot->offset;
+  sp_shm_area_inc (area);
+
+  self->ring_bufs[idx] = *buf;
+  self->ring_done[idx] = 0;
+  self->ring_next++;
+
+  sp_client_ring_close_areas (self);
+
+  return slot->size;
+#else
+  *buf = NULL;
+  return 0;
+#endif
+}
+
 long int
 sp_client_recv (ShmPipe * self, char **buf)
 {
@@ -660,8 +1353,22 @@ sp_client_recv (ShmPipe * self, char **buf)
   struct CommandBuffer cb;
   int retval;
 
+#ifdef SHM_PIPE_HAVE_RING
+  int fds[2];
+
+  if (!recv_command_with_fds (self->main_socket, &cb, fds, 2)) {
+    close_fds (fds, 2);
+    return -1;
+  }
+
+  if (cb.type == COMMAND_NEW_RING)
+    return sp_client_open_ring (self, &cb, fds);
+
+  close_fds (fds, 2);
+#else
   if (!recv_command (self->main_socket, &cb))
     return -1;
+#endif
 
   switch (cb.type) {
     case COMMAND_NEW_SHM_AREA:
@@ -679,7 +1386,7 @@ sp_client_recv (ShmPipe * self, char **buf)
       area_name[retval] = 0;
 
       newarea = sp_open_shm (area_name, cb.area_id, 0,
-          cb.payload.new_shm_area.size);
+          cb.payload.new_shm_area.size, 0);
       free (area_name);
       if (!newarea)
         return -4;
@@ -691,6 +1398,16 @@ sp_client_recv (ShmPipe * self, char **buf)
     case COMMAND_CLOSE_SHM_AREA:
       for (area = self->shm_area; area; area = area->next) {
         if (area->id == cb.area_id) {
+#ifdef SHM_PIPE_HAVE_RING
+          if (self->ring) {
+            /* Slots published until now can still point to it */
+            area->ring_closing = 1;
+            area->ring_close_seq =
+                __atomic_load_n (&self->ring->write_seq, __ATOMIC_SEQ_CST);
+            sp_client_ring_close_areas (self);
+            break;
+          }
+#endif
           sp_shm_area_dec (self, area);
           break;
         }
@@ -743,12 +1460,65 @@ sp_writer_recv (ShmPipe * self, ShmClient * client, void **tag)
   return 0;
 }
 
+#ifdef SHM_PIPE_HAVE_RING
+/* Returns -1 if @buf doesn't come from the ring */
+static int
+sp_client_ring_finish (ShmPipe * self, char *buf)
+{
+  uint64_t seq;
+  uint64_t idx;
+
+  for (seq = self->ring_released; seq < self->ring_next; seq++) {
+    idx = seq & self->ring_mask;
+    if (!self->ring_done[idx] && self->ring_bufs[idx] == buf)
+      break;
+  }
+
+  if (seq == self->ring_next)
+    return -1;
+
+  self->ring_done[seq & self->ring_mask] = 1;
+
+  /* The cursor can only move past buffers released in order */
+  if (seq != self->ring_released)
+    return 1;
+
+  while (self->ring_released < self->ring_next) {
+    idx = self->ring_released & self->ring_mask;
+    if (!self->ring_done[idx])
+      break;
+    self->ring_done[idx] = 0;
+    self->ring_bufs[idx] = NULL;
+    self->ring_released++;
+  }
+
+  __atomic_store_n (&self->ring_consumers[self->ring_index].read_seq,
+      self->ring_released, __ATOMIC_SEQ_CST);
+
+  if (__atomic_exchange_n (&self->ring->writer_waiting, 0, __ATOMIC_SEQ_CST))
+    eventfd_write (self->ring_release_fd, 1);
+
+  return 1;
+}
+#endif
+
 int
 sp_client_recv_finish (ShmPipe * self, char *buf)
 {
   ShmArea *shm_area = NULL;
   unsigned long offset;
+  int area_id;
   struct CommandBuffer cb = { 0 };
+  int ring_buffer = 0;
+
+#ifdef SHM_PIPE_HAVE_RING
+  if (self->ring) {
+    int ret = sp_client_ring_finish (self, buf);
+
+    if (ret >= 0)
+      ring_buffer = 1;
+  }
+#endif
 
   for (shm_area = self->shm_area; shm_area; shm_area = shm_area->next) {
     if (buf >= shm_area->shm_area_buf &&
@@ -759,12 +1529,17 @@ sp_client_recv_finish (ShmPipe * self, char *buf)
   assert (shm_area);
 
   offset = buf - shm_area->shm_area_buf;
+  area_id = shm_area->id;
 
   sp_shm_area_dec (self, shm_area);
 
+  /* Released through the ring cursor, no need for an ack */
+  if (ring_buffer)
+    return 1;
+
+  /* The buffer may come from an area older than the current one */
   cb.payload.ack_buffer.offset = offset;
-  return send_command (self->main_socket, &cb, COMMAND_ACK_BUFFER,
-      self->shm_area->id);
+  return send_command (self->main_socket, &cb, COMMAND_ACK_BUFFER, area_id);
 }
 
 ShmPipe *
@@ -778,6 +1553,9 @@ sp_client_open (const char *path)
 
   self->main_socket = socket (PF_UNIX, SOCK_STREAM, 0);
   self->use_count = 1;
+  self->ring_release_fd = -1;
+  self->ring_index = -1;
+  self->ring_fd = -1;
 
   if (self->main_socket < 0)
     goto error;
@@ -835,6 +1613,14 @@ sp_writer_accept_client (ShmPipe * self)
 
   client = spalloc_new (ShmClient);
   client->fd = fd;
+  client->ring_index = -1;
+  client->ring_fd = -1;
+  client->first_area_id = self->shm_area->id;
+
+#ifdef SHM_PIPE_HAVE_RING
+  if (self->ring && sp_writer_ring_add_client (self, client) < 0)
+    goto error;
+#endif
 
   /* Prepend ot linked list */
   client->next = self->clients;
@@ -844,11 +1630,30 @@ sp_writer_accept_client (ShmPipe * self)
   return client;
 
 error:
+  if (client)
+    spalloc_free (ShmClient, client);
   shutdown (fd, SHUT_RDWR);
   close (fd);
   return NULL;
 }
 
+static void
+sp_shmbuf_free (ShmPipe * self, ShmBuffer * buf, ShmBuffer * prev_buf,
+    void **tag)
+{
+  /* Remove from linked list */
+  if (prev_buf)
+    prev_buf->next = buf->next;
+  else
+    self->buffers = buf->next;
+
+  if (tag)
+    *tag = buf->tag;
+  shm_alloc_space_block_dec (buf->ablock);
+  sp_shm_area_dec (self, buf->shm_area);
+  spalloc_free1 (sizeof (ShmBuffer) + sizeof (int) * buf->num_clients, buf);
+}
+
 static int
 sp_shmbuf_dec (ShmPipe * self, ShmBuffer * buf, ShmBuffer * prev_buf,
     ShmClient * client, void **tag)
@@ -873,22 +1678,35 @@ sp_shmbuf_dec (ShmPipe * self, ShmBuffer * buf, ShmBuffer * prev_buf,
   buf->use_count--;
 
   if (buf->use_count == 0) {
-    /* Remove from linked list */
-    if (prev_buf)
-      prev_buf->next = buf->next;
-    else
-      self->buffers = buf->next;
-
-    if (tag)
-      *tag = buf->tag;
-    shm_alloc_space_block_dec (buf->ablock);
-    sp_shm_area_dec (self, buf->shm_area);
-    spalloc_free1 (sizeof (ShmBuffer) + sizeof (int) * buf->num_clients, buf);
+    sp_shmbuf_free (self, buf, prev_buf, tag);
     return 0;
   }
   return 1;
 }
 
+#ifdef SHM_PIPE_HAVE_RING
+/* Drops the reference of the ring, once all ring clients released it */
+static int
+sp_shmbuf_release_ring (ShmPipe * self, ShmBuffer * buf, void **tag)
+{
+  ShmBuffer *item, *prev_buf = NULL;
+
+  assert (buf->in_ring);
+  buf->in_ring = 0;
+  buf->use_count--;
+
+  if (buf->use_count > 0)
+    return 1;
+
+  for (item = self->buffers; item && item != buf; item = item->next)
+    prev_buf = item;
+  assert (item);
+
+  sp_shmbuf_free (self, buf, prev_buf, tag);
+  return 0;
+}
+#endif
+
 void
 sp_writer_close_client (ShmPipe * self, ShmClient * client,
     sp_buffer_free_callback callback, void *user_data)
@@ -931,6 +1749,14 @@ again:
 
   self->num_clients--;
 
+  if (client->ring_index >= 0) {
+    self->ring_used_consumers &= ~(1U << client->ring_index);
+    self->ring_num_consumers--;
+    close_fds (&client->ring_fd, 1);
+    /* Its cursor no longer holds anything back */
+    sp_writer_ring_reclaim (self, callback, user_data);
+  }
+
   spalloc_free (ShmClient, client);
 }
 
@@ -985,6 +1811,24 @@ sp_writer_buf_get_tag (ShmBuffer * buffer)
   return buffer->tag;
 }
 
+size_t
+sp_writer_get_high_water_mark (ShmPipe * self)
+{
+  if (self->shm_area == NULL)
+    return 0;
+
+  return shm_alloc_space_get_high_water_mark (self->shm_area->allocspace);
+}
+
+double
+sp_writer_get_fragmentation (ShmPipe * self)
+{
+  if (self->shm_area == NULL)
+    return 0.0;
+
+  return shm_alloc_space_get_fragmentation (self->shm_area->allocspace);
+}
+
 size_t
 sp_writer_get_max_buf_size (ShmPipe * self)
 {
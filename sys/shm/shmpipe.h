@@ -56,6 +56,18 @@
  * buffers are no longer valid. If was valid buffer was received, the
  * client must release it with sp_client_recv_finish() when it is done
  * reading from it.
+ *
+ * The writer can also call sp_writer_enable_ring() so that clients get
+ * their buffers from a ring in shared memory instead of one message per
+ * buffer. The writer must then wait for the ring to have space with
+ * sp_writer_ring_can_publish() before sending, and when it waits for
+ * buffers to be released (for the ring or after a failed alloc), it calls
+ * sp_writer_ring_want_release() first and selects on the fd returned by
+ * sp_writer_get_ring_fd(), calling sp_writer_ring_reclaim() when there is
+ * something to read on it. Once a client got the ring, which
+ * sp_client_get_ring_fd() tells, it calls sp_client_ring_recv() before
+ * every select() and whenever the ring fd is readable, in addition to
+ * reading from the socket.
  */
 
 
@@ -100,6 +112,8 @@ int sp_writer_send_buf (ShmPipe * self, char *buf, size_t size, void * tag);
 char *sp_writer_block_get_buf (ShmBlock *block);
 ShmPipe *sp_writer_block_get_pipe (ShmBlock *block);
 size_t sp_writer_get_max_buf_size (ShmPipe * self);
+size_t sp_writer_get_high_water_mark (ShmPipe * self);
+double sp_writer_get_fragmentation (ShmPipe * self);
 
 ShmClient * sp_writer_accept_client (ShmPipe * self);
 void sp_writer_close_client (ShmPipe *self, ShmClient * client,
@@ -108,6 +122,14 @@ int sp_writer_recv (ShmPipe * self, ShmClient * client, void ** tag);
 
 int sp_writer_pending_writes (ShmPipe * self);
 
+int sp_writer_enable_ring (ShmPipe * self, unsigned int n_slots);
+int sp_writer_get_ring_fd (ShmPipe * self);
+unsigned long long sp_writer_ring_get_published (ShmPipe * self);
+int sp_writer_ring_can_publish (ShmPipe * self);
+int sp_writer_ring_want_release (ShmPipe * self);
+int sp_writer_ring_reclaim (ShmPipe * self, sp_buffer_free_callback callback,
+    void * user_data);
+
 ShmBuffer *sp_writer_get_pending_buffers (ShmPipe * self);
 ShmBuffer *sp_writer_get_next_buffer (ShmBuffer * buffer);
 void *sp_writer_buf_get_tag (ShmBuffer * buffer);
@@ -115,6 +137,8 @@ void *sp_writer_buf_get_tag (ShmBuffer * buffer);
 ShmPipe *sp_client_open (const char *path);
 long int sp_client_recv (ShmPipe * self, char **buf);
 int sp_client_recv_finish (ShmPipe * self, char *buf);
+int sp_client_get_ring_fd (ShmPipe * self);
+long int sp_client_ring_recv (ShmPipe * self, char **buf);
 void sp_client_close (ShmPipe * self);
 
 #ifdef __cplusplus
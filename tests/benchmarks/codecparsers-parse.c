@@ -0,0 +1,1264 @@
+/* GStreamer
+ *
+ * codecparsers-parse.c: measure the throughput of the codec parsers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Runs the H.264, H.265, AV1, VP9 and MPEG-2 parsers over synthetic streams
+ * and over streams encoded from videotestsrc by whichever encoders are
+ * installed, and reports the throughput and the allocations needed per
+ * unit. Units are NAL units for H.264 and H.265, OBUs for AV1, frames for
+ * VP9 and start code delimited packets for MPEG-2, all of them are parsed
+ * the way decoders do, up to the slice or tile group headers.
+ *
+ * The synthetic streams have valid headers around random payloads, except
+ * for AV1 which repeats the 16x16 AOM test vector of the unit tests.
+ *
+ * Allocations are counted by interposing malloc(), which needs glibc, -1 is
+ * reported elsewhere. They include creating and freeing the parser. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/base/gstbitwriter.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include <gst/codecparsers/gstav1parser.h>
+#include <gst/codecparsers/gstvp9parser.h>
+#include <gst/codecparsers/gstmpegvideoparser.h>
+#include <gst/codecparsers/nalutils.h>
+
+#define DEFAULT_FRAMES 300
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+#define DEFAULT_ITERATIONS 5
+#define GOP_SIZE 30
+#define SLICES_PER_FRAME 4
+
+static guint width = DEFAULT_WIDTH;
+static guint height = DEFAULT_HEIGHT;
+
+#if defined (__GLIBC__) && !defined (__SANITIZE_ADDRESS__)
+#define HAVE_ALLOCATION_COUNTING 1
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static gint allocations;
+static gboolean count_allocations;
+
+void *
+malloc (size_t size)
+{
+  if (count_allocations)
+    g_atomic_int_inc (&allocations);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+  if (count_allocations)
+    g_atomic_int_inc (&allocations);
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  if (count_allocations)
+    g_atomic_int_inc (&allocations);
+  return __libc_realloc (ptr, size);
+}
+#endif
+
+/* Synthetic streams */
+
+static void
+put_se (NalWriter * nw, gint32 value)
+{
+  nal_writer_put_ue (nw, value > 0 ? 2 * value - 1 : -2 * value);
+}
+
+static void
+put_random_bytes (NalWriter * nw, GRand * rand, guint size)
+{
+  guint8 *data = g_malloc (size);
+  guint i;
+
+  for (i = 0; i < size; i++)
+    data[i] = g_rand_int_range (rand, 0, 256);
+  nal_writer_put_bytes (nw, data, size);
+  g_free (data);
+}
+
+/* Terminates the NAL unit written with @nw and appends it to @chunk, with a
+ * start code and emulation prevention bytes */
+static void
+append_nal (GByteArray * chunk, NalWriter * nw)
+{
+  GstMemory *mem;
+  GstMapInfo map;
+
+  nal_writer_do_rbsp_trailing_bits (nw);
+  mem = nal_writer_reset_and_get_memory (nw);
+  gst_memory_map (mem, &map, GST_MAP_READ);
+  g_byte_array_append (chunk, map.data, map.size);
+  gst_memory_unmap (mem, &map);
+  gst_memory_unref (mem);
+}
+
+/* Baseline profile, one reference frame and an IDR every GOP_SIZE frames,
+ * each frame in SLICES_PER_FRAME slices */
+static void
+write_h264_frame (GByteArray * chunk, guint frame, GRand * rand)
+{
+  guint mb_width = width / 16, mb_height = height / 16;
+  guint n_mbs = mb_width * mb_height;
+  gboolean idr = frame % GOP_SIZE == 0;
+  NalWriter nw;
+  guint i;
+
+  if (idr) {
+    /* SPS */
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, 0x67, 8);
+    nal_writer_put_bits_uint8 (&nw, GST_H264_PROFILE_BASELINE, 8);
+    nal_writer_put_bits_uint8 (&nw, 0, 8);
+    /* level 4.0 */
+    nal_writer_put_bits_uint8 (&nw, 40, 8);
+    nal_writer_put_ue (&nw, 0);
+    /* log2_max_frame_num_minus4 */
+    nal_writer_put_ue (&nw, 0);
+    /* pic_order_cnt_type */
+    nal_writer_put_ue (&nw, 2);
+    /* max_num_ref_frames */
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, mb_width - 1);
+    nal_writer_put_ue (&nw, mb_height - 1);
+    /* frame_mbs_only_flag, direct_8x8_inference_flag */
+    nal_writer_put_bits_uint8 (&nw, 3, 2);
+    /* frame_cropping_flag, vui_parameters_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+
+    /* PPS */
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, 0x68, 8);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* entropy_coding_mode_flag,
+     * bottom_field_pic_order_in_frame_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    /* num_slice_groups_minus1, num_ref_idx_l[01]_default_active_minus1 */
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* weighted_pred_flag, weighted_bipred_idc */
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    /* pic_init_qp_minus26, pic_init_qs_minus26, chroma_qp_index_offset */
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    /* deblocking_filter_control_present_flag, constrained_intra_pred_flag,
+     * redundant_pic_cnt_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 4, 3);
+    append_nal (chunk, &nw);
+
+    /* SEI with a recovery point */
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, 0x06, 8);
+    nal_writer_put_bits_uint8 (&nw, GST_H264_SEI_RECOVERY_POINT, 8);
+    nal_writer_put_bits_uint8 (&nw, 1, 8);
+    /* recovery_frame_cnt */
+    nal_writer_put_ue (&nw, 0);
+    /* exact_match_flag, broken_link_flag, changing_slice_group_idc */
+    nal_writer_put_bits_uint8 (&nw, 8, 4);
+    /* payload alignment */
+    nal_writer_put_bits_uint8 (&nw, 4, 3);
+    append_nal (chunk, &nw);
+  }
+
+  for (i = 0; i < SLICES_PER_FRAME; i++) {
+    guint slice_mbs = n_mbs / SLICES_PER_FRAME;
+
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, idr ? 0x65 : 0x61, 8);
+    nal_writer_put_ue (&nw, i * slice_mbs);
+    /* all slices of the picture are I or P */
+    nal_writer_put_ue (&nw, idr ? 7 : 5);
+    nal_writer_put_ue (&nw, 0);
+    /* frame_num */
+    nal_writer_put_bits_uint8 (&nw, (frame % GOP_SIZE) & 0xf, 4);
+    if (idr) {
+      nal_writer_put_ue (&nw, (frame / GOP_SIZE) & 1);
+    } else {
+      /* num_ref_idx_active_override_flag,
+       * ref_pic_list_modification_flag_l0 */
+      nal_writer_put_bits_uint8 (&nw, 0, 2);
+    }
+    /* no_output_of_prior_pics_flag and long_term_reference_flag, or
+     * adaptive_ref_pic_marking_mode_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, idr ? 2 : 1);
+    /* slice_qp_delta */
+    put_se (&nw, 0);
+    /* disable_deblocking_filter_idc */
+    nal_writer_put_ue (&nw, 1);
+    put_random_bytes (&nw, rand, slice_mbs * (idr ? 4 : 1));
+    append_nal (chunk, &nw);
+  }
+}
+
+static void
+put_h265_profile_tier_level (NalWriter * nw)
+{
+  /* Main profile, main tier */
+  nal_writer_put_bits_uint8 (nw, GST_H265_PROFILE_IDC_MAIN, 8);
+  nal_writer_put_bits_uint32 (nw, 0x60000000, 32);
+  /* progressive_source_flag, frame_only_constraint_flag */
+  nal_writer_put_bits_uint8 (nw, 9, 4);
+  nal_writer_put_bits_uint32 (nw, 0, 32);
+  nal_writer_put_bits_uint16 (nw, 0, 12);
+  /* level 4.1 */
+  nal_writer_put_bits_uint8 (nw, 123, 8);
+}
+
+static void
+put_h265_nal_header (NalWriter * nw, GstH265NalUnitType type)
+{
+  nal_writer_put_bits_uint8 (nw, type << 1, 8);
+  nal_writer_put_bits_uint8 (nw, 1, 8);
+}
+
+/* Main profile, 64x64 CTBs, one reference frame and an IDR every GOP_SIZE
+ * frames, each frame in SLICES_PER_FRAME slices */
+static void
+write_h265_frame (GByteArray * chunk, guint frame, GRand * rand)
+{
+  guint n_ctbs = ((width + 63) / 64) * ((height + 63) / 64);
+  gboolean idr = frame % GOP_SIZE == 0;
+  NalWriter nw;
+  guint i;
+
+  if (idr) {
+    /* VPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_VPS);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    /* base_layer_internal_flag, base_layer_available_flag */
+    nal_writer_put_bits_uint8 (&nw, 3, 2);
+    nal_writer_put_bits_uint8 (&nw, 0, 6);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    /* temporal_id_nesting_flag */
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_bits_uint16 (&nw, 0xffff, 16);
+    put_h265_profile_tier_level (&nw);
+    /* sub_layer_ordering_info_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* max_layer_id */
+    nal_writer_put_bits_uint8 (&nw, 0, 6);
+    nal_writer_put_ue (&nw, 0);
+    /* timing_info_present_flag, extension_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+
+    /* SPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_SPS);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    put_h265_profile_tier_level (&nw);
+    nal_writer_put_ue (&nw, 0);
+    /* chroma_format_idc */
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, width);
+    nal_writer_put_ue (&nw, height);
+    /* conformance_window_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 1);
+    /* bit_depth_luma_minus8, bit_depth_chroma_minus8 */
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* log2_max_pic_order_cnt_lsb_minus4 */
+    nal_writer_put_ue (&nw, 4);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* coding blocks from 8x8 to 64x64, transform blocks from 4x4 to
+     * 32x32 */
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 3);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 3);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* scaling_list_enabled_flag, amp_enabled_flag,
+     * sample_adaptive_offset_enabled_flag, pcm_enabled_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    /* one short term reference picture set, with the previous picture */
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    /* long_term_ref_pics_present_flag, temporal_mvp_enabled_flag,
+     * strong_intra_smoothing_enabled_flag, vui_parameters_present_flag,
+     * sps_extension_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 5);
+    append_nal (chunk, &nw);
+
+    /* PPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_PPS);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* dependent_slice_segments_enabled_flag, output_flag_present_flag,
+     * num_extra_slice_header_bits, sign_data_hiding_enabled_flag,
+     * cabac_init_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 7);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* init_qp_minus26 */
+    put_se (&nw, 0);
+    /* constrained_intra_pred_flag, transform_skip_enabled_flag,
+     * cu_qp_delta_enabled_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    /* cb_qp_offset, cr_qp_offset */
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    /* from slice_chroma_qp_offsets_present_flag to
+     * lists_modification_present_flag */
+    nal_writer_put_bits_uint16 (&nw, 0, 10);
+    /* log2_parallel_merge_level_minus2 */
+    nal_writer_put_ue (&nw, 0);
+    /* slice_segment_header_extension_present_flag, pps_extension_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+
+    /* SEI with a recovery point */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_PREFIX_SEI);
+    nal_writer_put_bits_uint8 (&nw, GST_H265_SEI_RECOVERY_POINT, 8);
+    nal_writer_put_bits_uint8 (&nw, 1, 8);
+    /* recovery_poc_cnt */
+    put_se (&nw, 0);
+    /* exact_match_flag, broken_link_flag */
+    nal_writer_put_bits_uint8 (&nw, 2, 2);
+    /* payload alignment */
+    nal_writer_put_bits_uint8 (&nw, 0x10, 5);
+    append_nal (chunk, &nw);
+  }
+
+  for (i = 0; i < SLICES_PER_FRAME; i++) {
+    guint slice_ctbs = n_ctbs / SLICES_PER_FRAME;
+
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, idr ? GST_H265_NAL_SLICE_IDR_W_RADL :
+        GST_H265_NAL_SLICE_TRAIL_R);
+    /* first_slice_segment_in_pic_flag */
+    nal_writer_put_bits_uint8 (&nw, i == 0, 1);
+    if (idr)
+      nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, 0);
+    if (i > 0)
+      nal_writer_put_bits_uint32 (&nw, i * slice_ctbs,
+          g_bit_storage (n_ctbs - 1));
+    nal_writer_put_ue (&nw, idr ? GST_H265_I_SLICE : GST_H265_P_SLICE);
+    if (!idr) {
+      /* slice_pic_order_cnt_lsb */
+      nal_writer_put_bits_uint8 (&nw, frame % GOP_SIZE, 8);
+      /* short_term_ref_pic_set_sps_flag */
+      nal_writer_put_bits_uint8 (&nw, 1, 1);
+      /* num_ref_idx_active_override_flag */
+      nal_writer_put_bits_uint8 (&nw, 0, 1);
+      /* five_minus_max_num_merge_cand */
+      nal_writer_put_ue (&nw, 0);
+    }
+    /* slice_qp_delta */
+    put_se (&nw, 0);
+    /* byte_alignment () */
+    nal_writer_do_rbsp_trailing_bits (&nw);
+    put_random_bytes (&nw, rand, slice_ctbs * (idr ? 64 : 16));
+    append_nal (chunk, &nw);
+  }
+}
+
+/* av1-1-b8-01-size-16x16 from the AOM test vectors, two frames */
+static const guint8 av1_16x16[] = {
+  0x12, 0x00, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x01, 0x9f, 0xfb, 0xff, 0xf3,
+  0x00, 0x80, 0x32, 0xa6, 0x01, 0x10, 0x00, 0x87, 0x80, 0x00, 0x03, 0x00,
+  0x00, 0x00, 0x40, 0x00, 0x9e, 0x86, 0x5b, 0xb2, 0x22, 0xb5, 0x58, 0x4d,
+  0x68, 0xe6, 0x37, 0x54, 0x42, 0x7b, 0x84, 0xce, 0xdf, 0x9f, 0xec, 0xab,
+  0x07, 0x4d, 0xf6, 0xe1, 0x5e, 0x9e, 0x27, 0xbf, 0x93, 0x2f, 0x47, 0x0d,
+  0x7b, 0x7c, 0x45, 0x8d, 0xcf, 0x26, 0xf7, 0x6c, 0x06, 0xd7, 0x8c, 0x2e,
+  0xf5, 0x2c, 0xb0, 0x8a, 0x31, 0xac, 0x69, 0xf5, 0xcd, 0xd8, 0x71, 0x5d,
+  0xaf, 0xf8, 0x96, 0x43, 0x8c, 0x9c, 0x23, 0x6f, 0xab, 0xd0, 0x35, 0x43,
+  0xdf, 0x81, 0x12, 0xe3, 0x7d, 0xec, 0x22, 0xb0, 0x30, 0x54, 0x32, 0x9f,
+  0x90, 0xc0, 0x5d, 0x64, 0x9b, 0x0f, 0x75, 0x31, 0x84, 0x3a, 0x57, 0xd7,
+  0x5f, 0x03, 0x6e, 0x7f, 0x43, 0x17, 0x6d, 0x08, 0xc3, 0x81, 0x8a, 0xae,
+  0x73, 0x1c, 0xa8, 0xa7, 0xe4, 0x9c, 0xa9, 0x5b, 0x3f, 0xd1, 0xeb, 0x75,
+  0x3a, 0x7f, 0x22, 0x77, 0x38, 0x64, 0x1c, 0x77, 0xdb, 0xcd, 0xef, 0xb7,
+  0x08, 0x45, 0x8e, 0x7f, 0xea, 0xa3, 0xd0, 0x81, 0xc9, 0xc1, 0xbc, 0x93,
+  0x9b, 0x41, 0xb1, 0xa1, 0x42, 0x17, 0x98, 0x3f, 0x1e, 0x95, 0xdf, 0x68,
+  0x7c, 0xb7, 0x98, 0x12, 0x00, 0x32, 0x4b, 0x30, 0x03, 0xc3, 0x00, 0xa7,
+  0x2e, 0x46, 0x8a, 0x00, 0x00, 0x03, 0x00, 0x00, 0x50, 0xc0, 0x20, 0x00,
+  0xf0, 0xb1, 0x2f, 0x43, 0xf3, 0xbb, 0xe6, 0x5c, 0xbe, 0xe6, 0x53, 0xbc,
+  0xaa, 0x61, 0x7c, 0x7e, 0x0a, 0x04, 0x1b, 0xa2, 0x87, 0x81, 0xe8, 0xa6,
+  0x85, 0xfe, 0xc2, 0x71, 0xb9, 0xf8, 0xc0, 0x78, 0x9f, 0x52, 0x4f, 0xa7,
+  0x8f, 0x55, 0x96, 0x79, 0x90, 0xaa, 0x2b, 0x6d, 0x0a, 0xa7, 0x05, 0x2a,
+  0xf8, 0xfc, 0xc9, 0x7d, 0x9d, 0x4a, 0x61, 0x16, 0xb1, 0x65
+};
+
+static void
+write_av1_frame (GByteArray * chunk, guint frame, GRand * rand)
+{
+  if (frame % 2 == 0)
+    g_byte_array_append (chunk, av1_16x16, sizeof (av1_16x16));
+}
+
+static void
+append_bit_writer (GByteArray * chunk, GstBitWriter * bw)
+{
+  gst_bit_writer_align_bytes (bw, 0);
+  g_byte_array_append (chunk, gst_bit_writer_get_data (bw),
+      gst_bit_writer_get_size (bw) / 8);
+  gst_bit_writer_reset (bw);
+}
+
+/* None of the bytes is zero, so that no start code is emulated */
+static void
+append_random_bytes (GByteArray * chunk, GRand * rand, guint size)
+{
+  guint offset = chunk->len, i;
+
+  g_byte_array_set_size (chunk, offset + size);
+  for (i = 0; i < size; i++)
+    chunk->data[offset + i] = g_rand_int_range (rand, 1, 256);
+}
+
+/* Profile 0, a key frame every GOP_SIZE frames, the others predicted from
+ * the previous frame */
+static void
+write_vp9_frame (GByteArray * chunk, guint frame, GRand * rand)
+{
+  guint sb_cols = (width + 63) / 64;
+  guint min_log2_tile_cols = 0, max_log2_tile_cols = 1;
+  guint compressed_size = g_rand_int_range (rand, 16, 256);
+  gboolean key = frame % GOP_SIZE == 0;
+  GstBitWriter bw;
+  guint i;
+
+  while ((64 << min_log2_tile_cols) < sb_cols)
+    min_log2_tile_cols++;
+  while ((sb_cols >> max_log2_tile_cols) >= 4)
+    max_log2_tile_cols++;
+  max_log2_tile_cols--;
+
+  gst_bit_writer_init (&bw);
+  /* frame_marker, profile, show_existing_frame */
+  gst_bit_writer_put_bits_uint8 (&bw, GST_VP9_FRAME_MARKER << 3, 5);
+  /* frame_type, show_frame, error_resilient_mode */
+  gst_bit_writer_put_bits_uint8 (&bw, key ? 2 : 6, 3);
+  if (key) {
+    gst_bit_writer_put_bits_uint32 (&bw, GST_VP9_SYNC_CODE, 24);
+    /* color_space, color_range */
+    gst_bit_writer_put_bits_uint8 (&bw, GST_VP9_CS_BT_709 << 1, 4);
+    gst_bit_writer_put_bits_uint16 (&bw, width - 1, 16);
+    gst_bit_writer_put_bits_uint16 (&bw, height - 1, 16);
+    /* render_and_frame_size_different */
+    gst_bit_writer_put_bits_uint8 (&bw, 0, 1);
+  } else {
+    /* reset_frame_context */
+    gst_bit_writer_put_bits_uint8 (&bw, 0, 2);
+    /* refresh_frame_flags */
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 8);
+    /* ref_frame_idx and ref_frame_sign_bias */
+    for (i = 0; i < GST_VP9_REFS_PER_FRAME; i++)
+      gst_bit_writer_put_bits_uint8 (&bw, 0, 4);
+    /* found_ref, render_and_frame_size_different, allow_high_precision_mv,
+     * is_filter_switchable */
+    gst_bit_writer_put_bits_uint8 (&bw, 9, 4);
+  }
+  /* refresh_frame_context, frame_parallel_decoding_mode,
+   * frame_context_idx */
+  gst_bit_writer_put_bits_uint8 (&bw, 0xc, 4);
+  /* loop_filter_level, loop_filter_sharpness,
+   * loop_filter_delta_enabled */
+  gst_bit_writer_put_bits_uint8 (&bw, 10, 6);
+  gst_bit_writer_put_bits_uint8 (&bw, 0, 4);
+  /* base_q_idx, no delta_q, segmentation_enabled */
+  gst_bit_writer_put_bits_uint8 (&bw, 60, 8);
+  gst_bit_writer_put_bits_uint8 (&bw, 0, 4);
+  /* a single tile */
+  if (max_log2_tile_cols > min_log2_tile_cols)
+    gst_bit_writer_put_bits_uint8 (&bw, 0, 1);
+  gst_bit_writer_put_bits_uint8 (&bw, 0, 1);
+  /* header_size_in_bytes */
+  gst_bit_writer_put_bits_uint16 (&bw, compressed_size, 16);
+  append_bit_writer (chunk, &bw);
+
+  append_random_bytes (chunk, rand, compressed_size +
+      width * height / (key ? 64 : 512));
+  /* the last byte must not look like a superframe index marker */
+  if ((chunk->data[chunk->len - 1] & 0xe0) == 0xc0)
+    chunk->data[chunk->len - 1] = 0x01;
+}
+
+static void
+put_start_code (GstBitWriter * bw, guint8 code)
+{
+  gst_bit_writer_put_bits_uint32 (bw, 0x100 | code, 32);
+}
+
+/* Main profile, a sequence header and an intra picture every GOP_SIZE
+ * frames, the other pictures predicted from the previous one, one slice per
+ * macroblock row */
+static void
+write_mpeg2_frame (GByteArray * chunk, guint frame, GRand * rand)
+{
+  gboolean intra = frame % GOP_SIZE == 0;
+  GstBitWriter bw;
+  guint i;
+
+  gst_bit_writer_init (&bw);
+  if (intra) {
+    put_start_code (&bw, GST_MPEG_VIDEO_PACKET_SEQUENCE);
+    gst_bit_writer_put_bits_uint16 (&bw, width, 12);
+    gst_bit_writer_put_bits_uint16 (&bw, height, 12);
+    /* square pixels, 30 fps */
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 4);
+    gst_bit_writer_put_bits_uint8 (&bw, 5, 4);
+    /* bit_rate_value, marker_bit, vbv_buffer_size_value */
+    gst_bit_writer_put_bits_uint32 (&bw, 0x3ffff, 18);
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 1);
+    gst_bit_writer_put_bits_uint16 (&bw, 112, 10);
+    /* constrained_parameters_flag, load_intra_quantiser_matrix,
+     * load_non_intra_quantiser_matrix */
+    gst_bit_writer_put_bits_uint8 (&bw, 0, 3);
+
+    put_start_code (&bw, GST_MPEG_VIDEO_PACKET_EXTENSION);
+    gst_bit_writer_put_bits_uint8 (&bw, GST_MPEG_VIDEO_PACKET_EXT_SEQUENCE,
+        4);
+    /* main profile, high level */
+    gst_bit_writer_put_bits_uint8 (&bw, 0x44, 8);
+    /* progressive_sequence, 4:2:0, no size extensions */
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 1);
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 2);
+    gst_bit_writer_put_bits_uint8 (&bw, 0, 4);
+    /* bit_rate_extension, marker_bit, vbv_buffer_size_extension */
+    gst_bit_writer_put_bits_uint16 (&bw, 0, 12);
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 1);
+    gst_bit_writer_put_bits_uint8 (&bw, 0, 8);
+    /* low_delay, no frame rate extension */
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 1);
+    gst_bit_writer_put_bits_uint8 (&bw, 0, 7);
+
+    put_start_code (&bw, GST_MPEG_VIDEO_PACKET_GOP);
+    /* time_code with only its marker_bit set, closed_gop, broken_link */
+    gst_bit_writer_put_bits_uint32 (&bw, 1 << 12, 25);
+    gst_bit_writer_put_bits_uint8 (&bw, 2, 2);
+    gst_bit_writer_align_bytes (&bw, 0);
+  }
+
+  put_start_code (&bw, GST_MPEG_VIDEO_PACKET_PICTURE);
+  gst_bit_writer_put_bits_uint16 (&bw, frame % GOP_SIZE, 10);
+  gst_bit_writer_put_bits_uint8 (&bw, intra ? GST_MPEG_VIDEO_PICTURE_TYPE_I :
+      GST_MPEG_VIDEO_PICTURE_TYPE_P, 3);
+  /* vbv_delay */
+  gst_bit_writer_put_bits_uint16 (&bw, 0xffff, 16);
+  /* full_pel_forward_vector, forward_f_code */
+  if (!intra)
+    gst_bit_writer_put_bits_uint8 (&bw, 7, 4);
+  /* extra_bit_picture */
+  gst_bit_writer_put_bits_uint8 (&bw, 0, 1);
+  gst_bit_writer_align_bytes (&bw, 0);
+
+  put_start_code (&bw, GST_MPEG_VIDEO_PACKET_EXTENSION);
+  gst_bit_writer_put_bits_uint8 (&bw, GST_MPEG_VIDEO_PACKET_EXT_PICTURE, 4);
+  /* f_code, only forward vectors in P pictures */
+  gst_bit_writer_put_bits_uint16 (&bw, intra ? 0xffff : 0x22ff, 16);
+  /* intra_dc_precision, picture_structure */
+  gst_bit_writer_put_bits_uint8 (&bw, 0, 2);
+  gst_bit_writer_put_bits_uint8 (&bw, GST_MPEG_VIDEO_PICTURE_STRUCTURE_FRAME,
+      2);
+  /* frame_pred_frame_dct, chroma_420_type, progressive_frame, the other
+   * flags unset */
+  gst_bit_writer_put_bits_uint16 (&bw, 0x106, 10);
+  gst_bit_writer_align_bytes (&bw, 0);
+
+  for (i = 0; i < height / 16; i++) {
+    put_start_code (&bw, GST_MPEG_VIDEO_PACKET_SLICE_MIN + i);
+    /* quantiser_scale_code, extra_bit_slice,
+     * macroblock_address_increment */
+    gst_bit_writer_put_bits_uint8 (&bw, 8, 5);
+    gst_bit_writer_put_bits_uint8 (&bw, 1, 2);
+    append_bit_writer (chunk, &bw);
+    append_random_bytes (chunk, rand, width / (intra ? 1 : 8));
+    gst_bit_writer_init (&bw);
+  }
+  gst_bit_writer_reset (&bw);
+}
+
+/* Parsing */
+
+static gboolean
+parse_h264_nal (GstH264NalParser * parser, GstH264NalUnit * nalu)
+{
+  GstH264ParserResult res = GST_H264_PARSER_OK;
+
+  switch (nalu->type) {
+    case GST_H264_NAL_SPS:{
+      GstH264SPS sps;
+
+      res = gst_h264_parser_parse_sps (parser, nalu, &sps);
+      if (res == GST_H264_PARSER_OK)
+        gst_h264_sps_clear (&sps);
+      break;
+    }
+    case GST_H264_NAL_PPS:{
+      GstH264PPS pps;
+
+      res = gst_h264_parser_parse_pps (parser, nalu, &pps);
+      if (res == GST_H264_PARSER_OK)
+        gst_h264_pps_clear (&pps);
+      break;
+    }
+    case GST_H264_NAL_SEI:{
+      GArray *messages;
+
+      res = gst_h264_parser_parse_sei (parser, nalu, &messages);
+      g_array_free (messages, TRUE);
+      break;
+    }
+    case GST_H264_NAL_SLICE:
+    case GST_H264_NAL_SLICE_IDR:{
+      GstH264SliceHdr slice;
+
+      res = gst_h264_parser_parse_slice_hdr (parser, nalu, &slice, TRUE,
+          TRUE);
+      break;
+    }
+    default:
+      break;
+  }
+
+  return res == GST_H264_PARSER_OK;
+}
+
+static guint
+parse_h264 (GPtrArray * chunks, guint * errors)
+{
+  GstH264NalParser *parser = gst_h264_nal_parser_new ();
+  guint n_nals = 0, i;
+
+  for (i = 0; i < chunks->len; i++) {
+    gsize size;
+    const guint8 *data = g_bytes_get_data (chunks->pdata[i], &size);
+    GstH264NalUnit nalu;
+    GstH264ParserResult res;
+
+    res = gst_h264_parser_identify_nalu (parser, data, 0, size, &nalu);
+    while (res == GST_H264_PARSER_OK || res == GST_H264_PARSER_NO_NAL_END) {
+      if (!parse_h264_nal (parser, &nalu))
+        (*errors)++;
+      n_nals++;
+
+      /* the last NAL unit of the chunk */
+      if (res == GST_H264_PARSER_NO_NAL_END)
+        break;
+      res = gst_h264_parser_identify_nalu (parser, data,
+          nalu.offset + nalu.size, size, &nalu);
+    }
+  }
+
+  gst_h264_nal_parser_free (parser);
+
+  return n_nals;
+}
+
+static gboolean
+parse_h265_nal (GstH265Parser * parser, GstH265NalUnit * nalu)
+{
+  GstH265ParserResult res = GST_H265_PARSER_OK;
+
+  switch (nalu->type) {
+    case GST_H265_NAL_VPS:{
+      GstH265VPS vps;
+
+      res = gst_h265_parser_parse_vps (parser, nalu, &vps);
+      break;
+    }
+    case GST_H265_NAL_SPS:{
+      GstH265SPS sps;
+
+      res = gst_h265_parser_parse_sps (parser, nalu, &sps, TRUE);
+      break;
+    }
+    case GST_H265_NAL_PPS:{
+      GstH265PPS pps;
+
+      res = gst_h265_parser_parse_pps (parser, nalu, &pps);
+      break;
+    }
+    case GST_H265_NAL_PREFIX_SEI:
+    case GST_H265_NAL_SUFFIX_SEI:{
+      GArray *messages;
+
+      res = gst_h265_parser_parse_sei (parser, nalu, &messages);
+      g_array_free (messages, TRUE);
+      break;
+    }
+    default:
+      if (nalu->type <= GST_H265_NAL_SLICE_CRA_NUT) {
+        GstH265SliceHdr slice;
+
+        res = gst_h265_parser_parse_slice_hdr (parser, nalu, &slice);
+        if (res == GST_H265_PARSER_OK)
+          gst_h265_slice_hdr_free (&slice);
+      }
+      break;
+  }
+
+  return res == GST_H265_PARSER_OK;
+}
+
+static guint
+parse_h265 (GPtrArray * chunks, guint * errors)
+{
+  GstH265Parser *parser = gst_h265_parser_new ();
+  guint n_nals = 0, i;
+
+  for (i = 0; i < chunks->len; i++) {
+    gsize size;
+    const guint8 *data = g_bytes_get_data (chunks->pdata[i], &size);
+    GstH265NalUnit nalu;
+    GstH265ParserResult res;
+
+    res = gst_h265_parser_identify_nalu (parser, data, 0, size, &nalu);
+    while (res == GST_H265_PARSER_OK || res == GST_H265_PARSER_NO_NAL_END) {
+      if (!parse_h265_nal (parser, &nalu))
+        (*errors)++;
+      n_nals++;
+
+      /* the last NAL unit of the chunk */
+      if (res == GST_H265_PARSER_NO_NAL_END)
+        break;
+      res = gst_h265_parser_identify_nalu (parser, data,
+          nalu.offset + nalu.size, size, &nalu);
+    }
+  }
+
+  gst_h265_parser_free (parser);
+
+  return n_nals;
+}
+
+static gboolean
+parse_av1_obu (GstAV1Parser * parser, GstAV1OBU * obu)
+{
+  GstAV1ParserResult res = GST_AV1_PARSER_OK;
+  GstAV1FrameHeaderOBU *frame_header = NULL;
+  GstAV1FrameOBU frame;
+
+  switch (obu->obu_type) {
+    case GST_AV1_OBU_SEQUENCE_HEADER:{
+      GstAV1SequenceHeaderOBU seq_header;
+
+      res = gst_av1_parser_parse_sequence_header_obu (parser, obu,
+          &seq_header);
+      break;
+    }
+    case GST_AV1_OBU_TEMPORAL_DELIMITER:
+      res = gst_av1_parser_parse_temporal_delimiter_obu (parser, obu);
+      break;
+    case GST_AV1_OBU_FRAME_HEADER:
+      res = gst_av1_parser_parse_frame_header_obu (parser, obu,
+          &frame.frame_header);
+      frame_header = &frame.frame_header;
+      break;
+    case GST_AV1_OBU_REDUNDANT_FRAME_HEADER:
+      res = gst_av1_parser_parse_frame_header_obu (parser, obu,
+          &frame.frame_header);
+      break;
+    case GST_AV1_OBU_FRAME:
+      res = gst_av1_parser_parse_frame_obu (parser, obu, &frame);
+      frame_header = &frame.frame_header;
+      break;
+    case GST_AV1_OBU_TILE_GROUP:{
+      GstAV1TileGroupOBU tile_group;
+
+      res = gst_av1_parser_parse_tile_group_obu (parser, obu, &tile_group);
+      break;
+    }
+    case GST_AV1_OBU_METADATA:{
+      GstAV1MetadataOBU metadata;
+
+      res = gst_av1_parser_parse_metadata_obu (parser, obu, &metadata);
+      break;
+    }
+    case GST_AV1_OBU_TILE_LIST:{
+      GstAV1TileListOBU tile_list;
+
+      res = gst_av1_parser_parse_tile_list_obu (parser, obu, &tile_list);
+      break;
+    }
+    default:
+      break;
+  }
+
+  /* Decoders update the references after each frame, the headers of the
+   * next ones depend on them */
+  if (res == GST_AV1_PARSER_OK && frame_header
+      && !frame_header->show_existing_frame)
+    res = gst_av1_parser_reference_frame_update (parser, frame_header);
+
+  return res == GST_AV1_PARSER_OK;
+}
+
+static guint
+parse_av1 (GPtrArray * chunks, guint * errors)
+{
+  GstAV1Parser *parser = gst_av1_parser_new ();
+  guint n_obus = 0, i;
+
+  gst_av1_parser_reset (parser, FALSE);
+
+  for (i = 0; i < chunks->len; i++) {
+    gsize size;
+    const guint8 *data = g_bytes_get_data (chunks->pdata[i], &size);
+    gsize offset = 0;
+
+    while (offset < size) {
+      GstAV1OBU obu;
+      GstAV1ParserResult res;
+      guint32 consumed = 0;
+
+      res = gst_av1_parser_identify_one_obu (parser, data + offset,
+          size - offset, &obu, &consumed);
+      if (res == GST_AV1_PARSER_OK) {
+        if (!parse_av1_obu (parser, &obu))
+          (*errors)++;
+      } else if (res != GST_AV1_PARSER_DROP || consumed == 0) {
+        (*errors)++;
+        break;
+      }
+      n_obus++;
+      offset += consumed;
+    }
+  }
+
+  gst_av1_parser_free (parser);
+
+  return n_obus;
+}
+
+static guint
+parse_vp9 (GPtrArray * chunks, guint * errors)
+{
+  GstVp9Parser *parser = gst_vp9_parser_new ();
+  guint n_frames = 0, i, j;
+
+  for (i = 0; i < chunks->len; i++) {
+    gsize size;
+    const guint8 *data = g_bytes_get_data (chunks->pdata[i], &size);
+    GstVp9SuperframeInfo superframe_info;
+    gsize offset = 0;
+
+    if (gst_vp9_parser_parse_superframe_info (parser, &superframe_info, data,
+            size) != GST_VP9_PARSER_OK) {
+      (*errors)++;
+      continue;
+    }
+
+    for (j = 0; j < superframe_info.frames_in_superframe; j++) {
+      GstVp9FrameHdr frame_hdr;
+      guint32 frame_size = superframe_info.frame_sizes[j];
+
+      if (offset + frame_size > size) {
+        (*errors)++;
+        break;
+      }
+
+      if (gst_vp9_parser_parse_frame_header (parser, &frame_hdr,
+              data + offset, frame_size) != GST_VP9_PARSER_OK)
+        (*errors)++;
+      n_frames++;
+      offset += frame_size;
+    }
+  }
+
+  gst_vp9_parser_free (parser);
+
+  return n_frames;
+}
+
+static gboolean
+parse_mpeg2_packet (GstMpegVideoPacket * packet,
+    GstMpegVideoSequenceHdr * seq_hdr, gboolean * have_seq_hdr)
+{
+  switch (packet->type) {
+    case GST_MPEG_VIDEO_PACKET_SEQUENCE:
+      *have_seq_hdr =
+          gst_mpeg_video_packet_parse_sequence_header (packet, seq_hdr);
+      return *have_seq_hdr;
+    case GST_MPEG_VIDEO_PACKET_EXTENSION:
+      if (packet->size < 1)
+        return FALSE;
+
+      switch (packet->data[packet->offset] >> 4) {
+        case GST_MPEG_VIDEO_PACKET_EXT_SEQUENCE:{
+          GstMpegVideoSequenceExt seq_ext;
+
+          return gst_mpeg_video_packet_parse_sequence_extension (packet,
+              &seq_ext);
+        }
+        case GST_MPEG_VIDEO_PACKET_EXT_SEQUENCE_DISPLAY:{
+          GstMpegVideoSequenceDisplayExt seq_display_ext;
+
+          return gst_mpeg_video_packet_parse_sequence_display_extension
+              (packet, &seq_display_ext);
+        }
+        case GST_MPEG_VIDEO_PACKET_EXT_QUANT_MATRIX:{
+          GstMpegVideoQuantMatrixExt quant_matrix_ext;
+
+          return gst_mpeg_video_packet_parse_quant_matrix_extension (packet,
+              &quant_matrix_ext);
+        }
+        case GST_MPEG_VIDEO_PACKET_EXT_PICTURE:{
+          GstMpegVideoPictureExt pic_ext;
+
+          return gst_mpeg_video_packet_parse_picture_extension (packet,
+              &pic_ext);
+        }
+        default:
+          return TRUE;
+      }
+    case GST_MPEG_VIDEO_PACKET_GOP:{
+      GstMpegVideoGop gop;
+
+      return gst_mpeg_video_packet_parse_gop (packet, &gop);
+    }
+    case GST_MPEG_VIDEO_PACKET_PICTURE:{
+      GstMpegVideoPictureHdr pic_hdr;
+
+      return gst_mpeg_video_packet_parse_picture_header (packet, &pic_hdr);
+    }
+    default:
+      if (GST_MPEG_VIDEO_PACKET_IS_SLICE (packet->type)) {
+        GstMpegVideoSliceHdr slice_hdr;
+
+        return *have_seq_hdr &&
+            gst_mpeg_video_packet_parse_slice_header (packet, &slice_hdr,
+            seq_hdr, NULL);
+      }
+      return TRUE;
+  }
+}
+
+static guint
+parse_mpeg2 (GPtrArray * chunks, guint * errors)
+{
+  GstMpegVideoSequenceHdr seq_hdr;
+  gboolean have_seq_hdr = FALSE;
+  guint n_packets = 0, i;
+
+  for (i = 0; i < chunks->len; i++) {
+    gsize size;
+    const guint8 *data = g_bytes_get_data (chunks->pdata[i], &size);
+    GstMpegVideoPacket packet;
+    guint offset = 0;
+
+    while (gst_mpeg_video_parse (&packet, data, size, offset)) {
+      gboolean last = packet.size == -1;
+
+      if (last)
+        packet.size = size - packet.offset;
+      if (!parse_mpeg2_packet (&packet, &seq_hdr, &have_seq_hdr))
+        (*errors)++;
+      n_packets++;
+
+      if (last)
+        break;
+      offset = packet.offset;
+    }
+  }
+
+  return n_packets;
+}
+
+typedef void (*WriteFrameFunc) (GByteArray * chunk, guint frame,
+    GRand * rand);
+typedef guint (*ParseFunc) (GPtrArray * chunks, guint * errors);
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *unit;            /* what parse() counts */
+  WriteFrameFunc write_frame;
+  ParseFunc parse;
+  /* tried in order, the first one available is used */
+  const gchar *encoders[3];
+} Codec;
+
+#define GOP_SIZE_STR G_STRINGIFY (GOP_SIZE)
+
+static const Codec codecs[] = {
+  {"h264", "NAL", write_h264_frame, parse_h264,
+        {"x264enc speed-preset=ultrafast key-int-max=" GOP_SIZE_STR
+              " ! video/x-h264,stream-format=byte-stream,alignment=au",
+              "openh264enc gop-size=" GOP_SIZE_STR
+              " ! video/x-h264,stream-format=byte-stream,alignment=au",
+            NULL}},
+  {"h265", "NAL", write_h265_frame, parse_h265,
+        {"x265enc speed-preset=ultrafast key-int-max=" GOP_SIZE_STR
+              " ! video/x-h265,stream-format=byte-stream,alignment=au",
+            NULL}},
+  {"av1", "OBU", write_av1_frame, parse_av1,
+        {"av1enc cpu-used=8 ! video/x-av1,stream-format=obu-stream",
+              "rav1enc speed-preset=10 ! video/x-av1,stream-format=obu-stream",
+            NULL}},
+  {"vp9", "frame", write_vp9_frame, parse_vp9,
+        {"vp9enc deadline=1 keyframe-max-dist=" GOP_SIZE_STR, NULL}},
+  {"mpeg2", "packet", write_mpeg2_frame, parse_mpeg2,
+        {"avenc_mpeg2video gop-size=" GOP_SIZE_STR " ! mpegvideoparse",
+            "mpeg2enc", NULL}},
+};
+
+static GPtrArray *
+generate_stream (const Codec * codec, guint frames)
+{
+  GPtrArray *chunks =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+  GRand *rand = g_rand_new_with_seed (0x01);
+  guint i;
+
+  for (i = 0; i < frames; i++) {
+    GByteArray *chunk = g_byte_array_new ();
+
+    codec->write_frame (chunk, i, rand);
+    if (chunk->len > 0)
+      g_ptr_array_add (chunks, g_byte_array_free_to_bytes (chunk));
+    else
+      g_byte_array_unref (chunk);
+  }
+
+  g_rand_free (rand);
+
+  return chunks;
+}
+
+static void
+on_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    GPtrArray * chunks)
+{
+  GstMapInfo map;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return;
+  g_ptr_array_add (chunks, g_bytes_new (map.data, map.size));
+  gst_buffer_unmap (buffer, &map);
+}
+
+/* Returns the encoded frames, none if the encoder isn't available or
+ * failed */
+static GPtrArray *
+encode_stream (const gchar * encoder, guint frames, const gchar * pattern)
+{
+  GPtrArray *chunks =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+  GstElement *pipeline, *sink;
+  GError *err = NULL;
+  GstMessage *msg;
+  GstBus *bus;
+  gchar *desc;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%u pattern=%s ! "
+      "video/x-raw,format=I420,width=%u,height=%u,framerate=30/1 ! %s ! "
+      "fakesink name=sink signal-handoffs=true sync=false", frames, pattern,
+      width, height, encoder);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (err) {
+    GST_INFO ("Can't use %s: %s", encoder, err->message);
+    g_clear_error (&err);
+    if (pipeline)
+      gst_object_unref (pipeline);
+    return chunks;
+  }
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (on_handoff), chunks);
+  gst_object_unref (sink);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    GST_INFO ("Encoding with %s failed", encoder);
+    g_ptr_array_set_size (chunks, 0);
+  }
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return chunks;
+}
+
+static void
+run (const Codec * codec, const gchar * corpus, GPtrArray * chunks,
+    gint iterations)
+{
+  gdouble best = G_MAXDOUBLE, allocations_per_unit = -1;
+  guint units = 0, errors = 0, i;
+  gsize size = 0;
+  gint iteration;
+
+  for (i = 0; i < chunks->len; i++)
+    size += g_bytes_get_size (chunks->pdata[i]);
+
+  for (iteration = 0; iteration < iterations; iteration++) {
+    gint64 start, end;
+
+    errors = 0;
+#ifdef HAVE_ALLOCATION_COUNTING
+    g_atomic_int_set (&allocations, 0);
+    count_allocations = TRUE;
+#endif
+    start = g_get_monotonic_time ();
+    units = codec->parse (chunks, &errors);
+    end = g_get_monotonic_time ();
+#ifdef HAVE_ALLOCATION_COUNTING
+    count_allocations = FALSE;
+    if (units > 0)
+      allocations_per_unit = g_atomic_int_get (&allocations) / (gdouble) units;
+#endif
+    best = MIN (best, (end - start) / (gdouble) G_USEC_PER_SEC);
+  }
+
+  g_print ("%s, %s, %s, %" G_GSIZE_FORMAT ", %u, %u, %.6f, %.2f, %.0f, "
+      "%.3f\n", codec->name, corpus, codec->unit, size, units, errors, best,
+      size / best / (1024 * 1024), units / best, allocations_per_unit);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint iterations = DEFAULT_ITERATIONS;
+  gint frames = DEFAULT_FRAMES;
+  gint w = DEFAULT_WIDTH, h = DEFAULT_HEIGHT;
+  gchar *pattern = NULL, *corpus = NULL;
+  gboolean synthetic, generated;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  guint i;
+  GOptionEntry options[] = {
+    {"iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of runs per corpus", NULL},
+    {"frames", 'f', 0, G_OPTION_ARG_INT, &frames,
+        "Number of frames of each corpus", NULL},
+    {"width", 'w', 0, G_OPTION_ARG_INT, &w, "Width of the frames", NULL},
+    {"height", 'h', 0, G_OPTION_ARG_INT, &h, "Height of the frames", NULL},
+    {"pattern", 'p', 0, G_OPTION_ARG_STRING, &pattern,
+        "videotestsrc pattern of the generated corpora (default: ball)",
+        NULL},
+    {"corpus", 'c', 0, G_OPTION_ARG_STRING, &corpus,
+        "Corpora to run: synthetic, generated or all (default)", NULL},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- codec parsers benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  synthetic = !corpus || g_str_equal (corpus, "all")
+      || g_str_equal (corpus, "synthetic");
+  generated = !corpus || g_str_equal (corpus, "all")
+      || g_str_equal (corpus, "generated");
+
+  /* MPEG-2 slices can't address more than 175 macroblock rows without the
+   * vertical position extension */
+  if (iterations <= 0 || frames <= 0 || w < 64 || w > 4080 || h < 64
+      || h > 2800 || (!synthetic && !generated)) {
+    g_printerr ("Invalid iterations, frames, size or corpus\n");
+    return 1;
+  }
+  width = GST_ROUND_UP_16 (w);
+  height = GST_ROUND_UP_16 (h);
+
+  /* the units are NALs, OBUs, frames or packets depending on the codec, as
+   * named in the unit column */
+  g_print ("# codec, corpus, unit, bytes, units, errors, seconds, MB/s, "
+      "units/s, allocations/unit\n");
+
+  for (i = 0; i < G_N_ELEMENTS (codecs); i++) {
+    const Codec *codec = &codecs[i];
+    GPtrArray *chunks;
+    guint j;
+
+    if (synthetic) {
+      chunks = generate_stream (codec, frames);
+      run (codec, "synthetic", chunks, iterations);
+      g_ptr_array_unref (chunks);
+    }
+
+    if (!generated)
+      continue;
+
+    for (j = 0; codec->encoders[j]; j++) {
+      chunks = encode_stream (codec->encoders[j], frames,
+          pattern ? pattern : "ball");
+      if (chunks->len > 0) {
+        gchar *name = g_strdup_printf ("generated-%.*s",
+            (gint) strcspn (codec->encoders[j], " "), codec->encoders[j]);
+
+        run (codec, name, chunks, iterations);
+        g_free (name);
+        g_ptr_array_unref (chunks);
+        break;
+      }
+      g_ptr_array_unref (chunks);
+    }
+    if (!codec->encoders[j])
+      g_printerr ("No %s encoder available, skipping its generated corpus\n",
+          codec->name);
+  }
+
+  g_free (pattern);
+  g_free (corpus);
+
+  return 0;
+}
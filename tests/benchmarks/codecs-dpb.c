@@ -0,0 +1,393 @@
+/* GStreamer
+ *
+ * codecs-dpb.c: measure reference picture lookups in the H.264 and H.265
+ * decoded picture buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Runs the DPB side of decoding frames with many slices: for H.264 the
+ * picture numbers are derived once per frame, then every slice reorders its
+ * reference picture list with modification commands looking up each
+ * reference by pic_num or long_term_pic_num. For H.265 every slice segment
+ * of a picture looks up its reference picture set by POC, which the decoder
+ * only does once per picture, so this is the worst case of streams with a
+ * new picture every slice. After each frame the oldest short term reference
+ * slides out of the DPB and the new frame is stored, as with the sliding
+ * window marking process.
+ *
+ * The "linear" rows walk the pictures of gst_h26X_dpb_get_pictures_all()
+ * like the lookups did before the DPB had an index, for comparison. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/codecs/gsth264picture.h>
+#include <gst/codecs/gsth265picture.h>
+
+#define DEFAULT_FRAMES 1000
+#define DEFAULT_SLICES 68
+#define DEFAULT_REFS 16
+#define DEFAULT_LONG_TERM_REFS 2
+#define DEFAULT_ITERATIONS 5
+#define MAX_FRAME_NUM 256
+#define MAX_POC_LSB 256
+
+static gint n_frames = DEFAULT_FRAMES;
+static gint n_slices = DEFAULT_SLICES;
+static gint n_refs = DEFAULT_REFS;
+static gint n_long_term_refs = DEFAULT_LONG_TERM_REFS;
+
+static GstH264Picture *
+h264_linear_short_ref (GstH264Dpb * dpb, gint pic_num)
+{
+  GArray *pictures = gst_h264_dpb_get_pictures_all (dpb);
+  GstH264Picture *ret = NULL;
+  guint i;
+
+  for (i = 0; i < pictures->len; i++) {
+    GstH264Picture *picture = g_array_index (pictures, GstH264Picture *, i);
+
+    if (GST_H264_PICTURE_IS_SHORT_TERM_REF (picture)
+        && picture->pic_num == pic_num) {
+      ret = picture;
+      break;
+    }
+  }
+
+  g_array_unref (pictures);
+  return ret;
+}
+
+static GstH264Picture *
+h264_linear_long_ref (GstH264Dpb * dpb, gint long_term_pic_num)
+{
+  GArray *pictures = gst_h264_dpb_get_pictures_all (dpb);
+  GstH264Picture *ret = NULL;
+  guint i;
+
+  for (i = 0; i < pictures->len; i++) {
+    GstH264Picture *picture = g_array_index (pictures, GstH264Picture *, i);
+
+    if (GST_H264_PICTURE_IS_LONG_TERM_REF (picture)
+        && picture->long_term_pic_num == long_term_pic_num) {
+      ret = picture;
+      break;
+    }
+  }
+
+  g_array_unref (pictures);
+  return ret;
+}
+
+static GstH264Picture *
+h264_new_picture (gint frame_num)
+{
+  GstH264Picture *picture = gst_h264_picture_new ();
+
+  picture->frame_num = picture->pic_num = frame_num;
+  picture->ref = GST_H264_PICTURE_REF_SHORT_TERM;
+  /* stored like the pictures of a frame_num gap, which are never waiting
+   * for output, so that no bumping is needed */
+  picture->nonexisting = TRUE;
+
+  return picture;
+}
+
+/* Returns the number of lookups done */
+static guint64
+h264_run (gboolean linear, guint64 * found)
+{
+  GstH264Dpb *dpb = gst_h264_dpb_new ();
+  guint64 lookups = 0;
+  gint n_short_term_refs = n_refs - n_long_term_refs;
+  gint frame_num = 0;
+  gint i, j, k;
+
+  gst_h264_dpb_set_max_num_frames (dpb, n_refs);
+
+  for (i = 0; i < n_long_term_refs; i++) {
+    GstH264Picture *picture = h264_new_picture (frame_num);
+
+    picture->ref = GST_H264_PICTURE_REF_LONG_TERM;
+    picture->long_term_frame_idx = i;
+    gst_h264_dpb_add (dpb, picture);
+    frame_num = (frame_num + 1) % MAX_FRAME_NUM;
+  }
+
+  for (i = 0; i < n_frames; i++) {
+    GstH264Picture *current = h264_new_picture (frame_num);
+
+    gst_h264_dpb_update_pic_nums (dpb, current, frame_num, MAX_FRAME_NUM);
+
+    for (j = 0; j < n_slices; j++) {
+      /* abs_diff_pic_num commands for every short term reference, most
+       * recent first, then long_term_pic_num commands */
+      for (k = 1; k <= MIN (n_short_term_refs, i); k++) {
+        GstH264Picture *ref;
+
+        if (linear)
+          ref = h264_linear_short_ref (dpb, frame_num - k);
+        else
+          ref = gst_h264_dpb_get_short_ref_by_pic_num (dpb, frame_num - k);
+        *found += ref != NULL;
+        lookups++;
+      }
+
+      for (k = 0; k < n_long_term_refs; k++) {
+        GstH264Picture *ref;
+
+        if (linear)
+          ref = h264_linear_long_ref (dpb, k);
+        else
+          ref = gst_h264_dpb_get_long_ref_by_long_term_pic_num (dpb, k);
+        *found += ref != NULL;
+        lookups++;
+      }
+    }
+
+    /* 8.2.5.3 Sliding window decoded reference picture marking */
+    if (i >= n_short_term_refs) {
+      GstH264Picture *oldest =
+          gst_h264_dpb_get_lowest_frame_num_short_ref (dpb);
+
+      if (oldest) {
+        oldest->ref = GST_H264_PICTURE_REF_NONE;
+        gst_h264_picture_unref (oldest);
+      }
+      gst_h264_dpb_delete_unused (dpb);
+    }
+
+    gst_h264_dpb_add (dpb, current);
+    frame_num = (frame_num + 1) % MAX_FRAME_NUM;
+  }
+
+  gst_h264_dpb_free (dpb);
+
+  return lookups;
+}
+
+static GstH265Picture *
+h265_linear_short_ref (GstH265Dpb * dpb, gint poc)
+{
+  GArray *pictures = gst_h265_dpb_get_pictures_all (dpb);
+  GstH265Picture *ret = NULL;
+  guint i;
+
+  for (i = 0; i < pictures->len; i++) {
+    GstH265Picture *picture = g_array_index (pictures, GstH265Picture *, i);
+
+    if (picture->ref && !picture->long_term && picture->pic_order_cnt == poc) {
+      ret = gst_h265_picture_ref (picture);
+      break;
+    }
+  }
+
+  g_array_unref (pictures);
+  return ret;
+}
+
+static GstH265Picture *
+h265_linear_ref_by_poc_lsb (GstH265Dpb * dpb, gint poc_lsb)
+{
+  GArray *pictures = gst_h265_dpb_get_pictures_all (dpb);
+  GstH265Picture *ret = NULL;
+  guint i;
+
+  for (i = 0; i < pictures->len; i++) {
+    GstH265Picture *picture = g_array_index (pictures, GstH265Picture *, i);
+
+    if (picture->ref && picture->pic_order_cnt_lsb == poc_lsb) {
+      ret = gst_h265_picture_ref (picture);
+      break;
+    }
+  }
+
+  g_array_unref (pictures);
+  return ret;
+}
+
+static GstH265Picture *
+h265_new_picture (gint poc)
+{
+  GstH265Picture *picture = gst_h265_picture_new ();
+
+  picture->pic_order_cnt = poc;
+  picture->pic_order_cnt_lsb = poc % MAX_POC_LSB;
+  picture->output_flag = FALSE;
+
+  return picture;
+}
+
+static guint64
+h265_run (gboolean linear, guint64 * found)
+{
+  GstH265Dpb *dpb = gst_h265_dpb_new ();
+  GArray *short_term = g_array_new (FALSE, FALSE, sizeof (GstH265Picture *));
+  guint64 lookups = 0;
+  gint n_short_term_refs = n_refs - n_long_term_refs;
+  gint poc = 0;
+  gint i, j, k;
+
+  gst_h265_dpb_set_max_num_pics (dpb, n_refs);
+
+  for (i = 0; i < n_long_term_refs; i++) {
+    GstH265Picture *picture = h265_new_picture (poc);
+
+    gst_h265_dpb_add (dpb, picture);
+    picture->long_term = TRUE;
+    poc += 2;
+  }
+
+  for (i = 0; i < n_frames; i++) {
+    GstH265Picture *current = h265_new_picture (poc);
+
+    for (j = 0; j < n_slices; j++) {
+      /* PocStCurrBefore, then PocLtCurr without delta_poc_msb_present_flag */
+      for (k = short_term->len; k > 0; k--) {
+        GstH265Picture *ref;
+        gint ref_poc =
+            g_array_index (short_term, GstH265Picture *, k - 1)->pic_order_cnt;
+
+        if (linear)
+          ref = h265_linear_short_ref (dpb, ref_poc);
+        else
+          ref = gst_h265_dpb_get_short_ref_by_poc (dpb, ref_poc);
+        if (ref) {
+          (*found)++;
+          gst_h265_picture_unref (ref);
+        }
+        lookups++;
+      }
+
+      for (k = 0; k < n_long_term_refs; k++) {
+        GstH265Picture *ref;
+
+        if (linear)
+          ref = h265_linear_ref_by_poc_lsb (dpb, 2 * k);
+        else
+          ref = gst_h265_dpb_get_ref_by_poc_lsb (dpb, 2 * k);
+        if (ref) {
+          (*found)++;
+          gst_h265_picture_unref (ref);
+        }
+        lookups++;
+      }
+    }
+
+    /* The oldest short term reference is not in the RPS of the next
+     * picture anymore */
+    if ((gint) short_term->len >= n_short_term_refs) {
+      GstH265Picture *oldest = g_array_index (short_term, GstH265Picture *, 0);
+
+      oldest->ref = FALSE;
+      g_array_remove_index (short_term, 0);
+      gst_h265_dpb_delete_unused (dpb);
+    }
+
+    g_array_append_val (short_term, current);
+    gst_h265_dpb_add (dpb, current);
+    /* keep the long term references out of the poc_lsb range of the
+     * short term ones */
+    poc += 2;
+    if (poc % MAX_POC_LSB < 2 * n_long_term_refs)
+      poc += 2 * n_long_term_refs;
+  }
+
+  g_array_unref (short_term);
+  gst_h265_dpb_free (dpb);
+
+  return lookups;
+}
+
+static void
+run (const gchar * codec, guint64 (*func) (gboolean, guint64 *),
+    gboolean linear, gint iterations)
+{
+  gdouble best = G_MAXDOUBLE;
+  guint64 lookups = 0;
+  guint64 found = 0;
+  gint i;
+
+  for (i = 0; i < iterations; i++) {
+    gint64 start, end;
+
+    found = 0;
+    start = g_get_monotonic_time ();
+    lookups = func (linear, &found);
+    end = g_get_monotonic_time ();
+    best = MIN (best, (end - start) / (gdouble) G_USEC_PER_SEC);
+  }
+
+  if (found != lookups)
+    g_printerr ("%s: %" G_GUINT64_FORMAT " lookups failed\n", codec,
+        lookups - found);
+
+  g_print ("%s, %s, %d, %d, %d, %" G_GUINT64_FORMAT ", %.6f, %.0f\n", codec,
+      linear ? "linear" : "indexed", n_refs, n_slices, n_frames, lookups,
+      best, lookups / best);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint iterations = DEFAULT_ITERATIONS;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GOptionEntry options[] = {
+    {"iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of runs per test", NULL},
+    {"frames", 'f', 0, G_OPTION_ARG_INT, &n_frames,
+        "Number of frames to decode", NULL},
+    {"slices", 's', 0, G_OPTION_ARG_INT, &n_slices,
+        "Number of slices per frame", NULL},
+    {"refs", 'r', 0, G_OPTION_ARG_INT, &n_refs,
+        "Number of reference pictures in the DPB", NULL},
+    {"long-term-refs", 'l', 0, G_OPTION_ARG_INT, &n_long_term_refs,
+        "Number of them that are long term references", NULL},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- DPB reference lookup benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (iterations <= 0 || n_frames <= 0 || n_slices <= 0 || n_refs <= 0 ||
+      n_refs > GST_H264_DPB_MAX_SIZE || n_long_term_refs < 0 ||
+      n_long_term_refs >= n_refs) {
+    g_printerr ("Invalid iterations, frames, slices or references\n");
+    return 1;
+  }
+
+  g_print ("# codec, lookup, refs, slices, frames, lookups, seconds, "
+      "lookups/s\n");
+
+  run ("h264", h264_run, TRUE, iterations);
+  run ("h264", h264_run, FALSE, iterations);
+  run ("h265", h265_run, TRUE, iterations);
+  run ("h265", h265_run, FALSE, iterations);
+
+  return 0;
+}
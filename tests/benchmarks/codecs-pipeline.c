@@ -0,0 +1,448 @@
+/* GStreamer
+ *
+ * codecs-pipeline.c: measure the pipelined mode of the H.264 and H.265
+ * decoder base classes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Decodes synthetic H.264 and H.265 streams with nullh264dec and
+ * nullh265dec, which spend --delay microseconds per picture in end_picture
+ * like a hardware decoder waiting for the picture would, and reports the
+ * frame rate for each pipeline depth. With a depth of 0, parsing and
+ * submission are serialized on the streaming thread, otherwise parsing the
+ * next frames overlaps with the submission of the previous ones. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include <gst/codecparsers/nalutils.h>
+
+#define DEFAULT_FRAMES 300
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1088
+#define DEFAULT_SLICES 8
+#define DEFAULT_DELAY 2000
+#define DEFAULT_DEPTHS "0,1,2,4"
+#define DEFAULT_ITERATIONS 3
+#define GOP_SIZE 30
+#define FRAME_DURATION (GST_SECOND / 30)
+
+static guint width = DEFAULT_WIDTH;
+static guint height = DEFAULT_HEIGHT;
+static guint n_slices = DEFAULT_SLICES;
+
+static void
+put_se (NalWriter * nw, gint32 value)
+{
+  nal_writer_put_ue (nw, value > 0 ? 2 * value - 1 : -2 * value);
+}
+
+/* About 0.1 bit per pixel, so that there is something to scan for start
+ * codes */
+static void
+put_slice_data (NalWriter * nw, GRand * rand, gboolean intra)
+{
+  guint size = width * height / 80 / n_slices * (intra ? 4 : 1);
+  guint i;
+
+  for (i = 0; i < size; i++)
+    nal_writer_put_bits_uint8 (nw, g_rand_int_range (rand, 0, 256), 8);
+}
+
+static void
+append_nal (GByteArray * chunk, NalWriter * nw)
+{
+  GstMemory *mem;
+  GstMapInfo map;
+
+  nal_writer_do_rbsp_trailing_bits (nw);
+  mem = nal_writer_reset_and_get_memory (nw);
+  gst_memory_map (mem, &map, GST_MAP_READ);
+  g_byte_array_append (chunk, map.data, map.size);
+  gst_memory_unmap (mem, &map);
+  gst_memory_unref (mem);
+}
+
+/* Baseline profile, one reference frame and an IDR every GOP_SIZE frames */
+static void
+write_h264_frame (GByteArray * chunk, guint frame, GRand * rand)
+{
+  guint mb_width = width / 16, mb_height = height / 16;
+  guint n_mbs = mb_width * mb_height;
+  gboolean idr = frame % GOP_SIZE == 0;
+  NalWriter nw;
+  guint i;
+
+  if (idr) {
+    /* SPS */
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, 0x67, 8);
+    nal_writer_put_bits_uint8 (&nw, GST_H264_PROFILE_BASELINE, 8);
+    nal_writer_put_bits_uint8 (&nw, 0, 8);
+    nal_writer_put_bits_uint8 (&nw, 40, 8);
+    nal_writer_put_ue (&nw, 0);
+    /* log2_max_frame_num_minus4 */
+    nal_writer_put_ue (&nw, 1);
+    /* pic_order_cnt_type */
+    nal_writer_put_ue (&nw, 2);
+    /* max_num_ref_frames */
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, mb_width - 1);
+    nal_writer_put_ue (&nw, mb_height - 1);
+    /* frame_mbs_only_flag, direct_8x8_inference_flag */
+    nal_writer_put_bits_uint8 (&nw, 3, 2);
+    /* frame_cropping_flag, vui_parameters_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+
+    /* PPS */
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, 0x68, 8);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    /* deblocking_filter_control_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 4, 3);
+    append_nal (chunk, &nw);
+  }
+
+  for (i = 0; i < n_slices; i++) {
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, idr ? 0x65 : 0x61, 8);
+    nal_writer_put_ue (&nw, i * n_mbs / n_slices);
+    nal_writer_put_ue (&nw, idr ? 7 : 5);
+    nal_writer_put_ue (&nw, 0);
+    /* frame_num */
+    nal_writer_put_bits_uint8 (&nw, frame % GOP_SIZE, 5);
+    if (idr) {
+      nal_writer_put_ue (&nw, (frame / GOP_SIZE) & 1);
+    } else {
+      /* num_ref_idx_active_override_flag,
+       * ref_pic_list_modification_flag_l0 */
+      nal_writer_put_bits_uint8 (&nw, 0, 2);
+    }
+    /* dec_ref_pic_marking () */
+    nal_writer_put_bits_uint8 (&nw, 0, idr ? 2 : 1);
+    /* slice_qp_delta, disable_deblocking_filter_idc */
+    put_se (&nw, 0);
+    nal_writer_put_ue (&nw, 1);
+    put_slice_data (&nw, rand, idr);
+    append_nal (chunk, &nw);
+  }
+}
+
+static void
+put_h265_profile_tier_level (NalWriter * nw)
+{
+  nal_writer_put_bits_uint8 (nw, GST_H265_PROFILE_IDC_MAIN, 8);
+  nal_writer_put_bits_uint32 (nw, 0x60000000, 32);
+  nal_writer_put_bits_uint8 (nw, 9, 4);
+  nal_writer_put_bits_uint32 (nw, 0, 32);
+  nal_writer_put_bits_uint16 (nw, 0, 12);
+  /* level 4.1 */
+  nal_writer_put_bits_uint8 (nw, 123, 8);
+}
+
+static void
+put_h265_nal_header (NalWriter * nw, GstH265NalUnitType type)
+{
+  nal_writer_put_bits_uint8 (nw, type << 1, 8);
+  nal_writer_put_bits_uint8 (nw, 1, 8);
+}
+
+/* Main profile, 64x64 CTBs, one reference frame and an IDR every GOP_SIZE
+ * frames */
+static void
+write_h265_frame (GByteArray * chunk, guint frame, GRand * rand)
+{
+  guint n_ctbs = ((width + 63) / 64) * ((height + 63) / 64);
+  gboolean idr = frame % GOP_SIZE == 0;
+  NalWriter nw;
+  guint i;
+
+  if (idr) {
+    /* VPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_VPS);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    nal_writer_put_bits_uint8 (&nw, 3, 2);
+    nal_writer_put_bits_uint8 (&nw, 0, 6);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_bits_uint16 (&nw, 0xffff, 16);
+    put_h265_profile_tier_level (&nw);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 6);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+
+    /* SPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_SPS);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    put_h265_profile_tier_level (&nw);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, width);
+    nal_writer_put_ue (&nw, height);
+    nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* log2_max_pic_order_cnt_lsb_minus4 */
+    nal_writer_put_ue (&nw, 4);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 3);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 3);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    /* one short term reference picture set, with the previous picture */
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_bits_uint8 (&nw, 0, 5);
+    append_nal (chunk, &nw);
+
+    /* PPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_PPS);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 7);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    put_se (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    nal_writer_put_bits_uint16 (&nw, 0, 10);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+  }
+
+  for (i = 0; i < n_slices; i++) {
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, idr ? GST_H265_NAL_SLICE_IDR_W_RADL :
+        GST_H265_NAL_SLICE_TRAIL_R);
+    /* first_slice_segment_in_pic_flag */
+    nal_writer_put_bits_uint8 (&nw, i == 0, 1);
+    if (idr)
+      nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, 0);
+    if (i > 0)
+      nal_writer_put_bits_uint32 (&nw, i * n_ctbs / n_slices,
+          g_bit_storage (n_ctbs - 1));
+    nal_writer_put_ue (&nw, idr ? GST_H265_I_SLICE : GST_H265_P_SLICE);
+    if (!idr) {
+      /* slice_pic_order_cnt_lsb */
+      nal_writer_put_bits_uint8 (&nw, frame % GOP_SIZE, 8);
+      /* short_term_ref_pic_set_sps_flag,
+       * num_ref_idx_active_override_flag */
+      nal_writer_put_bits_uint8 (&nw, 2, 2);
+      /* five_minus_max_num_merge_cand */
+      nal_writer_put_ue (&nw, 0);
+    }
+    /* slice_qp_delta */
+    put_se (&nw, 0);
+    /* byte_alignment () */
+    nal_writer_do_rbsp_trailing_bits (&nw);
+    put_slice_data (&nw, rand, idr);
+    append_nal (chunk, &nw);
+  }
+}
+
+typedef void (*WriteFrameFunc) (GByteArray * chunk, guint frame,
+    GRand * rand);
+
+static GPtrArray *
+generate_stream (WriteFrameFunc write_frame, guint n_frames)
+{
+  GPtrArray *frames = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_buffer_unref);
+  GRand *rand = g_rand_new_with_seed (0x01);
+  guint i;
+
+  for (i = 0; i < n_frames; i++) {
+    GByteArray *chunk = g_byte_array_new ();
+    GstBuffer *buf;
+    gsize size;
+
+    write_frame (chunk, i, rand);
+    size = chunk->len;
+    buf = gst_buffer_new_wrapped (g_byte_array_free (chunk, FALSE), size);
+    GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = i * FRAME_DURATION;
+    GST_BUFFER_DURATION (buf) = FRAME_DURATION;
+    g_ptr_array_add (frames, buf);
+  }
+
+  g_rand_free (rand);
+
+  return frames;
+}
+
+static gdouble
+run_once (const gchar * element, const gchar * caps, GPtrArray * frames,
+    guint depth, guint delay)
+{
+  GstHarness *h;
+  gchar *launch;
+  gint64 start, end;
+  guint i;
+
+  launch = g_strdup_printf ("%s pipeline-depth=%u submit-delay=%u", element,
+      depth, delay);
+  h = gst_harness_new_parse (launch);
+  g_free (launch);
+  gst_harness_set_drop_buffers (h, TRUE);
+  gst_harness_set_src_caps_str (h, caps);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < frames->len; i++) {
+    if (gst_harness_push (h,
+            gst_buffer_ref (g_ptr_array_index (frames, i))) != GST_FLOW_OK)
+      break;
+  }
+  gst_harness_push_event (h, gst_event_new_eos ());
+  end = g_get_monotonic_time ();
+
+  if (gst_harness_buffers_received (h) != frames->len) {
+    g_printerr ("%s: %u frames out of %u decoded\n", element,
+        gst_harness_buffers_received (h), frames->len);
+  }
+
+  gst_harness_teardown (h);
+
+  return (end - start) / (gdouble) G_USEC_PER_SEC;
+}
+
+static void
+run (const gchar * codec, const gchar * element, const gchar * caps,
+    WriteFrameFunc write_frame, guint n_frames, guint delay, gchar ** depths,
+    gint iterations)
+{
+  GPtrArray *frames = generate_stream (write_frame, n_frames);
+  gchar **depth;
+
+  for (depth = depths; *depth; depth++) {
+    guint d = atoi (*depth);
+    gdouble best = G_MAXDOUBLE;
+    gint i;
+
+    for (i = 0; i < iterations; i++)
+      best = MIN (best, run_once (element, caps, frames, d, delay));
+
+    g_print ("%s, %u, %u, %u, %.6f, %.1f\n", codec, d, delay, n_frames, best,
+        n_frames / best);
+  }
+
+  g_ptr_array_unref (frames);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint iterations = DEFAULT_ITERATIONS;
+  gint n_frames = DEFAULT_FRAMES;
+  gint delay = DEFAULT_DELAY;
+  gint w = DEFAULT_WIDTH, h = DEFAULT_HEIGHT, s = DEFAULT_SLICES;
+  gchar *depths_str = NULL;
+  gchar **depths;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GOptionEntry options[] = {
+    {"iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of runs per pipeline depth", NULL},
+    {"frames", 'n', 0, G_OPTION_ARG_INT, &n_frames,
+        "Number of frames per stream", NULL},
+    {"width", 0, 0, G_OPTION_ARG_INT, &w,
+        "Width of the streams, multiple of 16", NULL},
+    {"height", 0, 0, G_OPTION_ARG_INT, &h,
+        "Height of the streams, multiple of 16", NULL},
+    {"slices", 's', 0, G_OPTION_ARG_INT, &s,
+        "Number of slices per frame", NULL},
+    {"delay", 'd', 0, G_OPTION_ARG_INT, &delay,
+        "Time spent submitting each picture in microseconds", NULL},
+    {"depths", 'p', 0, G_OPTION_ARG_STRING, &depths_str,
+        "Comma separated pipeline depths (default: " DEFAULT_DEPTHS ")",
+        NULL},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- H.264/H.265 decoder pipelining benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (iterations <= 0 || n_frames <= 0 || delay < 0 || w < 64 || h < 64 ||
+      w % 16 != 0 || h % 16 != 0 || s <= 0 || s > (w / 64) * (h / 64)) {
+    g_printerr ("Invalid iterations, frames, delay, size or slices\n");
+    return 1;
+  }
+  width = w;
+  height = h;
+  n_slices = s;
+
+  depths = g_strsplit (depths_str ? depths_str : DEFAULT_DEPTHS, ",", -1);
+  g_free (depths_str);
+
+  g_print ("# codec, depth, delay (us), frames, seconds, fps\n");
+  run ("h264", "nullh264dec",
+      "video/x-h264, stream-format=byte-stream, alignment=au",
+      write_h264_frame, n_frames, delay, depths, iterations);
+  run ("h265", "nullh265dec",
+      "video/x-h265, stream-format=byte-stream, alignment=au",
+      write_h265_frame, n_frames, delay, depths, iterations);
+
+  g_strfreev (depths);
+
+  return 0;
+}
@@ -0,0 +1,142 @@
+/* GStreamer
+ *
+ * hls-m3u8-update.c: measure the cost of live HLS media playlist refreshes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Refreshes a live playlist with a long DVR window the way hlsdemux does,
+ * with the window sliding by one segment per refresh, and reports how long
+ * parsing the refreshed playlist and looking up the next fragment takes. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#undef GST_CAT_DEFAULT
+#include "m3u8.h"
+#include "m3u8.c"
+
+GST_DEBUG_CATEGORY (hls_debug);
+
+/* 6 hours of 2 second segments */
+#define DEFAULT_WINDOW 10800
+#define DEFAULT_UPDATES 100
+
+static gchar *
+generate_playlist (gint64 first_sequence, guint n_files,
+    gboolean with_sequence)
+{
+  GString *str = g_string_new ("#EXTM3U\n#EXT-X-VERSION:3\n"
+      "#EXT-X-TARGETDURATION:2\n");
+  guint i;
+
+  if (with_sequence)
+    g_string_append_printf (str, "#EXT-X-MEDIA-SEQUENCE:%" G_GINT64_FORMAT
+        "\n", first_sequence);
+
+  for (i = 0; i < n_files; i++) {
+    g_string_append_printf (str, "#EXTINF:2.000,\n"
+        "chunk_%" G_GINT64_FORMAT ".ts\n", first_sequence + i);
+  }
+
+  return g_string_free (str, FALSE);
+}
+
+static gdouble
+run (guint window, guint updates, gboolean with_sequence)
+{
+  GstM3U8 *m3u8;
+  gchar **playlists;
+  gint64 start, end;
+  guint i;
+
+  /* Generate everything upfront so only the updates are measured */
+  playlists = g_new (gchar *, updates + 1);
+  for (i = 0; i <= updates; i++)
+    playlists[i] = generate_playlist (i, window, with_sequence);
+
+  m3u8 = gst_m3u8_new ();
+  gst_m3u8_set_uri (m3u8, "http://localhost/live/index.m3u8", NULL, NULL);
+  if (!gst_m3u8_update (m3u8, playlists[0]))
+    g_error ("Failed to parse the initial playlist");
+
+  start = g_get_monotonic_time ();
+  for (i = 1; i <= updates; i++) {
+    GstM3U8MediaFile *file;
+
+    if (!gst_m3u8_update (m3u8, playlists[i]))
+      g_error ("Failed to update the playlist");
+
+    file = gst_m3u8_get_next_fragment (m3u8, TRUE, NULL, NULL);
+    if (file)
+      gst_m3u8_media_file_unref (file);
+    gst_m3u8_advance_fragment (m3u8, TRUE);
+  }
+  end = g_get_monotonic_time ();
+
+  gst_m3u8_unref (m3u8);
+  g_free (playlists);
+
+  return (end - start) / (gdouble) G_USEC_PER_SEC;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint window = DEFAULT_WINDOW;
+  gint updates = DEFAULT_UPDATES;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gint with_sequence;
+  GOptionEntry options[] = {
+    {"window", 'w', 0, G_OPTION_ARG_INT, &window,
+        "Number of segments in the playlist", NULL},
+    {"updates", 'u', 0, G_OPTION_ARG_INT, &updates,
+        "Number of playlist refreshes", NULL},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- HLS playlist update benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (window <= 0 || updates <= 0) {
+    g_printerr ("Invalid window or number of updates\n");
+    return 1;
+  }
+
+  GST_DEBUG_CATEGORY_INIT (hls_debug, "hlsdemux", 0, "hlsdemux");
+
+  g_print ("# media-sequence, segments, updates, seconds, ms/update\n");
+  for (with_sequence = 1; with_sequence >= 0; with_sequence--) {
+    gdouble seconds = run (window, updates, with_sequence);
+
+    g_print ("%s, %d, %d, %.6f, %.3f\n", with_sequence ? "yes" : "no", window,
+        updates, seconds, seconds * 1000 / updates);
+  }
+
+  return 0;
+}
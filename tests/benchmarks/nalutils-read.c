@@ -0,0 +1,256 @@
+/* GStreamer
+ *
+ * nalutils-read.c: measure H.264/H.265 start code scanning and NAL reading
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Splits Annex-B byte streams into NAL units with the start code scanner the
+ * codec parsers use, then reads every NAL unit with a NalReader, as a mix of
+ * exp-Golomb codes and fixed size fields like in slice headers and SEI, and
+ * reports the throughput of both.
+ *
+ * Captures are given on the command line, e.g. extracted with
+ *   gst-launch-1.0 filesrc location=in.mp4 ! qtdemux ! h264parse !
+ *       video/x-h264,stream-format=byte-stream ! filesink location=in.h264
+ * Without any, a stream of random NAL units is generated, with emulation
+ * prevention bytes inserted. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/codecparsers/nalutils.h>
+
+#define DEFAULT_STREAM_SIZE (64 * 1024 * 1024)
+#define DEFAULT_ITERATIONS 5
+
+/* Random NAL units, with more zero bytes than compressed data has so that
+ * there are emulation prevention bytes to deal with */
+static guint8 *
+generate_stream (gsize size, GRand * rand, gsize * out_size)
+{
+  GByteArray *stream = g_byte_array_sized_new (size + 1024);
+  static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+
+  while (stream->len < size) {
+    guint nal_size = g_rand_int_range (rand, 16, 64 * 1024);
+    guint zeros = 0, i;
+
+    g_byte_array_append (stream, start_code, sizeof (start_code));
+    for (i = 0; i < nal_size; i++) {
+      guint8 byte;
+
+      if (g_rand_int_range (rand, 0, 16) == 0)
+        byte = 0;
+      else
+        byte = g_rand_int_range (rand, 1, 256);
+
+      if (zeros >= 2 && byte <= 0x03) {
+        guint8 epb = 0x03;
+
+        g_byte_array_append (stream, &epb, 1);
+        zeros = 0;
+      }
+      g_byte_array_append (stream, &byte, 1);
+      zeros = byte == 0 ? zeros + 1 : 0;
+    }
+    /* a NAL unit can't end with a zero byte */
+    if (zeros > 0) {
+      guint8 trailing = 0x80;
+
+      g_byte_array_append (stream, &trailing, 1);
+    }
+  }
+
+  *out_size = stream->len;
+  return g_byte_array_free (stream, FALSE);
+}
+
+/* Returns the number of NAL units found */
+static guint
+scan_stream (const guint8 * data, gsize size, GArray * nals)
+{
+  gsize offset = 0;
+  gint off;
+
+  g_array_set_size (nals, 0);
+
+  off = scan_for_start_codes (data, size);
+  while (off >= 0) {
+    gsize start = offset + off + 3;
+    gsize end;
+
+    off = scan_for_start_codes (data + start, size - start);
+    if (off < 0) {
+      end = size;
+    } else {
+      end = start + off;
+      /* the zero byte of 4 bytes start codes */
+      while (end > start && data[end - 1] == 0x00)
+        end--;
+    }
+
+    g_array_append_val (nals, start);
+    g_array_append_val (nals, end);
+    offset = start;
+  }
+
+  return nals->len / 2;
+}
+
+static guint32
+read_nal (const guint8 * data, gsize size)
+{
+  NalReader nr;
+  guint32 sum = 0, val;
+  guint i = 0;
+
+  nal_reader_init (&nr, data, size);
+  while (TRUE) {
+    gboolean ok;
+
+    switch (i++ % 4) {
+      case 0:
+        ok = nal_reader_get_ue (&nr, &val);
+        break;
+      case 1:
+        ok = nal_reader_get_bits_uint32 (&nr, &val, 1);
+        break;
+      case 2:
+        ok = nal_reader_get_bits_uint32 (&nr, &val, 8);
+        break;
+      default:
+        ok = nal_reader_get_bits_uint32 (&nr, &val, 32);
+        break;
+    }
+    if (!ok)
+      break;
+    sum += val;
+  }
+
+  return sum + nal_reader_get_epb_count (&nr);
+}
+
+static void
+run (const gchar * name, const guint8 * data, gsize size, gint iterations)
+{
+  GArray *nals = g_array_new (FALSE, FALSE, sizeof (gsize));
+  gdouble best_scan = G_MAXDOUBLE, best_read = G_MAXDOUBLE;
+  volatile guint32 sum = 0;
+  guint n_nals = 0;
+  gint i;
+
+  for (i = 0; i < iterations; i++) {
+    gint64 start, end;
+    guint j;
+
+    start = g_get_monotonic_time ();
+    n_nals = scan_stream (data, size, nals);
+    end = g_get_monotonic_time ();
+    best_scan = MIN (best_scan, (end - start) / (gdouble) G_USEC_PER_SEC);
+
+    start = g_get_monotonic_time ();
+    for (j = 0; j < n_nals; j++) {
+      gsize nal_start = g_array_index (nals, gsize, 2 * j);
+      gsize nal_end = g_array_index (nals, gsize, 2 * j + 1);
+
+      sum += read_nal (data + nal_start, nal_end - nal_start);
+    }
+    end = g_get_monotonic_time ();
+    best_read = MIN (best_read, (end - start) / (gdouble) G_USEC_PER_SEC);
+  }
+
+  g_print ("%s, scan, %" G_GSIZE_FORMAT ", %u, %.6f, %.2f, %.0f\n", name,
+      size, n_nals, best_scan, size / best_scan / (1024 * 1024),
+      n_nals / best_scan);
+  g_print ("%s, read, %" G_GSIZE_FORMAT ", %u, %.6f, %.2f, %.0f\n", name,
+      size, n_nals, best_read, size / best_read / (1024 * 1024),
+      n_nals / best_read);
+
+  g_array_unref (nals);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint iterations = DEFAULT_ITERATIONS;
+  gint64 stream_size = DEFAULT_STREAM_SIZE;
+  gchar **files = NULL;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GOptionEntry options[] = {
+    {"iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of runs per input", NULL},
+    {"size", 's', 0, G_OPTION_ARG_INT64, &stream_size,
+        "Size of the generated stream in bytes, without captures", NULL},
+    {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files, NULL,
+        "[CAPTURE.h264|CAPTURE.h265...]"},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- NAL unit scanning and reading benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (iterations <= 0 || stream_size <= 0) {
+    g_printerr ("Invalid iterations or size\n");
+    return 1;
+  }
+
+  g_print ("# input, test, bytes, NALs, seconds, MB/s, NALs/s\n");
+
+  if (files == NULL) {
+    GRand *rand = g_rand_new_with_seed (0x01);
+    gsize size;
+    guint8 *data = generate_stream (stream_size, rand, &size);
+
+    run ("generated", data, size, iterations);
+
+    g_free (data);
+    g_rand_free (rand);
+  } else {
+    gchar **file;
+
+    for (file = files; *file; file++) {
+      gchar *data, *name;
+      gsize size;
+
+      if (!g_file_get_contents (*file, &data, &size, &err)) {
+        g_printerr ("Could not read %s: %s\n", *file, err->message);
+        g_clear_error (&err);
+        g_strfreev (files);
+        return 1;
+      }
+
+      name = g_path_get_basename (*file);
+      run (name, (const guint8 *) data, size, iterations);
+      g_free (name);
+      g_free (data);
+    }
+    g_strfreev (files);
+  }
+
+  return 0;
+}
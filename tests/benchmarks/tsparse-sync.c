@@ -0,0 +1,167 @@
+/* GStreamer
+ *
+ * tsparse-sync.c: measure MPEG-TS packet size discovery and resync speed
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Pushes clean, bit-flipped and fully random transport streams through
+ * tsparse and reports the throughput for each of them. The clean input
+ * measures the regular packetizing path, the bit-flipped one has sync bytes
+ * randomly corrupted so tsparse keeps losing sync, and the random one never
+ * finds a packet size at all. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+#define PACKET_SIZE 188
+/* 7 packets, as commonly carried in a single UDP datagram */
+#define CHUNK_SIZE (7 * PACKET_SIZE)
+#define DEFAULT_STREAM_SIZE (32 * 1024 * 1024)
+#define DEFAULT_ITERATIONS 5
+
+typedef enum
+{
+  INPUT_CLEAN,
+  INPUT_BIT_FLIPPED,
+  INPUT_RANDOM
+} InputType;
+
+static const gchar *input_names[] = { "clean", "bit-flipped", "random" };
+
+static guint8 *
+generate_stream (InputType type, gsize size, GRand * rand)
+{
+  guint8 *data = g_malloc (size);
+  gsize i;
+
+  if (type == INPUT_RANDOM) {
+    for (i = 0; i < size; i++)
+      data[i] = g_rand_int_range (rand, 0, 256);
+    return data;
+  }
+
+  /* Null packets with a random payload, continuity counter incrementing */
+  for (i = 0; i + PACKET_SIZE <= size; i += PACKET_SIZE) {
+    guint j;
+
+    data[i] = 0x47;
+    data[i + 1] = 0x1f;
+    data[i + 2] = 0xff;
+    data[i + 3] = 0x10 | ((i / PACKET_SIZE) & 0xf);
+    for (j = 4; j < PACKET_SIZE; j++)
+      data[i + j] = g_rand_int_range (rand, 0, 256);
+
+    /* Corrupt the sync byte of roughly one packet in 16 */
+    if (type == INPUT_BIT_FLIPPED && g_rand_int_range (rand, 0, 16) == 0)
+      data[i] ^= 1 << g_rand_int_range (rand, 0, 8);
+  }
+  for (; i < size; i++)
+    data[i] = 0xff;
+
+  return data;
+}
+
+static gdouble
+run_once (const guint8 * data, gsize size)
+{
+  GstHarness *h;
+  GstBuffer *input;
+  gint64 start, end;
+  gsize offset;
+
+  h = gst_harness_new ("tsparse");
+  gst_harness_set_drop_buffers (h, TRUE);
+  gst_harness_set_src_caps_str (h, "video/mpegts,systemstream=true");
+
+  input = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+      (gpointer) data, size, 0, size, NULL, NULL);
+
+  start = g_get_monotonic_time ();
+  for (offset = 0; offset < size; offset += CHUNK_SIZE) {
+    GstBuffer *chunk = gst_buffer_copy_region (input, GST_BUFFER_COPY_MEMORY,
+        offset, MIN (CHUNK_SIZE, size - offset));
+
+    if (gst_harness_push (h, chunk) != GST_FLOW_OK)
+      break;
+  }
+  gst_harness_push_event (h, gst_event_new_eos ());
+  end = g_get_monotonic_time ();
+
+  gst_buffer_unref (input);
+  gst_harness_teardown (h);
+
+  return (end - start) / (gdouble) G_USEC_PER_SEC;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint iterations = DEFAULT_ITERATIONS;
+  gint64 stream_size = DEFAULT_STREAM_SIZE;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GRand *rand;
+  InputType type;
+  GOptionEntry options[] = {
+    {"iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+        "Number of runs per input type", NULL},
+    {"size", 's', 0, G_OPTION_ARG_INT64, &stream_size,
+        "Size of the generated streams in bytes", NULL},
+    {NULL}
+  };
+
+  ctx = g_option_context_new ("- tsparse sync benchmark");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Error initializing: %s\n", err->message);
+    g_option_context_free (ctx);
+    g_clear_error (&err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (iterations <= 0 || stream_size < 4 * PACKET_SIZE) {
+    g_printerr ("Invalid iterations or size\n");
+    return 1;
+  }
+
+  rand = g_rand_new_with_seed (0x47);
+
+  g_print ("# input, bytes, seconds, MB/s\n");
+  for (type = INPUT_CLEAN; type <= INPUT_RANDOM; type++) {
+    guint8 *data = generate_stream (type, stream_size, rand);
+    gdouble best = G_MAXDOUBLE;
+    gint i;
+
+    for (i = 0; i < iterations; i++)
+      best = MIN (best, run_once (data, stream_size));
+
+    g_print ("%s, %" G_GINT64_FORMAT ", %.6f, %.2f\n", input_names[type],
+        stream_size, best, stream_size / best / (1024 * 1024));
+
+    g_free (data);
+  }
+
+  g_rand_free (rand);
+
+  return 0;
+}
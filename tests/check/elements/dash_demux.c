@@ -1520,6 +1520,268 @@ GST_START_TEST (testContentProtection)
 
 GST_END_TEST;
 
+#define PREFETCH_TEST_N_FRAGMENTS 4
+
+/* offsets of the fragments of the prefetch tests in audio.webm */
+static const guint64 prefetch_test_offsets[PREFETCH_TEST_N_FRAGMENTS] =
+    { 0, 1000, 3000, 4000 };
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  GstAdaptiveDemuxTestEngine *engine;
+
+  /* demux properties */
+  guint prefetch_depth;
+  guint64 prefetch_cache_size;  /* 0 for the default */
+
+  /* the first fragment is held back until the ones up to this one were
+   * requested */
+  guint n_prefetched;
+  /* then seek back to the start while it is still held back */
+  gboolean seek;
+  gboolean flushing;
+
+  /* how many times each fragment was requested */
+  guint requests[PREFETCH_TEST_N_FRAGMENTS];
+} PrefetchTestData;
+
+static PrefetchTestData prefetch_test;
+
+static gboolean
+testPrefetchDoSeek (gpointer user_data)
+{
+  GstElement *pipeline = prefetch_test.engine->pipeline;
+
+  fail_unless (gst_element_send_event (pipeline,
+          gst_event_new_seek (1.0, GST_FORMAT_TIME,
+              GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
+              GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, 0)));
+
+  return G_SOURCE_REMOVE;
+}
+
+/* call with prefetch_test.lock */
+static void
+testPrefetchHoldFirstFragment (void)
+{
+  gint64 end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+  guint next = prefetch_test.n_prefetched + 1;
+  guint i;
+
+  /* The next fragments are requested while the first one downloads... */
+  for (i = 1; i <= prefetch_test.n_prefetched; i++) {
+    while (prefetch_test.requests[i] == 0) {
+      fail_unless (g_cond_wait_until (&prefetch_test.cond, &prefetch_test.lock,
+              end_time), "fragment %u was not prefetched", i);
+    }
+  }
+
+  /* ...but not beyond the prefetch depth or the cache size */
+  if (next < PREFETCH_TEST_N_FRAGMENTS) {
+    end_time = g_get_monotonic_time () + 100 * G_TIME_SPAN_MILLISECOND;
+    while (prefetch_test.requests[next] == 0 &&
+        g_cond_wait_until (&prefetch_test.cond, &prefetch_test.lock,
+            end_time));
+    fail_unless_equals_int (prefetch_test.requests[next], 0);
+  }
+
+  if (prefetch_test.seek) {
+    g_idle_add (testPrefetchDoSeek, NULL);
+
+    end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+    while (!prefetch_test.flushing) {
+      fail_unless (g_cond_wait_until (&prefetch_test.cond, &prefetch_test.lock,
+              end_time), "no flush after seeking");
+    }
+  }
+}
+
+static GstFlowReturn
+testPrefetchSrcCreate (GstTestHTTPSrc * src, guint64 offset, guint length,
+    GstBuffer ** retbuf, gpointer context, gpointer user_data)
+{
+  const GstDashDemuxTestInputData *input =
+      (const GstDashDemuxTestInputData *) context;
+  guint i;
+
+  /* Each fragment is downloaded in one buffer, the first one of a request
+   * starts at the fragment's offset */
+  for (i = 0; i < PREFETCH_TEST_N_FRAGMENTS &&
+      g_strcmp0 (input->uri, "http://unit.test/audio.webm") == 0; i++) {
+    if (offset != prefetch_test_offsets[i])
+      continue;
+
+    g_mutex_lock (&prefetch_test.lock);
+    prefetch_test.requests[i]++;
+    g_cond_broadcast (&prefetch_test.cond);
+    if (i == 0 && prefetch_test.requests[i] == 1)
+      testPrefetchHoldFirstFragment ();
+    g_mutex_unlock (&prefetch_test.lock);
+    break;
+  }
+
+  return gst_dashdemux_http_src_create (src, offset, length, retbuf, context,
+      user_data);
+}
+
+static void
+testPrefetchPreTest (GstAdaptiveDemuxTestEngine * engine, gpointer user_data)
+{
+  prefetch_test.engine = engine;
+  g_object_set (engine->demux, "prefetch-depth", prefetch_test.prefetch_depth,
+      NULL);
+  if (prefetch_test.prefetch_cache_size)
+    g_object_set (engine->demux, "prefetch-cache-size",
+        prefetch_test.prefetch_cache_size, NULL);
+}
+
+static void
+testPrefetchAppSinkEvent (GstAdaptiveDemuxTestEngine * engine,
+    GstAdaptiveDemuxTestOutputStream * stream, GstEvent * event,
+    gpointer user_data)
+{
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_START) {
+    g_mutex_lock (&prefetch_test.lock);
+    prefetch_test.flushing = TRUE;
+    g_cond_broadcast (&prefetch_test.cond);
+    g_mutex_unlock (&prefetch_test.lock);
+  }
+}
+
+static void
+run_prefetch_test (guint prefetch_depth, guint64 prefetch_cache_size,
+    guint n_prefetched, gboolean seek)
+{
+  const gchar *mpd =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+      "<MPD xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\""
+      "     xmlns=\"urn:mpeg:DASH:schema:MPD:2011\""
+      "     xsi:schemaLocation=\"urn:mpeg:DASH:schema:MPD:2011 DASH-MPD.xsd\""
+      "     profiles=\"urn:mpeg:dash:profile:isoff-live:2011\""
+      "     type=\"static\""
+      "     minBufferTime=\"PT1.500S\""
+      "     mediaPresentationDuration=\"PT4S\">"
+      "  <Period>"
+      "    <AdaptationSet mimeType=\"audio/webm\""
+      "                   subsegmentAlignment=\"true\">"
+      "      <Representation id=\"171\""
+      "                      codecs=\"vorbis\""
+      "                      audioSamplingRate=\"44100\""
+      "                      startWithSAP=\"1\""
+      "                      bandwidth=\"129553\">"
+      "        <AudioChannelConfiguration"
+      "           schemeIdUri=\"urn:mpeg:dash:23003:3:audio_channel_configuration:2011\""
+      "           value=\"2\" />"
+      "        <BaseURL>audio.webm</BaseURL>"
+      "        <SegmentList duration=\"1\">"
+      "          <SegmentURL mediaRange=\"0-999\"></SegmentURL>"
+      "          <SegmentURL mediaRange=\"1000-2999\"></SegmentURL>"
+      "          <SegmentURL mediaRange=\"3000-3999\"></SegmentURL>"
+      "          <SegmentURL mediaRange=\"4000-4999\"></SegmentURL>"
+      "        </SegmentList>"
+      "      </Representation></AdaptationSet></Period></MPD>";
+
+  GstDashDemuxTestInputData inputTestData[] = {
+    {"http://unit.test/test.mpd", (guint8 *) mpd, 0},
+    {"http://unit.test/audio.webm", NULL, 5000},
+    {NULL, NULL, 0},
+  };
+  GstAdaptiveDemuxTestExpectedOutput outputTestData[] = {
+    {"audio_00", 5000, NULL},
+  };
+  GstTestHTTPSrcCallbacks http_src_callbacks = { 0 };
+  GstTestHTTPSrcTestData http_src_test_data = { 0 };
+  GstAdaptiveDemuxTestCallbacks test_callbacks = { 0 };
+  GstDashDemuxTestCase *testData;
+
+  memset (&prefetch_test, 0, sizeof (prefetch_test));
+  g_mutex_init (&prefetch_test.lock);
+  g_cond_init (&prefetch_test.cond);
+  prefetch_test.prefetch_depth = prefetch_depth;
+  prefetch_test.prefetch_cache_size = prefetch_cache_size;
+  prefetch_test.n_prefetched = n_prefetched;
+  prefetch_test.seek = seek;
+
+  http_src_callbacks.src_start = gst_dashdemux_http_src_start;
+  http_src_callbacks.src_create = testPrefetchSrcCreate;
+  http_src_test_data.input = inputTestData;
+  gst_test_http_src_install_callbacks (&http_src_callbacks,
+      &http_src_test_data);
+
+  test_callbacks.pre_test = testPrefetchPreTest;
+  test_callbacks.appsink_received_data =
+      gst_adaptive_demux_test_check_received_data;
+  test_callbacks.appsink_eos =
+      gst_adaptive_demux_test_check_size_of_received_data;
+  test_callbacks.appsink_event = testPrefetchAppSinkEvent;
+
+  testData = gst_dash_demux_test_case_new ();
+  COPY_OUTPUT_TEST_DATA (outputTestData, testData);
+
+  gst_adaptive_demux_test_run (DEMUX_ELEMENT_NAME, "http://unit.test/test.mpd",
+      &test_callbacks, testData);
+
+  g_object_unref (testData);
+  if (http_src_test_data.data)
+    gst_structure_free (http_src_test_data.data);
+
+  g_mutex_clear (&prefetch_test.lock);
+  g_cond_clear (&prefetch_test.cond);
+}
+
+/*
+ * Test downloading fragments ahead of time.
+ * The next fragments up to the prefetch depth must be requested while the
+ * first one is downloading. The fragments must be output in order and each
+ * be requested only once, whether it was prefetched or not.
+ */
+GST_START_TEST (testPrefetch)
+{
+  guint i;
+
+  run_prefetch_test (2, 0, 2, FALSE);
+
+  for (i = 0; i < PREFETCH_TEST_N_FRAGMENTS; i++)
+    fail_unless_equals_int (prefetch_test.requests[i], 1);
+}
+
+GST_END_TEST;
+
+/*
+ * Test that the prefetched fragments don't exceed the cache size.
+ * Fragment 1 (2000 bytes) fits in the cache, fragment 2 (1000 bytes) only
+ * once fragment 1 was taken out of it.
+ */
+GST_START_TEST (testPrefetchCacheSize)
+{
+  guint i;
+
+  run_prefetch_test (2, 2500, 1, FALSE);
+
+  for (i = 0; i < PREFETCH_TEST_N_FRAGMENTS; i++)
+    fail_unless_equals_int (prefetch_test.requests[i], 1);
+}
+
+GST_END_TEST;
+
+/*
+ * Test that the fragments prefetched before a seek are dropped, and
+ * requested again after seeking back to the start.
+ */
+GST_START_TEST (testPrefetchSeek)
+{
+  run_prefetch_test (2, 0, 2, TRUE);
+
+  fail_unless_equals_int (prefetch_test.requests[0], 2);
+  fail_unless_equals_int (prefetch_test.requests[1], 2);
+  fail_unless_equals_int (prefetch_test.requests[2], 2);
+  fail_unless_equals_int (prefetch_test.requests[3], 1);
+}
+
+GST_END_TEST;
+
 static Suite *
 dash_demux_suite (void)
 {
@@ -1545,6 +1807,9 @@ dash_demux_suite (void)
   tcase_add_test (tc_basicTest, testMediaDownloadErrorMiddleFragment);
   tcase_add_test (tc_basicTest, testQuery);
   tcase_add_test (tc_basicTest, testContentProtection);
+  tcase_add_test (tc_basicTest, testPrefetch);
+  tcase_add_test (tc_basicTest, testPrefetchCacheSize);
+  tcase_add_test (tc_basicTest, testPrefetchSeek);
 
   tcase_add_unchecked_fixture (tc_basicTest, gst_adaptive_demux_test_setup,
       gst_adaptive_demux_test_teardown);
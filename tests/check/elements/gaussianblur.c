@@ -0,0 +1,331 @@
+/* GStreamer
+ *
+ * unit test for gaussianblur
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+/* More than a tile wide and high, and larger than the kernels of the tested
+ * sigmas */
+#define WIDTH 300
+#define HEIGHT 70
+#define PSTRIDE 4
+#define CAPS "video/x-raw,format=AYUV,width=300,height=70,framerate=30/1"
+
+static GstBuffer *
+create_frame (void)
+{
+  GstBuffer *buffer;
+  GstMapInfo info;
+  GRand *rand;
+  gsize i;
+
+  buffer = gst_buffer_new_allocate (NULL, WIDTH * HEIGHT * PSTRIDE, NULL);
+  gst_buffer_map (buffer, &info, GST_MAP_WRITE);
+  rand = g_rand_new_with_seed (42);
+  for (i = 0; i < info.size; i++)
+    info.data[i] = g_rand_int_range (rand, 0, 256);
+  g_rand_free (rand);
+  gst_buffer_unmap (buffer, &info);
+
+  return buffer;
+}
+
+/* The floating point blur the element did before it used fixed point: the
+ * same kernel, renormalized to the part inside the frame at the edges */
+static float *
+make_kernel (float sigma, gint * windowsize)
+{
+  const float fe = -0.5 / (sigma * sigma);
+  const float dx = 1.0 / (sigma * sqrt (2 * G_PI));
+  gint i, center;
+  float *kernel;
+  float sum;
+
+  center = ceil (2.5 * fabs (sigma));
+  *windowsize = 1 + 2 * center;
+  kernel = g_new (float, *windowsize);
+
+  sum = kernel[center] = dx;
+  for (i = 1; i <= center; i++) {
+    float fx = dx * pow (G_E, fe * i * i);
+
+    kernel[center + i] = kernel[center - i] = fx;
+    sum += 2 * fx;
+  }
+  if (sigma < 0) {
+    sum = -sum;
+    kernel[center] += 2.0 * sum;
+  }
+  for (i = 0; i < *windowsize; i++)
+    kernel[i] /= sum;
+
+  return kernel;
+}
+
+static GstBuffer *
+float_blur (GstBuffer * in, float sigma)
+{
+  GstBuffer *out;
+  GstMapInfo in_info, out_info;
+  float *kernel, *tmp;
+  gint windowsize, center, x, y, c, k;
+
+  kernel = make_kernel (sigma, &windowsize);
+  center = windowsize / 2;
+  tmp = g_new (float, WIDTH * HEIGHT * PSTRIDE);
+
+  out = gst_buffer_new_allocate (NULL, WIDTH * HEIGHT * PSTRIDE, NULL);
+  gst_buffer_map (in, &in_info, GST_MAP_READ);
+  gst_buffer_map (out, &out_info, GST_MAP_WRITE);
+
+  for (y = 0; y < HEIGHT; y++) {
+    for (x = 0; x < WIDTH; x++) {
+      gint kmin = MAX (0, center - x);
+      gint kmax = MIN (windowsize, WIDTH + center - x);
+
+      for (c = 0; c < PSTRIDE; c++) {
+        float dot = 0.0, sum = 0.0;
+
+        for (k = kmin; k < kmax; k++) {
+          dot += in_info.data[(y * WIDTH + x - center + k) * PSTRIDE + c] *
+              kernel[k];
+          sum += kernel[k];
+        }
+        tmp[(y * WIDTH + x) * PSTRIDE + c] = dot / sum;
+      }
+    }
+  }
+
+  for (y = 0; y < HEIGHT; y++) {
+    gint kmin = MAX (0, center - y);
+    gint kmax = MIN (windowsize, HEIGHT + center - y);
+
+    for (x = 0; x < WIDTH * PSTRIDE; x++) {
+      float dot = 0.0, sum = 0.0;
+
+      for (k = kmin; k < kmax; k++) {
+        dot += tmp[(y - center + k) * WIDTH * PSTRIDE + x] * kernel[k];
+        sum += kernel[k];
+      }
+      out_info.data[y * WIDTH * PSTRIDE + x] =
+          (guint8) CLAMP (dot / sum + 0.5, 0, 255);
+    }
+  }
+
+  gst_buffer_unmap (out, &out_info);
+  gst_buffer_unmap (in, &in_info);
+  g_free (tmp);
+  g_free (kernel);
+
+  return out;
+}
+
+static GstHarness *
+create_harness (const gchar * mode)
+{
+  GstHarness *h;
+
+  h = gst_harness_new ("gaussianblur");
+  gst_harness_set_src_caps_str (h, CAPS);
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode", mode);
+
+  return h;
+}
+
+static GstBuffer *
+transform (GstHarness * h, GstBuffer * in)
+{
+  GstBuffer *out;
+
+  out = gst_harness_push_and_pull (h, gst_buffer_ref (in));
+  fail_unless (out != NULL);
+
+  return out;
+}
+
+/* Returns the largest difference between the components of a and b, and
+ * their mean difference in mean_diff */
+static guint
+compare_buffers (GstBuffer * a, GstBuffer * b, gdouble * mean_diff)
+{
+  GstMapInfo a_info, b_info;
+  guint64 total = 0;
+  guint max_diff = 0;
+  gsize i;
+
+  gst_buffer_map (a, &a_info, GST_MAP_READ);
+  gst_buffer_map (b, &b_info, GST_MAP_READ);
+  fail_unless_equals_uint64 (a_info.size, b_info.size);
+  for (i = 0; i < a_info.size; i++) {
+    guint diff = ABS (a_info.data[i] - b_info.data[i]);
+
+    max_diff = MAX (max_diff, diff);
+    total += diff;
+  }
+  if (mean_diff)
+    *mean_diff = (gdouble) total / a_info.size;
+  gst_buffer_unmap (b, &b_info);
+  gst_buffer_unmap (a, &a_info);
+
+  return max_diff;
+}
+
+GST_START_TEST (test_fixed_point)
+{
+  /* sharpening too, where the intermediate values leave 0..255 */
+  static const gdouble sigmas[] = { 1.2, 3.0, 8.0, -1.2, -3.0, -8.0 };
+  GstHarness *h;
+  GstBuffer *in;
+  guint i;
+
+  in = create_frame ();
+  h = create_harness ("exact");
+
+  for (i = 0; i < G_N_ELEMENTS (sigmas); i++) {
+    GstBuffer *out, *expected;
+
+    g_object_set (h->element, "sigma", sigmas[i], NULL);
+    out = transform (h, in);
+    expected = float_blur (in, sigmas[i]);
+
+    /* only rounding differences */
+    fail_unless (compare_buffers (out, expected, NULL) <= 1,
+        "sigma %f differs by more than 1 from the floating point blur",
+        sigmas[i]);
+
+    gst_buffer_unref (expected);
+    gst_buffer_unref (out);
+  }
+
+  gst_harness_teardown (h);
+  gst_buffer_unref (in);
+}
+
+GST_END_TEST;
+
+static void
+check_threads (const gchar * mode, gdouble sigma)
+{
+  static const guint n_threads[] = { 2, 3, 7, 0 };
+  GstHarness *h;
+  GstBuffer *in, *reference;
+  guint i;
+
+  in = create_frame ();
+  h = create_harness (mode);
+  g_object_set (h->element, "sigma", sigma, "n-threads", 1, NULL);
+  reference = transform (h, in);
+
+  for (i = 0; i < G_N_ELEMENTS (n_threads); i++) {
+    GstBuffer *out;
+
+    g_object_set (h->element, "n-threads", n_threads[i], NULL);
+    out = transform (h, in);
+    fail_unless_equals_int (compare_buffers (out, reference, NULL), 0);
+    gst_buffer_unref (out);
+  }
+
+  gst_harness_teardown (h);
+  gst_buffer_unref (reference);
+  gst_buffer_unref (in);
+}
+
+GST_START_TEST (test_threads)
+{
+  check_threads ("exact", 3.0);
+  check_threads ("exact", -3.0);
+  check_threads ("box", 3.0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_box)
+{
+  static const gdouble sigmas[] = { 3.0, 8.0 };
+  GstHarness *h;
+  GstBuffer *in, *out, *expected;
+  GstMapInfo info;
+  gsize j;
+  guint i;
+
+  h = create_harness ("box");
+
+  /* close to the gaussian blur on average */
+  in = create_frame ();
+  for (i = 0; i < G_N_ELEMENTS (sigmas); i++) {
+    gdouble mean_diff;
+
+    g_object_set (h->element, "sigma", sigmas[i], NULL);
+    out = transform (h, in);
+    expected = float_blur (in, sigmas[i]);
+    compare_buffers (out, expected, &mean_diff);
+    fail_unless (mean_diff < 1.0, "sigma %f: mean difference %f", sigmas[i],
+        mean_diff);
+    gst_buffer_unref (expected);
+    gst_buffer_unref (out);
+  }
+
+  /* sharpening isn't approximated */
+  g_object_set (h->element, "sigma", -3.0, NULL);
+  out = transform (h, in);
+  expected = float_blur (in, -3.0);
+  fail_unless (compare_buffers (out, expected, NULL) <= 1);
+  gst_buffer_unref (expected);
+  gst_buffer_unref (out);
+  gst_buffer_unref (in);
+
+  /* the boxes are renormalized at the edges */
+  in = gst_buffer_new_allocate (NULL, WIDTH * HEIGHT * PSTRIDE, NULL);
+  gst_buffer_memset (in, 0, 200, WIDTH * HEIGHT * PSTRIDE);
+  g_object_set (h->element, "sigma", 8.0, NULL);
+  out = transform (h, in);
+  gst_buffer_map (out, &info, GST_MAP_READ);
+  for (j = 0; j < info.size; j++)
+    fail_unless_equals_int (info.data[j], 200);
+  gst_buffer_unmap (out, &info);
+  gst_buffer_unref (out);
+  gst_buffer_unref (in);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+gaussianblur_suite (void)
+{
+  Suite *s = suite_create ("gaussianblur");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (s, tc);
+  tcase_add_test (tc, test_fixed_point);
+  tcase_add_test (tc, test_threads);
+  tcase_add_test (tc, test_box);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gaussianblur);
@@ -0,0 +1,277 @@
+/* GStreamer
+ *
+ * unit test for the geometrictransform elements
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+#define PSTRIDE 4
+#define CAPS "video/x-raw,format=BGRx,width=64,height=48,framerate=30/1"
+
+typedef void (*MapFunc) (gint x, gint y, gdouble * in_x, gdouble * in_y,
+    gpointer user_data);
+
+static GstBuffer *
+create_frame (void)
+{
+  GstBuffer *buffer;
+  GstMapInfo info;
+  GRand *rand;
+  gsize i;
+
+  buffer = gst_buffer_new_allocate (NULL, WIDTH * HEIGHT * PSTRIDE, NULL);
+  gst_buffer_map (buffer, &info, GST_MAP_WRITE);
+  rand = g_rand_new_with_seed (42);
+  for (i = 0; i < info.size; i++)
+    info.data[i] = g_rand_int_range (rand, 0, 256);
+  g_rand_free (rand);
+  gst_buffer_unmap (buffer, &info);
+
+  return buffer;
+}
+
+/* What the elements output before they sampled the input bilinearly: the
+ * pixel each mapped coordinate truncates to, or black */
+static GstBuffer *
+nearest_pixel_map (GstBuffer * in, MapFunc func, gpointer user_data)
+{
+  GstBuffer *out;
+  GstMapInfo in_info, out_info;
+  gint x, y;
+
+  out = gst_buffer_new_allocate (NULL, WIDTH * HEIGHT * PSTRIDE, NULL);
+  gst_buffer_map (in, &in_info, GST_MAP_READ);
+  gst_buffer_map (out, &out_info, GST_MAP_WRITE);
+  memset (out_info.data, 0, out_info.size);
+
+  for (y = 0; y < HEIGHT; y++) {
+    for (x = 0; x < WIDTH; x++) {
+      gdouble in_x, in_y;
+      gint trunc_x, trunc_y;
+
+      func (x, y, &in_x, &in_y, user_data);
+      trunc_x = (gint) in_x;
+      trunc_y = (gint) in_y;
+      if (trunc_x >= 0 && trunc_x < WIDTH && trunc_y >= 0 && trunc_y < HEIGHT)
+        memcpy (out_info.data + (y * WIDTH + x) * PSTRIDE,
+            in_info.data + (trunc_y * WIDTH + trunc_x) * PSTRIDE, PSTRIDE);
+    }
+  }
+
+  gst_buffer_unmap (out, &out_info);
+  gst_buffer_unmap (in, &in_info);
+
+  return out;
+}
+
+/* Same computation as the elements */
+static void
+mirror_left_map (gint x, gint y, gdouble * in_x, gdouble * in_y,
+    gpointer user_data)
+{
+  gdouble hw = WIDTH / 2.0 - 1.0;
+
+  if (x > hw)
+    *in_x = WIDTH - 1.0 - x;
+  else
+    *in_x = x;
+  *in_y = y;
+}
+
+static void
+mirror_bottom_map (gint x, gint y, gdouble * in_x, gdouble * in_y,
+    gpointer user_data)
+{
+  gdouble hh = HEIGHT / 2.0 - 1.0;
+
+  if (y > hh)
+    *in_y = y;
+  else
+    *in_y = HEIGHT - 1.0 - y;
+  *in_x = x;
+}
+
+static void
+rotate_map (gint x, gint y, gdouble * in_x, gdouble * in_y,
+    gpointer user_data)
+{
+  gdouble angle = *(gdouble *) user_data;
+  gdouble cx = 0.5 * WIDTH;
+  gdouble cy = 0.5 * HEIGHT;
+  gdouble xo = x - cx;
+  gdouble yo = y - cy;
+  gdouble ai = atan2 (yo, xo) + angle;
+  gdouble r = sqrt (xo * xo + yo * yo);
+
+  *in_x = r * cos (ai) + cx;
+  *in_y = r * sin (ai) + cy;
+}
+
+static GstBuffer *
+transform (GstHarness * h, GstBuffer * in)
+{
+  GstBuffer *out;
+
+  out = gst_harness_push_and_pull (h, gst_buffer_ref (in));
+  fail_unless (out != NULL);
+
+  return out;
+}
+
+static void
+assert_buffers_equal (GstBuffer * a, GstBuffer * b)
+{
+  GstMapInfo a_info, b_info;
+  gsize i;
+
+  gst_buffer_map (a, &a_info, GST_MAP_READ);
+  gst_buffer_map (b, &b_info, GST_MAP_READ);
+  fail_unless_equals_uint64 (a_info.size, b_info.size);
+  for (i = 0; i < a_info.size; i++) {
+    if (a_info.data[i] != b_info.data[i])
+      fail ("Pixel %" G_GSIZE_FORMAT ", %" G_GSIZE_FORMAT " component %"
+          G_GSIZE_FORMAT " differs: %u != %u", i / PSTRIDE % WIDTH,
+          i / PSTRIDE / WIDTH, i % PSTRIDE, a_info.data[i], b_info.data[i]);
+  }
+  gst_buffer_unmap (b, &b_info);
+  gst_buffer_unmap (a, &a_info);
+}
+
+static void
+check_nearest_pixel_map (GstHarness * h, MapFunc func, gpointer user_data)
+{
+  GstBuffer *in, *out, *expected;
+
+  in = create_frame ();
+  expected = nearest_pixel_map (in, func, user_data);
+  out = transform (h, in);
+
+  assert_buffers_equal (out, expected);
+
+  gst_buffer_unref (out);
+  gst_buffer_unref (expected);
+  gst_buffer_unref (in);
+}
+
+GST_START_TEST (test_mirror_exact)
+{
+  GstHarness *h;
+
+  h = gst_harness_new ("mirror");
+  gst_harness_set_src_caps_str (h, CAPS);
+
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode", "left");
+  check_nearest_pixel_map (h, mirror_left_map, NULL);
+
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode", "bottom");
+  check_nearest_pixel_map (h, mirror_bottom_map, NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_rotate_right_angles)
+{
+  static const gdouble angles[] = { G_PI / 2, G_PI, 3 * G_PI / 2 };
+  GstHarness *h;
+  guint i;
+
+  h = gst_harness_new ("rotate");
+  gst_harness_set_src_caps_str (h, CAPS);
+
+  for (i = 0; i < G_N_ELEMENTS (angles); i++) {
+    gdouble angle = angles[i];
+
+    g_object_set (h->element, "angle", angle, NULL);
+    check_nearest_pixel_map (h, rotate_map, &angle);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+check_threads (const gchar * element, const gchar * off_edge_pixels)
+{
+  static const guint n_threads[] = { 2, 3, 5, 7, 0 };
+  GstHarness *h;
+  GstBuffer *in, *reference;
+  guint i;
+
+  in = create_frame ();
+
+  h = gst_harness_new (element);
+  gst_harness_set_src_caps_str (h, CAPS);
+  gst_util_set_object_arg (G_OBJECT (h->element), "off-edge-pixels",
+      off_edge_pixels);
+
+  g_object_set (h->element, "n-threads", 1, NULL);
+  reference = transform (h, in);
+
+  for (i = 0; i < G_N_ELEMENTS (n_threads); i++) {
+    GstBuffer *out;
+
+    g_object_set (h->element, "n-threads", n_threads[i], NULL);
+    out = transform (h, in);
+    assert_buffers_equal (out, reference);
+    gst_buffer_unref (out);
+  }
+
+  gst_harness_teardown (h);
+  gst_buffer_unref (reference);
+  gst_buffer_unref (in);
+}
+
+GST_START_TEST (test_threads)
+{
+  /* bilinear sampling, with each off edge pixels method */
+  check_threads ("twirl", "ignore");
+  check_threads ("twirl", "clamp");
+  check_threads ("twirl", "wrap");
+  check_threads ("bulge", "ignore");
+}
+
+GST_END_TEST;
+
+static Suite *
+geometrictransform_suite (void)
+{
+  Suite *s = suite_create ("geometrictransform");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (s, tc);
+  tcase_add_test (tc, test_mirror_exact);
+  tcase_add_test (tc, test_rotate_right_angles);
+  tcase_add_test (tc, test_threads);
+
+  return s;
+}
+
+GST_CHECK_MAIN (geometrictransform);
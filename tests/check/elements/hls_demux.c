@@ -726,6 +726,109 @@ GST_START_TEST (testFragmentDownloadError)
 
 GST_END_TEST;
 
+/* Returns the index of the first request of @uri, or -1 */
+static gint
+find_request (const GValue * requests, const gchar * uri, guint * count)
+{
+  gint first = -1;
+  guint i;
+
+  *count = 0;
+  for (i = 0; i < gst_value_array_get_size (requests); ++i) {
+    const GValue *val = gst_value_array_get_value (requests, i);
+
+    if (g_strcmp0 (g_value_get_string (val), uri) == 0) {
+      if (first < 0)
+        first = i;
+      (*count)++;
+    }
+  }
+  return first;
+}
+
+/*
+ * Test a Low-Latency live playlist: the part announced by the preload hint
+ * is downloaded before the playlist lists it, and the playlist is reloaded
+ * with a blocking request for that part.
+ */
+GST_START_TEST (testLowLatencyParts)
+{
+  const guint segment_size = 30 * TS_PACKET_LEN;
+  const gchar *manifest =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:6\n"
+      "#EXT-X-TARGETDURATION:1\n"
+      "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=1.0\n"
+      "#EXT-X-PART-INF:PART-TARGET=0.5\n"
+      "#EXT-X-MEDIA-SEQUENCE:1\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"001.0.ts\",INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"001.1.ts\",INDEPENDENT=YES\n"
+      "#EXTINF:1,Test\n" "001.ts\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"002.0.ts\",INDEPENDENT=YES\n"
+      "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"002.1.ts\"\n";
+  const gchar *reloaded_manifest =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:6\n"
+      "#EXT-X-TARGETDURATION:1\n"
+      "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=1.0\n"
+      "#EXT-X-PART-INF:PART-TARGET=0.5\n"
+      "#EXT-X-MEDIA-SEQUENCE:1\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"001.0.ts\",INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"001.1.ts\",INDEPENDENT=YES\n"
+      "#EXTINF:1,Test\n" "001.ts\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"002.0.ts\",INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"002.1.ts\",INDEPENDENT=YES\n"
+      "#EXTINF:1,Test\n" "002.ts\n" "#EXT-X-ENDLIST\n";
+  GstHlsDemuxTestInputData inputTestData[] = {
+    {"http://unit.test/media.m3u8", (guint8 *) manifest, 0},
+    {"http://unit.test/media.m3u8?_HLS_msn=2&_HLS_part=1",
+        (guint8 *) reloaded_manifest, 0},
+    {"http://unit.test/001.1.ts", NULL, segment_size},
+    {"http://unit.test/002.0.ts", NULL, segment_size},
+    {"http://unit.test/002.1.ts", NULL, segment_size},
+    {NULL, NULL, 0},
+  };
+  GstAdaptiveDemuxTestExpectedOutput outputTestData[] = {
+    {"src_0", 3 * segment_size, NULL},
+    {NULL, 0, NULL}
+  };
+  const GValue *requests;
+  gint reload, hint;
+  guint count;
+  TESTCASE_INIT_BOILERPLATE (segment_size);
+
+  http_src_callbacks.src_start = gst_hlsdemux_test_src_start;
+  http_src_callbacks.src_create = gst_hlsdemux_test_src_create;
+  engine_callbacks.appsink_eos =
+      gst_adaptive_demux_test_check_size_of_received_data;
+
+  gst_test_http_src_install_callbacks (&http_src_callbacks, &hlsTestCase);
+  gst_adaptive_demux_test_run (DEMUX_ELEMENT_NAME,
+      inputTestData[0].uri, &engine_callbacks, engineTestData);
+
+  fail_if (gst_structure_has_field (hlsTestCase.state, "failure-count"));
+  requests = gst_structure_get_value (hlsTestCase.state, "requests");
+  fail_unless (requests != NULL);
+
+  /* Playback starts PART-HOLD-BACK from the live edge */
+  fail_unless (find_request (requests, "http://unit.test/001.1.ts",
+          &count) >= 0);
+  fail_unless (find_request (requests, "http://unit.test/001.0.ts",
+          &count) < 0);
+
+  /* The hinted part is downloaded once, before the playlist lists it */
+  reload = find_request (requests, inputTestData[1].uri, &count);
+  fail_unless (reload >= 0);
+  hint = find_request (requests, "http://unit.test/002.1.ts", &count);
+  fail_unless (hint >= 0);
+  assert_equals_int (count, 1);
+  fail_unless (hint < reload);
+
+  TESTCASE_UNREF_BOILERPLATE;
+}
+
+GST_END_TEST;
+
 static Suite *
 hls_demux_suite (void)
 {
@@ -737,6 +840,7 @@ hls_demux_suite (void)
   tcase_add_test (tc_basicTest, testMediaPlaylistNotFound);
   tcase_add_test (tc_basicTest, testFragmentNotFound);
   tcase_add_test (tc_basicTest, testFragmentDownloadError);
+  tcase_add_test (tc_basicTest, testLowLatencyParts);
   tcase_add_test (tc_basicTest, testSeek);
   tcase_add_test (tc_basicTest, testSeekKeyUnitPosition);
   tcase_add_test (tc_basicTest, testSeekPosition);
@@ -27,6 +27,7 @@
 #undef GST_CAT_DEFAULT
 #include "m3u8.h"
 #include "m3u8.c"
+#include "gstm3u8playlist.c"
 
 GST_DEBUG_CATEGORY (hls_debug);
 
@@ -714,6 +715,156 @@ GST_START_TEST (test_update_playlist)
 
 GST_END_TEST;
 
+static gchar *
+generate_live_playlist (gint64 first_sequence, guint n_files,
+    const gchar * prefix)
+{
+  GString *str = g_string_new ("#EXTM3U\n#EXT-X-TARGETDURATION:2\n");
+  guint i;
+
+  g_string_append_printf (str, "#EXT-X-MEDIA-SEQUENCE:%" G_GINT64_FORMAT
+      "\n", first_sequence);
+  for (i = 0; i < n_files; i++)
+    g_string_append_printf (str, "#EXTINF:2,\n%s%" G_GINT64_FORMAT ".ts\n",
+        prefix, first_sequence + i);
+
+  return g_string_free (str, FALSE);
+}
+
+GST_START_TEST (test_update_playlist_incremental)
+{
+  GstHLSMasterPlaylist *master;
+  GstM3U8 *pl;
+  GstM3U8MediaFile *file;
+  GstClockTime start;
+  GList *l;
+  gchar *data;
+
+  data = generate_live_playlist (100, 1000, "seg");
+  master = load_playlist (data);
+  g_free (data);
+  pl = master->default_variant->m3u8;
+  assert_equals_int (g_list_length (pl->files), 1000);
+
+  l = gst_m3u8_find_file_at_position (pl, 800 * GST_SECOND + 1, &start);
+  fail_unless (l != NULL);
+  file = l->data;
+  assert_equals_int (file->sequence, 500);
+  assert_equals_uint64 (start, 800 * GST_SECOND);
+
+  /* Files that were already known are kept as they are */
+  fail_unless (gst_m3u8_update (pl, generate_live_playlist (102, 1000,
+              "seg")));
+  assert_equals_int (g_list_length (pl->files), 1000);
+  assert_equals_int (GST_M3U8_MEDIA_FILE (pl->files->data)->sequence, 102);
+  assert_equals_int (GST_M3U8_MEDIA_FILE (g_list_last (pl->files)->data)->
+      sequence, 1101);
+  l = gst_m3u8_find_file_at_position (pl, 796 * GST_SECOND, &start);
+  fail_unless (l != NULL);
+  fail_unless (l->data == file);
+  assert_equals_string (file->uri, "http://localhost/seg500.ts");
+  assert_equals_uint64 (start, 796 * GST_SECOND);
+
+  /* Lookups by sequence */
+  pl->sequence = 1000;
+  pl->current_file = NULL;
+  file = gst_m3u8_get_next_fragment (pl, TRUE, NULL, NULL);
+  fail_unless (file != NULL);
+  assert_equals_string (file->uri, "http://localhost/seg1000.ts");
+  gst_m3u8_media_file_unref (file);
+  gst_m3u8_advance_fragment (pl, TRUE);
+  assert_equals_int (pl->sequence, 1001);
+
+  fail_unless (gst_m3u8_find_file_at_position (pl, 2000 * GST_SECOND,
+          &start) == NULL);
+  assert_equals_uint64 (start, 2000 * GST_SECOND);
+
+  /* A known sequence number with another URI is an error */
+  fail_if (gst_m3u8_update (pl, generate_live_playlist (102, 1001, "other")));
+
+  gst_hls_master_playlist_unref (master);
+
+  /* URIs are compared once resolved, "seg1.ts" is not "live/seg1.ts" */
+  data = generate_live_playlist (1, 10, "live/seg");
+  master = load_playlist (data);
+  g_free (data);
+  pl = master->default_variant->m3u8;
+  assert_equals_string (GST_M3U8_MEDIA_FILE (pl->files->data)->uri,
+      "http://localhost/live/seg1.ts");
+  fail_if (gst_m3u8_update (pl, generate_live_playlist (1, 10, "seg")));
+
+  gst_hls_master_playlist_unref (master);
+}
+
+GST_END_TEST;
+
+static gchar *
+generate_encrypted_live_playlist (gint64 first_sequence, guint n_files)
+{
+  GString *str = g_string_new ("#EXTM3U\n#EXT-X-TARGETDURATION:2\n");
+  guint i;
+
+  g_string_append_printf (str, "#EXT-X-MEDIA-SEQUENCE:%" G_GINT64_FORMAT
+      "\n#EXT-X-KEY:METHOD=AES-128,URI=\"key.bin\","
+      "IV=0x000102030405060708090a0b0c0d0e0f\n", first_sequence);
+  for (i = 0; i < n_files; i++)
+    g_string_append_printf (str, "#EXTINF:2,title%" G_GINT64_FORMAT
+        "\nseg%" G_GINT64_FORMAT ".ts\n", first_sequence + i,
+        first_sequence + i);
+
+  return g_string_free (str, FALSE);
+}
+
+GST_START_TEST (test_update_playlist_unchanged_files)
+{
+  GstHLSMasterPlaylist *master;
+  GstM3U8 *pl;
+  GstM3U8MediaFile *file;
+  const gchar *uri, *title;
+  guint8 iv[16];
+  gchar *data;
+  gint i;
+
+  for (i = 0; i < 16; i++)
+    iv[i] = i;
+
+  data = generate_encrypted_live_playlist (10, 100);
+  master = load_playlist (data);
+  g_free (data);
+  pl = master->default_variant->m3u8;
+  assert_equals_int (g_list_length (pl->files), 100);
+
+  file = g_list_nth_data (pl->files, 50);
+  uri = file->uri;
+  title = file->title;
+  assert_equals_string (title, "title60");
+
+  /* The known files after the first one are taken as they are, their lines
+   * aren't parsed and resolved again */
+  fail_unless (gst_m3u8_update (pl, generate_encrypted_live_playlist (12,
+              100)));
+  assert_equals_int (g_list_length (pl->files), 100);
+  fail_unless (g_list_nth_data (pl->files, 48) == file);
+  fail_unless (file->uri == uri);
+  fail_unless (file->title == title);
+
+  /* The new files continue with the key and IV of the known ones */
+  file = g_list_last (pl->files)->data;
+  assert_equals_int (file->sequence, 111);
+  assert_equals_string (file->uri, "http://localhost/seg111.ts");
+  assert_equals_string (file->title, "title111");
+  assert_equals_string (file->key, "http://localhost/key.bin");
+  fail_unless (memcmp (file->iv, iv, 16) == 0);
+
+  /* With another base URI the known lines are resolved again */
+  gst_m3u8_set_uri (pl, "http://localhost/other/test.m3u8", NULL, NULL);
+  fail_if (gst_m3u8_update (pl, generate_encrypted_live_playlist (13, 100)));
+
+  gst_hls_master_playlist_unref (master);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_playlist_media_files)
 {
   GstHLSMasterPlaylist *master;
@@ -1469,6 +1620,208 @@ GST_START_TEST (test_map_tag)
 
 GST_END_TEST;
 
+GST_START_TEST (test_render_low_latency_playlist)
+{
+  GstM3U8Playlist *playlist;
+  gchar *rendered;
+  guint i;
+
+  playlist = gst_m3u8_playlist_new (6, 5);
+  playlist->part_target = 0.5 * GST_SECOND;
+  playlist->can_block_reload = TRUE;
+
+  /* Only the last 3 segments keep their parts */
+  for (i = 0; i < 4; i++) {
+    gchar *url = g_strdup_printf ("segment%05u.ts", i);
+
+    fail_unless (gst_m3u8_playlist_add_part (playlist, url, 0.5 * GST_SECOND,
+            0, 1000, TRUE));
+    fail_unless (gst_m3u8_playlist_add_part (playlist, url, 0.5 * GST_SECOND,
+            1000, 800, FALSE));
+    fail_unless (gst_m3u8_playlist_add_entry (playlist, url, NULL,
+            1.0 * GST_SECOND, i, FALSE));
+    g_free (url);
+  }
+  gst_m3u8_playlist_add_part (playlist, "segment00004.ts", 0.5 * GST_SECOND,
+      0, 1200, TRUE);
+  gst_m3u8_playlist_set_preload_hint (playlist, "segment00004.ts", 1200);
+
+  rendered = gst_m3u8_playlist_render (playlist);
+  assert_equals_string (rendered, "#EXTM3U\n"
+      "#EXT-X-VERSION:6\n"
+      "#EXT-X-MEDIA-SEQUENCE:0\n"
+      "#EXT-X-TARGETDURATION:1\n"
+      "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=1.50000\n"
+      "#EXT-X-PART-INF:PART-TARGET=0.50000\n"
+      "\n"
+      "#EXTINF:1,\n"
+      "segment00000.ts\n"
+      "#EXT-X-PART:DURATION=0.50000,URI=\"segment00001.ts\","
+      "BYTERANGE=\"1000@0\",INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.50000,URI=\"segment00001.ts\","
+      "BYTERANGE=\"800@1000\"\n"
+      "#EXTINF:1,\n"
+      "segment00001.ts\n"
+      "#EXT-X-PART:DURATION=0.50000,URI=\"segment00002.ts\","
+      "BYTERANGE=\"1000@0\",INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.50000,URI=\"segment00002.ts\","
+      "BYTERANGE=\"800@1000\"\n"
+      "#EXTINF:1,\n"
+      "segment00002.ts\n"
+      "#EXT-X-PART:DURATION=0.50000,URI=\"segment00003.ts\","
+      "BYTERANGE=\"1000@0\",INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.50000,URI=\"segment00003.ts\","
+      "BYTERANGE=\"800@1000\"\n"
+      "#EXTINF:1,\n"
+      "segment00003.ts\n"
+      "#EXT-X-PART:DURATION=0.50000,URI=\"segment00004.ts\","
+      "BYTERANGE=\"1200@0\",INDEPENDENT=YES\n"
+      "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"segment00004.ts\","
+      "BYTERANGE-START=1200\n");
+  g_free (rendered);
+
+  /* Parts and hints are gone once the playlist ended */
+  playlist->end_list = TRUE;
+  rendered = gst_m3u8_playlist_render (playlist);
+  fail_if (strstr (rendered, "#EXT-X-PRELOAD-HINT") != NULL);
+  fail_if (strstr (rendered, "segment00004.ts") != NULL);
+  g_free (rendered);
+
+  gst_m3u8_playlist_free (playlist);
+}
+
+GST_END_TEST;
+
+#define LOW_LATENCY_PLAYLIST_HEAD \
+  "#EXTM3U\n" \
+  "#EXT-X-VERSION:6\n" \
+  "#EXT-X-TARGETDURATION:2\n" \
+  "#EXT-X-MEDIA-SEQUENCE:10\n" \
+  "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=1.5\n" \
+  "#EXT-X-PART-INF:PART-TARGET=0.5\n" \
+  "#EXTINF:2.0,\n" \
+  "seg10.ts\n" \
+  "#EXT-X-PART:DURATION=0.5,URI=\"seg11.0.ts\",INDEPENDENT=YES\n" \
+  "#EXT-X-PART:DURATION=0.5,URI=\"seg11.1.ts\"\n" \
+  "#EXT-X-PART:DURATION=0.5,URI=\"seg11.2.ts\",INDEPENDENT=YES\n" \
+  "#EXT-X-PART:DURATION=0.5,URI=\"seg11.3.ts\"\n" \
+  "#EXTINF:2.0,\n" \
+  "seg11.ts\n" \
+  "#EXT-X-PART:DURATION=0.5,URI=\"seg12.ts\",BYTERANGE=\"1000@0\"," \
+  "INDEPENDENT=YES\n" \
+  "#EXT-X-PART:DURATION=0.5,URI=\"seg12.ts\",BYTERANGE=\"800\"\n"
+
+static const gchar *LOW_LATENCY_PLAYLIST = LOW_LATENCY_PLAYLIST_HEAD
+    "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"seg12.ts\",BYTERANGE-START=1800,"
+    "BYTERANGE-LENGTH=900\n";
+
+static const gchar *LOW_LATENCY_PLAYLIST_UPDATED = LOW_LATENCY_PLAYLIST_HEAD
+    "#EXT-X-PART:DURATION=0.5,URI=\"seg12.ts\",BYTERANGE=\"900\"\n"
+    "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"seg12.ts\",BYTERANGE-START=2700\n";
+
+GST_START_TEST (test_low_latency_playlist)
+{
+  GstHLSMasterPlaylist *master;
+  GstM3U8 *pl;
+  GstM3U8MediaFile *mf, *segment;
+  GstClockTime timestamp;
+  gboolean discontinuous;
+  gchar *uri;
+
+  master = load_playlist (LOW_LATENCY_PLAYLIST);
+  pl = master->default_variant->m3u8;
+
+  assert_equals_uint64 (gst_m3u8_get_part_target (pl), GST_SECOND / 2);
+  fail_unless (pl->can_block_reload);
+  assert_equals_uint64 (pl->part_hold_back, 1500 * GST_MSECOND);
+
+  /* Complete segments and the one in progress */
+  assert_equals_int (g_list_length (pl->files), 2);
+  segment = g_list_last (pl->files)->data;
+  assert_equals_int (segment->sequence, 11);
+  assert_equals_int (segment->parts->len, 4);
+  fail_unless (pl->partial_file != NULL);
+  assert_equals_int (pl->partial_file->sequence, 12);
+  assert_equals_int (pl->partial_file->parts->len, 2);
+  assert_equals_uint64 (pl->partial_file->duration, GST_SECOND);
+  mf = g_ptr_array_index (pl->partial_file->parts, 1);
+  assert_equals_string (mf->uri, "http://localhost/seg12.ts");
+  assert_equals_int64 (mf->offset, 1000);
+  assert_equals_int64 (mf->size, 800);
+
+  /* Playback starts at the independent part past PART-HOLD-BACK */
+  assert_equals_int (pl->sequence, 11);
+  assert_equals_int (pl->part, 2);
+
+  mf = gst_m3u8_get_next_fragment (pl, TRUE, &timestamp, &discontinuous);
+  fail_unless (mf != NULL);
+  assert_equals_string (mf->uri, "http://localhost/seg11.2.ts");
+  assert_equals_uint64 (timestamp, 3 * GST_SECOND);
+  assert_equals_uint64 (mf->duration, GST_SECOND / 2);
+  fail_unless (mf->independent);
+  gst_m3u8_media_file_unref (mf);
+  gst_m3u8_advance_fragment (pl, TRUE);
+
+  mf = gst_m3u8_get_next_fragment (pl, TRUE, &timestamp, &discontinuous);
+  assert_equals_string (mf->uri, "http://localhost/seg11.3.ts");
+  assert_equals_uint64 (timestamp, 3500 * GST_MSECOND);
+  gst_m3u8_media_file_unref (mf);
+  fail_unless (gst_m3u8_has_next_fragment (pl, TRUE));
+  gst_m3u8_advance_fragment (pl, TRUE);
+
+  /* Over to the segment in progress */
+  mf = gst_m3u8_get_next_fragment (pl, TRUE, &timestamp, &discontinuous);
+  assert_equals_string (mf->uri, "http://localhost/seg12.ts");
+  assert_equals_uint64 (timestamp, 4 * GST_SECOND);
+  assert_equals_int (discontinuous, FALSE);
+  assert_equals_int64 (mf->offset, 0);
+  assert_equals_int64 (mf->size, 1000);
+  gst_m3u8_media_file_unref (mf);
+  gst_m3u8_advance_fragment (pl, TRUE);
+
+  mf = gst_m3u8_get_next_fragment (pl, TRUE, &timestamp, &discontinuous);
+  assert_equals_int64 (mf->offset, 1000);
+  gst_m3u8_media_file_unref (mf);
+  fail_if (gst_m3u8_has_next_fragment (pl, TRUE));
+  gst_m3u8_advance_fragment (pl, TRUE);
+
+  /* The next part is not published yet */
+  fail_unless (gst_m3u8_get_next_fragment (pl, TRUE, &timestamp,
+          &discontinuous) == NULL);
+
+  uri = gst_m3u8_get_blocking_reload_uri (pl);
+  assert_equals_string (uri,
+      "http://localhost/test.m3u8?_HLS_msn=12&_HLS_part=2");
+  g_free (uri);
+
+  mf = gst_m3u8_get_preload_hint (pl);
+  fail_unless (mf != NULL);
+  assert_equals_string (mf->uri, "http://localhost/seg12.ts");
+  assert_equals_int64 (mf->offset, 1800);
+  assert_equals_int64 (mf->size, 900);
+  gst_m3u8_media_file_unref (mf);
+
+  /* Once listed, it is returned where the hint pointed. The open ended
+   * hint is not usable for prefetching. */
+  fail_unless (gst_m3u8_update (pl, g_strdup (LOW_LATENCY_PLAYLIST_UPDATED)));
+  mf = gst_m3u8_get_next_fragment (pl, TRUE, &timestamp, &discontinuous);
+  fail_unless (mf != NULL);
+  assert_equals_uint64 (timestamp, 5 * GST_SECOND);
+  assert_equals_int64 (mf->offset, 1800);
+  assert_equals_int64 (mf->size, 900);
+  gst_m3u8_media_file_unref (mf);
+  fail_unless (gst_m3u8_get_preload_hint (pl) == NULL);
+
+  uri = gst_m3u8_get_blocking_reload_uri (pl);
+  assert_equals_string (uri,
+      "http://localhost/test.m3u8?_HLS_msn=12&_HLS_part=3");
+  g_free (uri);
+
+  gst_hls_master_playlist_unref (master);
+}
+
+GST_END_TEST;
+
 static Suite *
 hlsdemux_suite (void)
 {
@@ -1495,6 +1848,8 @@ hlsdemux_suite (void)
   tcase_add_test (tc_m3u8, test_playlist_with_encryption);
   tcase_add_test (tc_m3u8, test_update_invalid_playlist);
   tcase_add_test (tc_m3u8, test_update_playlist);
+  tcase_add_test (tc_m3u8, test_update_playlist_incremental);
+  tcase_add_test (tc_m3u8, test_update_playlist_unchanged_files);
   tcase_add_test (tc_m3u8, test_playlist_media_files);
   tcase_add_test (tc_m3u8, test_playlist_byte_range_media_files);
   tcase_add_test (tc_m3u8, test_get_next_fragment);
@@ -1512,6 +1867,8 @@ hlsdemux_suite (void)
   tcase_add_test (tc_m3u8, test_url_with_slash_query_param);
   tcase_add_test (tc_m3u8, test_stream_inf_tag);
   tcase_add_test (tc_m3u8, test_map_tag);
+  tcase_add_test (tc_m3u8, test_render_low_latency_playlist);
+  tcase_add_test (tc_m3u8, test_low_latency_playlist);
   return s;
 }
 
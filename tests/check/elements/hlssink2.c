@@ -0,0 +1,369 @@
+/* GStreamer
+ *
+ * unit test for hlssink2
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gio/gio.h>
+#include <gst/gst.h>
+#include <gst/app/app.h>
+#include <gst/check/gstcheck.h>
+
+#define N_FRAMES 90
+#define FPS 30
+#define GOP_SIZE 15
+#define PART_DURATION 200
+
+typedef struct
+{
+  gchar *location;
+  guint sequence;
+  guint part;
+  guint64 offset;
+  GstBuffer *data;
+} Part;
+
+typedef struct
+{
+  GHashTable *fragments;        /* location -> GMemoryOutputStream */
+  GMemoryOutputStream *playlist;
+  guint n_playlists;
+  guint n_preload_hints;
+  GList *parts;
+} TestData;
+
+static void
+part_free (Part * part)
+{
+  g_free (part->location);
+  gst_buffer_unref (part->data);
+  g_free (part);
+}
+
+static void
+check_playlist (TestData * data)
+{
+  const gchar *content;
+
+  if (!data->playlist)
+    return;
+
+  fail_unless (g_output_stream_write_all (G_OUTPUT_STREAM (data->playlist),
+          "", 1, NULL, NULL, NULL));
+  content = g_memory_output_stream_get_data (data->playlist);
+  data->n_playlists++;
+  if (strstr (content, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\""))
+    data->n_preload_hints++;
+}
+
+static GOutputStream *
+get_playlist_stream (GstElement * sink, const gchar * location,
+    TestData * data)
+{
+  /* The previous playlist is complete */
+  check_playlist (data);
+  g_clear_object (&data->playlist);
+
+  data->playlist =
+      G_MEMORY_OUTPUT_STREAM (g_memory_output_stream_new_resizable ());
+
+  return g_object_ref (G_OUTPUT_STREAM (data->playlist));
+}
+
+static GOutputStream *
+get_fragment_stream (GstElement * sink, const gchar * location,
+    TestData * data)
+{
+  GOutputStream *stream = g_memory_output_stream_new_resizable ();
+
+  g_hash_table_insert (data->fragments, g_path_get_basename (location),
+      g_object_ref (stream));
+
+  return stream;
+}
+
+static void
+new_part (GstElement * sink, const gchar * location, guint sequence,
+    guint part_index, guint64 offset, GstBuffer * buffer, TestData * data)
+{
+  Part *part = g_new0 (Part, 1);
+
+  part->location = g_strdup (location);
+  part->sequence = sequence;
+  part->part = part_index;
+  part->offset = offset;
+  part->data = gst_buffer_ref (buffer);
+  data->parts = g_list_append (data->parts, part);
+}
+
+static void
+run_sink (TestData * data, gboolean can_block_reload)
+{
+  GstElement *pipeline, *appsrc, *sink;
+  GstMessage *msg;
+  GstBus *bus;
+  GstCaps *caps;
+  gint i;
+
+  data->fragments = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      g_object_unref);
+  data->playlist = NULL;
+  data->n_playlists = 0;
+  data->n_preload_hints = 0;
+  data->parts = NULL;
+
+  pipeline = gst_pipeline_new (NULL);
+  appsrc = gst_element_factory_make ("appsrc", NULL);
+  sink = gst_element_factory_make ("hlssink2", NULL);
+  fail_unless (sink != NULL);
+
+  caps = gst_caps_from_string ("video/x-h264, stream-format=byte-stream, "
+      "alignment=au, width=320, height=240, framerate=30/1");
+  g_object_set (appsrc, "caps", caps, "format", GST_FORMAT_TIME, NULL);
+  gst_caps_unref (caps);
+
+  g_object_set (sink, "target-duration", 1, "part-duration", PART_DURATION,
+      "can-block-reload", can_block_reload, "send-keyframe-requests", FALSE,
+      NULL);
+  g_signal_connect (sink, "get-playlist-stream",
+      G_CALLBACK (get_playlist_stream), data);
+  g_signal_connect (sink, "get-fragment-stream",
+      G_CALLBACK (get_fragment_stream), data);
+  g_signal_connect (sink, "new-part", G_CALLBACK (new_part), data);
+
+  gst_bin_add_many (GST_BIN (pipeline), appsrc, sink, NULL);
+  fail_unless (gst_element_link_pads (appsrc, "src", sink, "video"));
+
+  /* Write the fragments as fast as possible */
+  gst_pipeline_use_clock (GST_PIPELINE (pipeline), NULL);
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+  for (i = 0; i < N_FRAMES; i++) {
+    /* Access unit delimiter and some slice data */
+    static const guint8 frame[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,
+      0x00, 0x00, 0x01, 0x01, 0xaa, 0xbb, 0xcc, 0xdd
+    };
+    GstBuffer *buf = gst_buffer_new_allocate (NULL, sizeof (frame), NULL);
+
+    gst_buffer_fill (buf, 0, frame, sizeof (frame));
+    GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) =
+        gst_util_uint64_scale (i, GST_SECOND, FPS);
+    GST_BUFFER_DURATION (buf) = GST_SECOND / FPS;
+    if (i % GOP_SIZE != 0)
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    fail_unless_equals_int (gst_app_src_push_buffer (GST_APP_SRC (appsrc),
+            buf), GST_FLOW_OK);
+  }
+  gst_app_src_end_of_stream (GST_APP_SRC (appsrc));
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_NULL) != GST_STATE_CHANGE_FAILURE);
+  gst_object_unref (pipeline);
+
+  check_playlist (data);
+}
+
+/* Whether the first PES in the part is a random access point, as flagged in
+ * the adaptation field of its first TS packet */
+static gboolean
+part_starts_with_keyframe (Part * part)
+{
+  GstMapInfo map;
+  gboolean keyframe = FALSE;
+  gsize offset;
+
+  fail_unless (gst_buffer_map (part->data, &map, GST_MAP_READ));
+  fail_unless (map.size % 188 == 0);
+
+  for (offset = 0; offset < map.size; offset += 188) {
+    const guint8 *packet = map.data + offset;
+    const guint8 *payload = packet + 4;
+
+    fail_unless_equals_int (packet[0], 0x47);
+    /* payload_unit_start_indicator */
+    if (!(packet[1] & 0x40))
+      continue;
+    if (packet[3] & 0x20)
+      payload += 1 + packet[4];
+    /* PSI sections don't start with a PES start code */
+    if (payload + 3 > packet + 188 || payload[0] != 0x00 || payload[1] != 0x00
+        || payload[2] != 0x01)
+      continue;
+
+    keyframe = (packet[3] & 0x20) && packet[4] > 0 && (packet[5] & 0x40);
+    break;
+  }
+  gst_buffer_unmap (part->data, &map);
+
+  return keyframe;
+}
+
+static void
+clear_data (TestData * data)
+{
+  g_hash_table_unref (data->fragments);
+  g_clear_object (&data->playlist);
+  g_list_free_full (data->parts, (GDestroyNotify) part_free);
+}
+
+GST_START_TEST (test_hlssink2_parts)
+{
+  TestData data;
+  const gchar *content;
+  Part *prev = NULL;
+  guint64 fragment_size = 0;
+  guint n_fragments = 0;
+  guint n_independent = 0, n_dependent = 0;
+  GList *l;
+
+  run_sink (&data, FALSE);
+
+  /* Fragments of 1 second are cut in parts of 200 ms at frame boundaries */
+  fail_unless (g_list_length (data.parts) >= 2 * 3);
+
+  for (l = data.parts; l; l = l->next) {
+    Part *part = l->data;
+    GMemoryOutputStream *fragment;
+    guint8 *fragment_data;
+    gsize size = gst_buffer_get_size (part->data);
+
+    fail_unless (size > 0);
+
+    if (!prev || prev->sequence != part->sequence) {
+      /* Parts of a fragment start at its beginning... */
+      fail_unless_equals_int (part->part, 0);
+      fail_unless_equals_uint64 (part->offset, 0);
+      if (prev) {
+        fail_unless_equals_int (part->sequence, prev->sequence + 1);
+        fail_unless (strcmp (part->location, prev->location) != 0);
+      }
+      fragment_size = 0;
+      n_fragments++;
+    } else {
+      /* ...and follow each other */
+      fail_unless_equals_int (part->part, prev->part + 1);
+      fail_unless_equals_uint64 (part->offset, prev->offset +
+          gst_buffer_get_size (prev->data));
+      fail_unless_equals_string (part->location, prev->location);
+    }
+
+    /* The data of a part is what was written to the fragment there */
+    fragment = g_hash_table_lookup (data.fragments, part->location);
+    fail_unless (fragment != NULL);
+    fail_unless (part->offset + size <=
+        g_memory_output_stream_get_data_size (fragment));
+    fragment_data = g_memory_output_stream_get_data (fragment);
+    fail_unless (gst_buffer_memcmp (part->data, 0,
+            fragment_data + part->offset, size) == 0);
+
+    fragment_size += size;
+    /* The last part of a fragment ends with it */
+    if (!l->next || ((Part *) l->next->data)->sequence != part->sequence)
+      fail_unless_equals_uint64 (fragment_size,
+          g_memory_output_stream_get_data_size (fragment));
+
+    prev = part;
+  }
+  fail_unless_equals_int (n_fragments, g_hash_table_size (data.fragments));
+
+  /* Parts are only independent if they start with a keyframe in the muxer
+   * output. Keyframes every GOP_SIZE frames also fall in the middle of
+   * parts */
+  content = g_memory_output_stream_get_data (data.playlist);
+  for (l = data.parts; l; l = l->next) {
+    Part *part = l->data;
+    gchar *entry;
+    const gchar *line;
+
+    entry = g_strdup_printf ("URI=\"%s\",BYTERANGE=\"%" G_GSIZE_FORMAT "@%"
+        G_GUINT64_FORMAT "\"", part->location,
+        gst_buffer_get_size (part->data), part->offset);
+    line = strstr (content, entry);
+    if (line) {
+      gboolean independent = g_str_has_prefix (line + strlen (entry),
+          ",INDEPENDENT=YES");
+
+      fail_unless_equals_int (independent, part_starts_with_keyframe (part));
+      if (independent)
+        n_independent++;
+      else
+        n_dependent++;
+    }
+    g_free (entry);
+  }
+  fail_unless (n_independent > 0);
+  fail_unless (n_dependent > 0);
+
+  /* The playlist is written for every part and announces the next one */
+  fail_unless (data.n_playlists > n_fragments);
+  fail_unless (data.n_preload_hints > 0);
+
+  fail_unless (strstr (content, "#EXT-X-PART-INF:PART-TARGET=0.20000\n"));
+  fail_unless (strstr (content, "#EXT-X-PART:DURATION="));
+  fail_unless (strstr (content, "#EXT-X-ENDLIST"));
+  /* Only advertised on request */
+  fail_if (strstr (content, "CAN-BLOCK-RELOAD"));
+
+  clear_data (&data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_hlssink2_can_block_reload)
+{
+  TestData data;
+  const gchar *content;
+
+  run_sink (&data, TRUE);
+
+  content = g_memory_output_stream_get_data (data.playlist);
+  fail_unless (strstr (content,
+          "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,"));
+
+  clear_data (&data);
+}
+
+GST_END_TEST;
+
+static Suite *
+hlssink2_suite (void)
+{
+  Suite *s = suite_create ("hlssink2");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (s, tc);
+  tcase_add_test (tc, test_hlssink2_parts);
+  tcase_add_test (tc, test_hlssink2_can_block_reload);
+
+  return s;
+}
+
+GST_CHECK_MAIN (hlssink2);
@@ -0,0 +1,323 @@
+/* GStreamer
+ *
+ * unit test for intervideosink/intervideosrc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+
+#include "../../../gst/inter/gstintersurface.h"
+
+#define N_FRAMES 30
+#define N_BLOCK_READERS 2
+#define N_STRESS_FRAMES 20000
+#define N_STRESS_READERS 4
+
+static GstBuffer *
+create_frame (guint n)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, 64, NULL);
+
+  gst_buffer_memset (buf, 0, n & 0xff, 64);
+  GST_BUFFER_OFFSET (buf) = n;
+
+  return buf;
+}
+
+static void
+publish_frame (GstInterSurface * surface, guint n)
+{
+  GstBuffer *buf = create_frame (n);
+
+  fail_unless (gst_inter_surface_video_publish (surface, buf));
+  gst_buffer_unref (buf);
+}
+
+/* Returns the number of the next frame for @reader, or -1 if there is none */
+static gint
+read_frame (GstInterSurface * surface, gint reader)
+{
+  GstBuffer *buf;
+  gboolean reset;
+  GstMapInfo map;
+  gint n;
+
+  fail_unless_equals_int (gst_inter_surface_video_read (surface, reader, -1,
+          &buf, &reset), GST_FLOW_OK);
+  fail_if (reset);
+  if (buf == NULL)
+    return -1;
+
+  n = GST_BUFFER_OFFSET (buf);
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.data[0], n & 0xff);
+  fail_unless_equals_int (map.data[63], n & 0xff);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  return n;
+}
+
+static GstElement *
+create_reader (const gchar * policy, GstElement ** appsink)
+{
+  GstElement *pipeline, *src;
+
+  src = gst_element_factory_make ("intervideosrc", NULL);
+  gst_util_set_object_arg (G_OBJECT (src), "policy", policy);
+  g_object_set (src, "channel", "intervideo-test", "timeout",
+      GST_CLOCK_TIME_NONE, NULL);
+
+  *appsink = gst_element_factory_make ("appsink", NULL);
+  g_object_set (*appsink, "sync", FALSE, "async", FALSE, "max-buffers", 1,
+      "enable-last-sample", FALSE, NULL);
+
+  pipeline = gst_pipeline_new (NULL);
+  gst_bin_add_many (GST_BIN (pipeline), src, *appsink, NULL);
+  fail_unless (gst_element_link (src, *appsink));
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+  return pipeline;
+}
+
+GST_START_TEST (test_intervideo_block)
+{
+  GstElement *producer, *appsrc, *sink;
+  GstElement *readers[N_BLOCK_READERS + 1];
+  GstElement *appsinks[N_BLOCK_READERS + 1];
+  GstCaps *caps;
+  guint ring_size;
+  gint i, j;
+
+  /* Readers with the block policy must see every frame in order */
+  for (i = 0; i < N_BLOCK_READERS; i++)
+    readers[i] = create_reader ("block", &appsinks[i]);
+  /* This one is never pulled from and mustn't hold back the sink */
+  readers[i] = create_reader ("drop", &appsinks[i]);
+
+  appsrc = gst_element_factory_make ("appsrc", NULL);
+  caps = gst_caps_from_string ("video/x-raw, format=GRAY8, width=8, "
+      "height=8, framerate=30/1");
+  g_object_set (appsrc, "caps", caps, "format", GST_FORMAT_TIME, NULL);
+  gst_caps_unref (caps);
+
+  sink = gst_element_factory_make ("intervideosink", NULL);
+  g_object_set (sink, "channel", "intervideo-test", "sync", FALSE,
+      "ring-size", 2, NULL);
+  g_object_get (sink, "ring-size", &ring_size, NULL);
+  fail_unless_equals_int (ring_size, 2);
+
+  producer = gst_pipeline_new (NULL);
+  gst_bin_add_many (GST_BIN (producer), appsrc, sink, NULL);
+  fail_unless (gst_element_link (appsrc, sink));
+  fail_unless (gst_element_set_state (producer,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+  for (j = 0; j < N_FRAMES; j++) {
+    GstBuffer *buf = gst_buffer_new_allocate (NULL, 64, NULL);
+    GstFlowReturn flow;
+
+    gst_buffer_memset (buf, 0, j, 64);
+    GST_BUFFER_PTS (buf) = j * GST_SECOND / 30;
+    GST_BUFFER_DURATION (buf) = GST_SECOND / 30;
+    g_signal_emit_by_name (appsrc, "push-buffer", buf, &flow);
+    fail_unless_equals_int (flow, GST_FLOW_OK);
+    gst_buffer_unref (buf);
+  }
+
+  for (j = 0; j < N_FRAMES; j++) {
+    for (i = 0; i < N_BLOCK_READERS; i++) {
+      GstSample *sample = NULL;
+      GstMapInfo map;
+      GstBuffer *buf;
+
+      g_signal_emit_by_name (appsinks[i], "pull-sample", &sample);
+      fail_unless (sample != NULL);
+      buf = gst_sample_get_buffer (sample);
+      fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+      fail_unless_equals_int (map.size, 64);
+      fail_unless_equals_int (map.data[0], j);
+      gst_buffer_unmap (buf, &map);
+      gst_sample_unref (sample);
+    }
+  }
+
+  fail_unless (gst_element_set_state (producer,
+          GST_STATE_NULL) != GST_STATE_CHANGE_FAILURE);
+  gst_object_unref (producer);
+
+  for (i = 0; i < N_BLOCK_READERS + 1; i++) {
+    fail_unless (gst_element_set_state (readers[i],
+            GST_STATE_NULL) != GST_STATE_CHANGE_FAILURE);
+    gst_object_unref (readers[i]);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_intervideo_surface_repeat)
+{
+  GstInterSurface *surface = gst_inter_surface_get ("surface-repeat");
+  gint reader;
+
+  gst_inter_surface_video_reset (surface, 4);
+  reader = gst_inter_surface_video_add_reader (surface,
+      GST_INTER_VIDEO_POLICY_REPEAT);
+  fail_unless (reader >= 0);
+  fail_unless_equals_int (read_frame (surface, reader), -1);
+
+  /* Only the latest frame is read, and only once */
+  publish_frame (surface, 1);
+  publish_frame (surface, 2);
+  publish_frame (surface, 3);
+  fail_unless_equals_int (read_frame (surface, reader), 3);
+  fail_unless_equals_int (read_frame (surface, reader), -1);
+
+  publish_frame (surface, 4);
+  fail_unless_equals_int (read_frame (surface, reader), 4);
+  fail_unless_equals_int (read_frame (surface, reader), -1);
+
+  gst_inter_surface_video_remove_reader (surface, reader);
+  gst_inter_surface_unref (surface);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_intervideo_surface_drop)
+{
+  GstInterSurface *surface = gst_inter_surface_get ("surface-drop");
+  gint reader, i;
+
+  gst_inter_surface_video_reset (surface, 4);
+  reader = gst_inter_surface_video_add_reader (surface,
+      GST_INTER_VIDEO_POLICY_DROP);
+  fail_unless (reader >= 0);
+
+  /* Frames in the ring are read in order */
+  publish_frame (surface, 1);
+  publish_frame (surface, 2);
+  fail_unless_equals_int (read_frame (surface, reader), 1);
+  fail_unless_equals_int (read_frame (surface, reader), 2);
+  fail_unless_equals_int (read_frame (surface, reader), -1);
+
+  /* The sink doesn't wait, frames overwritten before being read are
+   * dropped */
+  for (i = 3; i <= 8; i++)
+    publish_frame (surface, i);
+  for (i = 5; i <= 8; i++)
+    fail_unless_equals_int (read_frame (surface, reader), i);
+  fail_unless_equals_int (read_frame (surface, reader), -1);
+
+  gst_inter_surface_video_remove_reader (surface, reader);
+  gst_inter_surface_unref (surface);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstInterSurface *surface;
+  gint reader;
+  gint done;
+  guint n_read;
+} StressReader;
+
+static gpointer
+stress_reader_thread (gpointer user_data)
+{
+  StressReader *r = user_data;
+  gint last = 0;
+
+  for (;;) {
+    gboolean done = g_atomic_int_get (&r->done);
+    gint n;
+
+    while ((n = read_frame (r->surface, r->reader)) != -1) {
+      fail_unless (n > last);
+      last = n;
+      r->n_read++;
+    }
+
+    if (done)
+      break;
+    g_thread_yield ();
+  }
+
+  /* Whatever was dropped, the last frame can't be */
+  fail_unless_equals_int (last, N_STRESS_FRAMES);
+
+  return NULL;
+}
+
+GST_START_TEST (test_intervideo_surface_stress)
+{
+  GstInterSurface *surface = gst_inter_surface_get ("surface-stress");
+  StressReader readers[N_STRESS_READERS];
+  GThread *threads[N_STRESS_READERS];
+  gint i;
+
+  /* With a single slot every publish retires the buffer the readers are
+   * most likely referencing */
+  gst_inter_surface_video_reset (surface, 1);
+
+  for (i = 0; i < N_STRESS_READERS; i++) {
+    readers[i].surface = surface;
+    readers[i].reader = gst_inter_surface_video_add_reader (surface,
+        i % 2 ? GST_INTER_VIDEO_POLICY_DROP : GST_INTER_VIDEO_POLICY_REPEAT);
+    fail_unless (readers[i].reader >= 0);
+    readers[i].done = 0;
+    readers[i].n_read = 0;
+    threads[i] = g_thread_new ("reader", stress_reader_thread, &readers[i]);
+  }
+
+  for (i = 1; i <= N_STRESS_FRAMES; i++)
+    publish_frame (surface, i);
+
+  for (i = 0; i < N_STRESS_READERS; i++) {
+    g_atomic_int_set (&readers[i].done, 1);
+    g_thread_join (threads[i]);
+    fail_unless (readers[i].n_read > 0);
+    gst_inter_surface_video_remove_reader (surface, readers[i].reader);
+  }
+
+  gst_inter_surface_unref (surface);
+}
+
+GST_END_TEST;
+
+static Suite *
+intervideo_suite (void)
+{
+  Suite *s = suite_create ("intervideo");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (s, tc);
+  tcase_add_test (tc, test_intervideo_block);
+  tcase_add_test (tc, test_intervideo_surface_repeat);
+  tcase_add_test (tc, test_intervideo_surface_drop);
+  tcase_add_test (tc, test_intervideo_surface_stress);
+
+  return s;
+}
+
+GST_CHECK_MAIN (intervideo);
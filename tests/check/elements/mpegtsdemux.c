@@ -21,6 +21,9 @@
 #include <gst/gst.h>
 #include <gst/check/gstcheck.h>
 #include <gst/check/gstharness.h>
+#include <gst/base/gstbytewriter.h>
+#include <glib/gstdio.h>
+#include <string.h>
 
 #define PACKETSIZE 188
 
@@ -284,6 +287,44 @@ GST_START_TEST (test_tsparse_align_split)
 
 GST_END_TEST;
 
+GST_START_TEST (test_tsparse_align_split_zero_copy)
+{
+  GstHarness *h = gst_harness_new ("tsparse");
+  GstBuffer *buf;
+  GstMapInfo map;
+  gsize i;
+
+  gst_harness_set (h, "tsparse", "alignment", 1, NULL);
+
+  gst_harness_set_src_caps_str (h, "video/mpegts,systemstream=true");
+  gst_harness_set_sink_caps_str (h,
+      "video/mpegts,systemstream=true,packetsize=" G_STRINGIFY (PACKETSIZE));
+
+  buf =
+      gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY, (guint8 *) aac_ts,
+      sizeof aac_ts, 0, sizeof aac_ts, NULL, NULL);
+  fail_unless (gst_harness_push (h, buf) == GST_FLOW_OK);
+
+  gst_harness_push_event (h, gst_event_new_eos ());
+  fail_unless (gst_harness_buffers_in_queue (h) == aac_ts_packets,
+      "Expected %u buffers, got %u", aac_ts_packets,
+      gst_harness_buffers_in_queue (h));
+
+  /* Packets contained in a single input buffer share its memory */
+  for (i = 0; i < sizeof aac_ts; i += PACKETSIZE) {
+    buf = gst_harness_pull (h);
+    fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+    fail_unless_equals_int (map.size, PACKETSIZE);
+    fail_unless (map.data == aac_ts + i);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_tsparse_padding)
 {
   GstHarness *h = gst_harness_new ("tsparse");
@@ -377,6 +418,518 @@ GST_START_TEST (test_tsdemux_simple)
 
 GST_END_TEST;
 
+GST_START_TEST (test_tsdemux_unaligned_input)
+{
+  GstHarness *h = gst_harness_new_with_padnames ("tsdemux", "sink", NULL);
+  GstBuffer *buf;
+  GstCaps *caps;
+  GstSegment segment;
+  gsize i;
+
+  caps = gst_caps_from_string ("video/mpegts,systemstream=true");
+  gst_harness_push_event (h, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_harness_push_event (h, gst_event_new_segment (&segment));
+
+  gst_harness_set_sink_caps_str (h,
+      "audio/mpeg,mpegversion=4,stream-format=adts");
+
+  g_signal_connect (h->element, "pad-added",
+      G_CALLBACK (tsdemux_simple_pad_added), h);
+
+  /* Feed chunks that don't line up with packet boundaries, so that some
+   * packets straddle two input buffers */
+  buf =
+      gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY, (guint8 *) aac_ts,
+      sizeof aac_ts, 0, sizeof aac_ts, NULL, NULL);
+  for (i = 0; i < sizeof aac_ts; i += 100) {
+    fail_unless (gst_harness_push (h, gst_buffer_copy_region (buf,
+                GST_BUFFER_COPY_MEMORY, i, MIN (100,
+                    sizeof aac_ts - i))) == GST_FLOW_OK);
+  }
+  gst_buffer_unref (buf);
+  gst_harness_push_event (h, gst_event_new_eos ());
+
+  buf = gst_harness_take_all_data_as_buffer (h);
+  gst_check_buffer_data (buf, aac_data, sizeof aac_data);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_tsdemux_latency_mode)
+{
+  GstHarness *h = gst_harness_new_with_padnames ("tsdemux", "sink", NULL);
+  GstBuffer *buf;
+  GstCaps *caps;
+  GstSegment segment;
+
+  caps = gst_caps_from_string ("video/mpegts,systemstream=true");
+  gst_harness_push_event (h, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_harness_push_event (h, gst_event_new_segment (&segment));
+
+  gst_harness_set_sink_caps_str (h,
+      "audio/mpeg,mpegversion=4,stream-format=adts");
+
+  g_signal_connect (h->element, "pad-added",
+      G_CALLBACK (tsdemux_simple_pad_added), h);
+
+  buf =
+      gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY, (guint8 *) aac_ts,
+      sizeof aac_ts, 0, sizeof aac_ts, NULL, NULL);
+  fail_unless (gst_harness_push (h, buf) == GST_FLOW_OK);
+
+  gst_harness_set_upstream_latency (h, 0);
+  fail_unless_equals_uint64 (gst_harness_query_latency (h),
+      700 * GST_MSECOND);
+
+  /* Untimestamped input, nothing measured: only the margin is left */
+  gst_harness_set (h, "tsdemux", "latency-mode", 1, NULL);
+  fail_unless (gst_harness_query_latency (h) < 100 * GST_MSECOND);
+
+  gst_harness_push_event (h, gst_event_new_eos ());
+  buf = gst_harness_take_all_data_as_buffer (h);
+  gst_check_buffer_data (buf, aac_data, sizeof aac_data);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+tsdemux_video_pad_added (GstElement * tsdemux, GstPad * pad, GstHarness * h)
+{
+  gst_harness_add_element_src_pad (h, pad);
+}
+
+/* An IDR slice and a P slice, each starting an access unit */
+static const guint8 h264_idr[] = { 0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84,
+  0x00, 0x10, 0x00
+};
+static const guint8 h264_p[] = { 0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x02,
+  0x00, 0x10, 0x00
+};
+
+/* Muxes @n_frames frames, alternating the keyframe @key and delta frames */
+static GstBuffer *
+mux_h264_access_units (const guint8 * key, gsize key_size, guint n_frames)
+{
+  GstHarness *mux;
+  GstBuffer *buf;
+  guint i;
+
+  mux = gst_harness_new_with_padnames ("mpegtsmux", "sink_%d", "src");
+  gst_harness_set_src_caps_str (mux,
+      "video/x-h264,stream-format=byte-stream,alignment=au");
+  for (i = 0; i < n_frames; i++) {
+    if (i % 2 == 0)
+      buf = gst_buffer_new_memdup (key, key_size);
+    else
+      buf = gst_buffer_new_memdup (h264_p, sizeof h264_p);
+    GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = i * 40 * GST_MSECOND;
+    if (i % 2)
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    fail_unless (gst_harness_push (mux, buf) == GST_FLOW_OK);
+  }
+  gst_harness_push_event (mux, gst_event_new_eos ());
+  buf = gst_harness_take_all_data_as_buffer (mux);
+  gst_harness_teardown (mux);
+
+  return buf;
+}
+
+static GstBuffer *
+mux_h264_frames (guint n_frames)
+{
+  return mux_h264_access_units (h264_idr, sizeof h264_idr, n_frames);
+}
+
+/* Demuxes @buf, keeping the keyframe index in @location */
+static void
+demux_with_index (GstBuffer * buf, const gchar * location)
+{
+  GstHarness *h;
+  GstCaps *caps;
+  GstSegment segment;
+
+  h = gst_harness_new_with_padnames ("tsdemux", "sink", NULL);
+  gst_harness_set (h, "tsdemux", "index-location", location, NULL);
+
+  caps = gst_caps_from_string ("video/mpegts,systemstream=true");
+  gst_harness_push_event (h, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_harness_push_event (h, gst_event_new_segment (&segment));
+
+  gst_harness_set_sink_caps_str (h, "video/x-h264,stream-format=byte-stream");
+  g_signal_connect (h->element, "pad-added",
+      G_CALLBACK (tsdemux_video_pad_added), h);
+
+  fail_unless (gst_harness_push (h, buf) == GST_FLOW_OK);
+  gst_harness_push_event (h, gst_event_new_eos ());
+
+  /* The index is written out when stopping */
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_tsdemux_keyframe_index)
+{
+  GstBuffer *buf;
+  gchar *dir, *location, *contents;
+  gchar **lines;
+
+  buf = mux_h264_frames (6);
+
+  dir = g_dir_make_tmp ("tsdemux-index-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+  location = g_build_filename (dir, "index", NULL);
+
+  demux_with_index (buf, location);
+
+  fail_unless (g_file_get_contents (location, &contents, NULL, NULL));
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  fail_unless_equals_string (lines[0], "MPEGTSINDEX 1");
+  /* At least two keyframes, the first one followed by the second without
+   * a gap, and no entry for the delta frames */
+  fail_unless (g_strv_length (lines) >= 4);
+  fail_unless (g_strv_length (lines) <= 5);
+  fail_unless (g_str_has_suffix (lines[1], " 1"));
+  g_strfreev (lines);
+
+  g_unlink (location);
+  g_rmdir (dir);
+  g_free (location);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+/* An IDR access unit as encoders put it out, with parameter sets and SEI
+ * in front of the slice that don't fit in the first TS packet of the PES */
+static GstBuffer *
+make_h264_idr_access_unit (void)
+{
+  static const guint8 aud_sps_pps[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x4d, 0x40, 0x15, 0xec, 0xa4, 0xbf, 0x2e,
+    0x02, 0x20, 0x00, 0x00, 0x03, 0x00, 0x2e, 0xe6, 0xb2, 0x80, 0x01, 0xe2,
+    0xc5, 0xb2, 0xc0,
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xeb, 0xec, 0xb2
+  };
+  /* user_data_unregistered SEI: 16 bytes UUID and 184 bytes payload */
+  static const guint8 sei_header[] = { 0x00, 0x00, 0x00, 0x01, 0x06, 0x05,
+    0xc8
+  };
+  GstByteWriter bw;
+  guint i;
+
+  gst_byte_writer_init (&bw);
+  gst_byte_writer_put_data (&bw, aud_sps_pps, sizeof aud_sps_pps);
+  gst_byte_writer_put_data (&bw, sei_header, sizeof sei_header);
+  for (i = 0; i < 200; i++)
+    gst_byte_writer_put_uint8 (&bw, 0x55);
+  /* rbsp_trailing_bits */
+  gst_byte_writer_put_uint8 (&bw, 0x80);
+  gst_byte_writer_put_data (&bw, h264_idr, sizeof h264_idr);
+
+  return gst_byte_writer_reset_and_get_buffer (&bw);
+}
+
+GST_START_TEST (test_tsdemux_keyframe_index_sei)
+{
+  GstBuffer *buf, *idr;
+  GstMapInfo map;
+  gchar *dir, *location, *contents;
+  gchar **lines;
+  guint i, n_entries;
+
+  idr = make_h264_idr_access_unit ();
+  fail_unless (gst_buffer_map (idr, &map, GST_MAP_READ));
+  buf = mux_h264_access_units (map.data, map.size, 6);
+  gst_buffer_unmap (idr, &map);
+  gst_buffer_unref (idr);
+
+  dir = g_dir_make_tmp ("tsdemux-index-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+  location = g_build_filename (dir, "index", NULL);
+
+  demux_with_index (buf, location);
+
+  fail_unless (g_file_get_contents (location, &contents, NULL, NULL));
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  /* The keyframes are found although their slice is not in the first TS
+   * packet, and are known to follow each other */
+  fail_unless_equals_string (lines[0], "MPEGTSINDEX 1");
+  n_entries = g_strv_length (lines) - 2;
+  fail_unless (n_entries >= 2);
+  fail_unless (n_entries <= 3);
+  for (i = 1; i < n_entries; i++)
+    fail_unless (g_str_has_suffix (lines[i], " 1"));
+  g_strfreev (lines);
+
+  g_unlink (location);
+  g_rmdir (dir);
+  g_free (location);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+static void
+index_seek_handoff (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    GArray * timestamps)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buf);
+
+  g_array_append_val (timestamps, pts);
+}
+
+static void
+run_to_eos (GstElement * pipeline)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+/* Once the index was built, a seek must start on the indexed keyframe. The
+ * PCR based estimation goes back SEEK_TIMESTAMP_OFFSET from the target, which
+ * on such a short stream always means the start of the file */
+GST_START_TEST (test_tsdemux_index_seek)
+{
+  GstElement *pipeline, *sink;
+  GArray *timestamps;
+  GstBuffer *buf;
+  GstMapInfo map;
+  GstClockTime target;
+  gchar *dir, *ts_location, *index_location, *desc;
+
+  buf = mux_h264_frames (8);
+
+  dir = g_dir_make_tmp ("tsdemux-index-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+  ts_location = g_build_filename (dir, "stream.ts", NULL);
+  index_location = g_build_filename (dir, "index", NULL);
+
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  fail_unless (g_file_set_contents (ts_location, (const gchar *) map.data,
+          map.size, NULL));
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  desc = g_strdup_printf ("filesrc location=%s ! tsdemux index-location=%s "
+      "! fakesink name=sink sync=false signal-handoffs=true", ts_location,
+      index_location);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  timestamps = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (index_seek_handoff),
+      timestamps);
+  gst_object_unref (sink);
+
+  /* Play everything once to fill the index */
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  run_to_eos (pipeline);
+  fail_unless_equals_int (timestamps->len, 8);
+
+  /* Between the second and the third keyframe, both of which are followed
+   * by another keyframe and are thus complete in the index */
+  target = g_array_index (timestamps, GstClockTime, 2) + 10 * GST_MSECOND;
+  g_array_set_size (timestamps, 0);
+
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, target));
+  run_to_eos (pipeline);
+
+  fail_unless_equals_int (timestamps->len, 6);
+  fail_unless_equals_uint64 (g_array_index (timestamps, GstClockTime, 0),
+      target - 10 * GST_MSECOND);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_array_free (timestamps, TRUE);
+
+  g_unlink (index_location);
+  g_unlink (ts_location);
+  g_rmdir (dir);
+  g_free (index_location);
+  g_free (ts_location);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+/* MPEG-2 CRC32 of PSI sections */
+static guint32
+psi_crc32 (const guint8 * data, gsize size)
+{
+  guint32 crc = 0xffffffff;
+  gsize i;
+  gint j;
+
+  for (i = 0; i < size; i++) {
+    crc ^= (guint32) data[i] << 24;
+    for (j = 0; j < 8; j++)
+      crc = crc & 0x80000000 ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+  }
+
+  return crc;
+}
+
+/* Writes a TS packet carrying a complete PSI section */
+static void
+write_psi_packet (guint8 * packet, guint16 pid, const guint8 * section,
+    gsize size)
+{
+  memset (packet, 0xff, PACKETSIZE);
+  packet[0] = 0x47;
+  packet[1] = 0x40 | (pid >> 8);
+  packet[2] = pid & 0xff;
+  packet[3] = 0x10;
+  /* pointer_field */
+  packet[4] = 0x00;
+  memcpy (packet + 5, section, size);
+  GST_WRITE_UINT32_BE (packet + 5 + size, psi_crc32 (section, size));
+}
+
+#define NO_PCR_PMT_PID 0x100
+#define NO_PCR_PID 0x101
+/* 20ms in 90kHz units */
+#define NO_PCR_PES_DURATION 1800
+
+/* A program whose PCR is on the pid of its MPEG audio stream, where no PCR
+ * is ever sent, so tsdemux waits for one before pushing timestamped data.
+ * Each PES fills one TS packet, PES number first_pes to first_pes + n_pes */
+static GstBuffer *
+make_no_pcr_stream (guint first_pes, guint n_pes)
+{
+  static const guint8 pat[] = { 0x00, 0xb0, 0x0d, 0x00, 0x01, 0xc1, 0x00,
+    0x00, 0x00, 0x01, 0xe0 | (NO_PCR_PMT_PID >> 8), NO_PCR_PMT_PID & 0xff
+  };
+  static const guint8 pmt[] = { 0x02, 0xb0, 0x12, 0x00, 0x01, 0xc1, 0x00,
+    0x00, 0xe0 | (NO_PCR_PID >> 8), NO_PCR_PID & 0xff, 0xf0, 0x00, 0x03,
+    0xe0 | (NO_PCR_PID >> 8), NO_PCR_PID & 0xff, 0xf0, 0x00
+  };
+  guint8 *data, *packet;
+  guint i;
+
+  data = g_malloc ((2 + n_pes) * PACKETSIZE);
+  write_psi_packet (data, 0, pat, sizeof pat);
+  write_psi_packet (data + PACKETSIZE, NO_PCR_PMT_PID, pmt, sizeof pmt);
+
+  packet = data + 2 * PACKETSIZE;
+  for (i = first_pes; i < first_pes + n_pes; i++) {
+    guint64 pts = 90000 + i * NO_PCR_PES_DURATION;
+
+    memset (packet, 0, PACKETSIZE);
+    packet[0] = 0x47;
+    packet[1] = 0x40 | (NO_PCR_PID >> 8);
+    packet[2] = NO_PCR_PID & 0xff;
+    packet[3] = 0x10 | (i & 0x0f);
+    /* PES header with a PTS, and a payload up to the end of the packet */
+    packet[4] = 0x00;
+    packet[5] = 0x00;
+    packet[6] = 0x01;
+    packet[7] = 0xc0;
+    GST_WRITE_UINT16_BE (packet + 8, PACKETSIZE - 10);
+    packet[10] = 0x80;
+    packet[11] = 0x80;
+    packet[12] = 0x05;
+    packet[13] = 0x21 | ((pts >> 29) & 0x0e);
+    GST_WRITE_UINT16_BE (packet + 14, ((pts >> 14) & 0xfffe) | 0x01);
+    GST_WRITE_UINT16_BE (packet + 16, ((pts << 1) & 0xfffe) | 0x01);
+    packet += PACKETSIZE;
+  }
+
+  return gst_buffer_new_wrapped (data, (2 + n_pes) * PACKETSIZE);
+}
+
+static GstHarness *
+setup_no_pcr_harness (gint latency_mode)
+{
+  GstHarness *h = gst_harness_new_with_padnames ("tsdemux", "sink", NULL);
+  GstCaps *caps;
+  GstSegment segment;
+
+  gst_harness_set (h, "tsdemux", "latency-mode", latency_mode, NULL);
+
+  caps = gst_caps_from_string ("video/mpegts,systemstream=true");
+  gst_harness_push_event (h, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_harness_push_event (h, gst_event_new_segment (&segment));
+
+  gst_harness_set_sink_caps_str (h, "audio/mpeg,mpegversion=1");
+  g_signal_connect (h->element, "pad-added",
+      G_CALLBACK (tsdemux_video_pad_added), h);
+
+  return h;
+}
+
+GST_START_TEST (test_tsdemux_pending_threshold)
+{
+  GstHarness *h;
+  guint i, n;
+
+  /* By default, data is held back for as long as no PCR shows up */
+  h = setup_no_pcr_harness (0);
+  fail_unless (gst_harness_push (h, make_no_pcr_stream (0, 10)) ==
+      GST_FLOW_OK);
+  fail_unless (gst_harness_push (h, make_no_pcr_stream (10, 20)) ==
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_received (h), 0);
+  gst_harness_teardown (h);
+
+  /* In low latency mode, 100ms at most are waited for, then timestamps
+   * start from the first PTS, the input having none */
+  h = setup_no_pcr_harness (1);
+  fail_unless (gst_harness_push (h, make_no_pcr_stream (0, 4)) ==
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_received (h), 0);
+  fail_unless (gst_harness_push (h, make_no_pcr_stream (4, 6)) ==
+      GST_FLOW_OK);
+  n = gst_harness_buffers_received (h);
+  fail_unless (n >= 8);
+
+  for (i = 0; i < n; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+        gst_util_uint64_scale (i * NO_PCR_PES_DURATION, GST_SECOND, 90000));
+    gst_buffer_unref (buf);
+  }
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static Suite *
 mpegtsdemux_suite (void)
 {
@@ -389,11 +942,18 @@ mpegtsdemux_suite (void)
   tcase_skip_broken_test (tc, test_tsparse_align_auto);
   tcase_add_test (tc, test_tsparse_align_fuse);
   tcase_add_test (tc, test_tsparse_align_split);
+  tcase_add_test (tc, test_tsparse_align_split_zero_copy);
   tcase_add_test (tc, test_tsparse_padding);
 
   tc = tcase_create ("tsdemux");
   suite_add_tcase (s, tc);
   tcase_add_test (tc, test_tsdemux_simple);
+  tcase_add_test (tc, test_tsdemux_unaligned_input);
+  tcase_add_test (tc, test_tsdemux_latency_mode);
+  tcase_add_test (tc, test_tsdemux_keyframe_index);
+  tcase_add_test (tc, test_tsdemux_keyframe_index_sei);
+  tcase_add_test (tc, test_tsdemux_index_seek);
+  tcase_add_test (tc, test_tsdemux_pending_threshold);
 
   return s;
 }
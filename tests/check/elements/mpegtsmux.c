@@ -557,6 +557,51 @@ GST_START_TEST (test_align)
 
 GST_END_TEST;
 
+#define UNALIGNED_N_BUFFERS 20
+#define UNALIGNED_BUFFER_SIZE 20000
+
+static void
+test_unaligned_check_output (GList * bufs)
+{
+  guint n_packets = 0, n_keyframes = 0;
+
+  GST_LOG ("%u buffers", g_list_length (bufs));
+  while (bufs != NULL) {
+    GstBuffer *buf = bufs->data;
+    GstMapInfo map;
+
+    /* Without alignment, every packet is pushed in its own buffer */
+    fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+    fail_unless_equals_int (map.size, 188);
+    fail_unless_equals_int (map.data[0], 0x47);
+
+    /* and a keyframe flag is only ever on the start of a PES */
+    if (!GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      fail_unless (map.data[1] & 0x40);
+      n_keyframes++;
+    }
+    gst_buffer_unmap (buf, &map);
+
+    n_packets++;
+    bufs = bufs->next;
+  }
+
+  GST_LOG ("%u packets, %u keyframes", n_packets, n_keyframes);
+
+  fail_unless (n_packets >= UNALIGNED_N_BUFFERS * UNALIGNED_BUFFER_SIZE / 184);
+  fail_unless_equals_int (n_keyframes,
+      (UNALIGNED_N_BUFFERS + KEYFRAME_DISTANCE - 1) / KEYFRAME_DISTANCE);
+}
+
+GST_START_TEST (test_unaligned_output)
+{
+  check_tsmux_pad (&video_src_template, VIDEO_CAPS_STRING, 0xE0, 0x1b,
+      "sink_%d", test_unaligned_check_output, UNALIGNED_N_BUFFERS,
+      UNALIGNED_BUFFER_SIZE, 0);
+}
+
+GST_END_TEST;
+
 static void
 test_keyframe_propagation_check_output (GList * bufs)
 {
@@ -598,6 +643,7 @@ mpegtsmux_suite (void)
   tcase_add_test (tc_chain, test_video);
   tcase_add_test (tc_chain, test_multiple_state_change);
   tcase_add_test (tc_chain, test_align);
+  tcase_add_test (tc_chain, test_unaligned_output);
   tcase_add_test (tc_chain, test_keyframe_flag_propagation);
   tcase_add_test (tc_chain, test_reappearing_pad_while_playing);
   tcase_add_test (tc_chain, test_reappearing_pad_while_stopped);
@@ -1,3 +1,4 @@
+#include <glib/gstdio.h>
 #include <gst/check/gstharness.h>
 #include <gst/check/gstcheck.h>
 
@@ -51,6 +52,124 @@ GST_START_TEST (netsim_stress_delayed)
 
 GST_END_TEST;
 
+GST_START_TEST (netsim_delay_queue_order)
+{
+  GstHarness *h = gst_harness_new_parse ("netsim delay-probability=1.0 "
+      "min-delay=1 max-delay=20 allow-reordering=false");
+  const guint num_buffers = 10000;
+  guint i;
+
+  gst_harness_set_src_caps_str (h, "mycaps");
+
+  for (i = 0; i < num_buffers; i++) {
+    GstBuffer *buf = gst_harness_create_buffer (h, 100);
+    GST_BUFFER_OFFSET (buf) = i;
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+
+  /* All the buffers come out of the delay queue, in order */
+  for (i = 0; i < num_buffers; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    fail_unless (buf != NULL);
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buf), i);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (netsim_gilbert_elliott)
+{
+  GstHarness *h = gst_harness_new_parse ("netsim loss-model=gilbert-elliott "
+      "ge-good-to-bad=0.05 ge-bad-to-good=0.25 ge-good-loss=0.0 "
+      "ge-bad-loss=1.0 seed=42");
+  const guint num_buffers = 20000;
+  guint i, received, lost, bursts = 0;
+  guint64 expected = 0;
+  gdouble loss, burst_length;
+
+  gst_harness_set_src_caps_str (h, "mycaps");
+
+  for (i = 0; i < num_buffers; i++) {
+    GstBuffer *buf = gst_harness_create_buffer (h, 100);
+    GST_BUFFER_OFFSET (buf) = i;
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+
+  received = gst_harness_buffers_received (h);
+  for (i = 0; i < received; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    if (GST_BUFFER_OFFSET (buf) != expected)
+      bursts++;
+    expected = GST_BUFFER_OFFSET (buf) + 1;
+    gst_buffer_unref (buf);
+  }
+  if (expected != num_buffers)
+    bursts++;
+
+  /* Stationary loss is p / (p + r) = 1/6, mean burst length is 1 / r = 4 */
+  lost = num_buffers - received;
+  loss = (gdouble) lost / num_buffers;
+  burst_length = (gdouble) lost / bursts;
+  GST_INFO ("loss %f, mean burst length %f", loss, burst_length);
+  fail_unless (loss > 0.13 && loss < 0.20);
+  fail_unless (burst_length > 3.0 && burst_length < 5.0);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (netsim_trace)
+{
+  const gchar *trace = "delay_ms,lost\n"
+      "# recorded on a lossy link\n" "10,0\n" ",1\n" "0.5,0\n" "-1\n" "5,0\n";
+  const guint64 expected[] = { 0, 2, 4, 5, 7, 9 };
+  GstHarness *h;
+  gchar *location, *launch;
+  gint fd;
+  gint64 start;
+  guint i;
+
+  fd = g_file_open_tmp ("netsim-trace-XXXXXX.csv", &location, NULL);
+  fail_unless (fd != -1);
+  g_close (fd, NULL);
+  fail_unless (g_file_set_contents (location, trace, -1, NULL));
+
+  launch = g_strdup_printf ("netsim trace-location=\"%s\" "
+      "allow-reordering=false", location);
+  h = gst_harness_new_parse (launch);
+  g_free (launch);
+  gst_harness_set_src_caps_str (h, "mycaps");
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < 10; i++) {
+    GstBuffer *buf = gst_harness_create_buffer (h, 100);
+    GST_BUFFER_OFFSET (buf) = i;
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+
+  /* The trace is replayed twice, lost packets are dropped and the delay of
+   * the first one holds back the others */
+  for (i = 0; i < G_N_ELEMENTS (expected); i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    fail_unless (buf != NULL);
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buf), expected[i]);
+    gst_buffer_unref (buf);
+
+    if (i == 0)
+      fail_unless (g_get_monotonic_time () - start >= 10 * 1000);
+  }
+
+  gst_harness_teardown (h);
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
 static Suite *
 netsim_suite (void)
 {
@@ -60,6 +179,9 @@ netsim_suite (void)
   suite_add_tcase (s, (tc_chain = tcase_create ("general")));
   tcase_add_test (tc_chain, netsim_stress);
   tcase_add_test (tc_chain, netsim_stress_delayed);
+  tcase_add_test (tc_chain, netsim_delay_queue_order);
+  tcase_add_test (tc_chain, netsim_gilbert_elliott);
+  tcase_add_test (tc_chain, netsim_trace);
 
   return s;
 }
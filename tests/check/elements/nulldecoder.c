@@ -0,0 +1,485 @@
+/* GStreamer
+ *
+ * unit test for the pipelined mode of GstH264Decoder and GstH265Decoder,
+ * through nullh264dec and nullh265dec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include <gst/codecparsers/nalutils.h>
+
+#define FRAME_DURATION (GST_SECOND / 30)
+#define SLICES_PER_FRAME 2
+#define H264_GOP_SIZE 9
+#define H265_GOP_SIZE 8
+#define N_GOPS 3
+
+/* I0 P3 B1 B2 P6 B4 B5 P8 B7, the B frames aren't references */
+static const guint h264_gop_order[H264_GOP_SIZE] = { 0, 3, 1, 2, 6, 4, 5, 8,
+  7
+};
+
+static void
+put_se (NalWriter * nw, gint32 value)
+{
+  nal_writer_put_ue (nw, value > 0 ? 2 * value - 1 : -2 * value);
+}
+
+static void
+append_nal (GByteArray * chunk, NalWriter * nw)
+{
+  GstMemory *mem;
+  GstMapInfo map;
+
+  nal_writer_do_rbsp_trailing_bits (nw);
+  mem = nal_writer_reset_and_get_memory (nw);
+  gst_memory_map (mem, &map, GST_MAP_READ);
+  g_byte_array_append (chunk, map.data, map.size);
+  gst_memory_unmap (mem, &map);
+  gst_memory_unref (mem);
+}
+
+static GstBuffer *
+chunk_to_buffer (GByteArray * chunk, guint frame, guint display)
+{
+  GstBuffer *buf;
+  gsize size = chunk->len;
+
+  buf = gst_buffer_new_wrapped (g_byte_array_free (chunk, FALSE), size);
+  GST_BUFFER_DTS (buf) = frame * FRAME_DURATION;
+  GST_BUFFER_PTS (buf) = display * FRAME_DURATION;
+  GST_BUFFER_DURATION (buf) = FRAME_DURATION;
+
+  return buf;
+}
+
+/* Main profile with CAVLC and POC type 0, in GOPs of H264_GOP_SIZE frames
+ * with B frames. The parameter sets are repeated with every IDR */
+static GstBuffer *
+create_h264_frame (guint frame, guint width, guint height)
+{
+  GByteArray *chunk = g_byte_array_new ();
+  guint mb_width = width / 16, mb_height = height / 16;
+  guint n_mbs = mb_width * mb_height;
+  guint gop = frame / H264_GOP_SIZE;
+  guint display = h264_gop_order[frame % H264_GOP_SIZE];
+  gboolean idr = display == 0;
+  gboolean b_frame = display % 3 != 0 && display != 8;
+  guint frame_num;
+  NalWriter nw;
+  guint i;
+
+  /* one more than the last reference frame decoded in the GOP */
+  if (frame % H264_GOP_SIZE == 0)
+    frame_num = 0;
+  else
+    frame_num = (frame % H264_GOP_SIZE + 4) / 3;
+
+  if (idr) {
+    /* SPS */
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, 0x67, 8);
+    nal_writer_put_bits_uint8 (&nw, GST_H264_PROFILE_MAIN, 8);
+    nal_writer_put_bits_uint8 (&nw, 0, 8);
+    nal_writer_put_bits_uint8 (&nw, 30, 8);
+    nal_writer_put_ue (&nw, 0);
+    /* log2_max_frame_num_minus4 */
+    nal_writer_put_ue (&nw, 0);
+    /* pic_order_cnt_type, log2_max_pic_order_cnt_lsb_minus4 */
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 4);
+    /* max_num_ref_frames */
+    nal_writer_put_ue (&nw, 2);
+    nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, mb_width - 1);
+    nal_writer_put_ue (&nw, mb_height - 1);
+    /* frame_mbs_only_flag, direct_8x8_inference_flag */
+    nal_writer_put_bits_uint8 (&nw, 3, 2);
+    /* frame_cropping_flag, vui_parameters_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+
+    /* PPS */
+    nal_writer_init (&nw, 4, FALSE);
+    nal_writer_put_bits_uint8 (&nw, 0x68, 8);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    /* deblocking_filter_control_present_flag */
+    nal_writer_put_bits_uint8 (&nw, 4, 3);
+    append_nal (chunk, &nw);
+  }
+
+  for (i = 0; i < SLICES_PER_FRAME; i++) {
+    nal_writer_init (&nw, 4, FALSE);
+    if (idr)
+      nal_writer_put_bits_uint8 (&nw, 0x65, 8);
+    else if (b_frame)
+      nal_writer_put_bits_uint8 (&nw, 0x01, 8);
+    else
+      nal_writer_put_bits_uint8 (&nw, 0x61, 8);
+    nal_writer_put_ue (&nw, i * n_mbs / SLICES_PER_FRAME);
+    nal_writer_put_ue (&nw, idr ? 7 : b_frame ? 6 : 5);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, frame_num, 4);
+    if (idr)
+      nal_writer_put_ue (&nw, gop & 1);
+    /* pic_order_cnt_lsb */
+    nal_writer_put_bits_uint8 (&nw, display * 2, 8);
+    if (b_frame) {
+      /* direct_spatial_mv_pred_flag, num_ref_idx_active_override_flag,
+       * ref_pic_list_modification_flag_l0 and l1 */
+      nal_writer_put_bits_uint8 (&nw, 8, 4);
+    } else if (!idr) {
+      /* num_ref_idx_active_override_flag,
+       * ref_pic_list_modification_flag_l0,
+       * adaptive_ref_pic_marking_mode_flag */
+      nal_writer_put_bits_uint8 (&nw, 0, 3);
+    } else {
+      /* no_output_of_prior_pics_flag, long_term_reference_flag */
+      nal_writer_put_bits_uint8 (&nw, 0, 2);
+    }
+    /* slice_qp_delta, disable_deblocking_filter_idc */
+    put_se (&nw, 0);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_bits_uint32 (&nw, 0x5a5a5a5a, 32);
+    append_nal (chunk, &nw);
+  }
+
+  return chunk_to_buffer (chunk, frame, gop * H264_GOP_SIZE + display);
+}
+
+static void
+put_h265_profile_tier_level (NalWriter * nw)
+{
+  nal_writer_put_bits_uint8 (nw, GST_H265_PROFILE_IDC_MAIN, 8);
+  nal_writer_put_bits_uint32 (nw, 0x60000000, 32);
+  nal_writer_put_bits_uint8 (nw, 9, 4);
+  nal_writer_put_bits_uint32 (nw, 0, 32);
+  nal_writer_put_bits_uint16 (nw, 0, 12);
+  nal_writer_put_bits_uint8 (nw, 93, 8);
+}
+
+static void
+put_h265_nal_header (NalWriter * nw, GstH265NalUnitType type)
+{
+  nal_writer_put_bits_uint8 (nw, type << 1, 8);
+  nal_writer_put_bits_uint8 (nw, 1, 8);
+}
+
+/* Main profile with 64x64 CTBs, in GOPs of H265_GOP_SIZE frames, each of
+ * them referencing the previous one. The parameter sets are repeated with
+ * every IDR */
+static GstBuffer *
+create_h265_frame (guint frame, guint width, guint height)
+{
+  GByteArray *chunk = g_byte_array_new ();
+  guint n_ctbs = ((width + 63) / 64) * ((height + 63) / 64);
+  guint poc = frame % H265_GOP_SIZE;
+  gboolean idr = poc == 0;
+  NalWriter nw;
+  guint i;
+
+  if (idr) {
+    /* VPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_VPS);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    nal_writer_put_bits_uint8 (&nw, 3, 2);
+    nal_writer_put_bits_uint8 (&nw, 0, 6);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_bits_uint16 (&nw, 0xffff, 16);
+    put_h265_profile_tier_level (&nw);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 6);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+
+    /* SPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_SPS);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    put_h265_profile_tier_level (&nw);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, width);
+    nal_writer_put_ue (&nw, height);
+    nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    /* log2_max_pic_order_cnt_lsb_minus4 */
+    nal_writer_put_ue (&nw, 4);
+    /* no reordering */
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 3);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 3);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 4);
+    /* one short term reference picture set, with the previous picture */
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 1);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 1, 1);
+    nal_writer_put_bits_uint8 (&nw, 0, 5);
+    append_nal (chunk, &nw);
+
+    /* PPS */
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, GST_H265_NAL_PPS);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 7);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_ue (&nw, 0);
+    put_se (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 3);
+    put_se (&nw, 0);
+    put_se (&nw, 0);
+    nal_writer_put_bits_uint16 (&nw, 0, 10);
+    nal_writer_put_ue (&nw, 0);
+    nal_writer_put_bits_uint8 (&nw, 0, 2);
+    append_nal (chunk, &nw);
+  }
+
+  for (i = 0; i < SLICES_PER_FRAME; i++) {
+    nal_writer_init (&nw, 4, FALSE);
+    put_h265_nal_header (&nw, idr ? GST_H265_NAL_SLICE_IDR_W_RADL :
+        GST_H265_NAL_SLICE_TRAIL_R);
+    nal_writer_put_bits_uint8 (&nw, i == 0, 1);
+    if (idr)
+      nal_writer_put_bits_uint8 (&nw, 0, 1);
+    nal_writer_put_ue (&nw, 0);
+    if (i > 0)
+      nal_writer_put_bits_uint32 (&nw, i * n_ctbs / SLICES_PER_FRAME,
+          g_bit_storage (n_ctbs - 1));
+    nal_writer_put_ue (&nw, idr ? GST_H265_I_SLICE : GST_H265_P_SLICE);
+    if (!idr) {
+      nal_writer_put_bits_uint8 (&nw, poc, 8);
+      /* short_term_ref_pic_set_sps_flag,
+       * num_ref_idx_active_override_flag */
+      nal_writer_put_bits_uint8 (&nw, 2, 2);
+      nal_writer_put_ue (&nw, 0);
+    }
+    put_se (&nw, 0);
+    nal_writer_do_rbsp_trailing_bits (&nw);
+    nal_writer_put_bits_uint32 (&nw, 0x5a5a5a5a, 32);
+    append_nal (chunk, &nw);
+  }
+
+  return chunk_to_buffer (chunk, frame, frame);
+}
+
+typedef GstBuffer *(*CreateFrameFunc) (guint frame, guint width,
+    guint height);
+
+/* Decodes N_GOPS GOPs, the last one at twice the width, and returns the
+ * PTS of the output buffers */
+static GArray *
+decode_stream (const gchar * launch, const gchar * caps,
+    CreateFrameFunc create_frame, guint gop_size, guint width, guint height)
+{
+  GArray *pts = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+  GstHarness *h;
+  GstCaps *out_caps;
+  GstVideoInfo info;
+  GstBuffer *buf;
+  guint i;
+
+  h = gst_harness_new_parse (launch);
+  gst_harness_set_src_caps_str (h, caps);
+
+  for (i = 0; i < N_GOPS * gop_size; i++) {
+    guint w = i / gop_size == N_GOPS - 1 ? width * 2 : width;
+
+    fail_unless_equals_int (gst_harness_push (h, create_frame (i, w, height)),
+        GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the pictures the submission thread still holds come before the EOS */
+  while (TRUE) {
+    fail_unless (gst_harness_pull_until_eos (h, &buf));
+    if (!buf)
+      break;
+    g_array_append_val (pts, GST_BUFFER_PTS (buf));
+    gst_buffer_unref (buf);
+  }
+
+  out_caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (out_caps != NULL);
+  fail_unless (gst_video_info_from_caps (&info, out_caps));
+  fail_unless_equals_int (GST_VIDEO_INFO_WIDTH (&info), width * 2);
+  fail_unless_equals_int (GST_VIDEO_INFO_HEIGHT (&info), height);
+  gst_caps_unref (out_caps);
+
+  gst_harness_teardown (h);
+
+  return pts;
+}
+
+static void
+check_pipelined (const gchar * element, const gchar * caps,
+    CreateFrameFunc create_frame, guint gop_size, guint width, guint height)
+{
+  GArray *reference = NULL;
+  guint depths[] = { 0, 1, 2, 4 };
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (depths); i++) {
+    gchar *launch = g_strdup_printf ("%s pipeline-depth=%u submit-delay=%u",
+        element, depths[i], depths[i] ? 500 : 0);
+    GArray *pts = decode_stream (launch, caps, create_frame, gop_size,
+        width, height);
+
+    /* every frame, in presentation order */
+    fail_unless_equals_int (pts->len, N_GOPS * gop_size);
+    for (j = 0; j < pts->len; j++) {
+      fail_unless_equals_uint64 (g_array_index (pts, GstClockTime, j),
+          j * FRAME_DURATION);
+    }
+
+    if (reference) {
+      fail_unless (memcmp (reference->data, pts->data,
+              pts->len * sizeof (GstClockTime)) == 0);
+      g_array_unref (pts);
+    } else {
+      reference = pts;
+    }
+
+    g_free (launch);
+  }
+
+  g_array_unref (reference);
+}
+
+GST_START_TEST (test_nullh264dec_pipelined)
+{
+  check_pipelined ("nullh264dec",
+      "video/x-h264, stream-format=byte-stream, alignment=au",
+      create_h264_frame, H264_GOP_SIZE, 64, 64);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_nullh265dec_pipelined)
+{
+  check_pipelined ("nullh265dec",
+      "video/x-h265, stream-format=byte-stream, alignment=au",
+      create_h265_frame, H265_GOP_SIZE, 128, 64);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_nullh264dec_pipelined_flush)
+{
+  GstHarness *h;
+  GstSegment segment;
+  GstClockTime last_pts = GST_CLOCK_TIME_NONE;
+  GstBuffer *buf;
+  guint i, n_after_flush = 0;
+
+  h = gst_harness_new_parse ("nullh264dec pipeline-depth=4 "
+      "submit-delay=2000");
+  gst_harness_set_src_caps_str (h,
+      "video/x-h264, stream-format=byte-stream, alignment=au");
+
+  /* Flush while frames are still queued for the submission thread */
+  for (i = 0; i < H264_GOP_SIZE; i++) {
+    fail_unless_equals_int (gst_harness_push (h,
+            create_h264_frame (i, 64, 64)), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  while ((buf = gst_harness_try_pull (h)))
+    gst_buffer_unref (buf);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  for (i = H264_GOP_SIZE; i < 2 * H264_GOP_SIZE; i++) {
+    fail_unless_equals_int (gst_harness_push (h,
+            create_h264_frame (i, 64, 64)), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while (TRUE) {
+    fail_unless (gst_harness_pull_until_eos (h, &buf));
+    if (!buf)
+      break;
+    if (GST_CLOCK_TIME_IS_VALID (last_pts))
+      fail_unless (GST_BUFFER_PTS (buf) > last_pts);
+    last_pts = GST_BUFFER_PTS (buf);
+    n_after_flush++;
+    gst_buffer_unref (buf);
+  }
+
+  fail_unless_equals_int (n_after_flush, H264_GOP_SIZE);
+  fail_unless_equals_uint64 (last_pts, (2 * H264_GOP_SIZE - 1) *
+      FRAME_DURATION);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+nulldecoder_suite (void)
+{
+  Suite *s = suite_create ("nulldecoder");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (s, tc);
+  tcase_add_test (tc, test_nullh264dec_pipelined);
+  tcase_add_test (tc, test_nullh265dec_pipelined);
+  tcase_add_test (tc, test_nullh264dec_pipelined_flush);
+
+  return s;
+}
+
+GST_CHECK_MAIN (nulldecoder);
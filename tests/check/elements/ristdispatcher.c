@@ -0,0 +1,393 @@
+/* GStreamer
+ *
+ * unit test for ristdispatcher
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/check.h>
+#include <gst/rtp/rtp.h>
+
+#define N_LINKS 2
+#define PACKETS_PER_ROUND 500
+#define N_ROUNDS 20
+/* Keeps the simulated losses the same from one run to the next */
+#define NETSIM_SEED 42
+
+/* One bonded link, simulated by a netsim whose output is collected the
+ * way the receiver would */
+typedef struct
+{
+  GstHarness *h;
+  GstPad *pad;
+
+  gboolean have_seqnum;
+  guint32 first_seqnum;
+  guint32 highest_seqnum;
+  guint received;
+} Link;
+
+static GstBuffer *
+create_rtp_buffer (guint16 seqnum, gboolean delta_unit)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buf;
+
+  buf = gst_rtp_buffer_new_allocate (188 * 7, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_ssrc (&rtp, 0x12345678);
+  gst_rtp_buffer_set_seq (&rtp, seqnum);
+  gst_rtp_buffer_set_payload_type (&rtp, 33);
+  gst_rtp_buffer_unmap (&rtp);
+
+  if (delta_unit)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buf;
+}
+
+static GstHarness *
+setup_links (const gchar * dispatcher, Link * links,
+    const gfloat * drop_probability)
+{
+  GstHarness *h;
+  gint i;
+
+  h = gst_harness_new_with_padnames (dispatcher, "sink", NULL);
+
+  for (i = 0; i < N_LINKS; i++) {
+    gchar *name = g_strdup_printf ("src_%d", i);
+    GstPad *sinkpad;
+
+    memset (&links[i], 0, sizeof (Link));
+    links[i].h = gst_harness_new_with_padnames ("netsim", NULL, "src");
+    g_object_set (links[i].h->element, "drop-probability",
+        drop_probability[i], "seed", NETSIM_SEED + i, NULL);
+
+    links[i].pad = gst_element_request_pad_simple (h->element, name);
+    fail_unless (links[i].pad != NULL);
+    sinkpad = gst_element_get_static_pad (links[i].h->element, "sink");
+    fail_unless_equals_int (gst_pad_link (links[i].pad, sinkpad),
+        GST_PAD_LINK_OK);
+    gst_object_unref (sinkpad);
+    g_free (name);
+  }
+
+  gst_harness_set_src_caps_str (h, "application/x-rtp, payload=33, "
+      "media=video, clock-rate=90000, encoding-name=MP2T");
+
+  return h;
+}
+
+static void
+teardown_links (GstHarness * h, Link * links)
+{
+  gint i;
+
+  for (i = 0; i < N_LINKS; i++) {
+    gst_element_release_request_pad (h->element, links[i].pad);
+    gst_object_unref (links[i].pad);
+    gst_harness_teardown (links[i].h);
+  }
+  gst_harness_teardown (h);
+}
+
+/* Collects what went through the links, returns how many packets were
+ * received for the first time */
+static guint
+receive_links (Link * links, guint8 * seen)
+{
+  guint unique = 0;
+  gint i;
+
+  for (i = 0; i < N_LINKS; i++) {
+    GstBuffer *buf;
+
+    while ((buf = gst_harness_try_pull (links[i].h))) {
+      GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+      guint16 seqnum;
+
+      fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp));
+      seqnum = gst_rtp_buffer_get_seq (&rtp);
+      gst_rtp_buffer_unmap (&rtp);
+      gst_buffer_unref (buf);
+
+      if (!links[i].have_seqnum) {
+        links[i].first_seqnum = seqnum;
+        links[i].have_seqnum = TRUE;
+      }
+      links[i].highest_seqnum = MAX (links[i].highest_seqnum, seqnum);
+      links[i].received++;
+
+      if (!seen[seqnum]) {
+        seen[seqnum] = 1;
+        unique++;
+      }
+    }
+  }
+
+  return unique;
+}
+
+/* Sends what a receiver report block of each link would contain */
+static void
+report_links (GstHarness * h, Link * links, const GstClockTime * rtt)
+{
+  gint i;
+
+  for (i = 0; i < N_LINKS; i++) {
+    gint lost;
+
+    if (!links[i].have_seqnum)
+      continue;
+
+    lost = (links[i].highest_seqnum - links[i].first_seqnum + 1) -
+        links[i].received;
+    g_signal_emit_by_name (h->element, "report-link", links[i].pad,
+        (guint64) rtt[i], links[i].highest_seqnum, lost);
+  }
+}
+
+/* Pushes packets over two links, one of which drops 40% of them, and
+ * returns the share of packets received once the dispatcher settled */
+static gdouble
+measure_goodput (const gchar * dispatcher, gdouble * weights)
+{
+  const gfloat drop_probability[N_LINKS] = { 0.0, 0.4 };
+  const GstClockTime rtt[N_LINKS] = { 20 * GST_MSECOND, 60 * GST_MSECOND };
+  Link links[N_LINKS];
+  GstHarness *h;
+  guint8 *seen;
+  guint16 seqnum = 0;
+  guint sent = 0, unique = 0;
+  gboolean can_report;
+  gint round, i;
+
+  h = setup_links (dispatcher, links, drop_probability);
+  can_report = g_signal_lookup ("report-link",
+      G_OBJECT_TYPE (h->element)) != 0;
+  seen = g_new0 (guint8, 65536);
+
+  for (round = 0; round < N_ROUNDS; round++) {
+    guint round_unique;
+
+    for (i = 0; i < PACKETS_PER_ROUND; i++)
+      fail_unless_equals_int (gst_harness_push (h,
+              create_rtp_buffer (seqnum++, TRUE)), GST_FLOW_OK);
+
+    round_unique = receive_links (links, seen);
+    if (round >= N_ROUNDS / 2) {
+      sent += PACKETS_PER_ROUND;
+      unique += round_unique;
+    }
+
+    if (can_report)
+      report_links (h, links, rtt);
+  }
+
+  if (weights) {
+    for (i = 0; i < N_LINKS; i++)
+      g_object_get (links[i].pad, "weight", &weights[i], NULL);
+  }
+
+  g_free (seen);
+  teardown_links (h, links);
+
+  return (gdouble) unique / sent;
+}
+
+GST_START_TEST (test_weighted_goodput)
+{
+  gdouble rr_goodput, weighted_goodput;
+  gdouble weights[N_LINKS];
+
+  rr_goodput = measure_goodput ("roundrobin", NULL);
+  weighted_goodput = measure_goodput ("ristdispatcher", weights);
+
+  GST_INFO ("goodput: round-robin %f, weighted %f (weights %f / %f)",
+      rr_goodput, weighted_goodput, weights[0], weights[1]);
+
+  /* Round robin sends half the packets over the lossy link */
+  fail_unless (rr_goodput < 0.9);
+  /* The weighted dispatcher moves almost everything to the clean link */
+  fail_unless (weighted_goodput > 0.95);
+  fail_unless (weights[0] > 10 * weights[1]);
+  /* but keeps probing the lossy one */
+  fail_unless (weights[1] > 0.0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_rtt_weighting)
+{
+  const gfloat drop_probability[N_LINKS] = { 0.0, 0.0 };
+  const GstClockTime rtt[N_LINKS] = { 20 * GST_MSECOND, 40 * GST_MSECOND };
+  Link links[N_LINKS];
+  GstHarness *h;
+  guint8 *seen;
+  guint16 seqnum = 0;
+  gdouble weights[N_LINKS];
+  gint round, i;
+
+  h = setup_links ("ristdispatcher", links, drop_probability);
+  seen = g_new0 (guint8, 65536);
+
+  for (round = 0; round < N_ROUNDS; round++) {
+    for (i = 0; i < PACKETS_PER_ROUND; i++)
+      fail_unless_equals_int (gst_harness_push (h,
+              create_rtp_buffer (seqnum++, TRUE)), GST_FLOW_OK);
+    fail_unless_equals_int (receive_links (links, seen), PACKETS_PER_ROUND);
+    report_links (h, links, rtt);
+  }
+
+  for (i = 0; i < N_LINKS; i++)
+    g_object_get (links[i].pad, "weight", &weights[i], NULL);
+
+  /* Both links are clean, the one with the shorter round trip gets more */
+  fail_unless (weights[0] > weights[1]);
+  fail_unless (weights[1] > 0.1);
+
+  g_free (seen);
+  teardown_links (h, links);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_duplicate_keyframes)
+{
+  const gfloat drop_probability[N_LINKS] = { 0.0, 0.0 };
+  Link links[N_LINKS];
+  GstHarness *h;
+  guint8 *seen;
+
+  h = setup_links ("ristdispatcher", links, drop_probability);
+  seen = g_new0 (guint8, 65536);
+
+  /* Nothing was marked as delta unit yet, so this isn't known to be a
+   * keyframe */
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_buffer (0, FALSE)),
+      GST_FLOW_OK);
+  receive_links (links, seen);
+  fail_unless_equals_int (links[0].received + links[1].received, 1);
+
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_buffer (1, TRUE)),
+      GST_FLOW_OK);
+  receive_links (links, seen);
+  fail_unless_equals_int (links[0].received + links[1].received, 2);
+
+  /* Keyframe packets go over every link */
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_buffer (2, FALSE)),
+      GST_FLOW_OK);
+  receive_links (links, seen);
+  fail_unless_equals_int (links[0].received + links[1].received, 4);
+  fail_unless_equals_int (links[0].highest_seqnum, 2);
+  fail_unless_equals_int (links[1].highest_seqnum, 2);
+
+  g_object_set (h->element, "duplicate-keyframes", FALSE, NULL);
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_buffer (3, FALSE)),
+      GST_FLOW_OK);
+  receive_links (links, seen);
+  fail_unless_equals_int (links[0].received + links[1].received, 5);
+
+  g_free (seen);
+  teardown_links (h, links);
+}
+
+GST_END_TEST;
+
+/* Two links without random loss, but with different available bitrates,
+ * neither of which can carry the whole stream */
+GST_START_TEST (test_bitrate_weighting)
+{
+  const gfloat drop_probability[N_LINKS] = { 0.0, 0.0 };
+  const gint max_kbps[N_LINKS] = { 8000, 4000 };
+  const GstClockTime rtt[N_LINKS] = { 20 * GST_MSECOND, 20 * GST_MSECOND };
+  /* 100 packets of 1328 bytes every 100ms, about 10.6 Mb/s */
+  const GstClockTime packet_duration = GST_MSECOND;
+  Link links[N_LINKS];
+  GstHarness *h;
+  GstClockTime now = 0;
+  guint8 *seen;
+  guint16 seqnum = 0;
+  gdouble weights[N_LINKS];
+  guint64 bitrate;
+  guint sent = 0, unique = 0;
+  gint round, i, j;
+
+  h = setup_links ("ristdispatcher", links, drop_probability);
+  for (i = 0; i < N_LINKS; i++)
+    g_object_set (links[i].h->element, "max-kbps", max_kbps[i],
+        "max-bucket-size", 16, NULL);
+  seen = g_new0 (guint8, 65536);
+
+  for (round = 0; round < N_ROUNDS; round++) {
+    guint round_unique;
+
+    for (i = 0; i < 100; i++) {
+      now += packet_duration;
+      gst_harness_set_time (h, now);
+      for (j = 0; j < N_LINKS; j++)
+        gst_harness_set_time (links[j].h, now);
+
+      fail_unless_equals_int (gst_harness_push (h,
+              create_rtp_buffer (seqnum++, TRUE)), GST_FLOW_OK);
+    }
+
+    round_unique = receive_links (links, seen);
+    if (round >= N_ROUNDS / 2) {
+      sent += 100;
+      unique += round_unique;
+    }
+
+    report_links (h, links, rtt);
+  }
+
+  for (i = 0; i < N_LINKS; i++)
+    g_object_get (links[i].pad, "weight", &weights[i], NULL);
+  g_object_get (links[1].pad, "bitrate", &bitrate, NULL);
+
+  GST_INFO ("goodput %f (weights %f / %f), bitrate of the second link %"
+      G_GUINT64_FORMAT, (gdouble) unique / sent, weights[0], weights[1],
+      bitrate);
+
+  /* The links get a share in proportion to their available bitrate */
+  fail_unless (weights[0] > weights[1]);
+  fail_unless (weights[1] > 0.2);
+  fail_unless (bitrate > 3000000 && bitrate < 5000000);
+  fail_unless ((gdouble) unique / sent > 0.9);
+
+  g_free (seen);
+  teardown_links (h, links);
+}
+
+GST_END_TEST;
+
+static Suite *
+ristdispatcher_suite (void)
+{
+  Suite *s = suite_create ("ristdispatcher");
+  TCase *tc_chain;
+
+  suite_add_tcase (s, (tc_chain = tcase_create ("general")));
+  tcase_add_test (tc_chain, test_weighted_goodput);
+  tcase_add_test (tc_chain, test_rtt_weighting);
+  tcase_add_test (tc_chain, test_bitrate_weighting);
+  tcase_add_test (tc_chain, test_duplicate_keyframes);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ristdispatcher)
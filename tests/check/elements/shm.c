@@ -169,6 +169,64 @@ GST_START_TEST (test_shm_alloc)
 
 GST_END_TEST;
 
+GST_START_TEST (test_shm_alloc_stats)
+{
+  GstSegment segment;
+  guint64 high_water_mark, first_peak;
+  gdouble fragmentation;
+  gint i;
+
+  gst_pad_push_event (srcpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  g_object_get (sink, "high-water-mark", &high_water_mark, NULL);
+  fail_unless_equals_uint64 (high_water_mark, 0);
+
+  /* Enough buffers of the same size to go through a slab. They are all held
+   * by the consumer, so they are all allocated at the same time */
+  for (i = 0; i < 10; i++)
+    fail_unless (gst_pad_push (srcpad,
+            gst_buffer_new_allocate (NULL, 1000, NULL)) == GST_FLOW_OK);
+
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < 10)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  /* Each copy is at most padded for the alignment */
+  g_object_get (sink, "high-water-mark", &first_peak,
+      "fragmentation", &fragmentation, NULL);
+  fail_unless (first_peak >= 10 * 1000);
+  fail_unless (first_peak <= 10 * 1100);
+  fail_unless (fragmentation >= 0.0 && fragmentation <= 1.0);
+
+  /* Releasing them doesn't lower the mark */
+  gst_check_drop_buffers ();
+  g_object_get (sink, "high-water-mark", &high_water_mark, NULL);
+  fail_unless_equals_uint64 (high_water_mark, first_peak);
+
+  /* A higher peak raises it, whether the first buffers were already acked
+   * or not */
+  for (i = 0; i < 20; i++)
+    fail_unless (gst_pad_push (srcpad,
+            gst_buffer_new_allocate (NULL, 1000, NULL)) == GST_FLOW_OK);
+
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < 20)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  g_object_get (sink, "high-water-mark", &high_water_mark, NULL);
+  fail_unless (high_water_mark >= 20 * 1000);
+  fail_unless (high_water_mark <= 30 * 1100);
+
+  gst_check_drop_buffers ();
+  teardown_shm ();
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_shm_live)
 {
   GstElement *producer, *consumer;
@@ -229,6 +287,88 @@ GST_START_TEST (test_shm_live)
 
 GST_END_TEST;
 
+GST_START_TEST (test_shm_ring)
+{
+  GstElement *producer, *consumers[2];
+  GstElement *src, *sink, *appsinks[2];
+  gchar *socket_path = NULL;
+  GstStateChangeReturn state_res;
+  guint ring_size;
+  guint64 ring_published;
+  gint i, j;
+
+  src = gst_element_factory_make ("fakesrc", NULL);
+  g_object_set (src, "sizetype", 2, "filltype", 2, NULL);
+
+  sink = gst_element_factory_make ("shmsink", NULL);
+  g_object_set (sink, "socket-path", "shm-unit-test", "wait-for-connection",
+      FALSE, "ring-size", 3, NULL);
+  g_object_get (sink, "ring-size", &ring_size, NULL);
+  fail_unless_equals_int (ring_size, 3);
+
+  producer = gst_pipeline_new ("producer-pipeline");
+  gst_bin_add_many (GST_BIN (producer), src, sink, NULL);
+  fail_unless (gst_element_link (src, sink));
+
+  state_res = gst_element_set_state (producer, GST_STATE_PLAYING);
+  fail_unless (state_res != GST_STATE_CHANGE_FAILURE);
+
+  g_object_get (sink, "socket-path", &socket_path, NULL);
+  fail_unless (socket_path != NULL);
+
+  for (i = 0; i < 2; i++) {
+    src = gst_element_factory_make ("shmsrc", NULL);
+    appsinks[i] = gst_element_factory_make ("appsink", NULL);
+    g_object_set (src, "is-live", TRUE, "socket-path", socket_path, NULL);
+    g_object_set (appsinks[i], "async", FALSE, "enable-last-sample", FALSE,
+        NULL);
+
+    consumers[i] = gst_pipeline_new (NULL);
+    gst_bin_add_many (GST_BIN (consumers[i]), src, appsinks[i], NULL);
+    fail_unless (gst_element_link (src, appsinks[i]));
+
+    state_res = gst_element_set_state (consumers[i], GST_STATE_PLAYING);
+    fail_unless (state_res != GST_STATE_CHANGE_FAILURE);
+  }
+
+  /* The ring only has 4 slots, so the producer has to wait for both
+   * consumers to release buffers to get this far */
+  for (j = 0; j < 20; j++) {
+    for (i = 0; i < 2; i++) {
+      GstSample *sample = NULL;
+      GstMapInfo map;
+      GstBuffer *buf;
+
+      g_signal_emit_by_name (appsinks[i], "pull-sample", &sample);
+      fail_unless (sample != NULL);
+      buf = gst_sample_get_buffer (sample);
+      fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+      fail_unless (map.size > 0);
+      fail_unless_equals_int (map.data[0], 0);
+      gst_buffer_unmap (buf, &map);
+      gst_sample_unref (sample);
+    }
+  }
+
+  /* Both consumers got these from the ring, not over the socket */
+  g_object_get (sink, "ring-published", &ring_published, NULL);
+  fail_unless (ring_published >= 20);
+
+  state_res = gst_element_set_state (producer, GST_STATE_NULL);
+  fail_unless (state_res != GST_STATE_CHANGE_FAILURE);
+
+  for (i = 0; i < 2; i++) {
+    state_res = gst_element_set_state (consumers[i], GST_STATE_NULL);
+    fail_unless (state_res != GST_STATE_CHANGE_FAILURE);
+    gst_object_unref (consumers[i]);
+  }
+  gst_object_unref (producer);
+
+  g_free (socket_path);
+}
+
+GST_END_TEST;
+
 static Suite *
 shm_suite (void)
 {
@@ -239,10 +379,12 @@ shm_suite (void)
   tcase_add_checked_fixture (tc, setup_shm, NULL);
   tcase_add_test (tc, test_shm_sysmem_alloc);
   tcase_add_test (tc, test_shm_alloc);
+  tcase_add_test (tc, test_shm_alloc_stats);
   suite_add_tcase (s, tc);
 
   tc = tcase_create ("shm2");
   tcase_add_test (tc, test_shm_live);
+  tcase_add_test (tc, test_shm_ring);
   suite_add_tcase (s, tc);
 
   return s;
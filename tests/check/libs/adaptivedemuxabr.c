@@ -0,0 +1,432 @@
+/* GStreamer
+ *
+ * unit test for the adaptivedemux ABR algorithms
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/adaptivedemux/gstadaptivedemuxabr.h>
+
+GST_DEBUG_CATEGORY (adaptivedemux_debug);
+
+#define FRAGMENT_DURATION (2 * GST_SECOND)
+#define REQUEST_LATENCY (40 * GST_MSECOND)
+#define CHUNK_SIZE (8 * 1024)
+#define MAX_BUFFER_LEVEL (12 * GST_SECOND)
+#define BITRATE_LIMIT 0.8f
+/* Playback interruption allowed when the bandwidth suddenly drops */
+#define STALL_TOLERANCE (2 * GST_SECOND)
+
+/* Throughput traces, in kbps for every 500ms */
+#define TRACE_INTERVAL (500 * GST_MSECOND)
+
+/* A CDN link delivering ~4.3 Mbps on average in bursts */
+static const guint trace_bursty[] = {
+  4219, 3427, 4958, 4479, 424, 10036, 586, 6951, 11785, 5501, 622, 6918,
+  467, 5959, 209, 3164, 3982, 5060, 3730, 5866, 782, 11340, 3502, 5196,
+  6615, 6329, 3064, 3438, 4480, 682, 251, 739, 4955, 3399, 4233, 3490,
+  13751, 5261, 776, 409, 5880, 10098, 3208, 9182, 796, 3156, 583, 745,
+  6449, 3653, 3014, 4172, 330, 3973, 5855, 325, 5399, 10287, 534, 11588,
+  3241, 635, 411, 4519, 6650, 4907, 5494, 6606, 4405, 462, 3685, 6687,
+  6797, 14594, 4991, 6881, 217, 566, 3470, 5342, 6619, 10682, 645, 12542,
+  9070, 5518, 11018, 10469, 736, 6244, 233, 364, 3313, 6640, 229, 662,
+  13942, 4130, 3606, 14822, 5951, 6083, 4725, 744, 10651, 676, 5530, 762,
+  264, 4241, 11882, 288, 4487, 596, 718, 12730, 672, 368, 14384, 5423,
+  5629, 10752, 6402, 5106, 640, 6860, 6837, 738, 782, 3247, 3438, 255,
+  282, 3194, 436, 3026, 4282, 3746, 5193, 5288, 376, 4988, 10539, 10018,
+  656, 560, 4348, 740, 4927, 4722, 680, 646, 358, 6308, 670, 12462,
+  6357, 6991, 415, 250, 5405, 6438, 3857, 519, 340, 4011, 3859, 4683,
+  325, 3125, 14021, 206, 3581, 3111, 485, 5917, 3279, 6571, 5510, 4768,
+  5117, 13860, 6807, 5439, 5355, 251, 3801, 4257, 622, 569, 217, 296,
+  4854, 3883, 609, 231, 329, 6463, 5187, 6406, 12372, 13485, 5359, 6576,
+  634, 355, 5666, 4610, 6189, 700, 621, 655, 14196, 5609, 652, 593,
+  201, 3958, 6755, 276, 3550, 14559, 10494, 470, 683, 10143, 3923, 6673,
+  6069, 722, 5179, 499, 5017, 353, 439, 4437, 554, 3203, 6436, 359,
+};
+
+/* Variant bitrates in bps, as subclasses would choose from */
+static const guint64 variants[] = {
+  350000, 800000, 1500000, 2500000, 4000000, 6000000
+};
+
+typedef struct
+{
+  const guint *trace;
+  guint trace_len;
+
+  GstClockTime now;
+  GstClockTime buffer_level;
+  gboolean started;
+
+  guint variant;
+  guint fragments;
+  guint switches;
+  guint64 bitrate_sum;
+  GstClockTime stalled;
+
+  /* fragment at which the variant was last lowered */
+  guint last_down_switch;
+} Simulation;
+
+/* Rate of the link at the current time, the trace is repeated when the
+ * simulation lasts longer than it */
+static guint64
+simulation_get_rate (Simulation * sim, GstClockTime * remaining)
+{
+  guint index = (sim->now / TRACE_INTERVAL) % sim->trace_len;
+
+  *remaining = TRACE_INTERVAL - sim->now % TRACE_INTERVAL;
+
+  return (guint64) sim->trace[index] * 1000;
+}
+
+static void
+simulation_play (Simulation * sim, GstClockTime elapsed)
+{
+  sim->now += elapsed;
+
+  if (!sim->started)
+    return;
+
+  if (sim->buffer_level >= elapsed) {
+    sim->buffer_level -= elapsed;
+  } else {
+    sim->stalled += elapsed - sim->buffer_level;
+    sim->buffer_level = 0;
+  }
+}
+
+/* Downloads one fragment chunk by chunk, returns how long it took */
+static GstClockTime
+simulation_download (Simulation * sim, GstAdaptiveDemuxAbr * abr,
+    guint64 size)
+{
+  GstClockTime start = sim->now;
+  GstClockTime chunk_start;
+
+  simulation_play (sim, REQUEST_LATENCY);
+  chunk_start = start;
+
+  while (size > 0) {
+    guint64 chunk = MIN (size, CHUNK_SIZE);
+    guint64 bits = chunk * 8;
+
+    /* the chunk may span several trace intervals */
+    while (bits > 0) {
+      GstClockTime remaining, needed;
+      guint64 rate = simulation_get_rate (sim, &remaining);
+
+      needed = gst_util_uint64_scale_ceil (bits, GST_SECOND, rate);
+      if (needed <= remaining) {
+        simulation_play (sim, needed);
+        bits = 0;
+      } else {
+        simulation_play (sim, remaining);
+        bits -= MIN (bits, gst_util_uint64_scale (remaining, rate,
+                GST_SECOND));
+      }
+    }
+
+    gst_adaptive_demux_abr_add_chunk (abr, chunk, sim->now - chunk_start);
+    chunk_start = sim->now;
+    size -= chunk;
+  }
+
+  return sim->now - start;
+}
+
+static guint
+select_variant (guint64 bitrate)
+{
+  guint i;
+
+  for (i = G_N_ELEMENTS (variants) - 1; i > 0; i--) {
+    if (variants[i] <= bitrate)
+      break;
+  }
+
+  return i;
+}
+
+/* Plays the trace for the given time, starting at the lowest variant. The
+ * download of the next fragment starts right away unless the buffer is
+ * full. */
+static void
+simulate (Simulation * sim, GstAdaptiveDemuxAbrAlgorithm algorithm,
+    const guint * trace, guint trace_len, GstClockTime duration)
+{
+  GstAdaptiveDemuxAbr *abr;
+
+  memset (sim, 0, sizeof (Simulation));
+  sim->trace = trace;
+  sim->trace_len = trace_len;
+
+  abr = gst_adaptive_demux_abr_new (algorithm);
+  fail_unless (abr != NULL);
+  fail_unless_equals_int (gst_adaptive_demux_abr_get_algorithm (abr),
+      algorithm);
+
+  while (sim->now < duration) {
+    GstAdaptiveDemuxAbrInput input;
+    GstClockTime download_time;
+    guint64 size, bitrate;
+    guint variant;
+
+    size = gst_util_uint64_scale (variants[sim->variant], FRAGMENT_DURATION,
+        8 * GST_SECOND);
+    download_time = simulation_download (sim, abr, size);
+    input.fragment_bitrate = gst_util_uint64_scale (size, 8 * GST_SECOND,
+        download_time);
+
+    sim->buffer_level += FRAGMENT_DURATION;
+    sim->started = TRUE;
+    sim->fragments++;
+    sim->bitrate_sum += variants[sim->variant];
+
+    input.fragment_duration = FRAGMENT_DURATION;
+    input.buffer_level = sim->buffer_level;
+    input.bitrate_limit = BITRATE_LIMIT;
+
+    bitrate = gst_adaptive_demux_abr_get_bitrate (abr, &input);
+    variant = select_variant (bitrate);
+    if (variant != sim->variant) {
+      GST_LOG ("%" GST_TIME_FORMAT ": switching from %" G_GUINT64_FORMAT
+          " to %" G_GUINT64_FORMAT " (buffer %" GST_TIME_FORMAT ")",
+          GST_TIME_ARGS (sim->now), variants[sim->variant], variants[variant],
+          GST_TIME_ARGS (sim->buffer_level));
+      if (variant < sim->variant)
+        sim->last_down_switch = sim->fragments;
+      sim->switches++;
+      sim->variant = variant;
+    }
+
+    if (sim->buffer_level > MAX_BUFFER_LEVEL)
+      simulation_play (sim, sim->buffer_level - MAX_BUFFER_LEVEL);
+  }
+
+  gst_adaptive_demux_abr_free (abr);
+}
+
+GST_START_TEST (test_moving_average)
+{
+  const guint64 bitrates[] = { 1000000, 2000000, 3000000, 600000, 3000000 };
+  const guint64 expected[] = { 1000000, 1500000, 2000000, 600000, 2200000 };
+  GstAdaptiveDemuxAbrInput input = { 0, FRAGMENT_DURATION,
+    GST_CLOCK_TIME_NONE, 1.0
+  };
+  GstAdaptiveDemuxAbr *abr;
+  guint i;
+
+  abr = gst_adaptive_demux_abr_new (GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE);
+
+  /* the minimum of the last fragment and the average of the last three */
+  for (i = 0; i < G_N_ELEMENTS (bitrates); i++) {
+    input.fragment_bitrate = bitrates[i];
+    fail_unless_equals_uint64 (gst_adaptive_demux_abr_get_bitrate (abr,
+            &input), expected[i]);
+  }
+
+  gst_adaptive_demux_abr_free (abr);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_throughput_chunk_timing)
+{
+  GstAdaptiveDemuxAbrInput input = { 100000, FRAGMENT_DURATION,
+    GST_CLOCK_TIME_NONE, 1.0
+  };
+  GstAdaptiveDemuxAbr *abr;
+  guint64 bitrate, limited;
+  guint i;
+
+  abr = gst_adaptive_demux_abr_new (GST_ADAPTIVE_DEMUX_ABR_THROUGHPUT);
+
+  /* Not enough data yet, the fragment download rate is used */
+  gst_adaptive_demux_abr_add_chunk (abr, 64 * 1024, 100 * GST_MSECOND);
+  fail_unless_equals_uint64 (gst_adaptive_demux_abr_get_bitrate (abr,
+          &input), 100000);
+
+  /* Every 256ms, 16 chunks of 4000 bytes arrive in a burst: 2 Mbps, while
+   * most chunks took no time at all */
+  for (i = 0; i < 20 * 16; i++) {
+    gst_adaptive_demux_abr_add_chunk (abr, 4000,
+        i % 16 ? 0 : 256 * GST_MSECOND);
+  }
+
+  bitrate = gst_adaptive_demux_abr_get_bitrate (abr, &input);
+  GST_INFO ("estimated bitrate %" G_GUINT64_FORMAT, bitrate);
+  fail_unless (bitrate > 1900000 && bitrate < 2100000);
+
+  /* the bitrate limit applies */
+  input.bitrate_limit = 0.5;
+  limited = gst_adaptive_demux_abr_get_bitrate (abr, &input);
+  fail_unless (limited >= bitrate / 2 - 1 && limited <= bitrate / 2 + 1);
+
+  gst_adaptive_demux_abr_free (abr);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_buffer_level)
+{
+  GstAdaptiveDemuxAbrInput input = { 0, FRAGMENT_DURATION,
+    GST_CLOCK_TIME_NONE, 1.0
+  };
+  GstAdaptiveDemuxAbrAlgorithm algorithms[] = {
+    GST_ADAPTIVE_DEMUX_ABR_BUFFER, GST_ADAPTIVE_DEMUX_ABR_HYBRID
+  };
+  guint64 throughput, empty, low, full;
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (algorithms); i++) {
+    GstAdaptiveDemuxAbr *abr = gst_adaptive_demux_abr_new (algorithms[i]);
+
+    /* 2 Mbps */
+    for (j = 0; j < 40; j++)
+      gst_adaptive_demux_abr_add_chunk (abr, 25000, 100 * GST_MSECOND);
+
+    /* Without buffer level, this is the throughput estimate */
+    input.buffer_level = GST_CLOCK_TIME_NONE;
+    throughput = gst_adaptive_demux_abr_get_bitrate (abr, &input);
+    fail_unless (throughput > 1900000 && throughput < 2100000);
+
+    input.buffer_level = 0;
+    empty = gst_adaptive_demux_abr_get_bitrate (abr, &input);
+    input.buffer_level = 3 * FRAGMENT_DURATION;
+    low = gst_adaptive_demux_abr_get_bitrate (abr, &input);
+    input.buffer_level = 10 * FRAGMENT_DURATION;
+    full = gst_adaptive_demux_abr_get_bitrate (abr, &input);
+
+    GST_INFO ("%d: throughput %" G_GUINT64_FORMAT ", empty %" G_GUINT64_FORMAT
+        ", low %" G_GUINT64_FORMAT ", full %" G_GUINT64_FORMAT, algorithms[i],
+        throughput, empty, low, full);
+
+    /* Nothing left to play from, go as low as possible */
+    fail_unless_equals_uint64 (empty, 0);
+    fail_unless (low > empty);
+    /* A full buffer can absorb going above the throughput */
+    fail_unless (full > throughput);
+    fail_unless (full >= low);
+
+    gst_adaptive_demux_abr_free (abr);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_bursty_trace)
+{
+  const GstClockTime duration = 10 * 60 * GST_SECOND;
+  Simulation moving_average, throughput, buffer, hybrid;
+
+  simulate (&moving_average, GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE,
+      trace_bursty, G_N_ELEMENTS (trace_bursty), duration);
+  simulate (&throughput, GST_ADAPTIVE_DEMUX_ABR_THROUGHPUT,
+      trace_bursty, G_N_ELEMENTS (trace_bursty), duration);
+  simulate (&buffer, GST_ADAPTIVE_DEMUX_ABR_BUFFER,
+      trace_bursty, G_N_ELEMENTS (trace_bursty), duration);
+  simulate (&hybrid, GST_ADAPTIVE_DEMUX_ABR_HYBRID,
+      trace_bursty, G_N_ELEMENTS (trace_bursty), duration);
+
+#define LOG_SIMULATION(name, sim) \
+  GST_INFO (name ": %u fragments, %u switches, average bitrate %" \
+      G_GUINT64_FORMAT ", stalled %" GST_TIME_FORMAT, (sim).fragments, \
+      (sim).switches, (sim).bitrate_sum / (sim).fragments, \
+      GST_TIME_ARGS ((sim).stalled))
+  LOG_SIMULATION ("moving-average", moving_average);
+  LOG_SIMULATION ("throughput", throughput);
+  LOG_SIMULATION ("buffer", buffer);
+  LOG_SIMULATION ("hybrid", hybrid);
+#undef LOG_SIMULATION
+
+  /* The moving average follows the bursts */
+  fail_unless (moving_average.switches > moving_average.fragments / 5);
+
+  /* The others switch a lot less, without giving up much quality or
+   * stalling more */
+  fail_unless (throughput.switches * 4 < moving_average.switches);
+  fail_unless (buffer.switches * 4 < moving_average.switches);
+  fail_unless (hybrid.switches * 4 < moving_average.switches);
+
+  fail_unless (throughput.bitrate_sum / throughput.fragments >=
+      moving_average.bitrate_sum / moving_average.fragments * 0.85);
+  fail_unless (buffer.bitrate_sum / buffer.fragments >=
+      moving_average.bitrate_sum / moving_average.fragments);
+  fail_unless (hybrid.bitrate_sum / hybrid.fragments >=
+      moving_average.bitrate_sum / moving_average.fragments);
+
+  fail_unless (throughput.stalled <= moving_average.stalled);
+  fail_unless (buffer.stalled <= moving_average.stalled);
+  fail_unless (hybrid.stalled <= moving_average.stalled);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_bandwidth_drop)
+{
+  guint trace_drop[240];
+  GstAdaptiveDemuxAbrAlgorithm algorithm;
+  guint i;
+
+  /* 60s at 8 Mbps, then 1 Mbps */
+  for (i = 0; i < G_N_ELEMENTS (trace_drop); i++)
+    trace_drop[i] = i < G_N_ELEMENTS (trace_drop) / 2 ? 8000 : 1000;
+
+  for (algorithm = GST_ADAPTIVE_DEMUX_ABR_MOVING_AVERAGE;
+      algorithm <= GST_ADAPTIVE_DEMUX_ABR_HYBRID; algorithm++) {
+    Simulation sim;
+
+    simulate (&sim, algorithm, trace_drop, G_N_ELEMENTS (trace_drop),
+        58 * GST_SECOND);
+    GST_INFO ("%d: variant %u before the drop", algorithm, sim.variant);
+    fail_unless_equals_uint64 (variants[sim.variant], 6000000);
+
+    simulate (&sim, algorithm, trace_drop, G_N_ELEMENTS (trace_drop),
+        115 * GST_SECOND);
+    GST_INFO ("%d: variant %u after the drop, last lowered at fragment %u, "
+        "stalled %" GST_TIME_FORMAT, algorithm, sim.variant,
+        sim.last_down_switch, GST_TIME_ARGS (sim.stalled));
+
+    /* Settled on a variant that fits */
+    fail_unless (variants[sim.variant] <= 1000000);
+    fail_unless (sim.stalled < STALL_TOLERANCE);
+  }
+}
+
+GST_END_TEST;
+
+static Suite *
+adaptivedemuxabr_suite (void)
+{
+  Suite *s = suite_create ("adaptivedemuxabr");
+  TCase *tc_chain = tcase_create ("general");
+
+  GST_DEBUG_CATEGORY_INIT (adaptivedemux_debug, "adaptivedemux", 0,
+      "Base Adaptive Demux");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_moving_average);
+  tcase_add_test (tc_chain, test_throughput_chunk_timing);
+  tcase_add_test (tc_chain, test_buffer_level);
+  tcase_add_test (tc_chain, test_bursty_trace);
+  tcase_add_test (tc_chain, test_bandwidth_drop);
+
+  return s;
+}
+
+GST_CHECK_MAIN (adaptivedemuxabr)
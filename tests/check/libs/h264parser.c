@@ -714,6 +714,91 @@ GST_START_TEST (test_h264_create_sei)
 
 GST_END_TEST;
 
+/* Access unit delimiter and IDR slice, split in two memories in the middle of
+ * the start code or length prefix of the slice */
+static const guint8 h264_au_aud_idr[] = {
+  0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,
+  0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00,
+  0x10, 0xff, 0xfe, 0xf6, 0xf0, 0xfe, 0x05, 0x36,
+  0x56, 0x04, 0x50, 0x96, 0x7b, 0x3f, 0x53, 0xe1
+};
+
+static const guint8 h264_au_aud_idr_avc[] = {
+  0x00, 0x00, 0x00, 0x02, 0x09, 0xf0,
+  0x00, 0x00, 0x00, 0x14, 0x65, 0x88, 0x84, 0x00,
+  0x10, 0xff, 0xfe, 0xf6, 0xf0, 0xfe, 0x05, 0x36,
+  0x56, 0x04, 0x50, 0x96, 0x7b, 0x3f, 0x53, 0xe1
+};
+
+#define H264_AU_SPLIT 8
+#define H264_AU_SLICE_OFFSET 6
+
+GST_START_TEST (test_h264_insert_sei)
+{
+  GstH264NalParser *parser;
+  gint packetized;
+
+  parser = gst_h264_nal_parser_new ();
+
+  for (packetized = 0; packetized < 2; packetized++) {
+    const guint8 *au_data = packetized ? h264_au_aud_idr_avc : h264_au_aud_idr;
+    guint8 sei_data[sizeof (h264_sei_cll)];
+    GstMemory *sei, *slice_mem;
+    GstBuffer *au, *out;
+    GstMapInfo info;
+    guint n_mem;
+
+    memcpy (sei_data, h264_sei_cll, sizeof (h264_sei_cll));
+    if (packetized)
+      GST_WRITE_UINT32_BE (sei_data, sizeof (h264_sei_cll) - 4);
+    sei = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, sei_data,
+        sizeof (sei_data), 0, sizeof (sei_data), NULL, NULL);
+
+    au = gst_buffer_new ();
+    gst_buffer_append_memory (au,
+        gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, (gpointer) au_data,
+            sizeof (h264_au_aud_idr), 0, H264_AU_SPLIT, NULL, NULL));
+    slice_mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+        (gpointer) (au_data + H264_AU_SPLIT),
+        sizeof (h264_au_aud_idr) - H264_AU_SPLIT, 0,
+        sizeof (h264_au_aud_idr) - H264_AU_SPLIT, NULL, NULL);
+    gst_buffer_append_memory (au, slice_mem);
+    GST_BUFFER_PTS (au) = 10 * GST_SECOND;
+
+    if (packetized)
+      out = gst_h264_parser_insert_sei_avc (parser, 4, au, sei);
+    else
+      out = gst_h264_parser_insert_sei (parser, au, sei);
+    fail_unless (out != NULL);
+    assert_equals_uint64 (GST_BUFFER_PTS (out), 10 * GST_SECOND);
+
+    /* the memories of the AU are shared, not merged into a copy */
+    n_mem = gst_buffer_n_memory (out);
+    assert_equals_int (n_mem, 4);
+    fail_unless (gst_buffer_peek_memory (out, 1) == sei);
+    fail_unless (gst_buffer_peek_memory (out, n_mem - 1) == slice_mem);
+    assert_equals_int (gst_buffer_n_memory (au), 2);
+
+    fail_unless (gst_buffer_map (out, &info, GST_MAP_READ));
+    assert_equals_int (info.size, sizeof (h264_au_aud_idr) + sizeof (sei_data));
+    fail_if (memcmp (info.data, au_data, H264_AU_SLICE_OFFSET));
+    fail_if (memcmp (info.data + H264_AU_SLICE_OFFSET, sei_data,
+            sizeof (sei_data)));
+    fail_if (memcmp (info.data + H264_AU_SLICE_OFFSET + sizeof (sei_data),
+            au_data + H264_AU_SLICE_OFFSET,
+            sizeof (h264_au_aud_idr) - H264_AU_SLICE_OFFSET));
+    gst_buffer_unmap (out, &info);
+
+    gst_buffer_unref (out);
+    gst_buffer_unref (au);
+    gst_memory_unref (sei);
+  }
+
+  gst_h264_nal_parser_free (parser);
+}
+
+GST_END_TEST;
+
 static Suite *
 h264parser_suite (void)
 {
@@ -728,6 +813,7 @@ h264parser_suite (void)
   tcase_add_test (tc_chain, test_h264_parse_identify_nalu_avc);
   tcase_add_test (tc_chain, test_h264_parse_invalid_sei);
   tcase_add_test (tc_chain, test_h264_create_sei);
+  tcase_add_test (tc_chain, test_h264_insert_sei);
 
   return s;
 }
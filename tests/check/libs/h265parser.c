@@ -1166,6 +1166,91 @@ GST_START_TEST (test_h265_create_sei)
 
 GST_END_TEST;
 
+/* Access unit delimiter and a slice with TemporalId 1, split in two memories
+ * in the middle of the start code or length prefix of the slice */
+static const guint8 h265_au_aud_slice[] = {
+  0x00, 0x00, 0x00, 0x01, 0x46, 0x01, 0x50,
+  0x00, 0x00, 0x00, 0x01, 0x02, 0x02, 0xd0, 0x2a, 0x6a, 0xf8, 0x48, 0xf3,
+  0x18, 0xe1, 0xb4, 0x40, 0x44, 0x10, 0x25, 0x09, 0xa6, 0xae, 0x5c, 0x83
+};
+
+static const guint8 h265_au_aud_slice_hevc[] = {
+  0x00, 0x00, 0x00, 0x03, 0x46, 0x01, 0x50,
+  0x00, 0x00, 0x00, 0x14, 0x02, 0x02, 0xd0, 0x2a, 0x6a, 0xf8, 0x48, 0xf3,
+  0x18, 0xe1, 0xb4, 0x40, 0x44, 0x10, 0x25, 0x09, 0xa6, 0xae, 0x5c, 0x83
+};
+
+#define H265_AU_SPLIT 9
+#define H265_AU_SLICE_OFFSET 7
+
+GST_START_TEST (test_h265_insert_sei)
+{
+  GstH265Parser *parser;
+  gint packetized;
+
+  parser = gst_h265_parser_new ();
+
+  for (packetized = 0; packetized < 2; packetized++) {
+    const guint8 *au_data =
+        packetized ? h265_au_aud_slice_hevc : h265_au_aud_slice;
+    guint8 sei_data[sizeof (h265_sei_cll)];
+    GstMemory *sei, *slice_mem;
+    GstBuffer *au, *out;
+    GstMapInfo info;
+    guint n_mem;
+
+    memcpy (sei_data, h265_sei_cll, sizeof (h265_sei_cll));
+    if (packetized)
+      GST_WRITE_UINT32_BE (sei_data, sizeof (h265_sei_cll) - 4);
+    sei = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, sei_data,
+        sizeof (sei_data), 0, sizeof (sei_data), NULL, NULL);
+
+    au = gst_buffer_new ();
+    gst_buffer_append_memory (au,
+        gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, (gpointer) au_data,
+            sizeof (h265_au_aud_slice), 0, H265_AU_SPLIT, NULL, NULL));
+    slice_mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+        (gpointer) (au_data + H265_AU_SPLIT),
+        sizeof (h265_au_aud_slice) - H265_AU_SPLIT, 0,
+        sizeof (h265_au_aud_slice) - H265_AU_SPLIT, NULL, NULL);
+    gst_buffer_append_memory (au, slice_mem);
+
+    if (packetized)
+      out = gst_h265_parser_insert_sei_hevc (parser, 4, au, sei);
+    else
+      out = gst_h265_parser_insert_sei (parser, au, sei);
+    fail_unless (out != NULL);
+
+    /* the memories of the AU are shared, not merged into a copy */
+    n_mem = gst_buffer_n_memory (out);
+    assert_equals_int (n_mem, 4);
+    fail_unless (gst_buffer_peek_memory (out, n_mem - 1) == slice_mem);
+    assert_equals_int (gst_buffer_n_memory (au), 2);
+
+    /* and the TemporalId of the SEI is the one of the slice */
+    sei_data[5] = 0x02;
+
+    fail_unless (gst_buffer_map (out, &info, GST_MAP_READ));
+    assert_equals_int (info.size,
+        sizeof (h265_au_aud_slice) + sizeof (sei_data));
+    fail_if (memcmp (info.data, au_data, H265_AU_SLICE_OFFSET));
+    fail_if (memcmp (info.data + H265_AU_SLICE_OFFSET, sei_data,
+            sizeof (sei_data)));
+    fail_if (memcmp (info.data + H265_AU_SLICE_OFFSET + sizeof (sei_data),
+            au_data + H265_AU_SLICE_OFFSET,
+            sizeof (h265_au_aud_slice) - H265_AU_SLICE_OFFSET));
+    gst_buffer_unmap (out, &info);
+
+    gst_buffer_unref (out);
+    gst_buffer_unref (au);
+    gst_memory_unref (sei);
+  }
+
+  gst_h265_parser_free (parser);
+}
+
+GST_END_TEST;
+
 static Suite *
 h265parser_suite (void)
 {
@@ -1188,6 +1273,7 @@ h265parser_suite (void)
   tcase_add_test (tc_chain, test_h265_nal_type_classification);
   tcase_add_test (tc_chain, test_h265_sei_registered_user_data);
   tcase_add_test (tc_chain, test_h265_create_sei);
+  tcase_add_test (tc_chain, test_h265_insert_sei);
 
   return s;
 }
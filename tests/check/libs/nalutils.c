@@ -102,6 +102,120 @@ GST_START_TEST (test_nal_writer_emulation_preventation)
 
 GST_END_TEST;
 
+GST_START_TEST (test_nal_reader_emulation_prevention)
+{
+  /* 0x000003 sequences spread around the 8 bytes words the reader loads */
+  static const guint8 data[] = {
+    0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0,
+    0x00, 0x00, 0x03, 0x01, 0x11, 0x22, 0x33, 0x44,
+    0x55, 0x66, 0x77, 0x00, 0x00, 0x03, 0x00, 0x00,
+    0x03, 0x03, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd,
+    0x03, 0x00, 0x03, 0xee, 0xff, 0x00, 0x00, 0x03,
+  };
+  static const guint8 rbsp[] = {
+    0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0,
+    0x00, 0x00, 0x01, 0x11, 0x22, 0x33, 0x44,
+    0x55, 0x66, 0x77, 0x00, 0x00, 0x00, 0x00,
+    0x03, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd,
+    0x03, 0x00, 0x03, 0xee, 0xff, 0x00, 0x00,
+  };
+  static const guint widths[] = { 1, 3, 8, 32, 5, 16, 7, 24, 2, 13 };
+  NalReader nr;
+  guint64 val64;
+  guint bit, i;
+
+  /* read the same bits with different widths, crossing the emulation
+   * prevention bytes at every possible alignment */
+  for (i = 0; i < G_N_ELEMENTS (widths); i++) {
+    guint w = widths[i];
+
+    nal_reader_init (&nr, data, sizeof (data));
+    for (bit = 0; bit + w <= sizeof (rbsp) * 8; bit += w) {
+      guint32 val, expected = 0;
+      guint j;
+
+      for (j = bit; j < bit + w; j++)
+        expected = (expected << 1) | ((rbsp[j / 8] >> (7 - j % 8)) & 1);
+
+      fail_unless (nal_reader_get_bits_uint32 (&nr, &val, w));
+      assert_equals_int (val, expected);
+      assert_equals_int (nal_reader_is_byte_aligned (&nr), (bit + w) % 8 == 0);
+    }
+  }
+
+  /* and wider than the cache takes at once */
+  for (i = 33; i <= 64; i += 31) {
+    nal_reader_init (&nr, data, sizeof (data));
+    fail_unless (nal_reader_skip (&nr, 3));
+    for (bit = 3; bit + i <= sizeof (rbsp) * 8; bit += i) {
+      guint64 expected = 0;
+      guint j;
+
+      for (j = bit; j < bit + i; j++)
+        expected = (expected << 1) | ((rbsp[j / 8] >> (7 - j % 8)) & 1);
+
+      fail_unless (nal_reader_get_bits_uint64 (&nr, &val64, i));
+      assert_equals_uint64 (val64, expected);
+    }
+    fail_if (nal_reader_get_bits_uint64 (&nr, &val64, i));
+  }
+
+  /* the last byte of the data is an emulation prevention byte too, it is
+   * only counted once reached */
+  nal_reader_init (&nr, data, sizeof (data));
+  fail_unless (nal_reader_skip_long (&nr, sizeof (rbsp) * 8));
+  assert_equals_int (nal_reader_get_epb_count (&nr), 3);
+  assert_equals_int (nal_reader_get_remaining (&nr), 8);
+  fail_if (nal_reader_skip (&nr, 1));
+  assert_equals_int (nal_reader_get_epb_count (&nr), 4);
+
+  /* the position counts the emulation prevention bytes that were skipped,
+   * and only those */
+  nal_reader_init (&nr, data, sizeof (data));
+  fail_unless (nal_reader_skip (&nr, 64));
+  assert_equals_int (nal_reader_get_pos (&nr), 64);
+  assert_equals_int (nal_reader_get_epb_count (&nr), 0);
+  fail_unless (nal_reader_skip (&nr, 24));
+  assert_equals_int (nal_reader_get_pos (&nr), 96);
+  assert_equals_int (nal_reader_get_epb_count (&nr), 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_scan_for_start_codes)
+{
+  guint8 data[256];
+  guint i, j;
+
+  memset (data, 0xaa, sizeof (data));
+  assert_equals_int (scan_for_start_codes (data, sizeof (data)), -1);
+
+  /* start codes at every position, there must be one byte after it */
+  for (i = 0; i < sizeof (data) - 3; i++) {
+    memset (data, 0x01, sizeof (data));
+    data[i] = 0x00;
+    data[i + 1] = 0x00;
+    data[i + 2] = 0x01;
+
+    assert_equals_int (scan_for_start_codes (data, sizeof (data)), i);
+    assert_equals_int (scan_for_start_codes (data, i + 3), -1);
+    for (j = 0; j < i; j++)
+      assert_equals_int (scan_for_start_codes (data + j, sizeof (data) - j),
+          i - j);
+  }
+
+  /* things that look almost like a start code */
+  {
+    static const guint8 almost[] = {
+      0x01, 0x00, 0x01, 0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x00, 0x01, 0x09,
+    };
+
+    assert_equals_int (scan_for_start_codes (almost, sizeof (almost)), 8);
+  }
+}
+
+GST_END_TEST;
+
 static Suite *
 nalutils_suite (void)
 {
@@ -112,6 +226,8 @@ nalutils_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_nal_writer_init);
   tcase_add_test (tc_chain, test_nal_writer_emulation_preventation);
+  tcase_add_test (tc_chain, test_nal_reader_emulation_prevention);
+  tcase_add_test (tc_chain, test_scan_for_start_codes);
 
   return s;
 }
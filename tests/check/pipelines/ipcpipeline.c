@@ -34,7 +34,9 @@
 #include <sys/file.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <gst/check/gstcheck.h>
+#include <gst/allocators/allocators.h>
 #include <string.h>
 
 #ifndef HAVE_PIPE2
@@ -5804,6 +5806,107 @@ GST_START_TEST (test_wavparse_master_process_crash)
 
 GST_END_TEST;
 
+/**** fd passing test ****/
+
+/* This one does not need the multi process framework: memories are passed
+ * by fd between two pipelines of the same process, over a unix socket */
+
+#define FD_PASSING_N_BUFFERS 30
+
+typedef struct
+{
+  guint n_buffers;
+  guint n_fd_buffers;
+  GHashTable *inodes;
+  GHashTable *mappings;
+} FdPassingData;
+
+static void
+fd_passing_handoff (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    FdPassingData * data)
+{
+  GstMemory *mem = gst_buffer_peek_memory (buf, 0);
+  GstMapInfo map;
+  struct stat st;
+
+  data->n_buffers++;
+  if (!gst_is_fd_memory (mem))
+    return;
+  data->n_fd_buffers++;
+
+  fail_unless (fstat (gst_fd_memory_get_fd (mem), &st) == 0);
+  g_hash_table_add (data->inodes, GUINT_TO_POINTER (st.st_ino));
+
+  fail_unless (gst_memory_map (mem, &map, GST_MAP_READ));
+  g_hash_table_add (data->mappings, map.data - mem->offset);
+  gst_memory_unmap (mem, &map);
+}
+
+GST_START_TEST (test_fd_passing)
+{
+  GstElement *master, *slave, *src, *capsfilter, *ipcsink, *ipcsrc, *sink;
+  FdPassingData data = { 0, };
+  GstMessage *msg;
+  GstCaps *caps;
+  int sv[2];
+
+  fail_if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0);
+
+  master = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("videotestsrc", NULL);
+  g_object_set (src, "num-buffers", FD_PASSING_N_BUFFERS, NULL);
+  capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  caps = gst_caps_from_string ("video/x-raw,format=RGBA,width=64,height=64");
+  g_object_set (capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  ipcsink = gst_element_factory_make ("ipcpipelinesink", NULL);
+  g_object_set (ipcsink, "fdin", sv[0], "fdout", sv[0], NULL);
+  gst_bin_add_many (GST_BIN (master), src, capsfilter, ipcsink, NULL);
+  fail_unless (gst_element_link_many (src, capsfilter, ipcsink, NULL));
+
+  slave = gst_element_factory_make ("ipcslavepipeline", NULL);
+  ipcsrc = gst_element_factory_make ("ipcpipelinesrc", NULL);
+  g_object_set (ipcsrc, "fdin", sv[1], "fdout", sv[1], NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  gst_bin_add_many (GST_BIN (slave), ipcsrc, sink, NULL);
+  fail_unless (gst_element_link (ipcsrc, sink));
+
+  data.inodes = g_hash_table_new (NULL, NULL);
+  data.mappings = g_hash_table_new (NULL, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (fd_passing_handoff), &data);
+
+  fail_if (gst_element_set_state (master, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (master), 10 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  /* Every frame went by fd, into the memfd allocator proposed upstream */
+  fail_unless_equals_int (data.n_buffers, FD_PASSING_N_BUFFERS);
+  fail_unless_equals_int (data.n_fd_buffers, FD_PASSING_N_BUFFERS);
+
+  /* The slave released the frames, so the pool of videotestsrc recycled
+   * them instead of allocating a new file for each */
+  fail_unless (g_hash_table_size (data.inodes) < FD_PASSING_N_BUFFERS / 2);
+  /* and the slave only mapped each of these files once */
+  fail_unless (g_hash_table_size (data.mappings) <=
+      g_hash_table_size (data.inodes));
+
+  gst_element_set_state (master, GST_STATE_NULL);
+  gst_element_set_state (slave, GST_STATE_NULL);
+  gst_object_unref (master);
+  gst_object_unref (slave);
+  g_hash_table_unref (data.inodes);
+  g_hash_table_unref (data.mappings);
+  close (sv[0]);
+  close (sv[1]);
+}
+
+GST_END_TEST;
+
 static Suite *
 ipcpipeline_suite (void)
 {
@@ -6061,6 +6164,10 @@ ipcpipeline_suite (void)
      with the master pipeline. */
   tcase_add_test (tc_chain, test_wavparse_master_process_crash);
 
+  /* fd_passing tests that fd backed memories are passed by fd over unix
+     sockets, and released so that the upstream pool can recycle them. */
+  tcase_add_test (tc_chain, test_fd_passing);
+
   return s;
 }
 